@@ -36,6 +36,17 @@ typedef SbBool SbImageReadImageCB(const SbString &, SbImage *, void *);
 
 class COIN_DLL_API SbImage {
 public:
+  enum CompressedFormat {
+    UNCOMPRESSED = 0,
+    BC1_RGB,
+    BC1_RGBA,
+    BC2_RGBA,
+    BC3_RGBA,
+    BC4_R,
+    BC5_RG,
+    ETC1_RGB
+  };
+
   SbImage(void);
   SbImage(const unsigned char * bytes,
           const SbVec2s & size, const int bytesperpixel);
@@ -75,6 +86,17 @@ public:
 
   SbBool hasData(void) const;
 
+  void setCompressedValue(const SbVec2s & size, const CompressedFormat format,
+                          const int numlevels, const unsigned char * data);
+  CompressedFormat getCompressedFormat(void) const;
+  int getNumCompressedLevels(void) const;
+  const unsigned char * getCompressedLevel(const int level, SbVec2s & size,
+                                           size_t & numbytes) const;
+  SbBool compress(const CompressedFormat format, const SbBool mipmaps = TRUE);
+
+  static size_t getCompressedSize(const CompressedFormat format,
+                                  const SbVec2s & size);
+
 private:
 
   class SbImageP * pimpl;
@@ -90,6 +90,8 @@ public:
   void multDirMatrix(const SbVec3f & src, SbVec3f & dst) const;
   void multLineMatrix(const SbLine & src, SbLine & dst) const;
   void multVecMatrix(const SbVec4f & src, SbVec4f & dst) const;
+  void multVecMatrix(const SbVec3f * src, SbVec3f * dst, const int num) const;
+  void multDirMatrix(const SbVec3f * src, SbVec3f * dst, const int num) const;
 
   void print(FILE * fp) const;
 
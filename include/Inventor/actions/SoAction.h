@@ -85,6 +85,11 @@ public:
   void apply(SoAction * beingApplied);
   virtual void invalidateState(void);
 
+  static void applyToChildrenParallel(SoPath * path, SoAction ** actions,
+                                      const int numactions);
+  static void applyToChildrenParallel(SoNode * group, SoAction ** actions,
+                                      const int numactions);
+
   static void nullAction(SoAction * action, SoNode * node);
 
   AppliedCode getWhatAppliedTo(void) const;
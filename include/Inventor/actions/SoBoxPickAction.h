@@ -0,0 +1,75 @@
+#ifndef COIN_SOBOXPICKACTION_H
+#define COIN_SOBOXPICKACTION_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include <Inventor/tools/SbPimplPtr.h>
+#include <Inventor/actions/SoSubAction.h>
+#include <Inventor/actions/SoAction.h>
+#include <Inventor/SbVec3f.h>
+
+class SbBox3f;
+class SbVec2f;
+class SbViewVolume;
+class SoDetail;
+class SoPathList;
+
+struct SoBoxPickPrimitive {
+  int numvertices;
+  SbVec3f vertex[3];
+  const SoDetail * detail;
+};
+
+class COIN_DLL_API SoBoxPickAction : public SoAction {
+  typedef SoAction inherited;
+  SO_ACTION_HEADER(SoBoxPickAction);
+public:
+  static void initClass(void);
+  SoBoxPickAction(void);
+  virtual ~SoBoxPickAction(void);
+
+  void setBox(const SbBox3f & box);
+  void setViewVolume(const SbViewVolume & vv);
+  void setPolygon(const SbViewVolume & vv, const SbVec2f * points, const int numpoints);
+
+  void setPickPrimitives(const SbBool onoff);
+  SbBool isPickPrimitives(void) const;
+
+  virtual void apply(SoNode * node);
+  virtual void apply(SoPath * path);
+  virtual void apply(const SoPathList & paths, SbBool obeysRules = FALSE);
+
+  const SoPathList & getPaths(void) const;
+  int getNumPrimitives(const int index) const;
+  const SoBoxPickPrimitive * getPrimitive(const int index, const int primitive) const;
+
+private:
+  class PImpl;
+  SbPimplPtr<PImpl> pimpl;
+
+  SoBoxPickAction(const SoBoxPickAction & rhs); // N/A
+  SoBoxPickAction & operator = (const SoBoxPickAction & rhs); // N/A
+};
+
+#endif // !COIN_SOBOXPICKACTION_H
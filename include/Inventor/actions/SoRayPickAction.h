@@ -34,6 +34,7 @@ class SbVec2s;
 class SbVec3f;
 class SbViewVolume;
 class SbViewportRegion;
+class SoPath;
 class SoPickedPoint;
 class SoPickedPointList;
 class SoRayPickActionP;
@@ -54,11 +55,26 @@ public:
   void setRay(const SbVec3f & start, const SbVec3f & direction,
               float neardistance = -1.0,
               float fardistance = -1.0);
+  void setRays(const SbVec3f * starts, const SbVec3f * directions,
+               const int numrays,
+               float neardistance = -1.0,
+               float fardistance = -1.0);
+  void setNormalizedPoints(const SbVec2f * normpoints, const int numpoints);
+  int getNumRays(void) const;
+  void setNumThreads(const int num);
+  int getNumThreads(void) const;
   void setPickAll(const SbBool flag);
   SbBool isPickAll(void) const;
   const SoPickedPointList & getPickedPointList(void) const;
+  const SoPickedPointList & getPickedPointList(const int ray) const;
   SoPickedPoint * getPickedPoint(const int index = 0) const;
 
+  void setLightweightPick(const SbBool flag);
+  SbBool isLightweightPick(void) const;
+  const SoPath * getPickedPath(const int ray = 0) const;
+  float getPickedDistance(const int ray = 0) const;
+  const SbVec3f & getPickedObjectPoint(const int ray = 0) const;
+
 
   void computeWorldSpaceRay(void);
   SbBool hasWorldSpaceRay(void) const;
@@ -84,6 +100,15 @@ protected:
   virtual void beginTraversal(SoNode * node);
 
 private:
+  friend class SoShape;
+  friend class SoRayPickActionP;
+
+  int claimRayPacket(void);
+  int getNumPacketRays(void) const;
+  void setPacketRay(const int index);
+  void pushRayPacket(const int * indices, const int num);
+  void popRayPacket(void);
+
   SbPimplPtr<SoRayPickActionP> pimpl;
 
   // NOT IMPLEMENTED:
@@ -54,6 +54,18 @@ public:
   SbBool areIndexArraysMatched(void) const;
   SoSimplifier * getSimplifier(void) const;
 
+  void optimizeMeshes(SbBool onoff);
+  SbBool areMeshesOptimized(void) const;
+  void setWeldTolerance(const float tolerance);
+  float getWeldTolerance(void) const;
+
+  int getNumShapesBefore(void) const;
+  int getNumShapesAfter(void) const;
+  int getNumVerticesBefore(void) const;
+  int getNumVerticesAfter(void) const;
+  int getNumTrianglesBefore(void) const;
+  int getNumTrianglesAfter(void) const;
+
   virtual void apply(SoNode * root);
   virtual void apply(SoPath * path);
   virtual void apply(const SoPathList & pathlist, SbBool obeysrules = FALSE);
@@ -25,6 +25,9 @@
 \**************************************************************************/
 
 #include <Inventor/SbBasic.h>
+#include <Inventor/lists/SbList.h>
+
+class SoTypeList;
 
 class COIN_DLL_API SoProfiler {
 public:
@@ -36,6 +39,9 @@ public:
   static SbBool isOverlayActive(void);
   static SbBool isConsoleActive(void);
 
+  static void getNotificationCounts(SoTypeList & types, SbList<uint32_t> & counts);
+  static void resetNotificationCounts(void);
+
 }; // SoProfiler
 
 #endif // !COIN_SOPROFILER_H
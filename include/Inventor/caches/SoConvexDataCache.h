@@ -25,6 +25,7 @@
 \**************************************************************************/
 
 #include <Inventor/caches/SoCache.h>
+#include <Inventor/SbString.h>
 #include <Inventor/system/inttypes.h>
 
 class SbVec3f;
@@ -66,6 +67,9 @@ public:
   const int32_t *getTexIndices(void) const;
   int getNumTexIndices(void) const;
 
+  static void setCacheDirectory(const SbString & dir);
+  static SbString getCacheDirectory(void);
+
 private:
   SoConvexDataCacheP * pimpl;
 };
@@ -40,6 +40,7 @@ public:
   SbBool call(SoGLRenderAction * action);
 
   void open(SoGLRenderAction * action, SbBool autocache = TRUE);
+  void open(SoGLRenderAction * action, SbBool autocache, const int backend);
   void close(SoGLRenderAction * action);
 
   void invalidateAll(void);
@@ -26,6 +26,7 @@
 
 #include <Inventor/caches/SoCache.h>
 #include <Inventor/elements/SoGLLazyElement.h>
+#include <Inventor/SbTime.h>
 
 class SoGLDisplayList;
 class SoGLRenderCacheP;
@@ -35,7 +36,13 @@ class COIN_DLL_API SoGLRenderCache : public SoCache {
   typedef SoCache inherited;
 
 public:
+  enum Backend {
+    DISPLAY_LIST,
+    VERTEX_BUFFER
+  };
+
   SoGLRenderCache(SoState * state);
+  SoGLRenderCache(SoState * state, const Backend backend);
   virtual ~SoGLRenderCache();
 
   void open(SoState * state);
@@ -50,10 +57,22 @@ public:
   SoGLLazyElement::GLState * getPreLazyState(void);
   SoGLLazyElement::GLState * getPostLazyState(void);
 
+  Backend getBackend(void) const;
+  SbBool isBaked(void) const;
+  size_t getMemoryUsage(void) const;
+  SbTime getReplayTime(void) const;
+
+  static void setDefaultBackend(const Backend backend);
+  static Backend getDefaultBackend(void);
+
+  static SbBool canBakeElement(const int stackindex);
+  static SbBool canBakeShape(const SoType & type);
+
 protected:
   virtual void destroy(SoState *state);
 
 private:
+  friend class SoGLRenderCacheP;
   SoGLRenderCacheP * pimpl;
 };
 
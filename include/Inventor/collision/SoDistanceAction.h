@@ -0,0 +1,78 @@
+#ifndef COIN_SODISTANCEACTION_H
+#define COIN_SODISTANCEACTION_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include <Inventor/tools/SbPimplPtr.h>
+#include <Inventor/actions/SoSubAction.h>
+#include <Inventor/actions/SoAction.h>
+#include <Inventor/SbVec3f.h>
+
+struct SoDistanceResult {
+  float distance;
+  SoPath * path[2];
+  SbVec3f point[2];
+};
+
+class COIN_DLL_API SoDistanceAction : public SoAction {
+  typedef SoAction inherited;
+  SO_ACTION_HEADER(SoDistanceAction);
+public:
+  static void initClass(void);
+  SoDistanceAction(void);
+  virtual ~SoDistanceAction(void);
+
+  enum Query {
+    CLOSEST_PAIR,
+    ALL_PAIRS,
+    NEAREST
+  };
+
+  void setQuery(Query query);
+  Query getQuery(void) const;
+
+  void setMaxDistance(float distance);
+  float getMaxDistance(void) const;
+
+  void setPoint(const SbVec3f & point);
+  const SbVec3f & getPoint(void) const;
+  void setNumNearest(int num);
+  int getNumNearest(void) const;
+
+  virtual void apply(SoNode * node);
+  virtual void apply(SoPath * path);
+  virtual void apply(const SoPathList & paths, SbBool obeysRules = FALSE);
+
+  int getNumResults(void) const;
+  const SoDistanceResult * getResult(int index) const;
+
+private:
+  class PImpl;
+  SbPimplPtr<PImpl> pimpl;
+
+  SoDistanceAction(const SoDistanceAction & rhs); // N/A
+  SoDistanceAction & operator = (const SoDistanceAction & rhs); // N/A
+};
+
+#endif // !COIN_SODISTANCEACTION_H
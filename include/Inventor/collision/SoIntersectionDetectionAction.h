@@ -76,6 +76,12 @@ public:
   void setShapeInternalsEnabled(SbBool enable);
   SbBool isShapeInternalsEnabled(void) const;
 
+  void setPersistent(SbBool enable);
+  SbBool isPersistent(void) const;
+
+  void setNumThreads(int num);
+  int getNumThreads(void) const;
+
   void addVisitationCallback(SoType type, SoIntersectionVisitationCB * cb, void * closure);
   void removeVisitationCallback(SoType type, SoIntersectionVisitationCB * cb, void * closure);
 
@@ -90,6 +90,7 @@ private:
   static SoType classTypeId;
 
   friend class SoState; // FIXME: bad design. 19990629 mortene.
+  friend class SoStateP;
   static void cleanup(void);
   SoElement * nextup;
   SoElement * nextdown;
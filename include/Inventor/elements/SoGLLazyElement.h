@@ -135,6 +135,11 @@ public:
                              SoGLLazyElement::GLState * childprestate,
                              SoGLLazyElement::GLState * childpoststate);
 
+  static void getGLState(const SoState * state, SoGLLazyElement::GLState * glstate);
+  static void sendGLState(const SoState * state,
+                          const SoGLLazyElement::GLState * glstate,
+                          uint32_t mask);
+
   void updateColorVBO(SoVBO * vbo);
 
 protected:
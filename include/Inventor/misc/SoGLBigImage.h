@@ -29,6 +29,8 @@
 #include <Inventor/SbVec2f.h>
 #include <Inventor/misc/SoGLImage.h>
 
+class SoImageTileProvider;
+
 class COIN_DLL_API SoGLBigImage : public SoGLImage {
   typedef SoGLImage inherited;
 
@@ -63,6 +65,10 @@ public:
   SbBool exceededChangeLimit(void);
   static int setChangeLimit(const int limit);
 
+  void setTileProvider(SoImageTileProvider * provider);
+  SoImageTileProvider * getTileProvider(void) const;
+  static size_t setTileCacheSize(const size_t numbytes);
+
   // will return NULL to avoid that SoGLTextureImageElement will
   // update the texture state.
   virtual SoGLDisplayList * getGLDisplayList(SoState * state);
@@ -140,6 +140,13 @@ public:
     // Compress texture if available from OpenGL
     COMPRESSED                = 0x0800,
 
+    // build mipmaps in a worker thread, and upload them a few
+    // levels at a time
+    BACKGROUND_MIPMAP         = 0x1000,
+
+    // the image is sRGB encoded, average mipmap levels in linear space
+    SRGB_MIPMAP               = 0x2000,
+
     // use quality value to decide mipmap, filtering and scaling. This
     // is the default.
     USE_QUALITY_VALUE         = 0X8000
@@ -159,6 +166,14 @@ public:
 
   float getQuality(void) const;
   uint32_t getGLImageId(void) const;
+  SbBool isLoading(void) const;
+
+  static void halveImage(const unsigned char * src, const SbVec3s & size,
+                         const int numcomponents, unsigned char * dst,
+                         const SbBool srgb = FALSE);
+  static void resizeImage(const unsigned char * src, const SbVec3s & size,
+                          const int numcomponents, unsigned char * dst,
+                          const SbVec3s & newsize);
 
 protected:
 
@@ -0,0 +1,52 @@
+#ifndef COIN_SOGLRESOURCEMANAGER_H
+#define COIN_SOGLRESOURCEMANAGER_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include <Inventor/SbBasic.h>
+#include <stddef.h>
+
+class COIN_DLL_API SoGLResourceManager {
+public:
+  enum ResourceType {
+    RENDER_CACHE,
+    TEXTURE,
+    BUFFER_OBJECT
+  };
+
+  static void setMemoryBudget(const size_t bytes);
+  static size_t getMemoryBudget(void);
+
+  static void setUploadBudget(const size_t bytes);
+  static size_t getUploadBudget(void);
+
+  static size_t getMemoryUsage(const uint32_t contextid);
+  static size_t getMemoryUsage(const uint32_t contextid, const ResourceType type);
+  static int getNumResources(const uint32_t contextid, const ResourceType type);
+  static int getNumEvicted(const uint32_t contextid);
+
+  static void evictAll(const uint32_t contextid);
+};
+
+#endif // !COIN_SOGLRESOURCEMANAGER_H
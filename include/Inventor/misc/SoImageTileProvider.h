@@ -0,0 +1,64 @@
+#ifndef COIN_SOIMAGETILEPROVIDER_H
+#define COIN_SOIMAGETILEPROVIDER_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include <Inventor/SbBasic.h>
+#include <Inventor/SbVec2i32.h>
+
+class SbImage;
+class SbString;
+
+class COIN_DLL_API SoImageTileProvider {
+public:
+  SoImageTileProvider(void);
+
+  void ref(void) const;
+  void unref(void) const;
+  int32_t getRefCount(void) const;
+
+  virtual SbVec2i32 getSize(void) const = 0;
+  virtual int getNumComponents(void) const = 0;
+  virtual int getNumLevels(void) const;
+  SbVec2i32 getLevelSize(const int level) const;
+
+  virtual SbBool readRegion(const int level,
+                            const SbVec2i32 & origin,
+                            const SbVec2i32 & size,
+                            unsigned char * buffer) = 0;
+
+  static SoImageTileProvider * createFromFile(const SbString & filename);
+  static SoImageTileProvider * createFromImage(const SbImage & image);
+  static SbBool writeFile(const SbString & filename,
+                          SoImageTileProvider * source,
+                          const int tilesize = 256);
+
+protected:
+  virtual ~SoImageTileProvider();
+
+private:
+  class SoImageTileProviderP * pimpl;
+};
+
+#endif // !COIN_SOIMAGETILEPROVIDER_H
@@ -74,6 +74,7 @@ private:
   SbBool ccw;
   SbBool perVertex;
   int currFaceStart;
+  class SoNormalGeneratorP * pimpl;
 
   SbVec3f calcFaceNormal();
 };
@@ -31,6 +31,7 @@
 class SoAction;
 class SoTypeList;
 class SoElement;
+class SoStateSnapshot;
 
 class COIN_DLL_API SoState {
 public:
@@ -57,7 +58,11 @@ public:
 
   SoElement * getElementNoPush(const int stackindex) const;
 
+  SoStateSnapshot * createSnapshot(void);
+  void restoreSnapshot(const SoStateSnapshot * snapshot);
+
 private:
+  friend class SoStateP;
   SoElement ** stack;
   int numstacks;
   SbBool cacheopen;
@@ -85,12 +90,5 @@ SoState::isCacheOpen(void) const
   return this->cacheopen;
 }
 
-inline SoElement *
-SoState::getElementNoPush(const int stackindex) const
-{
-  assert(this->isElementEnabled(stackindex));
-  return this->stack[stackindex];
-}
-
 
 #endif // !COIN_SOSTATE_H
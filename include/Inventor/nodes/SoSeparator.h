@@ -69,6 +69,8 @@ public:
 
   static void setNumRenderCaches(const int howmany);
   static int getNumRenderCaches(void);
+  static void setRenderCacheBackend(const int backend);
+  static int getRenderCacheBackend(void);
   virtual SbBool affectsState(void) const;
 
 protected:
@@ -27,6 +27,7 @@
 #include <Inventor/nodes/SoNode.h>
 #include <Inventor/nodes/SoSubNode.h>
 #include <Inventor/fields/SoMFNode.h>
+#include <Inventor/SbString.h>
 
 class SoState;
 class SoGLRenderAction;
@@ -50,6 +51,9 @@ public:
   void setEnableCallback(SoShaderProgramEnableCB * cb,
                          void * closure);
 
+  static void setProgramCacheDirectory(const SbString & dir);
+  static SbString getProgramCacheDirectory(void);
+
 SoEXTENDER public:
   virtual void GLRender(SoGLRenderAction * action);
   virtual void search(SoSearchAction * action);
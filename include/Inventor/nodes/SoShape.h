@@ -39,6 +39,7 @@ class SoCoordinateElement;
 class SbVec2f;
 class SoMaterialBundle;
 class SoBoundingBoxCache;
+class SoTriangleBVHCache;
 
 class COIN_DLL_API SoShape : public SoNode {
   typedef SoNode inherited;
@@ -145,7 +146,10 @@ private:
   void validatePVCache(SoGLRenderAction * action);
   void getBBox(SoAction * action, SbBox3f & box, SbVec3f & center);
   void rayPickBoundingBox(SoRayPickAction * action);
+  SoTriangleBVHCache * getTriangleBVHCache(SoAction * action);
   friend class soshape_primdata;           // internal class
+  friend class SoExtSelectionP;            // internal class
+  friend class SoBoxPickActionP;           // internal class
   friend class so_generate_prim_private;   // a very private class
 };
 
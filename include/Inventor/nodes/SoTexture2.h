@@ -73,6 +73,14 @@ public:
 
   static SbBool readImage(const SbString & fname, int & w, int & h, int & nc,
                           unsigned char *& bytes);
+
+  static void setBackgroundLoading(const SbBool onoff);
+  static SbBool isBackgroundLoading(void);
+  static void setCompressOnLoad(const SbBool onoff);
+  static SbBool isCompressOnLoad(void);
+  static void setUseAtlas(const SbBool onoff);
+  static SbBool isUseAtlas(void);
+
 protected:
   virtual ~SoTexture2();
 
@@ -86,6 +94,7 @@ private:
   static void filenameSensorCB(void *, SoSensor *);
 
   SoTexture2P * pimpl;
+  friend class SoTexture2P;
 };
 
 #endif // !COIN_SOTEXTURE2_H
@@ -58,6 +58,15 @@
 #define GL_CLAMP_TO_BORDER 0x812D
 #endif /* GL_CLAMP_TO_BORDER */
 
+/* Texture level of detail parameters (OpenGL 1.2). */
+#ifndef GL_TEXTURE_BASE_LEVEL
+#define GL_TEXTURE_BASE_LEVEL             0x813C
+#endif /* !GL_TEXTURE_BASE_LEVEL */
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL              0x813D
+#endif /* !GL_TEXTURE_MAX_LEVEL */
+
 /* Define for the REPLACE texture model (OpenGL 1.1). */
 #ifndef GL_REPLACE
 #define GL_REPLACE                        0x1E01
@@ -270,6 +279,40 @@
 #define GL_NUM_COMPRESSED_TEXTURE_FORMATS_ARB 0x86A2
 #endif /* !GL_NUM_COMPRESSED_TEXTURE_FORMATS_ARB */
 
+/* block compressed formats (S3TC, LATC and ETC1) */
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
+#endif /* !GL_COMPRESSED_RGB_S3TC_DXT1_EXT */
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT  0x83F1
+#endif /* !GL_COMPRESSED_RGBA_S3TC_DXT1_EXT */
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT  0x83F2
+#endif /* !GL_COMPRESSED_RGBA_S3TC_DXT3_EXT */
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+#endif /* !GL_COMPRESSED_RGBA_S3TC_DXT5_EXT */
+
+#ifndef GL_COMPRESSED_LUMINANCE_LATC1_EXT
+#define GL_COMPRESSED_LUMINANCE_LATC1_EXT 0x8C70
+#endif /* !GL_COMPRESSED_LUMINANCE_LATC1_EXT */
+
+#ifndef GL_COMPRESSED_LUMINANCE_ALPHA_LATC2_EXT
+#define GL_COMPRESSED_LUMINANCE_ALPHA_LATC2_EXT 0x8C72
+#endif /* !GL_COMPRESSED_LUMINANCE_ALPHA_LATC2_EXT */
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES                  0x8D64
+#endif /* !GL_ETC1_RGB8_OES */
+
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2           0x9274
+#endif /* !GL_COMPRESSED_RGB8_ETC2 */
+
 #ifndef GL_COMPRESSED_TEXTURE_FORMATS_ARB
 #define GL_COMPRESSED_TEXTURE_FORMATS_ARB 0x86A3
 #endif /* !GL_COMPRESSED_TEXTURE_FORMATS_ARB */
@@ -1603,6 +1646,19 @@
 #define GL_OBJECT_LINK_STATUS_ARB 0x8B82
 #endif /* GL_OBJECT_LINK_STATUS_ARB */
 
+/* GL_ARB_get_program_binary */
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif /* GL_PROGRAM_BINARY_RETRIEVABLE_HINT */
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif /* GL_PROGRAM_BINARY_LENGTH */
+
+/* GL_KHR_parallel_shader_compile */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif /* GL_COMPLETION_STATUS_KHR */
+
 /* GL_EXT_texture_filter_anisotropic */
 #ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
 #define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
@@ -209,6 +209,9 @@
 #include <Inventor/elements/SoOverrideElement.h>
 #include <Inventor/misc/SoState.h>
 #include <Inventor/lists/SbList.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/misc/SoChildList.h>
+#include <Inventor/C/threads/wpool.h>
 #include <Inventor/SoDB.h>
 #include <Inventor/system/gl.h>
 #include <Inventor/errors/SoDebugError.h>
@@ -414,10 +417,12 @@ SoAction::initClasses(void)
   SoHandleEventAction::initClass();
   SoPickAction::initClass();
   SoRayPickAction::initClass();
+  SoBoxPickAction::initClass();
   SoSearchAction::initClass();
   SoWriteAction::initClass();
   SoAudioRenderAction::initClass();
   SoIntersectionDetectionAction::initClass();
+  SoDistanceAction::initClass();
 
   SoSimplifyAction::initClass();
   SoReorganizeAction::initClass();
@@ -809,6 +814,125 @@ SoAction::apply(SoAction * beingApplied)
   }
 }
 
+// Closure and callback for one sub-traversal in
+// SoAction::applyToChildrenParallel().
+struct soaction_subtraversal {
+  SoAction * action;
+  SoPathList * pathlist;
+};
+
+static void
+soaction_apply_subtraversal(void * closure)
+{
+  soaction_subtraversal * job = static_cast<soaction_subtraversal *>(closure);
+  job->action->apply(*job->pathlist, TRUE);
+}
+
+/*!
+  Splits the children of the group at the tail of \a path into \a
+  numactions consecutive ranges, and applies \a actions[i] to range
+  number \e i. Afterwards, the results of the actions can be merged
+  in traversal order, e.g. by summing the triangle counts of a set of
+  SoGetPrimitiveCountAction instances, or by concatenating the paths
+  found by a set of SoSearchAction instances.
+
+  Each sub-traversal runs in its own thread, and uses the SoState of
+  its own action. Before entering its range of children, the state of
+  each action is brought up to the split point by traversing \a path
+  and the nodes to the left of the range which change the traversal
+  state (as for any path list traversal). Each sub-traversal therefore
+  sees exactly the same element stack as a traversal of the complete
+  scene graph would.
+
+  The actions must not modify the scene graph, and any callbacks
+  registered with them must be safe to invoke from several threads at
+  the same time. Note that nodes which change the traversal state and
+  are to the left of, or above, a range of children are traversed by
+  each of the actions, so e.g. SoCallbackAction pre-callbacks on such
+  nodes will be invoked more than once.
+
+  The sub-traversals are only run in parallel when Coin has been built
+  with thread-safety enabled. Otherwise they are run one after the
+  other in the calling thread, with the same results.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoAction::applyToChildrenParallel(SoPath * path, SoAction ** actions,
+                                  const int numactions)
+{
+  assert(path && path->getLength() > 0);
+  assert(actions && numactions > 0);
+
+  path->ref();
+  SoNode * tail = path->getTail();
+  SoChildList * children = tail->getChildren();
+  const int numchildren = children ? children->getLength() : 0;
+
+  if (numchildren == 0 || numactions == 1) {
+    actions[0]->apply(path);
+    path->unrefNoDelete();
+    return;
+  }
+
+  const int numjobs = SbMin(numactions, numchildren);
+  soaction_subtraversal * jobs = new soaction_subtraversal[numjobs];
+  int i;
+  for (i = 0; i < numjobs; i++) {
+    const int start = int((int64_t(numchildren) * i) / numjobs);
+    const int end = int((int64_t(numchildren) * (i + 1)) / numjobs);
+    jobs[i].action = actions[i];
+    jobs[i].pathlist = new SoPathList(end - start);
+    for (int c = start; c < end; c++) {
+      SoPath * childpath = path->copy();
+      childpath->append(c);
+      jobs[i].pathlist->append(childpath);
+    }
+    // Set up the traversal method table and the state in this thread,
+    // as the lazy initialization of these is not thread safe.
+    actions[i]->traversalMethods->setUp();
+    (void) actions[i]->getState();
+  }
+
+#if defined(HAVE_THREADS) && defined(COIN_THREADSAFE)
+  cc_wpool * pool = cc_wpool_construct(numjobs - 1);
+  cc_wpool_begin(pool, numjobs - 1);
+  for (i = 1; i < numjobs; i++) {
+    cc_wpool_start_worker(pool, soaction_apply_subtraversal, &jobs[i]);
+  }
+  cc_wpool_end(pool);
+  soaction_apply_subtraversal(&jobs[0]);
+  cc_wpool_wait_all(pool);
+  cc_wpool_destruct(pool);
+#else // !(HAVE_THREADS && COIN_THREADSAFE)
+  for (i = 0; i < numjobs; i++) {
+    soaction_apply_subtraversal(&jobs[i]);
+  }
+#endif // !(HAVE_THREADS && COIN_THREADSAFE)
+
+  for (i = 0; i < numjobs; i++) {
+    delete jobs[i].pathlist;
+  }
+  delete[] jobs;
+  path->unrefNoDelete();
+}
+
+/*!
+  \overload
+
+  Splits the children of \a group between \a actions.
+*/
+void
+SoAction::applyToChildrenParallel(SoNode * group, SoAction ** actions,
+                                  const int numactions)
+{
+  SoPath * path = new SoPath(group);
+  path->ref();
+  SoAction::applyToChildrenParallel(path, actions, numactions);
+  path->unref();
+}
 
 /*!
   Invalidates the state, forcing it to be recreated at the next
@@ -1395,3 +1519,67 @@ SoActionP::getProfilerOverlay(void)
 // *************************************************************************
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoGetPrimitiveCountAction.h>
+#include <Inventor/nodes/SoCone.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+BOOST_AUTO_TEST_CASE(applyToChildrenParallel)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  // the translations accumulate across the children, so each range
+  // of children needs the state from the ranges before it
+  for (int i = 0; i < 10; i++) {
+    SoTranslation * t = new SoTranslation;
+    t->translation.setValue(float(i), 0.5f, 0.0f);
+    root->addChild(t);
+    if (i % 3 == 0) root->addChild(new SoCube);
+    else if (i % 3 == 1) root->addChild(new SoSphere);
+    else {
+      SoSeparator * sep = new SoSeparator;
+      sep->addChild(new SoTranslation);
+      sep->addChild(new SoCone);
+      root->addChild(sep);
+    }
+  }
+
+  const SbViewportRegion vp(100, 100);
+  SoGetBoundingBoxAction bboxaction(vp);
+  bboxaction.apply(root);
+  SoGetPrimitiveCountAction countaction;
+  countaction.apply(root);
+
+  SoGetBoundingBoxAction * bboxactions[4];
+  SoGetPrimitiveCountAction * countactions[4];
+  int i;
+  for (i = 0; i < 4; i++) {
+    bboxactions[i] = new SoGetBoundingBoxAction(vp);
+    countactions[i] = new SoGetPrimitiveCountAction;
+  }
+  SoAction::applyToChildrenParallel(root, reinterpret_cast<SoAction **>(bboxactions), 4);
+  SoAction::applyToChildrenParallel(root, reinterpret_cast<SoAction **>(countactions), 4);
+
+  SbBox3f bbox;
+  int triangles = 0;
+  for (i = 0; i < 4; i++) {
+    bbox.extendBy(bboxactions[i]->getBoundingBox());
+    triangles += countactions[i]->getTriangleCount();
+    delete bboxactions[i];
+    delete countactions[i];
+  }
+
+  BOOST_CHECK(bbox.getMin() == bboxaction.getBoundingBox().getMin());
+  BOOST_CHECK(bbox.getMax() == bboxaction.getBoundingBox().getMax());
+  BOOST_CHECK_EQUAL(triangles, countaction.getTriangleCount());
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
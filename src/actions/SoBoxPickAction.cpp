@@ -0,0 +1,1085 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SoBoxPickAction SoBoxPickAction.h Inventor/actions/SoBoxPickAction.h
+  \brief The SoBoxPickAction class finds the shapes inside a volume.
+
+  The action finds all shapes with primitives inside, or crossing the
+  boundary of, one of three kinds of volumes:
+
+  - a box in world space, set with setBox().
+
+  - a view volume, set with setViewVolume(). For rectangle selection,
+    this is the view volume of the camera narrowed to the rectangle
+    with SbViewVolume::narrow().
+
+  - a polygon in normalized screen coordinates, extruded through a
+    view volume, set with setPolygon(). This is for lasso selection.
+
+  The paths to the shapes found are returned by getPaths(), in
+  traversal order. If setPickPrimitives() has been called with \c
+  TRUE, the triangles, line segments and points of each shape inside
+  the volume are returned as well, see getPrimitive().
+
+  \code
+  SbViewVolume vv = camera->getViewVolume(viewport.getViewportAspectRatio());
+  SoBoxPickAction pa;
+  pa.setViewVolume(vv.narrow(0.2f, 0.2f, 0.4f, 0.5f));
+  pa.apply(root);
+  const SoPathList & paths = pa.getPaths();
+  for (int i = 0; i < paths.getLength(); i++) {
+    selection->select(paths[i]);
+  }
+  \endcode
+
+  The volume is tested against the bounding box caches of the
+  separators in the scene, so whole subgraphs outside the volume are
+  skipped, and shapes under separators inside it are picked without
+  further tests. Only the shapes crossing the boundary of the volume
+  have their primitives tested, and shapes which are picked more than
+  once keep a tree of their triangles for skipping most of them. If
+  the scene has no bounding box caches yet, they are made by the
+  first apply().
+
+  Unlike SoExtSelection, which tests the primitives of every shape in
+  the scene against the lasso, the cost of the action depends mostly
+  on the number of shapes on the boundary of the volume.
+
+  For concave polygons, only the view volume of the polygon's
+  bounding rectangle is used for skipping subgraphs, and the bounding
+  boxes of shapes are tested against the polygon on the screen.
+
+  \ingroup actions
+  \since Coin 4.0
+*/
+
+/*!
+  \struct SoBoxPickPrimitive SoBoxPickAction.h Inventor/actions/SoBoxPickAction.h
+  \brief The SoBoxPickPrimitive struct holds a primitive found by SoBoxPickAction.
+
+  \c numvertices is 3 for triangles, 2 for line segments and 1 for
+  points. The vertices are in world space. \c detail is a copy of the
+  detail of the first vertex, or \c NULL if the shape sets none. For
+  a face set, this is an SoFaceDetail which tells which face the
+  triangle is part of.
+
+  \ingroup actions
+  \since Coin 4.0
+*/
+
+// *************************************************************************
+
+#include <Inventor/actions/SoBoxPickAction.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/SbBox2f.h>
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbPlane.h>
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/caches/SoBoundingBoxCache.h>
+#include <Inventor/details/SoDetail.h>
+#include <Inventor/elements/SoCullElement.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/misc/SoState.h>
+#include <Inventor/nodes/SoShape.h>
+
+#include "actions/SoSubActionP.h"
+#include "caches/SoTriangleBVHCache.h"
+#include "coindefs.h"
+#include "SbBasicP.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+// *************************************************************************
+
+static SbBool
+boxpick_debug(void)
+{
+  static int dbg = -1;
+  if (dbg == -1) {
+    const char * env = coin_getenv("COIN_DEBUG_BOXPICKACTION");
+    dbg = env && atoi(env) > 0;
+  }
+  return dbg == 0 ? FALSE : TRUE;
+}
+
+// Returns TRUE if p is inside the polygon, with the even-odd rule.
+static SbBool
+boxpick_point_in_polygon(const SbVec2f & p, const SbVec2f * polygon, const int num)
+{
+  SbBool inside = FALSE;
+  for (int i = 0, j = num - 1; i < num; j = i++) {
+    const SbVec2f & a = polygon[i];
+    const SbVec2f & b = polygon[j];
+    if ((a[1] > p[1]) != (b[1] > p[1]) &&
+        p[0] < (b[0] - a[0]) * (p[1] - a[1]) / (b[1] - a[1]) + a[0]) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+static float
+boxpick_orient(const SbVec2f & a, const SbVec2f & b, const SbVec2f & c)
+{
+  return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// Returns TRUE if c, which is on the line through a and b, is on the
+// segment between them.
+static SbBool
+boxpick_on_segment(const SbVec2f & a, const SbVec2f & b, const SbVec2f & c)
+{
+  return
+    c[0] >= SbMin(a[0], b[0]) && c[0] <= SbMax(a[0], b[0]) &&
+    c[1] >= SbMin(a[1], b[1]) && c[1] <= SbMax(a[1], b[1]);
+}
+
+static SbBool
+boxpick_segments_intersect(const SbVec2f & p0, const SbVec2f & p1,
+                           const SbVec2f & q0, const SbVec2f & q1)
+{
+  const float d0 = boxpick_orient(q0, q1, p0);
+  const float d1 = boxpick_orient(q0, q1, p1);
+  const float d2 = boxpick_orient(p0, p1, q0);
+  const float d3 = boxpick_orient(p0, p1, q1);
+  if (((d0 > 0.0f && d1 < 0.0f) || (d0 < 0.0f && d1 > 0.0f)) &&
+      ((d2 > 0.0f && d3 < 0.0f) || (d2 < 0.0f && d3 > 0.0f))) return TRUE;
+  if (d0 == 0.0f && boxpick_on_segment(q0, q1, p0)) return TRUE;
+  if (d1 == 0.0f && boxpick_on_segment(q0, q1, p1)) return TRUE;
+  if (d2 == 0.0f && boxpick_on_segment(p0, p1, q0)) return TRUE;
+  if (d3 == 0.0f && boxpick_on_segment(p0, p1, q1)) return TRUE;
+  return FALSE;
+}
+
+// Returns TRUE if the polygon is convex and doesn't cross itself,
+// which is when it turns the same way at every corner, and only
+// once around.
+static SbBool
+boxpick_is_convex(const SbVec2f * polygon, const int num)
+{
+  SbBool left = FALSE, right = FALSE;
+  double turn = 0.0;
+  for (int i = 0; i < num; i++) {
+    const SbVec2f e0 = polygon[(i + 1) % num] - polygon[i];
+    const SbVec2f e1 = polygon[(i + 2) % num] - polygon[(i + 1) % num];
+    const float cross = e0[0] * e1[1] - e0[1] * e1[0];
+    if (cross > 0.0f) left = TRUE;
+    else if (cross < 0.0f) right = TRUE;
+    turn += atan2(double(cross), double(e0.dot(e1)));
+  }
+  return !(left && right) && fabs(fabs(turn) - 2.0 * M_PI) < 0.01;
+}
+
+// Clips the convex polygon v against plane, and puts the part inside
+// it in out. Returns the number of vertices in out.
+static int
+boxpick_clip_polygon(const SbPlane & plane, const SbVec3f * v, const int num, SbVec3f * out)
+{
+  int numout = 0;
+  const SbVec3f * prev = &v[num - 1];
+  float dprev = plane.getDistance(*prev);
+  for (int i = 0; i < num; i++) {
+    const float d = plane.getDistance(v[i]);
+    if ((dprev >= 0.0f) != (d >= 0.0f)) {
+      out[numout++] = *prev + (v[i] - *prev) * (dprev / (dprev - d));
+    }
+    if (d >= 0.0f) out[numout++] = v[i];
+    prev = &v[i];
+    dprev = d;
+  }
+  return numout;
+}
+
+// *************************************************************************
+
+// Gives the action access to the triangle trees which shapes keep
+// for picking.
+class SoBoxPickActionP {
+public:
+  static SoTriangleBVHCache * getTriangleBVHCache(SoShape * shape, SoAction * action)
+  {
+    return shape->getTriangleBVHCache(action);
+  }
+};
+
+// The traverser used by the action. The planes of the volume are
+// added to SoCullElement before traversing, so SoSeparator skips
+// subgraphs outside the volume, and SoCullElement::completelyInside()
+// tells when a subgraph is inside it.
+class SoBoxPickTraverser : public SoCallbackAction {
+public:
+  SoBoxPickTraverser(void) : planes(NULL), numplanes(0) { }
+
+  const SbPlane * planes;
+  int numplanes;
+
+protected:
+  virtual void beginTraversal(SoNode * node)
+  {
+    SoState * state = this->getState();
+    // push, so the planes are gone again after the traversal
+    state->push();
+    for (int i = 0; i < this->numplanes; i++) {
+      SoCullElement::addPlane(state, this->planes[i]);
+    }
+    SoCallbackAction::beginTraversal(node);
+    state->pop();
+  }
+};
+
+// *************************************************************************
+
+class SoBoxPickAction::PImpl {
+public:
+  PImpl(void);
+  ~PImpl();
+
+  // SoCullElement holds 32 planes, but completelyInside() can only
+  // handle 31
+  enum { MAXPLANES = 31 };
+
+  enum ShapeState {
+    IDLE,     // not traversing a shape, or it has been handled
+    INSIDE,   // the shape is inside the volume
+    BOUNDARY  // the shape crosses the boundary of the volume
+  };
+
+  void clear(void);
+  void clearVolume(void);
+  void setPlanes(const SbViewVolume & vv);
+  void traverse(SoNode * node);
+  void traverse(SoPath * path);
+  void report(void) const;
+
+  int classifyBox(const SbBox3f & box, const SbMatrix & matrix) const;
+  int classifyPolygon(const SbBox3f & box, const SbMatrix & matrix) const;
+  SbBool intersect(const SbVec3f * v, const int num) const;
+  SbBool intersectPolygon(const SbVec3f * v, const int num) const;
+  void addPrimitive(SoCallbackAction * action, const SoPrimitiveVertex * const * v,
+                    const int num);
+  void addPath(SoCallbackAction * action);
+
+  static SoCallbackAction::Response preShapeCB(void * closure, SoCallbackAction * action,
+                                               const SoNode * node);
+  static SoCallbackAction::Response postShapeCB(void * closure, SoCallbackAction * action,
+                                                const SoNode * node);
+  static void triangleCB(void * closure, SoCallbackAction * action,
+                         const SoPrimitiveVertex * v1,
+                         const SoPrimitiveVertex * v2,
+                         const SoPrimitiveVertex * v3);
+  static void lineSegmentCB(void * closure, SoCallbackAction * action,
+                            const SoPrimitiveVertex * v1,
+                            const SoPrimitiveVertex * v2);
+  static void pointCB(void * closure, SoCallbackAction * action,
+                      const SoPrimitiveVertex * v);
+
+  // the volume
+  SbPlane planes[MAXPLANES]; // world space, normals pointing in
+  int numplanes;
+  SbBool empty;
+  SbBool concave; // the planes are the bounding rectangle of the polygon
+  SbViewVolume viewvolume;
+  SbList<SbVec2f> polygon;
+
+  SbBool pickprimitives;
+  SoBoxPickTraverser * traverser;
+  SoPathList paths;
+  SbList<int> primstart; // index of the first primitive of each path
+  SbList<SoBoxPickPrimitive> primitives;
+
+  // the shape being traversed
+  ShapeState shapestate;
+  SbBool shapehit;
+  int shapeprimstart;
+
+  // for debugging
+  unsigned int numinside;
+  unsigned int numoutside;
+  unsigned int numboundary;
+  unsigned int numprimtests;
+};
+
+SoBoxPickAction::PImpl::PImpl(void)
+{
+  this->clearVolume();
+  this->pickprimitives = FALSE;
+  this->shapestate = IDLE;
+  this->shapehit = FALSE;
+  this->shapeprimstart = 0;
+  this->numinside = this->numoutside = this->numboundary = this->numprimtests = 0;
+
+  this->traverser = new SoBoxPickTraverser;
+  this->traverser->planes = this->planes;
+  const SoType shapetype = SoShape::getClassTypeId();
+  this->traverser->addPreCallback(shapetype, PImpl::preShapeCB, this);
+  this->traverser->addPostCallback(shapetype, PImpl::postShapeCB, this);
+  this->traverser->addTriangleCallback(shapetype, PImpl::triangleCB, this);
+  this->traverser->addLineSegmentCallback(shapetype, PImpl::lineSegmentCB, this);
+  this->traverser->addPointCallback(shapetype, PImpl::pointCB, this);
+}
+
+SoBoxPickAction::PImpl::~PImpl()
+{
+  this->clear();
+  delete this->traverser;
+}
+
+// Throws away the results of the last apply().
+void
+SoBoxPickAction::PImpl::clear(void)
+{
+  for (int i = 0; i < this->primitives.getLength(); i++) {
+    delete this->primitives[i].detail;
+  }
+  this->primitives.truncate(0);
+  this->primstart.truncate(0);
+  this->paths.truncate(0);
+  this->numinside = this->numoutside = this->numboundary = this->numprimtests = 0;
+}
+
+void
+SoBoxPickAction::PImpl::clearVolume(void)
+{
+  this->numplanes = 0;
+  this->empty = TRUE;
+  this->concave = FALSE;
+  this->polygon.truncate(0);
+}
+
+void
+SoBoxPickAction::PImpl::setPlanes(const SbViewVolume & vv)
+{
+  vv.getViewVolumePlanes(this->planes);
+  this->numplanes = 6;
+  this->empty = !(vv.getDepth() > 0.0f && vv.getWidth() > 0.0f && vv.getHeight() > 0.0f);
+}
+
+void
+SoBoxPickAction::PImpl::traverse(SoNode * node)
+{
+  // makes the bounding box caches the traversal culls against
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  bboxaction.apply(node);
+
+  this->traverser->numplanes = this->numplanes;
+  this->traverser->apply(node);
+}
+
+void
+SoBoxPickAction::PImpl::traverse(SoPath * path)
+{
+  SoGetBoundingBoxAction bboxaction((SbViewportRegion()));
+  bboxaction.apply(path);
+
+  this->traverser->numplanes = this->numplanes;
+  this->traverser->apply(path);
+}
+
+void
+SoBoxPickAction::PImpl::report(void) const
+{
+  if (boxpick_debug()) {
+    SoDebugError::postInfo("SoBoxPickAction::PImpl::report",
+                           "%u shapes inside, %u outside and %u on the boundary, "
+                           "%u primitives tested, %d shapes picked",
+                           this->numinside, this->numoutside, this->numboundary,
+                           this->numprimtests, this->paths.getLength());
+  }
+}
+
+// Returns -1 if box, transformed by matrix, is outside one of the
+// planes, 1 if it is inside all of them and 0 if it crosses the
+// boundary of the volume.
+int
+SoBoxPickAction::PImpl::classifyBox(const SbBox3f & box, const SbMatrix & matrix) const
+{
+  const SbVec3f & min = box.getMin();
+  const SbVec3f & max = box.getMax();
+  SbVec3f corners[8];
+  int i;
+  for (i = 0; i < 8; i++) {
+    const SbVec3f corner((i & 1) ? max[0] : min[0],
+                         (i & 2) ? max[1] : min[1],
+                         (i & 4) ? max[2] : min[2]);
+    matrix.multVecMatrix(corner, corners[i]);
+  }
+  SbBool inside = TRUE;
+  for (i = 0; i < this->numplanes; i++) {
+    int in = 0;
+    for (int j = 0; j < 8; j++) {
+      if (this->planes[i].isInHalfSpace(corners[j])) in++;
+    }
+    if (in == 0) return -1;
+    if (in < 8) inside = FALSE;
+  }
+  return inside ? 1 : 0;
+}
+
+// Like classifyBox(), but against the polygon on the screen, for
+// boxes inside the view volume of its bounding rectangle.
+int
+SoBoxPickAction::PImpl::classifyPolygon(const SbBox3f & box, const SbMatrix & matrix) const
+{
+  const SbVec3f & min = box.getMin();
+  const SbVec3f & max = box.getMax();
+  SbBox2f rect;
+  int i;
+  for (i = 0; i < 8; i++) {
+    SbVec3f corner((i & 1) ? max[0] : min[0],
+                   (i & 2) ? max[1] : min[1],
+                   (i & 4) ? max[2] : min[2]);
+    matrix.multVecMatrix(corner, corner);
+    SbVec3f s;
+    this->viewvolume.projectToScreen(corner, s);
+    rect.extendBy(SbVec2f(s[0], s[1]));
+  }
+
+  const SbVec2f & rmin = rect.getMin();
+  const SbVec2f & rmax = rect.getMax();
+  const SbVec2f r[4] = {
+    rmin, SbVec2f(rmax[0], rmin[1]), rmax, SbVec2f(rmin[0], rmax[1])
+  };
+  const SbVec2f * polygon = this->polygon.getArrayPtr();
+  const int numpolygon = this->polygon.getLength();
+  for (i = 0; i < numpolygon; i++) {
+    if (rect.intersect(polygon[i])) return 0;
+    const SbVec2f & a = polygon[i];
+    const SbVec2f & b = polygon[(i + 1) % numpolygon];
+    for (int j = 0; j < 4; j++) {
+      if (boxpick_segments_intersect(a, b, r[j], r[(j + 1) % 4])) return 0;
+    }
+  }
+  // no edges cross, so the rectangle is either inside or outside
+  return boxpick_point_in_polygon(rect.getCenter(), polygon, numpolygon) ? 1 : -1;
+}
+
+// Returns TRUE if the primitive with the num world space vertices in
+// v is at least partly inside the volume.
+SbBool
+SoBoxPickAction::PImpl::intersect(const SbVec3f * v, const int num) const
+{
+  SbVec3f buf[2][MAXPLANES + 3];
+  const SbVec3f * in = v;
+  int numin = num;
+  int i;
+
+  if (num == 3) {
+    for (i = 0; i < this->numplanes && numin > 0; i++) {
+      SbVec3f * out = buf[i & 1];
+      numin = boxpick_clip_polygon(this->planes[i], in, numin, out);
+      in = out;
+    }
+  }
+  else if (num == 2) {
+    float t0 = 0.0f, t1 = 1.0f;
+    for (i = 0; i < this->numplanes; i++) {
+      const float d0 = this->planes[i].getDistance(v[0]);
+      const float d1 = this->planes[i].getDistance(v[1]);
+      if (d0 < 0.0f && d1 < 0.0f) return FALSE;
+      if (d0 < 0.0f) t0 = SbMax(t0, d0 / (d0 - d1));
+      else if (d1 < 0.0f) t1 = SbMin(t1, d0 / (d0 - d1));
+      if (t0 > t1) return FALSE;
+    }
+    buf[0][0] = v[0] + (v[1] - v[0]) * t0;
+    buf[0][1] = v[0] + (v[1] - v[0]) * t1;
+    in = buf[0];
+  }
+  else {
+    for (i = 0; i < this->numplanes; i++) {
+      if (!this->planes[i].isInHalfSpace(v[0])) return FALSE;
+    }
+  }
+  if (numin == 0) return FALSE;
+  return this->concave ? this->intersectPolygon(in, numin) : TRUE;
+}
+
+// Returns TRUE if the primitive with the num world space vertices in
+// v, which are inside the view volume, overlaps the polygon on the
+// screen.
+SbBool
+SoBoxPickAction::PImpl::intersectPolygon(const SbVec3f * v, const int num) const
+{
+  SbVec2f p[MAXPLANES + 3];
+  int i;
+  for (i = 0; i < num; i++) {
+    SbVec3f s;
+    this->viewvolume.projectToScreen(v[i], s);
+    p[i].setValue(s[0], s[1]);
+  }
+
+  const SbVec2f * polygon = this->polygon.getArrayPtr();
+  const int numpolygon = this->polygon.getLength();
+  for (i = 0; i < num; i++) {
+    if (boxpick_point_in_polygon(p[i], polygon, numpolygon)) return TRUE;
+  }
+  if (num == 1) return FALSE;
+
+  const int numedges = (num == 2) ? 1 : num;
+  for (i = 0; i < numedges; i++) {
+    const SbVec2f & a = p[i];
+    const SbVec2f & b = p[(i + 1) % num];
+    for (int j = 0; j < numpolygon; j++) {
+      if (boxpick_segments_intersect(a, b, polygon[j], polygon[(j + 1) % numpolygon])) {
+        return TRUE;
+      }
+    }
+  }
+  // the polygon can be inside the primitive
+  return num > 2 && boxpick_point_in_polygon(polygon[0], p, num);
+}
+
+void
+SoBoxPickAction::PImpl::addPrimitive(SoCallbackAction * action,
+                                     const SoPrimitiveVertex * const * v,
+                                     const int num)
+{
+  if (this->shapestate == IDLE) return;
+  if (this->shapehit && !this->pickprimitives) return;
+
+  const SbMatrix & matrix = action->getModelMatrix();
+  SoBoxPickPrimitive primitive;
+  primitive.numvertices = num;
+  for (int i = 0; i < num; i++) {
+    matrix.multVecMatrix(v[i]->getPoint(), primitive.vertex[i]);
+  }
+  if (this->shapestate == BOUNDARY) {
+    this->numprimtests++;
+    if (!this->intersect(primitive.vertex, num)) return;
+  }
+  this->shapehit = TRUE;
+  if (this->pickprimitives) {
+    const SoDetail * detail = v[0]->getDetail();
+    primitive.detail = detail ? detail->copy() : NULL;
+    this->primitives.append(primitive);
+  }
+}
+
+void
+SoBoxPickAction::PImpl::addPath(SoCallbackAction * action)
+{
+  this->paths.append(new SoPath(*action->getCurPath()));
+  this->primstart.append(this->shapeprimstart);
+}
+
+SoCallbackAction::Response
+SoBoxPickAction::PImpl::preShapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
+{
+  PImpl * thisp = static_cast<PImpl *>(closure);
+  SoShape * shape = const_cast<SoShape *>(coin_assert_cast<const SoShape *>(node));
+  SoState * state = action->getState();
+
+  thisp->shapestate = IDLE;
+  thisp->shapehit = FALSE;
+  thisp->shapeprimstart = thisp->primitives.getLength();
+
+  // under a separator inside the volume
+  int where = (!thisp->concave && SoCullElement::completelyInside(state)) ? 1 : 0;
+
+  if (where == 0) {
+    SbBox3f bbox;
+    SbVec3f center;
+    const SoBoundingBoxCache * bboxcache = shape->getBoundingBoxCache();
+    if (bboxcache && bboxcache->isValid(state)) {
+      bbox = bboxcache->getProjectedBox();
+    }
+    else {
+      shape->computeBBox(action, bbox, center);
+    }
+    if (bbox.isEmpty()) return SoCallbackAction::PRUNE;
+    where = thisp->classifyBox(bbox, action->getModelMatrix());
+    // for concave polygons, the planes are just the bounding
+    // rectangle, so boxes inside it are tested against the polygon
+    // on the screen
+    if (where > 0 && thisp->concave) {
+      where = thisp->classifyPolygon(bbox, action->getModelMatrix());
+    }
+  }
+
+  if (where < 0) {
+    thisp->numoutside++;
+    return SoCallbackAction::PRUNE;
+  }
+  if (where > 0) {
+    thisp->numinside++;
+    if (!thisp->pickprimitives) {
+      thisp->addPath(action);
+      return SoCallbackAction::PRUNE;
+    }
+    thisp->shapestate = INSIDE;
+    return SoCallbackAction::CONTINUE;
+  }
+
+  // skip the primitives if none of the triangles are inside
+  SoTriangleBVHCache * bvhcache = SoBoxPickActionP::getTriangleBVHCache(shape, action);
+  if (bvhcache) {
+    SbBool outside = FALSE;
+    const SbMatrix & matrix = action->getModelMatrix();
+    if (matrix.det4() != 0.0f) {
+      const SbMatrix inverse = matrix.inverse();
+      SbPlane planes[MAXPLANES];
+      for (int i = 0; i < thisp->numplanes; i++) {
+        planes[i] = thisp->planes[i];
+        planes[i].transform(inverse);
+      }
+      outside = !bvhcache->mayIntersect(planes, thisp->numplanes);
+    }
+    bvhcache->unref();
+    if (outside) {
+      thisp->numoutside++;
+      return SoCallbackAction::PRUNE;
+    }
+  }
+  thisp->numboundary++;
+  thisp->shapestate = BOUNDARY;
+  return SoCallbackAction::CONTINUE;
+}
+
+SoCallbackAction::Response
+SoBoxPickAction::PImpl::postShapeCB(void * closure, SoCallbackAction * action,
+                                    const SoNode * COIN_UNUSED_ARG(node))
+{
+  PImpl * thisp = static_cast<PImpl *>(closure);
+  if (thisp->shapestate != IDLE && thisp->shapehit) {
+    thisp->addPath(action);
+  }
+  thisp->shapestate = IDLE;
+  return SoCallbackAction::CONTINUE;
+}
+
+void
+SoBoxPickAction::PImpl::triangleCB(void * closure, SoCallbackAction * action,
+                                   const SoPrimitiveVertex * v1,
+                                   const SoPrimitiveVertex * v2,
+                                   const SoPrimitiveVertex * v3)
+{
+  const SoPrimitiveVertex * v[3] = { v1, v2, v3 };
+  static_cast<PImpl *>(closure)->addPrimitive(action, v, 3);
+}
+
+void
+SoBoxPickAction::PImpl::lineSegmentCB(void * closure, SoCallbackAction * action,
+                                      const SoPrimitiveVertex * v1,
+                                      const SoPrimitiveVertex * v2)
+{
+  const SoPrimitiveVertex * v[2] = { v1, v2 };
+  static_cast<PImpl *>(closure)->addPrimitive(action, v, 2);
+}
+
+void
+SoBoxPickAction::PImpl::pointCB(void * closure, SoCallbackAction * action,
+                                const SoPrimitiveVertex * v)
+{
+  static_cast<PImpl *>(closure)->addPrimitive(action, &v, 1);
+}
+
+// *************************************************************************
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+SO_ACTION_SOURCE(SoBoxPickAction);
+
+// Override from parent class.
+void
+SoBoxPickAction::initClass(void)
+{
+  SO_ACTION_INTERNAL_INIT_CLASS(SoBoxPickAction, SoAction);
+}
+
+/*!
+  Constructor. No volume is set, so nothing is picked until one of
+  setBox(), setViewVolume() or setPolygon() is called.
+*/
+SoBoxPickAction::SoBoxPickAction(void)
+{
+  SO_ACTION_CONSTRUCTOR(SoBoxPickAction);
+}
+
+/*!
+  Destructor.
+*/
+SoBoxPickAction::~SoBoxPickAction(void)
+{
+}
+
+/*!
+  Picks the shapes inside the world space \a box.
+*/
+void
+SoBoxPickAction::setBox(const SbBox3f & box)
+{
+  PRIVATE(this)->clearVolume();
+  if (box.isEmpty()) return;
+  const SbVec3f & min = box.getMin();
+  const SbVec3f & max = box.getMax();
+  for (int i = 0; i < 3; i++) {
+    SbVec3f n(0.0f, 0.0f, 0.0f);
+    n[i] = 1.0f;
+    PRIVATE(this)->planes[2 * i] = SbPlane(n, min[i]);
+    PRIVATE(this)->planes[2 * i + 1] = SbPlane(-n, -max[i]);
+  }
+  PRIVATE(this)->numplanes = 6;
+  PRIVATE(this)->empty = FALSE;
+}
+
+/*!
+  Picks the shapes inside the world space view volume \a vv.
+*/
+void
+SoBoxPickAction::setViewVolume(const SbViewVolume & vv)
+{
+  PRIVATE(this)->clearVolume();
+  PRIVATE(this)->setPlanes(vv);
+}
+
+/*!
+  Picks the shapes inside the polygon with the \a numpoints \a
+  points, in the normalized screen coordinates of the view volume \a
+  vv. The polygon may be concave, but convex polygons are faster to
+  pick with.
+*/
+void
+SoBoxPickAction::setPolygon(const SbViewVolume & vv, const SbVec2f * points, const int numpoints)
+{
+  PRIVATE(this)->clearVolume();
+  if (numpoints < 3) return;
+
+  SbBox2f rect;
+  int i;
+  for (i = 0; i < numpoints; i++) { rect.extendBy(points[i]); }
+  if (!rect.hasArea()) return;
+  const SbVec2f & min = rect.getMin();
+  const SbVec2f & max = rect.getMax();
+  PRIVATE(this)->setPlanes(vv.narrow(min[0], min[1], max[0], max[1]));
+  if (PRIVATE(this)->empty) return;
+  PRIVATE(this)->viewvolume = vv;
+  for (i = 0; i < numpoints; i++) { PRIVATE(this)->polygon.append(points[i]); }
+
+  if (!boxpick_is_convex(points, numpoints) ||
+      PRIVATE(this)->numplanes + numpoints > PImpl::MAXPLANES) {
+    PRIVATE(this)->concave = TRUE;
+    return;
+  }
+
+  // a plane through each edge and the eye
+  SbVec3f inside0, inside1;
+  vv.projectPointToLine(rect.getCenter(), inside0, inside1);
+  const SbVec3f inside = (inside0 + inside1) * 0.5f;
+  for (i = 0; i < numpoints; i++) {
+    const SbVec2f & a = points[i];
+    const SbVec2f & b = points[(i + 1) % numpoints];
+    if (a == b) continue;
+    SbVec3f a0, a1, b0, b1;
+    vv.projectPointToLine(a, a0, a1);
+    vv.projectPointToLine(b, b0, b1);
+    SbPlane plane(a0, a1, b0);
+    if (!plane.isInHalfSpace(inside)) {
+      plane = SbPlane(-plane.getNormal(), -plane.getDistanceFromOrigin());
+    }
+    PRIVATE(this)->planes[PRIVATE(this)->numplanes++] = plane;
+  }
+}
+
+/*!
+  Sets whether the primitives of the shapes inside the volume should
+  be found. The default is \c FALSE.
+
+  This makes the action slower, as the primitives of every shape in
+  the volume have to be generated.
+
+  \sa isPickPrimitives(), getPrimitive()
+*/
+void
+SoBoxPickAction::setPickPrimitives(const SbBool onoff)
+{
+  PRIVATE(this)->pickprimitives = onoff;
+}
+
+/*!
+  Returns whether the primitives of the shapes inside the volume are
+  found.
+
+  \sa setPickPrimitives()
+*/
+SbBool
+SoBoxPickAction::isPickPrimitives(void) const
+{
+  return PRIVATE(this)->pickprimitives;
+}
+
+/*!
+  Picks the shapes in the scene graph rooted at \a node.
+*/
+void
+SoBoxPickAction::apply(SoNode * node)
+{
+  PRIVATE(this)->clear();
+  if (PRIVATE(this)->empty) return;
+  PRIVATE(this)->traverse(node);
+  PRIVATE(this)->report();
+}
+
+/*!
+  Picks the shapes in the subgraph at the end of \a path.
+*/
+void
+SoBoxPickAction::apply(SoPath * path)
+{
+  PRIVATE(this)->clear();
+  if (PRIVATE(this)->empty) return;
+  PRIVATE(this)->traverse(path);
+  PRIVATE(this)->report();
+}
+
+/*!
+  Picks the shapes under the paths in \a paths.
+
+  The \a obeysRules argument is ignored, as each path is traversed by
+  itself.
+*/
+void
+SoBoxPickAction::apply(const SoPathList & paths, SbBool COIN_UNUSED_ARG(obeysRules))
+{
+  PRIVATE(this)->clear();
+  if (PRIVATE(this)->empty) return;
+  for (int i = 0; i < paths.getLength(); i++) {
+    PRIVATE(this)->traverse(paths[i]);
+  }
+  PRIVATE(this)->report();
+}
+
+/*!
+  Returns the paths to the shapes picked by the last apply(), in
+  traversal order. The list is valid until the action is applied
+  again or destructed.
+*/
+const SoPathList &
+SoBoxPickAction::getPaths(void) const
+{
+  return PRIVATE(this)->paths;
+}
+
+/*!
+  Returns the number of primitives found for the shape at the end of
+  path \a index of getPaths(). This is 0 unless primitives are
+  picked.
+
+  \sa setPickPrimitives()
+*/
+int
+SoBoxPickAction::getNumPrimitives(const int index) const
+{
+  assert(index >= 0 && index < PRIVATE(this)->paths.getLength());
+  const int end = (index + 1 < PRIVATE(this)->primstart.getLength()) ?
+    PRIVATE(this)->primstart[index + 1] : PRIVATE(this)->primitives.getLength();
+  return end - PRIVATE(this)->primstart[index];
+}
+
+/*!
+  Returns primitive number \a primitive of the shape at the end of
+  path \a index of getPaths(), in the order the shape generated them.
+  The primitive is valid until the action is applied again or
+  destructed.
+
+  \sa getNumPrimitives()
+*/
+const SoBoxPickPrimitive *
+SoBoxPickAction::getPrimitive(const int index, const int primitive) const
+{
+  assert(primitive >= 0 && primitive < this->getNumPrimitives(index));
+  return PRIVATE(this)->primitives.getArrayPtr() + PRIVATE(this)->primstart[index] + primitive;
+}
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbVec2f.h>
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/details/SoFaceDetail.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <set>
+
+// A scene with a 10x10 grid of unit quads in the z=-5 plane, from
+// (0, 0) to (10, 10), and unit cubes at (1, 7, -5) and (5, 7, -5).
+static SoSeparator *
+make_scene(void)
+{
+  SoSeparator * root = new SoSeparator;
+  SoTranslation * translation = new SoTranslation;
+  translation->translation.setValue(0.0f, 0.0f, -5.0f);
+  root->addChild(translation);
+
+  SoSeparator * grid = new SoSeparator;
+  SoCoordinate3 * coords = new SoCoordinate3;
+  SoIndexedFaceSet * faceset = new SoIndexedFaceSet;
+  int i, j, n = 0;
+  for (j = 0; j <= 10; j++) {
+    for (i = 0; i <= 10; i++) {
+      coords->point.set1Value(j * 11 + i, SbVec3f(float(i), float(j), 0.0f));
+    }
+  }
+  for (j = 0; j < 10; j++) {
+    for (i = 0; i < 10; i++) {
+      const int32_t quad[5] = { j * 11 + i, j * 11 + i + 1, (j + 1) * 11 + i + 1, (j + 1) * 11 + i, -1 };
+      faceset->coordIndex.setValues(n, 5, quad);
+      n += 5;
+    }
+  }
+  grid->addChild(coords);
+  grid->addChild(faceset);
+  root->addChild(grid);
+
+  for (i = 0; i < 2; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * t = new SoTranslation;
+    t->translation.setValue(i ? 5.0f : 1.0f, 7.0f, 0.0f);
+    sep->addChild(t);
+    sep->addChild(new SoCube);
+    root->addChild(sep);
+  }
+  return root;
+}
+
+// Returns the number of different faces picked from the shape at the
+// end of path index.
+static int
+count_faces(const SoBoxPickAction & pa, const int index)
+{
+  std::set<int> faces;
+  for (int i = 0; i < pa.getNumPrimitives(index); i++) {
+    const SoDetail * detail = pa.getPrimitive(index, i)->detail;
+    if (detail && detail->isOfType(SoFaceDetail::getClassTypeId())) {
+      faces.insert(static_cast<const SoFaceDetail *>(detail)->getFaceIndex());
+    }
+  }
+  return static_cast<int>(faces.size());
+}
+
+BOOST_AUTO_TEST_CASE(box)
+{
+  SoSeparator * root = make_scene();
+  root->ref();
+
+  SoBoxPickAction pa;
+  pa.apply(root);
+  BOOST_CHECK_EQUAL(pa.getPaths().getLength(), 0);
+
+  pa.setBox(SbBox3f(2.5f, 2.5f, -6.0f, 4.5f, 4.5f, -4.0f));
+  pa.setPickPrimitives(TRUE);
+  pa.apply(root);
+  BOOST_REQUIRE_EQUAL(pa.getPaths().getLength(), 1);
+  BOOST_CHECK(pa.getPaths()[0]->getTail()->isOfType(SoIndexedFaceSet::getClassTypeId()));
+  BOOST_CHECK_EQUAL(count_faces(pa, 0), 9);
+
+  pa.setBox(SbBox3f(0.0f, 6.0f, -6.0f, 6.0f, 8.0f, -4.0f));
+  pa.setPickPrimitives(FALSE);
+  pa.apply(root);
+  BOOST_CHECK_EQUAL(pa.getPaths().getLength(), 3);
+  BOOST_CHECK_EQUAL(pa.getNumPrimitives(0), 0);
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(viewVolume)
+{
+  SoSeparator * root = make_scene();
+  root->ref();
+
+  SbViewVolume vv;
+  vv.ortho(0.0f, 10.0f, 0.0f, 10.0f, 1.0f, 10.0f);
+
+  SoBoxPickAction pa;
+  pa.setPickPrimitives(TRUE);
+  pa.setViewVolume(vv.narrow(0.25f, 0.25f, 0.45f, 0.45f));
+  pa.apply(root);
+  BOOST_REQUIRE_EQUAL(pa.getPaths().getLength(), 1);
+  BOOST_CHECK_EQUAL(count_faces(pa, 0), 9);
+
+  // everything is inside
+  pa.setViewVolume(vv);
+  pa.apply(root);
+  BOOST_REQUIRE_EQUAL(pa.getPaths().getLength(), 3);
+  BOOST_CHECK_EQUAL(count_faces(pa, 0), 100);
+  BOOST_CHECK_EQUAL(pa.getNumPrimitives(1), 12);
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(polygon)
+{
+  SoSeparator * root = make_scene();
+  root->ref();
+
+  SbViewVolume vv;
+  vv.ortho(0.0f, 10.0f, 0.0f, 10.0f, 1.0f, 10.0f);
+
+  // a U, with the cube at (5, 7) in the gap
+  const SbVec2f u[8] = {
+    SbVec2f(0.05f, 0.05f), SbVec2f(0.95f, 0.05f), SbVec2f(0.95f, 0.95f),
+    SbVec2f(0.65f, 0.95f), SbVec2f(0.65f, 0.35f), SbVec2f(0.35f, 0.35f),
+    SbVec2f(0.35f, 0.95f), SbVec2f(0.05f, 0.95f)
+  };
+  SoBoxPickAction pa;
+  pa.setPickPrimitives(TRUE);
+  pa.setPolygon(vv, u, 8);
+  pa.apply(root);
+  BOOST_REQUIRE_EQUAL(pa.getPaths().getLength(), 2);
+  BOOST_CHECK_EQUAL(count_faces(pa, 0), 88);
+  BOOST_CHECK(pa.getPaths()[1]->getTail() ==
+              static_cast<SoGroup *>(root->getChild(2))->getChild(1));
+
+  // a triangle with the cube at (1, 7) and a corner of the grid
+  const SbVec2f triangle[3] = {
+    SbVec2f(0.0f, 0.45f), SbVec2f(0.2f, 0.85f), SbVec2f(0.0f, 0.85f)
+  };
+  pa.setPolygon(vv, triangle, 3);
+  pa.apply(root);
+  BOOST_CHECK_EQUAL(pa.getPaths().getLength(), 2);
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
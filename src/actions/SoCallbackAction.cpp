@@ -68,7 +68,7 @@
      const SbMatrix mm = action->getModelMatrix();
 
      SbVec3f vx[3];
-     for (int j=0; j < 3; j++) { mm.multVecMatrix(vtx[j], vx[j]); }
+     mm.multVecMatrix(vtx, vx, 3);
 
      // (This is sub-optimal -- should scan for the same vertex
      // coordinates already being present in the SoCoordinate3
@@ -116,6 +116,8 @@
 #include "glue/glp.h"
 #include "glue/simage_wrapper.h"
 #include "rendering/SoGL.h"
+#include "rendering/SoGLResourceManagerP.h"
+#include "rendering/SoGLTextureAtlas.h"
 
 #include <Inventor/annex/Profiler/nodes/SoProfilerStats.h>
 #include "profiler/SoProfilerP.h"
@@ -1756,6 +1758,11 @@ SoGLRenderActionP::render(SoNode * node)
     }
   }
 
+  // evict OpenGL resources if the memory budget is exceeded
+  SoGLResourceManagerP::endFrame(state);
+  // upload atlas pages with textures packed during this frame
+  SoGLTextureAtlas::endFrame();
+
   state->pop();
   this->isrendering = FALSE;
 }
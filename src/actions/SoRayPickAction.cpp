@@ -112,6 +112,12 @@
   \code
   SoNode * realroot = viewer->getSceneManager()->getSceneGraph();
   \endcode
+
+  Many rays can be picked at once with setRays() or
+  setNormalizedPoints(), in a single traversal of the scene graph,
+  and optionally in several threads (see setNumThreads()). This is
+  much faster than applying the action for each ray, e.g. when
+  sampling the scene in a grid of pixels.
 */
 // FIXME: in the class doc, also mention how one can use
 // SoRayPickAction from within an SoHandleEventAction callback with
@@ -120,9 +126,15 @@
 
 #include <Inventor/actions/SoRayPickAction.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
 #include <cfloat>
+#include <cstdlib>
 
 #include <Inventor/SbLine.h>
+#include <Inventor/SoFullPath.h>
 #include <Inventor/SoPickedPoint.h>
 #include <Inventor/elements/SoClipPlaneElement.h>
 #include <Inventor/elements/SoModelMatrixElement.h>
@@ -146,6 +158,12 @@
 #include <Inventor/SbDPLine.h>
 #include <Inventor/SbDPPlane.h>
 #include <Inventor/SbDPMatrix.h>
+#include <Inventor/C/tidbits.h>
+#include <Inventor/C/threads/wpool.h>
+#include <Inventor/lists/SoActionMethodList.h>
+#ifdef HAVE_VRML97
+#include <Inventor/VRMLnodes/SoVRMLGroup.h>
+#endif // HAVE_VRML97
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
 #endif // COIN_DEBUG
@@ -160,7 +178,46 @@
 
 class SoRayPickActionP {
 public:
-  SoRayPickActionP(void) : owner(NULL) { }
+  SoRayPickActionP(void);
+  ~SoRayPickActionP();
+
+  // The ray and the picked points for it. An action has one of these
+  // for each ray set with setRays() or setNormalizedPoints(), or just
+  // one, and "ray" is the one which is currently picked.
+  class Ray {
+  public:
+    Ray(void) : lightpath(NULL), flags(0), osid(0) { }
+    ~Ray() { if (this->lightpath) this->lightpath->unref(); }
+
+    SbViewVolume osvolume;
+    SbViewVolume wsvolume;
+    SbLine osline_sp;
+
+    // use double precision types to increase picking precision
+    SbDPLine osline;
+    SbDPPlane nearplane;
+    SbVec2s vppoint;
+    SbVec2f normvppoint;
+    SbVec3d raystart;
+    SbVec3d raydirection;
+    double rayradiusstart;
+    double rayradiusdelta;
+    double raynear;
+    double rayfar;
+
+    SbDPLine wsline;
+
+    SoPickedPointList pickedpointlist;
+    SbList <double> ppdistance;
+
+    // the closest hit in lightweight mode
+    SoPath * lightpath;
+    double lightdistance;
+    SbVec3f lightobjectpoint;
+
+    unsigned int flags; // the RAY_FLAGS of this ray
+    uint32_t osid; // the object space osline was calculated in
+  };
 
   // Hidden private methods.
 
@@ -171,35 +228,52 @@ public:
   void clearFlag(const unsigned int flag);
   SbBool isFlagSet(const unsigned int flag) const;
   void calcObjectSpaceData(SoState * ownerstate);
-  void calcMatrices(SoState * ownerstate);
+  void calcRayObjectSpace(void);
+  SbBool calcMatrices(SoState * ownerstate);
   void setPickStyleFlags(SoState * ownerstate);
+  void setLightweightHit(const SoPath * path, const double distance,
+                         const SbVec3f & objectspacepoint);
+  void computeLightweightPickedPoint(Ray * r);
+
+  void setNumRays(const int numrays);
+  void setRay(const SbVec3f & start, const SbVec3f & direction,
+              float neardistance, float fardistance);
+  void computeWorldSpaceRay(SoState * state);
+  void useRay(Ray * ray);
+  void pushRayPacket(const int * indices, const int num);
+  void popRayPacket(void);
+  SbBool cullRayPacket(const SbBox3f & box, const SbBool usefullviewvolume);
+  SoActionMethodList * getBatchMethods(void);
+  void applyParallel(void);
+
+  static void batchGroupS(SoAction * action, SoNode * node);
+  static void batchShapeS(SoAction * action, SoNode * node);
 
   // Hidden private variables.
 
-  SbViewVolume osvolume;
-  SbViewVolume wsvolume;
-  SbLine osline_sp;
-
-  // use double precision types to increase picking precision
-  SbDPLine osline;
-  SbDPPlane nearplane;
-  SbVec2s vppoint;
-  SbVec2f normvppoint;
-  SbVec3d raystart;
-  SbVec3d raydirection;
-  double rayradiusstart;
-  double rayradiusdelta;
-  double raynear;
-  double rayfar;
+  SbList <Ray *> rays;
+  Ray * ray;
+  SbBool ownsrays; // FALSE for the actions of applyParallel()
+
+  // The packet of rays which are picked in the current subgraph of a
+  // batched pick, as the indices of the rays. The packet is
+  // packet[packetstart] to the end of the list, and packetstack has
+  // the start of the enclosing packets.
+  SbList <int> packet;
+  int packetstart;
+  SbList <int> packetstack;
+  SbBool packetpending; // can the shape take the whole packet?
+  SbBool inpacket; // is the shape picking the whole packet?
+  const SoNode * cullnode; // the group to cull the packet against
+  SoActionMethodList * batchmethods;
+  int numthreads;
+
   float radiusinpixels;
 
-  SbDPLine wsline;
   SbDPMatrix obj2world;
   SbDPMatrix world2obj;
   SbDPMatrix extramatrix;
-
-  SoPickedPointList pickedpointlist;
-  SbList <double> ppdistance;
+  uint32_t osid; // changes with each object space
 
   unsigned int flags;
   SbBool objectspacevalid; // FIXME: why not a flag?
@@ -215,7 +289,13 @@ public:
     PPLIST_IS_SORTED =   0x0080, // did we sort pickedpointslist ?
     OSVOLUME_DIRTY =     0x0100, // did we calculate osvolume?
     PUSH_PICK_TO_FRONT = 0x0200, // should pick go in front?
-    CULL_BACKFACES =     0x0400  // should backface picks be ignored?
+    CULL_BACKFACES =     0x0400, // should backface picks be ignored?
+    LIGHTWEIGHT =        0x0800, // just keep path and point of closest hit
+    LIGHT_PP_COMPUTED =  0x1000, // did we make a picked point for it?
+
+    // the flags which are kept for each ray
+    RAY_FLAGS = WS_RAY_SET | WS_RAY_COMPUTED | NORM_POINT | CLIP_NEAR | CLIP_FAR |
+                PPLIST_IS_SORTED | OSVOLUME_DIRTY | LIGHT_PP_COMPUTED
   };
 
   SoRayPickAction * owner;
@@ -279,7 +359,8 @@ SoRayPickAction::~SoRayPickAction(void)
 void
 SoRayPickAction::setPoint(const SbVec2s & viewportpoint)
 {
-  PRIVATE(this)->vppoint = viewportpoint;
+  PRIVATE(this)->setNumRays(1);
+  PRIVATE(this)->ray->vppoint = viewportpoint;
   PRIVATE(this)->clearFlag(SoRayPickActionP::NORM_POINT |
                            SoRayPickActionP::WS_RAY_SET |
                            SoRayPickActionP::WS_RAY_COMPUTED);
@@ -296,7 +377,8 @@ SoRayPickAction::setPoint(const SbVec2s & viewportpoint)
 void
 SoRayPickAction::setNormalizedPoint(const SbVec2f & normpoint)
 {
-  PRIVATE(this)->normvppoint = normpoint;
+  PRIVATE(this)->setNumRays(1);
+  PRIVATE(this)->ray->normvppoint = normpoint;
   PRIVATE(this)->clearFlag(SoRayPickActionP::WS_RAY_SET |
                            SoRayPickActionP::WS_RAY_COMPUTED);
   PRIVATE(this)->setFlag(SoRayPickActionP::NORM_POINT |
@@ -329,55 +411,118 @@ void
 SoRayPickAction::setRay(const SbVec3f & start, const SbVec3f & direction,
                         float neardistance, float fardistance)
 {
-#if COIN_DEBUG
-  if (direction == SbVec3f(0.0f, 0.0f, 0.0f)) {
-    SoDebugError::postWarning("SoRayPickAction::setRay",
-                              "Ray has no direction");
+  PRIVATE(this)->setNumRays(1);
+  PRIVATE(this)->setRay(start, direction, neardistance, fardistance);
+}
 
+/*!
+  Sets a batch of \a numrays rays in world space, from \a starts[i]
+  in \a directions[i], all with the same near and far distances as
+  for setRay().
+
+  The rays are picked in a single traversal of the scene graph, which
+  is much faster than applying the action once for each ray when
+  there are many of them, like when sampling a grid of pixels. The
+  rays are tested as a packet against the bounding boxes of
+  separators, so subgraphs are skipped as soon as no ray of the
+  packet can hit them. Shapes which use the default
+  SoShape::rayPick() generate their primitives once, and test each of
+  them against all the rays of the packet which hit the bounding box
+  of the shape.
+
+  The picked points of each ray are returned by
+  getPickedPointList(const int) and, in lightweight mode, by
+  getPickedPath(), getPickedDistance() and getPickedObjectPoint().
+
+  Calling setRay(), setPoint() or setNormalizedPoint() goes back to
+  picking with a single ray.
+
+  \sa setNormalizedPoints(), setNumThreads()
+  \since Coin 4.0
+*/
+void
+SoRayPickAction::setRays(const SbVec3f * starts, const SbVec3f * directions,
+                         const int numrays, float neardistance, float fardistance)
+{
+  assert(numrays > 0);
+  PRIVATE(this)->setNumRays(numrays);
+  for (int i = 0; i < numrays; i++) {
+    PRIVATE(this)->useRay(PRIVATE(this)->rays[i]);
+    PRIVATE(this)->setRay(starts[i], directions[i], neardistance, fardistance);
   }
-#endif // COIN_DEBUG
-  if (neardistance >= 0.0f) PRIVATE(this)->setFlag(SoRayPickActionP::CLIP_NEAR);
-  else {
-    PRIVATE(this)->clearFlag(SoRayPickActionP::CLIP_NEAR);
-    neardistance = 1.0f;
-    // make sure neardistance is smaller than fardistance
-    if (fardistance > 0.0f && neardistance >= fardistance) {
-      neardistance = fardistance * 0.01f;
-    }
-  }
+  PRIVATE(this)->useRay(PRIVATE(this)->rays[0]);
+}
 
-  if (fardistance >= 0.0f) PRIVATE(this)->setFlag(SoRayPickActionP::CLIP_FAR);
-  else {
-    PRIVATE(this)->clearFlag(SoRayPickActionP::CLIP_FAR);
-    // just set to some value bigger than neardistance.
-    fardistance = neardistance + 10.0f;
+/*!
+  Sets a batch of \a numpoints normalized viewport points, like
+  setNormalizedPoint() does for one point, with a ray for each of
+  them through the view volume of the camera in the scene graph.
+
+  \sa setRays()
+  \since Coin 4.0
+*/
+void
+SoRayPickAction::setNormalizedPoints(const SbVec2f * normpoints, const int numpoints)
+{
+  assert(numpoints > 0);
+  PRIVATE(this)->setNumRays(numpoints);
+  for (int i = 0; i < numpoints; i++) {
+    PRIVATE(this)->useRay(PRIVATE(this)->rays[i]);
+    PRIVATE(this)->ray->normvppoint = normpoints[i];
+    PRIVATE(this)->clearFlag(SoRayPickActionP::WS_RAY_SET |
+                             SoRayPickActionP::WS_RAY_COMPUTED);
+    PRIVATE(this)->setFlag(SoRayPickActionP::NORM_POINT |
+                           SoRayPickActionP::CLIP_NEAR |
+                           SoRayPickActionP::CLIP_FAR);
   }
+  PRIVATE(this)->useRay(PRIVATE(this)->rays[0]);
+}
 
-  // set these to some values. They will be set to better values
-  // in computeWorldSpaceRay() (when we know the view volume).
-  PRIVATE(this)->rayradiusstart = 0.01;
-  PRIVATE(this)->rayradiusdelta = 0.0;
+/*!
+  Returns the number of rays, which is 1 unless a batch of rays was
+  set with setRays() or setNormalizedPoints().
+
+  \since Coin 4.0
+*/
+int
+SoRayPickAction::getNumRays(void) const
+{
+  return PRIVATE(this)->rays.getLength();
+}
 
-  PRIVATE(this)->raystart.setValue(start);
-  PRIVATE(this)->raydirection.setValue(direction);
-  (void) PRIVATE(this)->raydirection.normalize();
-  PRIVATE(this)->raynear = neardistance;
-  PRIVATE(this)->rayfar = fardistance;
-  PRIVATE(this)->wsline = SbDPLine(PRIVATE(this)->raystart,
-                                   PRIVATE(this)->raystart + PRIVATE(this)->raydirection);
+/*!
+  Sets the number of threads a batch of rays is picked in.
 
-  // D = shortest distance from origin to plane
-  const double D = PRIVATE(this)->raydirection.dot(PRIVATE(this)->raystart);
-  PRIVATE(this)->nearplane = SbDPPlane(PRIVATE(this)->raydirection, D + PRIVATE(this)->raynear);
+  With more than one thread, the rays are divided into consecutive
+  ranges, and each range is picked in its own thread, by its own
+  traversal of the scene graph. The scene graph must not be changed
+  while the action is applied.
 
-  PRIVATE(this)->setFlag(SoRayPickActionP::WS_RAY_SET);
+  The default is 1, which can be changed with the environment
+  variable COIN_RAYPICK_THREADS. If Coin was built without thread
+  safety, the ranges are picked one after the other, with the same
+  results.
 
-  // We use a real cone for picking, but keep pick view volume in sync to be
-  // compatible with OIV
-  PRIVATE(this)->wsvolume.perspective(0.0, 1.0, neardistance, fardistance);
-  PRIVATE(this)->wsvolume.translateCamera(start);
-  PRIVATE(this)->wsvolume.rotateCamera(SbRotation(SbVec3f(0.0f, 0.0f, -1.0f), direction));
-  PRIVATE(this)->setFlag(SoRayPickActionP::OSVOLUME_DIRTY);
+  \sa setRays(), getNumThreads()
+  \since Coin 4.0
+*/
+void
+SoRayPickAction::setNumThreads(const int num)
+{
+  assert(num > 0);
+  PRIVATE(this)->numthreads = num;
+}
+
+/*!
+  Returns the number of threads a batch of rays is picked in.
+
+  \sa setNumThreads()
+  \since Coin 4.0
+*/
+int
+SoRayPickAction::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
 }
 
 /*!
@@ -408,14 +553,40 @@ SoRayPickAction::isPickAll(void) const
 
 /*!
   Returns a list of the picked points.
+
+  After a batched pick, this is the list for the first ray.
+
+  \sa setRays()
 */
 const SoPickedPointList &
 SoRayPickAction::getPickedPointList(void) const
 {
-  int n = PRIVATE(this)->pickedpointlist.getLength();
-  if (!PRIVATE(this)->isFlagSet(SoRayPickActionP::PPLIST_IS_SORTED) && n > 1) {
-    SoPickedPoint ** pparray = reinterpret_cast<SoPickedPoint **>(PRIVATE(this)->pickedpointlist.getArrayPtr());
-    double * darray = const_cast<double*>(PRIVATE(this)->ppdistance.getArrayPtr());
+  return this->getPickedPointList(0);
+}
+
+/*!
+  Returns the list of the points picked by ray number \a ray of a
+  batched pick.
+
+  \sa setRays(), setNormalizedPoints()
+  \since Coin 4.0
+*/
+const SoPickedPointList &
+SoRayPickAction::getPickedPointList(const int ray) const
+{
+  assert(ray >= 0 && ray < PRIVATE(this)->rays.getLength());
+  SoRayPickActionP * thisp =
+    const_cast<SoRayPickActionP *>(&PRIVATE(this).get());
+  SoRayPickActionP::Ray * r = thisp->rays[ray];
+
+  if (r->lightpath && !(r->flags & SoRayPickActionP::LIGHT_PP_COMPUTED)) {
+    thisp->computeLightweightPickedPoint(r);
+  }
+
+  int n = r->pickedpointlist.getLength();
+  if (!(r->flags & SoRayPickActionP::PPLIST_IS_SORTED) && n > 1) {
+    SoPickedPoint ** pparray = reinterpret_cast<SoPickedPoint **>(r->pickedpointlist.getArrayPtr());
+    double * darray = const_cast<double*>(r->ppdistance.getArrayPtr());
 
     int i, j, distance;
     SoPickedPoint * pptmp;
@@ -437,12 +608,10 @@ SoRayPickAction::getPickedPointList(void) const
         pparray[j] = pptmp;
       }
     }
-    SoRayPickActionP * thisp =
-      const_cast<SoRayPickActionP *>(&PRIVATE(this).get());
-    thisp->setFlag(SoRayPickActionP::PPLIST_IS_SORTED);
+    r->flags |= SoRayPickActionP::PPLIST_IS_SORTED;
   }
 
-  return PRIVATE(this)->pickedpointlist;
+  return r->pickedpointlist;
 }
 
 /*!
@@ -455,92 +624,116 @@ SoPickedPoint *
 SoRayPickAction::getPickedPoint(const int index) const
 {
   assert(index >= 0);
-  if (index < PRIVATE(this)->pickedpointlist.getLength()) {
-    return this->getPickedPointList()[index];
+  const SoPickedPointList & list = this->getPickedPointList();
+  if (index < list.getLength()) {
+    return list[index];
   }
   return NULL;
 }
 
 /*!
-  \COININTERNAL
- */
+  Lets you decide whether only the path and point of the closest
+  intersection should be found. This is for when picking has to be
+  fast, like for highlighting the object under the mouse cursor as
+  it moves.
+
+  When set, no SoPickedPoint is made during the traversal, and so no
+  details, normals or texture coordinates are calculated for the
+  intersections found. The closest intersection is returned by
+  getPickedPath(), getPickedDistance() and getPickedObjectPoint().
+  If getPickedPoint() or getPickedPointList() is called, the full
+  picked point for the closest intersection is made, by picking the
+  shape at the end of the picked path again.
+
+  Subgraphs with bounding boxes behind the closest intersection found
+  so far are skipped. This means shapes with the SHAPE_ON_TOP or
+  BOUNDING_BOX_ON_TOP pick styles are only found when they are in
+  front of other shapes.
+
+  The "pick all" flag is ignored when this is set, and shapes which
+  call addIntersection() get \c NULL back.
+
+  Default value of the flag is \c FALSE.
+
+  \since Coin 4.0
+*/
 void
-SoRayPickAction::computeWorldSpaceRay(void)
+SoRayPickAction::setLightweightPick(const SbBool flag)
 {
-  if (PRIVATE(this)->isFlagSet(SoRayPickActionP::WS_RAY_SET)) {
-    // set the ray radius to some very small value, since
-    // the user set the ray manually using setRay().
-    //
-    // FIXME: Wouldn't it be a nice new feature to be able to
-    // set the radius of the ray in setRay()? pederb, 2001-01-05
-    const SbViewVolume & vv = SoViewVolumeElement::get(this->state);
-    PRIVATE(this)->rayradiusstart = SbMin(vv.getWidth(), vv.getHeight()) * FLT_EPSILON;
-    PRIVATE(this)->rayradiusdelta = 0.0f;
-  }
-  else {
-    const SbViewVolume & vv = SoViewVolumeElement::get(this->state);
-    const SbViewportRegion & vp = SoViewportRegionElement::get(this->state);
+  if (flag) PRIVATE(this)->setFlag(SoRayPickActionP::LIGHTWEIGHT);
+  else PRIVATE(this)->clearFlag(SoRayPickActionP::LIGHTWEIGHT);
+}
 
-    if (!PRIVATE(this)->isFlagSet(SoRayPickActionP::NORM_POINT)) {
-      SbVec2s pt = PRIVATE(this)->vppoint - vp.getViewportOriginPixels();
-      SbVec2s size = vp.getViewportSizePixels();
-      PRIVATE(this)->normvppoint.setValue(float(pt[0]) / float(size[0]),
-                                 float(pt[1]) / float(size[1]));
-    }
+/*!
+  Returns whether only the path and point of the closest
+  intersection are found.
 
-#if COIN_DEBUG
-    if (vv.getDepth() == 0.0f || vv.getWidth() == 0.0f || vv.getHeight() == 0.0f) {
-      SoDebugError::postWarning("SoRayPickAction::computeWorldSpaceRay",
-                                "invalid frustum: <%f, %f, %f>",
-                                vv.getWidth(), vv.getHeight(), vv.getDepth());
-      return;
-    }
-#endif // COIN_DEBUG
+  \sa setLightweightPick()
+  \since Coin 4.0
+*/
+SbBool
+SoRayPickAction::isLightweightPick(void) const
+{
+  return PRIVATE(this)->isFlagSet(SoRayPickActionP::LIGHTWEIGHT);
+}
 
-    SbDPLine templine;
-    SbVec2d tmppt;
-    tmppt.setValue(PRIVATE(this)->normvppoint);
-    vv.getDPViewVolume().projectPointToLine(tmppt, templine);
-    PRIVATE(this)->raystart = templine.getPosition();
-    PRIVATE(this)->raydirection = templine.getDirection();
+/*!
+  Returns the path to the shape with the closest intersection of ray
+  number \a ray, or \c NULL if nothing was picked. Only set in
+  lightweight mode.
 
-    PRIVATE(this)->raynear = 0.0;
-    PRIVATE(this)->rayfar = vv.getDPViewVolume().getDepth();
+  \sa setLightweightPick(), setRays()
+  \since Coin 4.0
+*/
+const SoPath *
+SoRayPickAction::getPickedPath(const int ray) const
+{
+  assert(ray >= 0 && ray < PRIVATE(this)->rays.getLength());
+  return PRIVATE(this)->rays[ray]->lightpath;
+}
 
-    SbVec2s vpsize = vp.getViewportSizePixels();
-    PRIVATE(this)->rayradiusstart = (double(vv.getHeight()) / double(vpsize[1]))*
-      double(PRIVATE(this)->radiusinpixels);
-    PRIVATE(this)->rayradiusdelta = 0.0;
-    if (vv.getProjectionType() == SbViewVolume::PERSPECTIVE) {
-      SbVec3d dir(0.0f, vv.getHeight()*0.5f, vv.getNearDist());
-      // no need to test here, we know vv isn't empty
-      (void) dir.normalize();
-      SbVec3d upperfar = dir * (vv.getNearDist()+vv.getDepth()) /
-        dir.dot(SbVec3d(0.0f, 0.0f, 1.0f));
+/*!
+  Returns the distance from the near plane of the ray to the closest
+  intersection, measured along the projection direction, as for
+  sorting the picked point list. Only set in lightweight mode.
 
-      double farheight = double(upperfar[1])*2.0;
-      double farsize = (farheight / double(vpsize[1])) * double(PRIVATE(this)->radiusinpixels);
-      PRIVATE(this)->rayradiusdelta = (farsize - PRIVATE(this)->rayradiusstart) / double(vv.getDepth());
-    }
-    PRIVATE(this)->wsline = SbDPLine(PRIVATE(this)->raystart,
-                                     PRIVATE(this)->raystart + PRIVATE(this)->raydirection);
+  \sa setLightweightPick()
+  \since Coin 4.0
+*/
+float
+SoRayPickAction::getPickedDistance(const int ray) const
+{
+  assert(this->getPickedPath(ray) && "nothing picked");
+  return static_cast<float>(PRIVATE(this)->rays[ray]->lightdistance);
+}
 
-    PRIVATE(this)->nearplane = SbDPPlane(vv.getDPViewVolume().getProjectionDirection(),
-					 PRIVATE(this)->raystart);
-    PRIVATE(this)->setFlag(SoRayPickActionP::WS_RAY_COMPUTED);
+/*!
+  Returns the closest intersection, in the object space of the shape
+  at the end of getPickedPath(). Only set in lightweight mode.
 
-    // we pick on a real cone, but keep pick view volume in sync to be
-    // compatible with OIV.
-    double normradius = double(PRIVATE(this)->radiusinpixels) /
-      double(SbMin(vp.getViewportSizePixels()[0], vp.getViewportSizePixels()[1]));
+  \sa setLightweightPick()
+  \since Coin 4.0
+*/
+const SbVec3f &
+SoRayPickAction::getPickedObjectPoint(const int ray) const
+{
+  assert(this->getPickedPath(ray) && "nothing picked");
+  return PRIVATE(this)->rays[ray]->lightobjectpoint;
+}
 
-    PRIVATE(this)->wsvolume = vv.narrow(float(PRIVATE(this)->normvppoint[0] - normradius),
-                                        float(PRIVATE(this)->normvppoint[1] - normradius),
-                                        float(PRIVATE(this)->normvppoint[0] + normradius),
-                                        float(PRIVATE(this)->normvppoint[1] + normradius));
-    SoPickRayElement::set(state, PRIVATE(this)->wsvolume);
-    PRIVATE(this)->setFlag(SoRayPickActionP::OSVOLUME_DIRTY);
+/*!
+  \COININTERNAL
+ */
+void
+SoRayPickAction::computeWorldSpaceRay(void)
+{
+  // in batched picks, all the rays are set up by the camera
+  SoRayPickActionP::Ray * current = PRIVATE(this)->ray;
+  for (int i = 0; i < PRIVATE(this)->rays.getLength(); i++) {
+    PRIVATE(this)->useRay(PRIVATE(this)->rays[i]);
+    PRIVATE(this)->computeWorldSpaceRay(this->state);
   }
+  PRIVATE(this)->useRay(current);
 }
 
 /*!
@@ -596,8 +789,8 @@ SoRayPickAction::intersect(const SbVec3f & v0_in,
   v1.setValue(v1_in);
   v2.setValue(v2_in);
 
-  const SbVec3d & orig = PRIVATE(this)->osline.getPosition();
-  const SbVec3d & dir = PRIVATE(this)->osline.getDirection();
+  const SbVec3d & orig = PRIVATE(this)->ray->osline.getPosition();
+  const SbVec3d & dir = PRIVATE(this)->ray->osline.getDirection();
 
   SbVec3d edge1 = v1 - v0;
   SbVec3d edge2 = v2 - v0;
@@ -679,7 +872,7 @@ SoRayPickAction::intersect(const SbVec3f & v0_in, const SbVec3f & v1_in,
   SbVec3d op0, op1; // object space
   SbVec3d p0, p1; // world space
 
-  if (!PRIVATE(this)->osline.getClosestPoints(line, op0, op1)) return FALSE;
+  if (!PRIVATE(this)->ray->osline.getClosestPoints(line, op0, op1)) return FALSE;
 
   // clamp op1 between v0 and v1
   if ((op1-v0).dot(line.getDirection()) < 0.0) op1 = v0;
@@ -691,10 +884,10 @@ SoRayPickAction::intersect(const SbVec3f & v0_in, const SbVec3f & v1_in,
   // distance between points
   double distance = (p1-p0).length();
 
-  double raypos = PRIVATE(this)->nearplane.getDistance(p0);
+  double raypos = PRIVATE(this)->ray->nearplane.getDistance(p0);
 
-  double radius = static_cast<float>((PRIVATE(this)->rayradiusstart +
-                           PRIVATE(this)->rayradiusdelta * raypos));
+  double radius = static_cast<float>((PRIVATE(this)->ray->rayradiusstart +
+                           PRIVATE(this)->ray->rayradiusdelta * raypos));
 
   if (radius >= distance) {
     intersection.setValue(op1);
@@ -720,15 +913,15 @@ SoRayPickAction::intersect(const SbVec3f & point_in) const
 
   SbVec3d wpoint;
   PRIVATE(this)->obj2world.multVecMatrix(point, wpoint);
-  SbVec3d ptonline = PRIVATE(this)->wsline.getClosestPoint(wpoint);
+  SbVec3d ptonline = PRIVATE(this)->ray->wsline.getClosestPoint(wpoint);
 
   // distance between points
   double distance = (wpoint-ptonline).length();
 
-  double raypos = PRIVATE(this)->nearplane.getDistance(ptonline);
+  double raypos = PRIVATE(this)->ray->nearplane.getDistance(ptonline);
 
-  double radius = static_cast<double>((PRIVATE(this)->rayradiusstart +
-                            PRIVATE(this)->rayradiusdelta * raypos));
+  double radius = static_cast<double>((PRIVATE(this)->ray->rayradiusstart +
+                            PRIVATE(this)->ray->rayradiusdelta * raypos));
 
   return (radius >= distance);
 }
@@ -808,7 +1001,16 @@ SoRayPickAction::intersect(const SbBox3f & box, SbVec3f & intersection,
   // intersection point, so we just return FALSE.
   if (!PRIVATE(this)->objectspacevalid) return FALSE;
 
-  const SbDPLine & line = PRIVATE(this)->osline;
+  // in batched picks, the bounding box of a separator is tested
+  // against all the rays in the packet
+  if (PRIVATE(this)->cullnode &&
+      PRIVATE(this)->cullnode == this->getCurPathTail() &&
+      !PRIVATE(this)->inpacket) {
+    PRIVATE(this)->cullnode = NULL;
+    return PRIVATE(this)->cullRayPacket(box, usefullviewvolume);
+  }
+
+  const SbDPLine & line = PRIVATE(this)->ray->osline;
   SbVec3d bounds[2];
   bounds[0].setValue(box.getMin());
   bounds[1].setValue(box.getMax());
@@ -820,24 +1022,32 @@ SoRayPickAction::intersect(const SbBox3f & box, SbVec3f & intersection,
 
   int i;
 
-  if (PRIVATE(this)->isFlagSet(SoRayPickActionP::CLIP_NEAR|SoRayPickActionP::CLIP_FAR)) {
+  // in lightweight mode, boxes behind the closest intersection so far
+  // can't have a closer one
+  const SbBool behindhit = PRIVATE(this)->ray->lightpath != NULL;
+
+  if (PRIVATE(this)->isFlagSet(SoRayPickActionP::CLIP_NEAR|SoRayPickActionP::CLIP_FAR) ||
+      behindhit) {
     // check if all points are in front of the near or behind the far
     // clipping plane
     int numnear = 0;
     int numfar = 0;
+    double fardist = DBL_MAX;
+    if (PRIVATE(this)->isFlagSet(SoRayPickActionP::CLIP_FAR)) {
+      fardist = PRIVATE(this)->ray->rayfar - PRIVATE(this)->ray->raynear;
+    }
+    if (behindhit) fardist = SbMin(fardist, PRIVATE(this)->ray->lightdistance);
 
     for (i = 0; i < 8; i++) {
       SbVec3d bp(i&1 ? bounds[0][0] : bounds[1][0],
                  i&2 ? bounds[0][1] : bounds[1][1],
                  i&4 ? bounds[0][2] : bounds[1][2]);
       PRIVATE(this)->obj2world.multVecMatrix(bp, bp);
-      double dist = PRIVATE(this)->nearplane.getDistance(bp);
+      double dist = PRIVATE(this)->ray->nearplane.getDistance(bp);
       if (PRIVATE(this)->isFlagSet(SoRayPickActionP::CLIP_NEAR)) {
         if (dist < 0.0) numnear++;
       }
-      if (PRIVATE(this)->isFlagSet(SoRayPickActionP::CLIP_FAR)) {
-        if (dist > (PRIVATE(this)->rayfar - PRIVATE(this)->raynear)) numfar++;
-      }
+      if (dist > fardist) numfar++;
       if ((numnear < i) && (numfar < i)) break;
     }
     if (numnear == 8 || numfar == 8) return FALSE;
@@ -879,12 +1089,12 @@ SoRayPickAction::intersect(const SbBox3f & box, SbVec3f & intersection,
     PRIVATE(this)->obj2world.multVecMatrix(ptonbox, wptonbox);
     PRIVATE(this)->obj2world.multVecMatrix(ptonray, wptonray);
 
-    double raypos = PRIVATE(this)->nearplane.getDistance(wptonray);
+    double raypos = PRIVATE(this)->ray->nearplane.getDistance(wptonray);
     double distance = (wptonray-wptonbox).length();
 
     // find ray radius at wptonray
-    double radius = static_cast<float>((PRIVATE(this)->rayradiusstart +
-                             PRIVATE(this)->rayradiusdelta * raypos));
+    double radius = static_cast<float>((PRIVATE(this)->ray->rayradiusstart +
+                             PRIVATE(this)->ray->rayradiusdelta * raypos));
 
     // test for cone intersection
     if (radius >= distance) {
@@ -915,8 +1125,10 @@ SoRayPickAction::getViewVolume(void)
   if (PRIVATE(this)->objectspacevalid &&
       PRIVATE(this)->isFlagSet(SoRayPickActionP::OSVOLUME_DIRTY)) {
     // we pick on a real cone, but calculate pick view volume
-    // to be compatible with OIV.
-    PRIVATE(this)->osvolume = SoPickRayElement::get(this->getState());
+    // to be compatible with OIV. The element only holds the view
+    // volume of one ray of a batched pick.
+    PRIVATE(this)->ray->osvolume = PRIVATE(this)->rays.getLength() > 1 ?
+      PRIVATE(this)->ray->wsvolume : SoPickRayElement::get(this->getState());
     if (PRIVATE(this)->isFlagSet(SoRayPickActionP::EXTRA_MATRIX)) {
       SbDPMatrix m = PRIVATE(this)->world2obj * PRIVATE(this)->extramatrix;
       SbMatrix tmp(
@@ -933,7 +1145,7 @@ SoRayPickAction::getViewVolume(void)
                  static_cast<float>(m[3][2]), static_cast<float>(m[3][3])
                  );
 
-      PRIVATE(this)->osvolume.transform(tmp);
+      PRIVATE(this)->ray->osvolume.transform(tmp);
     }
     else {
       const SbDPMatrix & m = PRIVATE(this)->world2obj;
@@ -952,11 +1164,11 @@ SoRayPickAction::getViewVolume(void)
                  );
 
 
-      PRIVATE(this)->osvolume.transform(tmp);
+      PRIVATE(this)->ray->osvolume.transform(tmp);
     }
     PRIVATE(this)->clearFlag(SoRayPickActionP::OSVOLUME_DIRTY);
   }
-  return PRIVATE(this)->osvolume;
+  return PRIVATE(this)->ray->osvolume;
 }
 
 /*!
@@ -965,7 +1177,7 @@ SoRayPickAction::getViewVolume(void)
 const SbLine &
 SoRayPickAction::getLine(void)
 {
-  return PRIVATE(this)->osline_sp;
+  return PRIVATE(this)->ray->osline_sp;
 }
 
 /*!
@@ -996,21 +1208,28 @@ SoRayPickAction::addIntersection(const SbVec3f & objectspacepoint_in, SbBool fro
   SbVec3d worldpoint;
   PRIVATE(this)->obj2world.multVecMatrix(objectspacepoint, worldpoint);
   double dist = PRIVATE(this)->isFlagSet(SoRayPickActionP::PUSH_PICK_TO_FRONT) ?
-    0.0 : PRIVATE(this)->nearplane.getDistance(worldpoint);
+    0.0 : PRIVATE(this)->ray->nearplane.getDistance(worldpoint);
+
+  if (PRIVATE(this)->isFlagSet(SoRayPickActionP::LIGHTWEIGHT)) {
+    if (!PRIVATE(this)->ray->lightpath || dist < PRIVATE(this)->ray->lightdistance) {
+      PRIVATE(this)->setLightweightHit(this->getCurPath(), dist, objectspacepoint_in);
+    }
+    return NULL;
+  }
 
-  if (!PRIVATE(this)->isFlagSet(SoRayPickActionP::PICK_ALL) && PRIVATE(this)->pickedpointlist.getLength()) {
+  if (!PRIVATE(this)->isFlagSet(SoRayPickActionP::PICK_ALL) && PRIVATE(this)->ray->pickedpointlist.getLength()) {
     // got to test if new candidate is closer than old one
-    if (dist >= PRIVATE(this)->ppdistance[0]) return NULL; // farther
+    if (dist >= PRIVATE(this)->ray->ppdistance[0]) return NULL; // farther
     // remove old point
-    PRIVATE(this)->pickedpointlist.truncate(0);
-    PRIVATE(this)->ppdistance.truncate(0);
+    PRIVATE(this)->ray->pickedpointlist.truncate(0);
+    PRIVATE(this)->ray->ppdistance.truncate(0);
   }
 
   // create the new picked point
   SoPickedPoint * pp = new SoPickedPoint(this->getCurPath(),
                                          this->state, objectspacepoint_in);
-  PRIVATE(this)->pickedpointlist.append(pp);
-  PRIVATE(this)->ppdistance.append(dist);
+  PRIVATE(this)->ray->pickedpointlist.append(pp);
+  PRIVATE(this)->ray->ppdistance.append(dist);
   PRIVATE(this)->clearFlag(SoRayPickActionP::PPLIST_IS_SORTED);
   return pp;
 }
@@ -1031,32 +1250,383 @@ void
 SoRayPickAction::beginTraversal(SoNode * node)
 {
   PRIVATE(this)->cleanupPickedPoints();
+  int i;
+  for (i = 0; i < PRIVATE(this)->rays.getLength(); i++) {
+    PRIVATE(this)->rays[i]->osid = 0;
+  }
+
+  if (PRIVATE(this)->rays.getLength() > 1) {
+    const AppliedCode code = this->getWhatAppliedTo();
+    if (PRIVATE(this)->numthreads > 1 && (code == NODE || code == PATH)) {
+      PRIVATE(this)->applyParallel();
+      return;
+    }
+    this->getState()->push();
+    SoViewportRegionElement::set(this->getState(), this->vpRegion);
+    if (PRIVATE(this)->isFlagSet(SoRayPickActionP::WS_RAY_SET)) {
+      SoPickRayElement::set(state, PRIVATE(this)->ray->wsvolume);
+    }
+
+    // traverse with the methods which pick the rays as packets
+    for (i = 0; i < PRIVATE(this)->rays.getLength(); i++) {
+      PRIVATE(this)->packet.append(i);
+    }
+    PRIVATE(this)->packetstart = 0;
+    SoActionMethodList * methods = this->traversalMethods;
+    this->traversalMethods = PRIVATE(this)->getBatchMethods();
+    this->traversalMethods->setUp();
+    inherited::beginTraversal(node);
+    this->traversalMethods = methods;
+    PRIVATE(this)->packet.truncate(0);
+    PRIVATE(this)->packetstack.truncate(0);
+    PRIVATE(this)->cullnode = NULL;
+
+    this->getState()->pop();
+    PRIVATE(this)->useRay(PRIVATE(this)->rays[0]);
+    return;
+  }
+
   this->getState()->push();
   SoViewportRegionElement::set(this->getState(), this->vpRegion);
 
   if (PRIVATE(this)->isFlagSet(SoRayPickActionP::WS_RAY_SET)) {
-    SoPickRayElement::set(state, PRIVATE(this)->wsvolume);
+    SoPickRayElement::set(state, PRIVATE(this)->ray->wsvolume);
   }
   inherited::beginTraversal(node);
   this->getState()->pop();
 }
 
 
+// Returns the number of rays the shape being picked should test its
+// primitives against. This is the whole packet of a batched pick if
+// the shape is the first to claim it, else just the current ray.
+int
+SoRayPickAction::claimRayPacket(void)
+{
+  if (PRIVATE(this)->packetpending) {
+    PRIVATE(this)->packetpending = FALSE;
+    PRIVATE(this)->inpacket = TRUE;
+  }
+  return this->getNumPacketRays();
+}
+
+// Returns the number of rays in the packet claimed by the shape.
+int
+SoRayPickAction::getNumPacketRays(void) const
+{
+  if (!PRIVATE(this)->inpacket) return 1;
+  return PRIVATE(this)->packet.getLength() - PRIVATE(this)->packetstart;
+}
+
+// Makes ray number \a index of the claimed packet the current ray.
+void
+SoRayPickAction::setPacketRay(const int index)
+{
+  if (!PRIVATE(this)->inpacket) return;
+  const int ray = PRIVATE(this)->packet[PRIVATE(this)->packetstart + index];
+  PRIVATE(this)->useRay(PRIVATE(this)->rays[ray]);
+}
+
+// Narrows the claimed packet to the \a num rays with the given
+// indices in it, until popRayPacket() is called.
+void
+SoRayPickAction::pushRayPacket(const int * indices, const int num)
+{
+  if (PRIVATE(this)->inpacket) PRIVATE(this)->pushRayPacket(indices, num);
+}
+
+void
+SoRayPickAction::popRayPacket(void)
+{
+  if (PRIVATE(this)->inpacket) PRIVATE(this)->popRayPacket();
+}
+
 //////// Hidden private methods for //////////////////////////////////////
 //////// SoRayPickActionP (pimpl) ////////////////////////////////////////
 
+SoRayPickActionP::SoRayPickActionP(void)
+  : ray(NULL),
+    ownsrays(TRUE),
+    packetstart(0),
+    packetpending(FALSE),
+    inpacket(FALSE),
+    cullnode(NULL),
+    batchmethods(NULL),
+    numthreads(1),
+    osid(0),
+    owner(NULL)
+{
+  this->setNumRays(1);
+
+  const char * env = coin_getenv("COIN_RAYPICK_THREADS");
+  if (env && atoi(env) > 0) this->numthreads = atoi(env);
+}
+
+SoRayPickActionP::~SoRayPickActionP()
+{
+  if (this->ownsrays) {
+    for (int i = 0; i < this->rays.getLength(); i++) delete this->rays[i];
+  }
+  delete this->batchmethods;
+}
+
+void
+SoRayPickActionP::setNumRays(const int numrays)
+{
+  assert(this->ownsrays);
+  while (this->rays.getLength() > numrays) {
+    delete this->rays[this->rays.getLength() - 1];
+    this->rays.truncate(this->rays.getLength() - 1);
+  }
+  while (this->rays.getLength() < numrays) {
+    this->rays.append(new Ray);
+  }
+  this->ray = this->rays[0];
+}
+
+// Makes \a r the current ray, with the object space line for the
+// current object space if the ray is known in world space.
+void
+SoRayPickActionP::useRay(Ray * r)
+{
+  this->ray = r;
+  if (this->osid != 0 && r->osid != this->osid &&
+      (r->flags & (WS_RAY_SET | WS_RAY_COMPUTED))) {
+    this->calcRayObjectSpace();
+  }
+}
+
+void
+SoRayPickActionP::pushRayPacket(const int * indices, const int num)
+{
+  const int start = this->packet.getLength();
+  for (int i = 0; i < num; i++) {
+    this->packet.append(this->packet[this->packetstart + indices[i]]);
+  }
+  this->packetstack.append(this->packetstart);
+  this->packetstart = start;
+}
+
+void
+SoRayPickActionP::popRayPacket(void)
+{
+  this->packet.truncate(this->packetstart);
+  this->packetstart = this->packetstack.pop();
+}
+
+// Tests the rays of the packet against the bounding box of a
+// separator in the current object space, and pushes a packet of the
+// rays which may hit it. Each ray is tested against the world space
+// box around the object space box, made larger by the radius of the
+// pick cone, so this never misses a ray the test in
+// SoRayPickAction::intersect() would let through.
+SbBool
+SoRayPickActionP::cullRayPacket(const SbBox3f & box, const SbBool usefullviewvolume)
+{
+  SbVec3d bounds[2];
+  bounds[0].setValue(box.getMin());
+  bounds[1].setValue(box.getMax());
+  SbVec3d corners[8];
+  SbVec3d wsmin(DBL_MAX, DBL_MAX, DBL_MAX);
+  SbVec3d wsmax(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+  int i, j;
+  for (i = 0; i < 8; i++) {
+    SbVec3d bp(i&1 ? bounds[0][0] : bounds[1][0],
+               i&2 ? bounds[0][1] : bounds[1][1],
+               i&4 ? bounds[0][2] : bounds[1][2]);
+    this->obj2world.multVecMatrix(bp, corners[i]);
+    for (j = 0; j < 3; j++) {
+      wsmin[j] = SbMin(wsmin[j], corners[i][j]);
+      wsmax[j] = SbMax(wsmax[j], corners[i][j]);
+    }
+  }
+
+  SbList <int> hits;
+  const int num = this->packet.getLength() - this->packetstart;
+  for (int k = 0; k < num; k++) {
+    const Ray * r = this->rays[this->packet[this->packetstart + k]];
+    const SbVec3d & start = r->raystart;
+    const SbVec3d & dir = r->raydirection;
+    const SbDPPlane & nearplane = r->nearplane;
+
+    // the distances of the box from the near plane of the ray
+    double dmin = DBL_MAX, dmax = -DBL_MAX;
+    for (i = 0; i < 8; i++) {
+      const double d = nearplane.getDistance(corners[i]);
+      dmin = SbMin(dmin, d);
+      dmax = SbMax(dmax, d);
+    }
+    double fardist = DBL_MAX;
+    if (r->flags & CLIP_FAR) fardist = r->rayfar - r->raynear;
+    if (r->lightpath) fardist = SbMin(fardist, r->lightdistance);
+    if (((r->flags & CLIP_NEAR) && dmax < 0.0) || dmin > fardist) continue;
+
+    double margin = 0.0;
+    if (usefullviewvolume && !(r->flags & WS_RAY_SET)) {
+      margin = r->rayradiusstart + SbMax(r->rayradiusdelta, 0.0) * SbMax(dmax, 0.0);
+    }
+
+    // slab test of the line against the box
+    double tmin = -DBL_MAX, tmax = DBL_MAX;
+    for (j = 0; j < 3 && tmin <= tmax; j++) {
+      const double lo = wsmin[j] - margin;
+      const double hi = wsmax[j] + margin;
+      if (dir[j] == 0.0) {
+        if (start[j] < lo || start[j] > hi) tmax = -DBL_MAX;
+      }
+      else {
+        double t0 = (lo - start[j]) / dir[j];
+        double t1 = (hi - start[j]) / dir[j];
+        if (t0 > t1) SbSwap(t0, t1);
+        tmin = SbMax(tmin, t0);
+        tmax = SbMin(tmax, t1);
+      }
+    }
+    if (tmin <= tmax) hits.append(k);
+  }
+
+  if (hits.getLength() == 0) return FALSE;
+  this->pushRayPacket(hits.getArrayPtr(), hits.getLength());
+  this->useRay(this->rays[this->packet[this->packetstart]]);
+  return TRUE;
+}
+
+// Returns the traversal methods of batched picks, which are the
+// methods of the action, except for separators and shapes.
+SoActionMethodList *
+SoRayPickActionP::getBatchMethods(void)
+{
+  if (!this->batchmethods) {
+    this->batchmethods = new SoActionMethodList(this->owner->traversalMethods);
+    this->batchmethods->addMethod(SoShape::getClassTypeId(), batchShapeS);
+    this->batchmethods->addMethod(SoSeparator::getClassTypeId(), batchGroupS);
+#ifdef HAVE_VRML97
+    this->batchmethods->addMethod(SoVRMLGroup::getClassTypeId(), batchGroupS);
+#endif // HAVE_VRML97
+  }
+  return this->batchmethods;
+}
+
+// Picks a group which culls the packet against its bounding box.
+void
+SoRayPickActionP::batchGroupS(SoAction * action, SoNode * node)
+{
+  SoRayPickActionP * thisp = &PRIVATE(static_cast<SoRayPickAction *>(action)).get();
+  const int depth = thisp->packetstack.getLength();
+  thisp->cullnode = node;
+  SoNode::rayPickS(action, node);
+  thisp->cullnode = NULL;
+  if (thisp->packetstack.getLength() > depth) thisp->popRayPacket();
+}
+
+// Picks a shape with the whole packet, if its rayPick() method claims
+// it, or else with one ray at a time.
+void
+SoRayPickActionP::batchShapeS(SoAction * action, SoNode * node)
+{
+  SoRayPickActionP * thisp = &PRIVATE(static_cast<SoRayPickAction *>(action)).get();
+  thisp->cullnode = NULL;
+  thisp->useRay(thisp->rays[thisp->packet[thisp->packetstart]]);
+  thisp->packetpending = TRUE;
+  SoNode::rayPickS(action, node);
+  const SbBool claimed = thisp->inpacket;
+  thisp->packetpending = FALSE;
+  thisp->inpacket = FALSE;
+  if (claimed) return;
+
+  for (int i = thisp->packetstart + 1; i < thisp->packet.getLength(); i++) {
+    thisp->useRay(thisp->rays[thisp->packet[i]]);
+    SoNode::rayPickS(action, node);
+  }
+}
+
+// A range of the rays of a batched pick, picked by its own action.
+struct soraypick_job {
+  SoRayPickAction * action;
+  SoNode * node;
+  SoPath * path;
+};
+
+static void
+soraypick_apply_job(void * closure)
+{
+  soraypick_job * job = static_cast<soraypick_job *>(closure);
+  if (job->path) job->action->apply(job->path);
+  else job->action->apply(job->node);
+}
+
+// Splits the rays into consecutive ranges, and picks each range in a
+// thread of its own, with an action which picks into the rays of this
+// action.
+void
+SoRayPickActionP::applyParallel(void)
+{
+  const int numrays = this->rays.getLength();
+  const int numjobs = SbMin(this->numthreads, numrays);
+  soraypick_job * jobs = new soraypick_job[numjobs];
+  int i;
+  for (i = 0; i < numjobs; i++) {
+    const int start = int((int64_t(numrays) * i) / numjobs);
+    const int end = int((int64_t(numrays) * (i + 1)) / numjobs);
+
+    SoRayPickAction * action = new SoRayPickAction(this->owner->getViewportRegion());
+    action->enableCulling(this->owner->isCullingEnabled());
+    action->setRadius(this->radiusinpixels);
+    action->setNumThreads(1);
+    SoRayPickActionP * actionp = &PRIVATE(action).get();
+    actionp->flags |= this->flags & (PICK_ALL | LIGHTWEIGHT);
+    delete actionp->rays[0];
+    actionp->rays.truncate(0);
+    for (int r = start; r < end; r++) actionp->rays.append(this->rays[r]);
+    actionp->ray = actionp->rays[0];
+    actionp->ownsrays = FALSE;
+
+    jobs[i].action = action;
+    jobs[i].node = this->owner->getNodeAppliedTo();
+    jobs[i].path = this->owner->getWhatAppliedTo() == SoAction::PATH ?
+      this->owner->getPathAppliedTo() : NULL;
+
+    // Set up the traversal method tables and the state in this thread,
+    // as the lazy initialization of these is not thread safe.
+    action->traversalMethods->setUp();
+    actionp->getBatchMethods()->setUp();
+    (void) action->getState();
+  }
+
+#if defined(HAVE_THREADS) && defined(COIN_THREADSAFE)
+  cc_wpool * pool = cc_wpool_construct(numjobs - 1);
+  cc_wpool_begin(pool, numjobs - 1);
+  for (i = 1; i < numjobs; i++) {
+    cc_wpool_start_worker(pool, soraypick_apply_job, &jobs[i]);
+  }
+  cc_wpool_end(pool);
+  soraypick_apply_job(&jobs[0]);
+  cc_wpool_wait_all(pool);
+  cc_wpool_destruct(pool);
+#else // !(HAVE_THREADS && COIN_THREADSAFE)
+  for (i = 0; i < numjobs; i++) {
+    soraypick_apply_job(&jobs[i]);
+  }
+#endif // !(HAVE_THREADS && COIN_THREADSAFE)
+
+  for (i = 0; i < numjobs; i++) {
+    delete jobs[i].action;
+  }
+  delete[] jobs;
+}
+
 SbBool
 SoRayPickActionP::isBetweenPlanesWS(const SbVec3d & intersection,
                                     const SoClipPlaneElement * planes) const
 {
   SbVec3f isect_f;
   isect_f.setValue(intersection);
-  double dist = this->nearplane.getDistance(intersection);
+  double dist = this->ray->nearplane.getDistance(intersection);
   if (this->isFlagSet(CLIP_NEAR)) {
     if (dist < 0) return FALSE;
   }
   if (this->isFlagSet(CLIP_FAR)) {
-    if (dist > (this->rayfar - this->raynear)) return FALSE;
+    if (dist > (this->ray->rayfar - this->ray->raynear)) return FALSE;
   }
   int n =  planes->getNum();
   for (int i = 0; i < n; i++) {
@@ -1068,64 +1638,284 @@ SoRayPickActionP::isBetweenPlanesWS(const SbVec3d & intersection,
 void
 SoRayPickActionP::cleanupPickedPoints(void)
 {
-  this->pickedpointlist.truncate(0); // this will delete all SoPickedPoint instances in the list
-  this->ppdistance.truncate(0);
-  this->clearFlag(PPLIST_IS_SORTED);
+  // the rays of the actions in applyParallel() are cleaned up by the
+  // action they belong to
+  if (!this->ownsrays) return;
+  for (int i = 0; i < this->rays.getLength(); i++) {
+    Ray * r = this->rays[i];
+    r->pickedpointlist.truncate(0); // this will delete all SoPickedPoint instances in the list
+    r->ppdistance.truncate(0);
+    if (r->lightpath) {
+      r->lightpath->unref();
+      r->lightpath = NULL;
+    }
+    r->flags &= ~(PPLIST_IS_SORTED | LIGHT_PP_COMPUTED);
+  }
+}
+
+// Records the closest hit in lightweight mode. Hits on the same shape
+// as the last one reuse its path.
+void
+SoRayPickActionP::setLightweightHit(const SoPath * path, const double distance,
+                                    const SbVec3f & objectspacepoint)
+{
+  const SoFullPath * fullpath = static_cast<const SoFullPath *>(path);
+  const SoFullPath * last = static_cast<const SoFullPath *>(this->ray->lightpath);
+  SbBool same = last && last->getLength() == fullpath->getLength();
+  for (int i = fullpath->getLength() - 1; same && i >= 0; i--) {
+    same = last->getNode(i) == fullpath->getNode(i) &&
+      (i == 0 || last->getIndex(i) == fullpath->getIndex(i));
+  }
+  if (!same) {
+    if (this->ray->lightpath) this->ray->lightpath->unref();
+    this->ray->lightpath = path->copy();
+    this->ray->lightpath->ref();
+  }
+  this->ray->lightdistance = distance;
+  this->ray->lightobjectpoint = objectspacepoint;
+}
+
+// Makes the full picked point for the closest hit of a ray in
+// lightweight mode, by picking the shape at the end of the path again
+// with the same ray.
+void
+SoRayPickActionP::computeLightweightPickedPoint(Ray * r)
+{
+  r->flags |= LIGHT_PP_COMPUTED;
+
+  SoRayPickAction pick(this->owner->getViewportRegion());
+  pick.enableCulling(this->owner->isCullingEnabled());
+  pick.setRadius(this->radiusinpixels);
+  if (r->flags & WS_RAY_SET) {
+    SbVec3f start, direction;
+    start.setValue(r->raystart);
+    direction.setValue(r->raydirection);
+    pick.setRay(start, direction,
+                (r->flags & CLIP_NEAR) ? float(r->raynear) : -1.0f,
+                (r->flags & CLIP_FAR) ? float(r->rayfar) : -1.0f);
+  }
+  else if (r->flags & NORM_POINT) {
+    pick.setNormalizedPoint(r->normvppoint);
+  }
+  else {
+    pick.setPoint(r->vppoint);
+  }
+  pick.apply(r->lightpath);
+
+  SoPickedPoint * pp = pick.getPickedPoint();
+  if (pp) {
+    r->pickedpointlist.append(pp->copy());
+    r->ppdistance.append(r->lightdistance);
+  }
+}
+
+// Calculates the current ray in world space from the view volume.
+void
+SoRayPickActionP::computeWorldSpaceRay(SoState * state)
+{
+  this->ray->osid = 0;
+  if (this->isFlagSet(WS_RAY_SET)) {
+    // set the ray radius to some very small value, since
+    // the user set the ray manually using setRay().
+    //
+    // FIXME: Wouldn't it be a nice new feature to be able to
+    // set the radius of the ray in setRay()? pederb, 2001-01-05
+    const SbViewVolume & vv = SoViewVolumeElement::get(state);
+    this->ray->rayradiusstart = SbMin(vv.getWidth(), vv.getHeight()) * FLT_EPSILON;
+    this->ray->rayradiusdelta = 0.0f;
+  }
+  else {
+    const SbViewVolume & vv = SoViewVolumeElement::get(state);
+    const SbViewportRegion & vp = SoViewportRegionElement::get(state);
+
+    if (!this->isFlagSet(NORM_POINT)) {
+      SbVec2s pt = this->ray->vppoint - vp.getViewportOriginPixels();
+      SbVec2s size = vp.getViewportSizePixels();
+      this->ray->normvppoint.setValue(float(pt[0]) / float(size[0]),
+                                      float(pt[1]) / float(size[1]));
+    }
+
+#if COIN_DEBUG
+    if (vv.getDepth() == 0.0f || vv.getWidth() == 0.0f || vv.getHeight() == 0.0f) {
+      SoDebugError::postWarning("SoRayPickAction::computeWorldSpaceRay",
+                                "invalid frustum: <%f, %f, %f>",
+                                vv.getWidth(), vv.getHeight(), vv.getDepth());
+      return;
+    }
+#endif // COIN_DEBUG
+
+    SbDPLine templine;
+    SbVec2d tmppt;
+    tmppt.setValue(this->ray->normvppoint);
+    vv.getDPViewVolume().projectPointToLine(tmppt, templine);
+    this->ray->raystart = templine.getPosition();
+    this->ray->raydirection = templine.getDirection();
+
+    this->ray->raynear = 0.0;
+    this->ray->rayfar = vv.getDPViewVolume().getDepth();
+
+    SbVec2s vpsize = vp.getViewportSizePixels();
+    this->ray->rayradiusstart = (double(vv.getHeight()) / double(vpsize[1]))*
+      double(this->radiusinpixels);
+    this->ray->rayradiusdelta = 0.0;
+    if (vv.getProjectionType() == SbViewVolume::PERSPECTIVE) {
+      SbVec3d dir(0.0f, vv.getHeight()*0.5f, vv.getNearDist());
+      // no need to test here, we know vv isn't empty
+      (void) dir.normalize();
+      SbVec3d upperfar = dir * (vv.getNearDist()+vv.getDepth()) /
+        dir.dot(SbVec3d(0.0f, 0.0f, 1.0f));
+
+      double farheight = double(upperfar[1])*2.0;
+      double farsize = (farheight / double(vpsize[1])) * double(this->radiusinpixels);
+      this->ray->rayradiusdelta = (farsize - this->ray->rayradiusstart) / double(vv.getDepth());
+    }
+    this->ray->wsline = SbDPLine(this->ray->raystart,
+                                 this->ray->raystart + this->ray->raydirection);
+
+    this->ray->nearplane = SbDPPlane(vv.getDPViewVolume().getProjectionDirection(),
+                                     this->ray->raystart);
+    this->setFlag(WS_RAY_COMPUTED);
+
+    // we pick on a real cone, but keep pick view volume in sync to be
+    // compatible with OIV.
+    double normradius = double(this->radiusinpixels) /
+      double(SbMin(vp.getViewportSizePixels()[0], vp.getViewportSizePixels()[1]));
+
+    this->ray->wsvolume = vv.narrow(float(this->ray->normvppoint[0] - normradius),
+                                    float(this->ray->normvppoint[1] - normradius),
+                                    float(this->ray->normvppoint[0] + normradius),
+                                    float(this->ray->normvppoint[1] + normradius));
+    SoPickRayElement::set(state, this->ray->wsvolume);
+    this->setFlag(OSVOLUME_DIRTY);
+  }
+}
+
+// Sets the current ray in world space.
+void
+SoRayPickActionP::setRay(const SbVec3f & start, const SbVec3f & direction,
+                         float neardistance, float fardistance)
+{
+#if COIN_DEBUG
+  if (direction == SbVec3f(0.0f, 0.0f, 0.0f)) {
+    SoDebugError::postWarning("SoRayPickAction::setRay",
+                              "Ray has no direction");
+
+  }
+#endif // COIN_DEBUG
+  if (neardistance >= 0.0f) this->setFlag(CLIP_NEAR);
+  else {
+    this->clearFlag(CLIP_NEAR);
+    neardistance = 1.0f;
+    // make sure neardistance is smaller than fardistance
+    if (fardistance > 0.0f && neardistance >= fardistance) {
+      neardistance = fardistance * 0.01f;
+    }
+  }
+
+  if (fardistance >= 0.0f) this->setFlag(CLIP_FAR);
+  else {
+    this->clearFlag(CLIP_FAR);
+    // just set to some value bigger than neardistance.
+    fardistance = neardistance + 10.0f;
+  }
+
+  // set these to some values. They will be set to better values
+  // in computeWorldSpaceRay() (when we know the view volume).
+  this->ray->osid = 0;
+  this->ray->rayradiusstart = 0.01;
+  this->ray->rayradiusdelta = 0.0;
+
+  this->ray->raystart.setValue(start);
+  this->ray->raydirection.setValue(direction);
+  (void) this->ray->raydirection.normalize();
+  this->ray->raynear = neardistance;
+  this->ray->rayfar = fardistance;
+  this->ray->wsline = SbDPLine(this->ray->raystart,
+                               this->ray->raystart + this->ray->raydirection);
+
+  // D = shortest distance from origin to plane
+  const double D = this->ray->raydirection.dot(this->ray->raystart);
+  this->ray->nearplane = SbDPPlane(this->ray->raydirection, D + this->ray->raynear);
+
+  this->setFlag(WS_RAY_SET);
+
+  // We use a real cone for picking, but keep pick view volume in sync to be
+  // compatible with OIV
+  this->ray->wsvolume.perspective(0.0, 1.0, neardistance, fardistance);
+  this->ray->wsvolume.translateCamera(start);
+  this->ray->wsvolume.rotateCamera(SbRotation(SbVec3f(0.0f, 0.0f, -1.0f), direction));
+  this->setFlag(OSVOLUME_DIRTY);
 }
 
 void
 SoRayPickActionP::setFlag(const unsigned int flag)
 {
-  this->flags |= flag;
+  this->flags |= flag & ~RAY_FLAGS;
+  this->ray->flags |= flag & RAY_FLAGS;
 }
 
 void
 SoRayPickActionP::clearFlag(const unsigned int flag)
 {
   this->flags &= ~flag;
+  this->ray->flags &= ~flag;
 }
 
 SbBool
 SoRayPickActionP::isFlagSet(const unsigned int flag) const
 {
-  return (this->flags & flag) != 0;
+  return ((this->flags | this->ray->flags) & flag) != 0;
 }
 
 void
 SoRayPickActionP::calcObjectSpaceData(SoState * ownerstate)
 {
-  this->calcMatrices(ownerstate);
+  if (this->calcMatrices(ownerstate)) {
+    if (++this->osid == 0) this->osid = 1;
+  }
+  if (this->ray->osid != this->osid) this->calcRayObjectSpace();
+}
 
+// Calculates the object space line of the current ray.
+void
+SoRayPickActionP::calcRayObjectSpace(void)
+{
   SbVec3d start, dir;
 
+  this->ray->osid = this->osid;
   if (this->objectspacevalid) {
-    this->world2obj.multVecMatrix(this->raystart, start);
-    this->world2obj.multDirMatrix(this->raydirection, dir);
-    this->osline = SbDPLine(start, start + dir);
+    this->world2obj.multVecMatrix(this->ray->raystart, start);
+    this->world2obj.multDirMatrix(this->ray->raydirection, dir);
+    this->ray->osline = SbDPLine(start, start + dir);
 
     SbVec3f tmp1, tmp2;
     tmp1.setValue(start);
 
     // scale direction with depth to avoid that line gets no direction
     // when we convert it to single precision below.
-    dir *= this->rayfar;
+    dir *= this->ray->rayfar;
     tmp2.setValue(dir);
 
-    this->osline_sp = SbLine(tmp1, tmp1 + tmp2);
+    this->ray->osline_sp = SbLine(tmp1, tmp1 + tmp2);
   }
 }
 
-void
+// Returns FALSE if the object space is the same as the last time,
+// which is common when the shapes of a batched pick set the object
+// space for each ray.
+SbBool
 SoRayPickActionP::calcMatrices(SoState * state)
 {
-  const SbMatrix & tmp = SoModelMatrixElement::get(state);
-  this->obj2world = SbDPMatrix(tmp);
+  SbDPMatrix tmp(SoModelMatrixElement::get(state));
   if (this->isFlagSet(EXTRA_MATRIX)) {
-    this->obj2world.multLeft(this->extramatrix);
+    tmp.multLeft(this->extramatrix);
   }
+  if (this->osid != 0 && tmp == this->obj2world) return FALSE;
+  this->obj2world = tmp;
   this->world2obj = this->obj2world.inverse();
   // FIXME: find a safe way to test if we were able to properly calculate the inverse matrix
   this->objectspacevalid = TRUE;
+  return TRUE;
 }
 
 void
@@ -1158,3 +1948,217 @@ SoRayPickActionP::setPickStyleFlags(SoState * state)
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/SoPickedPoint.h>
+#include <Inventor/details/SoCubeDetail.h>
+#include <Inventor/lists/SoPickedPointList.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoFaceSet.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+// Unit cubes along the negative z axis, at z = -5, -10, -15 and -20,
+// in the order given.
+static SoSeparator *
+make_cubes(const SbBool farthestfirst)
+{
+  SoSeparator * root = new SoSeparator;
+  for (int i = 0; i < 4; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * t = new SoTranslation;
+    t->translation.setValue(0.0f, 0.0f, -5.0f * float(farthestfirst ? 4 - i : i + 1));
+    sep->addChild(t);
+    sep->addChild(new SoCube);
+    root->addChild(sep);
+  }
+  return root;
+}
+
+BOOST_AUTO_TEST_CASE(lightweightPick)
+{
+  for (int order = 0; order < 2; order++) {
+    SoSeparator * root = make_cubes(order == 1);
+    root->ref();
+    SoNode * nearest = static_cast<SoGroup *>(root->getChild(order ? 3 : 0))->getChild(1);
+
+    SoRayPickAction rp(SbViewportRegion(100, 100));
+    rp.setRay(SbVec3f(0.1f, 0.2f, 0.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+    rp.apply(root);
+    SoPickedPoint * full = rp.getPickedPoint();
+    BOOST_REQUIRE(full != NULL);
+    BOOST_CHECK(rp.getPickedPath() == NULL);
+    const SbVec3f fullpoint = full->getObjectPoint();
+
+    rp.setLightweightPick(TRUE);
+    BOOST_CHECK(rp.isLightweightPick());
+    rp.apply(root);
+    const SoPath * path = rp.getPickedPath();
+    BOOST_REQUIRE(path != NULL);
+    BOOST_CHECK(path->getTail() == nearest);
+    BOOST_CHECK(rp.getPickedObjectPoint().equals(fullpoint, 1e-5f));
+    // the near plane is at distance 1 from the ray start
+    BOOST_CHECK(fabs(rp.getPickedDistance() - 3.0f) < 1e-5f);
+
+    // the full picked point is made on demand
+    SoPickedPoint * pp = rp.getPickedPoint();
+    BOOST_REQUIRE(pp != NULL);
+    BOOST_CHECK(pp->getPath()->getTail() == nearest);
+    BOOST_CHECK(pp->getObjectPoint().equals(fullpoint, 1e-5f));
+    BOOST_CHECK(pp->getNormal().equals(SbVec3f(0.0f, 0.0f, 1.0f), 1e-5f));
+    BOOST_CHECK(pp->getDetail() &&
+                pp->getDetail()->isOfType(SoCubeDetail::getClassTypeId()));
+    BOOST_CHECK_EQUAL(rp.getPickedPointList().getLength(), 1);
+
+    // a miss clears the hit from the last pick
+    rp.setRay(SbVec3f(5.0f, 0.0f, 0.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+    rp.apply(root);
+    BOOST_CHECK(rp.getPickedPath() == NULL);
+    BOOST_CHECK(rp.getPickedPoint() == NULL);
+
+    root->unref();
+  }
+}
+
+// Checks that ray number i of a batched pick found the same as a pick
+// with just that ray.
+static void
+check_same_picks(SoRayPickAction & batch, const int i,
+                 SoRayPickAction & single)
+{
+  if (batch.isLightweightPick()) {
+    BOOST_REQUIRE_EQUAL(batch.getPickedPath(i) != NULL,
+                        single.getPickedPath() != NULL);
+    if (!single.getPickedPath()) return;
+    BOOST_CHECK(*batch.getPickedPath(i) == *single.getPickedPath());
+    BOOST_CHECK(fabs(batch.getPickedDistance(i) - single.getPickedDistance()) < 1e-5f);
+    return;
+  }
+  const SoPickedPointList & list = batch.getPickedPointList(i);
+  const SoPickedPointList & singlelist = single.getPickedPointList();
+  BOOST_REQUIRE_EQUAL(list.getLength(), singlelist.getLength());
+  for (int j = 0; j < list.getLength(); j++) {
+    BOOST_CHECK(*list[j]->getPath() == *singlelist[j]->getPath());
+    BOOST_CHECK(list[j]->getPoint().equals(singlelist[j]->getPoint(), 1e-5f));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(batchedPick)
+{
+  // the cubes are picked by SoCube::rayPick() one ray at a time, and
+  // the face set by SoShape::rayPick() with the packet
+  SoSeparator * root = make_cubes(FALSE);
+  root->ref();
+  SoSeparator * sep = new SoSeparator;
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->point.set1Value(0, SbVec3f(2.0f, -1.0f, -8.0f));
+  coords->point.set1Value(1, SbVec3f(4.0f, -1.0f, -8.0f));
+  coords->point.set1Value(2, SbVec3f(4.0f, 1.0f, -8.0f));
+  coords->point.set1Value(3, SbVec3f(2.0f, 1.0f, -8.0f));
+  sep->addChild(coords);
+  sep->addChild(new SoFaceSet);
+  root->addChild(sep);
+
+  SbVec3f starts[10], directions[10];
+  for (int i = 0; i < 10; i++) {
+    starts[i].setValue(float(i / 2) * 1.5f - 0.8f, (i & 1) ? 0.5f : -1.5f, 0.0f);
+    directions[i].setValue(0.0f, 0.0f, -1.0f);
+  }
+
+  for (int mode = 0; mode < 3; mode++) {
+    SoRayPickAction batch(SbViewportRegion(100, 100));
+    SoRayPickAction single(SbViewportRegion(100, 100));
+    batch.setPickAll(TRUE);
+    single.setPickAll(TRUE);
+    batch.setLightweightPick(mode == 1);
+    single.setLightweightPick(mode == 1);
+    batch.setNumThreads(mode == 2 ? 2 : 1);
+
+    batch.setRays(starts, directions, 10);
+    BOOST_CHECK_EQUAL(batch.getNumRays(), 10);
+    // apply twice, to pick with the bounding box caches as well
+    for (int apply = 0; apply < 2; apply++) {
+      batch.apply(root);
+      int numhits = 0;
+      for (int i = 0; i < 10; i++) {
+        single.setRay(starts[i], directions[i]);
+        single.apply(root);
+        check_same_picks(batch, i, single);
+        if (single.getPickedPoint()) numhits++;
+      }
+      // the cubes and the face set are hit by some rays, not all
+      BOOST_CHECK(numhits > 2 && numhits < 10);
+    }
+  }
+
+  // rays through a camera
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  camera->position.setValue(0.0f, 0.0f, 10.0f);
+  camera->farDistance = 100.0f;
+  root->insertChild(camera, 0);
+
+  SbVec2f points[9];
+  for (int i = 0; i < 9; i++) {
+    points[i].setValue(0.3f + float(i % 3) * 0.2f, 0.4f + float(i / 3) * 0.1f);
+  }
+  SoRayPickAction batch(SbViewportRegion(100, 100));
+  SoRayPickAction single(SbViewportRegion(100, 100));
+  batch.setNormalizedPoints(points, 9);
+  batch.apply(root);
+  for (int i = 0; i < 9; i++) {
+    single.setNormalizedPoint(points[i]);
+    single.apply(root);
+    check_same_picks(batch, i, single);
+  }
+  BOOST_CHECK(batch.getPickedPointList(4).getLength() == 1);
+
+  // back to picking one ray
+  batch.setNormalizedPoint(points[4]);
+  BOOST_CHECK_EQUAL(batch.getNumRays(), 1);
+
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(batchedPickClipped)
+{
+  SoSeparator * root = make_cubes(TRUE);
+  root->ref();
+
+  // rays in different directions, clipped to skip the nearest cube
+  SbVec3f starts[6], directions[6];
+  for (int i = 0; i < 6; i++) {
+    starts[i].setValue(0.2f * float(i % 3), 0.0f, 0.0f);
+    directions[i].setValue(0.0f, (i < 3) ? 0.0f : 0.3f, -1.0f);
+  }
+
+  SoRayPickAction batch(SbViewportRegion(100, 100));
+  SoRayPickAction single(SbViewportRegion(100, 100));
+  batch.setRays(starts, directions, 6, 7.0f, 30.0f);
+  batch.apply(root);
+  BOOST_CHECK_EQUAL(batch.getNumRays(), 6);
+  for (int i = 0; i < 6; i++) {
+    single.setRay(starts[i], directions[i], 7.0f, 30.0f);
+    single.apply(root);
+    check_same_picks(batch, i, single);
+  }
+
+  // the straight rays hit the front of the cube at z = -10
+  for (int i = 0; i < 3; i++) {
+    const SoPickedPointList & list = batch.getPickedPointList(i);
+    BOOST_REQUIRE_EQUAL(list.getLength(), 1);
+    BOOST_CHECK(fabs(list[0]->getPoint()[2] + 9.0f) < 1e-5f);
+  }
+  // the slanted rays pass above the cubes beyond the near distance
+  for (int i = 3; i < 6; i++) {
+    BOOST_CHECK_EQUAL(batch.getPickedPointList(i).getLength(), 0);
+  }
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
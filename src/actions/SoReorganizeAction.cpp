@@ -247,8 +247,14 @@
 
 #include <cstring>
 #include <cassert>
+#include <cstdlib>
+#include <cmath>
 
+#include <Inventor/C/tidbits.h>
 #include <Inventor/SbName.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbPlane.h>
+#include <Inventor/lists/SoTypeList.h>
 #include <Inventor/actions/SoCallbackAction.h>
 #include <Inventor/actions/SoSearchAction.h>
 #include <Inventor/nodes/SoVertexShape.h>
@@ -261,6 +267,31 @@
 #include <Inventor/nodes/SoVertexProperty.h>
 #include <Inventor/nodes/SoTextureCoordinate2.h>
 #include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoTransformation.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoBaseColor.h>
+#include <Inventor/nodes/SoPackedColor.h>
+#include <Inventor/nodes/SoMaterialBinding.h>
+#include <Inventor/nodes/SoNormalBinding.h>
+#include <Inventor/nodes/SoTextureCoordinateBinding.h>
+#include <Inventor/nodes/SoCoordinate4.h>
+#include <Inventor/nodes/SoShapeHints.h>
+#include <Inventor/nodes/SoDrawStyle.h>
+#include <Inventor/nodes/SoLightModel.h>
+#include <Inventor/nodes/SoLight.h>
+#include <Inventor/nodes/SoClipPlane.h>
+#include <Inventor/nodes/SoEnvironment.h>
+#include <Inventor/nodes/SoPolygonOffset.h>
+#include <Inventor/nodes/SoPickStyle.h>
+#include <Inventor/nodes/SoComplexity.h>
+#include <Inventor/nodes/SoTexture.h>
+#include <Inventor/nodes/SoTextureCoordinate3.h>
+#include <Inventor/nodes/SoTextureCoordinateFunction.h>
+#include <Inventor/nodes/SoCamera.h>
+#include <Inventor/nodes/SoInfo.h>
+#include <Inventor/nodes/SoLabel.h>
 #include <Inventor/SoPrimitiveVertex.h>
 #include <Inventor/SbViewportRegion.h>
 #include <Inventor/elements/SoMultiTextureEnabledElement.h>
@@ -268,6 +299,17 @@
 #include <Inventor/elements/SoShapeStyleElement.h>
 #include <Inventor/elements/SoLightModelElement.h>
 #include <Inventor/elements/SoNormalElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoShapeHintsElement.h>
+#include <Inventor/elements/SoDrawStyleElement.h>
+#include <Inventor/elements/SoLineWidthElement.h>
+#include <Inventor/elements/SoPointSizeElement.h>
+#include <Inventor/elements/SoLinePatternElement.h>
+#include <Inventor/elements/SoPickStyleElement.h>
+#include <Inventor/elements/SoEnvironmentElement.h>
+#include <Inventor/elements/SoPolygonOffsetElement.h>
+#include <Inventor/elements/SoLightElement.h>
+#include <Inventor/elements/SoClipPlaneElement.h>
 #include <Inventor/caches/SoPrimitiveVertexCache.h>
 #include <Inventor/SbColor4f.h>
 
@@ -285,6 +327,532 @@
 #include "coindefs.h" // COIN_STUB()
 #include "SbBasicP.h"
 #include "actions/SoSubActionP.h"
+#include "base/SbPointWelder.h"
+#include "misc/SbHash.h"
+#include "threads/threadsutilp.h"
+
+// *************************************************************************
+
+// Mesh optimization. The triangle shapes are collected with the
+// state they are rendered with, shapes rendered with the same state
+// are merged into one mesh, and every mesh is welded, cleaned for
+// degenerate and duplicate triangles and reordered for the post
+// transform vertex cache before it replaces the shapes.
+
+// The number of vertices in the simulated vertex cache.
+#define SOREORGANIZE_CACHE_SIZE 32
+
+// Welded vertices must have normals at most this far apart.
+#define SOREORGANIZE_NORMAL_TOLERANCE 1.0e-3f
+
+// The state a triangle shape is rendered with, apart from the
+// diffuse color, which is stored in the vertices. Shapes with equal
+// keys can be merged.
+class soreorganize_key {
+public:
+  int operator==(const soreorganize_key & key) const;
+  int operator!=(const soreorganize_key & key) const { return !(*this == key); }
+
+  SbBool lighting;
+  unsigned int shapeflags;
+  int transparencytype;
+  SbColor ambient;
+  SbColor emissive;
+  SbColor specular;
+  float shininess;
+  int vertexordering;
+  int shapetype;
+  int drawstyle;
+  float linewidth;
+  float pointsize;
+  int32_t linepattern;
+  int pickstyle;
+  float ambientintensity;
+  SbColor ambientcolor;
+  SbVec3f attenuation;
+  int32_t fogtype;
+  SbColor fogcolor;
+  float fogvisibility;
+  float fogstart;
+  float offsetfactor;
+  float offsetunits;
+  int offsetstyles;
+  SbBool offseton;
+  SbList<const SoNode *> lights;
+  SbList<SbMatrix> lightmatrices;
+  SbList<SbPlane> clipplanes;
+  // nodes traversed before the shape that might change how it is
+  // rendered, and which aren't reflected in the state above
+  SbList<const SoNode *> othernodes;
+};
+
+int
+soreorganize_key::operator==(const soreorganize_key & key) const
+{
+  return
+    this->lighting == key.lighting &&
+    this->shapeflags == key.shapeflags &&
+    this->transparencytype == key.transparencytype &&
+    this->ambient == key.ambient &&
+    this->emissive == key.emissive &&
+    this->specular == key.specular &&
+    this->shininess == key.shininess &&
+    this->vertexordering == key.vertexordering &&
+    this->shapetype == key.shapetype &&
+    this->drawstyle == key.drawstyle &&
+    this->linewidth == key.linewidth &&
+    this->pointsize == key.pointsize &&
+    this->linepattern == key.linepattern &&
+    this->pickstyle == key.pickstyle &&
+    this->ambientintensity == key.ambientintensity &&
+    this->ambientcolor == key.ambientcolor &&
+    this->attenuation == key.attenuation &&
+    this->fogtype == key.fogtype &&
+    this->fogcolor == key.fogcolor &&
+    this->fogvisibility == key.fogvisibility &&
+    this->fogstart == key.fogstart &&
+    this->offsetfactor == key.offsetfactor &&
+    this->offsetunits == key.offsetunits &&
+    this->offsetstyles == key.offsetstyles &&
+    this->offseton == key.offseton &&
+    this->lights == key.lights &&
+    this->lightmatrices == key.lightmatrices &&
+    this->clipplanes == key.clipplanes &&
+    this->othernodes == key.othernodes;
+}
+
+// A collected triangle shape.
+class soreorganize_shape {
+public:
+  SoFullPath * path;
+  SoPrimitiveVertexCache * pvcache;
+  SbMatrix matrix;
+  soreorganize_key key;
+  SbBool hastexture;
+  SbBool mergeable;
+};
+
+// The shapes merged into one mesh, and the result. The first shape
+// is replaced by the mesh, the others are removed.
+class soreorganize_mesh {
+public:
+  SbList<soreorganize_shape *> shapes;
+  SbBool lighting;
+  SbBool hastexture;
+  int numverticesbefore;
+  int numtrianglesbefore;
+
+  SbList<SbVec3f> vertices;
+  SbList<SbVec3f> normals;
+  SbList<SbVec2f> texcoords;
+  SbList<uint32_t> colors;
+  SbBool colorpervertex;
+  SbList<int32_t> indices;
+};
+
+// A triangle with its vertices rotated so the lowest index is first,
+// for finding duplicates.
+typedef struct {
+  int32_t v[3];
+  int32_t idx;
+} soreorganize_triangle;
+
+extern "C" {
+static int
+soreorganize_triangle_compare(const void * p0, const void * p1)
+{
+  const soreorganize_triangle * t0 = static_cast<const soreorganize_triangle *>(p0);
+  const soreorganize_triangle * t1 = static_cast<const soreorganize_triangle *>(p1);
+  for (int i = 0; i < 3; i++) {
+    if (t0->v[i] != t1->v[i]) return t0->v[i] < t1->v[i] ? -1 : 1;
+  }
+  return t0->idx < t1->idx ? -1 : (t0->idx > t1->idx ? 1 : 0);
+}
+}
+
+// The number of remaining triangles the vertex scores are tabulated
+// for.
+#define SOREORGANIZE_VALENCE_SIZE 64
+
+// The vertex scores of Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation": vertices recently used, and vertices with few
+// triangles left, score high. The scores are looked up in tables
+// made by soreorganize_init_scores().
+typedef struct {
+  float cache[SOREORGANIZE_CACHE_SIZE];
+  float valence[SOREORGANIZE_VALENCE_SIZE];
+} soreorganize_scores;
+
+static void
+soreorganize_init_scores(soreorganize_scores & scores)
+{
+  int i;
+  for (i = 0; i < SOREORGANIZE_CACHE_SIZE; i++) {
+    if (i < 3) {
+      // the last triangle's vertices get a fixed score, so the next
+      // triangle doesn't simply reuse the most recent edge
+      scores.cache[i] = 0.75f;
+    }
+    else {
+      const float s = 1.0f - float(i - 3) / float(SOREORGANIZE_CACHE_SIZE - 3);
+      scores.cache[i] = static_cast<float>(pow(s, 1.5f));
+    }
+  }
+  scores.valence[0] = 0.0f;
+  for (i = 1; i < SOREORGANIZE_VALENCE_SIZE; i++) {
+    scores.valence[i] = 2.0f / static_cast<float>(sqrt(float(i)));
+  }
+}
+
+static inline float
+soreorganize_vertex_score(const soreorganize_scores & scores,
+                          const int cachepos, const int remaining)
+{
+  if (remaining == 0) return -1.0f;
+  const float score = cachepos >= 0 ? scores.cache[cachepos] : 0.0f;
+  if (remaining < SOREORGANIZE_VALENCE_SIZE) {
+    return score + scores.valence[remaining];
+  }
+  return score + 2.0f / static_cast<float>(sqrt(float(remaining)));
+}
+
+// Reorders the triangles to reuse the vertices in the post transform
+// vertex cache, greedily picking the highest scoring triangle among
+// the ones using cached vertices.
+static void
+soreorganize_optimize_cache(int32_t * indices, const int numtriangles, const int numvertices)
+{
+  if (numtriangles < 2) return;
+  int i, j, k;
+  soreorganize_scores scores;
+  soreorganize_init_scores(scores);
+
+  int * numactive = new int[numvertices];
+  int * offsets = new int[numvertices + 1];
+  int * vtris = new int[numtriangles * 3];
+  int * cachepos = new int[numvertices];
+  float * vscore = new float[numvertices];
+  float * tscore = new float[numtriangles];
+  char * emitted = new char[numtriangles];
+  int32_t * result = new int32_t[numtriangles * 3];
+
+  // the triangles of every vertex, in one array
+  for (i = 0; i < numvertices; i++) numactive[i] = 0;
+  for (i = 0; i < numtriangles * 3; i++) numactive[indices[i]]++;
+  offsets[0] = 0;
+  for (i = 0; i < numvertices; i++) offsets[i+1] = offsets[i] + numactive[i];
+  for (i = 0; i < numvertices; i++) numactive[i] = 0;
+  for (i = 0; i < numtriangles * 3; i++) {
+    const int v = indices[i];
+    vtris[offsets[v] + numactive[v]++] = i / 3;
+  }
+  for (i = 0; i < numvertices; i++) {
+    cachepos[i] = -1;
+    vscore[i] = soreorganize_vertex_score(scores, -1, numactive[i]);
+  }
+
+  int best = -1;
+  float bestscore = -1.0f;
+  for (i = 0; i < numtriangles; i++) {
+    emitted[i] = 0;
+    tscore[i] = 0.0f;
+    for (j = 0; j < 3; j++) tscore[i] += vscore[indices[i*3+j]];
+    if (tscore[i] > bestscore) {
+      bestscore = tscore[i];
+      best = i;
+    }
+  }
+
+  int cache[SOREORGANIZE_CACHE_SIZE + 3];
+  int newcache[SOREORGANIZE_CACHE_SIZE + 3];
+  int cachelen = 0;
+  int next = 0; // all triangles before this one are emitted
+
+  for (int n = 0; n < numtriangles; n++) {
+    if (best < 0) {
+      // no cached vertex has triangles left, continue with the first
+      // remaining triangle
+      while (emitted[next]) next++;
+      best = next;
+    }
+    const int32_t * tri = indices + best * 3;
+    result[n*3] = tri[0];
+    result[n*3+1] = tri[1];
+    result[n*3+2] = tri[2];
+    emitted[best] = 1;
+
+    // move the triangle past the active triangles of its vertices
+    for (j = 0; j < 3; j++) {
+      const int v = tri[j];
+      int * list = vtris + offsets[v];
+      const int last = numactive[v] - 1;
+      for (k = 0; k < last; k++) {
+        if (list[k] == best) {
+          list[k] = list[last];
+          list[last] = best;
+          break;
+        }
+      }
+      numactive[v]--;
+    }
+
+    // the triangle's vertices go to the front of the cache
+    int newlen = 0;
+    for (j = 0; j < 3; j++) {
+      const int v = tri[j];
+      for (k = 0; k < newlen; k++) { if (newcache[k] == v) break; }
+      if (k == newlen) newcache[newlen++] = v;
+    }
+    for (i = 0; i < cachelen; i++) {
+      const int v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) newcache[newlen++] = v;
+    }
+
+    // new scores for the cached vertices, and the ones pushed out
+    for (i = 0; i < newlen; i++) {
+      const int v = newcache[i];
+      cachepos[v] = i < SOREORGANIZE_CACHE_SIZE ? i : -1;
+      const float score = soreorganize_vertex_score(scores, cachepos[v], numactive[v]);
+      const float delta = score - vscore[v];
+      vscore[v] = score;
+      const int * list = vtris + offsets[v];
+      for (k = 0; k < numactive[v]; k++) tscore[list[k]] += delta;
+    }
+    cachelen = SbMin(newlen, SOREORGANIZE_CACHE_SIZE);
+    for (i = 0; i < cachelen; i++) cache[i] = newcache[i];
+
+    best = -1;
+    bestscore = -1.0f;
+    for (i = 0; i < cachelen; i++) {
+      const int v = cache[i];
+      const int * list = vtris + offsets[v];
+      for (k = 0; k < numactive[v]; k++) {
+        if (tscore[list[k]] > bestscore) {
+          bestscore = tscore[list[k]];
+          best = list[k];
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < numtriangles * 3; i++) indices[i] = result[i];
+
+  delete[] result;
+  delete[] emitted;
+  delete[] tscore;
+  delete[] vscore;
+  delete[] cachepos;
+  delete[] vtris;
+  delete[] offsets;
+  delete[] numactive;
+}
+
+// Merges the shapes of the mesh into the coordinate system of the
+// first shape, welds the vertices, removes degenerate and duplicate
+// triangles, and orders the triangles and vertices for the vertex
+// cache. Only reads the caches of the shapes, so several meshes can
+// be built at the same time.
+static void
+soreorganize_build_mesh(soreorganize_mesh * mesh, const float tolerance)
+{
+  int i, j;
+  const SbBool lighting = mesh->lighting;
+  const SbBool hastexture = mesh->hastexture;
+
+  int numv = 0, numidx = 0;
+  for (i = 0; i < mesh->shapes.getLength(); i++) {
+    numv += mesh->shapes[i]->pvcache->getNumVertices();
+    numidx += mesh->shapes[i]->pvcache->getNumTriangleIndices();
+  }
+  mesh->numverticesbefore = numv;
+  mesh->numtrianglesbefore = numidx / 3;
+
+  // all vertices and triangles, in the first shape's coordinate system
+  SbList<SbVec3f> vertices(numv);
+  SbList<SbVec3f> normals(lighting ? numv : 4);
+  SbList<SbVec2f> texcoords(hastexture ? numv : 4);
+  SbList<uint32_t> colors(numv);
+  SbList<int32_t> indices(numidx);
+
+  const SbMatrix tofirst = mesh->shapes[0]->matrix.inverse();
+  for (i = 0; i < mesh->shapes.getLength(); i++) {
+    const SoPrimitiveVertexCache * pvcache = mesh->shapes[i]->pvcache;
+    const int n = pvcache->getNumVertices();
+    const int offset = vertices.getLength();
+    const SbVec3f * v = pvcache->getVertexArray();
+    const SbVec3f * nv = pvcache->getNormalArray();
+    const uint8_t * c = pvcache->getColorArray();
+
+    SbMatrix m = mesh->shapes[i]->matrix;
+    m.multRight(tofirst);
+    const SbBool identity = i == 0 || m == SbMatrix::identity();
+    const SbMatrix nm = identity ? m : m.inverse().transpose();
+
+    for (j = 0; j < n; j++) {
+      SbVec3f tmp = v[j];
+      if (!identity) m.multVecMatrix(v[j], tmp);
+      vertices.append(tmp);
+      if (lighting) {
+        tmp = nv[j];
+        if (!identity) {
+          nm.multDirMatrix(nv[j], tmp);
+          (void) tmp.normalize();
+        }
+        normals.append(tmp);
+      }
+      colors.append((uint32_t(c[0])<<24)|(uint32_t(c[1])<<16)|(uint32_t(c[2])<<8)|uint32_t(c[3]));
+      c += 4;
+    }
+    if (hastexture) {
+      const SbVec4f * tc = pvcache->getTexCoordArray();
+      for (j = 0; j < n; j++) {
+        SbVec4f tmp = tc[j];
+        if (tmp[3] != 0.0f) {
+          tmp[0] /= tmp[3];
+          tmp[1] /= tmp[3];
+        }
+        texcoords.append(SbVec2f(tmp[0], tmp[1]));
+      }
+    }
+    const GLint * idx = pvcache->getTriangleIndices();
+    const int numindices = pvcache->getNumTriangleIndices();
+    for (j = 0; j < numindices; j++) {
+      indices.append(static_cast<int32_t>(idx[j]) + offset);
+    }
+  }
+
+  // weld the positions, and then the vertices with a welded position
+  // and equal normal, texture coordinate and color
+  SbPointWelder welder(tolerance, numv);
+  SbList<int> posidx(numv);
+  for (i = 0; i < numv; i++) posidx.append(welder.addPoint(vertices[i]));
+
+  const int numpos = welder.getNumPoints();
+  int * first = new int[numpos];
+  for (i = 0; i < numpos; i++) first[i] = -1;
+  SbList<int> nextsame(numv);
+  SbList<int> welded(numv);
+  SbList<int> weldedpos(numv);
+  SbList<int> weldedsrc(numv);
+  for (i = 0; i < numv; i++) {
+    const int p = posidx[i];
+    int w = first[p];
+    while (w >= 0) {
+      const int src = weldedsrc[w];
+      if (colors[src] == colors[i] &&
+          (!lighting || (normals[src] - normals[i]).sqrLength() <=
+           SOREORGANIZE_NORMAL_TOLERANCE * SOREORGANIZE_NORMAL_TOLERANCE) &&
+          (!hastexture || texcoords[src] == texcoords[i])) break;
+      w = nextsame[w];
+    }
+    if (w < 0) {
+      w = weldedsrc.getLength();
+      weldedsrc.append(i);
+      weldedpos.append(p);
+      nextsame.append(first[p]);
+      first[p] = w;
+    }
+    welded.append(w);
+  }
+  delete[] first;
+
+  // remove degenerate triangles, and rotate the others for finding
+  // duplicates
+  const int numtri = numidx / 3;
+  soreorganize_triangle * tris = new soreorganize_triangle[numtri];
+  int numkept = 0;
+  for (i = 0; i < numtri; i++) {
+    const int32_t a = welded[indices[i*3]];
+    const int32_t b = welded[indices[i*3+1]];
+    const int32_t c = welded[indices[i*3+2]];
+    if (a == b || b == c || a == c) continue;
+    const SbVec3f & pa = welder.getPoint(weldedpos[a]);
+    const SbVec3f & pb = welder.getPoint(weldedpos[b]);
+    const SbVec3f & pc = welder.getPoint(weldedpos[c]);
+    if ((pb - pa).cross(pc - pa) == SbVec3f(0.0f, 0.0f, 0.0f)) continue;
+
+    soreorganize_triangle & t = tris[numkept++];
+    t.idx = i;
+    if (a < b && a < c) { t.v[0] = a; t.v[1] = b; t.v[2] = c; }
+    else if (b < c) { t.v[0] = b; t.v[1] = c; t.v[2] = a; }
+    else { t.v[0] = c; t.v[1] = a; t.v[2] = b; }
+  }
+
+  // remove duplicates, keeping the first one. Triangles facing the
+  // other way aren't duplicates, as they might be the back side.
+  qsort(tris, numkept, sizeof(soreorganize_triangle), soreorganize_triangle_compare);
+  char * keep = new char[numtri];
+  for (i = 0; i < numtri; i++) keep[i] = 0;
+  for (i = 0; i < numkept; i++) {
+    if (i == 0 ||
+        tris[i].v[0] != tris[i-1].v[0] ||
+        tris[i].v[1] != tris[i-1].v[1] ||
+        tris[i].v[2] != tris[i-1].v[2]) {
+      keep[tris[i].idx] = 1;
+    }
+  }
+  delete[] tris;
+
+  SbList<int32_t> & result = mesh->indices;
+  result.truncate(0);
+  for (i = 0; i < numtri; i++) {
+    if (!keep[i]) continue;
+    for (j = 0; j < 3; j++) result.append(welded[indices[i*3+j]]);
+  }
+  delete[] keep;
+
+  const int numresult = result.getLength();
+  int32_t * resultptr = const_cast<int32_t *>(result.getArrayPtr());
+  soreorganize_optimize_cache(resultptr, numresult / 3, weldedsrc.getLength());
+
+  // number the vertices in the order they are first used, dropping
+  // the unused ones
+  int * newidx = new int[weldedsrc.getLength()];
+  for (i = 0; i < weldedsrc.getLength(); i++) newidx[i] = -1;
+  int numused = 0;
+  for (i = 0; i < numresult; i++) {
+    const int w = resultptr[i];
+    if (newidx[w] < 0) newidx[w] = numused++;
+  }
+
+  mesh->vertices.truncate(0);
+  mesh->normals.truncate(0);
+  mesh->texcoords.truncate(0);
+  mesh->colors.truncate(0);
+  SbList<int> order(numused);
+  for (i = 0; i < numused; i++) order.append(0);
+  for (i = 0; i < weldedsrc.getLength(); i++) {
+    if (newidx[i] >= 0) order[newidx[i]] = i;
+  }
+  mesh->colorpervertex = FALSE;
+  for (i = 0; i < numused; i++) {
+    const int w = order[i];
+    const int src = weldedsrc[w];
+    mesh->vertices.append(welder.getPoint(weldedpos[w]));
+    if (lighting) mesh->normals.append(normals[src]);
+    if (hastexture) mesh->texcoords.append(texcoords[src]);
+    mesh->colors.append(colors[src]);
+    if (colors[src] != mesh->colors[0]) mesh->colorpervertex = TRUE;
+  }
+  for (i = 0; i < numresult; i++) resultptr[i] = newidx[resultptr[i]];
+  delete[] newidx;
+}
+
+typedef struct {
+  SbList<soreorganize_mesh *> * meshes;
+  float tolerance;
+} soreorganize_mesh_closure;
+
+static void
+soreorganize_mesh_worker(void * closure, int first, int last)
+{
+  soreorganize_mesh_closure * data = static_cast<soreorganize_mesh_closure *>(closure);
+  for (int idx = first; idx < last; idx++) {
+    soreorganize_build_mesh((*data->meshes)[idx], data->tolerance);
+  }
+}
+
+// *************************************************************************
 
 class SoReorganizeActionP {
  public:
@@ -295,9 +863,48 @@ class SoReorganizeActionP {
       gentristrips(FALSE),
       genvp(FALSE),
       matchidx(TRUE),
+      optimizemeshes(FALSE),
+      weldtolerance(0.0f),
       cbaction(SbViewportRegion(640, 480)),
       pvcache(NULL)
   {
+    this->numthreads = 4;
+    const char * env = coin_getenv("COIN_REORGANIZE_THREADS");
+    if (env) { this->numthreads = SbMax(atoi(env), 1); }
+    this->resetStatistics();
+
+    // nodes whose effect on the state is compared for merging shapes,
+    // or which don't change how shapes are rendered
+    this->knowntypes.append(SoGroup::getClassTypeId());
+    this->knowntypes.append(SoShape::getClassTypeId());
+    this->knowntypes.append(SoTransformation::getClassTypeId());
+    this->knowntypes.append(SoMaterial::getClassTypeId());
+    this->knowntypes.append(SoBaseColor::getClassTypeId());
+    this->knowntypes.append(SoPackedColor::getClassTypeId());
+    this->knowntypes.append(SoMaterialBinding::getClassTypeId());
+    this->knowntypes.append(SoNormalBinding::getClassTypeId());
+    this->knowntypes.append(SoTextureCoordinateBinding::getClassTypeId());
+    this->knowntypes.append(SoCoordinate3::getClassTypeId());
+    this->knowntypes.append(SoCoordinate4::getClassTypeId());
+    this->knowntypes.append(SoNormal::getClassTypeId());
+    this->knowntypes.append(SoVertexProperty::getClassTypeId());
+    this->knowntypes.append(SoShapeHints::getClassTypeId());
+    this->knowntypes.append(SoDrawStyle::getClassTypeId());
+    this->knowntypes.append(SoLightModel::getClassTypeId());
+    this->knowntypes.append(SoLight::getClassTypeId());
+    this->knowntypes.append(SoClipPlane::getClassTypeId());
+    this->knowntypes.append(SoEnvironment::getClassTypeId());
+    this->knowntypes.append(SoPolygonOffset::getClassTypeId());
+    this->knowntypes.append(SoPickStyle::getClassTypeId());
+    this->knowntypes.append(SoComplexity::getClassTypeId());
+    this->knowntypes.append(SoTexture::getClassTypeId());
+    this->knowntypes.append(SoTextureCoordinate2::getClassTypeId());
+    this->knowntypes.append(SoTextureCoordinate3::getClassTypeId());
+    this->knowntypes.append(SoTextureCoordinateFunction::getClassTypeId());
+    this->knowntypes.append(SoCamera::getClassTypeId());
+    this->knowntypes.append(SoInfo::getClassTypeId());
+    this->knowntypes.append(SoLabel::getClassTypeId());
+    cbaction.addPreCallback(SoNode::getClassTypeId(), pre_node_cb, this);
     cbaction.addTriangleCallback(SoVertexShape::getClassTypeId(), triangle_cb, this);
     cbaction.addLineSegmentCallback(SoVertexShape::getClassTypeId(), line_segment_cb, this);
 
@@ -331,6 +938,9 @@ class SoReorganizeActionP {
   SbBool gentristrips;
   SbBool genvp;
   SbBool matchidx;
+  SbBool optimizemeshes;
+  float weldtolerance;
+  int numthreads;
   SbList <SbBool> needtexcoords;
   int lastneeded;
   int numtriangles;
@@ -348,6 +958,21 @@ class SoReorganizeActionP {
   SoSearchAction sa;
   SoPrimitiveVertexCache * pvcache;
 
+  // for the mesh optimization
+  SbMatrix modelmatrix;
+  soreorganize_key key;
+  SbList<const SoNode *> othernodes;
+  SoTypeList knowntypes;
+  SbList<soreorganize_shape *> shapes;
+
+  int numshapesbefore;
+  int numshapesafter;
+  int numverticesbefore;
+  int numverticesafter;
+  int numtrianglesbefore;
+  int numtrianglesafter;
+
+  static SoCallbackAction::Response pre_node_cb(void * userdata, SoCallbackAction * action, const SoNode * node);
   static SoCallbackAction::Response pre_shape_cb(void * userdata, SoCallbackAction * action, const SoNode * node);
   static SoCallbackAction::Response post_shape_cb(void * userdata, SoCallbackAction * action, const SoNode * node);
   static void triangle_cb(void * userdata, SoCallbackAction * action,
@@ -360,6 +985,11 @@ class SoReorganizeActionP {
                               const SoPrimitiveVertex * v2);
 
   SbBool initShape(SoCallbackAction * action);
+  void initKey(SoState * state);
+  void resetStatistics(void);
+  void collectShape(SoFullPath * path);
+  void optimizeShapes(void);
+  void replaceMesh(soreorganize_mesh * mesh);
   void replaceNode(SoFullPath * path);
   void replaceIfs(SoFullPath * path);
   void replaceVrmlIfs(SoFullPath * path);
@@ -472,17 +1102,154 @@ SoReorganizeAction::getSimplifier(void) const
   return NULL;
 }
 
+/*!
+  Sets whether the triangle shapes should be optimized as meshes.
+  Default is \c FALSE.
+
+  When enabled, shapes rendered with the same state are merged into
+  one SoIndexedFaceSet, even when they are under different
+  separators and transformations, and the others are removed from
+  the scene graph. Each mesh has its vertices welded (see
+  setWeldTolerance()), its degenerate and duplicate triangles
+  removed, and its triangles and vertices ordered to reuse the
+  vertices in the post transform vertex cache of the graphics card.
+
+  Only shapes under SoGroup and SoSeparator nodes, which aren't
+  instanced, textured or transparent, are merged with other shapes.
+  The other triangle shapes are optimized one by one. Note that a
+  merged mesh is culled as a whole, so merging shapes spread over a
+  large area might make culling less efficient.
+
+  The meshes are built in parallel, in the number of threads given by
+  the environment variable \c COIN_REORGANIZE_THREADS (default 4).
+
+  \since Coin 4.0
+*/
+void
+SoReorganizeAction::optimizeMeshes(SbBool onoff)
+{
+  PRIVATE(this)->optimizemeshes = onoff;
+}
+
+/*!
+  Returns whether the triangle shapes are optimized as meshes.
+
+  \since Coin 4.0
+*/
+SbBool
+SoReorganizeAction::areMeshesOptimized(void) const
+{
+  return PRIVATE(this)->optimizemeshes;
+}
+
+/*!
+  Sets the distance within which vertices are welded when meshes are
+  optimized. Default is 0, which only welds vertices at equal
+  positions. Vertices are welded only if their normals, texture
+  coordinates and colors also match.
+
+  \since Coin 4.0
+*/
+void
+SoReorganizeAction::setWeldTolerance(const float tolerance)
+{
+  PRIVATE(this)->weldtolerance = SbMax(tolerance, 0.0f);
+}
+
+/*!
+  Returns the weld tolerance.
+
+  \since Coin 4.0
+*/
+float
+SoReorganizeAction::getWeldTolerance(void) const
+{
+  return PRIVATE(this)->weldtolerance;
+}
+
+/*!
+  Returns the number of shapes replaced by the last apply(), which is
+  the number of draw calls they needed.
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getNumShapesBefore(void) const
+{
+  return PRIVATE(this)->numshapesbefore;
+}
+
+/*!
+  Returns the number of shapes created by the last apply().
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getNumShapesAfter(void) const
+{
+  return PRIVATE(this)->numshapesafter;
+}
+
+/*!
+  Returns the number of distinct vertices of the shapes replaced by
+  the last apply().
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getNumVerticesBefore(void) const
+{
+  return PRIVATE(this)->numverticesbefore;
+}
+
+/*!
+  Returns the number of vertices of the shapes created by the last
+  apply().
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getNumVerticesAfter(void) const
+{
+  return PRIVATE(this)->numverticesafter;
+}
+
+/*!
+  Returns the number of triangles of the shapes replaced by the last
+  apply().
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getNumTrianglesBefore(void) const
+{
+  return PRIVATE(this)->numtrianglesbefore;
+}
+
+/*!
+  Returns the number of triangles of the shapes created by the last
+  apply().
+
+  \since Coin 4.0
+*/
+int
+SoReorganizeAction::getNumTrianglesAfter(void) const
+{
+  return PRIVATE(this)->numtrianglesafter;
+}
+
 void
 SoReorganizeAction::apply(SoNode * root)
 {
   int i;
+  PRIVATE(this)->resetStatistics();
   PRIVATE(this)->sa.setType(SoVertexShape::getClassTypeId());
   PRIVATE(this)->sa.setSearchingAll(TRUE);
   PRIVATE(this)->sa.setInterest(SoSearchAction::ALL);
   PRIVATE(this)->sa.apply(root);
   SoPathList & pl = PRIVATE(this)->sa.getPaths();
   for (i = 0; i < pl.getLength(); i++) {
-    this->apply(pl[i]);
+    PRIVATE(this)->collectShape(reclassify_cast<SoFullPath *>(pl[i]));
   }
   PRIVATE(this)->sa.reset();
 
@@ -494,7 +1261,7 @@ SoReorganizeAction::apply(SoNode * root)
   SoPathList & pl2 = PRIVATE(this)->sa.getPaths();
 
   for (i = 0; i < pl2.getLength(); i++) {
-    this->apply(pl2[i]);
+    PRIVATE(this)->collectShape(reclassify_cast<SoFullPath *>(pl2[i]));
   }
   PRIVATE(this)->sa.reset();
 
@@ -504,25 +1271,30 @@ SoReorganizeAction::apply(SoNode * root)
   PRIVATE(this)->sa.apply(root);
   SoPathList & pl3 = PRIVATE(this)->sa.getPaths();
   for (i = 0; i < pl3.getLength(); i++) {
-    this->apply(pl3[i]);
+    PRIVATE(this)->collectShape(reclassify_cast<SoFullPath *>(pl3[i]));
   }
   PRIVATE(this)->sa.reset();
 #endif // HAVE_VRML97
+
+  PRIVATE(this)->optimizeShapes();
 }
 
 void
 SoReorganizeAction::apply(SoPath * path)
 {
-  PRIVATE(this)->cbaction.apply(path);
-  PRIVATE(this)->replaceNode(reclassify_cast<SoFullPath *>(path));
+  PRIVATE(this)->resetStatistics();
+  PRIVATE(this)->collectShape(reclassify_cast<SoFullPath *>(path));
+  PRIVATE(this)->optimizeShapes();
 }
 
 void
 SoReorganizeAction::apply(const SoPathList & pathlist, SbBool COIN_UNUSED_ARG(obeysrules))
 {
+  PRIVATE(this)->resetStatistics();
   for (int i = 0; i < pathlist.getLength(); i++) {
-    this->apply(pathlist[i]);
+    PRIVATE(this)->collectShape(reclassify_cast<SoFullPath *>(pathlist[i]));
   }
+  PRIVATE(this)->optimizeShapes();
 }
 
 void
@@ -545,6 +1317,23 @@ SoReorganizeAction::beginTraversal(SoNode * /* node */)
 }
 
 
+// Collects the nodes traversed before a shape which might change how
+// it is rendered, but aren't reflected in the state compared for
+// merging shapes, like shader programs and callbacks.
+SoCallbackAction::Response
+SoReorganizeActionP::pre_node_cb(void * userdata, SoCallbackAction * COIN_UNUSED_ARG(action), const SoNode * node)
+{
+  SoReorganizeActionP * thisp = static_cast<SoReorganizeActionP *>(userdata);
+  if (!thisp->optimizemeshes) return SoCallbackAction::CONTINUE;
+
+  const SoTypeList & known = thisp->knowntypes;
+  for (int i = 0; i < known.getLength(); i++) {
+    if (node->isOfType(known[i])) return SoCallbackAction::CONTINUE;
+  }
+  thisp->othernodes.append(node);
+  return SoCallbackAction::CONTINUE;
+}
+
 SoCallbackAction::Response
 SoReorganizeActionP::pre_shape_cb(void * userdata, SoCallbackAction * COIN_UNUSED_ARG(action), const SoNode * node)
 {
@@ -704,15 +1493,278 @@ SoReorganizeActionP::initShape(SoCallbackAction * action)
     float transp = SoLazyElement::getTransparency(state, 0);
     this->diffusecolor = SbColor4f(diffuse, 1.0f - transp);
   }
+  if (canrenderasvertexarray && this->optimizemeshes) {
+    this->initKey(state);
+  }
   return canrenderasvertexarray;
 }
 
+// Stores the model matrix and the state which must be equal for
+// shapes to be merged.
+void
+SoReorganizeActionP::initKey(SoState * state)
+{
+  int i;
+  soreorganize_key & k = this->key;
+  this->modelmatrix = SoModelMatrixElement::get(state);
+
+  k.lighting = this->lighting;
+  k.shapeflags = SoShapeStyleElement::get(state)->getFlags();
+  k.transparencytype = SoShapeStyleElement::getTransparencyType(state);
+  k.ambient = SoLazyElement::getAmbient(state);
+  k.emissive = SoLazyElement::getEmissive(state);
+  k.specular = SoLazyElement::getSpecular(state);
+  k.shininess = SoLazyElement::getShininess(state);
+
+  SoShapeHintsElement::VertexOrdering vo;
+  SoShapeHintsElement::ShapeType st;
+  SoShapeHintsElement::FaceType ft;
+  SoShapeHintsElement::get(state, vo, st, ft);
+  k.vertexordering = static_cast<int>(vo);
+  k.shapetype = static_cast<int>(st);
+
+  k.drawstyle = static_cast<int>(SoDrawStyleElement::get(state));
+  k.linewidth = SoLineWidthElement::get(state);
+  k.pointsize = SoPointSizeElement::get(state);
+  k.linepattern = SoLinePatternElement::get(state);
+  k.pickstyle = static_cast<int>(SoPickStyleElement::get(state));
+
+  SoEnvironmentElement::get(state, k.ambientintensity, k.ambientcolor,
+                            k.attenuation, k.fogtype, k.fogcolor,
+                            k.fogvisibility, k.fogstart);
+
+  SoPolygonOffsetElement::Style styles;
+  SoPolygonOffsetElement::get(state, k.offsetfactor, k.offsetunits,
+                              styles, k.offseton);
+  k.offsetstyles = static_cast<int>(styles);
+
+  const SoNodeList & lights = SoLightElement::getLights(state);
+  k.lights.truncate(0);
+  k.lightmatrices.truncate(0);
+  for (i = 0; i < lights.getLength(); i++) {
+    k.lights.append(lights[i]);
+    k.lightmatrices.append(SoLightElement::getMatrix(state, i));
+  }
+
+  const SoClipPlaneElement * clipelem = SoClipPlaneElement::getInstance(state);
+  k.clipplanes.truncate(0);
+  for (i = 0; i < clipelem->getNum(); i++) {
+    k.clipplanes.append(clipelem->get(i, TRUE));
+  }
+
+  k.othernodes = this->othernodes;
+}
+
+void
+SoReorganizeActionP::resetStatistics(void)
+{
+  this->numshapesbefore = 0;
+  this->numshapesafter = 0;
+  this->numverticesbefore = 0;
+  this->numverticesafter = 0;
+  this->numtrianglesbefore = 0;
+  this->numtrianglesafter = 0;
+}
+
+// Converts the shape at the end of the path. Triangle shapes are kept
+// for optimizeShapes() when meshes are optimized, the others are
+// replaced right away.
+void
+SoReorganizeActionP::collectShape(SoFullPath * path)
+{
+  this->othernodes.truncate(0);
+  this->cbaction.apply(path);
+  if (this->pvcache == NULL) return;
+
+  if (!this->optimizemeshes || this->isvrml || this->numtriangles == 0 ||
+      path->getLength() < 2) {
+    this->replaceNode(path);
+    return;
+  }
+  this->pvcache->fit();
+
+  soreorganize_shape * shape = new soreorganize_shape;
+  shape->path = path;
+  shape->path->ref();
+  shape->pvcache = this->pvcache;
+  this->pvcache = NULL;
+  shape->matrix = this->modelmatrix;
+  shape->key = this->key;
+  shape->hastexture = this->hastexture;
+
+  // transparent shapes are left alone, as merging them changes the
+  // order they are blended in
+  shape->mergeable = !this->hastexture;
+  const int numv = shape->pvcache->getNumVertices();
+  const uint8_t * rgba = shape->pvcache->getColorArray();
+  for (int i = 0; shape->mergeable && i < numv; i++) {
+    if (rgba[i*4+3] != 255) shape->mergeable = FALSE;
+  }
+  // the shape must be rendered whenever the other shapes are
+  const SoType group = SoGroup::getClassTypeId();
+  const SoType separator = SoSeparator::getClassTypeId();
+  for (int j = 0; shape->mergeable && j < path->getLength() - 1; j++) {
+    const SoType type = path->getNode(j)->getTypeId();
+    if (type != group && type != separator) shape->mergeable = FALSE;
+  }
+  this->shapes.append(shape);
+}
+
+// Merges the collected shapes into meshes, optimizes the meshes and
+// replaces the shapes with them.
+void
+SoReorganizeActionP::optimizeShapes(void)
+{
+  int i, j;
+  if (this->shapes.getLength() == 0) return;
+
+  // instanced shapes are optimized, but not merged
+  SbHash<const SoNode *, int> instances;
+  for (i = 0; i < this->shapes.getLength(); i++) {
+    const SoNode * tail = this->shapes[i]->path->getTail();
+    int n = 0;
+    (void) instances.get(tail, n);
+    instances.put(tail, n + 1);
+  }
+
+  SbList<soreorganize_mesh *> meshes;
+  SbList<soreorganize_mesh *> mergemeshes;
+  for (i = 0; i < this->shapes.getLength(); i++) {
+    soreorganize_shape * shape = this->shapes[i];
+    int n = 0;
+    (void) instances.get(shape->path->getTail(), n);
+    if (n > 1) shape->mergeable = FALSE;
+
+    soreorganize_mesh * mesh = NULL;
+    if (shape->mergeable) {
+      for (j = 0; j < mergemeshes.getLength(); j++) {
+        if (mergemeshes[j]->shapes[0]->key == shape->key) {
+          mesh = mergemeshes[j];
+          break;
+        }
+      }
+    }
+    if (mesh == NULL) {
+      mesh = new soreorganize_mesh;
+      mesh->lighting = shape->key.lighting;
+      mesh->hastexture = shape->hastexture;
+      meshes.append(mesh);
+      if (shape->mergeable) mergemeshes.append(mesh);
+    }
+    mesh->shapes.append(shape);
+  }
+
+  soreorganize_mesh_closure data;
+  data.meshes = &meshes;
+  data.tolerance = this->weldtolerance;
+
+  cc_parallel_for(meshes.getLength(), 1, this->numthreads,
+                  soreorganize_mesh_worker, &data);
+
+  // replace the first shape of every mesh before removing any shapes,
+  // so the indices in the paths are still valid
+  for (i = 0; i < meshes.getLength(); i++) {
+    soreorganize_mesh * mesh = meshes[i];
+    this->replaceMesh(mesh);
+    this->numshapesbefore += mesh->shapes.getLength();
+    this->numshapesafter++;
+    this->numverticesbefore += mesh->numverticesbefore;
+    this->numverticesafter += mesh->vertices.getLength();
+    this->numtrianglesbefore += mesh->numtrianglesbefore;
+    this->numtrianglesafter += mesh->indices.getLength() / 3;
+  }
+  for (i = 0; i < meshes.getLength(); i++) {
+    soreorganize_mesh * mesh = meshes[i];
+    for (j = 1; j < mesh->shapes.getLength(); j++) {
+      SoFullPath * path = mesh->shapes[j]->path;
+      SoGroup * parent = coin_assert_cast<SoGroup *>(path->getNodeFromTail(1));
+      const int idx = parent->findChild(path->getTail());
+      if (idx >= 0) parent->removeChild(idx);
+    }
+    delete mesh;
+  }
+
+  for (i = 0; i < this->shapes.getLength(); i++) {
+    this->shapes[i]->pvcache->unref();
+    this->shapes[i]->path->unref();
+    delete this->shapes[i];
+  }
+  this->shapes.truncate(0);
+}
+
+void
+SoReorganizeActionP::replaceMesh(soreorganize_mesh * mesh)
+{
+  SoFullPath * path = mesh->shapes[0]->path;
+  SoNode * parent = path->getNodeFromTail(1);
+  if (!parent->isOfType(SoGroup::getClassTypeId())) {
+    return;
+  }
+
+  const int numv = mesh->vertices.getLength();
+  SoVertexProperty * vp = new SoVertexProperty;
+  vp->vertex.setValues(0, numv, mesh->vertices.getArrayPtr());
+  if (mesh->lighting) {
+    vp->normalBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+    vp->normal.setValues(0, numv, mesh->normals.getArrayPtr());
+  }
+  else {
+    vp->normalBinding = SoVertexProperty::OVERALL;
+  }
+  if (mesh->hastexture) {
+    vp->texCoord.setValues(0, numv, mesh->texcoords.getArrayPtr());
+  }
+  if (mesh->colorpervertex) {
+    vp->materialBinding = SoVertexProperty::PER_VERTEX_INDEXED;
+    vp->orderedRGBA.setValues(0, numv, mesh->colors.getArrayPtr());
+  }
+  else {
+    vp->materialBinding = SoVertexProperty::OVERALL;
+    if (numv) vp->orderedRGBA = mesh->colors[0];
+  }
+
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+  ifs->ref();
+  ifs->vertexProperty = vp;
+  ifs->normalIndex.setNum(0);
+  ifs->materialIndex.setNum(0);
+  ifs->textureCoordIndex.setNum(0);
+
+  const int numtri = mesh->indices.getLength() / 3;
+  const int32_t * indices = mesh->indices.getArrayPtr();
+  ifs->coordIndex.setNum(numtri * 4);
+  int32_t * ptr = ifs->coordIndex.startEditing();
+  for (int i = 0; i < numtri; i++) {
+    *ptr++ = indices[i*3];
+    *ptr++ = indices[i*3+1];
+    *ptr++ = indices[i*3+2];
+    *ptr++ = -1;
+  }
+  ifs->coordIndex.finishEditing();
+
+  int idx = path->getIndexFromTail(0);
+  path->pop();
+  SoGroup * g = coin_assert_cast<SoGroup *>(parent);
+  g->replaceChild(idx, ifs);
+  path->push(idx);
+  ifs->unrefNoDelete();
+}
+
 void
 SoReorganizeActionP::replaceNode(SoFullPath * path)
 {
   if (this->pvcache == NULL) return;
   this->pvcache->fit(); // needed to do optimize-sort of data
 
+  const int numv = this->pvcache->getNumVertices();
+  const int numtri = this->pvcache->getNumTriangleIndices() / 3;
+  this->numshapesbefore++;
+  this->numshapesafter++;
+  this->numverticesbefore += numv;
+  this->numverticesafter += numv;
+  this->numtrianglesbefore += numtri;
+  this->numtrianglesafter += numtri;
+
   if (this->pvcache->getNumTriangleIndices()) {
     if (this->isvrml) {
       this->replaceVrmlIfs(path);
@@ -1027,3 +2079,84 @@ SoReorganizeActionP::replaceVrmlIls(SoFullPath * path)
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+BOOST_AUTO_TEST_CASE(optimizeMeshes)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoMaterial * mat = new SoMaterial;
+  mat->diffuseColor.setValue(1.0f, 0.0f, 0.0f);
+  root->addChild(mat);
+
+  // four 2x2 grids of quads next to each other, every quad with its
+  // own coordinates, a duplicate of the first quad and a degenerate
+  // triangle
+  for (int k = 0; k < 4; k++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * t = new SoTranslation;
+    t->translation.setValue(float(k * 2), 0.0f, 0.0f);
+    SoCoordinate3 * coords = new SoCoordinate3;
+    SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+    int n = 0;
+    for (int y = 0; y < 2; y++) {
+      for (int x = 0; x < 2; x++) {
+        coords->point.set1Value(n, SbVec3f(float(x), float(y), 0.0f));
+        coords->point.set1Value(n+1, SbVec3f(float(x+1), float(y), 0.0f));
+        coords->point.set1Value(n+2, SbVec3f(float(x+1), float(y+1), 0.0f));
+        coords->point.set1Value(n+3, SbVec3f(float(x), float(y+1), 0.0f));
+        for (int i = 0; i < 4; i++) {
+          ifs->coordIndex.set1Value(ifs->coordIndex.getNum(), n + i);
+        }
+        ifs->coordIndex.set1Value(ifs->coordIndex.getNum(), -1);
+        n += 4;
+      }
+    }
+    static const int32_t extra[] = { 0, 1, 2, 3, -1, 0, 1, 1, -1 };
+    ifs->coordIndex.setValues(ifs->coordIndex.getNum(), 9, extra);
+    sep->addChild(t);
+    sep->addChild(coords);
+    sep->addChild(ifs);
+    root->addChild(sep);
+  }
+
+  SoReorganizeAction ra;
+  ra.optimizeMeshes(TRUE);
+  ra.apply(root);
+
+  BOOST_CHECK_EQUAL(ra.getNumShapesBefore(), 4);
+  BOOST_CHECK_EQUAL(ra.getNumShapesAfter(), 1);
+  BOOST_CHECK_EQUAL(ra.getNumTrianglesAfter(), 32);
+  BOOST_CHECK_MESSAGE(ra.getNumTrianglesBefore() > 32, "degenerate and duplicate triangles should be counted");
+  BOOST_CHECK_EQUAL(ra.getNumVerticesAfter(), 27);
+
+  SoSearchAction sa;
+  sa.setType(SoIndexedFaceSet::getClassTypeId());
+  sa.setInterest(SoSearchAction::ALL);
+  sa.apply(root);
+  BOOST_CHECK_EQUAL(sa.getPaths().getLength(), 1);
+  sa.reset();
+
+  // the shapes must stay where they were
+  SoGetBoundingBoxAction bba(SbViewportRegion(100, 100));
+  bba.apply(root);
+  const SbBox3f box = bba.getBoundingBox();
+  BOOST_CHECK_MESSAGE(box.getMin() == SbVec3f(0.0f, 0.0f, 0.0f) &&
+                      box.getMax() == SbVec3f(8.0f, 2.0f, 0.0f),
+                      "merged mesh should cover the original shapes");
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
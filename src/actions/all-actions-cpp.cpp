@@ -30,6 +30,7 @@
 
 #include "SoAction.cpp"
 #include "SoBoxHighlightRenderAction.cpp"
+#include "SoBoxPickAction.cpp"
 #include "SoCallbackAction.cpp"
 #include "SoGLRenderAction.cpp"
 #include "SoGetBoundingBoxAction.cpp"
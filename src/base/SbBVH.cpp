@@ -0,0 +1,825 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SbBVH noheader
+  \brief Bounding volume hierarchy of axis aligned boxes, for spatial queries.
+
+  The tree is built once from a set of boxes, and answers which of
+  the boxes are touched by a box, a sphere, a frustum or a ray. It is
+  used for the triangles of shapes in collision tests and picking.
+
+  build() splits the set of boxes top-down, at the split found with
+  the binned surface area heuristic: the box centers are sorted into
+  a number of bins along the longest axis, and the set is split
+  between the bins where the summed surface area times box count of
+  the two halves is smallest. This gives a lot better trees than
+  median splits for uneven distributions, like meshes with small and
+  large triangles. The binary tree is then collapsed into a tree with
+  four children per node, which is half as deep.
+
+  The nodes are stored in one array, with the boxes of the four
+  children stored coordinate by coordinate. Queries test all four
+  children of a node at the same time, using SSE2 instructions when
+  available.
+
+  When the boxes move, setBox() followed by refit() updates the
+  bounds while keeping the tree structure.
+
+  Compared to SbOctTree, items are stored by index rather than
+  pointer, and no callbacks are needed for the tests.
+*/
+
+#include "base/SbBVH.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <Inventor/SbPlane.h>
+#include <Inventor/SbSphere.h>
+
+#include "tidbitsp.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#ifdef COIN_HAVE_X86_SIMD
+#include <emmintrin.h>
+#endif // COIN_HAVE_X86_SIMD
+
+// *************************************************************************
+
+// a node of the binary tree made before collapsing
+struct SbBVH::BuildNode {
+  SbBox3f box;
+  int child[2]; // -1 for leaves
+  int item;
+};
+
+namespace {
+
+// the number of bins for the surface area heuristic
+const int SBBVH_NUMBINS = 16;
+
+// beyond this depth, the binary tree is split at the median, to bound
+// the depth for pathological distributions
+const int SBBVH_MAXSAHLEVEL = 48;
+
+inline float
+sbbvh_area(const SbBox3f & box)
+{
+  if (box.isEmpty()) return 0.0f;
+  const SbVec3f d = box.getMax() - box.getMin();
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+// orders item indices on the box center along one axis
+class sbbvh_center_less {
+public:
+  sbbvh_center_less(const SbVec3f * centersarg, const int axisarg)
+    : centers(centersarg), axis(axisarg) { }
+  bool operator()(const int a, const int b) const {
+    return this->centers[a][this->axis] < this->centers[b][this->axis];
+  }
+private:
+  const SbVec3f * centers;
+  int axis;
+};
+
+// true for the items with centers in the bins left of the split
+class sbbvh_in_left_bins {
+public:
+  sbbvh_in_left_bins(const SbVec3f * centersarg, const int axisarg,
+                     const float minarg, const float scalearg, const int splitarg)
+    : centers(centersarg), axis(axisarg), min(minarg), scale(scalearg), split(splitarg) { }
+  bool operator()(const int item) const {
+    int bin = static_cast<int>((this->centers[item][this->axis] - this->min) * this->scale);
+    if (bin >= SBBVH_NUMBINS) bin = SBBVH_NUMBINS - 1;
+    return bin <= this->split;
+  }
+private:
+  const SbVec3f * centers;
+  int axis;
+  float min;
+  float scale;
+  int split;
+};
+
+// The tests below return a mask with bit i set if child i of a node
+// is touched. The SSE2 versions do the same computations as the
+// scalar versions, four children at a time.
+
+int
+sbbvh_box_mask(const float (* b)[4], const SbVec3f & qmin, const SbVec3f & qmax)
+{
+  int mask = 0;
+  for (int i = 0; i < 4; i++) {
+    if (b[0][i] <= qmax[0] && b[3][i] >= qmin[0] &&
+        b[1][i] <= qmax[1] && b[4][i] >= qmin[1] &&
+        b[2][i] <= qmax[2] && b[5][i] >= qmin[2]) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+}
+
+int
+sbbvh_sphere_mask(const float (* b)[4], const SbVec3f & center, const float sqrradius)
+{
+  int mask = 0;
+  for (int i = 0; i < 4; i++) {
+    float d = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      float gap = 0.0f;
+      if (center[k] < b[k][i]) gap = b[k][i] - center[k];
+      else if (center[k] > b[k + 3][i]) gap = center[k] - b[k + 3][i];
+      d += gap * gap;
+    }
+    if (d <= sqrradius) mask |= 1 << i;
+  }
+  return mask;
+}
+
+// A box is outside the frustum if its corner farthest along the
+// normal of a plane is on the negative side of the plane.
+int
+sbbvh_frustum_mask(const float (* b)[4], const SbPlane * planes, const int numplanes)
+{
+  int mask = 0;
+  for (int i = 0; i < 4; i++) {
+    int p;
+    for (p = 0; p < numplanes; p++) {
+      const SbVec3f & n = planes[p].getNormal();
+      const float d =
+        n[0] * (n[0] >= 0.0f ? b[3][i] : b[0][i]) +
+        n[1] * (n[1] >= 0.0f ? b[4][i] : b[1][i]) +
+        n[2] * (n[2] >= 0.0f ? b[5][i] : b[2][i]);
+      if (d < planes[p].getDistanceFromOrigin()) break;
+    }
+    if (p == numplanes) mask |= 1 << i;
+  }
+  return mask;
+}
+
+// Slab test. The distances to where the ray enters the boxes are
+// returned in tnear.
+int
+sbbvh_ray_mask(const float (* b)[4], const SbVec3f & origin, const SbVec3f & invdir,
+               const float tmin, const float tmax, float * tnear)
+{
+  int mask = 0;
+  for (int i = 0; i < 4; i++) {
+    float t0 = tmin;
+    float t1 = tmax;
+    for (int k = 0; k < 3; k++) {
+      float ta = (b[k][i] - origin[k]) * invdir[k];
+      float tb = (b[k + 3][i] - origin[k]) * invdir[k];
+      if (ta > tb) std::swap(ta, tb);
+      t0 = SbMax(t0, ta);
+      t1 = SbMin(t1, tb);
+    }
+    tnear[i] = t0;
+    if (t0 <= t1) mask |= 1 << i;
+  }
+  return mask;
+}
+
+#ifdef COIN_HAVE_X86_SIMD
+
+COIN_TARGET_SSE2 int
+sbbvh_box_mask_sse2(const float (* b)[4], const SbVec3f & qmin, const SbVec3f & qmax)
+{
+  __m128 in = _mm_cmple_ps(_mm_loadu_ps(b[0]), _mm_set1_ps(qmax[0]));
+  in = _mm_and_ps(in, _mm_cmple_ps(_mm_loadu_ps(b[1]), _mm_set1_ps(qmax[1])));
+  in = _mm_and_ps(in, _mm_cmple_ps(_mm_loadu_ps(b[2]), _mm_set1_ps(qmax[2])));
+  in = _mm_and_ps(in, _mm_cmpge_ps(_mm_loadu_ps(b[3]), _mm_set1_ps(qmin[0])));
+  in = _mm_and_ps(in, _mm_cmpge_ps(_mm_loadu_ps(b[4]), _mm_set1_ps(qmin[1])));
+  in = _mm_and_ps(in, _mm_cmpge_ps(_mm_loadu_ps(b[5]), _mm_set1_ps(qmin[2])));
+  return _mm_movemask_ps(in);
+}
+
+COIN_TARGET_SSE2 int
+sbbvh_sphere_mask_sse2(const float (* b)[4], const SbVec3f & center, const float sqrradius)
+{
+  const __m128 zero = _mm_setzero_ps();
+  __m128 d = zero;
+  for (int k = 0; k < 3; k++) {
+    const __m128 c = _mm_set1_ps(center[k]);
+    // at most one of these is positive
+    const __m128 below = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(b[k]), c), zero);
+    const __m128 above = _mm_max_ps(_mm_sub_ps(c, _mm_loadu_ps(b[k + 3])), zero);
+    const __m128 gap = _mm_add_ps(below, above);
+    d = _mm_add_ps(d, _mm_mul_ps(gap, gap));
+  }
+  return _mm_movemask_ps(_mm_cmple_ps(d, _mm_set1_ps(sqrradius)));
+}
+
+COIN_TARGET_SSE2 int
+sbbvh_frustum_mask_sse2(const float (* b)[4], const SbPlane * planes, const int numplanes)
+{
+  __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  for (int p = 0; p < numplanes; p++) {
+    const SbVec3f & n = planes[p].getNormal();
+    const __m128 x = _mm_loadu_ps(n[0] >= 0.0f ? b[3] : b[0]);
+    const __m128 y = _mm_loadu_ps(n[1] >= 0.0f ? b[4] : b[1]);
+    const __m128 z = _mm_loadu_ps(n[2] >= 0.0f ? b[5] : b[2]);
+    const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n[0]), x),
+                                           _mm_mul_ps(_mm_set1_ps(n[1]), y)),
+                                _mm_mul_ps(_mm_set1_ps(n[2]), z));
+    in = _mm_and_ps(in, _mm_cmpge_ps(d, _mm_set1_ps(planes[p].getDistanceFromOrigin())));
+    if (_mm_movemask_ps(in) == 0) return 0;
+  }
+  return _mm_movemask_ps(in);
+}
+
+COIN_TARGET_SSE2 int
+sbbvh_ray_mask_sse2(const float (* b)[4], const SbVec3f & origin, const SbVec3f & invdir,
+                    const float tmin, const float tmax, float * tnear)
+{
+  __m128 t0 = _mm_set1_ps(tmin);
+  __m128 t1 = _mm_set1_ps(tmax);
+  for (int k = 0; k < 3; k++) {
+    const __m128 o = _mm_set1_ps(origin[k]);
+    const __m128 inv = _mm_set1_ps(invdir[k]);
+    const __m128 ta = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[k]), o), inv);
+    const __m128 tb = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b[k + 3]), o), inv);
+    t0 = _mm_max_ps(t0, _mm_min_ps(ta, tb));
+    t1 = _mm_min_ps(t1, _mm_max_ps(ta, tb));
+  }
+  _mm_storeu_ps(tnear, t0);
+  return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+}
+
+#endif // COIN_HAVE_X86_SIMD
+
+inline SbBool
+sbbvh_use_sse2(void)
+{
+#ifdef COIN_HAVE_X86_SIMD
+  return coin_runtime_simd() >= COIN_SIMD_SSE2;
+#else // !COIN_HAVE_X86_SIMD
+  return FALSE;
+#endif // !COIN_HAVE_X86_SIMD
+}
+
+// Returns 1 / d, with zero components replaced by a large number, so
+// that the slab tests never multiply zero by infinity.
+SbVec3f
+sbbvh_inverse_direction(const SbVec3f & d)
+{
+  SbVec3f inv;
+  for (int k = 0; k < 3; k++) {
+    if (fabs(d[k]) > 1.0e-30f) inv[k] = 1.0f / d[k];
+    else inv[k] = (d[k] < 0.0f) ? -1.0e30f : 1.0e30f;
+  }
+  return inv;
+}
+
+} // namespace
+
+// The stack of nodes to visit holds at most three siblings per level,
+// plus the node being visited.
+#define SBBVH_STACK(type, name)                                         \
+  type name##local[64];                                                 \
+  type * name = name##local;                                            \
+  const int name##size = 3 * this->depth + 2;                           \
+  if (name##size > 64) name = new type[name##size]
+
+#define SBBVH_STACK_FREE(name)                  \
+  if (name != name##local) delete[] name
+
+// *************************************************************************
+
+/*!
+  Constructor. Makes an empty tree.
+*/
+SbBVH::SbBVH(void)
+  : depth(0)
+{
+}
+
+/*!
+  Destructor.
+*/
+SbBVH::~SbBVH()
+{
+}
+
+/*!
+  Removes all items.
+*/
+void
+SbBVH::clear(void)
+{
+  this->nodes.truncate(0, TRUE);
+  this->boxes.truncate(0, TRUE);
+  this->depth = 0;
+}
+
+/*!
+  Builds the tree for \a numboxes boxes. Item i is \a boxes[i]. Empty
+  boxes are kept as items, but are never found by the queries.
+*/
+void
+SbBVH::build(const SbBox3f * boxesarg, const int numboxes)
+{
+  this->clear();
+  if (numboxes == 0) return;
+
+  int i;
+  SbVec3f * centers = new SbVec3f[numboxes];
+  int * order = new int[numboxes];
+  for (i = 0; i < numboxes; i++) {
+    this->boxes.append(boxesarg[i]);
+    centers[i] = boxesarg[i].isEmpty() ? SbVec3f(0.0f, 0.0f, 0.0f) : boxesarg[i].getCenter();
+    order[i] = i;
+  }
+
+  SbList<BuildNode> buildnodes(2 * numboxes);
+  const int root = this->buildRange(buildnodes, order, numboxes, centers, 0);
+  delete[] order;
+  delete[] centers;
+
+  if (buildnodes[root].child[0] == -1) {
+    // a single item, in a node of its own
+    Node node;
+    for (int k = 0; k < 4; k++) { node.child[k] = -1; }
+    node.child[0] = -2 - buildnodes[root].item;
+    this->nodes.append(node);
+    this->depth = 1;
+  }
+  else {
+    (void) this->collapse(buildnodes, root, 1);
+  }
+  this->refit();
+}
+
+/*!
+  Sets the box of \a item. The tree is not updated before refit() is
+  called.
+*/
+void
+SbBVH::setBox(const int item, const SbBox3f & box)
+{
+  assert(item >= 0 && item < this->boxes.getLength());
+  this->boxes[item] = box;
+}
+
+/*!
+  Updates the bounds of the tree after boxes have been moved with
+  setBox(). The structure of the tree is kept, so the queries get
+  slower if the boxes move a lot relative to each other. Rebuild the
+  tree with build() in that case.
+*/
+void
+SbBVH::refit(void)
+{
+  // children are always stored after their parents
+  for (int i = this->nodes.getLength() - 1; i >= 0; i--) {
+    Node & node = this->nodes[i];
+    for (int k = 0; k < 4; k++) {
+      SbBox3f box;
+      if (node.child[k] >= 0) box = this->getNodeBox(node.child[k]);
+      else if (node.child[k] <= -2) box = this->boxes.getArrayPtr()[-node.child[k] - 2];
+      // unused and empty boxes get inverted bounds, which no test
+      // touches
+      const SbVec3f & min = box.getMin();
+      const SbVec3f & max = box.getMax();
+      for (int c = 0; c < 3; c++) {
+        node.bounds[c][k] = box.isEmpty() ? FLT_MAX : min[c];
+        node.bounds[c + 3][k] = box.isEmpty() ? -FLT_MAX : max[c];
+      }
+    }
+  }
+}
+
+/*!
+  Returns the number of items in the tree.
+*/
+int
+SbBVH::getNumItems(void) const
+{
+  return this->boxes.getLength();
+}
+
+/*!
+  Returns the box of \a item.
+*/
+const SbBox3f &
+SbBVH::getBox(const int item) const
+{
+  return this->boxes.getArrayPtr()[item];
+}
+
+/*!
+  Returns the bounding box of all the items.
+*/
+SbBox3f
+SbBVH::getBoundingBox(void) const
+{
+  if (this->nodes.getLength() == 0) return SbBox3f();
+  return this->getNodeBox(0);
+}
+
+/*!
+  Returns the depth of the tree, 0 if it is empty.
+*/
+int
+SbBVH::getDepth(void) const
+{
+  return this->depth;
+}
+
+/*!
+  Appends the items whose boxes overlap \a box to \a items.
+*/
+void
+SbBVH::findBox(const SbBox3f & box, SbList<int> & items) const
+{
+  if (this->nodes.getLength() == 0 || box.isEmpty()) return;
+  const Node * nodearray = this->nodes.getArrayPtr();
+  const SbVec3f & qmin = box.getMin();
+  const SbVec3f & qmax = box.getMax();
+  const SbBool sse2 = sbbvh_use_sse2();
+
+  SBBVH_STACK(int, stack);
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node & node = nodearray[stack[--top]];
+#ifdef COIN_HAVE_X86_SIMD
+    int mask = sse2 ?
+      sbbvh_box_mask_sse2(node.bounds, qmin, qmax) : sbbvh_box_mask(node.bounds, qmin, qmax);
+#else // !COIN_HAVE_X86_SIMD
+    int mask = sbbvh_box_mask(node.bounds, qmin, qmax);
+#endif // !COIN_HAVE_X86_SIMD
+    for (int k = 0; mask; k++, mask >>= 1) {
+      if (!(mask & 1)) continue;
+      const int child = node.child[k];
+      if (child >= 0) stack[top++] = child;
+      else if (child <= -2) items.append(-child - 2);
+    }
+  }
+  SBBVH_STACK_FREE(stack);
+}
+
+/*!
+  Appends the items whose boxes are touched by \a sphere to \a items.
+*/
+void
+SbBVH::findSphere(const SbSphere & sphere, SbList<int> & items) const
+{
+  if (this->nodes.getLength() == 0) return;
+  const Node * nodearray = this->nodes.getArrayPtr();
+  const SbVec3f & center = sphere.getCenter();
+  const float sqrradius = sphere.getRadius() * sphere.getRadius();
+  const SbBool sse2 = sbbvh_use_sse2();
+
+  SBBVH_STACK(int, stack);
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node & node = nodearray[stack[--top]];
+#ifdef COIN_HAVE_X86_SIMD
+    int mask = sse2 ?
+      sbbvh_sphere_mask_sse2(node.bounds, center, sqrradius) :
+      sbbvh_sphere_mask(node.bounds, center, sqrradius);
+#else // !COIN_HAVE_X86_SIMD
+    int mask = sbbvh_sphere_mask(node.bounds, center, sqrradius);
+#endif // !COIN_HAVE_X86_SIMD
+    for (int k = 0; mask; k++, mask >>= 1) {
+      if (!(mask & 1)) continue;
+      const int child = node.child[k];
+      if (child >= 0) stack[top++] = child;
+      else if (child <= -2) items.append(-child - 2);
+    }
+  }
+  SBBVH_STACK_FREE(stack);
+}
+
+/*!
+  Appends the items whose boxes are inside or partly inside the
+  volume bounded by \a planes to \a items. The planes should have
+  their normals pointing into the volume, like the planes of a view
+  volume from SbViewVolume::getViewVolumePlanes() turned around.
+
+  The test is conservative: a box outside the volume may be found if
+  it crosses the planes outside the volume, close to a corner.
+*/
+void
+SbBVH::findFrustum(const SbPlane * planes, const int numplanes, SbList<int> & items) const
+{
+  if (this->nodes.getLength() == 0) return;
+  const Node * nodearray = this->nodes.getArrayPtr();
+  const SbBool sse2 = sbbvh_use_sse2();
+
+  SBBVH_STACK(int, stack);
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node & node = nodearray[stack[--top]];
+#ifdef COIN_HAVE_X86_SIMD
+    int mask = sse2 ?
+      sbbvh_frustum_mask_sse2(node.bounds, planes, numplanes) :
+      sbbvh_frustum_mask(node.bounds, planes, numplanes);
+#else // !COIN_HAVE_X86_SIMD
+    int mask = sbbvh_frustum_mask(node.bounds, planes, numplanes);
+#endif // !COIN_HAVE_X86_SIMD
+    for (int k = 0; mask; k++, mask >>= 1) {
+      if (!(mask & 1)) continue;
+      const int child = node.child[k];
+      if (child >= 0) stack[top++] = child;
+      else if (child <= -2) items.append(-child - 2);
+    }
+  }
+  SBBVH_STACK_FREE(stack);
+}
+
+/*!
+  Appends the items whose boxes are hit by the ray from \a origin
+  along \a direction, between the distances \a tmin and \a tmax, to
+  \a items. Distances are in units of the length of \a direction, and
+  may be negative. Use -FLT_MAX and FLT_MAX for an infinite line.
+*/
+void
+SbBVH::findRay(const SbVec3f & origin, const SbVec3f & direction,
+               const float tmin, const float tmax, SbList<int> & items) const
+{
+  if (this->nodes.getLength() == 0) return;
+  const Node * nodearray = this->nodes.getArrayPtr();
+  const SbVec3f invdir = sbbvh_inverse_direction(direction);
+  const SbBool sse2 = sbbvh_use_sse2();
+  float tnear[4];
+
+  SBBVH_STACK(int, stack);
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node & node = nodearray[stack[--top]];
+#ifdef COIN_HAVE_X86_SIMD
+    int mask = sse2 ?
+      sbbvh_ray_mask_sse2(node.bounds, origin, invdir, tmin, tmax, tnear) :
+      sbbvh_ray_mask(node.bounds, origin, invdir, tmin, tmax, tnear);
+#else // !COIN_HAVE_X86_SIMD
+    int mask = sbbvh_ray_mask(node.bounds, origin, invdir, tmin, tmax, tnear);
+#endif // !COIN_HAVE_X86_SIMD
+    for (int k = 0; mask; k++, mask >>= 1) {
+      if (!(mask & 1)) continue;
+      const int child = node.child[k];
+      if (child >= 0) stack[top++] = child;
+      else if (child <= -2) items.append(-child - 2);
+    }
+  }
+  SBBVH_STACK_FREE(stack);
+}
+
+/*!
+  Calls \a callback for the items whose boxes are hit by the ray from
+  \a origin along \a direction, between the distances \a tmin and \a
+  tmax. Children are visited closest first, and the far limit of the
+  ray is set to what the callback returns, so that boxes behind the
+  closest hit found so far are skipped. Returns the final far limit.
+
+  This is for finding the closest hit along a ray, where the
+  callback does the exact test of the item.
+*/
+float
+SbBVH::traceRay(const SbVec3f & origin, const SbVec3f & direction,
+                const float tmin, const float tmax,
+                SbBVHRayCB * callback, void * closure) const
+{
+  float tfar = tmax;
+  if (this->nodes.getLength() == 0) return tfar;
+  const Node * nodearray = this->nodes.getArrayPtr();
+  const SbVec3f invdir = sbbvh_inverse_direction(direction);
+  const SbBool sse2 = sbbvh_use_sse2();
+  float tnear[4];
+
+  // the stack holds the entry distances together with the nodes
+  SBBVH_STACK(int, stack);
+  SBBVH_STACK(float, stackdist);
+  int top = 0;
+  stack[top] = 0;
+  stackdist[top++] = tmin;
+  while (top > 0) {
+    --top;
+    if (stackdist[top] > tfar) continue;
+    const Node & node = nodearray[stack[top]];
+#ifdef COIN_HAVE_X86_SIMD
+    const int mask = sse2 ?
+      sbbvh_ray_mask_sse2(node.bounds, origin, invdir, tmin, tfar, tnear) :
+      sbbvh_ray_mask(node.bounds, origin, invdir, tmin, tfar, tnear);
+#else // !COIN_HAVE_X86_SIMD
+    const int mask = sbbvh_ray_mask(node.bounds, origin, invdir, tmin, tfar, tnear);
+#endif // !COIN_HAVE_X86_SIMD
+    if (mask == 0) continue;
+
+    // sort the hit children on distance, closest first
+    int order[4];
+    int num = 0;
+    for (int k = 0; k < 4; k++) {
+      if (!(mask & (1 << k)) || node.child[k] == -1) continue;
+      int pos = num++;
+      while (pos > 0 && tnear[order[pos - 1]] > tnear[k]) {
+        order[pos] = order[pos - 1];
+        pos--;
+      }
+      order[pos] = k;
+    }
+
+    // items are tested right away, nodes are pushed farthest first
+    for (int i = 0; i < num; i++) {
+      const int k = order[i];
+      if (node.child[k] <= -2 && tnear[k] <= tfar) {
+        tfar = callback(closure, -node.child[k] - 2, tfar);
+      }
+    }
+    for (int j = num - 1; j >= 0; j--) {
+      const int k = order[j];
+      if (node.child[k] >= 0) {
+        stack[top] = node.child[k];
+        stackdist[top++] = tnear[k];
+      }
+    }
+  }
+  SBBVH_STACK_FREE(stackdist);
+  SBBVH_STACK_FREE(stack);
+  return tfar;
+}
+
+// *************************************************************************
+
+// Builds the binary tree for count items from order. Returns the
+// index of the root of the subtree.
+int
+SbBVH::buildRange(SbList<BuildNode> & buildnodes, int * order, const int count,
+                  const SbVec3f * centers, const int level)
+{
+  const int idx = buildnodes.getLength();
+  BuildNode bn;
+  bn.child[0] = bn.child[1] = -1;
+  bn.item = -1;
+  for (int i = 0; i < count; i++) { bn.box.extendBy(this->boxes[order[i]]); }
+  buildnodes.append(bn);
+
+  if (count == 1) {
+    buildnodes[idx].item = order[0];
+    return idx;
+  }
+
+  SbBox3f cbox;
+  for (int i = 0; i < count; i++) { cbox.extendBy(centers[order[i]]); }
+  const SbVec3f extent = cbox.getMax() - cbox.getMin();
+  int axis = 0;
+  if (extent[1] > extent[axis]) axis = 1;
+  if (extent[2] > extent[axis]) axis = 2;
+
+  int numleft = count / 2;
+  if (extent[axis] <= 0.0f) {
+    // all centers in the same place, any split is as good
+  }
+  else if (level >= SBBVH_MAXSAHLEVEL) {
+    std::nth_element(order, order + numleft, order + count,
+                     sbbvh_center_less(centers, axis));
+  }
+  else {
+    // sort the items into bins on their centers
+    const float cmin = cbox.getMin()[axis];
+    const float scale = float(SBBVH_NUMBINS) / extent[axis];
+    int bincount[SBBVH_NUMBINS];
+    SbBox3f binbox[SBBVH_NUMBINS];
+    int b;
+    for (b = 0; b < SBBVH_NUMBINS; b++) { bincount[b] = 0; }
+    for (int i = 0; i < count; i++) {
+      b = static_cast<int>((centers[order[i]][axis] - cmin) * scale);
+      if (b >= SBBVH_NUMBINS) b = SBBVH_NUMBINS - 1;
+      bincount[b]++;
+      binbox[b].extendBy(this->boxes[order[i]]);
+    }
+
+    // the cost of splitting after bin b is the area times count of
+    // the boxes on each side
+    float rightcost[SBBVH_NUMBINS];
+    SbBox3f acc;
+    int n = 0;
+    for (b = SBBVH_NUMBINS - 1; b > 0; b--) {
+      acc.extendBy(binbox[b]);
+      n += bincount[b];
+      rightcost[b] = sbbvh_area(acc) * float(n);
+    }
+    int best = -1;
+    float bestcost = FLT_MAX;
+    acc.makeEmpty();
+    n = 0;
+    for (b = 0; b < SBBVH_NUMBINS - 1; b++) {
+      acc.extendBy(binbox[b]);
+      n += bincount[b];
+      if (n == 0 || n == count) continue;
+      const float cost = sbbvh_area(acc) * float(n) + rightcost[b + 1];
+      if (cost < bestcost) {
+        bestcost = cost;
+        best = b;
+      }
+    }
+
+    if (best == -1) {
+      std::nth_element(order, order + numleft, order + count,
+                       sbbvh_center_less(centers, axis));
+    }
+    else {
+      int * mid = std::partition(order, order + count,
+                                 sbbvh_in_left_bins(centers, axis, cmin, scale, best));
+      numleft = static_cast<int>(mid - order);
+    }
+  }
+
+  const int left = this->buildRange(buildnodes, order, numleft, centers, level + 1);
+  const int right = this->buildRange(buildnodes, order + numleft, count - numleft,
+                                     centers, level + 1);
+  buildnodes[idx].child[0] = left;
+  buildnodes[idx].child[1] = right;
+  return idx;
+}
+
+// Makes a node of up to four children from the inner binary node
+// buildnode, by repeatedly opening the child with the largest
+// surface area. Returns the index of the new node.
+int
+SbBVH::collapse(const SbList<BuildNode> & buildnodes, const int buildnode, const int level)
+{
+  const int idx = this->nodes.getLength();
+  Node node;
+  int k;
+  for (k = 0; k < 4; k++) { node.child[k] = -1; }
+  this->nodes.append(node);
+  this->depth = SbMax(this->depth, level);
+
+  int slots[4];
+  int num = 2;
+  slots[0] = buildnodes[buildnode].child[0];
+  slots[1] = buildnodes[buildnode].child[1];
+  while (num < 4) {
+    int open = -1;
+    float maxarea = -1.0f;
+    for (k = 0; k < num; k++) {
+      const BuildNode & bn = buildnodes[slots[k]];
+      if (bn.child[0] != -1 && sbbvh_area(bn.box) > maxarea) {
+        maxarea = sbbvh_area(bn.box);
+        open = k;
+      }
+    }
+    if (open == -1) break;
+    const BuildNode & bn = buildnodes[slots[open]];
+    slots[open] = bn.child[0];
+    slots[num++] = bn.child[1];
+  }
+
+  for (k = 0; k < num; k++) {
+    const BuildNode & bn = buildnodes[slots[k]];
+    // the node array may be reallocated by the recursion
+    const int child = (bn.child[0] == -1) ?
+      (-2 - bn.item) : this->collapse(buildnodes, slots[k], level + 1);
+    this->nodes[idx].child[k] = child;
+  }
+  return idx;
+}
+
+// Returns the union of the child boxes of node.
+SbBox3f
+SbBVH::getNodeBox(const int node) const
+{
+  const Node & n = this->nodes.getArrayPtr()[node];
+  SbBox3f box;
+  for (int k = 0; k < 4; k++) {
+    if (n.child[k] == -1 || n.bounds[0][k] > n.bounds[3][k]) continue;
+    box.extendBy(SbVec3f(n.bounds[0][k], n.bounds[1][k], n.bounds[2][k]));
+    box.extendBy(SbVec3f(n.bounds[3][k], n.bounds[4][k], n.bounds[5][k]));
+  }
+  return box;
+}
+
+#undef SBBVH_STACK
+#undef SBBVH_STACK_FREE
@@ -0,0 +1,100 @@
+#ifndef COIN_SBBVH_H
+#define COIN_SBBVH_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/lists/SbList.h>
+
+class SbPlane;
+class SbSphere;
+
+// Bounding volume hierarchy of a fixed set of axis aligned boxes, for
+// finding the boxes touched by a box, a sphere, a frustum or a ray.
+// Item i is box i given to build(). Boxes can be moved with setBox()
+// and refit(), which keeps the structure of the tree.
+//
+// The tree is built top-down with the binned surface area heuristic,
+// and stored as a flat array of nodes with four children each. The
+// boxes of the four children are stored coordinate by coordinate, so
+// a node is tested with a single pass of four wide SIMD instructions.
+// Items are stored directly as children of the nodes.
+
+// Called for each item whose box is hit by the ray in traceRay(),
+// roughly in order of distance to the box. Returns the new far limit
+// of the ray, usually the distance to the item if it is hit, or tmax
+// if not.
+typedef float SbBVHRayCB(void * closure, const int item, const float tmax);
+
+class SbBVH {
+public:
+  SbBVH(void);
+  ~SbBVH();
+
+  void clear(void);
+  void build(const SbBox3f * boxes, const int numboxes);
+
+  void setBox(const int item, const SbBox3f & box);
+  void refit(void);
+
+  int getNumItems(void) const;
+  const SbBox3f & getBox(const int item) const;
+  SbBox3f getBoundingBox(void) const;
+  int getDepth(void) const;
+
+  void findBox(const SbBox3f & box, SbList<int> & items) const;
+  void findSphere(const SbSphere & sphere, SbList<int> & items) const;
+  void findFrustum(const SbPlane * planes, const int numplanes, SbList<int> & items) const;
+  void findRay(const SbVec3f & origin, const SbVec3f & direction,
+               const float tmin, const float tmax, SbList<int> & items) const;
+  float traceRay(const SbVec3f & origin, const SbVec3f & direction,
+                 const float tmin, const float tmax,
+                 SbBVHRayCB * callback, void * closure) const;
+
+private:
+  // The boxes of four children, as min x, y, z and max x, y, z, and
+  // the children themselves. A child is an inner node if child is 0
+  // or more, item -child - 2 if child is -2 or less, or unused if
+  // child is -1. Unused children have empty boxes.
+  struct Node {
+    float bounds[6][4];
+    int child[4];
+  };
+
+  struct BuildNode;
+  int buildRange(SbList<BuildNode> & buildnodes, int * order, const int count,
+                 const SbVec3f * centers, const int level);
+  int collapse(const SbList<BuildNode> & buildnodes, const int buildnode, const int level);
+  SbBox3f getNodeBox(const int node) const;
+
+  SbList<Node> nodes;
+  SbList<SbBox3f> boxes;
+  int depth;
+};
+
+#endif // !COIN_SBBVH_H
@@ -402,17 +402,50 @@ SbBox3f::transform(const SbMatrix & matrix)
   }
 #endif // COIN_DEBUG
 
-  SbVec3f dst;
-  SbVec3f points[2] = {this->minpt, this->maxpt};
-  SbVec3f corner;
+  const float * t0 = matrix[0];
+  const float * t1 = matrix[1];
+  const float * t2 = matrix[2];
+  const float * t3 = matrix[3];
+
+  if (t0[0] == 1.0f && matrix == SbMatrix::identity()) return;
+
+  if (t0[3] == 0.0f && t1[3] == 0.0f && t2[3] == 0.0f && t3[3] == 1.0f) {
+    // Affine matrix, no perspective division. Each coordinate of a
+    // transformed corner is a sum of one product per input
+    // coordinate, so the smallest (largest) value is found by picking
+    // the smallest (largest) product for each term. The terms are
+    // added in the same order as in multVecMatrix(), and since
+    // floating point addition is monotonic, the result is identical
+    // to transforming all eight corners.
+    SbVec3f newmin, newmax;
+    for (int j = 0; j < 3; j++) {
+      float lo[3], hi[3];
+      for (int i = 0; i < 3; i++) {
+        const float a = matrix[i][j] * this->minpt[i];
+        const float b = matrix[i][j] * this->maxpt[i];
+        lo[i] = a < b ? a : b;
+        hi[i] = a < b ? b : a;
+      }
+      newmin[j] = lo[0] + lo[1] + lo[2] + t3[j];
+      newmax[j] = hi[0] + hi[1] + hi[2] + t3[j];
+    }
+    this->setBounds(newmin, newmax);
+    return;
+  }
+
+  SbVec3f corners[8];
   SbBox3f newbox;
 
   //transform all the corners and include them into the new box.
   for (int i=0;i<8;i++) {
     //Find all corners the "binary" way :-)
-    corner.setValue(points[(i&4)>>2][0], points[(i&2)>>1][1], points[i&1][2]);
-    matrix.multVecMatrix(corner, dst);
-    newbox.extendBy(dst);
+    corners[i].setValue(i&4 ? this->maxpt[0] : this->minpt[0],
+                        i&2 ? this->maxpt[1] : this->minpt[1],
+                        i&1 ? this->maxpt[2] : this->minpt[2]);
+  }
+  matrix.multVecMatrix(corners, corners, 8);
+  for (int i=0;i<8;i++) {
+    newbox.extendBy(corners[i]);
   }
   this->setBounds(newbox.minpt, newbox.maxpt);
 }
@@ -465,14 +498,13 @@ SbBox3f::outside(const SbMatrix & mvp, int & cullbits) const
   // pederb). 20000615 mortene.
 
   int i;
-  SbVec3f tmp;
   SbVec3f clip[8];
   for (i = 0; i < 8; i++) {
-    tmp[0] = i & 4 ? this->minpt[0] : this->maxpt[0];
-    tmp[1] = i & 2 ? this->minpt[1] : this->maxpt[1];
-    tmp[2] = i & 1 ? this->minpt[2] : this->maxpt[2];
-    mvp.multVecMatrix(tmp, clip[i]);
+    clip[i][0] = i & 4 ? this->minpt[0] : this->maxpt[0];
+    clip[i][1] = i & 2 ? this->minpt[1] : this->maxpt[1];
+    clip[i][2] = i & 1 ? this->minpt[2] : this->maxpt[2];
   }
+  mvp.multVecMatrix(clip, clip, 8);
   for (int j = 0; j < 3; j++) {
     if (cullbits & (1<<j)) {
       int inside = 0;
@@ -523,3 +555,38 @@ SbBox3f::getClosestPoint(const SbVec3f & point) const
 
   return closest;
 }
+
+#ifdef COIN_TEST_SUITE
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbRotation.h>
+
+BOOST_AUTO_TEST_CASE(transformAffine)
+{
+  SbMatrix matrices[3];
+  matrices[0].setTransform(SbVec3f(1.0f, -2.0f, 3.5f),
+                           SbRotation(SbVec3f(1.0f, 1.0f, 0.0f), 0.7f),
+                           SbVec3f(2.0f, 0.5f, -1.5f));
+  matrices[1].setTransform(SbVec3f(-0.1f, 0.0f, 100.0f),
+                           SbRotation(SbVec3f(0.2f, -1.0f, 0.3f), 2.9f),
+                           SbVec3f(1.0f, 1.0f, 1.0f));
+  matrices[2].setScale(SbVec3f(-1.0f, 3.0f, 0.25f));
+
+  const SbBox3f box(-1.5f, 0.25f, -3.0f, 2.0f, 7.5f, -0.5f);
+  for (int m = 0; m < 3; m++) {
+    // transform all eight corners, as for non-affine matrices
+    SbBox3f expected;
+    for (int i = 0; i < 8; i++) {
+      SbVec3f corner(i&4 ? box.getMax()[0] : box.getMin()[0],
+                     i&2 ? box.getMax()[1] : box.getMin()[1],
+                     i&1 ? box.getMax()[2] : box.getMin()[2]);
+      matrices[m].multVecMatrix(corner, corner);
+      expected.extendBy(corner);
+    }
+    SbBox3f result = box;
+    result.transform(matrices[m]);
+    BOOST_CHECK(result.getMin() == expected.getMin());
+    BOOST_CHECK(result.getMax() == expected.getMax());
+  }
+}
+
+#endif // COIN_TEST_SUITE
@@ -39,6 +39,7 @@
 /*! \file SbImage.h */
 #include <Inventor/SbImage.h>
 
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 
@@ -60,6 +61,7 @@
 #endif // COIN_THREADSAFE
 
 #include "glue/simage_wrapper.h"
+#include "base/SbImageCodec.h"
 #include "coindefs.h"
 
 #ifndef COIN_WORKAROUND_NO_USING_STD_FUNCS
@@ -85,7 +87,11 @@ public:
       datatype(SETVALUEPTR_DATA),
       size(0,0,0),
       bpp(0),
-      schedulecb(NULL)
+      schedulecb(NULL),
+      cformat(SbImage::UNCOMPRESSED),
+      cdata(NULL),
+      cdatasize(0),
+      clevels(0)
 #ifdef COIN_THREADSAFE
     , rwmutex(SbRWMutex::READ_PRECEDENCE)
 #endif // COIN_THREADSAFE
@@ -111,6 +117,23 @@ public:
     }
     this->datatype = SETVALUEPTR_DATA;
   }
+  void freeCompressed(void) {
+    delete[] this->cdata;
+    this->cdata = NULL;
+    this->cdatasize = 0;
+    this->clevels = 0;
+    this->cformat = SbImage::UNCOMPRESSED;
+  }
+  // decodes the first compressed level into bytes. Must be called
+  // with the write lock held.
+  void decodeCompressed(void) {
+    if (this->cdata == NULL || this->bytes != NULL) return;
+    const int buffersize = int(this->size[0]) * int(this->size[1]) * this->bpp;
+    this->bytes = new unsigned char[((buffersize + 3) / 4) * 4];
+    this->datatype = INTERNAL_DATA;
+    SbImageCodec::decode(this->cformat, this->cdata,
+                         this->size[0], this->size[1], this->bytes);
+  }
 
   unsigned char * bytes;
   DataType datatype;
@@ -120,8 +143,15 @@ public:
   SbImageScheduleReadCB * schedulecb;
   void * scheduleclosure;
 
+  SbImage::CompressedFormat cformat;
+  unsigned char * cdata;
+  size_t cdatasize;
+  int clevels;
+
   static SbList <ReadImageCBData> * readimagecallbacks;
 
+  static SbBool readContainerFile(const SbString & filename, SbImage * image);
+
 #ifdef COIN_THREADSAFE
   SbRWMutex rwmutex;
   void readLock(void) {
@@ -162,6 +192,34 @@ static void SbImage_cleanup_callback(void) {
 
 SbList <SbImageP::ReadImageCBData> * SbImageP::readimagecallbacks = NULL;
 
+// Reads DDS and KTX files, which don't need simage since the data is
+// kept compressed. Returns FALSE without complaining if the file is
+// of some other type.
+SbBool
+SbImageP::readContainerFile(const SbString & filename, SbImage * image)
+{
+  FILE * fp = fopen(filename.getString(), "rb");
+  if (!fp) return FALSE;
+
+  unsigned char magic[4];
+  SbBool ok = fread(magic, 1, 4, fp) == 4 &&
+    (memcmp(magic, "DDS ", 4) == 0 || memcmp(magic, "\253KTX", 4) == 0);
+  unsigned char * buf = NULL;
+  long len = 0;
+  if (ok) {
+    ok = fseek(fp, 0, SEEK_END) == 0 && (len = ftell(fp)) > 0 &&
+      fseek(fp, 0, SEEK_SET) == 0;
+  }
+  if (ok) {
+    buf = new unsigned char[len];
+    ok = fread(buf, 1, len, fp) == (size_t) len &&
+      SbImageCodec::readContainer(buf, len, image);
+    delete[] buf;
+  }
+  fclose(fp);
+  return ok;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 #define PRIVATE(image) ((image)->pimpl)
@@ -217,6 +275,7 @@ SbImage::SbImage(const SbImage & that)
 SbImage::~SbImage(void)
 {
   PRIVATE(this)->freeData();
+  PRIVATE(this)->freeCompressed();
   delete PRIVATE(this);
 }
 
@@ -283,6 +342,7 @@ SbImage::setValuePtr(const SbVec3s & size, const int bytesperpixel,
   PRIVATE(this)->schedulename = "";
   PRIVATE(this)->schedulecb = NULL;
   PRIVATE(this)->freeData();
+  PRIVATE(this)->freeCompressed();
   PRIVATE(this)->bytes = const_cast<unsigned char *>(bytes);
   PRIVATE(this)->datatype = SbImageP::SETVALUEPTR_DATA;
   PRIVATE(this)->size = size;
@@ -324,6 +384,7 @@ SbImage::setValue(const SbVec3s & size, const int bytesperpixel,
   PRIVATE(this)->writeLock();
   PRIVATE(this)->schedulename = "";
   PRIVATE(this)->schedulecb = NULL;
+  PRIVATE(this)->freeCompressed();
   if (PRIVATE(this)->bytes && PRIVATE(this)->datatype == SbImageP::INTERNAL_DATA) {
     // check for special case where we don't have to reallocate
     if (bytes && (size == PRIVATE(this)->size) && (bytesperpixel == PRIVATE(this)->bpp)) {
@@ -371,6 +432,10 @@ SbImage::getValue(SbVec2s & size, int & bytesperpixel) const
 /*!
   Returns the 3D image data.
 
+  If the image only holds compressed data (see setCompressedValue()),
+  the first level is decoded on the first call, and the decoded pixels
+  are returned.
+
   \since Coin 2.0
 */
 unsigned char *
@@ -385,6 +450,13 @@ SbImage::getValue(SbVec3s & size, int & bytesperpixel) const
       PRIVATE(this)->schedulecb = NULL;
     }
   }
+  if (PRIVATE(this)->cdata && !PRIVATE(this)->bytes) {
+    PRIVATE(this)->readUnlock();
+    PRIVATE(this)->writeLock();
+    PRIVATE(this)->decodeCompressed();
+    PRIVATE(this)->writeUnlock();
+    PRIVATE(this)->readLock();
+  }
   size = PRIVATE(this)->size;
   bytesperpixel = PRIVATE(this)->bpp;
   unsigned char * bytes = PRIVATE(this)->bytes;
@@ -432,7 +504,11 @@ SbImage::searchForFile(const SbString & basename,
 /*!
   Reads image data from \a filename. In Coin, simage is used to
   load image files, and several common file formats are supported.
-  simage can be downloaded from our webpages.  If loading
+  simage can be downloaded from our webpages.
+
+  DDS and KTX (version 1) files with block compressed 2D data are
+  read directly by Coin, without the need for simage, and the data is
+  kept compressed. See setCompressedValue().  If loading
   fails for some reason this method returns FALSE, and the instance
   is set to an empty image. If the file is successfully loaded, the
   file image data is copied into this class.
@@ -464,9 +540,13 @@ SbImage::readFile(const SbString & filename,
       if (finalname.getLength() > 0 && cbdata.cb(finalname, this, cbdata.closure)) return TRUE;
       if (cbdata.cb(filename, this, cbdata.closure)) return TRUE;
     }
-    if (!simage_wrapper()->available) {
-      return FALSE;
-    }
+  }
+
+  if (finalname.getLength() > 0 &&
+      SbImageP::readContainerFile(finalname, this)) return TRUE;
+
+  if (SbImageP::readimagecallbacks && !simage_wrapper()->available) {
+    return FALSE;
   }
 
   if (finalname.getLength() == 0) {
@@ -537,7 +617,16 @@ SbImage::operator==(const SbImage & image) const
 {
   this->readLock();
   int ret = 0;
-  if (!PRIVATE(this)->schedulecb && !PRIVATE(&image)->schedulecb) {
+  if (PRIVATE(this)->cdata || PRIVATE(&image)->cdata) {
+    ret =
+      PRIVATE(this)->cformat == PRIVATE(&image)->cformat &&
+      PRIVATE(this)->size == PRIVATE(&image)->size &&
+      PRIVATE(this)->clevels == PRIVATE(&image)->clevels &&
+      PRIVATE(this)->cdatasize == PRIVATE(&image)->cdatasize &&
+      memcmp(PRIVATE(this)->cdata, PRIVATE(&image)->cdata,
+             PRIVATE(this)->cdatasize) == 0;
+  }
+  else if (!PRIVATE(this)->schedulecb && !PRIVATE(&image)->schedulecb) {
     if (PRIVATE(this)->size != PRIVATE(&image)->size) ret = 0;
     else if (PRIVATE(this)->bpp != PRIVATE(&image)->bpp) ret = 0;
     else if (PRIVATE(this)->bytes == NULL || PRIVATE(&image)->bytes == NULL) {
@@ -564,6 +653,7 @@ SbImage::operator=(const SbImage & image)
   if (*this != image ) {
     PRIVATE(this)->writeLock();
     PRIVATE(this)->freeData();
+    PRIVATE(this)->freeCompressed();
     PRIVATE(this)->writeUnlock();
 
     if (PRIVATE(&image)->bytes) {
@@ -590,6 +680,20 @@ SbImage::operator=(const SbImage & image)
       }
       PRIVATE(&image)->readUnlock();
     }
+    if (PRIVATE(&image)->cdata) {
+      PRIVATE(&image)->readLock();
+      PRIVATE(this)->writeLock();
+      PRIVATE(this)->size = PRIVATE(&image)->size;
+      PRIVATE(this)->bpp = PRIVATE(&image)->bpp;
+      PRIVATE(this)->cformat = PRIVATE(&image)->cformat;
+      PRIVATE(this)->clevels = PRIVATE(&image)->clevels;
+      PRIVATE(this)->cdatasize = PRIVATE(&image)->cdatasize;
+      PRIVATE(this)->cdata = new unsigned char[PRIVATE(&image)->cdatasize];
+      memcpy(PRIVATE(this)->cdata, PRIVATE(&image)->cdata,
+             PRIVATE(&image)->cdatasize);
+      PRIVATE(this)->writeUnlock();
+      PRIVATE(&image)->readUnlock();
+    }
   }
   return *this;
 }
@@ -637,11 +741,197 @@ SbImage::hasData(void) const
 {
   SbBool ret;
   this->readLock();
-  ret = PRIVATE(this)->bytes != NULL;
+  ret = PRIVATE(this)->bytes != NULL || PRIVATE(this)->cdata != NULL;
+  this->readUnlock();
+  return ret;
+}
+
+/*!
+  Sets the image to \a numlevels levels of block compressed data in
+  the given \a format. The levels are stored back to back in \a data,
+  starting with the full resolution level of \a size, and each level
+  halving the size of the previous one (see getCompressedSize()). The
+  data is copied.
+
+  The compressed data is uploaded as is by SoGLImage if the OpenGL
+  driver supports the format. getValue() returns the decoded pixels of
+  the first level, with the number of components given by the format:
+  1 for BC4_R, 2 for BC5_RG, 3 for BC1_RGB and ETC1_RGB, and 4 for the
+  rest. For BC4_R and BC5_RG, the channels are treated as luminance
+  and luminance plus alpha, like for other 1 and 2 component images.
+
+  Setting \a format to UNCOMPRESSED, or \a data to \c NULL, clears
+  the image.
+
+  \sa compress(), getCompressedLevel()
+  \since Coin 4.0
+*/
+void
+SbImage::setCompressedValue(const SbVec2s & size,
+                            const CompressedFormat format,
+                            const int numlevels,
+                            const unsigned char * data)
+{
+  if (format == UNCOMPRESSED || data == NULL || numlevels < 1) {
+    this->setValue(SbVec3s(0,0,0), 0, NULL);
+    return;
+  }
+
+  size_t datasize = 0;
+  for (int i = 0; i < numlevels; i++) {
+    const SbVec2s levelsize(size[0] >> i ? size[0] >> i : 1,
+                            size[1] >> i ? size[1] >> i : 1);
+    datasize += SbImage::getCompressedSize(format, levelsize);
+  }
+
+  PRIVATE(this)->writeLock();
+  PRIVATE(this)->schedulename = "";
+  PRIVATE(this)->schedulecb = NULL;
+  PRIVATE(this)->freeData();
+  PRIVATE(this)->freeCompressed();
+  PRIVATE(this)->size.setValue(size[0], size[1], 0);
+  PRIVATE(this)->bpp = SbImageCodec::getNumComponents(format);
+  PRIVATE(this)->cformat = format;
+  PRIVATE(this)->clevels = numlevels;
+  PRIVATE(this)->cdatasize = datasize;
+  PRIVATE(this)->cdata = new unsigned char[datasize];
+  memcpy(PRIVATE(this)->cdata, data, datasize);
+  PRIVATE(this)->writeUnlock();
+}
+
+/*!
+  Returns the format of the compressed data, or UNCOMPRESSED if this
+  image doesn't hold any.
+
+  \since Coin 4.0
+*/
+SbImage::CompressedFormat
+SbImage::getCompressedFormat(void) const
+{
+  return PRIVATE(this)->cformat;
+}
+
+/*!
+  Returns the number of compressed levels (the full resolution image
+  plus mipmaps), or 0 if this image isn't compressed.
+
+  \since Coin 4.0
+*/
+int
+SbImage::getNumCompressedLevels(void) const
+{
+  return PRIVATE(this)->clevels;
+}
+
+/*!
+  Returns a pointer to the compressed data for \a level, and sets \a
+  size and \a numbytes to the dimensions and byte size of that level.
+  Returns \c NULL if \a level is out of range.
+
+  \since Coin 4.0
+*/
+const unsigned char *
+SbImage::getCompressedLevel(const int level, SbVec2s & size,
+                            size_t & numbytes) const
+{
+  const unsigned char * ret = NULL;
+  this->readLock();
+  if (level >= 0 && level < PRIVATE(this)->clevels) {
+    size_t offset = 0;
+    for (int i = 0; i <= level; i++) {
+      size.setValue(PRIVATE(this)->size[0] >> i ? PRIVATE(this)->size[0] >> i : 1,
+                    PRIVATE(this)->size[1] >> i ? PRIVATE(this)->size[1] >> i : 1);
+      numbytes = SbImage::getCompressedSize(PRIVATE(this)->cformat, size);
+      if (i < level) offset += numbytes;
+    }
+    ret = PRIVATE(this)->cdata + offset;
+  }
   this->readUnlock();
   return ret;
 }
 
+/*!
+  Compresses the current pixel data to \a format, with a full chain
+  of mipmaps if \a mipmaps is \c TRUE. This is a fairly expensive
+  operation, and is meant to be done once at load time, preferably in
+  a separate thread.
+
+  The uncompressed pixels are kept, so getValue() still returns the
+  original data. Returns \c FALSE if the image is empty, is a 3D
+  image, or if \a format can't be encoded from the current number of
+  components. BC1_RGB can be encoded from 3 and 4 component images,
+  BC1_RGBA, BC2_RGBA and BC3_RGBA from 4 component images, BC4_R from
+  1 component images, and BC5_RG from 2 component images. Encoding to
+  ETC1_RGB is not supported.
+
+  \since Coin 4.0
+*/
+SbBool
+SbImage::compress(const CompressedFormat format, const SbBool mipmaps)
+{
+  SbVec3s size;
+  int nc;
+  const unsigned char * bytes = this->getValue(size, nc);
+  if (!bytes || size[2] != 0 || size[0] <= 0 || size[1] <= 0 ||
+      !SbImageCodec::canEncode(format, nc)) return FALSE;
+
+  int numlevels = 1;
+  size_t datasize = SbImage::getCompressedSize(format, SbVec2s(size[0], size[1]));
+  if (mipmaps) {
+    for (int w = size[0], h = size[1]; w > 1 || h > 1; numlevels++) {
+      w = w > 1 ? w >> 1 : 1;
+      h = h > 1 ? h >> 1 : 1;
+      datasize += SbImage::getCompressedSize(format, SbVec2s(w, h));
+    }
+  }
+
+  unsigned char * data = new unsigned char[datasize];
+  unsigned char * dst = data;
+  const unsigned char * src = bytes;
+  unsigned char * tmp[2] = { NULL, NULL };
+  int w = size[0], h = size[1];
+  for (int i = 0; i < numlevels; i++) {
+    if (i > 0) {
+      unsigned char * next = tmp[i & 1];
+      if (next == NULL) {
+        // the first halving is the largest one
+        next = tmp[i & 1] =
+          new unsigned char[((size[0] + 1) / 2) * ((size[1] + 1) / 2) * nc];
+      }
+      SbImageCodec::halve(src, w, h, nc, next);
+      w = w > 1 ? w >> 1 : 1;
+      h = h > 1 ? h >> 1 : 1;
+      src = next;
+    }
+    SbImageCodec::encode(format, src, w, h, nc, dst);
+    dst += SbImage::getCompressedSize(format, SbVec2s(w, h));
+  }
+  delete[] tmp[0];
+  delete[] tmp[1];
+
+  PRIVATE(this)->writeLock();
+  PRIVATE(this)->freeCompressed();
+  PRIVATE(this)->cformat = format;
+  PRIVATE(this)->clevels = numlevels;
+  PRIVATE(this)->cdatasize = datasize;
+  PRIVATE(this)->cdata = data;
+  PRIVATE(this)->writeUnlock();
+  return TRUE;
+}
+
+/*!
+  Returns the number of bytes needed to store an image of \a size in
+  the compressed \a format. All the supported formats are stored in
+  blocks of 4x4 pixels.
+
+  \since Coin 4.0
+*/
+size_t
+SbImage::getCompressedSize(const CompressedFormat format, const SbVec2s & size)
+{
+  return SbImageCodec::getLevelSize(format, size[0], size[1]);
+}
+
 /*!
   Returns the size of the image. If this is a 2D image, the
   z component is zero. If this is a 3D image, the z component is
@@ -733,5 +1023,174 @@ BOOST_AUTO_TEST_CASE(copyConstruct)
   }
 
 }
+
+#include <Inventor/SbBasic.h>
+#include <cstdio>
+#include <cstdlib>
+
+// decodes the compressed data in image through a fresh SbImage, and
+// returns the largest difference from the original pixels
+static int
+test_compressed_error(const SbImage & image, const unsigned char * orgbytes,
+                      const int orgnc)
+{
+  SbVec2s size;
+  size_t numbytes;
+  const unsigned char * data = image.getCompressedLevel(0, size, numbytes);
+  SbImage decoded;
+  decoded.setCompressedValue(size, image.getCompressedFormat(),
+                             image.getNumCompressedLevels(), data);
+  SbVec2s dsize;
+  int nc;
+  const unsigned char * bytes = decoded.getValue(dsize, nc);
+  if (dsize != size) return 256;
+  int maxerr = 0;
+  for (int i = 0; i < size[0] * size[1]; i++) {
+    for (int c = 0; c < SbMin(nc, orgnc); c++) {
+      const int err = abs(int(bytes[i * nc + c]) - int(orgbytes[i * orgnc + c]));
+      if (err > maxerr) maxerr = err;
+    }
+  }
+  return maxerr;
+}
+
+BOOST_AUTO_TEST_CASE(compressRoundTrip)
+{
+  // a smooth gradient with a size which isn't a multiple of four
+  const int w = 22, h = 10;
+  unsigned char buf[w * h * 4];
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      unsigned char * p = buf + (y * w + x) * 4;
+      p[0] = (unsigned char) (x * 10);
+      p[1] = (unsigned char) (y * 20);
+      p[2] = (unsigned char) (255 - x * 5);
+      p[3] = (unsigned char) (y * 25);
+    }
+  }
+  const struct {
+    SbImage::CompressedFormat format;
+    int nc;
+  } formats[] = {
+    { SbImage::BC1_RGB, 3 }, { SbImage::BC2_RGBA, 4 },
+    { SbImage::BC3_RGBA, 4 }, { SbImage::BC4_R, 1 }, { SbImage::BC5_RG, 2 }
+  };
+  for (unsigned int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    const int nc = formats[i].nc;
+    unsigned char src[w * h * 4];
+    for (int j = 0; j < w * h; j++) {
+      for (int c = 0; c < nc; c++) src[j * nc + c] = buf[j * 4 + c];
+    }
+    SbImage image(src, SbVec2s(w, h), nc);
+    BOOST_CHECK_MESSAGE(image.compress(formats[i].format),
+                        "compress() failed");
+    BOOST_CHECK_MESSAGE(image.getCompressedFormat() == formats[i].format,
+                        "wrong compressed format");
+    // 22x10, 11x5, 5x2, 2x1, 1x1
+    BOOST_CHECK_MESSAGE(image.getNumCompressedLevels() == 5,
+                        "incomplete mipmap chain");
+
+    SbVec2s size;
+    size_t numbytes;
+    BOOST_CHECK(image.getCompressedLevel(2, size, numbytes) != NULL);
+    BOOST_CHECK_MESSAGE(size == SbVec2s(5, 2) &&
+                        numbytes == SbImage::getCompressedSize(formats[i].format, size),
+                        "wrong size of mipmap level");
+
+    // the original pixels are kept
+    int nc2;
+    SbVec2s size2;
+    BOOST_CHECK(memcmp(image.getValue(size2, nc2), src, w * h * nc) == 0);
+
+    const int err = test_compressed_error(image, src, nc);
+    BOOST_CHECK_MESSAGE(err <= 24, "too large compression error");
+  }
+
+  // can't encode a format which doesn't match the number of components
+  SbImage image(buf, SbVec2s(w, h), 4);
+  BOOST_CHECK(!image.compress(SbImage::BC4_R));
+  BOOST_CHECK(!image.compress(SbImage::ETC1_RGB));
+  BOOST_CHECK(image.getCompressedFormat() == SbImage::UNCOMPRESSED);
+}
+
+BOOST_AUTO_TEST_CASE(compressedCopy)
+{
+  unsigned char block[8] = { 0x00, 0xf8, 0x1f, 0x00, 0x00, 0x55, 0xaa, 0xff };
+  SbImage image;
+  image.setCompressedValue(SbVec2s(4, 4), SbImage::BC1_RGBA, 1, block);
+  BOOST_CHECK(image.hasData());
+  BOOST_CHECK(image.getSize() == SbVec3s(4, 4, 0));
+
+  SbImage copy(image);
+  BOOST_CHECK(copy == image);
+  BOOST_CHECK(copy.getCompressedFormat() == SbImage::BC1_RGBA);
+
+  SbVec2s size;
+  int nc;
+  const unsigned char * bytes = copy.getValue(size, nc);
+  BOOST_CHECK_MESSAGE(nc == 4 && size == SbVec2s(4, 4), "wrong decoded size");
+  // row 0 uses index 0 (red), row 1 index 1 (blue)
+  BOOST_CHECK(bytes[0] == 255 && bytes[1] == 0 && bytes[2] == 0 && bytes[3] == 255);
+  BOOST_CHECK(bytes[16] == 0 && bytes[17] == 0 && bytes[18] == 255);
+
+  // setting uncompressed data clears the compressed data
+  copy.setValue(SbVec2s(1, 1), 1, bytes);
+  BOOST_CHECK(copy.getCompressedFormat() == SbImage::UNCOMPRESSED);
+  BOOST_CHECK(copy != image);
+}
+
+BOOST_AUTO_TEST_CASE(decodeETC1)
+{
+  // individual mode, red/green/blue 8 in the left half and 4 in the
+  // right half, modifier table 0, all pixels using +2 except (0,0)
+  // which uses +8
+  const unsigned char block[8] = { 0x84, 0x84, 0x84, 0x00, 0, 0, 0, 0x01 };
+  SbImage image;
+  image.setCompressedValue(SbVec2s(4, 4), SbImage::ETC1_RGB, 1, block);
+  SbVec2s size;
+  int nc;
+  const unsigned char * bytes = image.getValue(size, nc);
+  BOOST_CHECK(nc == 3);
+  BOOST_CHECK_MESSAGE(bytes[0] == 136 + 8, "wrong modifier");
+  BOOST_CHECK_MESSAGE(bytes[3] == 136 + 2 && bytes[3 * 3 + 3 * 4 * 3] == 68 + 2,
+                      "wrong sub block color");
+}
+
+BOOST_AUTO_TEST_CASE(readDDS)
+{
+  unsigned char dds[128 + 8];
+  memset(dds, 0, sizeof(dds));
+  memcpy(dds, "DDS ", 4);
+  dds[4] = 124;          // header size
+  dds[4 + 8] = 4;        // height
+  dds[4 + 12] = 4;       // width
+  dds[4 + 72] = 32;      // pixel format size
+  dds[4 + 76] = 0x4;     // DDPF_FOURCC
+  memcpy(dds + 4 + 80, "DXT1", 4);
+  // red (index 0) in the first (top) row, blue (index 1) below
+  const unsigned char block[8] = { 0x00, 0xf8, 0x1f, 0x00, 0x00, 0x55, 0x55, 0x55 };
+  memcpy(dds + 128, block, 8);
+
+  const char * filename = "sbimage_readdds_test.dds";
+  FILE * fp = fopen(filename, "wb");
+  BOOST_REQUIRE(fp != NULL);
+  fwrite(dds, 1, sizeof(dds), fp);
+  fclose(fp);
+
+  SbImage image;
+  const SbBool ok = image.readFile(filename);
+  remove(filename);
+  BOOST_REQUIRE_MESSAGE(ok, "could not read DDS file");
+  BOOST_CHECK(image.getCompressedFormat() == SbImage::BC1_RGB);
+  BOOST_CHECK(image.getNumCompressedLevels() == 1);
+
+  SbVec2s size;
+  int nc;
+  const unsigned char * bytes = image.getValue(size, nc);
+  BOOST_CHECK(size == SbVec2s(4, 4) && nc == 3);
+  // the image is flipped to bottom-up, so the red row is the last one
+  BOOST_CHECK_MESSAGE(bytes[0] == 0 && bytes[2] == 255, "bottom row not blue");
+  BOOST_CHECK_MESSAGE(bytes[36] == 255 && bytes[38] == 0, "top row not red");
+}
 #endif //COIN_TEST_SUITE
 
@@ -0,0 +1,907 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// Software codecs for the block compressed formats SbImage can carry,
+// and parsers for the DDS and KTX (version 1) container formats.
+//
+// The decoders are used when the driver can not handle a compressed
+// format natively, and when the client asks for the pixel data with
+// SbImage::getValue(). The encoders do a "range fit" along the
+// principal axis of each block. This is nowhere near the quality of
+// offline tools, but it is fast enough to run at load time and much
+// better than a plain bounding box fit.
+
+#include "SbImageCodec.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <Inventor/SbVec2s.h>
+#include <Inventor/errors/SoDebugError.h>
+
+#ifndef COIN_WORKAROUND_NO_USING_STD_FUNCS
+using std::memcpy;
+using std::memcmp;
+#endif // !COIN_WORKAROUND_NO_USING_STD_FUNCS
+
+// *************************************************************************
+
+typedef unsigned char sbimage_block[16][4];
+
+static inline int
+sbimage_clamp255(int v)
+{
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// *************************************************************************
+// decoders
+
+static void
+sbimage_expand565(unsigned int c, unsigned char * rgb)
+{
+  const unsigned int r = (c >> 11) & 0x1f;
+  const unsigned int g = (c >> 5) & 0x3f;
+  const unsigned int b = c & 0x1f;
+  rgb[0] = (unsigned char) ((r << 3) | (r >> 2));
+  rgb[1] = (unsigned char) ((g << 2) | (g >> 4));
+  rgb[2] = (unsigned char) ((b << 3) | (b >> 2));
+}
+
+// Builds the four entry color palette of a BC1 style color block.
+// BC2 and BC3 always use the four color mode, BC1 switches to three
+// colors plus transparent black when color0 <= color1.
+static void
+sbimage_color_palette(unsigned int c0, unsigned int c1,
+                      const SbBool fourcolors, const SbBool punchthrough,
+                      unsigned char pal[4][4])
+{
+  sbimage_expand565(c0, pal[0]);
+  sbimage_expand565(c1, pal[1]);
+  pal[0][3] = pal[1][3] = 255;
+  if (fourcolors || c0 > c1) {
+    for (int i = 0; i < 3; i++) {
+      pal[2][i] = (unsigned char) ((2 * pal[0][i] + pal[1][i] + 1) / 3);
+      pal[3][i] = (unsigned char) ((pal[0][i] + 2 * pal[1][i] + 1) / 3);
+    }
+    pal[2][3] = pal[3][3] = 255;
+  }
+  else {
+    for (int i = 0; i < 3; i++) {
+      pal[2][i] = (unsigned char) ((pal[0][i] + pal[1][i] + 1) / 2);
+      pal[3][i] = 0;
+    }
+    pal[2][3] = 255;
+    pal[3][3] = punchthrough ? 0 : 255;
+  }
+}
+
+static void
+sbimage_decode_color(const unsigned char * b, const SbBool fourcolors,
+                     const SbBool punchthrough, sbimage_block out)
+{
+  unsigned char pal[4][4];
+  sbimage_color_palette(b[0] | (b[1] << 8), b[2] | (b[3] << 8),
+                        fourcolors, punchthrough, pal);
+  for (int i = 0; i < 16; i++) {
+    const int idx = (b[4 + (i >> 2)] >> ((i & 3) * 2)) & 3;
+    out[i][0] = pal[idx][0];
+    out[i][1] = pal[idx][1];
+    out[i][2] = pal[idx][2];
+    out[i][3] = pal[idx][3];
+  }
+}
+
+static void
+sbimage_alpha_palette(const int a0, const int a1, unsigned char pal[8])
+{
+  pal[0] = (unsigned char) a0;
+  pal[1] = (unsigned char) a1;
+  if (a0 > a1) {
+    for (int i = 2; i < 8; i++) {
+      pal[i] = (unsigned char) (((8 - i) * a0 + (i - 1) * a1 + 3) / 7);
+    }
+  }
+  else {
+    for (int i = 2; i < 6; i++) {
+      pal[i] = (unsigned char) (((6 - i) * a0 + (i - 1) * a1 + 2) / 5);
+    }
+    pal[6] = 0;
+    pal[7] = 255;
+  }
+}
+
+// BC4 style single channel block, also used for BC3 alpha and BC5.
+static void
+sbimage_decode_alpha(const unsigned char * b, sbimage_block out,
+                     const int channel)
+{
+  unsigned char pal[8];
+  sbimage_alpha_palette(b[0], b[1], pal);
+  for (int half = 0; half < 2; half++) {
+    const unsigned int bits =
+      b[2 + half * 3] | (b[3 + half * 3] << 8) | (b[4 + half * 3] << 16);
+    for (int i = 0; i < 8; i++) {
+      out[half * 8 + i][channel] = pal[(bits >> (i * 3)) & 7];
+    }
+  }
+}
+
+static void
+sbimage_decode_explicit_alpha(const unsigned char * b, sbimage_block out)
+{
+  for (int i = 0; i < 16; i++) {
+    out[i][3] = (unsigned char) (((b[i >> 1] >> ((i & 1) * 4)) & 0xf) * 17);
+  }
+}
+
+static const int sbimage_etc1_modifiers[8][2] = {
+  { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+  { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static void
+sbimage_decode_etc1(const unsigned char * b, sbimage_block out)
+{
+  int base[2][3];
+  if (b[3] & 2) { // differential mode
+    for (int i = 0; i < 3; i++) {
+      const int c = b[i] >> 3;
+      int d = b[i] & 7;
+      if (d >= 4) d -= 8;
+      const int c2 = (c + d) & 0x1f;
+      base[0][i] = (c << 3) | (c >> 2);
+      base[1][i] = (c2 << 3) | (c2 >> 2);
+    }
+  }
+  else {
+    for (int i = 0; i < 3; i++) {
+      base[0][i] = (b[i] >> 4) * 17;
+      base[1][i] = (b[i] & 0xf) * 17;
+    }
+  }
+  const int table[2] = { (b[3] >> 5) & 7, (b[3] >> 2) & 7 };
+  const SbBool flip = (b[3] & 1) != 0;
+  const unsigned int msb = (b[4] << 8) | b[5];
+  const unsigned int lsb = (b[6] << 8) | b[7];
+
+  for (int y = 0; y < 4; y++) {
+    for (int x = 0; x < 4; x++) {
+      const int j = x * 4 + y; // pixel indices are stored column major
+      const int sub = flip ? (y >= 2) : (x >= 2);
+      const int idx = (((msb >> j) & 1) << 1) | ((lsb >> j) & 1);
+      int m = sbimage_etc1_modifiers[table[sub]][idx & 1];
+      if (idx & 2) m = -m;
+      unsigned char * p = out[y * 4 + x];
+      p[0] = (unsigned char) sbimage_clamp255(base[sub][0] + m);
+      p[1] = (unsigned char) sbimage_clamp255(base[sub][1] + m);
+      p[2] = (unsigned char) sbimage_clamp255(base[sub][2] + m);
+      p[3] = 255;
+    }
+  }
+}
+
+// *************************************************************************
+// encoders
+
+static inline unsigned int
+sbimage_pack565(const int * rgb)
+{
+  return
+    (((unsigned int) (rgb[0] * 31 + 127) / 255) << 11) |
+    (((unsigned int) (rgb[1] * 63 + 127) / 255) << 5) |
+    ((unsigned int) (rgb[2] * 31 + 127) / 255);
+}
+
+// Range fit of a color block. Finds the principal axis of the
+// (non-transparent) colors with a few power iterations on the
+// covariance matrix, and uses the extreme projections as endpoints.
+static void
+sbimage_encode_color(const sbimage_block in, const SbBool fourcolors,
+                     const SbBool punchthrough, unsigned char * out)
+{
+  SbBool transparent[16];
+  SbBool anytransparent = FALSE;
+  int count = 0;
+  float mean[3] = { 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < 16; i++) {
+    transparent[i] = punchthrough && in[i][3] < 128;
+    if (transparent[i]) { anytransparent = TRUE; continue; }
+    mean[0] += in[i][0]; mean[1] += in[i][1]; mean[2] += in[i][2];
+    count++;
+  }
+
+  if (count == 0) { // fully transparent block
+    out[0] = out[1] = out[2] = out[3] = 0;
+    out[4] = out[5] = out[6] = out[7] = 0xff;
+    return;
+  }
+  mean[0] /= count; mean[1] /= count; mean[2] /= count;
+
+  float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < 16; i++) {
+    if (transparent[i]) continue;
+    const float r = in[i][0] - mean[0];
+    const float g = in[i][1] - mean[1];
+    const float b = in[i][2] - mean[2];
+    cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+    cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+  }
+  float axis[3] = { 0.9f, 1.0f, 0.7f };
+  for (int iter = 0; iter < 4; iter++) {
+    const float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+    const float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+    const float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+    float m = x < 0.0f ? -x : x;
+    if ((y < 0.0f ? -y : y) > m) m = y < 0.0f ? -y : y;
+    if ((z < 0.0f ? -z : z) > m) m = z < 0.0f ? -z : z;
+    if (m < 1e-6f) break; // all colors (almost) equal
+    axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+  }
+
+  int minidx = -1, maxidx = -1;
+  float mindot = 0.0f, maxdot = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    if (transparent[i]) continue;
+    const float d =
+      in[i][0] * axis[0] + in[i][1] * axis[1] + in[i][2] * axis[2];
+    if (minidx < 0 || d < mindot) { mindot = d; minidx = i; }
+    if (maxidx < 0 || d > maxdot) { maxdot = d; maxidx = i; }
+  }
+  int maxc[3], minc[3];
+  for (int i = 0; i < 3; i++) {
+    maxc[i] = in[maxidx][i];
+    minc[i] = in[minidx][i];
+  }
+
+  unsigned int c0 = sbimage_pack565(maxc);
+  unsigned int c1 = sbimage_pack565(minc);
+  // four color mode is selected by c0 > c1, three color mode (with
+  // transparency) by c0 <= c1
+  const SbBool threecolor = anytransparent && !fourcolors;
+  if ((threecolor && c0 > c1) || (!threecolor && c0 < c1)) {
+    const unsigned int tmp = c0; c0 = c1; c1 = tmp;
+  }
+
+  unsigned char pal[4][4];
+  sbimage_color_palette(c0, c1, fourcolors, punchthrough, pal);
+  const int numcolors = (fourcolors || c0 > c1) ? 4 : 3;
+
+  unsigned int indices = 0;
+  for (int i = 0; i < 16; i++) {
+    int best = 3;
+    if (!transparent[i]) {
+      int bestdist = 0x7fffffff;
+      for (int j = 0; j < numcolors; j++) {
+        const int dr = in[i][0] - pal[j][0];
+        const int dg = in[i][1] - pal[j][1];
+        const int db = in[i][2] - pal[j][2];
+        const int dist = dr * dr + dg * dg + db * db;
+        if (dist < bestdist) { bestdist = dist; best = j; }
+      }
+    }
+    indices |= (unsigned int) best << (i * 2);
+  }
+  out[0] = (unsigned char) (c0 & 0xff);
+  out[1] = (unsigned char) (c0 >> 8);
+  out[2] = (unsigned char) (c1 & 0xff);
+  out[3] = (unsigned char) (c1 >> 8);
+  out[4] = (unsigned char) (indices & 0xff);
+  out[5] = (unsigned char) ((indices >> 8) & 0xff);
+  out[6] = (unsigned char) ((indices >> 16) & 0xff);
+  out[7] = (unsigned char) (indices >> 24);
+}
+
+static void
+sbimage_encode_alpha(const sbimage_block in, const int channel,
+                     unsigned char * out)
+{
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; i++) {
+    if (in[i][channel] > a0) a0 = in[i][channel];
+    if (in[i][channel] < a1) a1 = in[i][channel];
+  }
+  unsigned char pal[8];
+  sbimage_alpha_palette(a0, a1, pal);
+
+  unsigned int bits[2] = { 0, 0 };
+  if (a0 != a1) {
+    for (int i = 0; i < 16; i++) {
+      int best = 0, bestdist = 256;
+      for (int j = 0; j < 8; j++) {
+        int d = in[i][channel] - pal[j];
+        if (d < 0) d = -d;
+        if (d < bestdist) { bestdist = d; best = j; }
+      }
+      bits[i >> 3] |= (unsigned int) best << ((i & 7) * 3);
+    }
+  }
+  out[0] = (unsigned char) a0;
+  out[1] = (unsigned char) a1;
+  for (int half = 0; half < 2; half++) {
+    out[2 + half * 3] = (unsigned char) (bits[half] & 0xff);
+    out[3 + half * 3] = (unsigned char) ((bits[half] >> 8) & 0xff);
+    out[4 + half * 3] = (unsigned char) ((bits[half] >> 16) & 0xff);
+  }
+}
+
+static void
+sbimage_encode_explicit_alpha(const sbimage_block in, unsigned char * out)
+{
+  for (int i = 0; i < 8; i++) {
+    const int lo = (in[i * 2][3] * 15 + 127) / 255;
+    const int hi = (in[i * 2 + 1][3] * 15 + 127) / 255;
+    out[i] = (unsigned char) (lo | (hi << 4));
+  }
+}
+
+// *************************************************************************
+
+int
+SbImageCodec::getNumComponents(const SbImage::CompressedFormat format)
+{
+  switch (format) {
+  case SbImage::BC1_RGB:
+  case SbImage::ETC1_RGB:
+    return 3;
+  case SbImage::BC1_RGBA:
+  case SbImage::BC2_RGBA:
+  case SbImage::BC3_RGBA:
+    return 4;
+  case SbImage::BC4_R:
+    return 1;
+  case SbImage::BC5_RG:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+int
+SbImageCodec::getBlockBytes(const SbImage::CompressedFormat format)
+{
+  switch (format) {
+  case SbImage::BC1_RGB:
+  case SbImage::BC1_RGBA:
+  case SbImage::BC4_R:
+  case SbImage::ETC1_RGB:
+    return 8;
+  case SbImage::BC2_RGBA:
+  case SbImage::BC3_RGBA:
+  case SbImage::BC5_RG:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+size_t
+SbImageCodec::getLevelSize(const SbImage::CompressedFormat format,
+                           const int width, const int height)
+{
+  return size_t((width + 3) / 4) * size_t((height + 3) / 4) *
+    size_t(SbImageCodec::getBlockBytes(format));
+}
+
+SbBool
+SbImageCodec::hasAlpha(const SbImage::CompressedFormat format)
+{
+  const int nc = SbImageCodec::getNumComponents(format);
+  return nc == 2 || nc == 4;
+}
+
+void
+SbImageCodec::decode(const SbImage::CompressedFormat format,
+                     const unsigned char * src,
+                     const int width, const int height,
+                     unsigned char * dst)
+{
+  const int nc = SbImageCodec::getNumComponents(format);
+  const int blockbytes = SbImageCodec::getBlockBytes(format);
+  assert(nc > 0 && blockbytes > 0);
+
+  sbimage_block block;
+  for (int by = 0; by < height; by += 4) {
+    for (int bx = 0; bx < width; bx += 4) {
+      switch (format) {
+      case SbImage::BC1_RGB:
+        sbimage_decode_color(src, FALSE, FALSE, block);
+        break;
+      case SbImage::BC1_RGBA:
+        sbimage_decode_color(src, FALSE, TRUE, block);
+        break;
+      case SbImage::BC2_RGBA:
+        sbimage_decode_color(src + 8, TRUE, FALSE, block);
+        sbimage_decode_explicit_alpha(src, block);
+        break;
+      case SbImage::BC3_RGBA:
+        sbimage_decode_color(src + 8, TRUE, FALSE, block);
+        sbimage_decode_alpha(src, block, 3);
+        break;
+      case SbImage::BC4_R:
+        sbimage_decode_alpha(src, block, 0);
+        break;
+      case SbImage::BC5_RG:
+        sbimage_decode_alpha(src, block, 0);
+        sbimage_decode_alpha(src + 8, block, 1);
+        break;
+      case SbImage::ETC1_RGB:
+        sbimage_decode_etc1(src, block);
+        break;
+      default:
+        assert(0 && "unknown format");
+        break;
+      }
+      src += blockbytes;
+
+      const int w = width - bx < 4 ? width - bx : 4;
+      const int h = height - by < 4 ? height - by : 4;
+      for (int y = 0; y < h; y++) {
+        unsigned char * ptr = dst + ((by + y) * width + bx) * nc;
+        for (int x = 0; x < w; x++) {
+          const unsigned char * p = block[y * 4 + x];
+          switch (nc) {
+          case 1: *ptr++ = p[0]; break;
+          case 2: *ptr++ = p[0]; *ptr++ = p[1]; break;
+          case 3: *ptr++ = p[0]; *ptr++ = p[1]; *ptr++ = p[2]; break;
+          default:
+            *ptr++ = p[0]; *ptr++ = p[1]; *ptr++ = p[2]; *ptr++ = p[3];
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+SbBool
+SbImageCodec::canEncode(const SbImage::CompressedFormat format,
+                        const int numcomponents)
+{
+  switch (format) {
+  case SbImage::BC1_RGB:
+    return numcomponents == 3 || numcomponents == 4;
+  case SbImage::BC1_RGBA:
+  case SbImage::BC2_RGBA:
+  case SbImage::BC3_RGBA:
+    return numcomponents == 4;
+  case SbImage::BC4_R:
+    return numcomponents == 1;
+  case SbImage::BC5_RG:
+    return numcomponents == 2;
+  default:
+    // FIXME: no ETC1 encoder yet. The mode and table search makes it
+    // a lot more expensive than the BCn formats to do properly.
+    return FALSE;
+  }
+}
+
+void
+SbImageCodec::encode(const SbImage::CompressedFormat format,
+                     const unsigned char * src,
+                     const int width, const int height, const int nc,
+                     unsigned char * dst)
+{
+  assert(SbImageCodec::canEncode(format, nc));
+  const int blockbytes = SbImageCodec::getBlockBytes(format);
+
+  sbimage_block block;
+  for (int by = 0; by < height; by += 4) {
+    for (int bx = 0; bx < width; bx += 4) {
+      // gather the block, replicating edge pixels for partial blocks
+      for (int y = 0; y < 4; y++) {
+        const int sy = by + y < height ? by + y : height - 1;
+        for (int x = 0; x < 4; x++) {
+          const int sx = bx + x < width ? bx + x : width - 1;
+          const unsigned char * p = src + (sy * width + sx) * nc;
+          unsigned char * q = block[y * 4 + x];
+          switch (nc) {
+          case 1: q[0] = p[0]; q[1] = q[2] = 0; q[3] = 255; break;
+          case 2: q[0] = p[0]; q[1] = p[1]; q[2] = 0; q[3] = 255; break;
+          case 3: q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = 255; break;
+          default: q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[3]; break;
+          }
+        }
+      }
+      switch (format) {
+      case SbImage::BC1_RGB:
+        sbimage_encode_color(block, FALSE, FALSE, dst);
+        break;
+      case SbImage::BC1_RGBA:
+        sbimage_encode_color(block, FALSE, TRUE, dst);
+        break;
+      case SbImage::BC2_RGBA:
+        sbimage_encode_explicit_alpha(block, dst);
+        sbimage_encode_color(block, TRUE, FALSE, dst + 8);
+        break;
+      case SbImage::BC3_RGBA:
+        sbimage_encode_alpha(block, 3, dst);
+        sbimage_encode_color(block, TRUE, FALSE, dst + 8);
+        break;
+      case SbImage::BC4_R:
+        sbimage_encode_alpha(block, 0, dst);
+        break;
+      case SbImage::BC5_RG:
+        sbimage_encode_alpha(block, 0, dst);
+        sbimage_encode_alpha(block, 1, dst + 8);
+        break;
+      default:
+        assert(0 && "unsupported format");
+        break;
+      }
+      dst += blockbytes;
+    }
+  }
+}
+
+// Box filters an image down to the next mipmap level.
+void
+SbImageCodec::halve(const unsigned char * src,
+                    const int width, const int height, const int nc,
+                    unsigned char * dst)
+{
+  const int w = width > 1 ? width >> 1 : 1;
+  const int h = height > 1 ? height >> 1 : 1;
+  for (int y = 0; y < h; y++) {
+    const int y0 = y * 2 < height ? y * 2 : height - 1;
+    const int y1 = y * 2 + 1 < height ? y * 2 + 1 : y0;
+    for (int x = 0; x < w; x++) {
+      const int x0 = x * 2 < width ? x * 2 : width - 1;
+      const int x1 = x * 2 + 1 < width ? x * 2 + 1 : x0;
+      const unsigned char * p00 = src + (y0 * width + x0) * nc;
+      const unsigned char * p01 = src + (y0 * width + x1) * nc;
+      const unsigned char * p10 = src + (y1 * width + x0) * nc;
+      const unsigned char * p11 = src + (y1 * width + x1) * nc;
+      for (int c = 0; c < nc; c++) {
+        *dst++ = (unsigned char) ((p00[c] + p01[c] + p10[c] + p11[c] + 2) >> 2);
+      }
+    }
+  }
+}
+
+// *************************************************************************
+// containers
+
+static inline unsigned int
+sbimage_read32(const unsigned char * p, const SbBool swap = FALSE)
+{
+  if (swap) {
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  }
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+#define SBIMAGE_FOURCC(a, b, c, d) \
+  ((unsigned int) (a) | ((unsigned int) (b) << 8) | \
+   ((unsigned int) (c) << 16) | ((unsigned int) (d) << 24))
+
+// Flips a compressed level upside down, by reversing the block rows
+// and the pixel rows inside each block. This is only exact when the
+// height is a multiple of four, or when the level is a single block
+// high.
+static SbBool
+sbimage_flip_level(const SbImage::CompressedFormat format,
+                   unsigned char * data, const int width, const int height)
+{
+  if (format == SbImage::ETC1_RGB) return FALSE;
+  if (height > 4 && (height & 3)) return FALSE;
+
+  const int rows = height < 4 ? height : 4;
+  const int blockbytes = SbImageCodec::getBlockBytes(format);
+  const int rowbytes = ((width + 3) / 4) * blockbytes;
+  const int numrows = (height + 3) / 4;
+
+  unsigned char tmp[16];
+  for (int by = 0; by < numrows / 2; by++) {
+    unsigned char * a = data + by * rowbytes;
+    unsigned char * b = data + (numrows - 1 - by) * rowbytes;
+    for (int i = 0; i < rowbytes; i++) {
+      const unsigned char t = a[i]; a[i] = b[i]; b[i] = t;
+    }
+  }
+
+  const int numblocks = ((width + 3) / 4) * numrows;
+  for (int i = 0; i < numblocks; i++) {
+    unsigned char * block = data + i * blockbytes;
+    // sub blocks of 8 bytes, each either a color block (one byte of
+    // indices per row), a BC2 alpha block (two bytes per row) or a
+    // BC4 block (12 bits per row)
+    for (int sub = 0; sub < blockbytes / 8; sub++) {
+      unsigned char * b = block + sub * 8;
+      const SbBool color =
+        format == SbImage::BC1_RGB || format == SbImage::BC1_RGBA ||
+        (sub == 1 && (format == SbImage::BC2_RGBA ||
+                      format == SbImage::BC3_RGBA));
+      if (color) {
+        memcpy(tmp, b + 4, 4);
+        for (int r = 0; r < rows; r++) b[4 + r] = tmp[rows - 1 - r];
+      }
+      else if (format == SbImage::BC2_RGBA) {
+        memcpy(tmp, b, 8);
+        for (int r = 0; r < rows; r++) {
+          b[r * 2] = tmp[(rows - 1 - r) * 2];
+          b[r * 2 + 1] = tmp[(rows - 1 - r) * 2 + 1];
+        }
+      }
+      else {
+        unsigned int bits[4], flipped[4];
+        const unsigned int lo = b[2] | (b[3] << 8) | (b[4] << 16);
+        const unsigned int hi = b[5] | (b[6] << 8) | (b[7] << 16);
+        bits[0] = lo & 0xfff; bits[1] = lo >> 12;
+        bits[2] = hi & 0xfff; bits[3] = hi >> 12;
+        for (int r = 0; r < 4; r++) {
+          flipped[r] = r < rows ? bits[rows - 1 - r] : bits[r];
+        }
+        const unsigned int nlo = flipped[0] | (flipped[1] << 12);
+        const unsigned int nhi = flipped[2] | (flipped[3] << 12);
+        b[2] = (unsigned char) (nlo & 0xff);
+        b[3] = (unsigned char) ((nlo >> 8) & 0xff);
+        b[4] = (unsigned char) (nlo >> 16);
+        b[5] = (unsigned char) (nhi & 0xff);
+        b[6] = (unsigned char) ((nhi >> 8) & 0xff);
+        b[7] = (unsigned char) (nhi >> 16);
+      }
+    }
+  }
+  return TRUE;
+}
+
+// Validates the mipmap chain in a container, and copies it into
+// image. Returns FALSE if there isn't at least one complete level.
+static SbBool
+sbimage_set_levels(SbImage * image, const SbImage::CompressedFormat format,
+                   const int width, const int height, int numlevels,
+                   const unsigned char * data, const size_t datalen,
+                   const size_t * levelpadding, const SbBool flip)
+{
+  if (width <= 0 || height <= 0 || width > 32767 || height > 32767) {
+    return FALSE;
+  }
+  int maxlevels = 1;
+  for (int s = width > height ? width : height; s > 1; s >>= 1) maxlevels++;
+  if (numlevels < 1) numlevels = 1;
+  if (numlevels > maxlevels) numlevels = maxlevels;
+
+  // find the number of levels actually present in the file
+  size_t total = 0, offset = 0;
+  int levels = 0;
+  for (int i = 0; i < numlevels; i++) {
+    const int w = width >> i ? width >> i : 1;
+    const int h = height >> i ? height >> i : 1;
+    const size_t levelsize = SbImageCodec::getLevelSize(format, w, h);
+    if (levelpadding) offset += 4; // KTX imageSize field
+    if (offset + levelsize > datalen) break;
+    total += levelsize;
+    offset += levelsize + (levelpadding ? levelpadding[i] : 0);
+    levels++;
+  }
+  if (levels == 0) return FALSE;
+
+  unsigned char * buf = new unsigned char[total];
+  unsigned char * dst = buf;
+  offset = 0;
+  SbBool flipped = TRUE;
+  for (int i = 0; i < levels; i++) {
+    const int w = width >> i ? width >> i : 1;
+    const int h = height >> i ? height >> i : 1;
+    const size_t levelsize = SbImageCodec::getLevelSize(format, w, h);
+    if (levelpadding) offset += 4;
+    memcpy(dst, data + offset, levelsize);
+    if (flip && !sbimage_flip_level(format, dst, w, h)) flipped = FALSE;
+    offset += levelsize + (levelpadding ? levelpadding[i] : 0);
+    dst += levelsize;
+  }
+#if COIN_DEBUG
+  if (!flipped) {
+    SoDebugError::postWarning("SbImage::readFile",
+                              "Unable to flip compressed image of size "
+                              "%dx%d to bottom-up row order. The image "
+                              "will be upside down.", width, height);
+  }
+#endif // COIN_DEBUG
+  image->setCompressedValue(SbVec2s((short) width, (short) height),
+                            format, levels, buf);
+  delete[] buf;
+  return TRUE;
+}
+
+static SbBool
+sbimage_read_dds(const unsigned char * buf, const size_t buflen,
+                 SbImage * image)
+{
+  if (buflen < 128 || sbimage_read32(buf + 4) != 124) return FALSE;
+  const unsigned char * hdr = buf + 4;
+  const unsigned int flags = sbimage_read32(hdr + 4);
+  const int height = (int) sbimage_read32(hdr + 8);
+  const int width = (int) sbimage_read32(hdr + 12);
+  const int mipcount = (flags & 0x20000) ? (int) sbimage_read32(hdr + 24) : 1;
+  const unsigned int pfflags = sbimage_read32(hdr + 76);
+  const unsigned int fourcc = sbimage_read32(hdr + 80);
+  const unsigned int caps2 = sbimage_read32(hdr + 108);
+
+  // cube maps and volume textures are not supported
+  if (caps2 & (0x200 | 0x200000)) return FALSE;
+  if (!(pfflags & 0x4)) return FALSE; // not DDPF_FOURCC, uncompressed
+
+  SbImage::CompressedFormat format = SbImage::UNCOMPRESSED;
+  size_t offset = 128;
+  switch (fourcc) {
+  case SBIMAGE_FOURCC('D','X','T','1'):
+    format = (pfflags & 0x1) ? SbImage::BC1_RGBA : SbImage::BC1_RGB;
+    break;
+  case SBIMAGE_FOURCC('D','X','T','2'):
+  case SBIMAGE_FOURCC('D','X','T','3'):
+    format = SbImage::BC2_RGBA;
+    break;
+  case SBIMAGE_FOURCC('D','X','T','4'):
+  case SBIMAGE_FOURCC('D','X','T','5'):
+    format = SbImage::BC3_RGBA;
+    break;
+  case SBIMAGE_FOURCC('A','T','I','1'):
+  case SBIMAGE_FOURCC('B','C','4','U'):
+    format = SbImage::BC4_R;
+    break;
+  case SBIMAGE_FOURCC('A','T','I','2'):
+  case SBIMAGE_FOURCC('B','C','5','U'):
+    format = SbImage::BC5_RG;
+    break;
+  case SBIMAGE_FOURCC('D','X','1','0'):
+    {
+      if (buflen < 148) return FALSE;
+      const unsigned char * dx10 = buf + 128;
+      const unsigned int dxgiformat = sbimage_read32(dx10);
+      const unsigned int dimension = sbimage_read32(dx10 + 4);
+      const unsigned int miscflag = sbimage_read32(dx10 + 8);
+      const unsigned int arraysize = sbimage_read32(dx10 + 12);
+      if (dimension != 3 || (miscflag & 0x4) || arraysize > 1) return FALSE;
+      switch (dxgiformat) {
+      case 70: case 71: case 72: format = SbImage::BC1_RGBA; break;
+      case 73: case 74: case 75: format = SbImage::BC2_RGBA; break;
+      case 76: case 77: case 78: format = SbImage::BC3_RGBA; break;
+      case 79: case 80: format = SbImage::BC4_R; break;
+      case 82: case 83: format = SbImage::BC5_RG; break;
+      default: return FALSE;
+      }
+      offset = 148;
+    }
+    break;
+  default:
+    return FALSE;
+  }
+  // DDS files store the top row first
+  return sbimage_set_levels(image, format, width, height, mipcount,
+                            buf + offset, buflen - offset, NULL, TRUE);
+}
+
+static SbBool
+sbimage_read_ktx(const unsigned char * buf, const size_t buflen,
+                 SbImage * image)
+{
+  if (buflen < 64) return FALSE;
+  const unsigned int endianness = sbimage_read32(buf + 12);
+  if (endianness != 0x04030201 && endianness != 0x01020304) return FALSE;
+  const SbBool swap = endianness != 0x04030201;
+
+  const unsigned int gltype = sbimage_read32(buf + 16, swap);
+  const unsigned int internalformat = sbimage_read32(buf + 28, swap);
+  const int width = (int) sbimage_read32(buf + 36, swap);
+  const int height = (int) sbimage_read32(buf + 40, swap);
+  const unsigned int depth = sbimage_read32(buf + 44, swap);
+  const unsigned int arraysize = sbimage_read32(buf + 48, swap);
+  const unsigned int faces = sbimage_read32(buf + 52, swap);
+  const int numlevels = (int) sbimage_read32(buf + 56, swap);
+  const size_t kvbytes = sbimage_read32(buf + 60, swap);
+
+  if (gltype != 0 || depth > 0 || arraysize > 0 || faces > 1) return FALSE;
+  if (64 + kvbytes > buflen) return FALSE;
+
+  SbImage::CompressedFormat format;
+  switch (internalformat) {
+  case 0x83f0: // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+  case 0x8c4c: // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+    format = SbImage::BC1_RGB;
+    break;
+  case 0x83f1: // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+  case 0x8c4d:
+    format = SbImage::BC1_RGBA;
+    break;
+  case 0x83f2: // GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+  case 0x8c4e:
+    format = SbImage::BC2_RGBA;
+    break;
+  case 0x83f3: // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+  case 0x8c4f:
+    format = SbImage::BC3_RGBA;
+    break;
+  case 0x8c70: // GL_COMPRESSED_LUMINANCE_LATC1_EXT
+  case 0x8dbb: // GL_COMPRESSED_RED_RGTC1
+    format = SbImage::BC4_R;
+    break;
+  case 0x8c72: // GL_COMPRESSED_LUMINANCE_ALPHA_LATC2_EXT
+  case 0x8dbd: // GL_COMPRESSED_RG_RGTC2
+    format = SbImage::BC5_RG;
+    break;
+  case 0x8d64: // GL_ETC1_RGB8_OES
+  case 0x9274: // GL_COMPRESSED_RGB8_ETC2, a superset of ETC1
+    // FIXME: ETC2 specific block modes are not decoded, and will
+    // come out wrong if the driver lacks ETC2 support.
+    format = SbImage::ETC1_RGB;
+    break;
+  default:
+    return FALSE;
+  }
+
+  // Data is stored bottom-up unless the KTXorientation key says
+  // otherwise.
+  SbBool flip = FALSE;
+  size_t kv = 0;
+  const unsigned char * kvdata = buf + 64;
+  while (kv + 4 <= kvbytes) {
+    const size_t len = sbimage_read32(kvdata + kv, swap);
+    if (kv + 4 + len > kvbytes) break;
+    const char * key = (const char *) (kvdata + kv + 4);
+    if (len > 15 && memcmp(key, "KTXorientation", 15) == 0) {
+      for (size_t i = 15; i + 2 < len; i++) {
+        if (key[i] == 'T' && key[i + 1] == '=' && key[i + 2] == 'd') flip = TRUE;
+      }
+    }
+    kv += 4 + ((len + 3) & ~size_t(3));
+  }
+
+  // levels are preceded by their size and padded to four bytes
+  const unsigned char * data = buf + 64 + kvbytes;
+  const size_t datalen = buflen - 64 - kvbytes;
+  size_t padding[16];
+  size_t offset = 0;
+  const int levels = numlevels < 1 ? 1 : (numlevels > 16 ? 16 : numlevels);
+  for (int i = 0; i < levels; i++) {
+    const int w = width >> i ? width >> i : 1;
+    const int h = height >> i ? height >> i : 1;
+    const size_t expected = SbImageCodec::getLevelSize(format, w, h);
+    padding[i] = (4 - expected % 4) % 4;
+    if (offset + 4 <= datalen &&
+        sbimage_read32(data + offset, swap) != expected) return FALSE;
+    offset += 4 + expected + padding[i];
+  }
+  return sbimage_set_levels(image, format, width, height, levels,
+                            data, datalen, padding, flip);
+}
+
+// Reads a compressed DDS or KTX file from memory.
+SbBool
+SbImageCodec::readContainer(const unsigned char * buf, const size_t buflen,
+                            SbImage * image)
+{
+  static const unsigned char ktxid[12] = {
+    0xab, 'K', 'T', 'X', ' ', '1', '1', 0xbb, '\r', '\n', 0x1a, '\n'
+  };
+  if (buflen >= 4 && memcmp(buf, "DDS ", 4) == 0) {
+    return sbimage_read_dds(buf, buflen, image);
+  }
+  if (buflen >= 12 && memcmp(buf, ktxid, 12) == 0) {
+    return sbimage_read_ktx(buf, buflen, image);
+  }
+  return FALSE;
+}
+
+#undef SBIMAGE_FOURCC
@@ -0,0 +1,68 @@
+#ifndef COIN_SBIMAGECODEC_H
+#define COIN_SBIMAGECODEC_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+// *************************************************************************
+
+#include <Inventor/SbImage.h>
+#include <stddef.h>
+
+// *************************************************************************
+
+// Block compression codecs and container parsers used by SbImage.
+// All functions operate on tightly packed 2D data, with the first row
+// being the bottom row of the image (as for the rest of SbImage).
+
+class SbImageCodec {
+public:
+  static int getNumComponents(const SbImage::CompressedFormat format);
+  static int getBlockBytes(const SbImage::CompressedFormat format);
+  static size_t getLevelSize(const SbImage::CompressedFormat format,
+                             const int width, const int height);
+  static SbBool hasAlpha(const SbImage::CompressedFormat format);
+
+  static void decode(const SbImage::CompressedFormat format,
+                     const unsigned char * src,
+                     const int width, const int height,
+                     unsigned char * dst);
+  static SbBool canEncode(const SbImage::CompressedFormat format,
+                          const int numcomponents);
+  static void encode(const SbImage::CompressedFormat format,
+                     const unsigned char * src,
+                     const int width, const int height, const int nc,
+                     unsigned char * dst);
+  static void halve(const unsigned char * src,
+                    const int width, const int height, const int nc,
+                    unsigned char * dst);
+
+  static SbBool readContainer(const unsigned char * buf, const size_t buflen,
+                              SbImage * image);
+};
+
+#endif // !COIN_SBIMAGECODEC_H
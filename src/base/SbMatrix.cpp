@@ -123,6 +123,11 @@
 #endif // COIN_DEBUG
 
 #include "coindefs.h" // COIN_STUB()
+#include "tidbitsp.h"
+
+#ifdef COIN_HAVE_X86_SIMD
+#include <emmintrin.h>
+#endif // COIN_HAVE_X86_SIMD
 
 #ifndef COIN_WORKAROUND_NO_USING_STD_FUNCS
 using std::memmove;
@@ -1515,6 +1520,159 @@ SbMatrix::multDirMatrix(const SbVec3f & src, SbVec3f & dst) const
   dst[2] = s[0]*t0[2] + s[1]*t1[2] + s[2]*t2[2];
 }
 
+// *************************************************************************
+
+// Array versions of multVecMatrix() and multDirMatrix(). The SSE2
+// versions transform one vector per iteration, with the matrix rows
+// kept in registers. They do the multiplications and additions in the
+// same order as the scalar code, so the results are identical.
+
+typedef void sbmatrix_multvec_func(const float m[4][4], const SbVec3f * src,
+                                   SbVec3f * dst, const int num);
+
+static void
+sbmatrix_multvec_c(const float m[4][4], const SbVec3f * src,
+                   SbVec3f * dst, const int num)
+{
+  const float * t0 = m[0];
+  const float * t1 = m[1];
+  const float * t2 = m[2];
+  const float * t3 = m[3];
+  for (int i = 0; i < num; i++) {
+    const SbVec3f s = src[i];
+    const float W = s[0]*t0[3] + s[1]*t1[3] + s[2]*t2[3] + t3[3];
+    dst[i][0] = (s[0]*t0[0] + s[1]*t1[0] + s[2]*t2[0] + t3[0])/W;
+    dst[i][1] = (s[0]*t0[1] + s[1]*t1[1] + s[2]*t2[1] + t3[1])/W;
+    dst[i][2] = (s[0]*t0[2] + s[1]*t1[2] + s[2]*t2[2] + t3[2])/W;
+  }
+}
+
+static void
+sbmatrix_multdir_c(const float m[4][4], const SbVec3f * src,
+                   SbVec3f * dst, const int num)
+{
+  const float * t0 = m[0];
+  const float * t1 = m[1];
+  const float * t2 = m[2];
+  for (int i = 0; i < num; i++) {
+    const SbVec3f s = src[i];
+    dst[i][0] = s[0]*t0[0] + s[1]*t1[0] + s[2]*t2[0];
+    dst[i][1] = s[0]*t0[1] + s[1]*t1[1] + s[2]*t2[1];
+    dst[i][2] = s[0]*t0[2] + s[1]*t1[2] + s[2]*t2[2];
+  }
+}
+
+#ifdef COIN_HAVE_X86_SIMD
+
+static COIN_TARGET_SSE2 inline void
+sbmatrix_store3_sse2(float * dst, const __m128 v)
+{
+  _mm_storel_pi(reinterpret_cast<__m64 *>(dst), v);
+  _mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+
+static COIN_TARGET_SSE2 void
+sbmatrix_multvec_sse2(const float m[4][4], const SbVec3f * src,
+                      SbVec3f * dst, const int num)
+{
+  const __m128 r0 = _mm_loadu_ps(m[0]);
+  const __m128 r1 = _mm_loadu_ps(m[1]);
+  const __m128 r2 = _mm_loadu_ps(m[2]);
+  const __m128 r3 = _mm_loadu_ps(m[3]);
+  for (int i = 0; i < num; i++) {
+    const float * s = src[i].getValue();
+    __m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s[0]), r0),
+                          _mm_mul_ps(_mm_set1_ps(s[1]), r1));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(s[2]), r2));
+    v = _mm_add_ps(v, r3);
+    v = _mm_div_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+    sbmatrix_store3_sse2(&dst[i][0], v);
+  }
+}
+
+static COIN_TARGET_SSE2 void
+sbmatrix_multdir_sse2(const float m[4][4], const SbVec3f * src,
+                      SbVec3f * dst, const int num)
+{
+  const __m128 r0 = _mm_loadu_ps(m[0]);
+  const __m128 r1 = _mm_loadu_ps(m[1]);
+  const __m128 r2 = _mm_loadu_ps(m[2]);
+  for (int i = 0; i < num; i++) {
+    const float * s = src[i].getValue();
+    __m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s[0]), r0),
+                          _mm_mul_ps(_mm_set1_ps(s[1]), r1));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(s[2]), r2));
+    sbmatrix_store3_sse2(&dst[i][0], v);
+  }
+}
+
+#endif // COIN_HAVE_X86_SIMD
+
+/*!
+  Multiplies the \a num vectors in \a src with this matrix, and
+  stores the results in \a dst. This gives the same results as
+  calling multVecMatrix(const SbVec3f &, SbVec3f &) for each vector,
+  but is faster for larger arrays.
+
+  \a src and \a dst can be the same array.
+
+  \since Coin 4.0
+*/
+void
+SbMatrix::multVecMatrix(const SbVec3f * src, SbVec3f * dst, const int num) const
+{
+  if (SbMatrixP::isIdentity(this->matrix)) {
+    if (src != dst) memmove(dst, src, num * sizeof(SbVec3f));
+    return;
+  }
+  static sbmatrix_multvec_func * func = NULL;
+  if (func == NULL) {
+#ifdef COIN_HAVE_X86_SIMD
+    if (coin_runtime_simd() >= COIN_SIMD_SSE2) {
+      func = sbmatrix_multvec_sse2;
+    }
+    else
+#endif // COIN_HAVE_X86_SIMD
+    {
+      func = sbmatrix_multvec_c;
+    }
+  }
+  func(this->matrix, src, dst, num);
+}
+
+/*!
+  Multiplies the \a num direction vectors in \a src with this matrix
+  (ignoring the translation components), and stores the results in \a
+  dst. This gives the same results as calling
+  multDirMatrix(const SbVec3f &, SbVec3f &) for each vector, but is
+  faster for larger arrays.
+
+  \a src and \a dst can be the same array.
+
+  \since Coin 4.0
+*/
+void
+SbMatrix::multDirMatrix(const SbVec3f * src, SbVec3f * dst, const int num) const
+{
+  if (SbMatrixP::isIdentity(this->matrix)) {
+    if (src != dst) memmove(dst, src, num * sizeof(SbVec3f));
+    return;
+  }
+  static sbmatrix_multvec_func * func = NULL;
+  if (func == NULL) {
+#ifdef COIN_HAVE_X86_SIMD
+    if (coin_runtime_simd() >= COIN_SIMD_SSE2) {
+      func = sbmatrix_multdir_sse2;
+    }
+    else
+#endif // COIN_HAVE_X86_SIMD
+    {
+      func = sbmatrix_multdir_c;
+    }
+  }
+  func(this->matrix, src, dst, num);
+}
+
 /*!
   Multiplies line point with the full matrix and multiplies the
   line direction with the matrix without the translation components.
@@ -2043,6 +2201,8 @@ SbMatrixP::decomp_affine(SbMatrixP::HMatrix A, SbMatrixP::AffineParts * parts)
 
 #ifdef COIN_TEST_SUITE
 #include <Inventor/SbDPMatrix.h>
+#include <Inventor/SbVec3f.h>
+#include <Inventor/SbRotation.h>
 
 BOOST_AUTO_TEST_CASE(constructFromSbDPMatrix) {
   SbMatrixd a(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
@@ -2053,4 +2213,41 @@ BOOST_AUTO_TEST_CASE(constructFromSbDPMatrix) {
   BOOST_CHECK_MESSAGE(b == d,
                       "Equality comparrison failed!");
 }
+
+BOOST_AUTO_TEST_CASE(multVecArray) {
+  SbMatrix persp(0.9f, 0.1f, -0.2f, 0.01f,
+                 -0.3f, 1.1f, 0.4f, -0.02f,
+                 0.2f, -0.5f, 0.8f, 0.03f,
+                 5.0f, -7.0f, 3.0f, 1.5f);
+  SbMatrix affine;
+  affine.setTransform(SbVec3f(1.0f, -2.0f, 3.5f),
+                      SbRotation(SbVec3f(1.0f, 1.0f, 0.0f), 0.7f),
+                      SbVec3f(2.0f, 0.5f, 1.5f));
+  const SbMatrix identity = SbMatrix::identity();
+  const SbMatrix * matrices[] = { &persp, &affine, &identity };
+
+  const int num = 37;
+  SbVec3f src[num];
+  for (int i = 0; i < num; i++) {
+    src[i].setValue(float(i) * 0.37f - 5.0f, float(i * i) * 0.01f, 3.0f - float(i));
+  }
+
+  for (int m = 0; m < 3; m++) {
+    const SbMatrix & matrix = *matrices[m];
+    SbVec3f dst[num], dir[num], inplace[num];
+    matrix.multVecMatrix(src, dst, num);
+    matrix.multDirMatrix(src, dir, num);
+    for (int i = 0; i < num; i++) inplace[i] = src[i];
+    matrix.multVecMatrix(inplace, inplace, num);
+
+    SbBool ok = TRUE;
+    for (int i = 0; i < num; i++) {
+      SbVec3f v, d;
+      matrix.multVecMatrix(src[i], v);
+      matrix.multDirMatrix(src[i], d);
+      if (v != dst[i] || d != dir[i] || v != inplace[i]) ok = FALSE;
+    }
+    BOOST_CHECK_MESSAGE(ok, "array version differs from single vector version");
+  }
+}
 #endif //COIN_TEST_SUITE
@@ -0,0 +1,221 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include "base/SbPointWelder.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// Hash of three integers, with a final mix so the low bits can be
+// used directly as the bucket index.
+static inline uint32_t
+sbpointwelder_mix(uint32_t x, uint32_t y, uint32_t z)
+{
+  uint32_t h = x * 73856093u ^ y * 19349663u ^ z * 83492791u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+// Bits of a coordinate, with -0 and 0 giving the same bits since they
+// compare equal.
+static inline uint32_t
+sbpointwelder_bits(const float f)
+{
+  const float v = (f == 0.0f) ? 0.0f : f;
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+SbPointWelder::SbPointWelder(const float tol, const int approxpoints)
+  : tolerance(tol),
+    invcellsize((tol > 0.0f) ? 1.0f / tol : 0.0f),
+    next(approxpoints),
+    points(approxpoints)
+{
+  assert(tol >= 0.0f);
+  int numbuckets = 64;
+  while (numbuckets < approxpoints) numbuckets <<= 1;
+  for (int i = 0; i < numbuckets; i++) this->buckets.append(-1);
+}
+
+SbPointWelder::~SbPointWelder()
+{
+}
+
+// Removes all points and frees their memory, and sets the tolerance
+// for the points added after this.
+void
+SbPointWelder::clear(const float tol)
+{
+  assert(tol >= 0.0f);
+  this->tolerance = tol;
+  this->invcellsize = (tol > 0.0f) ? 1.0f / tol : 0.0f;
+  this->points.truncate(0, TRUE);
+  this->next.truncate(0, TRUE);
+  this->buckets.truncate(0, TRUE);
+  for (int i = 0; i < 64; i++) this->buckets.append(-1);
+}
+
+float
+SbPointWelder::getTolerance(void) const
+{
+  return this->tolerance;
+}
+
+int
+SbPointWelder::getNumPoints(void) const
+{
+  return this->points.getLength();
+}
+
+const SbVec3f &
+SbPointWelder::getPoint(const int idx) const
+{
+  assert(idx >= 0 && idx < this->points.getLength());
+  return this->points.getArrayPtr()[idx];
+}
+
+const SbVec3f *
+SbPointWelder::getPointsArrayPtr(void) const
+{
+  return this->points.getArrayPtr();
+}
+
+// Returns the index of the point equal to, or within the tolerance
+// of, pt, or -1 if there is none.
+int
+SbPointWelder::findPoint(const SbVec3f & pt) const
+{
+  if (this->tolerance == 0.0f) {
+    return this->findInBucket(this->hashPoint(pt), pt);
+  }
+  int x, y, z;
+  this->getCell(pt, x, y, z);
+  int found = -1;
+  for (int dz = -1; dz <= 1; dz++) {
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        const int idx = this->findInBucket(this->hashCell(x + dx, y + dy, z + dz), pt);
+        if (idx >= 0 && (found < 0 || idx < found)) found = idx;
+      }
+    }
+  }
+  return found;
+}
+
+// Adds pt, unless there is a point to weld it to, and returns the
+// index of the point it ends up as.
+int
+SbPointWelder::addPoint(const SbVec3f & pt)
+{
+  const int found = this->findPoint(pt);
+  if (found >= 0) return found;
+
+  const int idx = this->points.getLength();
+  if (idx >= this->buckets.getLength()) {
+    this->rehash(this->buckets.getLength() * 2);
+  }
+  this->points.append(pt);
+  const uint32_t bucket = this->hashPoint(pt) & (this->buckets.getLength() - 1);
+  this->next.append(this->buckets[bucket]);
+  this->buckets[bucket] = idx;
+  return idx;
+}
+
+// Returns the first point in bucket, which is a hash value, welding
+// to pt.
+int
+SbPointWelder::findInBucket(const uint32_t bucket, const SbVec3f & pt) const
+{
+  const int * nextptr = this->next.getArrayPtr();
+  const SbVec3f * pts = this->points.getArrayPtr();
+  int idx = this->buckets.getArrayPtr()[bucket & (this->buckets.getLength() - 1)];
+  if (this->tolerance == 0.0f) {
+    while (idx >= 0 && pts[idx] != pt) idx = nextptr[idx];
+    return idx;
+  }
+  // points are prepended to the buckets, so the last one found is
+  // the first one added
+  const float sqrtol = this->tolerance * this->tolerance;
+  int found = -1;
+  for (; idx >= 0; idx = nextptr[idx]) {
+    if ((pts[idx] - pt).sqrLength() <= sqrtol) found = idx;
+  }
+  return found;
+}
+
+void
+SbPointWelder::getCell(const SbVec3f & pt, int & x, int & y, int & z) const
+{
+  int cell[3];
+  for (int i = 0; i < 3; i++) {
+    double c = floor(double(pt[i]) * double(this->invcellsize));
+    // keep away from overflow when offsetting to neighbour cells,
+    // and let NaN end up somewhere
+    if (!(c > -1073741824.0)) c = -1073741824.0;
+    if (c > 1073741824.0) c = 1073741824.0;
+    cell[i] = int(c);
+  }
+  x = cell[0]; y = cell[1]; z = cell[2];
+}
+
+uint32_t
+SbPointWelder::hashCell(const int x, const int y, const int z) const
+{
+  return sbpointwelder_mix(uint32_t(x), uint32_t(y), uint32_t(z));
+}
+
+uint32_t
+SbPointWelder::hashPoint(const SbVec3f & pt) const
+{
+  if (this->tolerance == 0.0f) {
+    return sbpointwelder_mix(sbpointwelder_bits(pt[0]),
+                             sbpointwelder_bits(pt[1]),
+                             sbpointwelder_bits(pt[2]));
+  }
+  int x, y, z;
+  this->getCell(pt, x, y, z);
+  return this->hashCell(x, y, z);
+}
+
+void
+SbPointWelder::rehash(const int numbuckets)
+{
+  assert((numbuckets & (numbuckets - 1)) == 0);
+  this->buckets.truncate(0);
+  int i;
+  for (i = 0; i < numbuckets; i++) this->buckets.append(-1);
+  const int n = this->points.getLength();
+  const SbVec3f * pts = this->points.getArrayPtr();
+  for (i = 0; i < n; i++) {
+    const uint32_t bucket = this->hashPoint(pts[i]) & (numbuckets - 1);
+    this->next[i] = this->buckets[bucket];
+    this->buckets[bucket] = i;
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef COIN_SBPOINTWELDER_H
+#define COIN_SBPOINTWELDER_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+#include <Inventor/SbVec3f.h>
+#include <Inventor/system/inttypes.h>
+#include <Inventor/lists/SbList.h>
+
+// Welds points by giving equal points the same index, with a hash
+// table over the points. Point i is the i'th distinct point added.
+//
+// With a tolerance of 0, only points comparing equal are welded, just
+// like with SbBSPTree::addPoint(). With a positive tolerance, a point
+// is welded to the first added point at a distance of at most the
+// tolerance, and the points are hashed on a grid with cells of that
+// size, so only the neighbouring cells need to be searched.
+
+class SbPointWelder {
+public:
+  SbPointWelder(const float tolerance = 0.0f, const int approxpoints = 64);
+  ~SbPointWelder();
+
+  void clear(const float tolerance = 0.0f);
+
+  int addPoint(const SbVec3f & pt);
+  int findPoint(const SbVec3f & pt) const;
+
+  int getNumPoints(void) const;
+  const SbVec3f & getPoint(const int idx) const;
+  const SbVec3f * getPointsArrayPtr(void) const;
+  float getTolerance(void) const;
+
+private:
+  uint32_t hashCell(const int x, const int y, const int z) const;
+  uint32_t hashPoint(const SbVec3f & pt) const;
+  void getCell(const SbVec3f & pt, int & x, int & y, int & z) const;
+  int findInBucket(const uint32_t bucket, const SbVec3f & pt) const;
+  void rehash(const int numbuckets);
+
+  float tolerance;
+  float invcellsize;
+  // first point of each bucket, and the next point in the bucket of
+  // each point, -1 terminated
+  SbList<int> buckets;
+  SbList<int> next;
+  SbList<SbVec3f> points;
+};
+
+#endif // !COIN_SBPOINTWELDER_H
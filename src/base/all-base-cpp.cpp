@@ -40,12 +40,15 @@
 #include "SbDict.cpp"
 #include "SbHeap.cpp"
 #include "SbImage.cpp"
+#include "SbImageCodec.cpp"
 #include "SbLine.cpp"
 #include "SbDPLine.cpp"
 #include "SbMatrix.cpp"
 #include "SbDPMatrix.cpp"
 #include "SbName.cpp"
 #include "SbOctTree.cpp"
+#include "SbBVH.cpp"
+#include "SbPointWelder.cpp"
 #include "SbPlane.cpp"
 #include "SbDPPlane.cpp"
 #include "SbRotation.cpp"
@@ -30,6 +30,14 @@
   by tessellating all polygons into triangles and storing the newly
   generated primitives in an internal cache.
 
+  Polygons are tessellated by up to four threads, or the number set
+  in the environment variable \c COIN_CONVEXDATACACHE_THREADS. Small
+  polygons with no intersecting edges are triangulated by clipping
+  ears directly, and other polygons by SbTesselator, or by the GLU
+  tessellator if \c COIN_PREFER_GLU_TESSELLATOR is set. With
+  setCacheDirectory(), the result is also stored on disk and reused
+  by later runs of the application.
+
   This class is not part of the original SGI Open Inventor v2.1
   API, but is a Coin extension.
 */
@@ -39,15 +47,34 @@
 #include <Inventor/caches/SoConvexDataCache.h>
 
 #include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include <Inventor/SbMatrix.h>
 #include <Inventor/SbTesselator.h>
+#include <Inventor/C/tidbits.h>
 #include <Inventor/elements/SoCoordinateElement.h>
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/lists/SbList.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#ifdef HAVE_WINDOWS_H
+#include <windows.h> // GetCurrentProcessId()
+#endif // HAVE_WINDOWS_H
+#ifdef HAVE_UNISTD_H
+#include <unistd.h> // getpid()
+#endif // HAVE_UNISTD_H
+
 #include "tidbitsp.h"
 #include "base/SbGLUTessellator.h"
+#include "threads/threadsutilp.h"
 
 // *************************************************************************
 
@@ -219,6 +246,646 @@ typedef struct {
   int numtexind;
 } tTessData;
 
+// polygon vertices handed to a thread at a time
+#define SOCONVEXDATACACHE_CHUNK 2048
+// largest polygon triangulated by soconvexdatacache_earclip()
+#define SOCONVEXDATACACHE_MAXEARCLIP 32
+// smallest number of coordinate indices worth storing on disk
+#define SOCONVEXDATACACHE_MINSTORE 1024
+// bump this when the triangulation changes, to ignore old files
+#define SOCONVEXDATACACHE_VERSION 1
+
+// *************************************************************************
+
+// twice the signed area of the triangle a, b, c
+static double
+soconvexdatacache_orient(const double * x, const double * y,
+                         const int a, const int b, const int c)
+{
+  return (x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a]);
+}
+
+// whether c, which is on the line through a and b, is on the segment
+static SbBool
+soconvexdatacache_on_segment(const double * x, const double * y,
+                             const int a, const int b, const int c)
+{
+  return
+    x[c] >= SbMin(x[a], x[b]) && x[c] <= SbMax(x[a], x[b]) &&
+    y[c] >= SbMin(y[a], y[b]) && y[c] <= SbMax(y[a], y[b]);
+}
+
+// whether the segments a-b and c-d intersect or touch
+static SbBool
+soconvexdatacache_segments_touch(const double * x, const double * y,
+                                 const int a, const int b,
+                                 const int c, const int d)
+{
+  const double d1 = soconvexdatacache_orient(x, y, c, d, a);
+  const double d2 = soconvexdatacache_orient(x, y, c, d, b);
+  const double d3 = soconvexdatacache_orient(x, y, a, b, c);
+  const double d4 = soconvexdatacache_orient(x, y, a, b, d);
+  if (((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) &&
+      ((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0))) return TRUE;
+  return
+    (d1 == 0.0 && soconvexdatacache_on_segment(x, y, c, d, a)) ||
+    (d2 == 0.0 && soconvexdatacache_on_segment(x, y, c, d, b)) ||
+    (d3 == 0.0 && soconvexdatacache_on_segment(x, y, a, b, c)) ||
+    (d4 == 0.0 && soconvexdatacache_on_segment(x, y, a, b, d));
+}
+
+// The weight SbTesselator gives the triangle a, b, c, computed with
+// the same single precision steps, so that both pick the same
+// ears. It is related to, but not quite, the square of the
+// circumcircle radius.
+static double
+soconvexdatacache_circle_size(const float * x, const float * y,
+                              const int a, const int b, const int c)
+{
+  const double d1 = (x[b] - x[a]) * (x[c] - x[a]) + (y[b] - y[a]) * (y[c] - y[a]);
+  const double d2 = (x[b] - x[c]) * (x[a] - x[c]) + (y[b] - y[c]) * (y[a] - y[c]);
+  const double d3 = (x[a] - x[b]) * (x[c] - x[b]) + (y[a] - y[b]) * (y[c] - y[b]);
+  const double c1 = d2 * d3;
+  const double c2 = d3 * d1;
+  const double c3 = d1 * d2;
+  const double div = 2.0f * (c1 + c2 + c3);
+  if (div == 0.0f) return FLT_MAX;
+  const double val = 1.0f / div;
+  const float w1 = float(c2 + c3), w2 = float(c3 + c1), w3 = float(c1 + c2);
+  const double cx = (x[c] * w3 + x[a] * w1 + x[b] * w2) * val;
+  const double cy = (y[c] * w3 + y[a] * w1 + y[b] * w2) * val;
+  return (x[a] - cx) * (x[a] - cx) + (y[a] - cy) * (y[a] - cy);
+}
+
+// Returns the weight of the triangle a, next[a], next[next[a]], or
+// DBL_MAX if it is not an ear. dir is the sign of the polygon area.
+static double
+soconvexdatacache_ear_weight(const double * x, const double * y,
+                             const float * fx, const float * fy,
+                             const int * next, const int a, const double dir)
+{
+  const int b = next[a];
+  const int c = next[b];
+  const double cross = soconvexdatacache_orient(x, y, a, b, c) * dir;
+  if (cross <= 0.0) return DBL_MAX;
+  for (int k = next[c]; k != a; k = next[k]) {
+    if (soconvexdatacache_orient(x, y, a, b, k) * dir >= 0.0 &&
+        soconvexdatacache_orient(x, y, b, c, k) * dir >= 0.0 &&
+        soconvexdatacache_orient(x, y, c, a, k) * dir >= 0.0) return DBL_MAX;
+  }
+  return soconvexdatacache_circle_size(fx, fy, a, b, c);
+}
+
+// Triangulates a simple polygon by clipping ears, for the small
+// polygons where setting up SbTesselator costs more than the
+// tessellation itself. The ears are picked as by SbTesselator, which
+// clips the ear with the smallest circumcircle first, and splits the
+// last four vertices along the diagonal giving the smaller
+// circumcircles. Returns FALSE,
+// without emitting anything, if the polygon must be left to
+// SbTesselator: if it has repeated or collinear vertices, touching
+// edges or more than SOCONVEXDATACACHE_MAXEARCLIP vertices.
+static SbBool
+soconvexdatacache_earclip(const SbVec3f * coords, tVertexInfo * info,
+                          const int n, tTessData * tessdata)
+{
+  if (n < 3 || n > SOCONVEXDATACACHE_MAXEARCLIP) return FALSE;
+  int i, j;
+  for (i = 0; i < n; i++) {
+    if (coords[i] == coords[(i + 1) % n]) return FALSE;
+  }
+  if (n == 3) {
+    do_triangle(&info[0], &info[1], &info[2], tessdata);
+    return TRUE;
+  }
+
+  // project onto the coordinate plane most perpendicular to the
+  // polygon normal
+  double normal[3] = { 0.0, 0.0, 0.0 };
+  for (i = 0; i < n; i++) {
+    const SbVec3f & v0 = coords[i];
+    const SbVec3f & v1 = coords[(i + 1) % n];
+    normal[0] += (double(v0[1]) - v1[1]) * (double(v0[2]) + v1[2]);
+    normal[1] += (double(v0[2]) - v1[2]) * (double(v0[0]) + v1[0]);
+    normal[2] += (double(v0[0]) - v1[0]) * (double(v0[1]) + v1[1]);
+  }
+  int X = 0, Y = 1;
+  if (fabs(normal[0]) > fabs(normal[1])) {
+    if (fabs(normal[0]) > fabs(normal[2])) { X = 1; Y = 2; }
+  }
+  else if (fabs(normal[1]) > fabs(normal[2])) { X = 2; Y = 0; }
+
+  float fx[SOCONVEXDATACACHE_MAXEARCLIP];
+  float fy[SOCONVEXDATACACHE_MAXEARCLIP];
+  double x[SOCONVEXDATACACHE_MAXEARCLIP];
+  double y[SOCONVEXDATACACHE_MAXEARCLIP];
+  double area = 0.0;
+  for (i = 0; i < n; i++) {
+    x[i] = fx[i] = coords[i][X];
+    y[i] = fy[i] = coords[i][Y];
+  }
+  for (i = 0; i < n; i++) {
+    j = (i + 1) % n;
+    area += x[i] * y[j] - x[j] * y[i];
+  }
+  if (area == 0.0) return FALSE;
+  const double dir = area > 0.0 ? 1.0 : -1.0;
+
+  for (i = 0; i < n; i++) {
+    if (soconvexdatacache_orient(x, y, (i + n - 1) % n, i, (i + 1) % n) == 0.0) {
+      return FALSE;
+    }
+  }
+  for (i = 0; i < n; i++) {
+    for (j = i + 2; j < n; j++) {
+      if ((j + 1) % n == i) continue; // adjacent edges
+      if (soconvexdatacache_segments_touch(x, y, i, (i + 1) % n, j, (j + 1) % n)) {
+        return FALSE;
+      }
+    }
+  }
+
+  int next[SOCONVEXDATACACHE_MAXEARCLIP];
+  int prev[SOCONVEXDATACACHE_MAXEARCLIP];
+  double weight[SOCONVEXDATACACHE_MAXEARCLIP];
+  SbBool dirty[SOCONVEXDATACACHE_MAXEARCLIP];
+  for (i = 0; i < n; i++) {
+    next[i] = (i + 1) % n;
+    prev[i] = (i + n - 1) % n;
+    dirty[i] = TRUE;
+  }
+
+  // the triangles are kept until the polygon is known to be
+  // triangulated, as nothing must be emitted if this fails
+  int tri[3 * (SOCONVEXDATACACHE_MAXEARCLIP - 2)];
+  int numtri = 0;
+  int first = 0;
+  for (int m = n; m > 4; m--) {
+    int best = -1;
+    int a = first;
+    do {
+      // clipping an ear never makes another ear invalid, but may
+      // make vertices that were not ears into ears
+      if (dirty[a]) {
+        weight[a] = soconvexdatacache_ear_weight(x, y, fx, fy, next, a, dir);
+        dirty[a] = weight[a] == DBL_MAX;
+      }
+      if (best < 0 || weight[a] < weight[best]) best = a;
+      a = next[a];
+    } while (a != first);
+    if (weight[best] == DBL_MAX) return FALSE;
+
+    const int b = next[best];
+    const int c = next[b];
+    tri[numtri++] = best;
+    tri[numtri++] = b;
+    tri[numtri++] = c;
+    next[best] = c;
+    prev[c] = best;
+    dirty[best] = dirty[prev[best]] = TRUE;
+    first = best;
+  }
+
+  const int a = first, b = next[a], c = next[b], d = next[c];
+  const int quad[4] = { a, b, c, d };
+  for (i = 0; i < 4; i++) {
+    if (dirty[quad[i]]) {
+      weight[quad[i]] = soconvexdatacache_ear_weight(x, y, fx, fy, next, quad[i], dir);
+    }
+  }
+  const double w0 = SbMax(weight[a], weight[c]);
+  const double w1 = SbMax(weight[b], weight[d]);
+  if (w0 == DBL_MAX && w1 == DBL_MAX) return FALSE;
+  const int v = (w0 < w1) ? 0 : 1;
+  tri[numtri++] = quad[v];
+  tri[numtri++] = quad[v + 1];
+  tri[numtri++] = quad[v + 2];
+  tri[numtri++] = quad[v];
+  tri[numtri++] = quad[v + 2];
+  tri[numtri++] = quad[(v + 3) % 4];
+
+  for (i = 0; i < numtri; i += 3) {
+    do_triangle(&info[tri[i]], &info[tri[i + 1]], &info[tri[i + 2]], tessdata);
+  }
+  return TRUE;
+}
+
+// *************************************************************************
+
+// Polygons are tessellated by chunks of SOCONVEXDATACACHE_CHUNK
+// vertices, each by the first free thread of cc_parallel_for(). The
+// triangles of each chunk are stored separately, and concatenated in
+// order afterwards, so the result does not depend on the number of
+// threads.
+typedef struct {
+  const tTessData * tessdata;
+  const SbVec3f * coords;
+  const int * polygons; // start and end of each polygon in vind
+  const int * chunks; // first polygon of each chunk, and the end
+  int numchunks;
+  SoConvexDataCacheP ** results;
+  SbBool glu;
+} soconvexdatacache_tessjob;
+
+static void
+soconvexdatacache_tessellate_chunks(void * closure, int first, int last)
+{
+  soconvexdatacache_tessjob * job =
+    static_cast<soconvexdatacache_tessjob *>(closure);
+
+  tTessData tessdata = *job->tessdata;
+  SbGLUTessellator * glutess = NULL;
+  SbTesselator * tess = NULL;
+  if (job->glu) glutess = new SbGLUTessellator(do_triangle, &tessdata);
+  else tess = new SbTesselator(do_triangle, &tessdata);
+
+  for (int chunk = first; chunk < last; chunk++) {
+    SoConvexDataCacheP * result = job->results[chunk];
+    tessdata.vertexIndex = &result->coordIndices;
+    tessdata.matIndex = (tessdata.matbind != SoConvexDataCache::NONE) ?
+      &result->materialIndices : NULL;
+    tessdata.normIndex = (tessdata.normbind != SoConvexDataCache::NONE) ?
+      &result->normalIndices : NULL;
+    tessdata.texIndex = (tessdata.texbind != SoConvexDataCache::NONE) ?
+      &result->texIndices : NULL;
+
+    for (int p = job->chunks[chunk]; p < job->chunks[chunk + 1]; p++) {
+      const int start = job->polygons[2 * p];
+      const int end = job->polygons[2 * p + 1];
+      int i;
+      if (glutess) {
+        glutess->beginPolygon();
+        for (i = start; i < end; i++) {
+          glutess->addVertex(job->coords[i], static_cast<void *>(&tessdata.vertexInfo[i]));
+        }
+        glutess->endPolygon();
+      }
+      else if (!soconvexdatacache_earclip(job->coords + start, tessdata.vertexInfo + start,
+                                          end - start, &tessdata)) {
+        tess->beginPolygon();
+        for (i = start; i < end; i++) {
+          tess->addVertex(job->coords[i], static_cast<void *>(&tessdata.vertexInfo[i]));
+        }
+        tess->endPolygon();
+      }
+    }
+  }
+  delete glutess;
+  delete tess;
+}
+
+// Appends the lists of results 1 to num - 1 to those of result 0,
+// and deletes them
+static void
+soconvexdatacache_merge(SoConvexDataCacheP ** results, const int num)
+{
+  SbList <int32_t> SoConvexDataCacheP::*lists[4] = {
+    &SoConvexDataCacheP::coordIndices,
+    &SoConvexDataCacheP::materialIndices,
+    &SoConvexDataCacheP::normalIndices,
+    &SoConvexDataCacheP::texIndices
+  };
+  for (int l = 0; l < 4; l++) {
+    SbList <int32_t> & dst = results[0]->*lists[l];
+    // SbList::ensureCapacity() allocates exactly what is asked for,
+    // so it must only be called once
+    int total = 0;
+    int r;
+    for (r = 0; r < num; r++) total += (results[r]->*lists[l]).getLength();
+    dst.ensureCapacity(total);
+    for (r = 1; r < num; r++) {
+      const SbList <int32_t> & src = results[r]->*lists[l];
+      const int n = src.getLength();
+      for (int i = 0; i < n; i++) dst.append(src[i]);
+    }
+  }
+  for (int r = 1; r < num; r++) delete results[r];
+}
+
+// *************************************************************************
+
+// Cache files hold the input of generate(), with the coordinates
+// transformed, followed by the generated indices. Everything is
+// stored as little endian 32 bit words:
+//
+//   "COIN" "CNVX"
+//   SOCONVEXDATACACHE_VERSION
+//   numv, matbind, normbind, texbind, GLU tessellator used
+//   for each of the numv coordinate indices: the index, and for
+//     indices >= 0, material, texture, normal and vertex number and
+//     the three coordinates
+//   length and contents of the coordinate, material, normal and
+//     texture coordinate index lists
+//
+// The input is compared in full when a file is read, so a hash
+// collision in the file name can never restore the wrong
+// triangles.
+
+static void * soconvexdatacache_mutex = NULL;
+static SbString * soconvexdatacache_dir = NULL;
+static int soconvexdatacache_numthreads = 1;
+static SbBool soconvexdatacache_initialized = FALSE;
+
+static void
+soconvexdatacache_cleanup(void)
+{
+  delete soconvexdatacache_dir;
+  soconvexdatacache_dir = NULL;
+  soconvexdatacache_initialized = FALSE;
+  CC_MUTEX_DESTRUCT(soconvexdatacache_mutex);
+}
+
+// returns with the mutex locked
+static void
+soconvexdatacache_lock(void)
+{
+  CC_MUTEX_CONSTRUCT(soconvexdatacache_mutex);
+  CC_MUTEX_LOCK(soconvexdatacache_mutex);
+  if (!soconvexdatacache_initialized) {
+    const char * env = coin_getenv("COIN_CONVEXDATACACHE_DIR");
+    if (env && env[0]) soconvexdatacache_dir = new SbString(env);
+    env = coin_getenv("COIN_CONVEXDATACACHE_THREADS");
+    soconvexdatacache_numthreads = env ? SbMax(atoi(env), 1) : 4;
+    coin_atexit(soconvexdatacache_cleanup, CC_ATEXIT_NORMAL);
+    soconvexdatacache_initialized = TRUE;
+  }
+}
+
+static uint32_t
+soconvexdatacache_read32(const unsigned char * src)
+{
+  return
+    (uint32_t) src[0] | ((uint32_t) src[1] << 8) |
+    ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+// Passes 32 bit words to or from a cache file. The same code
+// serializes the input for hashing it, writing it and comparing it
+// with a file, so the three can not disagree.
+class soconvexdatacache_stream {
+public:
+  enum Mode { HASH, WRITE, COMPARE, READ };
+
+  soconvexdatacache_stream(const Mode m, FILE * f)
+    : mode(m), ok(TRUE), hash((uint64_t(0xcbf29ce4) << 32) | 0x84222325),
+      fp(f), pos(0), len(0) { }
+
+  void put(const uint32_t val) {
+    if (this->mode == HASH) {
+      // 64 bit FNV-1a, a word at a time
+      this->hash ^= val;
+      this->hash *= (uint64_t(0x100) << 32) | 0x1b3;
+    }
+    else if (this->mode == WRITE) {
+      if (this->pos == sizeof(this->buffer)) this->flush();
+      unsigned char * dst = this->buffer + this->pos;
+      dst[0] = (unsigned char) (val & 0xff);
+      dst[1] = (unsigned char) ((val >> 8) & 0xff);
+      dst[2] = (unsigned char) ((val >> 16) & 0xff);
+      dst[3] = (unsigned char) ((val >> 24) & 0xff);
+      this->pos += 4;
+    }
+    else if (this->get() != val) {
+      this->ok = FALSE;
+    }
+  }
+
+  uint32_t get(void) {
+    if (!this->ok) return 0;
+    if (this->len - this->pos < 4) {
+      if (this->len != this->pos) { this->ok = FALSE; return 0; }
+      this->len = fread(this->buffer, 1, sizeof(this->buffer), this->fp);
+      this->pos = 0;
+      if (this->len < 4) { this->ok = FALSE; return 0; }
+    }
+    const uint32_t val = soconvexdatacache_read32(this->buffer + this->pos);
+    this->pos += 4;
+    return val;
+  }
+
+  void flush(void) {
+    if (this->pos && fwrite(this->buffer, 1, this->pos, this->fp) != this->pos) {
+      this->ok = FALSE;
+    }
+    this->pos = 0;
+  }
+
+  Mode mode;
+  SbBool ok;
+  uint64_t hash;
+
+private:
+  FILE * fp;
+  size_t pos, len;
+  unsigned char buffer[4096];
+};
+
+typedef struct {
+  const int32_t * vind;
+  int numv;
+  const tVertexInfo * vertexinfo;
+  const SbVec3f * coords;
+  SoConvexDataCache::Binding matbind;
+  SoConvexDataCache::Binding normbind;
+  SoConvexDataCache::Binding texbind;
+  SbBool glu;
+} soconvexdatacache_key;
+
+static void
+soconvexdatacache_put_key(soconvexdatacache_stream & s,
+                          const soconvexdatacache_key & key)
+{
+  s.put(soconvexdatacache_read32((const unsigned char *) "COIN"));
+  s.put(soconvexdatacache_read32((const unsigned char *) "CNVX"));
+  s.put(SOCONVEXDATACACHE_VERSION);
+  s.put((uint32_t) key.numv);
+  s.put((uint32_t) key.matbind);
+  s.put((uint32_t) key.normbind);
+  s.put((uint32_t) key.texbind);
+  s.put(key.glu ? 1 : 0);
+  for (int i = 0; i < key.numv; i++) {
+    s.put((uint32_t) key.vind[i]);
+    if (key.vind[i] >= 0) {
+      const tVertexInfo & info = key.vertexinfo[i];
+      s.put((uint32_t) info.matnr);
+      s.put((uint32_t) info.texnr);
+      s.put((uint32_t) info.normnr);
+      s.put((uint32_t) info.vertexnr);
+      for (int j = 0; j < 3; j++) {
+        uint32_t bits;
+        memcpy(&bits, &key.coords[i][j], sizeof(bits));
+        s.put(bits);
+      }
+    }
+  }
+}
+
+static SbString
+soconvexdatacache_filename(const SbString & dir, const soconvexdatacache_key & key)
+{
+  soconvexdatacache_stream s(soconvexdatacache_stream::HASH, NULL);
+  soconvexdatacache_put_key(s, key);
+  SbString name;
+  name.sprintf("%s/coin-%08x%08x.cnvx", dir.getString(),
+               (unsigned int) (s.hash >> 32), (unsigned int) (s.hash & 0xffffffff));
+  return name;
+}
+
+static SbBool
+soconvexdatacache_get_list(soconvexdatacache_stream & s, SbList <int32_t> & list,
+                           const uint32_t maxlen)
+{
+  const uint32_t n = s.get();
+  if (!s.ok || n > maxlen) return FALSE;
+  list.truncate(0);
+  list.ensureCapacity((int) n);
+  for (uint32_t i = 0; i < n; i++) list.append((int32_t) s.get());
+  return s.ok;
+}
+
+static void
+soconvexdatacache_put_list(soconvexdatacache_stream & s, const SbList <int32_t> & list)
+{
+  const int n = list.getLength();
+  s.put((uint32_t) n);
+  for (int i = 0; i < n; i++) s.put((uint32_t) list[i]);
+}
+
+// Checks that the index lists of data could have been made from key:
+// whole triangles, as many material, normal and texture indices as
+// the bindings give, and only indices that the polygons of key use.
+// A damaged file can then not make the shape index outside its
+// coordinates, materials, normals or texture coordinates.
+static SbBool
+soconvexdatacache_check_list(const SbList <int32_t> & list,
+                             const SoConvexDataCache::Binding binding,
+                             const int numtriangles,
+                             const int lo, const int hi)
+{
+  const int n = list.getLength();
+  if (binding == SoConvexDataCache::NONE) return n == 0;
+  // per face bindings have an index per triangle, per vertex ones an
+  // index per corner and a -1 after each triangle
+  const SbBool pervertex = binding >= SoConvexDataCache::PER_VERTEX;
+  if (n != (pervertex ? 4 * numtriangles : numtriangles)) return FALSE;
+  for (int i = 0; i < n; i++) {
+    const int32_t idx = list[i];
+    if (pervertex && (i & 3) == 3) {
+      if (idx != -1) return FALSE;
+    }
+    else if (idx < lo || idx > hi) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static SbBool
+soconvexdatacache_check_lists(const soconvexdatacache_key & key,
+                              const SoConvexDataCacheP * data)
+{
+  // the range of each kind of index used by the polygons
+  int lo[4] = { INT_MAX, INT_MAX, INT_MAX, INT_MAX };
+  int hi[4] = { INT_MIN, INT_MIN, INT_MIN, INT_MIN };
+  for (int i = 0; i < key.numv; i++) {
+    if (key.vind[i] < 0) continue;
+    const tVertexInfo & info = key.vertexinfo[i];
+    const int idx[4] = { info.vertexnr, info.matnr, info.normnr, info.texnr };
+    for (int j = 0; j < 4; j++) {
+      lo[j] = SbMin(lo[j], idx[j]);
+      hi[j] = SbMax(hi[j], idx[j]);
+    }
+  }
+
+  const int numcoords = data->coordIndices.getLength();
+  if (numcoords % 4) return FALSE;
+  const int numtriangles = numcoords / 4;
+  // texture coordinates always go with the vertices
+  const SoConvexDataCache::Binding texbind =
+    (key.texbind == SoConvexDataCache::NONE) ?
+    SoConvexDataCache::NONE : SoConvexDataCache::PER_VERTEX;
+  return
+    soconvexdatacache_check_list(data->coordIndices, SoConvexDataCache::PER_VERTEX,
+                                 numtriangles, lo[0], hi[0]) &&
+    soconvexdatacache_check_list(data->materialIndices, key.matbind,
+                                 numtriangles, lo[1], hi[1]) &&
+    soconvexdatacache_check_list(data->normalIndices, key.normbind,
+                                 numtriangles, lo[2], hi[2]) &&
+    soconvexdatacache_check_list(data->texIndices, texbind,
+                                 numtriangles, lo[3], hi[3]);
+}
+
+// must be called with the mutex locked. Leaves result empty if there
+// is no valid file for key.
+static SbBool
+soconvexdatacache_read_file(const SbString & filename, const soconvexdatacache_key & key,
+                            SoConvexDataCacheP * result)
+{
+  FILE * fp = fopen(filename.getString(), "rb");
+  if (!fp) return FALSE;
+
+  soconvexdatacache_stream s(soconvexdatacache_stream::COMPARE, fp);
+  soconvexdatacache_put_key(s, key);
+  s.mode = soconvexdatacache_stream::READ;
+  // no polygon gives more than a triangle per vertex
+  const uint32_t maxlen = 4 * (uint32_t) key.numv;
+  const SbBool ok =
+    s.ok &&
+    soconvexdatacache_get_list(s, result->coordIndices, maxlen) &&
+    soconvexdatacache_get_list(s, result->materialIndices, maxlen) &&
+    soconvexdatacache_get_list(s, result->normalIndices, maxlen) &&
+    soconvexdatacache_get_list(s, result->texIndices, maxlen) &&
+    soconvexdatacache_check_lists(key, result);
+  fclose(fp);
+
+  if (!ok) {
+    result->coordIndices.truncate(0);
+    result->materialIndices.truncate(0);
+    result->normalIndices.truncate(0);
+    result->texIndices.truncate(0);
+  }
+  return ok;
+}
+
+// must be called with the mutex locked
+static void
+soconvexdatacache_write_file(const SbString & filename, const soconvexdatacache_key & key,
+                             const SoConvexDataCacheP * data)
+{
+  // write to a temporary file first, so that other processes never
+  // see a partially written file. Other processes may be writing the
+  // same file, so the name is made unique with the process id.
+#if defined(HAVE_WINDOWS_H)
+  const unsigned long pid = (unsigned long) GetCurrentProcessId();
+#elif defined(HAVE_UNISTD_H)
+  const unsigned long pid = (unsigned long) getpid();
+#else
+  const unsigned long pid = 0;
+#endif
+  SbString tmpname;
+  tmpname.sprintf("%s.%lu.tmp", filename.getString(), pid);
+  FILE * fp = fopen(tmpname.getString(), "wb");
+  if (!fp) return;
+
+  soconvexdatacache_stream s(soconvexdatacache_stream::WRITE, fp);
+  soconvexdatacache_put_key(s, key);
+  soconvexdatacache_put_list(s, data->coordIndices);
+  soconvexdatacache_put_list(s, data->materialIndices);
+  soconvexdatacache_put_list(s, data->normalIndices);
+  soconvexdatacache_put_list(s, data->texIndices);
+  s.flush();
+  SbBool ok = s.ok;
+  if (fclose(fp) != 0) ok = FALSE;
+
+  if (ok) {
+    (void) remove(filename.getString());
+    ok = rename(tmpname.getString(), filename.getString()) == 0;
+  }
+  if (!ok) (void) remove(tmpname.getString());
+}
+
+// *************************************************************************
+
 /*!
   Generates the convexified data. FIXME: doc
 */
@@ -258,8 +925,6 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
   tessdata.nummatind = 0;
   tessdata.numnormind = 0;
   tessdata.numtexind = 0;
-  // FIXME: stupid to have a separate struct for each coordIndex
-  // should only allocate enough to hold the largest polygon
   tessdata.vertexInfo = new tVertexInfo[numv];
   tessdata.vertexIndex = NULL;
   tessdata.matIndex = NULL;
@@ -267,27 +932,20 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
   tessdata.texIndex = NULL;
   tessdata.firstvertex = TRUE;
 
-  // create tessellator
-  SbGLUTessellator glutess(do_triangle, &tessdata);
-  SbTesselator tess(do_triangle, &tessdata);
-  const SbBool gt = SbGLUTessellator::preferred();
-
-  // if PER_FACE binding, the binding must change to PER_FACE_INDEXED
-  // if convexify data is used.
-  tessdata.vertexIndex = &PRIVATE(this)->coordIndices;
-  if (matbind != NONE)
-    tessdata.matIndex = &PRIVATE(this)->materialIndices;
-  if (normbind != NONE)
-    tessdata.normIndex = &PRIVATE(this)->normalIndices;
-  if (texbind != NONE)
-    tessdata.texIndex = &PRIVATE(this)->texIndices;
-
-  if (gt) { glutess.beginPolygon(); }
-  else { tess.beginPolygon(); }
-  for (int i = 0; i < numv; i++) {
+  // Find the vertices of each polygon, and transform them. This is
+  // done here, and not by the tessellating threads, as
+  // SoCoordinateElement::get3() is not thread safe.
+  SbVec3f * vertexcoords = new SbVec3f[numv];
+  SbList <int> polygons;
+  int start = 0;
+  int i;
+  for (i = 0; i < numv; i++) {
     if (vind[i] < 0) {
-      if (gt) { glutess.endPolygon(); }
-      else { tess.endPolygon(); }
+      if (i > start) {
+        polygons.append(start);
+        polygons.append(i);
+      }
+      start = i + 1;
       if (matbind == PER_VERTEX_INDEXED || 
           matbind == PER_FACE ||
           matbind == PER_FACE_INDEXED) matnr++;
@@ -295,10 +953,6 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
           normbind == PER_FACE ||
           normbind == PER_FACE_INDEXED) normnr++;
       if (texbind == PER_VERTEX_INDEXED) texnr++;
-      if (i < numv - 1) { // if not last polygon
-        if (gt) { glutess.beginPolygon(); }
-        else { tess.beginPolygon(); }
-      }
     }
     else {
       tessdata.vertexInfo[i].vertexnr = vind[i];
@@ -320,25 +974,142 @@ SoConvexDataCache::generate(const SoCoordinateElement * const coords,
 
       SbVec3f v = coords->get3(vind[i]);
       if (!identity) matrix.multVecMatrix(v,v);
-      if (gt) { glutess.addVertex(v, static_cast<void *>(&tessdata.vertexInfo[i])); }
-      else { tess.addVertex(v, static_cast<void *>(&tessdata.vertexInfo[i])); }
+      vertexcoords[i] = v;
     }
   }
-  
   // if last coordIndex != -1, terminate polygon
-  if (numv > 0 && vind[numv-1] != -1) {
-    if (gt) { glutess.endPolygon(); }
-    else { tess.endPolygon(); }
+  if (numv > start) {
+    polygons.append(start);
+    polygons.append(numv);
+  }
+
+  // also sets up the GLU library, before any thread needs it
+  const SbBool gt = SbGLUTessellator::preferred();
+
+  soconvexdatacache_key key;
+  key.vind = vind;
+  key.numv = numv;
+  key.vertexinfo = tessdata.vertexInfo;
+  key.coords = vertexcoords;
+  key.matbind = matbind;
+  key.normbind = normbind;
+  key.texbind = texbind;
+  key.glu = gt;
+
+  SbString filename;
+  SbBool restored = FALSE;
+  if (numv >= SOCONVEXDATACACHE_MINSTORE) {
+    const SbString dir = SoConvexDataCache::getCacheDirectory();
+    if (dir.getLength()) {
+      filename = soconvexdatacache_filename(dir, key);
+      soconvexdatacache_lock();
+      restored = soconvexdatacache_read_file(filename, key, PRIVATE(this));
+      CC_MUTEX_UNLOCK(soconvexdatacache_mutex);
+    }
   }
 
+  if (!restored) {
+    SbList <int> chunks;
+    const int numpolygons = polygons.getLength() / 2;
+    int size = 0;
+    for (i = 0; i < numpolygons; i++) {
+      if (size == 0) chunks.append(i);
+      size += polygons[2 * i + 1] - polygons[2 * i];
+      if (size >= SOCONVEXDATACACHE_CHUNK) size = 0;
+    }
+    chunks.append(numpolygons);
+
+    soconvexdatacache_tessjob job;
+    job.tessdata = &tessdata;
+    job.coords = vertexcoords;
+    job.polygons = polygons.getArrayPtr();
+    job.chunks = chunks.getArrayPtr();
+    job.numchunks = chunks.getLength() - 1;
+    job.results = new SoConvexDataCacheP*[SbMax(job.numchunks, 1)];
+    job.glu = gt;
+
+    // the first chunk goes straight into this cache
+    job.results[0] = PRIVATE(this);
+    for (i = 1; i < job.numchunks; i++) {
+      job.results[i] = new SoConvexDataCacheP;
+    }
+
+    soconvexdatacache_lock();
+    const int numthreads = soconvexdatacache_numthreads;
+    CC_MUTEX_UNLOCK(soconvexdatacache_mutex);
+    // leave small jobs to this thread, as starting the others costs
+    // more than it saves
+    const int numworkers = SbMin(numthreads, (job.numchunks + 3) / 4);
+
+    cc_parallel_for(job.numchunks, 1, numworkers,
+                    soconvexdatacache_tessellate_chunks, &job);
+
+    soconvexdatacache_merge(job.results, job.numchunks);
+    delete[] job.results;
+
+    if (filename.getLength()) {
+      soconvexdatacache_lock();
+      soconvexdatacache_write_file(filename, key, PRIVATE(this));
+      CC_MUTEX_UNLOCK(soconvexdatacache_mutex);
+    }
+  }
+
+  delete [] vertexcoords;
   delete [] tessdata.vertexInfo;
 
   PRIVATE(this)->coordIndices.fit();
-  if (tessdata.matIndex) PRIVATE(this)->materialIndices.fit();
-  if (tessdata.normIndex) PRIVATE(this)->normalIndices.fit();
-  if (tessdata.texIndex) PRIVATE(this)->texIndices.fit();
+  PRIVATE(this)->materialIndices.fit();
+  PRIVATE(this)->normalIndices.fit();
+  PRIVATE(this)->texIndices.fit();
+}
+
+/*!
+  Sets the directory where convexified data is stored, so that it
+  can be reused by later runs of the application. Face sets with many
+  concave polygons then only need to be tessellated once. Data is
+  only stored for shapes with at least 1024 coordinate indices, as
+  smaller shapes are tessellated faster than they are read. An empty
+  string disables the disk cache, which is the default.
+
+  The stored data is only used for shapes with exactly the same
+  coordinates, indices and bindings, so changing the geometry just
+  causes new files to be written. Old files are never removed.
+
+  The directory can also be set with the environment variable \c
+  COIN_CONVEXDATACACHE_DIR.
+
+  \since Coin 4.0
+*/
+void
+SoConvexDataCache::setCacheDirectory(const SbString & dir)
+{
+  soconvexdatacache_lock();
+  delete soconvexdatacache_dir;
+  soconvexdatacache_dir = dir.getLength() ? new SbString(dir) : NULL;
+  CC_MUTEX_UNLOCK(soconvexdatacache_mutex);
+}
+
+/*!
+  Returns the directory where convexified data is stored, or an empty
+  string if it is not stored on disk.
+
+  \since Coin 4.0
+  \sa setCacheDirectory()
+*/
+SbString
+SoConvexDataCache::getCacheDirectory(void)
+{
+  soconvexdatacache_lock();
+  SbString dir = soconvexdatacache_dir ? *soconvexdatacache_dir : SbString();
+  CC_MUTEX_UNLOCK(soconvexdatacache_mutex);
+  return dir;
 }
 
+#undef SOCONVEXDATACACHE_CHUNK
+#undef SOCONVEXDATACACHE_MAXEARCLIP
+#undef SOCONVEXDATACACHE_MINSTORE
+#undef SOCONVEXDATACACHE_VERSION
+
 //
 // helper function for do_triangle() below
 //
@@ -400,3 +1171,135 @@ do_triangle(void *v0, void *v1, void *v2, void *data)
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <cmath>
+
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbVec3f.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/elements/SoCoordinateElement.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/nodes/SoCallback.h>
+
+// An L shaped hexagon, triangulated by clipping ears, and a star with
+// 40 corners, left to SbTesselator, repeated enough times to be
+// tessellated by several threads.
+typedef struct {
+  SoCallback * node;
+  SbList <SbVec3f> coords;
+  SbList <int32_t> vind;
+  SbList <float> areas;
+  int numtriangles;
+  SbBool checked;
+} convexdatacache_test_data;
+
+static void
+convexdatacache_test_shapes(convexdatacache_test_data & data, const int copies)
+{
+  for (int k = 0; k < copies; k++) {
+    const float x = 3.0f * k;
+    const float l[6][2] = { { 0, 0 }, { 2, 0 }, { 2, 1 }, { 1, 1 }, { 1, 2 }, { 0, 2 } };
+    for (int i = 0; i < 6; i++) {
+      data.vind.append(data.coords.getLength());
+      data.coords.append(SbVec3f(x + l[i][0], l[i][1], 0.0f));
+    }
+    data.vind.append(-1);
+    data.areas.append(3.0f);
+    data.numtriangles += 4;
+
+    float area = 0.0f;
+    const int n = 40;
+    const int first = data.coords.getLength();
+    for (int i = 0; i < n; i++) {
+      const float r = (i & 1) ? 0.5f : 1.0f;
+      const float a = float(2.0 * M_PI * i / n);
+      data.vind.append(data.coords.getLength());
+      data.coords.append(SbVec3f(x + r * cos(a), 3.0f + r * sin(a), 0.0f));
+    }
+    for (int i = 0; i < n; i++) {
+      const SbVec3f & v0 = data.coords[first + i];
+      const SbVec3f & v1 = data.coords[first + (i + 1) % n];
+      area += 0.5f * ((v0[0] - x) * (v1[1] - 3.0f) - (v1[0] - x) * (v0[1] - 3.0f));
+    }
+    data.vind.append(-1);
+    data.areas.append(area);
+    data.numtriangles += n - 2;
+  }
+}
+
+static void
+convexdatacache_test_cb(void * closure, SoAction * action)
+{
+  if (!action->isOfType(SoCallbackAction::getClassTypeId())) return;
+  convexdatacache_test_data * data = static_cast<convexdatacache_test_data *>(closure);
+  SoState * state = action->getState();
+  SoCoordinateElement::set3(state, data->node, data->coords.getLength(),
+                            data->coords.getArrayPtr());
+
+  SoConvexDataCache * cache = new SoConvexDataCache(state);
+  cache->ref();
+  cache->generate(SoCoordinateElement::getInstance(state), SbMatrix::identity(),
+                  data->vind.getArrayPtr(), data->vind.getLength(),
+                  NULL, NULL, NULL,
+                  SoConvexDataCache::PER_FACE, SoConvexDataCache::NONE,
+                  SoConvexDataCache::NONE);
+
+  BOOST_REQUIRE_EQUAL(cache->getNumCoordIndices(), 4 * data->numtriangles);
+  BOOST_REQUIRE_EQUAL(cache->getNumMaterialIndices(), data->numtriangles);
+  BOOST_CHECK_EQUAL(cache->getNumNormalIndices(), 0);
+  const int32_t * cind = cache->getCoordIndices();
+  const int32_t * mind = cache->getMaterialIndices();
+
+  // the triangles must come polygon by polygon, cover each polygon
+  // and keep its orientation
+  SbList <float> areas;
+  SbList <int> first;
+  for (int i = 0; i < data->vind.getLength(); i++) {
+    if (data->vind[i] < 0) {
+      areas.append(0.0f);
+      first.append(data->vind[i - 1] + 1);
+    }
+  }
+  first.insert(0, 0);
+  int wrong = 0;
+  for (int t = 0; t < data->numtriangles; t++) {
+    const int p = mind[t];
+    if (t > 0 && p < mind[t - 1]) wrong++;
+    if (cind[4 * t + 3] != -1) wrong++;
+    for (int i = 0; i < 3; i++) {
+      if (cind[4 * t + i] < first[p] || cind[4 * t + i] >= first[p + 1]) wrong++;
+    }
+    const SbVec3f e0 = data->coords[cind[4 * t + 1]] - data->coords[cind[4 * t]];
+    const SbVec3f e1 = data->coords[cind[4 * t + 2]] - data->coords[cind[4 * t]];
+    const float area = 0.5f * (e0[0] * e1[1] - e0[1] * e1[0]);
+    if (area <= 0.0f) wrong++;
+    areas[p] += area;
+  }
+  BOOST_CHECK_EQUAL(wrong, 0);
+  for (int p = 0; p < areas.getLength(); p++) {
+    BOOST_CHECK_CLOSE(areas[p], data->areas[p], 0.01f);
+  }
+  cache->unref();
+  data->checked = TRUE;
+}
+
+BOOST_AUTO_TEST_CASE(concavePolygons)
+{
+  convexdatacache_test_data data;
+  data.numtriangles = 0;
+  data.checked = FALSE;
+  convexdatacache_test_shapes(data, 400);
+
+  SoCallback * root = new SoCallback;
+  root->ref();
+  data.node = root;
+  root->setCallback(convexdatacache_test_cb, &data);
+  SoCallbackAction cba;
+  cba.apply(root);
+  root->unref();
+  BOOST_CHECK(data.checked);
+}
+
+#endif // COIN_TEST_SUITE
@@ -43,6 +43,7 @@
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/misc/SoState.h>
 #include <Inventor/misc/SoContextHandler.h>
+#include <Inventor/misc/SoGLDriverDatabase.h>
 #include <Inventor/system/gl.h>
 
 #include "tidbitsp.h"
@@ -78,6 +79,7 @@ public:
   SoElement * invalidelement;
   int numframesok;
   int numshapes;
+  SbBool novbo;
 
   //
   // Callback from SoContextHandler
@@ -117,6 +119,7 @@ SoGLCacheList::SoGLCacheList(int numcaches)
   PRIVATE(this)->invalidelement = NULL;
   PRIVATE(this)->numframesok = 0;
   PRIVATE(this)->numshapes = 0;
+  PRIVATE(this)->novbo = FALSE;
 
   // auto caching must be enabled using an environment variable
   if (COIN_AUTO_CACHING < 0) {
@@ -191,7 +194,11 @@ SoGLCacheList::call(SoGLRenderAction * action)
         // update lazy GL state before calling cache
         SoGLLazyElement::getInstance(state)->send(state, SoLazyElement::ALL_MASK);
         cache->call(state);
-        SoGLLazyElement::postCacheCall(state, cache->getPostLazyState());
+        // vertex buffer caches send their material state through
+        // SoGLLazyElement, which is then up to date already
+        if (cache->getBackend() == SoGLRenderCache::DISPLAY_LIST) {
+          SoGLLazyElement::postCacheCall(state, cache->getPostLazyState());
+        }
         cache->unref(state);
         PRIVATE(this)->numused++;
 
@@ -448,6 +455,24 @@ SoGLCacheList::call(SoGLRenderAction * action)
 */
 void
 SoGLCacheList::open(SoGLRenderAction * action, SbBool autocache)
+{
+  this->open(action, autocache, SoGLRenderCache::getDefaultBackend());
+}
+
+/*!
+  Start recording a new cache using \a backend, which is a
+  SoGLRenderCache::Backend value. A display list cache is recorded
+  instead if the OpenGL driver doesn't support vertex buffer objects,
+  or if a vertex buffer cache could not be baked for this cache list
+  earlier. In the latter case display lists are used until
+  invalidateAll() is called.
+
+  \since Coin 4.0
+  \sa close()
+*/
+void
+SoGLCacheList::open(SoGLRenderAction * action, SbBool autocache,
+                    const int backend)
 {
   // needclose is used to quickly return in close()
   if (PRIVATE(this)->numcaches == 0 || (autocache && COIN_AUTO_CACHING == 0)) {
@@ -527,7 +552,15 @@ SoGLCacheList::open(SoGLRenderAction * action, SbBool autocache)
       PRIVATE(this)->itemlist.remove(0);
       PRIVATE(this)->numdiscarded++;
     }
-    PRIVATE(this)->opencache = new SoGLRenderCache(state);
+    SoGLRenderCache::Backend cachebackend =
+      static_cast<SoGLRenderCache::Backend>(backend);
+    if (cachebackend == SoGLRenderCache::VERTEX_BUFFER &&
+        (PRIVATE(this)->novbo ||
+         !SoGLDriverDatabase::isSupported(sogl_glue_instance(state),
+                                          SO_GL_VERTEX_BUFFER_OBJECT))) {
+      cachebackend = SoGLRenderCache::DISPLAY_LIST;
+    }
+    PRIVATE(this)->opencache = new SoGLRenderCache(state, cachebackend);
     PRIVATE(this)->opencache->ref();
     SoCacheElement::set(state, PRIVATE(this)->opencache);
     SoGLLazyElement::beginCaching(state, PRIVATE(this)->opencache->getPreLazyState(),
@@ -566,6 +599,15 @@ SoGLCacheList::close(SoGLRenderAction * action)
   if (PRIVATE(this)->opencache) {
     PRIVATE(this)->opencache->close();
     SoGLLazyElement::endCaching(state);
+
+    // the subgraph couldn't be baked into vertex buffers. Throw the
+    // cache away and use display lists from now on.
+    if (PRIVATE(this)->opencache->getBackend() == SoGLRenderCache::VERTEX_BUFFER &&
+        !PRIVATE(this)->opencache->isBaked()) {
+      PRIVATE(this)->opencache->unref();
+      PRIVATE(this)->opencache = NULL;
+      PRIVATE(this)->novbo = TRUE;
+    }
   }
   if (SoCacheElement::setInvalid(PRIVATE(this)->savedinvalid)) {
     // notify parent caches
@@ -594,7 +636,12 @@ SoGLCacheList::close(SoGLRenderAction * action)
 #if COIN_DEBUG
     if (coin_debug_caching_level() > 0) {
       SoDebugError::postInfo("SoGLCacheList::close",
-                             "new cache created: %p", this);
+                             "new cache created: %p (%s, %lu bytes)", this,
+                             PRIVATE(this)->opencache->getBackend() ==
+                             SoGLRenderCache::VERTEX_BUFFER ?
+                             "vertex buffer" : "display list",
+                             static_cast<unsigned long>
+                             (PRIVATE(this)->opencache->getMemoryUsage()));
     }
 #endif // debug
     PRIVATE(this)->itemlist.append(PRIVATE(this)->opencache);
@@ -628,6 +675,7 @@ SoGLCacheList::invalidateAll(void)
   PRIVATE(this)->itemlist.truncate(0);
   PRIVATE(this)->numdiscarded += n;
   PRIVATE(this)->numframesok = 0;
+  PRIVATE(this)->novbo = FALSE;
 }
 
 #undef PRIVATE
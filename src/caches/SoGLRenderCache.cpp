@@ -25,43 +25,631 @@
   \class SoGLRenderCache Inventor/caches/SoGLRenderCache.h
   \brief The SoGLRenderCache class is used to cache OpenGL calls.
   \ingroup caches
+
+  The cache has two backends. The default, SoGLRenderCache::DISPLAY_LIST,
+  records all OpenGL calls made while the cache is open into an OpenGL
+  display list.
+
+  SoGLRenderCache::VERTEX_BUFFER bakes the shapes rendered while the
+  cache is open into one vertex buffer object and one index buffer
+  object, along with a compact list of draw commands and the lazy
+  material state each of them needs. Replaying the cache binds the
+  buffers and issues one glDrawElements() per state change. This
+  avoids display lists, which are not available in core profile
+  contexts and are slow with some drivers.
+
+  Only triangle based shapes (SoFaceSet, SoIndexedFaceSet,
+  SoTriangleStripSet, SoIndexedTriangleStripSet, SoQuadMesh, SoCube,
+  SoSphere, SoCone and SoCylinder) without textures or shader programs
+  can be baked, and the subgraph can only change the model matrix,
+  materials and the geometry elements. If anything else is found
+  while recording, the cache is not baked (see isBaked()), and
+  SoGLCacheList will use a display list cache for the SoSeparator
+  instead.
+
+  The backend can be selected for all SoSeparator nodes using
+  SoSeparator::setRenderCacheBackend(), or globally using
+  setDefaultBackend() or the environment variable \c
+  COIN_RENDER_CACHE_BACKEND (set it to \c VERTEX_BUFFER or \c
+  DISPLAY_LIST).
 */
 
 // *************************************************************************
 
 #include <cassert>
+#include <cstring>
+#include <cstddef>
 
 #include <Inventor/caches/SoGLRenderCache.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/elements/SoBBoxModelMatrixElement.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoCacheHintElement.h>
+#include <Inventor/elements/SoComplexityElement.h>
+#include <Inventor/elements/SoComplexityTypeElement.h>
+#include <Inventor/elements/SoCoordinateElement.h>
+#include <Inventor/elements/SoCreaseAngleElement.h>
+#include <Inventor/elements/SoCullElement.h>
+#include <Inventor/elements/SoDecimationPercentageElement.h>
+#include <Inventor/elements/SoDecimationTypeElement.h>
+#include <Inventor/elements/SoDrawStyleElement.h>
 #include <Inventor/elements/SoGLCacheContextElement.h>
 #include <Inventor/elements/SoGLDisplayList.h>
-#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoGLLazyElement.h>
+#include <Inventor/elements/SoGLShaderProgramElement.h>
+#include <Inventor/elements/SoGLVBOElement.h>
+#include <Inventor/elements/SoLinePatternElement.h>
+#include <Inventor/elements/SoLineWidthElement.h>
+#include <Inventor/elements/SoLocalBBoxMatrixElement.h>
+#include <Inventor/elements/SoMaterialBindingElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoMultiTextureCoordinateElement.h>
+#include <Inventor/elements/SoMultiTextureEnabledElement.h>
+#include <Inventor/elements/SoNormalBindingElement.h>
+#include <Inventor/elements/SoNormalElement.h>
+#include <Inventor/elements/SoOverrideElement.h>
+#include <Inventor/elements/SoPickStyleElement.h>
+#include <Inventor/elements/SoPointSizeElement.h>
+#include <Inventor/elements/SoProfileCoordinateElement.h>
+#include <Inventor/elements/SoProfileElement.h>
+#include <Inventor/elements/SoShapeHintsElement.h>
+#include <Inventor/elements/SoShapeStyleElement.h>
+#include <Inventor/elements/SoSwitchElement.h>
+#include <Inventor/elements/SoTextureCoordinateBindingElement.h>
+#include <Inventor/elements/SoTextureOverrideElement.h>
+#include <Inventor/elements/SoUnitsElement.h>
+#include <Inventor/errors/SoDebugError.h>
 #include <Inventor/lists/SbList.h>
+#include <Inventor/misc/SoGLDriverDatabase.h>
+#include <Inventor/misc/SoState.h>
+#include <Inventor/nodes/SoCone.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoCylinder.h>
+#include <Inventor/nodes/SoFaceSet.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoIndexedTriangleStripSet.h>
+#include <Inventor/nodes/SoQuadMesh.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTriangleStripSet.h>
 #include <Inventor/C/tidbits.h> // coin_getenv()
 
+#include "tidbitsp.h"
+#include "caches/SoGLRenderCacheP.h"
+#include "rendering/SoGLResourceManagerP.h"
+#include "rendering/SoVBO.h"
+
 // *************************************************************************
 
-class SoGLRenderCacheP {
-public:
-  SoGLDisplayList * displaylist;
-  SoState * openstate;
-  SbList <SoGLDisplayList*> nestedcachelist;
-  SoGLLazyElement::GLState prestate;
-  SoGLLazyElement::GLState poststate;
-};
+static int sorendercache_defaultbackend = -1;
+static SbList <SbBool> * sorendercache_allowedelements = NULL;
+
+static void
+sorendercache_cleanup(void)
+{
+  delete sorendercache_allowedelements;
+  sorendercache_allowedelements = NULL;
+  sorendercache_defaultbackend = -1;
+}
+
+static void
+sorendercache_init_allowedelements(void)
+{
+  if (sorendercache_allowedelements == NULL) {
+    sorendercache_allowedelements = new SbList <SbBool>;
+    coin_atexit((coin_atexit_f*) sorendercache_cleanup, CC_ATEXIT_NORMAL);
+
+    const int allowed[] = {
+      SoBBoxModelMatrixElement::getClassStackIndex(),
+      SoCacheElement::getClassStackIndex(),
+      SoCacheHintElement::getClassStackIndex(),
+      SoComplexityElement::getClassStackIndex(),
+      SoComplexityTypeElement::getClassStackIndex(),
+      SoCoordinateElement::getClassStackIndex(),
+      SoCreaseAngleElement::getClassStackIndex(),
+      SoCullElement::getClassStackIndex(),
+      SoDecimationPercentageElement::getClassStackIndex(),
+      SoDecimationTypeElement::getClassStackIndex(),
+      SoGLCacheContextElement::getClassStackIndex(),
+      SoGLVBOElement::getClassStackIndex(),
+      SoLazyElement::getClassStackIndex(),
+      SoLinePatternElement::getClassStackIndex(),
+      SoLineWidthElement::getClassStackIndex(),
+      SoLocalBBoxMatrixElement::getClassStackIndex(),
+      SoMaterialBindingElement::getClassStackIndex(),
+      SoModelMatrixElement::getClassStackIndex(),
+      SoMultiTextureCoordinateElement::getClassStackIndex(),
+      SoNormalBindingElement::getClassStackIndex(),
+      SoNormalElement::getClassStackIndex(),
+      SoOverrideElement::getClassStackIndex(),
+      SoPickStyleElement::getClassStackIndex(),
+      SoPointSizeElement::getClassStackIndex(),
+      SoProfileCoordinateElement::getClassStackIndex(),
+      SoProfileElement::getClassStackIndex(),
+      SoShapeHintsElement::getClassStackIndex(),
+      SoShapeStyleElement::getClassStackIndex(),
+      SoSwitchElement::getClassStackIndex(),
+      SoTextureCoordinateBindingElement::getClassStackIndex(),
+      SoTextureOverrideElement::getClassStackIndex(),
+      SoUnitsElement::getClassStackIndex()
+    };
+    for (unsigned int i = 0; i < sizeof(allowed) / sizeof(allowed[0]); i++) {
+      while (sorendercache_allowedelements->getLength() <= allowed[i]) {
+        sorendercache_allowedelements->append(FALSE);
+      }
+      (*sorendercache_allowedelements)[allowed[i]] = TRUE;
+    }
+  }
+}
+
+// compares the parts of the lazy GL state replayed by the vertex
+// buffer backend
+static SbBool
+sorendercache_state_equal(const SoGLLazyElement::GLState & s0,
+                          const SoGLLazyElement::GLState & s1)
+{
+  return
+    (s0.lightmodel == s1.lightmodel) &&
+    (s0.ambient == s1.ambient) &&
+    (s0.emissive == s1.emissive) &&
+    (s0.specular == s1.specular) &&
+    (s0.shininess == s1.shininess) &&
+    (s0.blending == s1.blending) &&
+    (s0.blend_sfactor == s1.blend_sfactor) &&
+    (s0.blend_dfactor == s1.blend_dfactor) &&
+    (s0.alpha_blend_sfactor == s1.alpha_blend_sfactor) &&
+    (s0.alpha_blend_dfactor == s1.alpha_blend_dfactor) &&
+    (s0.stipplenum == s1.stipplenum) &&
+    (s0.vertexordering == s1.vertexordering) &&
+    (s0.culling == s1.culling) &&
+    (s0.twoside == s1.twoside) &&
+    (s0.flatshading == s1.flatshading) &&
+    (s0.alphatestfunc == s1.alphatestfunc) &&
+    (s0.alphatestvalue == s1.alphatestvalue);
+}
+
+// *************************************************************************
+
+SoGLRenderCacheP::Vertex::operator unsigned long(void) const
+{
+  unsigned long key = 0;
+  // create an xor key based on all the vertex data
+  const unsigned char * ptr = reinterpret_cast<const unsigned char *>(this);
+  for (unsigned int i = 0; i < sizeof(Vertex); i++) {
+    int shift = (i%4) * 8;
+    key ^= (ptr[i]<<shift);
+  }
+  return key;
+}
+
+int
+SoGLRenderCacheP::Vertex::operator==(const Vertex & v) const
+{
+  return
+    (this->point == v.point) &&
+    (this->normal == v.normal) &&
+    (this->rgba[0] == v.rgba[0]) &&
+    (this->rgba[1] == v.rgba[1]) &&
+    (this->rgba[2] == v.rgba[2]) &&
+    (this->rgba[3] == v.rgba[3]);
+}
+
+// Returns the private data of the vertex buffer cache currently being
+// recorded in \a state, or NULL if there is none.
+SoGLRenderCacheP *
+SoGLRenderCacheP::getRecording(SoState * state)
+{
+  SoGLRenderCache * cache =
+    dynamic_cast<SoGLRenderCache *>(SoCacheElement::getCurrentCache(state));
+  if (cache &&
+      (cache->pimpl->backend == SoGLRenderCache::VERTEX_BUFFER) &&
+      (cache->pimpl->openstate == state) &&
+      !cache->pimpl->failed) {
+    return cache->pimpl;
+  }
+  return NULL;
+}
+
+void
+SoGLRenderCacheP::beginRecording(SoState * state)
+{
+  this->failed = FALSE;
+  this->clear();
+
+  // store the elements at the top of the stack, so that we can tell
+  // which elements have been set inside the cache
+  const int numstacks = SoElement::getNumStackIndices();
+  this->openelements.truncate(0);
+  for (int i = 0; i < numstacks; i++) {
+    this->openelements.append(state->isElementEnabled(i) ?
+                              state->getConstElement(i) : NULL);
+  }
+
+  // the geometry is stored relative to the model matrix when the
+  // cache is opened. Don't use SoModelMatrixElement::get(), since
+  // that would make the cache depend on the model matrix.
+  const SoModelMatrixElement * mm = static_cast<const SoModelMatrixElement *>
+    (state->getConstElement(SoModelMatrixElement::getClassStackIndex()));
+  const SbMatrix & m = mm->getModelMatrix();
+  if (m.det4() == 0.0f) {
+    this->fail("singular model matrix");
+    return;
+  }
+  this->openinverse = m.inverse();
+}
+
+void
+SoGLRenderCacheP::endRecording(void)
+{
+  this->openelements.truncate(0, TRUE);
+  this->vhash.clear();
+  if (this->failed) return;
+
+  this->numvertices = this->vertexlist.getLength();
+  this->numindices = this->indexlist.getLength();
+
+  if (this->numindices) {
+    this->vertexvbo = new SoVBO(GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+    void * vdata = this->vertexvbo->allocBufferData(this->numvertices * sizeof(Vertex));
+    memcpy(vdata, this->vertexlist.getArrayPtr(), this->numvertices * sizeof(Vertex));
+
+    // use 16 bit indices when possible, to save memory and bandwidth
+    this->shortindices = this->numvertices <= 65536;
+    this->indexvbo = new SoVBO(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+    const uint32_t * src = this->indexlist.getArrayPtr();
+    if (this->shortindices) {
+      uint16_t * dst = static_cast<uint16_t *>
+        (this->indexvbo->allocBufferData(this->numindices * sizeof(uint16_t)));
+      for (int i = 0; i < this->numindices; i++) {
+        dst[i] = static_cast<uint16_t>(src[i]);
+      }
+    }
+    else {
+      void * dst = this->indexvbo->allocBufferData(this->numindices * sizeof(uint32_t));
+      memcpy(dst, src, this->numindices * sizeof(uint32_t));
+    }
+  }
+  // the data is kept in the SoVBO instances from now on
+  this->vertexlist.truncate(0, TRUE);
+  this->indexlist.truncate(0, TRUE);
+  this->statelist.fit();
+  this->commandlist.fit();
+}
+
+void
+SoGLRenderCacheP::fail(const char * reason)
+{
+  if (this->failed) return;
+  this->failed = TRUE;
+  this->clear();
+
+#if COIN_DEBUG
+  if (coin_debug_caching_level() > 0) {
+    SoDebugError::postInfo("SoGLRenderCacheP::fail",
+                           "vertex buffer cache %p can not be baked: %s",
+                           this, reason);
+  }
+#endif // debug
+}
+
+// Called from SoShape::shouldGLRender() while recording. Returns TRUE
+// if the primitives of the shape should be recorded.
+SbBool
+SoGLRenderCacheP::beginShape(SoState * state, const SoShape * shape)
+{
+  if (this->failed) return FALSE;
+
+  if (!SoGLRenderCache::canBakeShape(shape->getTypeId())) {
+    this->fail(shape->getTypeId().getName().getString());
+    return FALSE;
+  }
+  const int numstacks = this->openelements.getLength();
+  for (int i = 0; i < numstacks; i++) {
+    const SoElement * elem = state->isElementEnabled(i) ?
+      state->getConstElement(i) : NULL;
+    if (elem != this->openelements[i] && !SoGLRenderCache::canBakeElement(i)) {
+      this->fail(elem ? elem->getTypeId().getName().getString() : "element");
+      return FALSE;
+    }
+  }
+  int lastenabled = -1;
+  (void) SoMultiTextureEnabledElement::getEnabledUnits(state, lastenabled);
+  if (lastenabled >= 0) {
+    this->fail("texturing");
+    return FALSE;
+  }
+  if (SoDrawStyleElement::get(state) != SoDrawStyleElement::FILLED) {
+    this->fail("draw style");
+    return FALSE;
+  }
+  if (SoGLShaderProgramElement::get(state) || SoGLLazyElement::isColorIndex(state)) {
+    this->fail("shader program or color index mode");
+    return FALSE;
+  }
+
+  // store the material state the shape will be rendered with
+  SoGLLazyElement * lazy = SoGLLazyElement::getInstance(state);
+  lazy->send(state, SoLazyElement::ALL_MASK);
+  SoGLLazyElement::GLState glstate;
+  SoGLLazyElement::getGLState(state, &glstate);
+  const int numstates = this->statelist.getLength();
+  if (numstates == 0 ||
+      !sorendercache_state_equal(glstate, this->statelist[numstates-1])) {
+    this->statelist.append(glstate);
+  }
+
+  // diffuse colors are baked into the vertices
+  this->numdiffuse = lazy->getNumDiffuse();
+  this->numtransp = lazy->getNumTransparencies();
+  if (lazy->isPacked()) {
+    this->packedptr = lazy->getPackedPointer();
+    this->diffuseptr = NULL;
+    this->transpptr = NULL;
+  }
+  else {
+    this->packedptr = NULL;
+    this->diffuseptr = lazy->getDiffusePointer();
+    this->transpptr = lazy->getTransparencyPointer();
+  }
+
+  const SoModelMatrixElement * mm = static_cast<const SoModelMatrixElement *>
+    (state->getConstElement(SoModelMatrixElement::getClassStackIndex()));
+  this->matrix = mm->getModelMatrix();
+  this->matrix.multRight(this->openinverse);
+  this->identity = this->matrix == SbMatrix::identity();
+  if (!this->identity) {
+    this->normalmatrix = this->matrix.inverse().transpose();
+  }
+  this->vhash.clear();
+  this->shapeindex = this->indexlist.getLength();
+  return TRUE;
+}
+
+void
+SoGLRenderCacheP::addTriangle(const SoPrimitiveVertex * v0,
+                              const SoPrimitiveVertex * v1,
+                              const SoPrimitiveVertex * v2)
+{
+  if (this->failed) return;
+  const SoPrimitiveVertex * vp[3] = { v0, v1, v2 };
+
+  for (int i = 0; i < 3; i++) {
+    Vertex v;
+    if (this->identity) {
+      v.point = vp[i]->getPoint();
+      v.normal = vp[i]->getNormal();
+    }
+    else {
+      // GL_NORMALIZE is always enabled, so normalizing the
+      // transformed normals doesn't change the lighting
+      this->matrix.multVecMatrix(vp[i]->getPoint(), v.point);
+      this->normalmatrix.multDirMatrix(vp[i]->getNormal(), v.normal);
+      if (v.normal.sqrLength() > 0.0f) v.normal.normalize();
+    }
+
+    const int midx = vp[i]->getMaterialIndex();
+    uint32_t col;
+    if (this->packedptr) {
+      col = this->packedptr[SbClamp(midx, 0, this->numdiffuse-1)];
+    }
+    else {
+      SbColor tmpc = this->diffuseptr[SbClamp(midx, 0, this->numdiffuse-1)];
+      float tmpt = this->transpptr[SbClamp(midx, 0, this->numtransp-1)];
+      col = tmpc.getPackedValue(tmpt);
+    }
+    v.rgba[0] = col>>24;
+    v.rgba[1] = (col>>16)&0xff;
+    v.rgba[2] = (col>>8)&0xff;
+    v.rgba[3] = col&0xff;
+
+    int32_t idx;
+    if (!this->vhash.get(v, idx)) {
+      idx = this->vertexlist.getLength();
+      this->vhash.put(v, idx);
+      this->vertexlist.append(v);
+    }
+    this->indexlist.append(static_cast<uint32_t>(idx));
+  }
+}
+
+void
+SoGLRenderCacheP::endShape(void)
+{
+  if (this->failed) return;
+  const int count = this->indexlist.getLength() - this->shapeindex;
+  if (count == 0) return;
+
+  // merge with the previous command if the material state is the same
+  const int stateidx = this->statelist.getLength() - 1;
+  const int numcommands = this->commandlist.getLength();
+  if (numcommands > 0 &&
+      this->commandlist[numcommands-1].stateidx == stateidx &&
+      (this->commandlist[numcommands-1].first +
+       this->commandlist[numcommands-1].count) == this->shapeindex) {
+    this->commandlist[numcommands-1].count += count;
+  }
+  else {
+    Command cmd;
+    cmd.stateidx = stateidx;
+    cmd.first = this->shapeindex;
+    cmd.count = count;
+    this->commandlist.append(cmd);
+  }
+}
+
+void
+SoGLRenderCacheP::render(SoState * state)
+{
+  if (this->numindices == 0) return;
+
+  const uint32_t contextid = SoGLCacheContextElement::get(state);
+  const cc_glglue * glue = cc_glglue_instance(static_cast<int>(contextid));
+
+  if (state->isCacheOpen() &&
+      !SoGLDriverDatabase::isSupported(glue, SO_GL_VBO_IN_DISPLAYLIST)) {
+    SoCacheElement::invalidate(state);
+  }
+
+  const GLsizei stride = sizeof(Vertex);
+  this->vertexvbo->bindBuffer(contextid);
+  cc_glglue_glVertexPointer(glue, 3, GL_FLOAT, stride,
+                            reinterpret_cast<const GLvoid *>(offsetof(Vertex, point)));
+  cc_glglue_glEnableClientState(glue, GL_VERTEX_ARRAY);
+  cc_glglue_glNormalPointer(glue, GL_FLOAT, stride,
+                            reinterpret_cast<const GLvoid *>(offsetof(Vertex, normal)));
+  cc_glglue_glEnableClientState(glue, GL_NORMAL_ARRAY);
+  cc_glglue_glColorPointer(glue, 4, GL_UNSIGNED_BYTE, stride,
+                           reinterpret_cast<const GLvoid *>(offsetof(Vertex, rgba)));
+  cc_glglue_glEnableClientState(glue, GL_COLOR_ARRAY);
+
+  this->indexvbo->bindBuffer(contextid);
+
+  // the buffers are deleted by evictCB(), so they must be evicted
+  // together with the cache, and before it
+  SoGLResourceManagerP::addDependency(this->resid,
+                                      this->vertexvbo->getResourceId(contextid),
+                                      TRUE);
+  SoGLResourceManagerP::addDependency(this->resid,
+                                      this->indexvbo->getResourceId(contextid),
+                                      TRUE);
+
+  const GLenum type = this->shortindices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  const size_t indexsize = this->shortindices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+  const int n = this->commandlist.getLength();
+  for (int i = 0; i < n; i++) {
+    const Command & cmd = this->commandlist[i];
+    SoGLLazyElement::sendGLState(state, &this->statelist[cmd.stateidx],
+                                 SoLazyElement::ALL_BUT_DIFFUSE_MASK);
+    cc_glglue_glDrawElements(glue, GL_TRIANGLES, cmd.count, type,
+                             reinterpret_cast<const GLvoid *>(cmd.first * indexsize));
+  }
+
+  cc_glglue_glDisableClientState(glue, GL_COLOR_ARRAY);
+  cc_glglue_glDisableClientState(glue, GL_NORMAL_ARRAY);
+  cc_glglue_glDisableClientState(glue, GL_VERTEX_ARRAY);
+  cc_glglue_glBindBuffer(glue, GL_ELEMENT_ARRAY_BUFFER, 0);
+  cc_glglue_glBindBuffer(glue, GL_ARRAY_BUFFER, 0);
+
+  // inform SoGLLazyElement that the current color has changed
+  SoGLLazyElement::getInstance(state)->reset(state, SoLazyElement::DIFFUSE_MASK);
+}
+
+void
+SoGLRenderCacheP::clear(void)
+{
+  this->vertexlist.truncate(0, TRUE);
+  this->indexlist.truncate(0, TRUE);
+  this->statelist.truncate(0, TRUE);
+  this->commandlist.truncate(0, TRUE);
+  this->vhash.clear();
+  delete this->vertexvbo;
+  delete this->indexvbo;
+  this->vertexvbo = NULL;
+  this->indexvbo = NULL;
+  this->numvertices = 0;
+  this->numindices = 0;
+}
+
+// Called by SoGLResourceManager when the cache is evicted. The OpenGL
+// resources are freed, and the cache will not be used again.
+void
+SoGLRenderCacheP::evictCB(void * closure, const uint32_t contextid, SoState * state)
+{
+  SoGLRenderCacheP * thisp = static_cast<SoGLRenderCacheP *>(closure);
+  const int n = thisp->nestedcachelist.getLength();
+  for (int i = 0; i < n; i++) {
+    thisp->nestedcachelist[i]->unref(state);
+  }
+  thisp->nestedcachelist.truncate(0);
+  if (thisp->displaylist) {
+    thisp->displaylist->unref(state);
+    thisp->displaylist = NULL;
+  }
+  thisp->clear();
+  thisp->evicted = TRUE;
+  thisp->resid = 0;
+}
+
+size_t
+SoGLRenderCacheP::getMemoryUsage(void) const
+{
+  return
+    this->numvertices * sizeof(Vertex) +
+    this->numindices * (this->shortindices ? sizeof(uint16_t) : sizeof(uint32_t)) +
+    this->statelist.getLength() * sizeof(SoGLLazyElement::GLState) +
+    this->commandlist.getLength() * sizeof(Command);
+}
 
 #define PRIVATE(obj) ((obj)->pimpl)
 
 // *************************************************************************
 
 /*!
-  Constructor with \a state being the current state.
+  \enum SoGLRenderCache::Backend
+
+  Selects how the cache stores the rendering.
+
+  \since Coin 4.0
+*/
+/*!
+  \var SoGLRenderCache::Backend SoGLRenderCache::DISPLAY_LIST
+  Record all OpenGL calls into an OpenGL display list.
+*/
+/*!
+  \var SoGLRenderCache::Backend SoGLRenderCache::VERTEX_BUFFER
+  Bake the shapes into vertex buffer objects and a list of draw commands.
+*/
+
+/*!
+  Constructor with \a state being the current state. The cache will
+  use the default backend.
+
+  \sa getDefaultBackend()
 */
 SoGLRenderCache::SoGLRenderCache(SoState * state)
   : SoCache(state)
 {
   PRIVATE(this) = new SoGLRenderCacheP;
+  PRIVATE(this)->backend = SoGLRenderCache::getDefaultBackend();
+  PRIVATE(this)->context = -1;
+  PRIVATE(this)->displaylist = NULL;
+  PRIVATE(this)->openstate = NULL;
+  PRIVATE(this)->failed = FALSE;
+  PRIVATE(this)->vertexvbo = NULL;
+  PRIVATE(this)->indexvbo = NULL;
+  PRIVATE(this)->shortindices = FALSE;
+  PRIVATE(this)->numvertices = 0;
+  PRIVATE(this)->numindices = 0;
+  PRIVATE(this)->resid = 0;
+  PRIVATE(this)->dlestimate = 0;
+  PRIVATE(this)->evicted = FALSE;
+}
+
+/*!
+  Constructor with \a state being the current state, which creates
+  a cache using \a backend. SoGLRenderCache::VERTEX_BUFFER must only
+  be used if the OpenGL driver supports vertex buffer objects.
+  SoGLCacheList checks this before creating its caches.
+
+  \since Coin 4.0
+*/
+SoGLRenderCache::SoGLRenderCache(SoState * state, const Backend backend)
+  : SoCache(state)
+{
+  PRIVATE(this) = new SoGLRenderCacheP;
+  PRIVATE(this)->backend = backend;
+  PRIVATE(this)->context = -1;
   PRIVATE(this)->displaylist = NULL;
   PRIVATE(this)->openstate = NULL;
+  PRIVATE(this)->failed = FALSE;
+  PRIVATE(this)->vertexvbo = NULL;
+  PRIVATE(this)->indexvbo = NULL;
+  PRIVATE(this)->shortindices = FALSE;
+  PRIVATE(this)->numvertices = 0;
+  PRIVATE(this)->numindices = 0;
+  PRIVATE(this)->resid = 0;
+  PRIVATE(this)->dlestimate = 0;
+  PRIVATE(this)->evicted = FALSE;
 }
 
 /*!
@@ -72,6 +660,7 @@ SoGLRenderCache::~SoGLRenderCache()
   // stuff should have been deleted in destroy()
   assert(PRIVATE(this)->displaylist == NULL);
   assert(PRIVATE(this)->nestedcachelist.getLength() == 0);
+  assert(PRIVATE(this)->vertexvbo == NULL);
   
   delete PRIVATE(this);
 }
@@ -88,6 +677,20 @@ SoGLRenderCache::open(SoState * state)
   assert(PRIVATE(this)->displaylist == NULL);
   assert(PRIVATE(this)->openstate == NULL); // cache should not be open
   PRIVATE(this)->openstate = state;
+  PRIVATE(this)->context = SoGLCacheContextElement::get(state);
+  // the size is set in close(). The buffers of vertex buffer caches
+  // are registered separately by SoVBO, and are made dependencies of
+  // the cache when they are bound.
+  PRIVATE(this)->resid =
+    SoGLResourceManagerP::add(PRIVATE(this)->context,
+                              SoGLResourceManager::RENDER_CACHE, 0,
+                              SoGLRenderCacheP::evictCB, PRIVATE(this));
+
+  // recording the vertex buffers doesn't make any OpenGL calls
+  if (PRIVATE(this)->backend == VERTEX_BUFFER) {
+    PRIVATE(this)->beginRecording(state);
+    return;
+  }
   PRIVATE(this)->displaylist =
     new SoGLDisplayList(state, SoGLDisplayList::DISPLAY_LIST);
   PRIVATE(this)->displaylist->ref();
@@ -103,20 +706,38 @@ void
 SoGLRenderCache::close(void)
 {
   assert(PRIVATE(this)->openstate != NULL);
-  assert(PRIVATE(this)->displaylist != NULL);
-  PRIVATE(this)->displaylist->close(PRIVATE(this)->openstate);
+  if (PRIVATE(this)->backend == VERTEX_BUFFER) {
+    PRIVATE(this)->endRecording();
+  }
+  else {
+    assert(PRIVATE(this)->displaylist != NULL);
+    PRIVATE(this)->displaylist->close(PRIVATE(this)->openstate);
+    SoGLResourceManagerP::resize(PRIVATE(this)->resid, PRIVATE(this)->dlestimate);
+  }
   PRIVATE(this)->openstate = NULL;
+
+#if COIN_DEBUG
+  if (coin_debug_caching_level() > 0 && !PRIVATE(this)->failed) {
+    SoDebugError::postInfo("SoGLRenderCache::close",
+                           "cache %p closed. Backend: %s, memory usage: %lu bytes",
+                           this,
+                           PRIVATE(this)->backend == VERTEX_BUFFER ?
+                           "VERTEX_BUFFER" : "DISPLAY_LIST",
+                           static_cast<unsigned long>(this->getMemoryUsage()));
+  }
+#endif // debug
 }
 
 /*!
-  Executes the cached display list.
+  Executes the cached display list or draw commands.
 
   \sa open()
 */
 void
 SoGLRenderCache::call(SoState * state)
 {
-  assert(PRIVATE(this)->displaylist != NULL);
+  assert(PRIVATE(this)->displaylist != NULL ||
+         PRIVATE(this)->backend == VERTEX_BUFFER);
 
   static int COIN_NESTED_CACHING = -1;
   if (COIN_NESTED_CACHING < 0) {
@@ -124,12 +745,25 @@ SoGLRenderCache::call(SoState * state)
     if (env) COIN_NESTED_CACHING = atoi(env);
     else COIN_NESTED_CACHING = 0;
   }
+
+  const SbTime start = SbTime::getTimeOfDay();
+  SoGLResourceManagerP::touch(PRIVATE(this)->resid, state);
   
   if (COIN_NESTED_CACHING) {
     if (state->isCacheOpen()) {
       SoCacheElement::addCacheDependency(state, this);  
-      
-      PRIVATE(this)->displaylist->call(state);
+
+      // a vertex buffer cache being recorded can't see what's
+      // rendered by this cache
+      SoGLRenderCacheP * recording = SoGLRenderCacheP::getRecording(state);
+      if (recording) recording->fail("nested render cache");
+
+      if (PRIVATE(this)->displaylist) {
+        PRIVATE(this)->displaylist->call(state);
+      }
+      else {
+        PRIVATE(this)->render(state);
+      }
       SoGLLazyElement::mergeCacheInfo(state, 
                                       &PRIVATE(this)->prestate,
                                       &PRIVATE(this)->poststate);
@@ -137,16 +771,28 @@ SoGLRenderCache::call(SoState * state)
       SoGLRenderCache* parentCache = static_cast<SoGLRenderCache *>(
         SoCacheElement::getCurrentCache(state)
        );
-      parentCache->addNestedCache(PRIVATE(this)->displaylist);
+      if (PRIVATE(this)->displaylist) {
+        parentCache->addNestedCache(PRIVATE(this)->displaylist);
+      }
     }
-    else {
+    else if (PRIVATE(this)->displaylist) {
       PRIVATE(this)->displaylist->call(state);
     }
+    else {
+      PRIVATE(this)->render(state);
+    }
   }
   else { // no nested caching
     SoCacheElement::invalidate(state); // destroy any parent caches
-    PRIVATE(this)->displaylist->call(state);
+    if (PRIVATE(this)->displaylist) {
+      PRIVATE(this)->displaylist->call(state);
+    }
+    else {
+      PRIVATE(this)->render(state);
+    }
   }
+
+  PRIVATE(this)->replaytime = SbTime::getTimeOfDay() - start;
 }
 
 /*!
@@ -159,7 +805,7 @@ int
 SoGLRenderCache::getCacheContext(void) const
 {
   if (PRIVATE(this)->displaylist) return PRIVATE(this)->displaylist->getContext();
-  return -1;
+  return PRIVATE(this)->context;
 }
 
 // Documented in superclass. Overridden to test and update lazy GL
@@ -168,6 +814,7 @@ SbBool
 SoGLRenderCache::isValid(const SoState * state) const
 {
   // pre and post cache state is handled in SoGLCacheList
+  if (PRIVATE(this)->evicted) return FALSE;
   return inherited::isValid(state);
 }
 
@@ -186,6 +833,8 @@ SoGLRenderCache::addNestedCache(SoGLDisplayList * child)
 void
 SoGLRenderCache::destroy(SoState * state)
 {
+  SoGLResourceManagerP::remove(PRIVATE(this)->resid);
+  PRIVATE(this)->resid = 0;
   int n = PRIVATE(this)->nestedcachelist.getLength();
   for (int i = 0; i < n; i++) {
     PRIVATE(this)->nestedcachelist[i]->unref(state);
@@ -195,6 +844,7 @@ SoGLRenderCache::destroy(SoState * state)
     PRIVATE(this)->displaylist->unref(state);
     PRIVATE(this)->displaylist = NULL;
   }
+  PRIVATE(this)->clear();
 }
 
 SoGLLazyElement::GLState * 
@@ -209,6 +859,306 @@ SoGLRenderCache::getPostLazyState(void)
   return &PRIVATE(this)->poststate;
 }
 
+/*!
+  Returns the backend used by this cache.
+
+  \since Coin 4.0
+*/
+SoGLRenderCache::Backend
+SoGLRenderCache::getBackend(void) const
+{
+  return PRIVATE(this)->backend;
+}
+
+/*!
+  Returns TRUE if this is a SoGLRenderCache::VERTEX_BUFFER cache, and
+  everything rendered while it was open could be baked into its
+  vertex buffers. If not, the cache can not be used, and the
+  subgraph should be cached in a display list instead.
+
+  \since Coin 4.0
+  \sa canBakeElement(), canBakeShape()
+*/
+SbBool
+SoGLRenderCache::isBaked(void) const
+{
+  return (PRIVATE(this)->backend == VERTEX_BUFFER) && !PRIVATE(this)->failed;
+}
+
+/*!
+  Returns the number of bytes used by the vertex buffers and draw
+  commands of this cache. The OpenGL driver keeps a copy of the
+  buffers of the same size for each context they are used in.
+
+  Returns 0 for display list caches, since the memory used by display
+  lists can not be queried from OpenGL.
+
+  \since Coin 4.0
+*/
+size_t
+SoGLRenderCache::getMemoryUsage(void) const
+{
+  if (PRIVATE(this)->backend == VERTEX_BUFFER) {
+    return PRIVATE(this)->getMemoryUsage();
+  }
+  return 0;
+}
+
+/*!
+  Returns the time spent the last time the cache was called. Since
+  OpenGL executes asynchronously, this is the time spent submitting
+  the cache to the driver.
+
+  \since Coin 4.0
+*/
+SbTime
+SoGLRenderCache::getReplayTime(void) const
+{
+  return PRIVATE(this)->replaytime;
+}
+
+/*!
+  Sets the backend used for new caches when nothing else is
+  specified. Until this is called, the default is
+  SoGLRenderCache::DISPLAY_LIST, unless the environment variable \c
+  COIN_RENDER_CACHE_BACKEND is set to \c VERTEX_BUFFER.
+
+  \since Coin 4.0
+*/
+void
+SoGLRenderCache::setDefaultBackend(const Backend backend)
+{
+  sorendercache_defaultbackend = static_cast<int>(backend);
+}
+
+/*!
+  Returns the backend used for new caches when nothing else is
+  specified.
+
+  \sa setDefaultBackend()
+  \since Coin 4.0
+*/
+SoGLRenderCache::Backend
+SoGLRenderCache::getDefaultBackend(void)
+{
+  if (sorendercache_defaultbackend >= 0) {
+    return static_cast<Backend>(sorendercache_defaultbackend);
+  }
+  const char * env = coin_getenv("COIN_RENDER_CACHE_BACKEND");
+  if (env && (strcmp(env, "VERTEX_BUFFER") == 0 || strcmp(env, "VBO") == 0)) {
+    return VERTEX_BUFFER;
+  }
+  return DISPLAY_LIST;
+}
+
+/*!
+  Returns TRUE if elements with stack index \a stackindex may be set
+  inside a SoGLRenderCache::VERTEX_BUFFER cache. These either only
+  affect the primitives generated for the shapes, or are baked into
+  the recorded vertices and draw commands. If any other element is
+  set before a shape is rendered, the cache is not baked.
+
+  \since Coin 4.0
+  \sa isBaked()
+*/
+SbBool
+SoGLRenderCache::canBakeElement(const int stackindex)
+{
+  sorendercache_init_allowedelements();
+  return
+    (stackindex >= 0) &&
+    (stackindex < sorendercache_allowedelements->getLength()) &&
+    (*sorendercache_allowedelements)[stackindex];
+}
+
+/*!
+  Returns TRUE if shapes of \a type can be baked into a
+  SoGLRenderCache::VERTEX_BUFFER cache. These are the shapes which
+  only render the triangles they generate in generatePrimitives().
 
+  \since Coin 4.0
+  \sa isBaked()
+*/
+SbBool
+SoGLRenderCache::canBakeShape(const SoType & type)
+{
+  return
+    (type == SoIndexedFaceSet::getClassTypeId()) ||
+    (type == SoFaceSet::getClassTypeId()) ||
+    (type == SoIndexedTriangleStripSet::getClassTypeId()) ||
+    (type == SoTriangleStripSet::getClassTypeId()) ||
+    (type == SoQuadMesh::getClassTypeId()) ||
+    (type == SoCube::getClassTypeId()) ||
+    (type == SoSphere::getClassTypeId()) ||
+    (type == SoCone::getClassTypeId()) ||
+    (type == SoCylinder::getClassTypeId());
+}
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/caches/SoGLRenderCache.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoGLRenderAction.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoCoordinateElement.h>
+#include <Inventor/elements/SoDrawStyleElement.h>
+#include <Inventor/elements/SoGLMultiTextureImageElement.h>
+#include <Inventor/elements/SoGLShaderProgramElement.h>
+#include <Inventor/elements/SoLazyElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/elements/SoMultiTextureEnabledElement.h>
+#include <Inventor/elements/SoMultiTextureMatrixElement.h>
+#include <Inventor/misc/SoState.h>
+#include <Inventor/nodes/SoCallback.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoLineSet.h>
+#include <Inventor/nodes/SoPointSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoText2.h>
+#include <Inventor/C/tidbits.h>
+
+// Opens a vertex buffer cache the way SoGLCacheList does. Recording
+// vertex buffers makes no OpenGL calls, so this works without an
+// OpenGL context as long as no shapes are rendered.
+static SoGLRenderCache *
+sorendercache_test_open(SoState * state)
+{
+  state->push();
+  SoGLRenderCache * cache =
+    new SoGLRenderCache(state, SoGLRenderCache::VERTEX_BUFFER);
+  cache->ref();
+  SoCacheElement::set(state, cache);
+  state->setCacheOpen(TRUE);
+  cache->open(state);
+  return cache;
+}
+
+static void
+sorendercache_test_close(SoState * state, SoGLRenderCache * cache)
+{
+  cache->close();
+  state->setCacheOpen(FALSE);
+  state->pop();
+}
+
+BOOST_AUTO_TEST_CASE(defaultBackend)
+{
+  // the environment is used until a default backend has been set
+  coin_setenv("COIN_RENDER_CACHE_BACKEND", "VERTEX_BUFFER", TRUE);
+  BOOST_CHECK_EQUAL(SoGLRenderCache::getDefaultBackend(), SoGLRenderCache::VERTEX_BUFFER);
+  coin_setenv("COIN_RENDER_CACHE_BACKEND", "DISPLAY_LIST", TRUE);
+  BOOST_CHECK_EQUAL(SoGLRenderCache::getDefaultBackend(), SoGLRenderCache::DISPLAY_LIST);
+  coin_unsetenv("COIN_RENDER_CACHE_BACKEND");
+  BOOST_CHECK_EQUAL(SoGLRenderCache::getDefaultBackend(), SoGLRenderCache::DISPLAY_LIST);
+
+  SoGLRenderCache::setDefaultBackend(SoGLRenderCache::VERTEX_BUFFER);
+  coin_setenv("COIN_RENDER_CACHE_BACKEND", "DISPLAY_LIST", TRUE);
+  BOOST_CHECK_EQUAL(SoGLRenderCache::getDefaultBackend(), SoGLRenderCache::VERTEX_BUFFER);
+  coin_unsetenv("COIN_RENDER_CACHE_BACKEND");
+
+  SoGLRenderAction action(SbViewportRegion(64, 64));
+  SoState * state = action.getState();
+  SoGLRenderCache * cache = new SoGLRenderCache(state);
+  cache->ref();
+  BOOST_CHECK_EQUAL(cache->getBackend(), SoGLRenderCache::VERTEX_BUFFER);
+  cache->unref(state);
+
+  SoGLRenderCache::setDefaultBackend(SoGLRenderCache::DISPLAY_LIST);
+  cache = new SoGLRenderCache(state);
+  cache->ref();
+  BOOST_CHECK_EQUAL(cache->getBackend(), SoGLRenderCache::DISPLAY_LIST);
+  BOOST_CHECK(!cache->isBaked());
+  cache->unref(state);
+
+  // an explicit backend overrides the default
+  cache = new SoGLRenderCache(state, SoGLRenderCache::VERTEX_BUFFER);
+  cache->ref();
+  BOOST_CHECK_EQUAL(cache->getBackend(), SoGLRenderCache::VERTEX_BUFFER);
+  cache->unref(state);
+}
+
+BOOST_AUTO_TEST_CASE(separatorBackend)
+{
+  // separators follow the default until a backend is set for them
+  SoGLRenderCache::setDefaultBackend(SoGLRenderCache::DISPLAY_LIST);
+  BOOST_CHECK_EQUAL(SoSeparator::getRenderCacheBackend(), int(SoGLRenderCache::DISPLAY_LIST));
+  SoSeparator::setRenderCacheBackend(SoGLRenderCache::VERTEX_BUFFER);
+  BOOST_CHECK_EQUAL(SoSeparator::getRenderCacheBackend(), int(SoGLRenderCache::VERTEX_BUFFER));
+  BOOST_CHECK_EQUAL(SoGLRenderCache::getDefaultBackend(), SoGLRenderCache::DISPLAY_LIST);
+  SoSeparator::setRenderCacheBackend(-1);
+  BOOST_CHECK_EQUAL(SoSeparator::getRenderCacheBackend(), int(SoGLRenderCache::DISPLAY_LIST));
+
+  // the choice is not a field, so files written by Coin stay readable
+  // by other Inventor implementations
+  SoSeparator * sep = new SoSeparator;
+  sep->ref();
+  BOOST_CHECK(sep->getField("renderCacheBackend") == NULL);
+  sep->unref();
+}
+
+BOOST_AUTO_TEST_CASE(bakeableElements)
+{
+  // geometry, transforms and materials are baked
+  BOOST_CHECK(SoGLRenderCache::canBakeElement(SoModelMatrixElement::getClassStackIndex()));
+  BOOST_CHECK(SoGLRenderCache::canBakeElement(SoCoordinateElement::getClassStackIndex()));
+  BOOST_CHECK(SoGLRenderCache::canBakeElement(SoLazyElement::getClassStackIndex()));
+  BOOST_CHECK(SoGLRenderCache::canBakeElement(SoCacheElement::getClassStackIndex()));
+
+  // textures, shaders and draw styles are not
+  BOOST_CHECK(!SoGLRenderCache::canBakeElement(SoGLMultiTextureImageElement::getClassStackIndex()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeElement(SoMultiTextureEnabledElement::getClassStackIndex()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeElement(SoMultiTextureMatrixElement::getClassStackIndex()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeElement(SoGLShaderProgramElement::getClassStackIndex()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeElement(SoDrawStyleElement::getClassStackIndex()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeElement(-1));
+}
+
+BOOST_AUTO_TEST_CASE(bakeableShapes)
+{
+  BOOST_CHECK(SoGLRenderCache::canBakeShape(SoCube::getClassTypeId()));
+  BOOST_CHECK(SoGLRenderCache::canBakeShape(SoIndexedFaceSet::getClassTypeId()));
+
+  BOOST_CHECK(!SoGLRenderCache::canBakeShape(SoLineSet::getClassTypeId()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeShape(SoPointSet::getClassTypeId()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeShape(SoText2::getClassTypeId()));
+  BOOST_CHECK(!SoGLRenderCache::canBakeShape(SoSeparator::getClassTypeId()));
+}
+
+BOOST_AUTO_TEST_CASE(notBaked)
+{
+  SoGLRenderAction action(SbViewportRegion(64, 64));
+  SoState * state = action.getState();
+
+  // nothing rendered, nothing to prevent baking
+  SoGLRenderCache * cache = sorendercache_test_open(state);
+  sorendercache_test_close(state, cache);
+  BOOST_CHECK(cache->isBaked());
+  BOOST_CHECK(cache->isValid(state));
+  cache->unref(state);
+
+  // SoCallback nodes may make any OpenGL calls
+  SoCallback * callback = new SoCallback;
+  callback->ref();
+  cache = sorendercache_test_open(state);
+  callback->GLRender(&action);
+  sorendercache_test_close(state, cache);
+  BOOST_CHECK(!cache->isBaked());
+  cache->unref(state);
+  callback->unref();
+
+  // calling another cache while recording. This invalidates the
+  // cache being recorded, or with nested caching, prevents baking.
+  SoGLRenderCache * child = sorendercache_test_open(state);
+  sorendercache_test_close(state, child);
+  cache = sorendercache_test_open(state);
+  child->call(state);
+  sorendercache_test_close(state, cache);
+  BOOST_CHECK(!cache->isValid(state) || !cache->isBaked());
+  cache->unref(state);
+  child->unref(state);
+}
+
+#endif // COIN_TEST_SUITE
@@ -0,0 +1,130 @@
+#ifndef COIN_SOGLRENDERCACHEP_H
+#define COIN_SOGLRENDERCACHEP_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <Inventor/caches/SoGLRenderCache.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbVec3f.h>
+#include <Inventor/lists/SbList.h>
+
+#include "misc/SbHash.h"
+
+class SoGLDisplayList;
+class SoElement;
+class SoPrimitiveVertex;
+class SoShape;
+class SoState;
+class SoVBO;
+
+// Private data for SoGLRenderCache. The vertex buffer backend records
+// the geometry of the shapes rendered while the cache is open into
+// one vertex buffer and one index buffer, and a list of draw commands
+// with the SoGLLazyElement state each range of indices needs. This is
+// exposed to SoShape, which feeds the recorder from
+// generatePrimitives().
+
+class SoGLRenderCacheP {
+public:
+  // interleaved vertex, 28 bytes
+  struct Vertex {
+    SbVec3f point;
+    SbVec3f normal;
+    uint8_t rgba[4];
+
+    // needed for SbHash
+    operator unsigned long(void) const;
+    int operator==(const Vertex & v) const;
+  };
+
+  struct Command {
+    int stateidx;
+    int first;
+    int count;
+  };
+
+  SoGLRenderCache::Backend backend;
+  int context;
+  SoGLDisplayList * displaylist;
+  SoState * openstate;
+  SbList <SoGLDisplayList*> nestedcachelist;
+  SoGLLazyElement::GLState prestate;
+  SoGLLazyElement::GLState poststate;
+  SbTime replaytime;
+
+  // SoGLResourceManager bookkeeping
+  uint32_t resid;
+  size_t dlestimate;
+  SbBool evicted;
+  static void evictCB(void * closure, const uint32_t contextid, SoState * state);
+
+  // vertex buffer backend
+  SbBool failed;
+  SbList <Vertex> vertexlist;
+  SbList <uint32_t> indexlist;
+  SbList <SoGLLazyElement::GLState> statelist;
+  SbList <Command> commandlist;
+  SoVBO * vertexvbo;
+  SoVBO * indexvbo;
+  SbBool shortindices;
+  int numvertices;
+  int numindices;
+
+  // recording
+  SbList <const SoElement *> openelements;
+  SbMatrix openinverse;
+  SbMatrix matrix;
+  SbMatrix normalmatrix;
+  SbBool identity;
+  const uint32_t * packedptr;
+  const SbColor * diffuseptr;
+  const float * transpptr;
+  int numdiffuse;
+  int numtransp;
+  int shapeindex;
+  SbHash <Vertex, int32_t> vhash;
+
+  static SoGLRenderCacheP * getRecording(SoState * state);
+  static SoGLRenderCacheP * get(SoGLRenderCache * cache) { return cache->pimpl; }
+
+  void beginRecording(SoState * state);
+  void endRecording(void);
+  void fail(const char * reason);
+
+  SbBool beginShape(SoState * state, const SoShape * shape);
+  void addTriangle(const SoPrimitiveVertex * v0,
+                   const SoPrimitiveVertex * v1,
+                   const SoPrimitiveVertex * v2);
+  void endShape(void);
+
+  void render(SoState * state);
+  void clear(void);
+  size_t getMemoryUsage(void) const;
+};
+
+#endif // !COIN_SOGLRENDERCACHEP_H
@@ -46,6 +46,7 @@
 #include <Inventor/lists/SbList.h>
 #include <Inventor/errors/SoDebugError.h>
 
+#include "misc/SoNormalGeneratorP.h"
 #include "tidbitsp.h"
 
 // *************************************************************************
@@ -183,47 +184,6 @@ SoNormalCache::getIndices(void) const
   return NULL;
 }
 
-//
-// calculates the normal vector for a vertex, based on the
-// normal vectors of all incident faces
-//
-static void
-calc_normal_vec(const SbVec3f * facenormals, const int facenum, 
-                const int numfacenorm, SbList <int32_t> & faceArray, 
-                const float threshold, SbVec3f & vertnormal)
-{
-  // start with face normal vector
-  const SbVec3f * facenormal = & facenormals[facenum];
-  vertnormal = *facenormal;
-
-  int n = faceArray.getLength();
-  int currface;
-
-  for (int i = 0; i < n; i++) {
-    currface = faceArray[i];
-    if (currface != facenum) { // check all but this face
-      if (currface < numfacenorm || numfacenorm == -1) { // -1 means: assume
-        const SbVec3f & normal = facenormals[currface];  // everything is ok
-        if ((normal.dot(*facenormal)) > threshold) {
-          // smooth towards this face
-          vertnormal += normal;
-        }
-      }
-      else {
-        static int calc_norm_error = 0;
-        if (calc_norm_error < 1) {
-          SoDebugError::postWarning("SoNormalCache::calc_normal_vec", "Normals "
-                                    "have not been specified for all faces. "
-                                    "this warning will only be shown once, "
-                                    "but there might be more errors");
-        }
-
-        calc_norm_error++;
-      }
-    }
-  }
-}
-
 /*!
   Generates normals for each vertex for each face. It is possible to
   specify face normals if these have been calculated somewhere else,
@@ -286,21 +246,43 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
     if (temp > maxi) maxi = temp;
   }
 
-  // for each vertex, store all faceindices the vertex is a part of
-  SbList<int32_t> * vertexFaceArray = new SbList<int32_t>[maxi+1]; // [0, maxi]
-
-  // for each vertex, store all normals that have been calculated
-  SbList <int32_t>* vertexNormalArray = new SbList<int32_t>[maxi+1]; // [0, maxi]
+  // the face of each vertex in vindex
+  int32_t * vertexface = new int32_t[SbMax(numvi, 1)];
+  int currindex = 0; // current normal index
+  int facenum = 0;
+  int stripcnt = 0;
+  for (i = 0; i < numvi; i++) {
+    currindex = vindex[i];
+    if (currindex >= 0 && static_cast<unsigned int>(currindex) < numcoords) {
+      if (tristrip) {
+        if (++stripcnt > 3) facenum++; // next face
+      }
+      vertexface[i] = facenum;
+    }
+    else { // new face
+      facenum++;
+      stripcnt = 0;
+    }
+  }
 
-  int numfaces = 0;
+  // for each vertex, store all faceindices the vertex is a part of.
+  // Without triangle strips, these are just the faces found above.
+  const int numvertices = SbMin(maxi + 1, static_cast<int>(numcoords));
+  int32_t * firstface = new int32_t[numvertices + 1];
+  int32_t * vertexfaces = NULL;
 
   if (tristrip) {
+    SbList<int32_t> incvertex(numvi);
+    SbList<int32_t> incface(numvi);
+    int numfaces = 0;
+
     // Find and save the faces belonging to the different vertices
     i = 0;
     while (i + 2 < numvi) {
       temp = vindex[i];
       if (temp >= 0 && static_cast<unsigned int>(temp) < numcoords) {
-        vertexFaceArray[temp].append(numfaces);
+        incvertex.append(temp);
+        incface.append(numfaces);
       }
       else {
         i = i+1;
@@ -310,7 +292,8 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
 
       temp = vindex[i+1];
       if (temp >= 0 && static_cast<unsigned int>(temp) < numcoords) {
-        vertexFaceArray[temp].append(numfaces);
+        incvertex.append(temp);
+        incface.append(numfaces);
       }
       else {
         i = i+2;
@@ -320,7 +303,8 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
 
       temp = vindex[i+2];
       if (temp >= 0 && static_cast<unsigned int>(temp) < numcoords) {
-        vertexFaceArray[temp].append(numfaces);
+        incvertex.append(temp);
+        incface.append(numfaces);
       }
       else {
         i = i+3;
@@ -338,40 +322,60 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
       i++;
       numfaces++;
     }
+    vertexfaces = new int32_t[SbMax(incvertex.getLength(), 1)];
+    sonormalgenerator_vertex_faces(incvertex.getArrayPtr(), incface.getArrayPtr(),
+                                   incvertex.getLength(), numvertices,
+                                   firstface, vertexfaces);
   }
-  else { // !tristrip
-    for (i = 0; i < numvi; i++) {
-      temp = vindex[i];
-      if (temp >= 0 && static_cast<unsigned int>(temp) < numcoords) {
-        vertexFaceArray[temp].append(numfaces);
-      }
-      else {
-        numfaces++;
+  else {
+    vertexfaces = new int32_t[SbMax(numvi, 1)];
+    sonormalgenerator_vertex_faces(vindex, vertexface, numvi, numvertices,
+                                   firstface, vertexfaces);
+  }
+  const int numvertexfaces = firstface[numvertices];
+
+  if (numfacenorm != -1) {
+    for (i = 0; i < numvertexfaces; i++) {
+      if (vertexfaces[i] >= numfacenorm) {
+        static int calc_norm_error = 0;
+        if (calc_norm_error < 1) {
+          SoDebugError::postWarning("SoNormalCache::generatePerVertex", "Normals "
+                                    "have not been specified for all faces. "
+                                    "this warning will only be shown once, "
+                                    "but there might be more errors");
+        }
+        calc_norm_error++;
+        break;
       }
     }
   }
 
+  // calc normal for each vertex in vindex, possibly in several threads
   float threshold = static_cast<float>(cos(SbClamp(crease_angle, 0.0f, static_cast<float>(M_PI))));
+  SbVec3f * vertexnormals = new SbVec3f[SbMax(numvi, 1)];
+  sonormalgenerator_smooth(facenorm, numfacenorm, firstface, vertexfaces, numvertices,
+                           vindex, vertexface, numvi, threshold, vertexnormals);
+  delete [] firstface;
+  delete [] vertexfaces;
+
+  // for each vertex, the normals that have been calculated, as a list
+  // through nextnormal in the order they were calculated
+  int32_t * firstnormal = new int32_t[maxi+1]; // [0, maxi]
+  int32_t * lastnormal = new int32_t[maxi+1];
+  for (i = 0; i <= maxi; i++) firstnormal[i] = -1;
+  SbList<int32_t> nextnormal(numvi);
+
   SbBool found;
-  int currindex = 0; // current normal index
   int nindex = 0;
-  int j, n ;
-  int facenum = 0;
-  int stripcnt = 0;
 
   for (i = 0; i < numvi; i++) {
     currindex = vindex[i];
     if (currindex >= 0 && static_cast<unsigned int>(currindex) < numcoords) {
-      if (tristrip) {
-        if (++stripcnt > 3) facenum++; // next face
-      }
-      // calc normal for this vertex
-      SbVec3f tmpvec;
-      calc_normal_vec(facenorm, facenum, numfacenorm, vertexFaceArray[currindex], 
-                      threshold, tmpvec);
+      facenum = vertexface[i];
+      const SbVec3f & tmpvec = vertexnormals[i];
 
       // Be robust when it comes to erroneously specified triangles.
-      if ((tmpvec.normalize() == 0.0f) && coin_debug_extra()) {
+      if ((tmpvec == SbVec3f(0.0f, 0.0f, 0.0f)) && coin_debug_extra()) {
 #if COIN_DEBUG
         static uint32_t normgenerrors_vertex = 0;
         if (normgenerrors_vertex < 1) {
@@ -393,14 +397,12 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
         PRIVATE(this)->normalArray[nindex] = tmpvec;
 
       // try to find equal normal (total smoothing)
-      SbList <int32_t> & array = vertexNormalArray[currindex];
       found = FALSE;
-      n = array.getLength();
-      int same_normal = -1;
-      for (j = 0; j < n && !found; j++) {
-        same_normal = array[j];
+      int same_normal = firstnormal[currindex];
+      while (same_normal >= 0 && !found) {
         found = PRIVATE(this)->normalArray[same_normal].equals(PRIVATE(this)->normalArray[nindex],
                                                       NORMAL_EPSILON);
+        if (!found) same_normal = nextnormal[same_normal];
       }
       if (found)
         PRIVATE(this)->indices.append(same_normal);
@@ -412,13 +414,14 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
       }
       else {
         PRIVATE(this)->indices.append(nindex);
-        array.append(nindex);
+        if (firstnormal[currindex] < 0) firstnormal[currindex] = nindex;
+        else nextnormal[lastnormal[currindex]] = nindex;
+        lastnormal[currindex] = nindex;
+        nextnormal.append(-1);
         nindex++;
       }
     }
     else { // new face
-      facenum++;
-      stripcnt = 0;
       PRIVATE(this)->indices.append(-1); // add a -1 for PER_VERTEX_INDEXED binding
     }
   }
@@ -431,8 +434,10 @@ SoNormalCache::generatePerVertex(const SbVec3f * const coords,
                          "generated normals per vertex: %p %d %d\n",
                          PRIVATE(this)->normalData.normals, PRIVATE(this)->numNormals, PRIVATE(this)->indices.getLength());
 #endif
-  delete [] vertexFaceArray;
-  delete [] vertexNormalArray;
+  delete [] vertexface;
+  delete [] vertexnormals;
+  delete [] firstnormal;
+  delete [] lastnormal;
 }
 
 /*!
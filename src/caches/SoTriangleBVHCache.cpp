@@ -0,0 +1,240 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SoTriangleBVHCache SoTriangleBVHCache.h
+  \brief The SoTriangleBVHCache class keeps the triangles of a shape in a bounding volume hierarchy.
+
+  The cache holds the object space triangles of a shape, with an
+  SbBVH of their bounding boxes. It is used by SoShape to find out
+  quickly that a pick ray, or a lasso selection volume, can't touch
+  any triangle of the shape, so that generating the primitives of
+  the shape can be skipped. The tests are conservative: they may say
+  a triangle is touched when it isn't, but never the other way
+  around.
+
+  Shapes with lines or points, and shapes with only a few triangles,
+  get a cache which is not usable, so that the cache is not made
+  over and over again for them.
+*/
+
+#include "caches/SoTriangleBVHCache.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <Inventor/SbLine.h>
+#include <Inventor/SbPlane.h>
+#include <Inventor/SbVec3d.h>
+
+#include <cfloat>
+#include <cmath>
+
+// shapes with fewer triangles than this are cheap enough to test
+// without the tree
+static const int SOTRIANGLEBVHCACHE_MINTRIANGLES = 32;
+
+// *************************************************************************
+
+// Line and triangle test with some slack, in double precision like
+// SoRayPickAction::intersect(). Returns TRUE if the line passes
+// through or close to the triangle, or is parallel to it.
+static SbBool
+sotrianglebvhcache_line_hits(const SbVec3d & orig, const SbVec3d & dir, const SbVec3f * v)
+{
+  const double slack = 1.0e-4;
+  SbVec3d v0, v1, v2;
+  v0.setValue(v[0]);
+  v1.setValue(v[1]);
+  v2.setValue(v[2]);
+  const SbVec3d edge1 = v1 - v0;
+  const SbVec3d edge2 = v2 - v0;
+  const SbVec3d pvec = dir.cross(edge2);
+  const double det = edge1.dot(pvec);
+  if (fabs(det) <= 1.0e-9 * edge1.length() * edge2.length() * dir.length()) return TRUE;
+
+  const double invdet = 1.0 / det;
+  const SbVec3d tvec = orig - v0;
+  const double u = tvec.dot(pvec) * invdet;
+  if (u < -slack || u > 1.0 + slack) return FALSE;
+  const SbVec3d qvec = tvec.cross(edge1);
+  const double w = dir.dot(qvec) * invdet;
+  return w >= -slack && u + w <= 1.0 + slack;
+}
+
+struct sotrianglebvhcache_ray {
+  SbVec3d orig;
+  SbVec3d dir;
+  const SbVec3f * vertices;
+  SbBool hit;
+};
+
+static float
+sotrianglebvhcache_ray_cb(void * closure, const int item, const float tmax)
+{
+  sotrianglebvhcache_ray * data = static_cast<sotrianglebvhcache_ray *>(closure);
+  if (sotrianglebvhcache_line_hits(data->orig, data->dir, data->vertices + 3 * item)) {
+    data->hit = TRUE;
+    // stops the traversal
+    return -FLT_MAX;
+  }
+  return tmax;
+}
+
+// *************************************************************************
+
+/*!
+  Constructor. \a actiontype is the type of the action the primitives
+  are generated for, since shapes may generate different primitives
+  for different actions.
+*/
+SoTriangleBVHCache::SoTriangleBVHCache(SoState * state, const SoType actiontype)
+  : SoCache(state),
+    actiontype(actiontype),
+    otherprimitives(FALSE)
+{
+}
+
+/*!
+  Destructor.
+*/
+SoTriangleBVHCache::~SoTriangleBVHCache()
+{
+}
+
+/*!
+  Adds a triangle, in object space.
+*/
+void
+SoTriangleBVHCache::addTriangle(const SbVec3f & v0, const SbVec3f & v1, const SbVec3f & v2)
+{
+  if (this->otherprimitives) return;
+  this->vertices.append(v0);
+  this->vertices.append(v1);
+  this->vertices.append(v2);
+}
+
+/*!
+  Tells the cache that the shape has lines or points, which makes the
+  cache unusable.
+*/
+void
+SoTriangleBVHCache::addOtherPrimitive(void)
+{
+  this->otherprimitives = TRUE;
+  this->vertices.truncate(0, TRUE);
+}
+
+/*!
+  Builds the tree, after all the triangles have been added.
+*/
+void
+SoTriangleBVHCache::close(void)
+{
+  if (!this->isUsable()) {
+    this->vertices.truncate(0, TRUE);
+    return;
+  }
+  const int numtriangles = this->getNumTriangles();
+  const SbVec3f * v = this->vertices.getArrayPtr();
+  SbBox3f * boxes = new SbBox3f[numtriangles];
+  for (int i = 0; i < numtriangles; i++) {
+    SbBox3f & box = boxes[i];
+    box.extendBy(v[3 * i]);
+    box.extendBy(v[3 * i + 1]);
+    box.extendBy(v[3 * i + 2]);
+    // enlarge the boxes a little, so that rounding errors in the
+    // box tests don't lose triangles
+    const SbVec3f & min = box.getMin();
+    const SbVec3f & max = box.getMax();
+    float size = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      size = SbMax(size, SbMax(float(fabs(min[k])), float(fabs(max[k]))));
+    }
+    const float e = size * 1.0e-5f + FLT_MIN;
+    box.setBounds(min - SbVec3f(e, e, e), max + SbVec3f(e, e, e));
+  }
+  this->tree.build(boxes, numtriangles);
+  delete[] boxes;
+}
+
+/*!
+  Returns the type of the action the cache was made for.
+*/
+SoType
+SoTriangleBVHCache::getActionType(void) const
+{
+  return this->actiontype;
+}
+
+/*!
+  Returns TRUE if the shape has only triangles, and enough of them
+  for the tree to be worth using.
+*/
+SbBool
+SoTriangleBVHCache::isUsable(void) const
+{
+  return !this->otherprimitives && this->getNumTriangles() >= SOTRIANGLEBVHCACHE_MINTRIANGLES;
+}
+
+/*!
+  Returns the number of triangles in the cache.
+*/
+int
+SoTriangleBVHCache::getNumTriangles(void) const
+{
+  return this->vertices.getLength() / 3;
+}
+
+/*!
+  Returns FALSE if the object space \a line is certain not to
+  intersect any of the triangles.
+*/
+SbBool
+SoTriangleBVHCache::mayIntersect(const SbLine & line) const
+{
+  if (!this->isUsable()) return TRUE;
+  sotrianglebvhcache_ray data;
+  data.orig.setValue(line.getPosition());
+  data.dir.setValue(line.getDirection());
+  data.vertices = this->vertices.getArrayPtr();
+  data.hit = FALSE;
+  (void) this->tree.traceRay(line.getPosition(), line.getDirection(), -FLT_MAX, FLT_MAX,
+                             sotrianglebvhcache_ray_cb, &data);
+  return data.hit;
+}
+
+/*!
+  Returns FALSE if none of the triangles are in the object space
+  volume bounded by \a planes, which have their normals pointing into
+  the volume.
+*/
+SbBool
+SoTriangleBVHCache::mayIntersect(const SbPlane * planes, const int numplanes) const
+{
+  if (!this->isUsable()) return TRUE;
+  SbList<int> items;
+  this->tree.findFrustum(planes, numplanes, items);
+  return items.getLength() > 0;
+}
@@ -0,0 +1,64 @@
+#ifndef COIN_SOTRIANGLEBVHCACHE_H
+#define COIN_SOTRIANGLEBVHCACHE_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* ! COIN_INTERNAL */
+
+#include <Inventor/caches/SoCache.h>
+#include <Inventor/SoType.h>
+#include <Inventor/lists/SbList.h>
+
+#include "base/SbBVH.h"
+
+class SbLine;
+class SbPlane;
+
+class SoTriangleBVHCache : public SoCache {
+  typedef SoCache inherited;
+public:
+  SoTriangleBVHCache(SoState * state, const SoType actiontype);
+  virtual ~SoTriangleBVHCache();
+
+  void addTriangle(const SbVec3f & v0, const SbVec3f & v1, const SbVec3f & v2);
+  void addOtherPrimitive(void);
+  void close(void);
+
+  SoType getActionType(void) const;
+  SbBool isUsable(void) const;
+  int getNumTriangles(void) const;
+
+  SbBool mayIntersect(const SbLine & line) const;
+  SbBool mayIntersect(const SbPlane * planes, const int numplanes) const;
+
+private:
+  SoType actiontype;
+  SbList<SbVec3f> vertices;
+  SbBool otherprimitives;
+  SbBVH tree;
+};
+
+#endif // !COIN_SOTRIANGLEBVHCACHE_H
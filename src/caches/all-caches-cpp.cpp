@@ -31,4 +31,5 @@
 #include "SoPrimitiveVertexCache.cpp"
 #include "SoGlyphCache.cpp"
 #include "SoShaderProgramCache.cpp"
+#include "SoTriangleBVHCache.cpp"
 #include "SoVBOCache.cpp"
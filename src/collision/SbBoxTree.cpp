@@ -0,0 +1,604 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SbBoxTree noheader
+  \brief Bounding volume hierarchy of axis aligned boxes.
+
+  The tree is used for broad phase collision tests. For a static set
+  of boxes (like the triangles of a shape), build() makes a balanced
+  tree in one go by splitting the set at the median of the box
+  centers along the longest axis. When boxes move, setLeafBox()
+  followed by refit() updates the bounds while keeping the tree
+  structure.
+
+  For sets of boxes which change over time, leaves are added with
+  insert() and moved with update(). Inserted boxes are enlarged with
+  a margin, so that small movements don't need to restructure the
+  tree. The sibling of a new leaf is chosen to minimize the increase
+  in surface area, and the tree is kept balanced with rotations.
+
+  Leaves are identified by integer handles. These stay valid until
+  the leaf is removed.
+*/
+
+#include "collision/SbBoxTree.h"
+
+#include <algorithm>
+#include <cassert>
+
+// *************************************************************************
+
+namespace {
+
+// half of the surface area of a box, which is what the insertion
+// heuristic uses as the cost measure.
+inline float
+sbboxtree_area(const SbBox3f & box)
+{
+  const SbVec3f d = box.getMax() - box.getMin();
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+inline SbBox3f
+sbboxtree_union(const SbBox3f & a, const SbBox3f & b)
+{
+  SbBox3f u(a);
+  u.extendBy(b);
+  return u;
+}
+
+inline SbBool
+sbboxtree_contains(const SbBox3f & outer, const SbBox3f & inner)
+{
+  const SbVec3f & omin = outer.getMin();
+  const SbVec3f & omax = outer.getMax();
+  const SbVec3f & imin = inner.getMin();
+  const SbVec3f & imax = inner.getMax();
+  return
+    omin[0] <= imin[0] && omin[1] <= imin[1] && omin[2] <= imin[2] &&
+    omax[0] >= imax[0] && omax[1] >= imax[1] && omax[2] >= imax[2];
+}
+
+inline SbBool
+sbboxtree_overlap(const SbBox3f & a, const SbBox3f & b)
+{
+  const SbVec3f & amin = a.getMin();
+  const SbVec3f & amax = a.getMax();
+  const SbVec3f & bmin = b.getMin();
+  const SbVec3f & bmax = b.getMax();
+  return
+    amin[0] <= bmax[0] && amax[0] >= bmin[0] &&
+    amin[1] <= bmax[1] && amax[1] >= bmin[1] &&
+    amin[2] <= bmax[2] && amax[2] >= bmin[2];
+}
+
+// orders leaf indices on the box center along one axis
+class sbboxtree_center_less {
+public:
+  sbboxtree_center_less(const SbVec3f * centersarg, const int axisarg)
+    : centers(centersarg), axis(axisarg) { }
+  bool operator()(const int a, const int b) const {
+    return this->centers[a][this->axis] < this->centers[b][this->axis];
+  }
+private:
+  const SbVec3f * centers;
+  int axis;
+};
+
+} // namespace
+
+// *************************************************************************
+
+/*!
+  Constructor. Makes an empty tree.
+*/
+SbBoxTree::SbBoxTree(void)
+  : root(-1),
+    freelist(-1),
+    numleaves(0),
+    margin(0.1f)
+{
+}
+
+/*!
+  Destructor.
+*/
+SbBoxTree::~SbBoxTree()
+{
+}
+
+/*!
+  Removes all leaves from the tree.
+*/
+void
+SbBoxTree::clear(void)
+{
+  this->nodes.truncate(0);
+  this->root = -1;
+  this->freelist = -1;
+  this->numleaves = 0;
+}
+
+/*!
+  Clears the tree and builds it from \a numboxes boxes. Leaf \e i
+  holds box \e i, and has a NULL item. The boxes are not enlarged
+  with the margin.
+*/
+void
+SbBoxTree::build(const SbBox3f * boxes, const int numboxes)
+{
+  this->clear();
+  if (numboxes == 0) return;
+
+  Node leaf;
+  leaf.item = NULL;
+  leaf.parent = -1;
+  leaf.child[0] = leaf.child[1] = -1;
+  leaf.height = 0;
+  this->nodes.ensureCapacity(2 * numboxes - 1);
+  int i;
+  for (i = 0; i < numboxes; i++) {
+    leaf.box = boxes[i];
+    this->nodes.append(leaf);
+  }
+  this->numleaves = numboxes;
+
+  int * leaves = new int[numboxes];
+  SbVec3f * centers = new SbVec3f[numboxes];
+  for (i = 0; i < numboxes; i++) {
+    leaves[i] = i;
+    centers[i] = (boxes[i].getMin() + boxes[i].getMax()) * 0.5f;
+  }
+  this->root = this->buildRange(leaves, numboxes, centers);
+  this->nodes[this->root].parent = -1;
+  delete[] centers;
+  delete[] leaves;
+}
+
+// Builds the subtree for a range of leaves, and returns its root.
+int
+SbBoxTree::buildRange(int * leaves, const int numleaves, const SbVec3f * centers)
+{
+  if (numleaves == 1) return leaves[0];
+
+  // split at the median center along the longest axis of the centers
+  SbBox3f centerbox;
+  for (int i = 0; i < numleaves; i++) { centerbox.extendBy(centers[leaves[i]]); }
+  const SbVec3f d = centerbox.getMax() - centerbox.getMin();
+  int axis = 0;
+  if (d[1] > d[axis]) axis = 1;
+  if (d[2] > d[axis]) axis = 2;
+
+  const int mid = numleaves / 2;
+  std::nth_element(leaves, leaves + mid, leaves + numleaves,
+                   sbboxtree_center_less(centers, axis));
+
+  const int node = this->allocNode();
+  const int c0 = this->buildRange(leaves, mid, centers);
+  const int c1 = this->buildRange(leaves + mid, numleaves - mid, centers);
+
+  Node & n = this->nodes[node];
+  n.child[0] = c0;
+  n.child[1] = c1;
+  n.box = sbboxtree_union(this->nodes[c0].box, this->nodes[c1].box);
+  n.height = 1 + SbMax(this->nodes[c0].height, this->nodes[c1].height);
+  this->nodes[c0].parent = node;
+  this->nodes[c1].parent = node;
+  return node;
+}
+
+// *************************************************************************
+
+/*!
+  Adds a leaf for \a box with user data \a item, and returns its
+  handle. The box is enlarged with the margin.
+*/
+int
+SbBoxTree::insert(const SbBox3f & box, void * item)
+{
+  const int leaf = this->allocNode();
+  Node & n = this->nodes[leaf];
+  n.box = this->fatten(box);
+  n.item = item;
+  n.child[0] = n.child[1] = -1;
+  n.height = 0;
+  this->insertLeaf(leaf);
+  this->numleaves++;
+  return leaf;
+}
+
+/*!
+  Removes the leaf \a leaf from the tree.
+*/
+void
+SbBoxTree::remove(const int leaf)
+{
+  assert(leaf >= 0 && leaf < this->nodes.getLength());
+  assert(this->nodes[leaf].child[0] == -1);
+  this->removeLeaf(leaf);
+  this->freeNode(leaf);
+  this->numleaves--;
+}
+
+/*!
+  Moves leaf \a leaf to \a box. Nothing is done if the new box is
+  still inside the enlarged box of the leaf. Otherwise the leaf is
+  reinserted, and TRUE is returned.
+*/
+SbBool
+SbBoxTree::update(const int leaf, const SbBox3f & box)
+{
+  assert(leaf >= 0 && leaf < this->nodes.getLength());
+  if (sbboxtree_contains(this->nodes[leaf].box, box)) return FALSE;
+
+  this->removeLeaf(leaf);
+  this->nodes[leaf].box = this->fatten(box);
+  this->insertLeaf(leaf);
+  return TRUE;
+}
+
+/*!
+  Sets the box of \a leaf without updating the rest of the tree. Call
+  refit() after the leaf boxes have been changed.
+*/
+void
+SbBoxTree::setLeafBox(const int leaf, const SbBox3f & box)
+{
+  assert(leaf >= 0 && leaf < this->nodes.getLength());
+  this->nodes[leaf].box = box;
+}
+
+/*!
+  Recalculates the boxes of all inner nodes from the leaf boxes.
+*/
+void
+SbBoxTree::refit(void)
+{
+  if (this->root >= 0) this->refitNode(this->root);
+}
+
+void
+SbBoxTree::refitNode(const int node)
+{
+  Node & n = this->nodes[node];
+  if (n.child[0] == -1) return;
+  this->refitNode(n.child[0]);
+  this->refitNode(n.child[1]);
+  n.box = sbboxtree_union(this->nodes[n.child[0]].box,
+                          this->nodes[n.child[1]].box);
+}
+
+// *************************************************************************
+
+/*!
+  Returns the user data of \a leaf.
+*/
+void *
+SbBoxTree::getItem(const int leaf) const
+{
+  return this->nodes.getArrayPtr()[leaf].item;
+}
+
+/*!
+  Returns the box of \a leaf, including the margin. Also works for
+  the internal nodes found with getRoot() and getChild().
+*/
+const SbBox3f &
+SbBoxTree::getBox(const int leaf) const
+{
+  return this->nodes.getArrayPtr()[leaf].box;
+}
+
+/*!
+  Returns the number of leaves in the tree.
+*/
+int
+SbBoxTree::getNumLeaves(void) const
+{
+  return this->numleaves;
+}
+
+/*!
+  Returns the height of the tree. A tree with a single leaf has
+  height 0, and an empty tree has height -1.
+*/
+int
+SbBoxTree::getHeight(void) const
+{
+  if (this->root == -1) return -1;
+  return this->nodes.getArrayPtr()[this->root].height;
+}
+
+/*!
+  Returns the root node of the tree, or -1 if the tree is empty. The
+  root is a leaf if the tree holds a single box.
+
+  Together with getChild() and getBox(), this is for searches which
+  need to visit the nodes in their own order, like closest point
+  searches.
+*/
+int
+SbBoxTree::getRoot(void) const
+{
+  return this->root;
+}
+
+/*!
+  Returns child number \a which (0 or 1) of \a node, or -1 if \a
+  node is a leaf.
+*/
+int
+SbBoxTree::getChild(const int node, const int which) const
+{
+  assert(which == 0 || which == 1);
+  return this->nodes.getArrayPtr()[node].child[which];
+}
+
+/*!
+  Sets the margin boxes are enlarged with when inserted or moved, as
+  a fraction of the longest side of the box. The default is 0.1.
+*/
+void
+SbBoxTree::setMargin(const float marginarg)
+{
+  assert(marginarg >= 0.0f);
+  this->margin = marginarg;
+}
+
+/*!
+  Returns the margin.
+
+  \sa setMargin()
+*/
+float
+SbBoxTree::getMargin(void) const
+{
+  return this->margin;
+}
+
+/*!
+  Appends the handles of all leaves with boxes overlapping \a box to
+  \a leaves. The list is not cleared first.
+*/
+void
+SbBoxTree::findLeaves(const SbBox3f & box, SbList<int> & leaves) const
+{
+  if (this->root == -1 || box.isEmpty()) return;
+  const Node * nodearray = this->nodes.getArrayPtr();
+
+  // the stack never holds more than height + 1 nodes
+  int localstack[64];
+  int * stack = localstack;
+  const int stacksize = nodearray[this->root].height + 2;
+  if (stacksize > 64) stack = new int[stacksize];
+
+  int top = 0;
+  stack[top++] = this->root;
+  while (top > 0) {
+    const Node & n = nodearray[stack[--top]];
+    if (!sbboxtree_overlap(n.box, box)) continue;
+    if (n.child[0] == -1) {
+      leaves.append(static_cast<int>(&n - nodearray));
+    }
+    else {
+      stack[top++] = n.child[1];
+      stack[top++] = n.child[0];
+    }
+  }
+  if (stack != localstack) delete[] stack;
+}
+
+// *************************************************************************
+
+int
+SbBoxTree::allocNode(void)
+{
+  if (this->freelist != -1) {
+    const int node = this->freelist;
+    this->freelist = this->nodes[node].parent;
+    this->nodes[node].parent = -1;
+    return node;
+  }
+  Node n;
+  n.item = NULL;
+  n.parent = -1;
+  n.child[0] = n.child[1] = -1;
+  n.height = 0;
+  this->nodes.append(n);
+  return this->nodes.getLength() - 1;
+}
+
+void
+SbBoxTree::freeNode(const int node)
+{
+  Node & n = this->nodes[node];
+  n.item = NULL;
+  n.height = -1;
+  n.parent = this->freelist;
+  this->freelist = node;
+}
+
+SbBox3f
+SbBoxTree::fatten(const SbBox3f & box) const
+{
+  if (box.isEmpty() || this->margin == 0.0f) return box;
+  const SbVec3f d = box.getMax() - box.getMin();
+  const float m = this->margin * SbMax(d[0], SbMax(d[1], d[2]));
+  const SbVec3f mv(m, m, m);
+  return SbBox3f(box.getMin() - mv, box.getMax() + mv);
+}
+
+void
+SbBoxTree::insertLeaf(const int leaf)
+{
+  if (this->root == -1) {
+    this->root = leaf;
+    this->nodes[leaf].parent = -1;
+    return;
+  }
+
+  // find the best sibling, by the increase in surface area of the
+  // inner nodes the new leaf is added below
+  const SbBox3f leafbox = this->nodes[leaf].box;
+  int index = this->root;
+  while (this->nodes[index].child[0] != -1) {
+    const Node & n = this->nodes[index];
+    const float area = sbboxtree_area(n.box);
+    const float combinedarea = sbboxtree_area(sbboxtree_union(n.box, leafbox));
+
+    // cost of making a new parent for this node and the leaf
+    const float cost = 2.0f * combinedarea;
+    // minimum cost of pushing the leaf further down the tree
+    const float inheritance = 2.0f * (combinedarea - area);
+
+    float childcost[2];
+    for (int i = 0; i < 2; i++) {
+      const Node & c = this->nodes[n.child[i]];
+      const float a = sbboxtree_area(sbboxtree_union(c.box, leafbox));
+      childcost[i] = inheritance + ((c.child[0] == -1) ? a : a - sbboxtree_area(c.box));
+    }
+    if (cost < childcost[0] && cost < childcost[1]) break;
+    index = (childcost[0] < childcost[1]) ? n.child[0] : n.child[1];
+  }
+
+  const int sibling = index;
+  const int oldparent = this->nodes[sibling].parent;
+  const int newparent = this->allocNode();
+  Node & p = this->nodes[newparent];
+  p.parent = oldparent;
+  p.item = NULL;
+  p.box = sbboxtree_union(leafbox, this->nodes[sibling].box);
+  p.height = this->nodes[sibling].height + 1;
+  p.child[0] = sibling;
+  p.child[1] = leaf;
+  this->nodes[sibling].parent = newparent;
+  this->nodes[leaf].parent = newparent;
+
+  if (oldparent != -1) {
+    Node & op = this->nodes[oldparent];
+    if (op.child[0] == sibling) op.child[0] = newparent;
+    else op.child[1] = newparent;
+  }
+  else {
+    this->root = newparent;
+  }
+
+  // walk back up, fixing heights and boxes
+  index = this->nodes[leaf].parent;
+  while (index != -1) {
+    index = this->balance(index);
+    Node & n = this->nodes[index];
+    const Node & c0 = this->nodes[n.child[0]];
+    const Node & c1 = this->nodes[n.child[1]];
+    n.height = 1 + SbMax(c0.height, c1.height);
+    n.box = sbboxtree_union(c0.box, c1.box);
+    index = n.parent;
+  }
+}
+
+void
+SbBoxTree::removeLeaf(const int leaf)
+{
+  if (leaf == this->root) {
+    this->root = -1;
+    return;
+  }
+
+  const int parent = this->nodes[leaf].parent;
+  const int grandparent = this->nodes[parent].parent;
+  const int sibling = (this->nodes[parent].child[0] == leaf) ?
+    this->nodes[parent].child[1] : this->nodes[parent].child[0];
+
+  if (grandparent != -1) {
+    Node & gp = this->nodes[grandparent];
+    if (gp.child[0] == parent) gp.child[0] = sibling;
+    else gp.child[1] = sibling;
+    this->nodes[sibling].parent = grandparent;
+    this->freeNode(parent);
+
+    int index = grandparent;
+    while (index != -1) {
+      index = this->balance(index);
+      Node & n = this->nodes[index];
+      const Node & c0 = this->nodes[n.child[0]];
+      const Node & c1 = this->nodes[n.child[1]];
+      n.box = sbboxtree_union(c0.box, c1.box);
+      n.height = 1 + SbMax(c0.height, c1.height);
+      index = n.parent;
+    }
+  }
+  else {
+    this->root = sibling;
+    this->nodes[sibling].parent = -1;
+    this->freeNode(parent);
+  }
+  this->nodes[leaf].parent = -1;
+}
+
+// Rotates the subtree at node a if its children differ in height by
+// more than one, and returns the root of the subtree.
+int
+SbBoxTree::balance(const int a)
+{
+  Node & na = this->nodes[a];
+  if (na.child[0] == -1 || na.height < 2) return a;
+
+  const int b = na.child[0];
+  const int c = na.child[1];
+  const int diff = this->nodes[c].height - this->nodes[b].height;
+  if (diff >= -1 && diff <= 1) return a;
+
+  // the higher child moves up
+  const int up = (diff > 1) ? c : b;
+  Node & nu = this->nodes[up];
+  const int f = nu.child[0];
+  const int g = nu.child[1];
+
+  nu.child[0] = a;
+  nu.parent = na.parent;
+  na.parent = up;
+  if (nu.parent != -1) {
+    Node & p = this->nodes[nu.parent];
+    if (p.child[0] == a) p.child[0] = up;
+    else p.child[1] = up;
+  }
+  else {
+    this->root = up;
+  }
+
+  // the higher of the grandchildren stays below the new subtree root,
+  // the lower one goes to a
+  int keep = f, give = g;
+  if (this->nodes[g].height > this->nodes[f].height) { keep = g; give = f; }
+  nu.child[1] = keep;
+  if (diff > 1) na.child[1] = give;
+  else na.child[0] = give;
+  this->nodes[give].parent = a;
+
+  na.box = sbboxtree_union(this->nodes[na.child[0]].box, this->nodes[na.child[1]].box);
+  na.height = 1 + SbMax(this->nodes[na.child[0]].height, this->nodes[na.child[1]].height);
+  nu.box = sbboxtree_union(na.box, this->nodes[keep].box);
+  nu.height = 1 + SbMax(na.height, this->nodes[keep].height);
+  return up;
+}
@@ -0,0 +1,92 @@
+#ifndef COIN_SBBOXTREE_H
+#define COIN_SBBOXTREE_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif
+
+#include <Inventor/SbBox3f.h>
+#include <Inventor/lists/SbList.h>
+
+// Bounding volume hierarchy of axis aligned boxes. The tree can
+// either be built top-down in one go from a set of boxes (leaf i then
+// holds box i), or be maintained incrementally with insert(),
+// remove() and update(). Leaves are identified by integer handles.
+
+class SbBoxTree {
+public:
+  SbBoxTree(void);
+  ~SbBoxTree();
+
+  void clear(void);
+  void build(const SbBox3f * boxes, const int numboxes);
+
+  int insert(const SbBox3f & box, void * item);
+  void remove(const int leaf);
+  SbBool update(const int leaf, const SbBox3f & box);
+
+  void setLeafBox(const int leaf, const SbBox3f & box);
+  void refit(void);
+
+  void * getItem(const int leaf) const;
+  const SbBox3f & getBox(const int leaf) const;
+  int getNumLeaves(void) const;
+  int getHeight(void) const;
+
+  int getRoot(void) const;
+  int getChild(const int node, const int which) const;
+
+  void setMargin(const float margin);
+  float getMargin(void) const;
+
+  void findLeaves(const SbBox3f & box, SbList<int> & leaves) const;
+
+private:
+  struct Node {
+    SbBox3f box;
+    void * item;
+    int parent; // next free node when on the free list
+    int child[2];
+    int height;
+  };
+
+  int allocNode(void);
+  void freeNode(const int node);
+  void insertLeaf(const int leaf);
+  void removeLeaf(const int leaf);
+  int balance(const int node);
+  void refitNode(const int node);
+  int buildRange(int * leaves, const int numleaves, const SbVec3f * centers);
+  SbBox3f fatten(const SbBox3f & box) const;
+
+  SbList<Node> nodes;
+  int root;
+  int freelist;
+  int numleaves;
+  float margin;
+};
+
+#endif // !COIN_SBBOXTREE_H
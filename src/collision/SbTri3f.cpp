@@ -50,6 +50,11 @@
 #include <Inventor/SbBox3f.h>
 
 #include "SbTri3f.h"
+#include "tidbitsp.h"
+
+#ifdef COIN_HAVE_X86_SIMD
+#include <emmintrin.h>
+#endif // COIN_HAVE_X86_SIMD
 
 // Here's an idea for an alternate approach for this class:
 //
@@ -74,108 +79,274 @@
 
 // *************************************************************************
 
-class SbTri3fP {
-public:
-  SbTri3fP(void) {}
-  SbTri3fP(SbTri3fP * t)
-    : a(t->a), b(t->b), c(t->c) {}
-  SbTri3fP(const SbVec3f & na, const SbVec3f & nb, const SbVec3f & nc)
-    : a(na), b(nb), c(nc)
-  {
-    // FIXME: fix IDAction so this assert doesn't hit. 20030328 mortene.
-    assert(a != b && a != c && b != c);
-  }
-
-  SbVec3f a;
-  SbVec3f b;
-  SbVec3f c;
-};
-
-// *************************************************************************
-
-#define PRIVATE(obj) ((obj)->pimpl)
-
 SbTri3f::SbTri3f(void)
-  : pimpl(new SbTri3fP)
 {
 }
 
 SbTri3f::SbTri3f(const SbTri3f & t)
-  : pimpl(new SbTri3fP(PRIVATE(&t)))
+  : a(t.a), b(t.b), c(t.c)
 {
 }
 
-SbTri3f::SbTri3f(const SbVec3f & a, const SbVec3f & b, const SbVec3f & c)
-  : pimpl(new SbTri3fP(a, b, c))
+SbTri3f::SbTri3f(const SbVec3f & na, const SbVec3f & nb, const SbVec3f & nc)
+  : a(na), b(nb), c(nc)
 {
+  // FIXME: fix IDAction so this assert doesn't hit. 20030328 mortene.
+  assert(a != b && a != c && b != c);
 }
 
 SbTri3f::~SbTri3f(void)
 {
-  delete PRIVATE(this);
 }
 
 SbTri3f &
 SbTri3f::setValue(const SbTri3f & t)
 {
-  PRIVATE(this)->a = PRIVATE(&t)->a;
-  PRIVATE(this)->b = PRIVATE(&t)->b;
-  PRIVATE(this)->c = PRIVATE(&t)->c;
-  assert(PRIVATE(this)->a != PRIVATE(this)->b && PRIVATE(this)->a != PRIVATE(this)->c && PRIVATE(this)->b != PRIVATE(this)->c);
+  this->a = t.a;
+  this->b = t.b;
+  this->c = t.c;
+  assert(this->a != this->b && this->a != this->c && this->b != this->c);
   return *this;
 }
 
 SbTri3f &
-SbTri3f::setValue(const SbVec3f & a, const SbVec3f & b, const SbVec3f & c)
+SbTri3f::setValue(const SbVec3f & na, const SbVec3f & nb, const SbVec3f & nc)
 {
-  assert(a != b && a != c && b != c);
-  PRIVATE(this)->a = a;
-  PRIVATE(this)->b = b;
-  PRIVATE(this)->c = c;
+  assert(na != nb && na != nc && nb != nc);
+  this->a = na;
+  this->b = nb;
+  this->c = nc;
   return *this;
 }
 
 void
 SbTri3f::getValue(SbTri3f & t) const
 {
-  PRIVATE(&t)->a = PRIVATE(this)->a;
-  PRIVATE(&t)->b = PRIVATE(this)->b;
-  PRIVATE(&t)->c = PRIVATE(this)->c;
+  t.a = this->a;
+  t.b = this->b;
+  t.c = this->c;
 }
 
 void
-SbTri3f::getValue(SbVec3f & a, SbVec3f & b, SbVec3f & c) const
+SbTri3f::getValue(SbVec3f & va, SbVec3f & vb, SbVec3f & vc) const
 {
-  a = PRIVATE(this)->a;
-  b = PRIVATE(this)->b;
-  c = PRIVATE(this)->c;
+  va = this->a;
+  vb = this->b;
+  vc = this->c;
 }
 
 SbTri3f &
 SbTri3f::operator = (const SbTri3f & t)
 {
-  PRIVATE(this)->a = PRIVATE(&t)->a;
-  PRIVATE(this)->b = PRIVATE(&t)->b;
-  PRIVATE(this)->c = PRIVATE(&t)->c;
+  this->a = t.a;
+  this->b = t.b;
+  this->c = t.c;
   return *this;
 }
 
 // *************************************************************************
 
+// Quick rejection tests, used before the exact (and a lot more
+// expensive) tests below. The SSE2 versions do the same computations
+// as the scalar versions, four lanes at a time.
+
+// Returns TRUE if all the vertices of p are more than margin away from
+// the plane of q, on the same side. A small tolerance relative to the
+// coordinate magnitudes is added, so that TRUE is only returned when
+// the exact tests would also find the triangles apart.
+static SbBool
+sbtri3f_plane_separated(const SbVec3f * p, const SbVec3f * q, const float margin)
+{
+  const SbVec3f n = (q[1] - q[0]).cross(q[2] - q[0]);
+  float scale = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      scale = SbMax(scale, SbMax(float(fabs(p[i][j])), float(fabs(q[i][j]))));
+    }
+  }
+  const float nlen = float(fabs(n[0])) + float(fabs(n[1])) + float(fabs(n[2]));
+  const float limit = nlen * (margin + 1.0e-5f * scale);
+  float d[3];
+  for (int k = 0; k < 3; k++) {
+    d[k] = n[0] * (p[k][0] - q[0][0]) + n[1] * (p[k][1] - q[0][1]) + n[2] * (p[k][2] - q[0][2]);
+  }
+  return
+    (d[0] > limit && d[1] > limit && d[2] > limit) ||
+    (d[0] < -limit && d[1] < -limit && d[2] < -limit);
+}
+
+// Separating axis test of a triangle against an axis-aligned box
+// given by its center and half size.
+static SbBool
+sbtri3f_box_overlap(const SbVec3f * t, const SbVec3f & center, const SbVec3f & h)
+{
+  const SbVec3f v[3] = { t[0] - center, t[1] - center, t[2] - center };
+  int i;
+  // the face normals of the box
+  for (i = 0; i < 3; i++) {
+    if (SbMin(v[0][i], SbMin(v[1][i], v[2][i])) > h[i]) return FALSE;
+    if (SbMax(v[0][i], SbMax(v[1][i], v[2][i])) < -h[i]) return FALSE;
+  }
+  // the cross products of the triangle edges and the box axes
+  const SbVec3f e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+  for (int k = 0; k < 3; k++) {
+    const SbVec3f ae(float(fabs(e[k][0])), float(fabs(e[k][1])), float(fabs(e[k][2])));
+    const SbVec3f p0 = v[0].cross(e[k]);
+    const SbVec3f p1 = v[1].cross(e[k]);
+    const SbVec3f p2 = v[2].cross(e[k]);
+    for (i = 0; i < 3; i++) {
+      const int j = (i + 1) % 3;
+      const int l = (i + 2) % 3;
+      const float r = h[j] * ae[l] + h[l] * ae[j];
+      if (SbMin(p0[i], SbMin(p1[i], p2[i])) > r) return FALSE;
+      if (SbMax(p0[i], SbMax(p1[i], p2[i])) < -r) return FALSE;
+    }
+  }
+  // the plane of the triangle
+  const SbVec3f n = e[0].cross(e[1]);
+  const float d = n[0] * v[0][0] + n[1] * v[0][1] + n[2] * v[0][2];
+  const float r = h[0] * float(fabs(n[0])) + h[1] * float(fabs(n[1])) + h[2] * float(fabs(n[2]));
+  return float(fabs(d)) <= r;
+}
+
+#ifdef COIN_HAVE_X86_SIMD
+
+static COIN_TARGET_SSE2 inline __m128
+sbtri3f_load(const SbVec3f & v)
+{
+  return _mm_setr_ps(v[0], v[1], v[2], 0.0f);
+}
+
+static COIN_TARGET_SSE2 inline __m128
+sbtri3f_yzx(const __m128 v)
+{
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static COIN_TARGET_SSE2 inline __m128
+sbtri3f_zxy(const __m128 v)
+{
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 2));
+}
+
+static COIN_TARGET_SSE2 inline __m128
+sbtri3f_cross(const __m128 u, const __m128 v)
+{
+  return _mm_sub_ps(_mm_mul_ps(sbtri3f_yzx(u), sbtri3f_zxy(v)),
+                    _mm_mul_ps(sbtri3f_zxy(u), sbtri3f_yzx(v)));
+}
+
+static COIN_TARGET_SSE2 inline __m128
+sbtri3f_abs(const __m128 v)
+{
+  return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// The vertices are loaded one coordinate per register, so the three
+// distances are found at the same time.
+static COIN_TARGET_SSE2 SbBool
+sbtri3f_plane_separated_sse2(const SbVec3f * p, const SbVec3f * q, const float margin)
+{
+  const SbVec3f n = (q[1] - q[0]).cross(q[2] - q[0]);
+  const __m128 x = _mm_setr_ps(p[0][0], p[1][0], p[2][0], q[0][0]);
+  const __m128 y = _mm_setr_ps(p[0][1], p[1][1], p[2][1], q[1][0]);
+  const __m128 z = _mm_setr_ps(p[0][2], p[1][2], p[2][2], q[2][0]);
+  const __m128 qy = _mm_setr_ps(q[0][1], q[1][1], q[2][1], 0.0f);
+  const __m128 qz = _mm_setr_ps(q[0][2], q[1][2], q[2][2], 0.0f);
+
+  __m128 m = _mm_max_ps(sbtri3f_abs(x), _mm_max_ps(sbtri3f_abs(y), sbtri3f_abs(z)));
+  m = _mm_max_ps(m, _mm_max_ps(sbtri3f_abs(qy), sbtri3f_abs(qz)));
+  m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+  const float scale = _mm_cvtss_f32(m);
+
+  const float nlen = float(fabs(n[0])) + float(fabs(n[1])) + float(fabs(n[2]));
+  const __m128 limit = _mm_set1_ps(nlen * (margin + 1.0e-5f * scale));
+  const __m128 d =
+    _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n[0]), _mm_sub_ps(x, _mm_set1_ps(q[0][0]))),
+                          _mm_mul_ps(_mm_set1_ps(n[1]), _mm_sub_ps(y, _mm_set1_ps(q[0][1])))),
+               _mm_mul_ps(_mm_set1_ps(n[2]), _mm_sub_ps(z, _mm_set1_ps(q[0][2]))));
+  const int above = _mm_movemask_ps(_mm_cmpgt_ps(d, limit)) & 7;
+  const int below = _mm_movemask_ps(_mm_cmplt_ps(d, _mm_sub_ps(_mm_setzero_ps(), limit))) & 7;
+  return (above == 7) || (below == 7);
+}
+
+static COIN_TARGET_SSE2 SbBool
+sbtri3f_box_overlap_sse2(const SbVec3f * t, const SbVec3f & center, const SbVec3f & halfsize)
+{
+  const __m128 c = sbtri3f_load(center);
+  const __m128 h = sbtri3f_load(halfsize);
+  const __m128 negh = _mm_sub_ps(_mm_setzero_ps(), h);
+  const __m128 v0 = _mm_sub_ps(sbtri3f_load(t[0]), c);
+  const __m128 v1 = _mm_sub_ps(sbtri3f_load(t[1]), c);
+  const __m128 v2 = _mm_sub_ps(sbtri3f_load(t[2]), c);
+
+  // the face normals of the box
+  __m128 sep = _mm_or_ps(_mm_cmpgt_ps(_mm_min_ps(v0, _mm_min_ps(v1, v2)), h),
+                         _mm_cmplt_ps(_mm_max_ps(v0, _mm_max_ps(v1, v2)), negh));
+  if (_mm_movemask_ps(sep) & 7) return FALSE;
+
+  // the cross products of the triangle edges and the box axes, one
+  // edge at a time
+  const __m128 e[3] = { _mm_sub_ps(v1, v0), _mm_sub_ps(v2, v1), _mm_sub_ps(v0, v2) };
+  for (int k = 0; k < 3; k++) {
+    const __m128 ae = sbtri3f_abs(e[k]);
+    const __m128 r = _mm_add_ps(_mm_mul_ps(sbtri3f_yzx(h), sbtri3f_zxy(ae)),
+                                _mm_mul_ps(sbtri3f_zxy(h), sbtri3f_yzx(ae)));
+    const __m128 p0 = sbtri3f_cross(v0, e[k]);
+    const __m128 p1 = sbtri3f_cross(v1, e[k]);
+    const __m128 p2 = sbtri3f_cross(v2, e[k]);
+    sep = _mm_or_ps(sep, _mm_cmpgt_ps(_mm_min_ps(p0, _mm_min_ps(p1, p2)), r));
+    sep = _mm_or_ps(sep, _mm_cmplt_ps(_mm_max_ps(p0, _mm_max_ps(p1, p2)),
+                                      _mm_sub_ps(_mm_setzero_ps(), r)));
+  }
+  if (_mm_movemask_ps(sep) & 7) return FALSE;
+
+  // the plane of the triangle
+  const __m128 n = sbtri3f_cross(e[0], e[1]);
+  float d[4], r[4];
+  _mm_storeu_ps(d, _mm_mul_ps(n, v0));
+  _mm_storeu_ps(r, _mm_mul_ps(h, sbtri3f_abs(n)));
+  return float(fabs(d[0] + d[1] + d[2])) <= r[0] + r[1] + r[2];
+}
+
+#endif // COIN_HAVE_X86_SIMD
+
+static SbBool
+sbtri3f_separated(const SbVec3f * t1, const SbVec3f * t2, const float margin)
+{
+#ifdef COIN_HAVE_X86_SIMD
+  if (coin_runtime_simd() >= COIN_SIMD_SSE2) {
+    return
+      sbtri3f_plane_separated_sse2(t1, t2, margin) ||
+      sbtri3f_plane_separated_sse2(t2, t1, margin);
+  }
+#endif // COIN_HAVE_X86_SIMD
+  return
+    sbtri3f_plane_separated(t1, t2, margin) ||
+    sbtri3f_plane_separated(t2, t1, margin);
+}
+
+// *************************************************************************
+
 SbBool
 SbTri3f::intersect(const SbTri3f & t) const
 {
+  const SbVec3f t1[3] = { this->a, this->b, this->c };
+  const SbVec3f t2[3] = { t.a, t.b, t.c };
+  if (sbtri3f_separated(t1, t2, 0.0f)) return FALSE;
+
   // FIXME: remove all "programming logic" error messages and asserts from
   // this function when it's verified that those paths can't be taken.
 
-  SbVec3f a1(PRIVATE(this)->a);
-  SbVec3f b1(PRIVATE(this)->b);
-  SbVec3f c1(PRIVATE(this)->c);
+  SbVec3f a1(this->a);
+  SbVec3f b1(this->b);
+  SbVec3f c1(this->c);
   SbPlane plane1(a1, b1, c1);
 
-  SbVec3f a2(PRIVATE(&t)->a);
-  SbVec3f b2(PRIVATE(&t)->b);
-  SbVec3f c2(PRIVATE(&t)->c);
+  SbVec3f a2(t.a);
+  SbVec3f b2(t.b);
+  SbVec3f c2(t.c);
   SbPlane plane2(a2, b2, c2);
 
   // FIXME: can ((n1 == -n2) && (d1 == -d2)) really happen?
@@ -408,10 +579,34 @@ SbBool
 SbTri3f::intersect(const SbTri3f & t, float e) const
 {
   if (e == 0.0f) return this->intersect(t);
+  const SbVec3f t1[3] = { this->a, this->b, this->c };
+  const SbVec3f t2[3] = { t.a, t.b, t.c };
+  if (sbtri3f_separated(t1, t2, e)) return FALSE;
   if (this->getDistance(t) <= e) return TRUE;
   return FALSE;
 }
 
+/*!
+  Returns TRUE if the triangle intersects the given box, or is inside
+  it. An empty box never intersects anything.
+
+  \since Coin 4.0
+*/
+SbBool
+SbTri3f::intersect(const SbBox3f & box) const
+{
+  if (box.isEmpty()) return FALSE;
+  const SbVec3f center = box.getCenter();
+  const SbVec3f halfsize = (box.getMax() - box.getMin()) * 0.5f;
+  const SbVec3f t[3] = { this->a, this->b, this->c };
+#ifdef COIN_HAVE_X86_SIMD
+  if (coin_runtime_simd() >= COIN_SIMD_SSE2) {
+    return sbtri3f_box_overlap_sse2(t, center, halfsize);
+  }
+#endif // COIN_HAVE_X86_SIMD
+  return sbtri3f_box_overlap(t, center, halfsize);
+}
+
 SbVec3f
 SbTri3f::getNormal() const
 {
@@ -485,9 +680,9 @@ static const float gs_fTolerance = 1e-06f;
 float 
 SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
 {
-  SbVec3f kDiff = PRIVATE(this)->a - p1;
-  SbVec3f edge0 = PRIVATE(this)->b - PRIVATE(this)->a;
-  SbVec3f edge1 = PRIVATE(this)->c - PRIVATE(this)->a;
+  SbVec3f kDiff = this->a - p1;
+  SbVec3f edge0 = this->b - this->a;
+  SbVec3f edge1 = this->c - this->a;
   float fA00 = (p2-p1).sqrLength();
   float fA01 = -(p2-p1).dot(edge0);
   float fA02 = -(p2-p1).dot(edge1);
@@ -529,11 +724,11 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
           if (fT < 0.0f) {  // region 4m
             // min on face s=0 or t=0 or r=0
             fSqrDist = SbTri3f::sqrDistance(p1, p2, 
-                                          PRIVATE(this)->a, PRIVATE(this)->c,
+                                          this->a, this->c,
                                           &fR,&fT);
             fS = 0.0f;
             fSqrDist0 = SbTri3f::sqrDistance(p1, p2, 
-                                           PRIVATE(this)->a, PRIVATE(this)->b,
+                                           this->a, this->b,
                                            &fR0,&fS0);
             fT0 = 0.0f;
             if (fSqrDist0 < fSqrDist) {
@@ -553,7 +748,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
           }
           else {  // region 3m
             // min on face s=0 or r=0
-            fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+            fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
             fS = 0.0f;
             fSqrDist0 = this->sqrDistance(p1,&fS0,&fT0);
             fR0 = 0.0f;
@@ -568,7 +763,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         else if (fT < 0.0f) {  // region 5m
           // min on face t=0 or r=0
           fSqrDist = SbTri3f::sqrDistance(p1, p2, 
-                                        PRIVATE(this)->a, PRIVATE(this)->b,
+                                        this->a, this->b,
                                         &fR,&fS);
           fT = 0.0f;
           fSqrDist0 = this->sqrDistance(p1,&fS0,&fT0);
@@ -589,9 +784,9 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
       else {
         if (fS < 0.0f) {  // region 2m
           // min on face s=0 or s+t=1 or r=0
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
           fS = 0.0f;
-          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
           fS0 = 1.0f-fT0;
           if (fSqrDist0 < fSqrDist) {
             fSqrDist = fSqrDist0;
@@ -611,10 +806,10 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         else if (fT < 0.0f) {  // region 6m
           // min on face t=0 or s+t=1 or r=0
           fSqrDist = SbTri3f::sqrDistance(p1, p2, 
-                                        PRIVATE(this)->a, PRIVATE(this)->b,
+                                        this->a, this->b,
                                         &fR,&fS);
           fT = 0.0f;
-          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
           fS0 = 1.0f-fT0;
           if (fSqrDist0 < fSqrDist) {
             fSqrDist = fSqrDist0;
@@ -633,7 +828,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         }
         else {  // region 1m
           // min on face s+t=1 or r=0
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR,&fT);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR,&fT);
           fS = 1.0f-fT;
           fSqrDist0 = this->sqrDistance(p1,&fS0,&fT0);
           fR0 = 0.0f;
@@ -651,10 +846,10 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         if (fS < 0.0f) {
           if (fT < 0.0f) {  // region 4
             // min on face s=0 or t=0
-            fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+            fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
             fS = 0.0f;
             fSqrDist0 = SbTri3f::sqrDistance(p1, p2, 
-                                           PRIVATE(this)->a, PRIVATE(this)->b,
+                                           this->a, this->b,
                                            &fR0,&fS0);
             fT0 = 0.0f;
             if (fSqrDist0 < fSqrDist) {
@@ -666,13 +861,13 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
           }
           else {  // region 3
             // min on face s=0
-            fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+            fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
             fS = 0.0f;
           }
         }
         else if (fT < 0.0f) {  // region 5
           // min on face t=0
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->b,&fR,&fS);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->b,&fR,&fS);
           fT = 0.0f;
         }
         else {  // region 0
@@ -683,9 +878,9 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
       else {
         if (fS < 0.0f) {  // region 2
           // min on face s=0 or s+t=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
           fS = 0.0f;
-          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
           fS0 = 1.0f-fT0;
           if (fSqrDist0 < fSqrDist) {
             fSqrDist = fSqrDist0;
@@ -696,9 +891,9 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         }
         else if (fT < 0.0f) {  // region 6
           // min on face t=0 or s+t=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->b,&fR,&fS);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->b,&fR,&fS);
           fT = 0.0f;
-          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
           fS0 = 1.0f-fT0;
           if (fSqrDist0 < fSqrDist) {
             fSqrDist = fSqrDist0;
@@ -709,7 +904,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         }
         else {  // region 1
           // min on face s+t=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR,&fT);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR,&fT);
           fS = 1.0f-fT;
         }
       }
@@ -719,9 +914,9 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         if (fS < 0.0f) {
           if (fT < 0.0f) {  // region 4p
             // min on face s=0 or t=0 or r=1
-            fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+            fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
             fS = 0.0f;
-            fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->b,&fR0,&fS0);
+            fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->a, this->b,&fR0,&fS0);
             fT0 = 0.0f;
             if (fSqrDist0 < fSqrDist) {
               fSqrDist = fSqrDist0;
@@ -740,7 +935,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
           }
           else {  // region 3p
             // min on face s=0 or r=1
-            fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+            fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
             fS = 0.0f;
             fSqrDist0 = this->sqrDistance(p2,&fS0,&fT0);
             fR0 = 1.0f;
@@ -754,7 +949,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         }
         else if (fT < 0.0f) {  // region 5p
           // min on face t=0 or r=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->b,&fR,&fS);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->b,&fR,&fS);
           fT = 0.0f;
           fSqrDist0 = this->sqrDistance(p2,&fS0,&fT0);
           fR0 = 1.0f;
@@ -774,9 +969,9 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
       else {
         if (fS < 0.0f) {  // region 2p
           // min on face s=0 or s+t=1 or r=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR,&fT);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR,&fT);
           fS = 0.0f;
-          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
           fS0 = 1.0f-fT0;
           if (fSqrDist0 < fSqrDist) {
             fSqrDist = fSqrDist0;
@@ -795,9 +990,9 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         }
         else if (fT < 0.0f) {  // region 6p
           // min on face t=0 or s+t=1 or r=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->b,&fR,&fS);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->b,&fR,&fS);
           fT = 0.0f;
-          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+          fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
           fS0 = 1.0f-fT0;
           if (fSqrDist0 < fSqrDist) {
             fSqrDist = fSqrDist0;
@@ -816,7 +1011,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
         }
         else {  // region 1p
           // min on face s+t=1 or r=1
-          fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR,&fT);
+          fSqrDist = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR,&fT);
           fS = 1.0f-fT;
           fSqrDist0 = this->sqrDistance(p2,&fS0,&fT0);
           fR0 = 1.0f;
@@ -832,10 +1027,10 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
   }
   else {
     // segment and triangle are parallel
-    fSqrDist = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->b,&fR,&fS);
+    fSqrDist = SbTri3f::sqrDistance(p1, p2, this->a, this->b,&fR,&fS);
     fT = 0.0f;
 
-    fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->a, PRIVATE(this)->c,&fR0,&fT0);
+    fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->a, this->c,&fR0,&fT0);
     fS0 = 0.0f;
     if (fSqrDist0 < fSqrDist) {
       fSqrDist = fSqrDist0;
@@ -844,7 +1039,7 @@ SbTri3f::getDistance(const SbVec3f & p1, const SbVec3f & p2) const
       fT = fT0;
     }
 
-    fSqrDist0 = SbTri3f::sqrDistance(p1, p2, PRIVATE(this)->b, PRIVATE(this)->c,&fR0,&fT0);
+    fSqrDist0 = SbTri3f::sqrDistance(p1, p2, this->b, this->c,&fR0,&fT0);
     fS0 = 1.0f-fT0;
     if (fSqrDist0 < fSqrDist) {
       fSqrDist = fSqrDist0;
@@ -1269,9 +1464,9 @@ float
 SbTri3f::sqrDistance (const SbVec3f & p1, 
                     float * pfSParam, float * pfTParam) const
 {
-  SbVec3f kDiff = PRIVATE(this)->a - p1;
-  SbVec3f edge0 = PRIVATE(this)->b - PRIVATE(this)->a;
-  SbVec3f edge1 = PRIVATE(this)->c - PRIVATE(this)->a;
+  SbVec3f kDiff = this->a - p1;
+  SbVec3f edge0 = this->b - this->a;
+  SbVec3f edge1 = this->c - this->a;
   float fA00 = edge0.sqrLength();
   float fA01 = edge0.dot(edge1);
   float fA11 = edge1.sqrLength();
@@ -1510,13 +1705,178 @@ SbTri3f::getBoundingBox(void) const
   // probably be optimized simply by expanding the code. 20030328 mortene.
 
   SbBox3f b;
-  b.extendBy(PRIVATE(this)->a);
-  b.extendBy(PRIVATE(this)->b);
-  b.extendBy(PRIVATE(this)->c);
+  b.extendBy(this->a);
+  b.extendBy(this->b);
+  b.extendBy(this->c);
   return b;
 }
 
 // *************************************************************************
 
+// Finds the closest points of the segments p1-q1 and p2-q2, and
+// returns the squared distance between them. From "Real-Time
+// Collision Detection" by Christer Ericson.
+static float
+sbtri3f_segment_closest(const SbVec3f & p1, const SbVec3f & q1,
+                        const SbVec3f & p2, const SbVec3f & q2,
+                        SbVec3f & c1, SbVec3f & c2)
+{
+  const SbVec3f d1 = q1 - p1;
+  const SbVec3f d2 = q2 - p2;
+  const SbVec3f r = p1 - p2;
+  const float a = d1.dot(d1);
+  const float e = d2.dot(d2);
+  const float f = d2.dot(r);
+  float s, t;
+  if (a <= FLT_EPSILON && e <= FLT_EPSILON) {
+    s = t = 0.0f;
+  }
+  else if (a <= FLT_EPSILON) {
+    s = 0.0f;
+    t = SbClamp(f / e, 0.0f, 1.0f);
+  }
+  else {
+    const float c = d1.dot(r);
+    if (e <= FLT_EPSILON) {
+      t = 0.0f;
+      s = SbClamp(-c / a, 0.0f, 1.0f);
+    }
+    else {
+      const float b = d1.dot(d2);
+      const float denom = a * e - b * b;
+      s = (denom != 0.0f) ? SbClamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+      t = (b * s + f) / e;
+      if (t < 0.0f) {
+        t = 0.0f;
+        s = SbClamp(-c / a, 0.0f, 1.0f);
+      }
+      else if (t > 1.0f) {
+        t = 1.0f;
+        s = SbClamp((b - c) / a, 0.0f, 1.0f);
+      }
+    }
+  }
+  c1 = p1 + d1 * s;
+  c2 = p2 + d2 * t;
+  return (c1 - c2).sqrLength();
+}
+
+// Returns TRUE if the segment p-q crosses the triangle t, and the
+// crossing point in x. Segments in the plane of the triangle are not
+// counted, as those cases are covered by the edge-edge and
+// vertex-triangle tests in getClosestPoints().
+static SbBool
+sbtri3f_segment_crossing(const SbVec3f & p, const SbVec3f & q,
+                         const SbVec3f * t, SbVec3f & x)
+{
+  const SbVec3f n = (t[1] - t[0]).cross(t[2] - t[0]);
+  const float dp = n.dot(p - t[0]);
+  const float dq = n.dot(q - t[0]);
+  if ((dp > 0.0f && dq > 0.0f) || (dp < 0.0f && dq < 0.0f) || dp == dq) return FALSE;
+  x = p + (q - p) * (dp / (dp - dq));
+  for (int i = 0; i < 3; i++) {
+    const SbVec3f & v0 = t[i];
+    const SbVec3f & v1 = t[(i + 1) % 3];
+    if (n.dot((v1 - v0).cross(x - v0)) < 0.0f) return FALSE;
+  }
+  return TRUE;
+}
+
+/*!
+  Returns the point on the triangle closest to \a p.
+
+  \since Coin 4.0
+*/
+SbVec3f
+SbTri3f::getClosestPoint(const SbVec3f & p) const
+{
+  // Finds the Voronoi region of the triangle p is in, from "Real-Time
+  // Collision Detection" by Christer Ericson.
+  const SbVec3f ab = this->b - this->a;
+  const SbVec3f ac = this->c - this->a;
+  const SbVec3f ap = p - this->a;
+  const float d1 = ab.dot(ap);
+  const float d2 = ac.dot(ap);
+  if (d1 <= 0.0f && d2 <= 0.0f) return this->a;
+
+  const SbVec3f bp = p - this->b;
+  const float d3 = ab.dot(bp);
+  const float d4 = ac.dot(bp);
+  if (d3 >= 0.0f && d4 <= d3) return this->b;
+
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+    return this->a + ab * (d1 / (d1 - d3));
+  }
+
+  const SbVec3f cp = p - this->c;
+  const float d5 = ab.dot(cp);
+  const float d6 = ac.dot(cp);
+  if (d6 >= 0.0f && d5 <= d6) return this->c;
+
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+    return this->a + ac * (d2 / (d2 - d6));
+  }
+
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+    return this->b + (this->c - this->b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  }
+
+  const float sum = va + vb + vc;
+  if (sum == 0.0f) return this->a; // degenerate triangle
+  return this->a + ab * (vb / sum) + ac * (vc / sum);
+}
+
+/*!
+  Finds the closest points of this triangle and \a t, and returns the
+  distance between them. The point on this triangle is returned in \a
+  p1, and the point on \a t in \a p2. If the triangles intersect, the
+  distance is 0 and both points are set to a point on both triangles.
+
+  \since Coin 4.0
+*/
+float
+SbTri3f::getClosestPoints(const SbTri3f & t, SbVec3f & p1, SbVec3f & p2) const
+{
+  const SbVec3f t1[3] = { this->a, this->b, this->c };
+  const SbVec3f t2[3] = { t.a, t.b, t.c };
+  int i, j;
+
+  // if the triangles intersect, an edge of one of them crosses the
+  // other, unless they are in the same plane
+  SbVec3f x;
+  for (i = 0; i < 3; i++) {
+    if (sbtri3f_segment_crossing(t1[i], t1[(i + 1) % 3], t2, x) ||
+        sbtri3f_segment_crossing(t2[i], t2[(i + 1) % 3], t1, x)) {
+      p1 = p2 = x;
+      return 0.0f;
+    }
+  }
+
+  // otherwise the closest points are a vertex and a point on the
+  // other triangle, or on a pair of edges
+  float best = FLT_MAX;
+  SbVec3f c1, c2;
+  for (i = 0; i < 3; i++) {
+    c2 = t.getClosestPoint(t1[i]);
+    float d = (t1[i] - c2).sqrLength();
+    if (d < best) { best = d; p1 = t1[i]; p2 = c2; }
+    c1 = this->getClosestPoint(t2[i]);
+    d = (t2[i] - c1).sqrLength();
+    if (d < best) { best = d; p1 = c1; p2 = t2[i]; }
+  }
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 3; j++) {
+      const float d = sbtri3f_segment_closest(t1[i], t1[(i + 1) % 3],
+                                              t2[j], t2[(j + 1) % 3], c1, c2);
+      if (d < best) { best = d; p1 = c1; p2 = c2; }
+    }
+  }
+  return float(sqrt(best));
+}
+
+// *************************************************************************
+
 #undef SBTRI_DEBUG
-#undef PRIVATE
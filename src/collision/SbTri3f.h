@@ -27,8 +27,6 @@
 #include <Inventor/SbVec3f.h>
 #include <Inventor/SbBox3f.h>
 
-class SbTri3fP;
-
 class SbTri3f {
 public:
   SbTri3f(void);
@@ -56,13 +54,17 @@ public:
 
   SbBool intersect(const SbTri3f & triangle) const;
   SbBool intersect(const SbTri3f & triangle, float epsilon) const;
+  SbBool intersect(const SbBox3f & box) const;
 
   const SbBox3f getBoundingBox(void) const;
 
+  SbVec3f getClosestPoint(const SbVec3f & p) const;
+  float getClosestPoints(const SbTri3f & t, SbVec3f & p1, SbVec3f & p2) const;
+
 private:
-  // FIXME: get rid of this -- a triangle is too simple a class to
-  // have a private implementation. 20030328 mortene.
-  SbTri3fP * const pimpl;
+  SbVec3f a;
+  SbVec3f b;
+  SbVec3f c;
 };
 
 #endif // !COIN_SBTRI3F_H
@@ -0,0 +1,959 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SoDistanceAction Inventor/collision/SoDistanceAction.h
+  \brief The SoDistanceAction class is for finding distances between shapes in a scene.
+
+  The action answers three kinds of queries, selected with setQuery():
+
+  - CLOSEST_PAIR finds the two shapes closest to each other, and the
+    closest points on them. This gives the minimum clearance of the
+    scene.
+
+  - ALL_PAIRS finds every pair of shapes closer to each other than
+    the maximum distance set with setMaxDistance(), and the closest
+    points of each pair. This is for clearance checks against a
+    required minimum distance.
+
+  - NEAREST finds the shapes closest to the point set with
+    setPoint(). The number of shapes to find is set with
+    setNumNearest().
+
+  When the action is applied to a node or a path, the distances
+  between all shapes found are considered. When applied to a path
+  list, only the distances between shapes under different paths of
+  the list are considered. The minimum distance between two subgraphs
+  is therefore found by applying the action to a list of two paths:
+
+  \code
+  SoPathList paths;
+  paths.append(path1);
+  paths.append(path2);
+
+  SoDistanceAction da;
+  da.apply(paths);
+  if (da.getNumResults() > 0) {
+    const SoDistanceResult * r = da.getResult(0);
+    (void)fprintf(stdout, "clearance is %g, between (%g, %g, %g) and (%g, %g, %g)\n",
+                  r->distance,
+                  r->point[0][0], r->point[0][1], r->point[0][2],
+                  r->point[1][0], r->point[1][1], r->point[1][2]);
+  }
+  \endcode
+
+  Distances are measured between the triangles generated by the
+  shapes, in world space. Like for SoIntersectionDetectionAction,
+  lines and points are not considered.
+
+  The bounding boxes of the shapes are kept in a bounding volume
+  hierarchy, which is searched closest first. Shape pairs whose
+  bounding boxes are farther apart than the best distance found so
+  far (or the maximum distance) are never looked at, and the
+  triangles of a shape are only generated when the shape is close
+  enough to matter. The triangles of each shape are kept in a
+  hierarchy of their own, searched the same way, so only a small part
+  of the triangle pairs are tested.
+
+  \ingroup actions
+  \since Coin 4.0
+*/
+
+/*!
+  \struct SoDistanceResult SoDistanceAction.h Inventor/collision/SoDistanceAction.h
+  \brief The SoDistanceResult struct holds a distance found by SoDistanceAction.
+
+  For shape pairs, \c path holds the paths to the two shapes, in
+  traversal order, and \c point holds the closest points on them. For
+  NEAREST queries, \c path[1] is \c NULL and \c point[1] is the query
+  point. The points are in world space.
+
+  \ingroup actions
+  \since Coin 4.0
+*/
+
+/*!
+  \enum SoDistanceAction::Query
+  The kinds of distance queries, see setQuery().
+*/
+
+/*!
+  \var SoDistanceAction::Query SoDistanceAction::CLOSEST_PAIR
+  Find the closest pair of shapes.
+*/
+
+/*!
+  \var SoDistanceAction::Query SoDistanceAction::ALL_PAIRS
+  Find all pairs of shapes within the maximum distance.
+*/
+
+/*!
+  \var SoDistanceAction::Query SoDistanceAction::NEAREST
+  Find the shapes closest to a point.
+*/
+
+// *************************************************************************
+
+#include <Inventor/collision/SoDistanceAction.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/caches/SoBoundingBoxCache.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/nodes/SoShape.h>
+
+#include "actions/SoSubActionP.h"
+#include "collision/SbBoxTree.h"
+#include "collision/SbTri3f.h"
+#include "coindefs.h"
+#include "SbBasicP.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstdlib>
+#include <queue>
+#include <vector>
+
+// *************************************************************************
+
+static SbBool
+distance_debug(void)
+{
+  static int dbg = -1;
+  if (dbg == -1) {
+    const char * env = coin_getenv("COIN_DEBUG_DISTANCEACTION");
+    dbg = env && atoi(env) > 0;
+  }
+  return dbg == 0 ? FALSE : TRUE;
+}
+
+// Returns the squared distance between two boxes, 0 if they overlap.
+static float
+box_sqr_distance(const SbBox3f & b1, const SbBox3f & b2)
+{
+  const SbVec3f & min1 = b1.getMin();
+  const SbVec3f & max1 = b1.getMax();
+  const SbVec3f & min2 = b2.getMin();
+  const SbVec3f & max2 = b2.getMax();
+  float d = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    float gap = 0.0f;
+    if (min1[i] > max2[i]) gap = min1[i] - max2[i];
+    else if (min2[i] > max1[i]) gap = min2[i] - max1[i];
+    d += gap * gap;
+  }
+  return d;
+}
+
+// Returns the squared distance from a point to a box, 0 if inside.
+static float
+point_box_sqr_distance(const SbVec3f & p, const SbBox3f & box)
+{
+  const SbVec3f & min = box.getMin();
+  const SbVec3f & max = box.getMax();
+  float d = 0.0f;
+  for (int i = 0; i < 3; i++) {
+    float gap = 0.0f;
+    if (p[i] < min[i]) gap = min[i] - p[i];
+    else if (p[i] > max[i]) gap = p[i] - max[i];
+    d += gap * gap;
+  }
+  return d;
+}
+
+// Half the surface area of a box, used for picking which of two
+// nodes to descend into.
+static float
+box_area(const SbBox3f & box)
+{
+  const SbVec3f d = box.getMax() - box.getMin();
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+// A pair of tree nodes, or a node and a point, waiting to be visited,
+// with the lower bound of the squared distance between them.
+struct DistanceCandidate {
+  DistanceCandidate(const float d, const int a, const int b)
+    : sqrdist(d), node1(a), node2(b) { }
+  float sqrdist;
+  int node1;
+  int node2;
+};
+
+// Ordering for the priority queues, which put the closest candidate
+// on top.
+struct distance_candidate_farther {
+  bool operator()(const DistanceCandidate & a, const DistanceCandidate & b) const {
+    return a.sqrdist > b.sqrdist;
+  }
+};
+
+typedef std::priority_queue<DistanceCandidate, std::vector<DistanceCandidate>,
+                            distance_candidate_farther> DistanceQueue;
+
+// *************************************************************************
+
+// A shape found when traversing the scene. The triangles are
+// generated, in world space, when first needed.
+class DistanceShape {
+public:
+  DistanceShape(SoPath * p, const SbBox3f & b, const int g)
+    : path(p), box(b), group(g), tree(NULL)
+  {
+    this->path->ref();
+  }
+
+  ~DistanceShape()
+  {
+    delete this->tree;
+    this->path->unref();
+  }
+
+  // Returns the bounding volume hierarchy of the triangles. Leaf i
+  // of the tree is triangle i.
+  const SbBoxTree * getTree(void)
+  {
+    if (this->tree == NULL) {
+      SoCallbackAction generator;
+      generator.addTriangleCallback(SoShape::getClassTypeId(),
+                                    DistanceShape::triangleCB, this);
+      generator.apply(this->path);
+
+      const int num = this->triangles.getLength();
+      SbBox3f * boxes = new SbBox3f[num];
+      for (int i = 0; i < num; i++) { boxes[i] = this->triangles[i].getBoundingBox(); }
+      this->tree = new SbBoxTree;
+      this->tree->build(boxes, num);
+      delete[] boxes;
+    }
+    return this->tree;
+  }
+
+  SoPath * path;
+  SbBox3f box; // world space
+  int group;
+  SbList<SbTri3f> triangles;
+
+private:
+  static void triangleCB(void * closure, SoCallbackAction * action,
+                         const SoPrimitiveVertex * v1,
+                         const SoPrimitiveVertex * v2,
+                         const SoPrimitiveVertex * v3)
+  {
+    DistanceShape * thisp = static_cast<DistanceShape *>(closure);
+    const SbMatrix & m = action->getModelMatrix();
+    SbVec3f a, b, c;
+    m.multVecMatrix(v1->getPoint(), a);
+    m.multVecMatrix(v2->getPoint(), b);
+    m.multVecMatrix(v3->getPoint(), c);
+    // SbTri3f doesn't handle triangles with coincident vertices, and
+    // their edges are usually shared with neighbouring triangles
+    if (a == b || a == c || b == c) return;
+    thisp->triangles.append(SbTri3f(a, b, c));
+  }
+
+  SbBoxTree * tree;
+};
+
+// *************************************************************************
+
+// A result, with the traversal order of the shapes for sorting.
+struct DistancePairResult {
+  SoDistanceResult result;
+  int index1;
+  int index2;
+};
+
+static bool
+distance_result_less(const DistancePairResult & a, const DistancePairResult & b)
+{
+  if (a.result.distance != b.result.distance) return a.result.distance < b.result.distance;
+  if (a.index1 != b.index1) return a.index1 < b.index1;
+  return a.index2 < b.index2;
+}
+
+class SoDistanceAction::PImpl {
+public:
+  PImpl(void);
+  ~PImpl();
+
+  void clear(void);
+  static SoCallbackAction::Response shapeCB(void * closure, SoCallbackAction * action, const SoNode * node);
+  float getBound(void) const;
+  void search(void);
+  void searchPairs(void);
+  void searchNearest(void);
+  SbBool shapeDistance(DistanceShape * shape1, DistanceShape * shape2,
+                       float & bound, SoDistanceResult & result);
+  SbBool pointDistance(DistanceShape * shape, float & bound, SoDistanceResult & result);
+
+  SoDistanceAction::Query query;
+  float maxdistance;
+  SbVec3f point;
+  int numnearest;
+
+  SoCallbackAction * traverser;
+  int group; // of the shapes being traversed, -1 for one per shape
+  SbList<DistanceShape *> shapes;
+  SbBoxTree shapetree;
+  std::vector<DistancePairResult> results;
+
+  // for debugging
+  unsigned int numshapepairs;
+  unsigned int numtrianglepairs;
+};
+
+SoDistanceAction::PImpl::PImpl(void)
+{
+  this->query = SoDistanceAction::CLOSEST_PAIR;
+  this->maxdistance = FLT_MAX;
+  this->point.setValue(0.0f, 0.0f, 0.0f);
+  this->numnearest = 1;
+  this->group = -1;
+  this->numshapepairs = 0;
+  this->numtrianglepairs = 0;
+  this->traverser = new SoCallbackAction;
+  this->traverser->addPreCallback(SoShape::getClassTypeId(), PImpl::shapeCB, this);
+}
+
+SoDistanceAction::PImpl::~PImpl()
+{
+  this->clear();
+  delete this->traverser;
+}
+
+// Throws away the shapes and results of the last apply().
+void
+SoDistanceAction::PImpl::clear(void)
+{
+  for (int i = 0; i < this->shapes.getLength(); i++) {
+    delete this->shapes[i];
+  }
+  this->shapes.truncate(0);
+  this->shapetree.clear();
+  this->results.clear();
+  this->numshapepairs = 0;
+  this->numtrianglepairs = 0;
+}
+
+SoCallbackAction::Response
+SoDistanceAction::PImpl::shapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
+{
+  PImpl * thisp = static_cast<PImpl *>(closure);
+  SoShape * shape = const_cast<SoShape *>(coin_assert_cast<const SoShape *>(node));
+  SoState * state = action->getState();
+
+  SbBox3f bbox;
+  SbVec3f center;
+  const SoBoundingBoxCache * bboxcache = shape->getBoundingBoxCache();
+  if (bboxcache && bboxcache->isValid(state)) {
+    bbox = bboxcache->getProjectedBox();
+  }
+  else {
+    shape->computeBBox(action, bbox, center);
+  }
+  if (bbox.isEmpty()) return SoCallbackAction::CONTINUE;
+  bbox.transform(action->getModelMatrix());
+
+  const int shapegroup = (thisp->group >= 0) ? thisp->group : thisp->shapes.getLength();
+  thisp->shapes.append(new DistanceShape(new SoPath(*action->getCurPath()), bbox, shapegroup));
+  return SoCallbackAction::CONTINUE;
+}
+
+// Returns the maximum squared distance to search within.
+float
+SoDistanceAction::PImpl::getBound(void) const
+{
+  if (this->maxdistance >= float(sqrt(FLT_MAX))) return FLT_MAX;
+  return this->maxdistance * this->maxdistance;
+}
+
+// Runs the query on the shapes found in the traversal.
+void
+SoDistanceAction::PImpl::search(void)
+{
+  const int numshapes = this->shapes.getLength();
+  SbBox3f * boxes = new SbBox3f[numshapes];
+  for (int i = 0; i < numshapes; i++) { boxes[i] = this->shapes[i]->box; }
+  this->shapetree.build(boxes, numshapes);
+  delete[] boxes;
+
+  if (this->query == SoDistanceAction::NEAREST) { this->searchNearest(); }
+  else { this->searchPairs(); }
+  std::sort(this->results.begin(), this->results.end(), distance_result_less);
+
+  if (distance_debug()) {
+    SoDebugError::postInfo("SoDistanceAction::PImpl::search",
+                           "%d shapes, %u shape pairs and %u triangle pairs "
+                           "tested, %d results",
+                           numshapes, this->numshapepairs, this->numtrianglepairs,
+                           static_cast<int>(this->results.size()));
+  }
+}
+
+// Finds the closest pair of shapes, or all pairs within the maximum
+// distance, by visiting pairs of shape tree nodes closest first.
+void
+SoDistanceAction::PImpl::searchPairs(void)
+{
+  const SbBool all = (this->query == SoDistanceAction::ALL_PAIRS);
+  const float maxbound = this->getBound();
+  float bound = maxbound;
+  SbBool found = FALSE;
+  const SbBoxTree & tree = this->shapetree;
+
+  DistanceQueue queue;
+  if (tree.getRoot() != -1) { queue.push(DistanceCandidate(0.0f, tree.getRoot(), tree.getRoot())); }
+  while (!queue.empty()) {
+    const DistanceCandidate c = queue.top();
+    queue.pop();
+    // all remaining candidates are at least as far away
+    if (c.sqrdist > bound || (found && !all && c.sqrdist >= bound)) break;
+
+    const int n1 = c.node1;
+    const int n2 = c.node2;
+    const int c1 = tree.getChild(n1, 0);
+    const int c2 = tree.getChild(n2, 0);
+
+    if (n1 == n2) {
+      // pairs within a subtree
+      if (c1 == -1) continue;
+      const int d1 = tree.getChild(n1, 1);
+      queue.push(DistanceCandidate(0.0f, c1, c1));
+      queue.push(DistanceCandidate(0.0f, d1, d1));
+      queue.push(DistanceCandidate(box_sqr_distance(tree.getBox(c1), tree.getBox(d1)), c1, d1));
+    }
+    else if (c1 == -1 && c2 == -1) {
+      // leaf i of the shape tree is shape i
+      const int i1 = SbMin(n1, n2);
+      const int i2 = SbMax(n1, n2);
+      DistanceShape * shape1 = this->shapes[i1];
+      DistanceShape * shape2 = this->shapes[i2];
+      if (shape1->group == shape2->group || *shape1->path == *shape2->path) continue;
+
+      DistancePairResult r;
+      float pairbound = all ? maxbound : bound;
+      if (this->shapeDistance(shape1, shape2, pairbound, r.result)) {
+        r.index1 = i1;
+        r.index2 = i2;
+        if (all) {
+          this->results.push_back(r);
+        }
+        else {
+          bound = pairbound;
+          found = TRUE;
+          this->results.clear();
+          this->results.push_back(r);
+        }
+      }
+    }
+    else {
+      // descend into the node with the largest box
+      const SbBool split1 =
+        (c2 == -1) || (c1 != -1 && box_area(tree.getBox(n1)) >= box_area(tree.getBox(n2)));
+      const int split = split1 ? n1 : n2;
+      const int other = split1 ? n2 : n1;
+      for (int k = 0; k < 2; k++) {
+        const int child = tree.getChild(split, k);
+        const float d = box_sqr_distance(tree.getBox(child), tree.getBox(other));
+        if (d <= bound) { queue.push(DistanceCandidate(d, child, other)); }
+      }
+    }
+  }
+}
+
+// Finds the shapes closest to the query point.
+void
+SoDistanceAction::PImpl::searchNearest(void)
+{
+  const float maxbound = this->getBound();
+  const size_t k = static_cast<size_t>(this->numnearest);
+  const SbBoxTree & tree = this->shapetree;
+
+  DistanceQueue queue;
+  if (tree.getRoot() != -1) {
+    queue.push(DistanceCandidate(point_box_sqr_distance(this->point, tree.getBox(tree.getRoot())),
+                                 tree.getRoot(), -1));
+  }
+  while (!queue.empty()) {
+    const DistanceCandidate c = queue.top();
+    queue.pop();
+    const SbBool full = (this->results.size() == k);
+    const float bound = full ?
+      this->results.back().result.distance * this->results.back().result.distance : maxbound;
+    if (c.sqrdist > bound || (full && c.sqrdist >= bound)) break;
+
+    const int child = tree.getChild(c.node1, 0);
+    if (child == -1) {
+      DistancePairResult r;
+      float shapebound = bound;
+      if (this->pointDistance(this->shapes[c.node1], shapebound, r.result)) {
+        r.index1 = c.node1;
+        r.index2 = -1;
+        // keep the k closest, sorted
+        std::vector<DistancePairResult>::iterator it =
+          std::upper_bound(this->results.begin(), this->results.end(), r, distance_result_less);
+        this->results.insert(it, r);
+        if (this->results.size() > k) { this->results.pop_back(); }
+      }
+    }
+    else {
+      for (int i = 0; i < 2; i++) {
+        const int n = tree.getChild(c.node1, i);
+        queue.push(DistanceCandidate(point_box_sqr_distance(this->point, tree.getBox(n)), n, -1));
+      }
+    }
+  }
+}
+
+// Finds the closest points of two shapes, if they are within the
+// squared distance bound. If so, bound is set to the squared
+// distance, and TRUE is returned.
+SbBool
+SoDistanceAction::PImpl::shapeDistance(DistanceShape * shape1, DistanceShape * shape2,
+                                       float & bound, SoDistanceResult & result)
+{
+  this->numshapepairs++;
+  const SbBoxTree * tree1 = shape1->getTree();
+  const SbBoxTree * tree2 = shape2->getTree();
+  if (tree1->getRoot() == -1 || tree2->getRoot() == -1) return FALSE;
+
+  SbBool found = FALSE;
+  // depth first, with the closest of two child pairs visited first
+  std::vector<DistanceCandidate> stack;
+  stack.push_back(DistanceCandidate(box_sqr_distance(tree1->getBox(tree1->getRoot()),
+                                                     tree2->getBox(tree2->getRoot())),
+                                    tree1->getRoot(), tree2->getRoot()));
+  while (!stack.empty()) {
+    const DistanceCandidate c = stack.back();
+    stack.pop_back();
+    if (c.sqrdist > bound || (found && c.sqrdist >= bound)) continue;
+
+    const int c1 = tree1->getChild(c.node1, 0);
+    const int c2 = tree2->getChild(c.node2, 0);
+    if (c1 == -1 && c2 == -1) {
+      this->numtrianglepairs++;
+      SbVec3f p1, p2;
+      const float d = shape1->triangles[c.node1].getClosestPoints(shape2->triangles[c.node2], p1, p2);
+      const float d2 = d * d;
+      if (d2 < bound || (!found && d2 <= bound)) {
+        bound = d2;
+        found = TRUE;
+        result.distance = d;
+        result.path[0] = shape1->path;
+        result.path[1] = shape2->path;
+        result.point[0] = p1;
+        result.point[1] = p2;
+      }
+      continue;
+    }
+
+    const SbBool split1 =
+      (c2 == -1) || (c1 != -1 && box_area(tree1->getBox(c.node1)) >= box_area(tree2->getBox(c.node2)));
+    DistanceCandidate next[2] = {
+      DistanceCandidate(0.0f, split1 ? c1 : c.node1, split1 ? c.node2 : c2),
+      DistanceCandidate(0.0f, split1 ? tree1->getChild(c.node1, 1) : c.node1,
+                        split1 ? c.node2 : tree2->getChild(c.node2, 1))
+    };
+    for (int i = 0; i < 2; i++) {
+      next[i].sqrdist = box_sqr_distance(tree1->getBox(next[i].node1), tree2->getBox(next[i].node2));
+    }
+    if (next[0].sqrdist < next[1].sqrdist) { std::swap(next[0], next[1]); }
+    for (int j = 0; j < 2; j++) {
+      if (next[j].sqrdist <= bound) { stack.push_back(next[j]); }
+    }
+  }
+  return found;
+}
+
+// Finds the point of a shape closest to the query point, if it is
+// within the squared distance bound. If so, bound is set to the
+// squared distance, and TRUE is returned.
+SbBool
+SoDistanceAction::PImpl::pointDistance(DistanceShape * shape, float & bound,
+                                       SoDistanceResult & result)
+{
+  this->numshapepairs++;
+  const SbBoxTree * tree = shape->getTree();
+  if (tree->getRoot() == -1) return FALSE;
+
+  SbBool found = FALSE;
+  std::vector<DistanceCandidate> stack;
+  stack.push_back(DistanceCandidate(point_box_sqr_distance(this->point, tree->getBox(tree->getRoot())),
+                                    tree->getRoot(), -1));
+  while (!stack.empty()) {
+    const DistanceCandidate c = stack.back();
+    stack.pop_back();
+    if (c.sqrdist > bound || (found && c.sqrdist >= bound)) continue;
+
+    const int child = tree->getChild(c.node1, 0);
+    if (child == -1) {
+      this->numtrianglepairs++;
+      const SbVec3f p = shape->triangles[c.node1].getClosestPoint(this->point);
+      const float d2 = (p - this->point).sqrLength();
+      if (d2 < bound || (!found && d2 <= bound)) {
+        bound = d2;
+        found = TRUE;
+        result.distance = float(sqrt(d2));
+        result.path[0] = shape->path;
+        result.path[1] = NULL;
+        result.point[0] = p;
+        result.point[1] = this->point;
+      }
+      continue;
+    }
+
+    DistanceCandidate next[2] = {
+      DistanceCandidate(0.0f, child, -1),
+      DistanceCandidate(0.0f, tree->getChild(c.node1, 1), -1)
+    };
+    for (int i = 0; i < 2; i++) {
+      next[i].sqrdist = point_box_sqr_distance(this->point, tree->getBox(next[i].node1));
+    }
+    if (next[0].sqrdist < next[1].sqrdist) { std::swap(next[0], next[1]); }
+    for (int j = 0; j < 2; j++) {
+      if (next[j].sqrdist <= bound) { stack.push_back(next[j]); }
+    }
+  }
+  return found;
+}
+
+// *************************************************************************
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+SO_ACTION_SOURCE(SoDistanceAction);
+
+// Override from parent class.
+void
+SoDistanceAction::initClass(void)
+{
+  SO_ACTION_INTERNAL_INIT_CLASS(SoDistanceAction, SoAction);
+}
+
+/*!
+  Constructor. The default query is CLOSEST_PAIR, without a maximum
+  distance.
+*/
+SoDistanceAction::SoDistanceAction(void)
+{
+  SO_ACTION_CONSTRUCTOR(SoDistanceAction);
+}
+
+/*!
+  Destructor.
+*/
+SoDistanceAction::~SoDistanceAction(void)
+{
+}
+
+/*!
+  Sets the kind of query to run when the action is applied.
+
+  \sa getQuery()
+*/
+void
+SoDistanceAction::setQuery(Query query)
+{
+  PRIVATE(this)->query = query;
+}
+
+/*!
+  Returns the kind of query run when the action is applied.
+
+  \sa setQuery()
+*/
+SoDistanceAction::Query
+SoDistanceAction::getQuery(void) const
+{
+  return PRIVATE(this)->query;
+}
+
+/*!
+  Sets the maximum distance to search within. Shapes farther apart
+  than this are not reported, and not looked at more closely than
+  their bounding boxes. For ALL_PAIRS queries, this is the clearance
+  to check against.
+
+  The default is \c FLT_MAX, which means no limit.
+
+  \sa getMaxDistance()
+*/
+void
+SoDistanceAction::setMaxDistance(float distance)
+{
+  assert(distance >= 0.0f);
+  PRIVATE(this)->maxdistance = distance;
+}
+
+/*!
+  Returns the maximum distance to search within.
+
+  \sa setMaxDistance()
+*/
+float
+SoDistanceAction::getMaxDistance(void) const
+{
+  return PRIVATE(this)->maxdistance;
+}
+
+/*!
+  Sets the world space point for NEAREST queries.
+
+  \sa setNumNearest(), getPoint()
+*/
+void
+SoDistanceAction::setPoint(const SbVec3f & point)
+{
+  PRIVATE(this)->point = point;
+}
+
+/*!
+  Returns the world space point for NEAREST queries.
+
+  \sa setPoint()
+*/
+const SbVec3f &
+SoDistanceAction::getPoint(void) const
+{
+  return PRIVATE(this)->point;
+}
+
+/*!
+  Sets the number of shapes NEAREST queries should find. The default
+  is 1.
+
+  \sa setPoint(), getNumNearest()
+*/
+void
+SoDistanceAction::setNumNearest(int num)
+{
+  assert(num > 0);
+  PRIVATE(this)->numnearest = num;
+}
+
+/*!
+  Returns the number of shapes NEAREST queries find.
+
+  \sa setNumNearest()
+*/
+int
+SoDistanceAction::getNumNearest(void) const
+{
+  return PRIVATE(this)->numnearest;
+}
+
+/*!
+  Runs the query on all the shapes in the scene graph rooted at \a node.
+*/
+void
+SoDistanceAction::apply(SoNode * node)
+{
+  PRIVATE(this)->clear();
+  PRIVATE(this)->group = -1;
+  PRIVATE(this)->traverser->apply(node);
+  PRIVATE(this)->search();
+}
+
+/*!
+  Runs the query on all the shapes in the subgraph at the end of \a
+  path.
+*/
+void
+SoDistanceAction::apply(SoPath * path)
+{
+  PRIVATE(this)->clear();
+  PRIVATE(this)->group = -1;
+  PRIVATE(this)->traverser->apply(path);
+  PRIVATE(this)->search();
+}
+
+/*!
+  Runs the query on the shapes under the paths in \a paths. For
+  CLOSEST_PAIR and ALL_PAIRS queries, only shapes under different
+  paths are paired.
+
+  The \a obeysRules argument is ignored, as each path is traversed by
+  itself.
+*/
+void
+SoDistanceAction::apply(const SoPathList & paths, SbBool COIN_UNUSED_ARG(obeysRules))
+{
+  PRIVATE(this)->clear();
+  for (int i = 0; i < paths.getLength(); i++) {
+    PRIVATE(this)->group = i;
+    PRIVATE(this)->traverser->apply(paths[i]);
+  }
+  PRIVATE(this)->search();
+}
+
+/*!
+  Returns the number of results from the last apply(). For
+  CLOSEST_PAIR queries, this is 1, or 0 if there are no shapes within
+  the maximum distance of each other.
+*/
+int
+SoDistanceAction::getNumResults(void) const
+{
+  return static_cast<int>(PRIVATE(this)->results.size());
+}
+
+/*!
+  Returns result number \a index from the last apply(). The results
+  are sorted on distance, closest first. The result is valid until
+  the action is applied again or destructed.
+*/
+const SoDistanceResult *
+SoDistanceAction::getResult(int index) const
+{
+  assert(index >= 0 && index < this->getNumResults());
+  return &PRIVATE(this)->results[index].result;
+}
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoPath.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+// Adds a separator with a 2x2x2 cube at x to group.
+static SoSeparator *
+add_cube(SoGroup * group, const float x)
+{
+  SoSeparator * sep = new SoSeparator;
+  SoTranslation * translation = new SoTranslation;
+  translation->translation.setValue(x, 0.0f, 0.0f);
+  sep->addChild(translation);
+  sep->addChild(new SoCube);
+  group->addChild(sep);
+  return sep;
+}
+
+BOOST_AUTO_TEST_CASE(closestPair)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoSeparator * sep0 = add_cube(root, 0.0f);
+  SoSeparator * sep1 = add_cube(root, 5.0f);
+  add_cube(root, 12.0f);
+
+  SoDistanceAction da;
+  da.apply(root);
+  BOOST_REQUIRE_EQUAL(da.getNumResults(), 1);
+  const SoDistanceResult * r = da.getResult(0);
+  BOOST_CHECK_CLOSE(r->distance, 3.0f, 0.001f);
+  BOOST_CHECK_CLOSE(r->point[0][0], 1.0f, 0.001f);
+  BOOST_CHECK_CLOSE(r->point[1][0], 4.0f, 0.001f);
+  BOOST_CHECK(r->path[0]->getTail() == sep0->getChild(1));
+  BOOST_CHECK(r->path[1]->getTail() == sep1->getChild(1));
+
+  da.setMaxDistance(2.0f);
+  da.apply(root);
+  BOOST_CHECK_EQUAL(da.getNumResults(), 0);
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(allPairs)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  add_cube(root, 0.0f);
+  add_cube(root, 5.0f);
+  add_cube(root, 12.0f);
+
+  SoDistanceAction da;
+  da.setQuery(SoDistanceAction::ALL_PAIRS);
+  da.setMaxDistance(4.0f);
+  da.apply(root);
+  BOOST_CHECK_EQUAL(da.getNumResults(), 1);
+
+  da.setMaxDistance(6.0f);
+  da.apply(root);
+  BOOST_REQUIRE_EQUAL(da.getNumResults(), 2);
+  BOOST_CHECK_CLOSE(da.getResult(0)->distance, 3.0f, 0.001f);
+  BOOST_CHECK_CLOSE(da.getResult(1)->distance, 5.0f, 0.001f);
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(nearest)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  add_cube(root, 0.0f);
+  SoSeparator * sep1 = add_cube(root, 5.0f);
+  SoSeparator * sep2 = add_cube(root, 12.0f);
+
+  SoDistanceAction da;
+  da.setQuery(SoDistanceAction::NEAREST);
+  da.setPoint(SbVec3f(20.0f, 0.0f, 0.0f));
+  da.setNumNearest(2);
+  da.apply(root);
+  BOOST_REQUIRE_EQUAL(da.getNumResults(), 2);
+  BOOST_CHECK_CLOSE(da.getResult(0)->distance, 7.0f, 0.001f);
+  BOOST_CHECK(da.getResult(0)->path[0]->getTail() == sep2->getChild(1));
+  BOOST_CHECK(da.getResult(0)->path[1] == NULL);
+  BOOST_CHECK_CLOSE(da.getResult(1)->distance, 14.0f, 0.001f);
+  BOOST_CHECK(da.getResult(1)->path[0]->getTail() == sep1->getChild(1));
+  root->unref();
+}
+
+BOOST_AUTO_TEST_CASE(pathListGroups)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoSeparator * group = new SoSeparator;
+  root->addChild(group);
+  add_cube(group, 0.0f);
+  add_cube(group, 5.0f);
+  SoSeparator * other = add_cube(root, 12.0f);
+
+  SoPath * path1 = new SoPath(root);
+  path1->append(group);
+  SoPath * path2 = new SoPath(root);
+  path2->append(other);
+  SoPathList paths;
+  paths.append(path1);
+  paths.append(path2);
+
+  // the cubes under the first path are not paired with each other
+  SoDistanceAction da;
+  da.apply(paths);
+  BOOST_REQUIRE_EQUAL(da.getNumResults(), 1);
+  BOOST_CHECK_CLOSE(da.getResult(0)->distance, 5.0f, 0.001f);
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
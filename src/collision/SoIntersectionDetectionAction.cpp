@@ -33,6 +33,10 @@
   Note also that the SoIntersectionDetectionAction class is not a
   high-performance component in Coin.  Using it in a continuous manner
   over complex scene graphs is doomed to be a performance killer.
+  When the action is applied repeatedly to a scene where only a few
+  shapes change between each invocation, see setPersistent(). To
+  spread the testing of large scenes over several processor cores,
+  see setNumThreads().
 
   Below is a simple usage example for this class. It was written as a
   stand-alone framework set up for profiling and optimization of the
@@ -111,11 +115,6 @@
 // intersection testing code in SoExtSelection. Check if that could be
 // used.
 
-// FIXME: I just noticed that there's an O(n^2) algorithm for removing
-// duplicates from SbOctTree::findItems() results in SbOctTree.cpp
-// (see the add_to_array() helper function). This may very well be a
-// serious bottleneck, should investigate. 20050512 mortene.
-
 // *************************************************************************
 
 /*! \file SoIntersectionDetectionAction.h */
@@ -126,18 +125,15 @@
 #endif // HAVE_CONFIG_H
 
 #include <Inventor/C/tidbits.h>
-#include <Inventor/SbOctTree.h>
-#include <Inventor/SbRotation.h>
 #include <Inventor/SbTime.h>
-#include <Inventor/SbViewportRegion.h>
 #include <Inventor/SbXfBox3f.h>
 #include <Inventor/SoPath.h>
 #include <Inventor/SoPrimitiveVertex.h>
 #include <Inventor/actions/SoCallbackAction.h>
-#include <Inventor/actions/SoGetBoundingBoxAction.h>
 #include <Inventor/actions/SoGetPrimitiveCountAction.h>
 #include <Inventor/actions/SoWriteAction.h>
 #include <Inventor/caches/SoBoundingBoxCache.h>
+#include <Inventor/elements/SoCacheElement.h>
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/lists/SbPList.h>
 #include <Inventor/nodes/SoBaseColor.h>
@@ -162,7 +158,11 @@
 #endif // HAVE_MANIPULATORS
 
 #include "actions/SoSubActionP.h"
+#include "base/SbBVH.h"
+#include "collision/SbBoxTree.h"
 #include "collision/SbTri3f.h"
+#include "misc/SbHash.h"
+#include "threads/threadsutilp.h"
 #include "coindefs.h"
 
 #if BOOST_WORKAROUND(COIN_MSVC, <= COIN_MSVC_6_0_VERSION)
@@ -171,8 +171,12 @@
 #endif // VC6.0
 
 #include "SbBasicP.h"
+#include "tidbitsp.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <list>
+#include <map>
 #include <vector>
 
 // *************************************************************************
@@ -205,6 +209,8 @@
 
 class ShapeData;
 class PrimitiveData;
+class PairData;
+class PairJob;
 
 class SoIntersectionDetectionAction :: PImpl {
 public:
@@ -237,9 +243,33 @@ public:
   static SoCallbackAction::Response pruneCB(void * closure, SoCallbackAction * action, const SoNode * node);
 
   void reset(void);
+  void clearShapes(void);
+  void clearPairs(void);
+  void removeUnseenShapes(void);
+  void updateShapeTree(void);
+  ShapeData * findShape(const SoPath * path) const;
   void doIntersectionTesting(void);
-  void doPrimitiveIntersectionTesting(PrimitiveData * primitives1, PrimitiveData * primitives2, SbBool & cont);
-  void doInternalPrimitiveIntersectionTesting(PrimitiveData * primitives, SbBool & cont);
+  void doPairIntersectionTesting(ShapeData * shape1, ShapeData * shape2, SbBool & cont);
+  void doParallelPairIntersectionTesting(std::vector<PairJob> & jobs, SbBool & cont);
+  PairData * getPairData(ShapeData * shape1, ShapeData * shape2);
+  void startPair(PairData * pair, ShapeData * shape1, PrimitiveData * primitives1,
+                 ShapeData * shape2, PrimitiveData * primitives2);
+  void replayHits(const PairData * pair, ShapeData * shape1, ShapeData * shape2, SbBool & cont);
+  void doPrimitiveIntersectionTesting(PrimitiveData * primitives1, PrimitiveData * primitives2, PairData * pair, SbBool & cont);
+  void doInternalPrimitiveIntersectionTesting(PrimitiveData * primitives, PairData * pair, SbBool & cont);
+  SoIntersectionDetectionAction::Resp invokeCallbacks(const PrimitiveData * primitives1, const int tri1,
+                                                      const PrimitiveData * primitives2, const int tri2);
+
+  // closure for reportHitCB()
+  struct ReportClosure {
+    PImpl * thisp;
+    const PrimitiveData * primitives1;
+    const PrimitiveData * primitives2;
+    PairData * pair;
+    SoIntersectionDetectionAction::Resp resp;
+    unsigned int nrhits;
+  };
+  static SbBool reportHitCB(void * closure, const int tri1, const int tri2);
 
   SoTypeList * prunetypes;
 
@@ -249,7 +279,19 @@ public:
   std::vector<SoIntersectionVisitationCallback> traversalcallbacks;
 
   SbList<ShapeData*> shapedata;
-  SbXfBox3f fullxfbbox;
+
+  // persistent mode data, kept between apply() invocations
+  SbBool persistent;
+  SbHash<const SoNode *, ShapeData *> shapedict;
+  SbList<ShapeData*> prevshapedata;
+  SbBoxTree shapetree;
+  typedef std::map<std::pair<uint32_t, uint32_t>, PairData *> PairMap;
+  PairMap pairdata;
+  float pairepsilon;
+  uint32_t applycount;
+  uint32_t nextshapeid;
+
+  int numthreads;
 };
 
 float SoIntersectionDetectionAction::PImpl::staticepsilon = 0.0f;
@@ -266,11 +308,18 @@ SoIntersectionDetectionAction::PImpl::PImpl(void)
   this->traverser = NULL;
   this->prunetypes = new SoTypeList;
   this->traversaltypes = new SoTypeList;
+  this->persistent = FALSE;
+  this->pairepsilon = 0.0f;
+  this->applycount = 0;
+  this->nextshapeid = 0;
+  this->numthreads = 1;
+  const char * env = coin_getenv("COIN_INTERSECTIONDETECTION_THREADS");
+  if (env) { this->numthreads = SbMax(atoi(env), 1); }
 }
 
 SoIntersectionDetectionAction::PImpl::~PImpl(void)
 {
-  this->reset();
+  this->clearShapes();
   delete this->traverser;
   delete this->prunetypes;
   delete this->traversaltypes;
@@ -641,6 +690,108 @@ SoIntersectionDetectionAction::removeIntersectionCallback(SoIntersectionCB * cb,
   }
 }
 
+/*!
+  Sets whether the action should keep data about the shapes in the
+  scene between invocations of apply().
+
+  In persistent mode, the action keeps the triangles of each shape,
+  organized in a bounding volume hierarchy, and a tree of the shape
+  bounding boxes. The next time the action is applied, only shapes
+  which have been changed since the last invocation get their
+  bounding boxes recalculated. A shape which has only been moved
+  keeps its triangles, which are just transformed to the new
+  position, and shapes whose geometry has changed get their
+  triangles regenerated the next time they are tested. Which shapes
+  have changed is found from the node ids of the nodes the shape
+  geometry depends on, so any notification of these nodes counts as
+  a change.
+
+  The action also remembers the result of each shape pair test. Pairs
+  of shapes where neither has changed are not tested again, instead
+  the stored intersections are reported to the callbacks. Shape
+  pairs where the testing was stopped by a callback returning
+  NEXT_SHAPE or ABORT are always tested again.
+
+  The filter callback is invoked for all shape pairs with overlapping
+  bounding boxes, also the ones that don't need to be tested again.
+
+  This makes repeated intersection testing of a scene where only a
+  few shapes change, like when interactively placing parts in an
+  assembly, much faster. The price is the memory used for keeping the
+  triangles of all tested shapes.
+
+  Turning persistent mode off frees all data kept by the action.
+
+  The default is \c FALSE.
+
+  \since Coin 4.0
+  \sa isPersistent()
+*/
+void
+SoIntersectionDetectionAction::setPersistent(SbBool enable)
+{
+  // shapes from the last apply() are not set up for reuse when
+  // turning persistent mode on, so always start from scratch
+  if (enable != PRIVATE(this)->persistent) { PRIVATE(this)->clearShapes(); }
+  PRIVATE(this)->persistent = enable;
+}
+
+/*!
+  Returns whether the action keeps data about the shapes in the scene
+  between invocations of apply().
+
+  \since Coin 4.0
+  \sa setPersistent()
+*/
+SbBool
+SoIntersectionDetectionAction::isPersistent(void) const
+{
+  return PRIVATE(this)->persistent;
+}
+
+/*!
+  Sets the number of threads used for testing the triangles of shape
+  pairs against each other.
+
+  With more than one thread, the action first finds all the shape
+  pairs to test, invoking the filter callback for each of them. The
+  pairs are then divided between the threads, each recording the
+  intersecting triangles it finds. Finally the intersection callbacks
+  are invoked from the thread which called apply(), in the same order
+  as when using one thread, so the callbacks don't need to be thread
+  safe. Note that a callback returning NEXT_SHAPE or ABORT then no
+  longer saves the work of testing the remaining triangles.
+
+  The triangles of the shapes are still generated in the thread which
+  called apply().
+
+  The default is 1, which can be changed with the environment
+  variable COIN_INTERSECTIONDETECTION_THREADS. If Coin was built
+  without thread support, the shape pairs are tested one after the
+  other, with the same results.
+
+  \since Coin 4.0
+  \sa getNumThreads()
+*/
+void
+SoIntersectionDetectionAction::setNumThreads(int num)
+{
+  assert(num > 0);
+  PRIVATE(this)->numthreads = num;
+}
+
+/*!
+  Returns the number of threads used for testing shape pairs.
+
+  \since Coin 4.0
+  \sa setNumThreads()
+*/
+int
+SoIntersectionDetectionAction::getNumThreads(void) const
+{
+  return PRIVATE(this)->numthreads;
+}
+
 // *************************************************************************
 
 void
@@ -659,13 +810,6 @@ SoIntersectionDetectionAction::apply(SoNode * node)
 
   PRIVATE(this)->reset();
 
-  // Needs a bounding box for the full scene, for later initialization
-  // of the SbOctTree of shape bounding boxes.
-  SbViewportRegion vp;
-  SoGetBoundingBoxAction bboxaction(vp);
-  bboxaction.apply(node);
-  PRIVATE(this)->fullxfbbox = bboxaction.getXfBoundingBox();
-
   if (ida_debug()) { // debug
     SoGetPrimitiveCountAction counter;
     counter.apply(node);
@@ -675,6 +819,7 @@ SoIntersectionDetectionAction::apply(SoNode * node)
   }
 
   PRIVATE(this)->traverser->apply(node);
+  PRIVATE(this)->removeUnseenShapes();
 
   SbTime starttime;
   if (ida_debug()) { // debug
@@ -696,15 +841,8 @@ void
 SoIntersectionDetectionAction::apply(SoPath * path)
 {
   PRIVATE(this)->reset();
-
-  // Needs a bounding box for the full scene, for later initialization
-  // of the SbOctTree of shape bounding boxes.
-  SbViewportRegion vp;
-  SoGetBoundingBoxAction bboxaction(vp);
-  bboxaction.apply(path);
-  PRIVATE(this)->fullxfbbox = bboxaction.getXfBoundingBox();
-
   PRIVATE(this)->traverser->apply(path);
+  PRIVATE(this)->removeUnseenShapes();
   PRIVATE(this)->doIntersectionTesting();
 }
 
@@ -712,15 +850,8 @@ void
 SoIntersectionDetectionAction::apply(const SoPathList & paths, SbBool obeysRules)
 {
   PRIVATE(this)->reset();
-
-  // Needs a bounding box for the full scene, for later initialization
-  // of the SbOctTree of shape bounding boxes.
-  SbViewportRegion vp;
-  SoGetBoundingBoxAction bboxaction(vp);
-  bboxaction.apply(paths, obeysRules);
-  PRIVATE(this)->fullxfbbox = bboxaction.getXfBoundingBox();
-
   PRIVATE(this)->traverser->apply(paths, obeysRules);
+  PRIVATE(this)->removeUnseenShapes();
   PRIVATE(this)->doIntersectionTesting();
 }
 
@@ -731,118 +862,182 @@ public:
   PrimitiveData(void)
   {
     this->path = NULL;
-    this->octtree = NULL;
+    this->tree = NULL;
   }
 
   ~PrimitiveData()
   {
-    delete this->octtree;
+    delete this->tree;
     for (unsigned int i = 0; i < this->numTriangles(); i++) { delete this->getTriangle(i); }
   }
 
-
-  const SbOctTree * getOctTree(void) {
-    if (this->octtree == NULL) {
-      const SbOctTreeFuncs funcs = {
-        NULL /* ptinsidefunc */,
-        PrimitiveData::insideboxfunc,
-        NULL /* insidespherefunc */,
-        NULL /* insideplanesfunc */
-      };
-
-      SbBox3f b = this->getBoundingBox();
-      // Add a 1% slack to the bounding box, to avoid problems in
-      // SbOctTree due to floating point inaccuracies (see assert() in
-      // SbOctTree::addItem()).
-      //
-      // This may be just a temporary hack -- see the FIXME at the
-      // same place as mentioned above.
-      SbMatrix m;
-      m.setTransform(SbVec3f(0, 0, 0), // translation
-                     SbRotation::identity(), // rotation
-                     SbVec3f(1.01f, 1.01f, 1.01f), // scalefactor
-                     SbRotation::identity(), // scaleorientation
-                     SbVec3f(b.getCenter())); // center
-      b.transform(m);
-
-      this->octtree = new SbOctTree(b, funcs);
+  // Returns the bounding volume hierarchy of the triangles. Item i
+  // of the tree is triangle i.
+  const SbBVH * getTree(void) {
+    if (this->tree == NULL) {
+      const int num = this->triangles.getLength();
+      SbBox3f * boxes = new SbBox3f[num];
+      for (int k = 0; k < num; k++) { boxes[k] = this->triangles[k]->getBoundingBox(); }
+      this->tree = new SbBVH;
+      this->tree->build(boxes, num);
+      delete[] boxes;
 
       if (ida_debug()) {
-        SoDebugError::postInfo("PrimitiveData::getOctTree",
-                               "made new octtree for PrimitiveData %p", this);
-      }
-
-      for (unsigned int k = 0; k < this->numTriangles(); k++) {
-        SbTri3f * t = this->getTriangle(k);
-        this->octtree->addItem(t);
+        SoDebugError::postInfo("PrimitiveData::getTree",
+                               "made new tree for PrimitiveData %p, depth %d",
+                               this, this->tree->getDepth());
       }
     }
-    return this->octtree;
+    return this->tree;
   }
 
-
   void setPath(SoPath * p) { this->path = p; }
   SoPath * getPath(void) const { return this->path; }
 
-  void addTriangle(SbTri3f * t)
+  void addTriangle(const SbVec3f & oa, const SbVec3f & ob, const SbVec3f & oc,
+                   const SbVec3f & wa, const SbVec3f & wb, const SbVec3f & wc)
   {
-    assert(this->octtree == NULL && "all triangles must be added before making octtree");
+    assert(this->tree == NULL && "all triangles must be added before making tree");
+    SbTri3f * t = new SbTri3f(wa, wb, wc);
     this->triangles.append(t);
+    this->points.append(oa);
+    this->points.append(ob);
+    this->points.append(oc);
     this->bbox.extendBy(t->getBoundingBox());
   }
 
   unsigned int numTriangles(void) const { return this->triangles.getLength(); }
   SbTri3f * getTriangle(const int idx) const { return this->triangles[idx]; }
+  void getObjectTriangle(const int idx, SbVec3f * v) const {
+    const SbVec3f * p = this->points.getArrayPtr(3 * idx);
+    v[0] = p[0]; v[1] = p[1]; v[2] = p[2];
+  }
 
   const SbBox3f & getBoundingBox(void) const { return this->bbox; }
 
+  // Moves the triangles to a new transformation, keeping the
+  // structure of the triangle tree.
+  void setTransform(const SbMatrix & m)
+  {
+    if (m == this->transform) return;
+    this->transform = m;
+    this->bbox.makeEmpty();
+    const SbVec3f * p = this->points.getArrayPtr();
+    for (unsigned int k = 0; k < this->numTriangles(); k++) {
+      SbVec3f wa, wb, wc;
+      m.multVecMatrix(p[3 * k], wa);
+      m.multVecMatrix(p[3 * k + 1], wb);
+      m.multVecMatrix(p[3 * k + 2], wc);
+      SbTri3f * t = this->triangles[k];
+      t->setValue(wa, wb, wc);
+      const SbBox3f tbox = t->getBoundingBox();
+      this->bbox.extendBy(tbox);
+      if (this->tree) { this->tree->setBox(k, tbox); }
+    }
+    if (this->tree) { this->tree->refit(); }
+  }
+
   SbMatrix transform;
-  SbMatrix invtransform;
 
 private:
-  static SbBool insideboxfunc(void * const item, const SbBox3f & box);
-
   SoPath * path;
   SbList<SbTri3f*> triangles;
+  SbList<SbVec3f> points; // object space, three per triangle
   SbBox3f bbox;
-  SbOctTree * octtree;
+  SbBVH * tree;
 };
 
-SbBool
-PrimitiveData::insideboxfunc(void * const item, const SbBox3f & box)
-{
-  SbTri3f * tri = static_cast<SbTri3f *>(item);
-  return box.intersect(tri->getBoundingBox());
-}
-
 // *************************************************************************
 
 class ShapeData {
 public:
   ShapeData(void)
   {
+    this->path = NULL;
     this->primitives = NULL;
+    this->bboxdeps = NULL;
+    this->geometrydeps = NULL;
+    this->nodeid = 0;
+    this->id = 0;
+    this->version = 0;
+    this->treeversion = 0;
+    this->index = -1;
+    this->leaf = -1;
+    this->seen = FALSE;
+    this->next = NULL;
   }
 
   ~ShapeData()
   {
-    if (this->primitives) { delete this->primitives; }
+    this->invalidate();
   }
 
-  PrimitiveData * getPrimitives(void);
+  PrimitiveData * getPrimitives(SbBool recorddeps);
+  SbBool validate(SoState * state, const SoShape * shape);
+  void invalidate(void);
 
   SoPath * path;
   SbXfBox3f xfbbox;
 
+  // persistent mode data
+  SoCache * bboxdeps; // elements the bounding box depends on
+  SoCache * geometrydeps; // elements the triangles depend on
+  uint32_t nodeid; // shape node id when bboxdeps was made
+  uint32_t id; // unique for the lifetime of the action
+  uint32_t version; // bumped when the shape changes
+  uint32_t treeversion; // version of the box in the shape tree
+  int index; // position in shape list for this apply()
+  int leaf; // handle in the shape tree
+  SbBool seen;
+  ShapeData * next; // next instance of the same shape node
+
 private:
   static void triangleCB(void * closure, SoCallbackAction *,
                          const SoPrimitiveVertex * v1,
                          const SoPrimitiveVertex * v2,
                          const SoPrimitiveVertex * v3);
+  static SoCallbackAction::Response preShapeCB(void * closure, SoCallbackAction * action, const SoNode * node);
+  static SoCallbackAction::Response postShapeCB(void * closure, SoCallbackAction * action, const SoNode * node);
 
   PrimitiveData * primitives;
+  SbBool storedinvalid;
 };
 
+// Checks if the bounding box and triangles of the shape are still
+// valid in the current traversal state. The triangles are thrown
+// away if they are not, while the return value tells whether the
+// bounding box is still valid.
+SbBool
+ShapeData::validate(SoState * state, const SoShape * shape)
+{
+  if (this->bboxdeps == NULL ||
+      this->nodeid != shape->getNodeId() ||
+      !this->bboxdeps->isValid(state)) {
+    return FALSE;
+  }
+  if (this->geometrydeps && !this->geometrydeps->isValid(state)) {
+    this->geometrydeps->unref();
+    this->geometrydeps = NULL;
+    delete this->primitives;
+    this->primitives = NULL;
+    this->version++;
+  }
+  return TRUE;
+}
+
+// Throws away the bounding box dependencies and the triangles.
+void
+ShapeData::invalidate(void)
+{
+  if (this->bboxdeps) { this->bboxdeps->unref(); }
+  if (this->geometrydeps) { this->geometrydeps->unref(); }
+  this->bboxdeps = NULL;
+  this->geometrydeps = NULL;
+  delete this->primitives;
+  this->primitives = NULL;
+  this->version++;
+}
+
 void
 ShapeData::triangleCB(void * closure, SoCallbackAction *,
                       const SoPrimitiveVertex * v1,
@@ -861,8 +1056,7 @@ ShapeData::triangleCB(void * closure, SoCallbackAction *,
   // Only add valid triangles.
   const SbVec3f normal = (wa - wb).cross(wa - wc);
   if (normal.length() > 0.0f) {
-    SbTri3f * triangle = new SbTri3f(wa, wb, wc);
-    primitives->addTriangle(triangle);
+    primitives->addTriangle(oa, ob, oc, wa, wb, wc);
   }
   else {
     static SbBool warn = TRUE;
@@ -887,49 +1081,182 @@ ShapeData::triangleCB(void * closure, SoCallbackAction *,
   }
 }
 
+// Opens a cache around the primitive generation of the shape, to
+// record which elements the triangles depend on.
+SoCallbackAction::Response
+ShapeData::preShapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
+{
+  ShapeData * thisp = static_cast<ShapeData *>(closure);
+  if (node != thisp->path->getTail()) return SoCallbackAction::CONTINUE;
+
+  SoState * state = action->getState();
+  // must push state to make cache dependencies work
+  state->push();
+  thisp->storedinvalid = SoCacheElement::setInvalid(FALSE);
+  assert(thisp->geometrydeps == NULL);
+  thisp->geometrydeps = new SoCache(state);
+  thisp->geometrydeps->ref();
+  SoCacheElement::set(state, thisp->geometrydeps);
+  return SoCallbackAction::CONTINUE;
+}
+
+SoCallbackAction::Response
+ShapeData::postShapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
+{
+  ShapeData * thisp = static_cast<ShapeData *>(closure);
+  if (node != thisp->path->getTail()) return SoCallbackAction::CONTINUE;
+
+  action->getState()->pop();
+  SoCacheElement::setInvalid(thisp->storedinvalid);
+  return SoCallbackAction::CONTINUE;
+}
+
+// Returns the triangles of the shape, generating them if
+// needed. With recorddeps set, the elements the triangles depend on
+// are recorded, so that validate() can tell when they must be
+// generated again.
 PrimitiveData *
-ShapeData::getPrimitives(void)
+ShapeData::getPrimitives(SbBool recorddeps)
 {
-  if (this->primitives) { return this->primitives; }
+  if (this->primitives) {
+    this->primitives->setTransform(this->xfbbox.getTransform());
+    return this->primitives;
+  }
 
   this->primitives = new PrimitiveData;
   this->primitives->setPath(this->path);
   this->primitives->transform = this->xfbbox.getTransform();
-  this->primitives->invtransform = primitives->transform.inverse();
   SoCallbackAction generator;
   generator.addTriangleCallback(SoShape::getClassTypeId(),
                                 ShapeData::triangleCB,
                                 this->primitives);
+  if (recorddeps) {
+    generator.addPreCallback(SoShape::getClassTypeId(), ShapeData::preShapeCB, this);
+    generator.addPostCallback(SoShape::getClassTypeId(), ShapeData::postShapeCB, this);
+  }
   generator.apply(this->path);
   return this->primitives;
 }
 
 // *************************************************************************
 
+// The stored result of intersection testing a pair of shapes, or a
+// shape with itself.
+class PairData {
+public:
+  PairData(void) : firstid(0), stamp(0), complete(FALSE) {
+    this->version[0] = this->version[1] = 0;
+  }
+
+  uint32_t firstid; // id of the shape of the first triangle in each hit
+  uint32_t version[2]; // versions of the first and second shape
+  uint32_t stamp; // apply() count when last used
+  SbBool complete; // FALSE if testing was stopped by a callback
+  SbList<int> hits; // pairs of triangle indices
+};
+
+// A shape pair to test when using several threads, see
+// doParallelPairIntersectionTesting().
+class PairJob {
+public:
+  PairJob(ShapeData * s1, ShapeData * s2)
+    : shape1(s1), shape2(s2), primitives1(NULL), primitives2(NULL),
+      pair(NULL), nrisectchks(0) { }
+
+  ShapeData * shape1;
+  ShapeData * shape2;
+  PrimitiveData * primitives1; // NULL if the stored result can be used
+  PrimitiveData * primitives2;
+  PairData * pair;
+  unsigned int nrisectchks; // for debugging
+};
+
+// *************************************************************************
+
 SoCallbackAction::Response
 SoIntersectionDetectionAction::PImpl::shape(SoCallbackAction * action, SoShape * shape)
 {
+  SoState * state = action->getState();
+  const SoPath * curpath = action->getCurPath();
+  const SbMatrix & modelmatrix = action->getModelMatrix();
+
+  ShapeData * data = this->persistent ? this->findShape(curpath) : NULL;
+  if (data == NULL) {
+    data = new ShapeData;
+    data->path = new SoPath(*curpath);
+    data->path->ref();
+    data->id = this->nextshapeid++;
+    if (this->persistent) {
+      ShapeData * first = NULL;
+      if (this->shapedict.get(shape, first)) { data->next = first; }
+      this->shapedict.put(shape, data);
+    }
+  }
+  data->seen = TRUE;
+  data->index = this->shapedata.getLength();
+  this->shapedata.append(data);
+
+  if (this->persistent && data->validate(state, shape)) {
+    // only the transformation might have changed
+    if (modelmatrix != data->xfbbox.getTransform()) {
+      data->xfbbox.setTransform(modelmatrix);
+      data->version++;
+    }
+    return SoCallbackAction::CONTINUE;
+  }
+
+  SbBool storedinvalid = FALSE;
+  if (this->persistent) {
+    data->invalidate();
+    // record the elements the bounding box depends on, like
+    // SoShape does for its bounding box cache
+    state->push();
+    storedinvalid = SoCacheElement::setInvalid(FALSE);
+    data->bboxdeps = new SoCache(state);
+    data->bboxdeps->ref();
+    SoCacheElement::set(state, data->bboxdeps);
+  }
+
   SbBox3f bbox;
   SbVec3f center;
 
   const SoBoundingBoxCache * bboxcache = shape->getBoundingBoxCache();
-  if (bboxcache && bboxcache->isValid(action->getState())) {
+  if (bboxcache && bboxcache->isValid(state)) {
     bbox = bboxcache->getProjectedBox();
     if (bboxcache->isCenterSet()) center = bboxcache->getCenter();
     else center = bbox.getCenter();
+    if (this->persistent) {
+      SoCacheElement::addCacheDependency(state, const_cast<SoBoundingBoxCache *>(bboxcache));
+    }
   }
   else {
     shape->computeBBox(action, bbox, center);
   }
-  ShapeData * data = new ShapeData;
-  data->path = new SoPath(*(action->getCurPath()));
-  data->path->ref();
+
+  if (this->persistent) {
+    state->pop();
+    SoCacheElement::setInvalid(storedinvalid);
+    data->nodeid = shape->getNodeId();
+  }
+
   data->xfbbox = bbox;
-  data->xfbbox.setTransform(action->getModelMatrix());
-  this->shapedata.append(data);
+  data->xfbbox.setTransform(modelmatrix);
   return SoCallbackAction::CONTINUE;
 }
 
+// Finds the data kept from an earlier apply() for the shape at the
+// end of path.
+ShapeData *
+SoIntersectionDetectionAction::PImpl::findShape(const SoPath * path) const
+{
+  ShapeData * data = NULL;
+  if (!this->shapedict.get(path->getTail(), data)) return NULL;
+  while (data && (data->seen || *data->path != *path)) {
+    data = data->next;
+  }
+  return data;
+}
+
 SoCallbackAction::Response
 SoIntersectionDetectionAction::PImpl::shapeCB(void * closure, SoCallbackAction * action, const SoNode * node)
 {
@@ -993,16 +1320,22 @@ SoIntersectionDetectionAction::PImpl::pruneCB(void *, SoCallbackAction *, const
   return SoCallbackAction::PRUNE;
 }
 
+// Prepares for a new traversal. Without persistent mode, all data
+// from the last apply() is thrown away.
 void
 SoIntersectionDetectionAction::PImpl::reset(void)
 {
   int i;
-  for (i = 0; i < this->shapedata.getLength(); i++) {
-    ShapeData * data = this->shapedata[i];
-    data->path->unref();
-    delete data;
+  if (!this->persistent) {
+    this->clearShapes();
+  }
+  else {
+    this->prevshapedata = this->shapedata;
+    for (i = 0; i < this->shapedata.getLength(); i++) {
+      this->shapedata[i]->seen = FALSE;
+    }
+    this->shapedata.truncate(0);
   }
-  this->shapedata.truncate(0);
   if (this->traverser != NULL) {
     delete this->traverser;
     this->traverser = NULL;
@@ -1021,6 +1354,84 @@ SoIntersectionDetectionAction::PImpl::reset(void)
                                   shapeCB, this);
 }
 
+// Throws away all shape and pair data.
+void
+SoIntersectionDetectionAction::PImpl::clearShapes(void)
+{
+  int i;
+  for (i = 0; i < this->shapedata.getLength(); i++) {
+    ShapeData * data = this->shapedata[i];
+    data->path->unref();
+    delete data;
+  }
+  this->shapedata.truncate(0);
+  this->prevshapedata.truncate(0);
+  this->shapedict.clear();
+  this->shapetree.clear();
+  this->clearPairs();
+}
+
+void
+SoIntersectionDetectionAction::PImpl::clearPairs(void)
+{
+  for (PairMap::iterator it = this->pairdata.begin(); it != this->pairdata.end(); ++it) {
+    delete it->second;
+  }
+  this->pairdata.clear();
+}
+
+// Throws away the data for shapes which were not found in the last
+// traversal.
+void
+SoIntersectionDetectionAction::PImpl::removeUnseenShapes(void)
+{
+  for (int i = 0; i < this->prevshapedata.getLength(); i++) {
+    ShapeData * data = this->prevshapedata[i];
+    if (data->seen) continue;
+
+    const SoNode * tail = data->path->getTail();
+    ShapeData * first = NULL;
+    SbBool found = this->shapedict.get(tail, first);
+    assert(found);
+    if (first == data) {
+      if (data->next) { this->shapedict.put(tail, data->next); }
+      else { this->shapedict.erase(tail); }
+    }
+    else {
+      ShapeData * prev = first;
+      while (prev->next != data) { prev = prev->next; }
+      prev->next = data->next;
+    }
+    if (data->leaf != -1) { this->shapetree.remove(data->leaf); }
+    data->path->unref();
+    delete data;
+  }
+  this->prevshapedata.truncate(0);
+}
+
+// Brings the tree of shape bounding boxes up to date with the shapes
+// found in the last traversal.
+void
+SoIntersectionDetectionAction::PImpl::updateShapeTree(void)
+{
+  for (int i = 0; i < this->shapedata.getLength(); i++) {
+    ShapeData * data = this->shapedata[i];
+    if (data->leaf != -1 && data->treeversion == data->version) continue;
+    data->treeversion = data->version;
+
+    if (data->xfbbox.isEmpty()) {
+      if (data->leaf != -1) { this->shapetree.remove(data->leaf); }
+      data->leaf = -1;
+    }
+    else if (data->leaf == -1) {
+      data->leaf = this->shapetree.insert(data->xfbbox.project(), data);
+    }
+    else {
+      this->shapetree.update(data->leaf, data->xfbbox.project());
+    }
+  }
+}
+
 #if 0 //Do not compile debug functions normally
 
 // This is a helper function for debugging purposes: it sets up an
@@ -1145,12 +1556,11 @@ expand_SbXfBox3f(const SbXfBox3f & box, float epsilon)
   return extbox;
 }
 
-// The callback test function for the SbOctTree.
-static SbBool
-shapeinsideboxfunc(void * const item, const SbBox3f & box)
+// Orders shapes by their position in the traversal.
+static bool
+shape_index_less(const ShapeData * a, const ShapeData * b)
 {
-  ShapeData * shape = static_cast<ShapeData *>(item);
-  return shape->xfbbox.intersect(box);
+  return a->index < b->index;
 }
 
 // Execute full set of intersection detection operations on all the
@@ -1174,42 +1584,27 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
 
   }
 
-  const SbOctTreeFuncs funcs = {
-    NULL /* ptinsidefunc */,
-    shapeinsideboxfunc,
-    NULL /* insidespherefunc */,
-    NULL /* insideplanesfunc */
-  };
-
-  SbBox3f b = this->fullxfbbox.project();
-  // Add a 1% slack to the bounding box, to avoid problems in
-  // SbOctTree due to floating point inaccuracies (see assert() in
-  // SbOctTree::addItem()).
-  //
-  // This may be just a temporary hack -- see the FIXME at the
-  // same place.
-  SbMatrix m;
-  m.setTransform(SbVec3f(0, 0, 0), // translation
-                 SbRotation::identity(), // rotation
-                 SbVec3f(1.01f, 1.01f, 1.01f), // scalefactor
-                 SbRotation::identity(), // scaleorientation
-                 SbVec3f(b.getCenter())); // center
-  b.transform(m);
-
-  SbOctTree shapetree(b, funcs);
-  for (int k = 0; k < this->shapedata.getLength(); k++) {
-    ShapeData * shape = this->shapedata[k];
-    if (shape->xfbbox.isEmpty()) { continue; }
-    shapetree.addItem(shape);
-  }
-
-  if (ida_debug()) { shapetree.debugTree(stderr); }
+  this->updateShapeTree();
 
   // For debugging.
   unsigned int nrshapeshapeisects = 0;
   unsigned int nrselfisects = 0;
 
   const float theepsilon = this->getEpsilon();
+  if (theepsilon != this->pairepsilon) {
+    this->clearPairs();
+    this->pairepsilon = theepsilon;
+  }
+  this->applycount++;
+
+  // With several threads, the shape pairs are collected first and
+  // tested afterwards.
+  const SbBool parallel = this->numthreads > 1;
+  std::vector<PairJob> jobs;
+
+  SbBool cont = TRUE;
+  SbList<int> candidateleaves;
+  std::vector<ShapeData *> candidateshapes;
 
   for (int i = 0; i < this->shapedata.getLength(); i++) {
     ShapeData * shape1 = this->shapedata[i];
@@ -1218,17 +1613,16 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
     // iteration of for-loop.
     if (shape1->xfbbox.isEmpty()) { continue; }
 
-    // Remove shapes from octtree as we iterate over the full set, to
-    // avoid self-intersection and to avoid checks against other
-    // shapes happening both ways.
-    shapetree.removeItem(shape1);
-
     // FIXME: shouldn't we also invoke the filter-callback here? 20030403 mortene.
     if (this->internalsenabled) {
       nrselfisects++;
-      SbBool cont;
-      this->doInternalPrimitiveIntersectionTesting(shape1->getPrimitives(), cont);
-      if (!cont) { goto done; }
+      if (parallel) {
+        jobs.push_back(PairJob(shape1, shape1));
+      }
+      else {
+        this->doPairIntersectionTesting(shape1, shape1, cont);
+        if (!cont) { goto done; }
+      }
     }
 
     SbBox3f shapebbox = shape1->xfbbox.project();
@@ -1238,13 +1632,23 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
       shapebbox.getMin() -= e;
       shapebbox.getMax() += e;
     }
-    SbList<void*> candidateshapes;
-    shapetree.findItems(shapebbox, candidateshapes);
+
+    // Only shapes later in the traversal are tested against, to
+    // avoid self-intersection and to avoid checks against other
+    // shapes happening both ways.
+    candidateleaves.truncate(0);
+    this->shapetree.findLeaves(shapebbox, candidateleaves);
+    candidateshapes.clear();
+    for (int k = 0; k < candidateleaves.getLength(); k++) {
+      ShapeData * s = static_cast<ShapeData *>(this->shapetree.getItem(candidateleaves[k]));
+      if (s->index > i) { candidateshapes.push_back(s); }
+    }
+    std::sort(candidateshapes.begin(), candidateshapes.end(), shape_index_less);
 
     if (ida_debug()) {
       SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doIntersectionTesting",
                              "shape %d intersects %d other shapes",
-                             i, candidateshapes.getLength());
+                             i, static_cast<int>(candidateshapes.size()));
 
       // debug, dump to .iv-file the "master" shape bbox given by i,
       // plus ditto for all intersected shapes
@@ -1255,10 +1659,10 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
 
         root->addChild(make_scene_graph(shape1->xfbbox, "mastershape"));
 
-        for (int j = 0; j < candidateshapes.getLength(); j++) {
-          ShapeData * s = (ShapeData * )candidateshapes[j];
+        for (size_t j = 0; j < candidateshapes.size(); j++) {
+          ShapeData * s = candidateshapes[j];
           SbString str;
-          str.sprintf("%d", j);
+          str.sprintf("%d", static_cast<int>(j));
           root->addChild(make_scene_graph(s->xfbbox, str.getString()));
         }
 
@@ -1277,14 +1681,14 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
     if (theepsilon > 0.0f) { xfboxchk = expand_SbXfBox3f(shape1->xfbbox, theepsilon); }
     else { xfboxchk = shape1->xfbbox; }
 
-    for (int j = 0; j < candidateshapes.getLength(); j++) {
-      ShapeData * shape2 = static_cast<ShapeData *>(candidateshapes[j]);
+    for (size_t j = 0; j < candidateshapes.size(); j++) {
+      ShapeData * shape2 = candidateshapes[j];
 
       if (!xfboxchk.intersect(shape2->xfbbox)) {
         if (ida_debug()) {
           SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doIntersectionTesting",
                                  "shape %d intersecting %d is a miss when tried with SbXfBox3f::intersect(SbXfBox3f)",
-                                 i, j);
+                                 i, shape2->index);
         }
         continue;
       }
@@ -1292,9 +1696,34 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
       if (!this->filtercb ||
           this->filtercb(this->filterclosure, shape1->path, shape2->path)) {
         nrshapeshapeisects++;
-        SbBool cont;
-        this->doPrimitiveIntersectionTesting(shape1->getPrimitives(), shape2->getPrimitives(), cont);
-        if (!cont) { goto done; }
+        if (parallel) {
+          jobs.push_back(PairJob(shape1, shape2));
+        }
+        else {
+          this->doPairIntersectionTesting(shape1, shape2, cont);
+          if (!cont) { goto done; }
+        }
+      }
+    }
+  }
+
+  if (parallel) {
+    this->doParallelPairIntersectionTesting(jobs, cont);
+    if (!cont) { goto done; }
+  }
+
+  // Results for shape pairs which are no longer tested are not
+  // needed anymore. Skipped when aborted, as not all pairs have
+  // been visited then.
+  if (this->persistent) {
+    PairMap::iterator it = this->pairdata.begin();
+    while (it != this->pairdata.end()) {
+      if (it->second->stamp != this->applycount) {
+        delete it->second;
+        this->pairdata.erase(it++);
+      }
+      else {
+        ++it;
       }
     }
   }
@@ -1307,101 +1736,276 @@ SoIntersectionDetectionAction::PImpl::doIntersectionTesting(void)
   }
 }
 
-// Intersection testing between primitives of different shapes.
+// Returns the stored result for a pair of shapes, or a shape with
+// itself, creating it if needed.
+PairData *
+SoIntersectionDetectionAction::PImpl::getPairData(ShapeData * shape1, ShapeData * shape2)
+{
+  assert(this->persistent);
+  const std::pair<uint32_t, uint32_t> key(SbMin(shape1->id, shape2->id),
+                                          SbMax(shape1->id, shape2->id));
+  PairMap::iterator it = this->pairdata.find(key);
+  if (it == this->pairdata.end()) {
+    it = this->pairdata.insert(PairMap::value_type(key, new PairData)).first;
+  }
+  PairData * pair = it->second;
+  pair->stamp = this->applycount;
+  return pair;
+}
+
+// Clears the hits of pair before testing the shapes again, and
+// records which shape the first triangle of each hit belongs to.
 void
-SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting(PrimitiveData * primitives1,
-                                                             PrimitiveData * primitives2,
-                                                             SbBool & cont)
+SoIntersectionDetectionAction::PImpl::startPair(PairData * pair,
+                                                ShapeData * shape1,
+                                                PrimitiveData * primitives1,
+                                                ShapeData * shape2,
+                                                PrimitiveData * primitives2)
+{
+  pair->hits.truncate(0);
+  pair->complete = FALSE;
+  // the shape with fewer triangles is iterated over, see
+  // doPrimitiveIntersectionTesting()
+  const SbBool swap = primitives1->numTriangles() < primitives2->numTriangles();
+  ShapeData * first = (shape1 == shape2 || swap) ? shape1 : shape2;
+  ShapeData * second = (first == shape1) ? shape2 : shape1;
+  pair->firstid = first->id;
+  pair->version[0] = first->version;
+  pair->version[1] = second->version;
+}
+
+// Invokes the intersection callbacks for the hits of pair.
+void
+SoIntersectionDetectionAction::PImpl::replayHits(const PairData * pair,
+                                                 ShapeData * shape1,
+                                                 ShapeData * shape2,
+                                                 SbBool & cont)
 {
   cont = TRUE;
+  if (pair->hits.getLength() == 0) return;
+
+  ShapeData * first = (pair->firstid == shape1->id) ? shape1 : shape2;
+  ShapeData * second = (first == shape1) ? shape2 : shape1;
+  const PrimitiveData * primitives1 = first->getPrimitives(this->persistent);
+  const PrimitiveData * primitives2 = second->getPrimitives(this->persistent);
+  for (int i = 0; i < pair->hits.getLength(); i += 2) {
+    switch (this->invokeCallbacks(primitives1, pair->hits[i],
+                                  primitives2, pair->hits[i + 1])) {
+    case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
+      break;
+    case SoIntersectionDetectionAction::NEXT_SHAPE:
+      return;
+    case SoIntersectionDetectionAction::ABORT:
+      cont = FALSE;
+      return;
+    default:
+      assert(0);
+    }
+  }
+}
 
-  // for debugging
-  if (ida_debug()) {
-    SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting",
-                           "primitives1 (%p) = %d tris, primitives2 (%p) = %d tris",
-                           primitives1, primitives1->numTriangles(),
-                           primitives2, primitives2->numTriangles());
+// Returns TRUE if the stored result of pair is still valid.
+static SbBool
+pair_is_current(const PairData * pair, const ShapeData * shape1, const ShapeData * shape2)
+{
+  const ShapeData * first = (pair->firstid == shape1->id) ? shape1 : shape2;
+  const ShapeData * second = (first == shape1) ? shape2 : shape1;
+  return
+    pair->complete &&
+    pair->version[0] == first->version &&
+    pair->version[1] == second->version;
+}
+
+// Intersection testing between two shapes, or of a shape with itself
+// if shape1 and shape2 are the same. In persistent mode, the stored
+// result is used if neither shape has changed since it was made.
+void
+SoIntersectionDetectionAction::PImpl::doPairIntersectionTesting(ShapeData * shape1,
+                                                                ShapeData * shape2,
+                                                                SbBool & cont)
+{
+  cont = TRUE;
+
+  PairData * pair = NULL;
+  if (this->persistent) {
+    pair = this->getPairData(shape1, shape2);
+    if (pair_is_current(pair, shape1, shape2)) {
+      if (ida_debug()) {
+        SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doPairIntersectionTesting",
+                               "reusing %d hits between shapes %d and %d",
+                               pair->hits.getLength() / 2, shape1->index, shape2->index);
+      }
+      this->replayHits(pair, shape1, shape2, cont);
+      return;
+    }
   }
-  unsigned int nrisectchks = 0;
-  unsigned int nrhits = 0;
 
-  // Use the majority size shape from an octtree.
-  //
-  // (Some initial investigation indicates that this isn't a clear-cut
-  // choice, by the way -- should investigate further. mortene.)
-  PrimitiveData * octtreeprims = primitives1;
-  PrimitiveData * iterationprims = primitives2;
-  if (primitives1->numTriangles() < primitives2->numTriangles()) {
-    octtreeprims = primitives2;
-    iterationprims = primitives1;
+  if (shape1 == shape2) {
+    PrimitiveData * primitives = shape1->getPrimitives(this->persistent);
+    if (pair) { this->startPair(pair, shape1, primitives, shape1, primitives); }
+    this->doInternalPrimitiveIntersectionTesting(primitives, pair, cont);
   }
+  else {
+    PrimitiveData * primitives1 = shape1->getPrimitives(this->persistent);
+    PrimitiveData * primitives2 = shape2->getPrimitives(this->persistent);
+    if (pair) { this->startPair(pair, shape1, primitives1, shape2, primitives2); }
+    this->doPrimitiveIntersectionTesting(primitives1, primitives2, pair, cont);
+  }
+}
 
-  const SbOctTree * octtree = octtreeprims->getOctTree();
+// Invokes the intersection callbacks for a pair of intersecting
+// triangles. Returns NEXT_SHAPE or ABORT if a callback asks for
+// that, NEXT_PRIMITIVE otherwise.
+SoIntersectionDetectionAction::Resp
+SoIntersectionDetectionAction::PImpl::invokeCallbacks(const PrimitiveData * primitives1, const int tri1,
+                                                      const PrimitiveData * primitives2, const int tri2)
+{
+  SoIntersectingPrimitive p1;
+  p1.path = primitives1->getPath();
+  p1.type = SoIntersectingPrimitive::TRIANGLE;
+  primitives1->getTriangle(tri1)->getValue(p1.xf_vertex[0], p1.xf_vertex[1], p1.xf_vertex[2]);
+  primitives1->getObjectTriangle(tri1, p1.vertex);
+
+  SoIntersectingPrimitive p2;
+  p2.path = primitives2->getPath();
+  p2.type = SoIntersectingPrimitive::TRIANGLE;
+  primitives2->getTriangle(tri2)->getValue(p2.xf_vertex[0], p2.xf_vertex[1], p2.xf_vertex[2]);
+  primitives2->getObjectTriangle(tri2, p2.vertex);
+
+  std::vector<SoIntersectionCallback>::iterator it = this->callbacks.begin();
+  while (it != this->callbacks.end()) {
+    switch ( (*it).first((*it).second, &p1, &p2) ) {
+    case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
+      // Break out of the switch, invoke next callback.
+      break;
+    case SoIntersectionDetectionAction::NEXT_SHAPE:
+      // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
+      return SoIntersectionDetectionAction::NEXT_SHAPE;
+    case SoIntersectionDetectionAction::ABORT:
+      // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
+      return SoIntersectionDetectionAction::ABORT;
+    default:
+      assert(0);
+    }
+    ++it;
+  }
+  return SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
 
-  const float theepsilon = this->getEpsilon();
-  const SbVec3f e(theepsilon, theepsilon, theepsilon);
+// Called for each pair of intersecting triangles found by
+// find_hits(). Returns FALSE to stop the search.
+typedef SbBool ida_hit_cb(void * closure, const int tri1, const int tri2);
+
+// Finds the triangles of iterationprims which intersect triangles of
+// treeprims, or, if they are the same, the intersecting triangles
+// within the shape. Returns FALSE if stopped by report.
+//
+// Only reads the triangles and the tree of treeprims, so several
+// searches can run at the same time in different threads, as long as
+// the tree has been made in advance.
+static SbBool
+find_hits(const PrimitiveData * iterationprims,
+          const PrimitiveData * treeprims, const SbBVH * tree,
+          const float epsilon, ida_hit_cb * report, void * closure,
+          unsigned int & nrisectchks)
+{
+  const SbBool internal = (iterationprims == treeprims);
+  const SbVec3f e(epsilon, epsilon, epsilon);
 
-  for (unsigned int i = 0; i < iterationprims->numTriangles(); i++) {
-    SbTri3f * t1 = static_cast<SbTri3f *>(iterationprims->getTriangle(i));
+  SbList<int> candidatetris;
+  const int numtris = iterationprims->numTriangles();
+  for (int i = 0; i < numtris; i++) {
+    const SbTri3f * t1 = iterationprims->getTriangle(i);
 
     SbBox3f tribbox = t1->getBoundingBox();
-    if (theepsilon > 0.0f) {
+    if (epsilon > 0.0f) {
       // Extend bbox in all 6 directions with the epsilon value.
       tribbox.getMin() -= e;
       tribbox.getMax() += e;
     }
 
-    SbList<void*> candidatetris;
-    octtree->findItems(tribbox, candidatetris);
+    candidatetris.truncate(0);
+    tree->findBox(tribbox, candidatetris);
 
     for (int j = 0; j < candidatetris.getLength(); j++) {
-      SbTri3f * t2 = static_cast<SbTri3f *>(candidatetris[j]);
+      const int idx2 = candidatetris[j];
+      // triangles within a shape are only tested one way, and not
+      // against themselves
+      if (internal && idx2 <= i) continue;
+      const SbTri3f * t2 = treeprims->getTriangle(idx2);
 
       nrisectchks++;
 
-      if (t1->intersect(*t2, theepsilon)) {
-        nrhits++;
-
-        SoIntersectingPrimitive p1;
-        p1.path = iterationprims->getPath();
-        p1.type = SoIntersectingPrimitive::TRIANGLE;
-        t1->getValue(p1.xf_vertex[0], p1.xf_vertex[1], p1.xf_vertex[2]);
-        iterationprims->invtransform.multVecMatrix(p1.xf_vertex[0], p1.vertex[0]);
-        iterationprims->invtransform.multVecMatrix(p1.xf_vertex[1], p1.vertex[1]);
-        iterationprims->invtransform.multVecMatrix(p1.xf_vertex[2], p1.vertex[2]);
-
-        SoIntersectingPrimitive p2;
-        p2.path = octtreeprims->getPath();
-        p2.type = SoIntersectingPrimitive::TRIANGLE;
-        t2->getValue(p2.xf_vertex[0], p2.xf_vertex[1], p2.xf_vertex[2]);
-        octtreeprims->invtransform.multVecMatrix(p2.xf_vertex[0], p2.vertex[0]);
-        octtreeprims->invtransform.multVecMatrix(p2.xf_vertex[1], p2.vertex[1]);
-        octtreeprims->invtransform.multVecMatrix(p2.xf_vertex[2], p2.vertex[2]);
-
-        std::vector<SoIntersectionCallback>::iterator it = this->callbacks.begin();
-        while (it != this->callbacks.end()) {
-          switch ( (*it).first((*it).second, &p1, &p2) ) {
-          case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
-            // Break out of the switch, invoke next callback.
-            break;
-          case SoIntersectionDetectionAction::NEXT_SHAPE:
-            // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
-            cont = TRUE;
-            goto done;
-          case SoIntersectionDetectionAction::ABORT:
-            // FIXME: remaining callbacks won't be invoked -- should they? 20030328 mortene.
-            cont = FALSE;
-            goto done;
-          default:
-            assert(0);
-          }
-          ++it;
-        }
+      // The bounding boxes overlap. Check that the other triangle
+      // actually passes through the box before doing the more
+      // expensive exact test.
+      if (!t2->intersect(tribbox)) continue;
+
+      if (t1->intersect(*t2, epsilon)) {
+        if (!report(closure, i, idx2)) return FALSE;
       }
     }
   }
+  return TRUE;
+}
+
+// Reports hits to the intersection callbacks as they are found.
+SbBool
+SoIntersectionDetectionAction::PImpl::reportHitCB(void * closure, const int tri1, const int tri2)
+{
+  ReportClosure * data = static_cast<ReportClosure *>(closure);
+  data->nrhits++;
+  if (data->pair) {
+    data->pair->hits.append(tri1);
+    data->pair->hits.append(tri2);
+  }
+  data->resp = data->thisp->invokeCallbacks(data->primitives1, tri1,
+                                            data->primitives2, tri2);
+  return data->resp == SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
+
+// Intersection testing between primitives of different shapes. Hits
+// are recorded in pair, if given.
+void
+SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting(PrimitiveData * primitives1,
+                                                                     PrimitiveData * primitives2,
+                                                                     PairData * pair,
+                                                                     SbBool & cont)
+{
+  // for debugging
+  if (ida_debug()) {
+    SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting",
+                           "primitives1 (%p) = %d tris, primitives2 (%p) = %d tris",
+                           primitives1, primitives1->numTriangles(),
+                           primitives2, primitives2->numTriangles());
+  }
+  unsigned int nrisectchks = 0;
+
+  // Use the majority size shape from a tree.
+  //
+  // (Some initial investigation indicates that this isn't a clear-cut
+  // choice, by the way -- should investigate further. mortene.)
+  PrimitiveData * treeprims = primitives1;
+  PrimitiveData * iterationprims = primitives2;
+  if (primitives1->numTriangles() < primitives2->numTriangles()) {
+    treeprims = primitives2;
+    iterationprims = primitives1;
+  }
+
+  ReportClosure data;
+  data.thisp = this;
+  data.primitives1 = iterationprims;
+  data.primitives2 = treeprims;
+  data.pair = pair;
+  data.resp = SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+  data.nrhits = 0;
+
+  const SbBool complete = find_hits(iterationprims, treeprims, treeprims->getTree(),
+                                    this->getEpsilon(), PImpl::reportHitCB, &data,
+                                    nrisectchks);
+  if (complete && pair) { pair->complete = TRUE; }
+  cont = (data.resp != SoIntersectionDetectionAction::ABORT);
 
-done:
   // for debugging
   if (ida_debug()) {
     const unsigned int total = primitives1->numTriangles() + primitives2->numTriangles();
@@ -1409,21 +2013,23 @@ done:
                            "intersection checks = %d (pr primitive: %f)",
                            nrisectchks, float(nrisectchks) / total);
     SbString chksprhit;
-    if (nrhits == 0) { chksprhit = "-"; }
-    else { chksprhit.sprintf("%f", float(nrisectchks) / nrhits); }
+    if (data.nrhits == 0) { chksprhit = "-"; }
+    else { chksprhit.sprintf("%f", float(nrisectchks) / data.nrhits); }
     SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doPrimitiveIntersectionTesting",
-                           "hits = %d (chks pr hit: %s)", nrhits, chksprhit.getString());
+                           "hits = %d (chks pr hit: %s)", data.nrhits, chksprhit.getString());
   }
 }
 
 // Does intersection testing internally within the same
-// shape. Triangles are not tested against themselves.
+// shape. Triangles are not tested against themselves. Hits are
+// recorded in pair, if given.
 //
 // Can ignore epsilon setting, as that only indicates a distance
 // between distinct shapes.
 void
 SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting(PrimitiveData * primitives,
-                                                                     SbBool & cont)
+                                                                             PairData * pair,
+                                                                             SbBool & cont)
 {
   // for debugging
   if (ida_debug()) {
@@ -1432,60 +2038,269 @@ SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting(Pri
   }
   unsigned int nrisectchks = 0;
 
-  // FIXME: use the SbOctTree optimization, as above. Should refactor
-  // doPrimitiveIntersectionTesting() and
-  // doInternalPrimitiveIntersectionTesting() into common
-  // code. 20030328 mortene.
+  ReportClosure data;
+  data.thisp = this;
+  data.primitives1 = primitives;
+  data.primitives2 = primitives;
+  data.pair = pair;
+  data.resp = SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+  data.nrhits = 0;
 
-  cont = TRUE;
-  const int numprimitives = primitives->numTriangles();
-  for (int i = 0; i < numprimitives; i++ ) {
-    SbTri3f * t1 = static_cast<SbTri3f *>(primitives->getTriangle(i));
-    for (int j = i + 1; j < numprimitives; j++ ) {
-      SbTri3f * t2 = static_cast<SbTri3f *>(primitives->getTriangle(j));
-      nrisectchks++;
-      if ( t1->intersect(*t2) ) {
-        SoIntersectingPrimitive p1;
-        p1.path = primitives->getPath();
-        p1.type = SoIntersectingPrimitive::TRIANGLE;
-        t1->getValue(p1.xf_vertex[0], p1.xf_vertex[1], p1.xf_vertex[2]);
-        primitives->invtransform.multVecMatrix(p1.xf_vertex[0], p1.vertex[0]);
-        primitives->invtransform.multVecMatrix(p1.xf_vertex[1], p1.vertex[1]);
-        primitives->invtransform.multVecMatrix(p1.xf_vertex[2], p1.vertex[2]);
-
-        SoIntersectingPrimitive p2;
-        p2.path = primitives->getPath();
-        p2.type = SoIntersectingPrimitive::TRIANGLE;
-        t2->getValue(p2.xf_vertex[0], p2.xf_vertex[1], p2.xf_vertex[2]);
-        primitives->invtransform.multVecMatrix(p2.xf_vertex[0], p2.vertex[0]);
-        primitives->invtransform.multVecMatrix(p2.xf_vertex[1], p2.vertex[1]);
-        primitives->invtransform.multVecMatrix(p2.xf_vertex[2], p2.vertex[2]);
-
-        std::vector<SoIntersectionCallback>::iterator it = this->callbacks.begin();
-        while (it != this->callbacks.end()) {
-          switch ( (*it).first((*it).second, &p1, &p2) ) {
-          case SoIntersectionDetectionAction::NEXT_PRIMITIVE:
-            break;
-          case SoIntersectionDetectionAction::NEXT_SHAPE:
-            cont = TRUE;
-            goto done;
-          case SoIntersectionDetectionAction::ABORT:
-            cont = FALSE;
-            goto done;
-          default:
-            assert(0);
-          }
-          ++it;
-        }
+  const SbBool complete = find_hits(primitives, primitives, primitives->getTree(),
+                                    0.0f, PImpl::reportHitCB, &data, nrisectchks);
+  if (complete && pair) { pair->complete = TRUE; }
+  cont = (data.resp != SoIntersectionDetectionAction::ABORT);
+
+  // for debugging
+  if (ida_debug()) {
+    SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting",
+                           "intersection checks = %d", nrisectchks);
+  }
+}
+
+// *************************************************************************
+
+static SbBool
+record_hit(void * closure, const int tri1, const int tri2)
+{
+  SbList<int> * hits = static_cast<SbList<int> *>(closure);
+  hits->append(tri1);
+  hits->append(tri2);
+  return TRUE;
+}
+
+// Shared by the threads testing shape pairs, each doing a range of
+// the jobs.
+struct ida_worker_closure {
+  std::vector<PairJob *> * work;
+  float epsilon;
+};
+
+static void
+pair_worker(void * closure, int first, int last)
+{
+  ida_worker_closure * data = static_cast<ida_worker_closure *>(closure);
+  for (int idx = first; idx < last; idx++) {
+    PairJob * job = (*data->work)[idx];
+    PrimitiveData * iterationprims = job->primitives1;
+    PrimitiveData * treeprims = job->primitives2;
+    float epsilon = 0.0f;
+    if (iterationprims != treeprims) {
+      epsilon = data->epsilon;
+      if (iterationprims->numTriangles() >= treeprims->numTriangles()) {
+        iterationprims = job->primitives2;
+        treeprims = job->primitives1;
       }
     }
+    // the tree was made by doParallelPairIntersectionTesting(), so
+    // this doesn't modify treeprims
+    (void) find_hits(iterationprims, treeprims, treeprims->getTree(), epsilon,
+                     record_hit, &job->pair->hits, job->nrisectchks);
+    job->pair->complete = TRUE;
   }
- done:
-  // for debugging
+}
+
+// Intersection testing of the shape pairs in jobs, using several
+// threads. Everything touching the scene graph, and the lazy set up
+// of triangles and trees, is done in this thread first. The worker
+// threads then only record the hits of each pair, and the callbacks
+// are invoked afterwards, in the order of the jobs.
+void
+SoIntersectionDetectionAction::PImpl::doParallelPairIntersectionTesting(std::vector<PairJob> & jobs,
+                                                                        SbBool & cont)
+{
+  cont = TRUE;
+  if (jobs.empty()) return;
+
+  // not thread safe the first time it is called
+  (void) coin_runtime_simd();
+
+  std::vector<PairJob *> work;
+  size_t i;
+  for (i = 0; i < jobs.size(); i++) {
+    PairJob & job = jobs[i];
+    if (this->persistent) {
+      job.pair = this->getPairData(job.shape1, job.shape2);
+      if (pair_is_current(job.pair, job.shape1, job.shape2)) continue;
+    }
+    else {
+      job.pair = new PairData;
+    }
+    job.primitives1 = job.shape1->getPrimitives(this->persistent);
+    job.primitives2 = job.shape2->getPrimitives(this->persistent);
+    this->startPair(job.pair, job.shape1, job.primitives1, job.shape2, job.primitives2);
+    (void) job.primitives1->getTree();
+    (void) job.primitives2->getTree();
+    work.push_back(&job);
+  }
+
   if (ida_debug()) {
-    SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doInternalPrimitiveIntersectionTesting",
+    SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doParallelPairIntersectionTesting",
+                           "testing %d of %d shape pairs in %d threads",
+                           static_cast<int>(work.size()), static_cast<int>(jobs.size()),
+                           this->numthreads);
+  }
+
+  ida_worker_closure data;
+  data.work = &work;
+  data.epsilon = this->getEpsilon();
+
+  cc_parallel_for(static_cast<int>(work.size()), 1, this->numthreads,
+                  pair_worker, &data);
+
+  if (ida_debug()) {
+    unsigned int nrisectchks = 0;
+    for (i = 0; i < work.size(); i++) { nrisectchks += work[i]->nrisectchks; }
+    SoDebugError::postInfo("SoIntersectionDetectionAction::PImpl::doParallelPairIntersectionTesting",
                            "intersection checks = %d", nrisectchks);
   }
+
+  for (i = 0; i < jobs.size() && cont; i++) {
+    this->replayHits(jobs[i].pair, jobs[i].shape1, jobs[i].shape2, cont);
+  }
+
+  if (!this->persistent) {
+    for (i = 0; i < jobs.size(); i++) { delete jobs[i].pair; }
+  }
 }
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+#include <vector>
+
+static SoIntersectionDetectionAction::Resp
+count_hits(void * closure, const SoIntersectingPrimitive *, const SoIntersectingPrimitive *)
+{
+  (*static_cast<int *>(closure))++;
+  return SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
+
+BOOST_AUTO_TEST_CASE(persistentMode)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoTranslation * translations[3];
+  SoCube * cubes[3];
+  for (int i = 0; i < 3; i++) {
+    SoSeparator * sep = new SoSeparator;
+    translations[i] = new SoTranslation;
+    translations[i]->translation.setValue(1.5f * i, 0.25f * i, 0.0f);
+    cubes[i] = new SoCube;
+    sep->addChild(translations[i]);
+    sep->addChild(cubes[i]);
+    root->addChild(sep);
+  }
+
+  int hits = 0;
+  SoIntersectionDetectionAction reference;
+  reference.addIntersectionCallback(count_hits, &hits);
+  reference.apply(root);
+  const int refhits = hits;
+  BOOST_CHECK_MESSAGE(refhits > 0, "neighbouring cubes should intersect");
+
+  SoIntersectionDetectionAction ida;
+  ida.setPersistent(TRUE);
+  ida.addIntersectionCallback(count_hits, &hits);
+  hits = 0;
+  ida.apply(root);
+  BOOST_CHECK_EQUAL(hits, refhits);
+  // nothing changed, stored results are reported
+  hits = 0;
+  ida.apply(root);
+  BOOST_CHECK_EQUAL(hits, refhits);
+
+  // moving the middle cube away leaves no intersections
+  translations[1]->translation.setValue(0.0f, 10.0f, 0.0f);
+  hits = 0;
+  ida.apply(root);
+  BOOST_CHECK_EQUAL(hits, 0);
+
+  translations[1]->translation.setValue(1.5f, 0.25f, 0.0f);
+  hits = 0;
+  ida.apply(root);
+  BOOST_CHECK_EQUAL(hits, refhits);
+
+  // shrinking the cubes changes their geometry
+  for (int j = 0; j < 3; j++) { cubes[j]->width = 1.0f; }
+  hits = 0;
+  ida.apply(root);
+  BOOST_CHECK_EQUAL(hits, 0);
+
+  // removed shapes are forgotten
+  for (int k = 0; k < 3; k++) { cubes[k]->width = 2.0f; }
+  root->removeChild(2);
+  hits = 0;
+  reference.apply(root);
+  const int twohits = hits;
+  hits = 0;
+  ida.apply(root);
+  BOOST_CHECK_EQUAL(hits, twohits);
+  BOOST_CHECK(twohits > 0 && twohits < refhits);
+
+  root->unref();
+}
+
+static SoIntersectionDetectionAction::Resp
+record_hits(void * closure, const SoIntersectingPrimitive * p1, const SoIntersectingPrimitive * p2)
+{
+  std::vector<SbVec3f> * hits = static_cast<std::vector<SbVec3f> *>(closure);
+  hits->push_back(p1->xf_vertex[0]);
+  hits->push_back(p2->xf_vertex[0]);
+  return SoIntersectionDetectionAction::NEXT_PRIMITIVE;
+}
+
+BOOST_AUTO_TEST_CASE(parallelTesting)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  for (int i = 0; i < 6; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * translation = new SoTranslation;
+    translation->translation.setValue(1.5f * (i % 3), 1.5f * (i / 3), 0.1f * i);
+    sep->addChild(translation);
+    if (i % 2) { sep->addChild(new SoCube); }
+    else { sep->addChild(new SoSphere); }
+    root->addChild(sep);
+  }
+
+  std::vector<SbVec3f> reference;
+  SoIntersectionDetectionAction serial;
+  serial.setNumThreads(1);
+  serial.addIntersectionCallback(record_hits, &reference);
+  serial.apply(root);
+  BOOST_CHECK_MESSAGE(!reference.empty(), "neighbouring shapes should intersect");
+
+  std::vector<SbVec3f> hits;
+  SoIntersectionDetectionAction parallel;
+  parallel.setNumThreads(4);
+  BOOST_CHECK_EQUAL(parallel.getNumThreads(), 4);
+  parallel.addIntersectionCallback(record_hits, &hits);
+  parallel.apply(root);
+  BOOST_CHECK_MESSAGE(hits == reference, "hits should be reported in the same order");
+
+  // the same in persistent mode, with stored results the second time
+  parallel.setPersistent(TRUE);
+  for (int j = 0; j < 2; j++) {
+    hits.clear();
+    parallel.apply(root);
+    BOOST_CHECK_MESSAGE(hits == reference, "stored hits should be reported in the same order");
+  }
+
+  reference.clear();
+  serial.setIntersectionDetectionEpsilon(0.1f);
+  serial.apply(root);
+  hits.clear();
+  parallel.setIntersectionDetectionEpsilon(0.1f);
+  parallel.apply(root);
+  BOOST_CHECK_MESSAGE(hits == reference, "hits within epsilon should be the same");
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -1,2 +1,4 @@
 #include "SbTri3f.cpp"
+#include "SbBoxTree.cpp"
+#include "SoDistanceAction.cpp"
 #include "SoIntersectionDetectionAction.cpp"
@@ -1276,6 +1276,141 @@ SoGLLazyElement::mergeCacheInfo(SoState * state,
   elt->cachebitmask |= childpoststate->cachebitmask;
 }
 
+/*!
+  Copies the OpenGL state this element has last sent into \a glstate.
+  Call send() first if the current Coin state should be included.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoGLLazyElement::getGLState(const SoState * state, SoGLLazyElement::GLState * glstate)
+{
+  const SoGLLazyElement * elem = getInstance(state);
+  *glstate = elem->glstate;
+  glstate->cachebitmask = 0;
+}
+
+/*!
+  Sends the parts of \a glstate selected by \a mask to OpenGL. This
+  is used to restore a state stored with getGLState() without changing
+  the Coin state, for instance when replaying a render cache. Only the
+  values that differ from what this element has already sent are
+  sent.
+
+  \COIN_FUNCTION_EXTENSION
+
+  \since Coin 4.0
+*/
+void
+SoGLLazyElement::sendGLState(const SoState * state,
+                             const SoGLLazyElement::GLState * glstate,
+                             uint32_t mask)
+{
+  const SoGLLazyElement * elem = getInstance(state);
+
+  for (int i = 0; (i < LAZYCASES_LAST)&&mask; i++, mask>>=1) {
+    if (mask&1) {
+      switch (i) {
+      case LIGHT_MODEL_CASE:
+        if (glstate->lightmodel >= 0 &&
+            glstate->lightmodel != elem->glstate.lightmodel) {
+          elem->sendLightModel(glstate->lightmodel);
+        }
+        break;
+      case DIFFUSE_CASE:
+        if (glstate->diffuse != elem->glstate.diffuse) {
+          elem->sendPackedDiffuse(glstate->diffuse);
+        }
+        break;
+      case AMBIENT_CASE:
+        if (glstate->ambient != elem->glstate.ambient) {
+          elem->sendAmbient(glstate->ambient);
+        }
+        break;
+      case SPECULAR_CASE:
+        if (glstate->specular != elem->glstate.specular) {
+          elem->sendSpecular(glstate->specular);
+        }
+        break;
+      case EMISSIVE_CASE:
+        if (glstate->emissive != elem->glstate.emissive) {
+          elem->sendEmissive(glstate->emissive);
+        }
+        break;
+      case SHININESS_CASE:
+        if (glstate->shininess >= 0.0f &&
+            glstate->shininess != elem->glstate.shininess) {
+          elem->sendShininess(glstate->shininess);
+        }
+        break;
+      case BLENDING_CASE:
+        if (glstate->blending > 0) {
+          if (elem->glstate.blending != glstate->blending ||
+              elem->glstate.blend_sfactor != glstate->blend_sfactor ||
+              elem->glstate.blend_dfactor != glstate->blend_dfactor ||
+              elem->glstate.alpha_blend_sfactor != glstate->alpha_blend_sfactor ||
+              elem->glstate.alpha_blend_dfactor != glstate->alpha_blend_dfactor) {
+            if ((glstate->alpha_blend_sfactor != 0) &&
+                (glstate->alpha_blend_dfactor != 0)) {
+              elem->enableSeparateBlending(cc_glglue_instance(SoGLCacheContextElement::get((SoState*)state)),
+                                           glstate->blend_sfactor,
+                                           glstate->blend_dfactor,
+                                           glstate->alpha_blend_sfactor,
+                                           glstate->alpha_blend_dfactor);
+            }
+            else {
+              elem->enableBlending(glstate->blend_sfactor, glstate->blend_dfactor);
+            }
+          }
+        }
+        else if (glstate->blending == 0 && elem->glstate.blending != 0) {
+          elem->disableBlending();
+        }
+        break;
+      case TRANSPARENCY_CASE:
+        if (glstate->stipplenum >= 0 &&
+            glstate->stipplenum != elem->glstate.stipplenum) {
+          elem->sendTransparency(glstate->stipplenum);
+        }
+        break;
+      case VERTEXORDERING_CASE:
+        if (glstate->vertexordering >= 0 &&
+            glstate->vertexordering != elem->glstate.vertexordering) {
+          elem->sendVertexOrdering((VertexOrdering) glstate->vertexordering);
+        }
+        break;
+      case CULLING_CASE:
+        if (glstate->culling >= 0 &&
+            glstate->culling != elem->glstate.culling) {
+          elem->sendBackfaceCulling(glstate->culling);
+        }
+        break;
+      case TWOSIDE_CASE:
+        if (glstate->twoside >= 0 &&
+            glstate->twoside != elem->glstate.twoside) {
+          elem->sendTwosideLighting(glstate->twoside);
+        }
+        break;
+      case SHADE_MODEL_CASE:
+        if (glstate->flatshading >= 0 &&
+            glstate->flatshading != elem->glstate.flatshading) {
+          elem->sendFlatshading(glstate->flatshading);
+        }
+        break;
+      case ALPHATEST_CASE:
+        if (glstate->alphatestfunc >= 0 &&
+            (glstate->alphatestfunc != elem->glstate.alphatestfunc ||
+             glstate->alphatestvalue != elem->glstate.alphatestvalue)) {
+          elem->sendAlphaTest(glstate->alphatestfunc, glstate->alphatestvalue);
+        }
+        break;
+      }
+    }
+  }
+}
+
 #undef FLAG_FORCE_DIFFUSE
 #undef FLAG_DIFFUSE_DEPENDENCY
 #undef GLLAZY_DEBUG
@@ -298,6 +298,7 @@
 
 #include "elements/SoTextureScalePolicyElement.h" // internal element
 #include "elements/SoTextureScaleQualityElement.h" // internal  element
+#include "elements/SoTextureAtlasElement.h" // internal element
 #include "tidbitsp.h"
 #include "coindefs.h"
 
@@ -451,6 +452,7 @@ SoElement::initElements(void)
 
   SoTextureScalePolicyElement::initClass();
   SoTextureScaleQualityElement::initClass();
+  SoTextureAtlasElement::initClass();
 
   SoListenerPositionElement::initClass();
   SoListenerOrientationElement::initClass();
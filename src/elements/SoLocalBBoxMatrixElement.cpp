@@ -34,6 +34,8 @@
 #include <Inventor/elements/SoLocalBBoxMatrixElement.h>
 #include <Inventor/misc/SoState.h>
 
+#include "misc/SoStateP.h"
+
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
 #endif // COIN_DEBUG
@@ -258,8 +260,18 @@ SoLocalBBoxMatrixElement::resetAll(SoState * const state)
      state->getElement(getClassStackIndex())
      );
   while (element) {
+    SoLocalBBoxMatrixElement * next =
+      coin_safe_cast<SoLocalBBoxMatrixElement*>(element->getNextInStack());
+    // elements used by a state snapshot are replaced, not modified
+    if (SoStateP::isShared(state, classStackIndex, element)) {
+      SoLocalBBoxMatrixElement * copy =
+        static_cast<SoLocalBBoxMatrixElement *>(element->getTypeId().createInstance());
+      copy->modelInverseMatrix = element->modelInverseMatrix;
+      SoStateP::replaceElement(state, classStackIndex, element, copy);
+      element = copy;
+    }
     element->localMatrix.makeIdentity();
-    element = coin_safe_cast<SoLocalBBoxMatrixElement*>(element->getNextInStack());
+    element = next;
   }
 }
 
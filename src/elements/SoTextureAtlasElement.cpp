@@ -0,0 +1,189 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SoTextureAtlasElement Inventor/elements/SoTextureAtlasElement.h
+  \brief The SoTextureAtlasElement class keeps track of atlas remapping
+  matrices merged into the texture matrix.
+  \ingroup elements
+
+  When an SoTexture2 node has been packed into a shared atlas page, it
+  multiplies a remapping matrix onto the texture matrix so that the
+  shape's texture coordinates address its own cell in the page. This
+  element stores the texture matrix from before and after the
+  remapping for each unit, so that the next texture node on the same
+  unit can strip the remapping again before it applies its own.
+
+  This is currently an internal Coin element. The header file is not
+  installed, and the API for this element might change without notice.
+
+  \since Coin 4.0
+*/
+
+#include "elements/SoTextureAtlasElement.h"
+
+#include <cassert>
+
+#include "SbBasicP.h"
+
+SO_ELEMENT_SOURCE(SoTextureAtlasElement);
+
+/*!
+  This static method initializes static data for the
+  SoTextureAtlasElement class.
+*/
+void
+SoTextureAtlasElement::initClass(void)
+{
+  SO_ELEMENT_INIT_CLASS(SoTextureAtlasElement, inherited);
+}
+
+/*!
+  The destructor.
+*/
+SoTextureAtlasElement::~SoTextureAtlasElement(void)
+{
+}
+
+// doc from parent
+void
+SoTextureAtlasElement::init(SoState * COIN_UNUSED_ARG(state))
+{
+  for (int i = 0; i < MAX_UNITS; i++) {
+    this->active[i] = FALSE;
+    this->base[i] = SbMatrix::identity();
+    this->remapped[i] = SbMatrix::identity();
+  }
+}
+
+// doc from parent
+void
+SoTextureAtlasElement::push(SoState * COIN_UNUSED_ARG(state))
+{
+  const SoTextureAtlasElement * prev =
+    coin_assert_cast<const SoTextureAtlasElement *>(this->getNextInStack());
+  for (int i = 0; i < MAX_UNITS; i++) {
+    this->active[i] = prev->active[i];
+    this->base[i] = prev->base[i];
+    this->remapped[i] = prev->remapped[i];
+  }
+}
+
+// doc from parent
+SbBool
+SoTextureAtlasElement::matches(const SoElement * elem) const
+{
+  const SoTextureAtlasElement * e =
+    coin_assert_cast<const SoTextureAtlasElement *>(elem);
+  for (int i = 0; i < MAX_UNITS; i++) {
+    if (e->active[i] != this->active[i]) return FALSE;
+    if (this->active[i] &&
+        (e->base[i] != this->base[i] || e->remapped[i] != this->remapped[i])) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// doc from parent
+SoElement *
+SoTextureAtlasElement::copyMatchInfo(void) const
+{
+  SoTextureAtlasElement * elem =
+    static_cast<SoTextureAtlasElement *>(this->getTypeId().createInstance());
+  for (int i = 0; i < MAX_UNITS; i++) {
+    elem->active[i] = this->active[i];
+    elem->base[i] = this->base[i];
+    elem->remapped[i] = this->remapped[i];
+  }
+  return elem;
+}
+
+/*!
+  Records that the texture matrix for \a unit has been changed from
+  \a base to \a remapped to address a cell in an atlas page.
+*/
+void
+SoTextureAtlasElement::set(SoState * state, SoNode * COIN_UNUSED_ARG(node),
+                           const int unit, const SbMatrix & base,
+                           const SbMatrix & remapped)
+{
+  if (unit < 0 || unit >= MAX_UNITS) return;
+  SoTextureAtlasElement * elem =
+    coin_safe_cast<SoTextureAtlasElement *>
+    (state->getElement(classStackIndex));
+  if (elem) {
+    elem->active[unit] = TRUE;
+    elem->base[unit] = base;
+    elem->remapped[unit] = remapped;
+  }
+}
+
+/*!
+  Records that no atlas remapping is active for \a unit.
+*/
+void
+SoTextureAtlasElement::clear(SoState * state, SoNode * COIN_UNUSED_ARG(node),
+                             const int unit)
+{
+  if (unit < 0 || unit >= MAX_UNITS) return;
+  SoTextureAtlasElement * elem =
+    coin_safe_cast<SoTextureAtlasElement *>
+    (state->getElement(classStackIndex));
+  if (elem) {
+    elem->active[unit] = FALSE;
+    elem->base[unit] = SbMatrix::identity();
+    elem->remapped[unit] = SbMatrix::identity();
+  }
+}
+
+/*!
+  Returns \c TRUE if an atlas remapping is active for \a unit, and
+  sets \a stripped to \a current without the remapping. If the texture
+  matrix hasn't changed since the remapping was applied, the matrix
+  from before the remapping is returned unchanged. Otherwise texture
+  transforms have been applied since, and the remapping is undone
+  with its inverse.
+*/
+SbBool
+SoTextureAtlasElement::strip(SoState * state, const int unit,
+                             const SbMatrix & current, SbMatrix & stripped)
+{
+  if (unit < 0 || unit >= MAX_UNITS) return FALSE;
+  const SoTextureAtlasElement * elem =
+    coin_assert_cast<const SoTextureAtlasElement *>
+    (getConstElement(state, classStackIndex));
+  if (!elem->active[unit]) return FALSE;
+
+  if (current == elem->remapped[unit]) {
+    stripped = elem->base[unit];
+  }
+  else {
+    // texture transforms are multiplied from the left, so current is
+    // T * remapped, and T * base is wanted
+    stripped = current;
+    stripped.multRight(elem->remapped[unit].inverse());
+    stripped.multRight(elem->base[unit]);
+  }
+  return TRUE;
+}
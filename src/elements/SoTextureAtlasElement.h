@@ -0,0 +1,65 @@
+#ifndef COIN_SOTEXTUREATLASELEMENT_H
+#define COIN_SOTEXTUREATLASELEMENT_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif // !COIN_INTERNAL
+
+#include <Inventor/elements/SoElement.h>
+#include <Inventor/elements/SoSubElement.h>
+#include <Inventor/SbMatrix.h>
+
+class SoTextureAtlasElement : public SoElement {
+  typedef SoElement inherited;
+
+  SO_ELEMENT_HEADER(SoTextureAtlasElement);
+
+public:
+  static void initClass(void);
+protected:
+  virtual ~SoTextureAtlasElement();
+
+public:
+  enum { MAX_UNITS = 8 };
+
+  virtual void init(SoState * state);
+  virtual void push(SoState * state);
+  virtual SbBool matches(const SoElement * elem) const;
+  virtual SoElement * copyMatchInfo(void) const;
+
+  static void set(SoState * state, SoNode * node, const int unit,
+                  const SbMatrix & base, const SbMatrix & remapped);
+  static void clear(SoState * state, SoNode * node, const int unit);
+  static SbBool strip(SoState * state, const int unit,
+                      const SbMatrix & current, SbMatrix & stripped);
+
+private:
+  SbBool active[MAX_UNITS];
+  SbMatrix base[MAX_UNITS];
+  SbMatrix remapped[MAX_UNITS];
+};
+
+#endif // !COIN_SOTEXTUREATLASELEMENT_H
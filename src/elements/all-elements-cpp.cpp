@@ -93,6 +93,7 @@
 #include "SoTextureQualityElement.cpp"
 #include "SoTextureScalePolicyElement.cpp"
 #include "SoTextureScaleQualityElement.cpp"
+#include "SoTextureAtlasElement.cpp"
 #include "SoTextureUnitElement.cpp"
 #include "SoTransparencyElement.cpp"
 #include "SoUnitsElement.cpp"
@@ -192,6 +192,14 @@
   of the DirectionalLight, even though the Cube is rendered without
   lighting because of the BASE_COLOR LightModel.
 
+  Internally, the expressions are compiled into a flat instruction
+  list which is run for batches of input values at a time. This is
+  much faster than interpreting the expressions once per value for
+  inputs with many values. Expressions using \e rand(), or reading a
+  temporary variable before it is written, are interpreted as
+  before. Set the environment variable COIN_NO_COMPILED_CALCULATOR
+  to "1" to always interpret the expressions.
+
 */
 
 #include <Inventor/engines/SoCalculator.h>
@@ -199,8 +207,10 @@
 #include "SbBasicP.h"
 
 #include <cassert>
+#include <cstdlib>
 
 #include <Inventor/lists/SoEngineOutputList.h>
+#include <Inventor/C/tidbits.h>
 
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
@@ -320,6 +330,14 @@ public:
   float oa_od[4];
   SbVec3f oA_oD[4];
   SbList <struct so_eval_node*> evaluatorList;
+
+  so_eval_program * program;
+  SbBool triedcompile;
+
+  void clearExpressions(void);
+  void evaluateCompiled(SoCalculator * master, const int maxnum,
+                        const char * inused, const char * outused);
+  static SbBool useCompiled(void);
 };
 
 #define PRIVATE(thisp) (thisp->pimpl)
@@ -333,6 +351,8 @@ SO_ENGINE_SOURCE(SoCalculator);
 SoCalculator::SoCalculator(void)
 {
   PRIVATE(this) = new SoCalculatorP;
+  PRIVATE(this)->program = NULL;
+  PRIVATE(this)->triedcompile = FALSE;
 
   SO_ENGINE_INTERNAL_CONSTRUCTOR(SoCalculator);
 
@@ -376,9 +396,7 @@ SoCalculator::SoCalculator(void)
 */
 SoCalculator::~SoCalculator(void)
 {
-  for (int i = 0; i < PRIVATE(this)->evaluatorList.getLength(); i++) {
-    so_eval_delete(PRIVATE(this)->evaluatorList[i]);
-  }
+  PRIVATE(this)->clearExpressions();
   delete PRIVATE(this);
 }
 
@@ -414,6 +432,15 @@ SoCalculator::evaluate(void)
     }
   }
 
+  if (!PRIVATE(this)->triedcompile) {
+    PRIVATE(this)->triedcompile = TRUE;
+    if (SoCalculatorP::useCompiled()) {
+      PRIVATE(this)->program =
+        so_eval_compile(PRIVATE(this)->evaluatorList.getArrayPtr(),
+                        PRIVATE(this)->evaluatorList.getLength());
+    }
+  }
+
 
   // find all fields used in all expressions
   int maxnum = 0;
@@ -453,6 +480,11 @@ SoCalculator::evaluate(void)
   if (outused[6]) { SO_ENGINE_OUTPUT(oC, SoMFVec3f, setNum(maxnum)); }
   if (outused[7]) { SO_ENGINE_OUTPUT(oD, SoMFVec3f, setNum(maxnum)); }
 
+  if (PRIVATE(this)->program) {
+    PRIVATE(this)->evaluateCompiled(this, maxnum, inused, outused);
+    return;
+  }
+
   // loop through all fieldindices and evaluate
   for (i = 0; i < maxnum; i++) {
     // just initialize output registers to default values
@@ -595,10 +627,7 @@ SoCalculator::inputChanged(SoField *which)
 {
   // if expression changes we have to rebuild the eval tree structure
   if (which == &this->expression) {
-    for (int i = 0; i < PRIVATE(this)->evaluatorList.getLength(); i++) {
-      so_eval_delete(PRIVATE(this)->evaluatorList[i]);
-    }
-    PRIVATE(this)->evaluatorList.truncate(0);
+    PRIVATE(this)->clearExpressions();
   }
 }
 
@@ -699,5 +728,207 @@ SoCalculator::writefieldcb(const char *fieldname, float *data,
   }
 }
 
+// *************************************************************************
+
+void
+SoCalculatorP::clearExpressions(void)
+{
+  for (int i = 0; i < this->evaluatorList.getLength(); i++) {
+    so_eval_delete(this->evaluatorList[i]);
+  }
+  this->evaluatorList.truncate(0);
+  so_eval_program_delete(this->program);
+  this->program = NULL;
+  this->triedcompile = FALSE;
+}
+
+SbBool
+SoCalculatorP::useCompiled(void)
+{
+  static int usecompiled = -1;
+  if (usecompiled == -1) {
+    const char * env = coin_getenv("COIN_NO_COMPILED_CALCULATOR");
+    usecompiled = (env && atoi(env) > 0) ? 0 : 1;
+  }
+  return usecompiled ? TRUE : FALSE;
+}
+
+// Evaluates the compiled expressions for all field indices, in
+// batches of SO_EVAL_BATCHSIZE. The input values are copied into the
+// program registers with the same index clamping as in
+// SoCalculator::evaluateExpression(), and the results are written
+// to the engine outputs with one setValues() call per batch.
+void
+SoCalculatorP::evaluateCompiled(SoCalculator * master, const int maxnum,
+                                const char * inused, const char * outused)
+{
+  int i, j, k;
+  char regname[3];
+  regname[2] = 0;
+
+  // temporary registers keep their values between field indices, so
+  // seed them with the current values and store the values from the
+  // last field index back afterwards
+  regname[0] = 't';
+  for (i = 0; i < 8; i++) {
+    regname[1] = 'a' + i;
+    float * dst = so_eval_program_register(this->program, regname, 0);
+    for (k = 0; k < SO_EVAL_BATCHSIZE; k++) dst[k] = this->ta_th[i];
+    regname[1] = 'A' + i;
+    for (j = 0; j < 3; j++) {
+      dst = so_eval_program_register(this->program, regname, j);
+      for (k = 0; k < SO_EVAL_BATCHSIZE; k++) dst[k] = this->tA_tH[i][j];
+    }
+  }
+
+  SbVec3f vecbuf[SO_EVAL_BATCHSIZE];
+  int last = 0;
+
+  for (int start = 0; start < maxnum; start += SO_EVAL_BATCHSIZE) {
+    const int num = SbMin(maxnum - start, SO_EVAL_BATCHSIZE);
+    last = num - 1;
+
+    regname[1] = 0;
+    for (i = 0; i < 8; i++) {
+      if (!inused[i]) continue;
+      regname[0] = 'a' + i;
+      SoMFFloat * field = coin_assert_cast<SoMFFloat *>(master->getField(regname));
+      const int fieldnum = field->getNum();
+      const float * src = fieldnum ? field->getValues(0) : NULL;
+      float * dst = so_eval_program_register(this->program, regname, 0);
+      for (k = 0; k < num; k++) {
+        dst[k] = src ? src[SbMin(start + k, fieldnum - 1)] : 0.0f;
+      }
+    }
+    for (i = 0; i < 8; i++) {
+      if (!inused[i+8]) continue;
+      regname[0] = 'A' + i;
+      SoMFVec3f * field = coin_assert_cast<SoMFVec3f *>(master->getField(regname));
+      const int fieldnum = field->getNum();
+      const SbVec3f * src = fieldnum ? field->getValues(0) : NULL;
+      for (j = 0; j < 3; j++) {
+        float * dst = so_eval_program_register(this->program, regname, j);
+        for (k = 0; k < num; k++) {
+          dst[k] = src ? src[SbMin(start + k, fieldnum - 1)][j] : 0.0f;
+        }
+      }
+    }
+
+    so_eval_program_run(this->program, num);
+
+    regname[0] = 'o';
+    for (i = 0; i < 4; i++) {
+      if (!outused[i]) continue;
+      regname[1] = 'a' + i;
+      const float * res = so_eval_program_register(this->program, regname, 0);
+      SoEngineOutput * out = NULL;
+      switch (i) {
+      case 0: out = &master->oa; break;
+      case 1: out = &master->ob; break;
+      case 2: out = &master->oc; break;
+      default: out = &master->od; break;
+      }
+      SO_ENGINE_OUTPUT((*out), SoMFFloat, setValues(start, num, res));
+    }
+    for (i = 0; i < 4; i++) {
+      if (!outused[i+4]) continue;
+      regname[1] = 'A' + i;
+      for (j = 0; j < 3; j++) {
+        const float * res = so_eval_program_register(this->program, regname, j);
+        for (k = 0; k < num; k++) vecbuf[k][j] = res[k];
+      }
+      SoEngineOutput * out = NULL;
+      switch (i) {
+      case 0: out = &master->oA; break;
+      case 1: out = &master->oB; break;
+      case 2: out = &master->oC; break;
+      default: out = &master->oD; break;
+      }
+      SO_ENGINE_OUTPUT((*out), SoMFVec3f, setValues(start, num, vecbuf));
+    }
+  }
+
+  regname[0] = 't';
+  for (i = 0; i < 8; i++) {
+    regname[1] = 'a' + i;
+    this->ta_th[i] = so_eval_program_register(this->program, regname, 0)[last];
+    regname[1] = 'A' + i;
+    for (j = 0; j < 3; j++) {
+      this->tA_tH[i][j] = so_eval_program_register(this->program, regname, j)[last];
+    }
+  }
+}
+
 #undef THISP
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoMaterial.h>
+
+BOOST_AUTO_TEST_CASE(evaluateManyValues)
+{
+  const int num = 1000; // several batches, the last one partial
+  SoCalculator * calc = new SoCalculator;
+  calc->ref();
+  SoMaterial * mat = new SoMaterial;
+  mat->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->ref();
+
+  int i;
+  for (i = 0; i < num; i++) {
+    calc->a.set1Value(i, float(i) * 0.5f);
+    calc->A.set1Value(i, SbVec3f(float(i), 1.0f, -float(i)));
+  }
+  calc->b.setValue(2.0f); // clamped to the last (only) value
+  calc->expression.set1Value(0, "ta = a * b; oa = ta > 10 ? ta - 10 : fabs(ta)");
+  calc->expression.set1Value(1, "oA = A * a + vec3f(b, 0, oa); oA[1] = dot(A, A)");
+
+  mat->transparency.connectFrom(&calc->oa);
+  coords->point.connectFrom(&calc->oA);
+
+  BOOST_CHECK_EQUAL(mat->transparency.getNum(), num);
+  BOOST_CHECK_EQUAL(coords->point.getNum(), num);
+
+  SbBool ok = TRUE;
+  for (i = 0; i < num && ok; i++) {
+    const float a = float(i) * 0.5f;
+    const SbVec3f A(float(i), 1.0f, -float(i));
+    const float ta = a * 2.0f;
+    const float oa = ta > 10.0f ? ta - 10.0f : float(fabs(ta));
+    const SbVec3f oA(A[0] * a + 2.0f, A[0]*A[0] + A[1]*A[1] + A[2]*A[2], A[2] * a + oa);
+    ok = (mat->transparency[i] == oa) && (coords->point[i] == oA);
+  }
+  BOOST_CHECK_MESSAGE(ok, "unexpected result from expressions");
+
+  coords->unref();
+  mat->unref();
+  calc->unref();
+}
+
+BOOST_AUTO_TEST_CASE(temporaryCarriedOver)
+{
+  // reading a temporary before it is written gives the value from the
+  // previous field index
+  SoCalculator * calc = new SoCalculator;
+  calc->ref();
+  SoMaterial * mat = new SoMaterial;
+  mat->ref();
+
+  const float values[] = { 1.0f, 2.0f, 3.0f, 4.0f };
+  calc->a.setValues(0, 4, values);
+  calc->expression.setValue("oa = ta; ta = a");
+  mat->transparency.connectFrom(&calc->oa);
+
+  BOOST_CHECK_EQUAL(mat->transparency.getNum(), 4);
+  BOOST_CHECK_EQUAL(mat->transparency[0], 0.0f);
+  BOOST_CHECK_EQUAL(mat->transparency[1], 1.0f);
+  BOOST_CHECK_EQUAL(mat->transparency[3], 3.0f);
+
+  mat->unref();
+  calc->unref();
+}
+
+#endif // COIN_TEST_SUITE
@@ -36,12 +36,26 @@
 
 #include <Inventor/engines/SoInterpolate.h>
 #include <Inventor/lists/SoEngineOutputList.h>
+#include <Inventor/fields/SoMFFloat.h>
+#include <Inventor/fields/SoMFVec2f.h>
+#include <Inventor/fields/SoMFVec3f.h>
+#include <Inventor/fields/SoMFVec4f.h>
+#include <Inventor/fields/SoMFRotation.h>
 
 #if COIN_DEBUG
 #include <Inventor/errors/SoDebugError.h>
 #endif // COIN_DEBUG
 
 #include "engines/SoSubEngineP.h"
+#include "engines/SoInterpolateP.h"
+#include "tidbitsp.h"
+
+#ifdef COIN_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif // COIN_HAVE_X86_SIMD
+#ifdef COIN_HAVE_NEON_SIMD
+#include <arm_neon.h>
+#endif // COIN_HAVE_NEON_SIMD
 
 /*!
   \var SoSFFloat SoInterpolate::alpha
@@ -114,3 +128,282 @@ SoInterpolate::~SoInterpolate()
   delete this->inputdata; this->inputdata = NULL;
   delete this->outputdata; this->outputdata = NULL;
 }
+
+// *************************************************************************
+
+// The SIMD versions of the lerp kernel use separate multiply and add
+// instructions (no fused multiply-add), so that the results are
+// identical to the plain C++ version.
+
+typedef void lerp_func(const float * v0, const float * v1, float * result,
+                       const int num, const float t);
+
+static void
+lerp_c(const float * v0, const float * v1, float * result,
+       const int num, const float t)
+{
+  for (int i = 0; i < num; i++) {
+    result[i] = (v1[i] - v0[i]) * t + v0[i];
+  }
+}
+
+#ifdef COIN_HAVE_X86_SIMD
+
+static COIN_TARGET_SSE2 void
+lerp_sse2(const float * v0, const float * v1, float * result,
+          const int num, const float t)
+{
+  const __m128 tv = _mm_set1_ps(t);
+  int i = 0;
+  for (; i + 4 <= num; i += 4) {
+    const __m128 a = _mm_loadu_ps(v0 + i);
+    const __m128 b = _mm_loadu_ps(v1 + i);
+    _mm_storeu_ps(result + i, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(b, a), tv), a));
+  }
+  lerp_c(v0 + i, v1 + i, result + i, num - i, t);
+}
+
+static COIN_TARGET_AVX void
+lerp_avx(const float * v0, const float * v1, float * result,
+         const int num, const float t)
+{
+  const __m256 tv = _mm256_set1_ps(t);
+  int i = 0;
+  for (; i + 8 <= num; i += 8) {
+    const __m256 a = _mm256_loadu_ps(v0 + i);
+    const __m256 b = _mm256_loadu_ps(v1 + i);
+    _mm256_storeu_ps(result + i, _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(b, a), tv), a));
+  }
+  lerp_c(v0 + i, v1 + i, result + i, num - i, t);
+}
+
+#endif // COIN_HAVE_X86_SIMD
+
+#ifdef COIN_HAVE_NEON_SIMD
+
+static void
+lerp_neon(const float * v0, const float * v1, float * result,
+          const int num, const float t)
+{
+  const float32x4_t tv = vdupq_n_f32(t);
+  int i = 0;
+  for (; i + 4 <= num; i += 4) {
+    const float32x4_t a = vld1q_f32(v0 + i);
+    const float32x4_t b = vld1q_f32(v1 + i);
+    vst1q_f32(result + i, vaddq_f32(vmulq_f32(vsubq_f32(b, a), tv), a));
+  }
+  lerp_c(v0 + i, v1 + i, result + i, num - i, t);
+}
+
+#endif // COIN_HAVE_NEON_SIMD
+
+/*!
+  \internal
+
+  Sets result[i] = v0[i] + (v1[i] - v0[i]) * t for i in [0, num>.
+*/
+void
+SoInterpolateP::lerp(const float * v0, const float * v1, float * result,
+                     const int num, const float t)
+{
+  static lerp_func * lerpfunc = NULL;
+  if (lerpfunc == NULL) {
+    switch (coin_runtime_simd()) {
+#ifdef COIN_HAVE_X86_SIMD
+    case COIN_SIMD_AVX:
+    case COIN_SIMD_AVX2:
+      lerpfunc = lerp_avx;
+      break;
+    case COIN_SIMD_SSE2:
+      lerpfunc = lerp_sse2;
+      break;
+#endif // COIN_HAVE_X86_SIMD
+#ifdef COIN_HAVE_NEON_SIMD
+    case COIN_SIMD_NEON:
+      lerpfunc = lerp_neon;
+      break;
+#endif // COIN_HAVE_NEON_SIMD
+    default:
+      lerpfunc = lerp_c;
+      break;
+    }
+  }
+  lerpfunc(v0, v1, result, num, t);
+}
+
+/*!
+  \internal
+
+  Spherical linear interpolation of \a num rotations, as
+  SbRotation::slerp().
+*/
+void
+SoInterpolateP::slerp(const SbRotation * r0, const SbRotation * r1,
+                      SbRotation * result, const int num, float t)
+{
+#if COIN_DEBUG
+  // check once here instead of in SbRotation::slerp() for each value
+  if (t < 0.0f || t > 1.0f) {
+    SoDebugError::postWarning("SoInterpolateP::slerp",
+                              "The t parameter (%f) is out of bounds [0,1]. "
+                              "Clamping to bounds.", t);
+    if (t < 0.0f) t = 0.0f;
+    else if (t > 1.0f) t = 1.0f;
+  }
+#endif // COIN_DEBUG
+  for (int i = 0; i < num; i++) {
+    result[i] = SbRotation::slerp(r0[i], r1[i], t);
+  }
+}
+
+// Runs the interpolation for all fields connected to the output. The
+// values are arrays of NUMFLOATS floats.
+template <class FieldType, int NUMFLOATS>
+static void
+interpolate_floats(SoEngineOutput & output, const FieldType & input0,
+                   const FieldType & input1, const float t)
+{
+  if (!output.isEnabled()) return;
+
+  const int n0 = input0.getNum();
+  const int n1 = input1.getNum();
+  const int num = (n0 && n1) ? SbMax(n0, n1) : 0;
+  const int common = SbMin(n0, n1);
+  const float * v0 = n0 ? reinterpret_cast<const float *>(input0.getValues(0)) : NULL;
+  const float * v1 = n1 ? reinterpret_cast<const float *>(input1.getValues(0)) : NULL;
+
+  for (int c = 0; c < output.getNumConnections(); c++) {
+    FieldType * field = static_cast<FieldType *>(output[c]);
+    if (field->isReadOnly()) continue;
+    field->setNum(num);
+    if (num == 0) continue;
+    float * result = reinterpret_cast<float *>(field->startEditing());
+    SoInterpolateP::lerp(v0, v1, result, common * NUMFLOATS, t);
+    for (int i = common; i < num; i++) {
+      SoInterpolateP::lerp(v0 + SbMin(i, n0 - 1) * NUMFLOATS,
+                           v1 + SbMin(i, n1 - 1) * NUMFLOATS,
+                           result + i * NUMFLOATS, NUMFLOATS, t);
+    }
+    field->finishEditing();
+  }
+}
+
+void
+SoInterpolateP::evaluate(SoEngineOutput & output, const SoMFFloat & input0,
+                         const SoMFFloat & input1, const float t)
+{
+  interpolate_floats<SoMFFloat, 1>(output, input0, input1, t);
+}
+
+void
+SoInterpolateP::evaluate(SoEngineOutput & output, const SoMFVec2f & input0,
+                         const SoMFVec2f & input1, const float t)
+{
+  interpolate_floats<SoMFVec2f, 2>(output, input0, input1, t);
+}
+
+void
+SoInterpolateP::evaluate(SoEngineOutput & output, const SoMFVec3f & input0,
+                         const SoMFVec3f & input1, const float t)
+{
+  interpolate_floats<SoMFVec3f, 3>(output, input0, input1, t);
+}
+
+void
+SoInterpolateP::evaluate(SoEngineOutput & output, const SoMFVec4f & input0,
+                         const SoMFVec4f & input1, const float t)
+{
+  interpolate_floats<SoMFVec4f, 4>(output, input0, input1, t);
+}
+
+void
+SoInterpolateP::evaluate(SoEngineOutput & output, const SoMFRotation & input0,
+                         const SoMFRotation & input1, const float t)
+{
+  if (!output.isEnabled()) return;
+
+  const int n0 = input0.getNum();
+  const int n1 = input1.getNum();
+  const int num = (n0 && n1) ? SbMax(n0, n1) : 0;
+  const int common = SbMin(n0, n1);
+  const SbRotation * r0 = input0.getValues(0);
+  const SbRotation * r1 = input1.getValues(0);
+
+  for (int c = 0; c < output.getNumConnections(); c++) {
+    SoMFRotation * field = static_cast<SoMFRotation *>(output[c]);
+    if (field->isReadOnly()) continue;
+    field->setNum(num);
+    if (num == 0) continue;
+    SbRotation * result = field->startEditing();
+    SoInterpolateP::slerp(r0, r1, result, common, t);
+    for (int i = common; i < num; i++) {
+      SoInterpolateP::slerp(r0 + SbMin(i, n0 - 1), r1 + SbMin(i, n1 - 1),
+                            result + i, 1, t);
+    }
+    field->finishEditing();
+  }
+}
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/engines/SoInterpolateVec3f.h>
+#include <Inventor/engines/SoInterpolateRotation.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoTransform.h>
+
+BOOST_AUTO_TEST_CASE(interpolateVec3f)
+{
+  SoInterpolateVec3f * interp = new SoInterpolateVec3f;
+  interp->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->ref();
+
+  // input1 is shorter, so its last value is reused
+  const int n0 = 37, n1 = 30;
+  int i;
+  for (i = 0; i < n0; i++) {
+    interp->input0.set1Value(i, SbVec3f(float(i), -1.5f * i, 0.25f));
+  }
+  for (i = 0; i < n1; i++) {
+    interp->input1.set1Value(i, SbVec3f(0.1f * i, float(i * i), -3.0f));
+  }
+  interp->alpha.setValue(0.3f);
+  coords->point.connectFrom(&interp->output);
+
+  BOOST_CHECK_EQUAL(coords->point.getNum(), n0);
+  SbBool ok = TRUE;
+  for (i = 0; i < n0 && ok; i++) {
+    const SbVec3f v0 = interp->input0[i];
+    const SbVec3f v1 = interp->input1[SbMin(i, n1 - 1)];
+    ok = (coords->point[i] == (v1 - v0) * 0.3f + v0);
+  }
+  BOOST_CHECK_MESSAGE(ok, "unexpected interpolated value");
+
+  interp->input1.setNum(0);
+  BOOST_CHECK_EQUAL(coords->point.getNum(), 0);
+
+  coords->unref();
+  interp->unref();
+}
+
+BOOST_AUTO_TEST_CASE(interpolateRotation)
+{
+  SoInterpolateRotation * interp = new SoInterpolateRotation;
+  interp->ref();
+  SoTransform * xf = new SoTransform;
+  xf->ref();
+
+  const SbRotation r0(SbVec3f(0.0f, 1.0f, 0.0f), 0.5f);
+  const SbRotation r1(SbVec3f(1.0f, 0.0f, 0.0f), 2.0f);
+  interp->input0.setValue(r0);
+  interp->input1.setValue(r1);
+  interp->alpha.setValue(0.75f);
+  xf->rotation.connectFrom(&interp->output);
+
+  BOOST_CHECK(xf->rotation.getValue() == SbRotation::slerp(r0, r1, 0.75f));
+
+  xf->unref();
+  interp->unref();
+}
+
+#endif // COIN_TEST_SUITE
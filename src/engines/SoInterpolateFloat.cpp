@@ -30,6 +30,7 @@
 #include <Inventor/engines/SoInterpolateFloat.h>
 
 #include "engines/SoSubEngineP.h"
+#include "engines/SoInterpolateP.h"
 
 /*!
   \var SoMFFloat SoInterpolateFloat::input0
@@ -46,5 +47,4 @@ SO_INTERPOLATE_INTERNAL_SOURCE(SoInterpolateFloat,
                                SoMFFloat,
                                float,
                                (0.0f),
-                               (1.0f),
-                               (v1-v0)*a+v0);
+                               (1.0f));
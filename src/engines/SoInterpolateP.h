@@ -0,0 +1,67 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_SOINTERPOLATEP_H
+#define COIN_SOINTERPOLATEP_H
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif // !COIN_INTERNAL
+
+class SoEngineOutput;
+class SoMFFloat;
+class SoMFVec2f;
+class SoMFVec3f;
+class SoMFVec4f;
+class SoMFRotation;
+class SbRotation;
+
+// Interpolation kernels for the SoInterpolate engines and the VRML97
+// interpolator nodes. The kernels work on whole arrays, using SIMD
+// instructions when available (selected at runtime), and give the
+// same results as evaluating v0 + (v1 - v0) * t for each value.
+
+class SoInterpolateP {
+public:
+  static void lerp(const float * v0, const float * v1, float * result,
+                   const int num, const float t);
+  static void slerp(const SbRotation * r0, const SbRotation * r1,
+                    SbRotation * result, const int num, const float t);
+
+  // Interpolates between the inputs and writes the result directly
+  // into the fields connected to output. If the inputs have a
+  // different number of values, the last value of the shorter input
+  // is used for the remaining values.
+  static void evaluate(SoEngineOutput & output, const SoMFFloat & input0,
+                       const SoMFFloat & input1, const float t);
+  static void evaluate(SoEngineOutput & output, const SoMFVec2f & input0,
+                       const SoMFVec2f & input1, const float t);
+  static void evaluate(SoEngineOutput & output, const SoMFVec3f & input0,
+                       const SoMFVec3f & input1, const float t);
+  static void evaluate(SoEngineOutput & output, const SoMFVec4f & input0,
+                       const SoMFVec4f & input1, const float t);
+  static void evaluate(SoEngineOutput & output, const SoMFRotation & input0,
+                       const SoMFRotation & input1, const float t);
+};
+
+#endif // !COIN_SOINTERPOLATEP_H
@@ -31,6 +31,7 @@
 #include <Inventor/SbVec3f.h>
 
 #include "engines/SoSubEngineP.h"
+#include "engines/SoInterpolateP.h"
 
 /*!
   \var SoMFRotation SoInterpolateRotation::input0
@@ -47,5 +48,4 @@ SO_INTERPOLATE_INTERNAL_SOURCE(SoInterpolateRotation,
                                SoMFRotation,
                                SbRotation,
                                (SbVec3f(0.0f,0.0f,1.0f),0.0f),
-                               (SbVec3f(0.0f,0.0f,1.0f),0.0f),
-                               SbRotation::slerp(v0,v1,a));
+                               (SbVec3f(0.0f,0.0f,1.0f),0.0f));
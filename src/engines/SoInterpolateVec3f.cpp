@@ -30,6 +30,7 @@
 #include <Inventor/engines/SoInterpolateVec3f.h>
 
 #include "engines/SoSubEngineP.h"
+#include "engines/SoInterpolateP.h"
 
 /*!
   \var SoMFVec3f SoInterpolateVec3f::input0
@@ -46,5 +47,4 @@ SO_INTERPOLATE_INTERNAL_SOURCE(SoInterpolateVec3f,
                                SoMFVec3f,
                                SbVec3f,
                                (0.0f,0.0f,0.0f),
-                               (0.0f,0.0f,0.0f),
-                               (v1-v0)*a+v0);
+                               (0.0f,0.0f,0.0f));
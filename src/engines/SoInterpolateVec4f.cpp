@@ -30,6 +30,7 @@
 #include <Inventor/engines/SoInterpolateVec4f.h>
 
 #include "engines/SoSubEngineP.h"
+#include "engines/SoInterpolateP.h"
 
 /*!
   \var SoMFVec4f SoInterpolateVec4f::input0
@@ -46,5 +47,4 @@ SO_INTERPOLATE_INTERNAL_SOURCE(SoInterpolateVec4f,
                                SoMFVec4f,
                                SbVec4f,
                                (0.0f,0.0f,0.0f,0.0f),
-                               (0.0f,0.0f,0.0f,0.0f),
-                               (v1-v0)*a+v0);
+                               (0.0f,0.0f,0.0f,0.0f));
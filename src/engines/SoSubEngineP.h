@@ -76,7 +76,11 @@ _class_::initClass(void) \
 }
 
 
-#define SO_INTERPOLATE_INTERNAL_SOURCE(_class_, _type_, _valtype_, _default0_, _default1_, _interpexp_) \
+// The builtin interpolators do not use PRIVATE_SO_INTERPOLATE_EVALUATE,
+// but the array kernels in SoInterpolateP, which write directly into
+// the connected fields.
+
+#define SO_INTERPOLATE_INTERNAL_SOURCE(_class_, _type_, _valtype_, _default0_, _default1_) \
  \
 SO_ENGINE_SOURCE(_class_); \
  \
@@ -87,7 +91,13 @@ _class_::_class_(void) \
 } \
  \
 PRIVATE_SO_INTERPOLATE_DESTRUCTOR(_class_) \
-PRIVATE_SO_INTERPOLATE_EVALUATE(_class_, _type_, _valtype_, _interpexp_)
+ \
+void \
+_class_::evaluate(void) \
+{ \
+  SoInterpolateP::evaluate(this->output, this->input0, this->input1, \
+                           this->alpha.getValue()); \
+}
 
 
 #define SO_INTERNAL_ENGINE_SOURCE_DYNAMIC_IO(_class_) \
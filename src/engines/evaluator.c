@@ -467,3 +467,572 @@ so_eval_delete(so_eval_node *node)
     free(node);
   }
 }
+
+/* ********************************************************************** */
+
+/*
+ * Compiled evaluation.
+ *
+ * The tree structure is flattened into a list of instructions which
+ * operate on "slots". A slot holds SO_EVAL_BATCHSIZE floats, one for
+ * each field index being evaluated, so that a single pass through
+ * the instruction list evaluates a whole batch of field indices. The
+ * inner loops are simple enough for the compiler to vectorize.
+ *
+ * Vectors occupy three consecutive slots (x, y and z), and boolean
+ * values are stored as 0.0f or 1.0f. The named registers have fixed
+ * slots, followed by constants and intermediate results.
+ *
+ * The result for each field index is identical to what
+ * so_eval_evaluate() would produce. Expressions where this can not
+ * be guaranteed are rejected by so_eval_compile(): rand() (the order
+ * of rand() calls would change), and reading a temporary register
+ * before it has been written for the current field index (the value
+ * would otherwise be carried over from the previous field index).
+ */
+
+enum {
+  SLOT_IN_FLT = 0,   /* a-h */
+  SLOT_TMP_FLT = 8,  /* ta-th */
+  SLOT_OUT_FLT = 16, /* oa-od */
+  SLOT_IN_VEC = 20,  /* A-H, three slots each */
+  SLOT_TMP_VEC = 44, /* tA-tH, three slots each */
+  SLOT_OUT_VEC = 68, /* oA-oD, three slots each */
+  SLOT_NUM_NAMED = 80
+};
+
+/* pseudo instruction id, not used in the tree structure */
+#define ID_COPY -1
+
+typedef struct {
+  int id;
+  int dst;
+  int src[3];
+} so_eval_instr;
+
+struct so_eval_program {
+  so_eval_instr * instr;
+  int numinstr;
+  int maxinstr;
+  int numslots;
+  float * slots;
+};
+
+typedef struct {
+  so_eval_program * program;
+  int * constslot;
+  float * constvalue;
+  int numconstants;
+  int maxconstants;
+  char written[SLOT_NUM_NAMED];
+  int failed;
+} so_eval_compiler;
+
+#define SLOT(program, idx) ((program)->slots + (idx) * SO_EVAL_BATCHSIZE)
+
+/*
+ * returns the (first) slot for a named register.
+ */
+static int
+register_slot(const char * regname, int comp)
+{
+  char c;
+  if (regname[0] == 'o') {
+    c = regname[1];
+    if (c >= 'A' && c <= 'D') return SLOT_OUT_VEC + (c - 'A') * 3 + comp;
+    return SLOT_OUT_FLT + (c - 'a');
+  }
+  if (regname[0] == 't') {
+    c = regname[1];
+    if (c >= 'A' && c <= 'H') return SLOT_TMP_VEC + (c - 'A') * 3 + comp;
+    return SLOT_TMP_FLT + (c - 'a');
+  }
+  c = regname[0];
+  if (c >= 'A' && c <= 'H') return SLOT_IN_VEC + (c - 'A') * 3 + comp;
+  return SLOT_IN_FLT + (c - 'a');
+}
+
+static int
+is_tmp_slot(int slot)
+{
+  return
+    (slot >= SLOT_TMP_FLT && slot < SLOT_OUT_FLT) ||
+    (slot >= SLOT_TMP_VEC && slot < SLOT_OUT_VEC);
+}
+
+static int
+is_vec_node(const so_eval_node * node)
+{
+  switch (node->id) {
+  case ID_ADD_VEC:
+  case ID_SUB_VEC:
+  case ID_NEG_VEC:
+  case ID_CROSS:
+  case ID_NORMALIZE:
+  case ID_VEC3F:
+  case ID_VEC_REG:
+  case ID_VEC_COND:
+  case ID_MUL_VEC_FLT:
+  case ID_DIV_VEC_FLT:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static int
+alloc_slots(so_eval_compiler * c, int num)
+{
+  int slot = c->program->numslots;
+  c->program->numslots += num;
+  return slot;
+}
+
+static void
+emit(so_eval_compiler * c, int id, int dst, int src1, int src2, int src3)
+{
+  so_eval_program * p = c->program;
+  so_eval_instr * instr;
+  if (p->numinstr == p->maxinstr) {
+    p->maxinstr = p->maxinstr ? p->maxinstr * 2 : 32;
+    p->instr = (so_eval_instr*)
+      realloc(p->instr, p->maxinstr * sizeof(so_eval_instr));
+  }
+  instr = &p->instr[p->numinstr++];
+  instr->id = id;
+  instr->dst = dst;
+  instr->src[0] = src1;
+  instr->src[1] = src2;
+  instr->src[2] = src3;
+}
+
+static void
+check_read(so_eval_compiler * c, int slot)
+{
+  if (is_tmp_slot(slot) && !c->written[slot]) c->failed = 1;
+}
+
+/*
+ * compiles a (sub)tree. Returns the slot holding the result, or the
+ * first of three slots if the result is a vector.
+ */
+static int
+compile_node(so_eval_compiler * c, const so_eval_node * node)
+{
+  int src[3], dst, i;
+
+  if (node == NULL || c->failed) return -1;
+
+  switch (node->id) {
+  case ID_SEPARATOR:
+    (void) compile_node(c, node->child1);
+    (void) compile_node(c, node->child2);
+    return -1;
+  case ID_ASSIGN_FLT:
+    src[0] = compile_node(c, node->child2);
+    if (c->failed) return -1;
+    if (node->child1->id == ID_VEC_REG_COMP) {
+      if (node->child1->regidx < 0 || node->child1->regidx > 2) {
+        c->failed = 1;
+        return -1;
+      }
+      dst = register_slot(node->child1->regname, node->child1->regidx);
+    }
+    else {
+      dst = register_slot(node->child1->regname, 0);
+    }
+    emit(c, ID_COPY, dst, src[0], -1, -1);
+    c->written[dst] = 1;
+    return -1;
+  case ID_ASSIGN_VEC:
+    src[0] = compile_node(c, node->child2);
+    if (c->failed) return -1;
+    dst = register_slot(node->child1->regname, 0);
+    for (i = 0; i < 3; i++) {
+      emit(c, ID_COPY, dst + i, src[0] + i, -1, -1);
+      c->written[dst + i] = 1;
+    }
+    return -1;
+  case ID_FLT_REG:
+    dst = register_slot(node->regname, 0);
+    check_read(c, dst);
+    return dst;
+  case ID_VEC_REG:
+    dst = register_slot(node->regname, 0);
+    for (i = 0; i < 3; i++) check_read(c, dst + i);
+    return dst;
+  case ID_VEC_REG_COMP:
+    if (node->regidx < 0 || node->regidx > 2) {
+      c->failed = 1;
+      return -1;
+    }
+    dst = register_slot(node->regname, node->regidx);
+    check_read(c, dst);
+    return dst;
+  case ID_VALUE:
+    dst = alloc_slots(c, 1);
+    if (c->numconstants == c->maxconstants) {
+      c->maxconstants = c->maxconstants ? c->maxconstants * 2 : 16;
+      c->constslot = (int*) realloc(c->constslot, c->maxconstants * sizeof(int));
+      c->constvalue = (float*) realloc(c->constvalue, c->maxconstants * sizeof(float));
+    }
+    c->constslot[c->numconstants] = dst;
+    c->constvalue[c->numconstants++] = node->value;
+    return dst;
+  case ID_RAND:
+    c->failed = 1;
+    return -1;
+  default:
+    break;
+  }
+
+  src[0] = node->child1 ? compile_node(c, node->child1) : -1;
+  src[1] = node->child2 ? compile_node(c, node->child2) : -1;
+  src[2] = node->child3 ? compile_node(c, node->child3) : -1;
+  if (c->failed) return -1;
+
+  dst = alloc_slots(c, is_vec_node(node) ? 3 : 1);
+  emit(c, node->id, dst, src[0], src[1], src[2]);
+  return dst;
+}
+
+/*
+ * compiles the expression trees in nodes[0 .. numnodes-1] (evaluated
+ * in that order) into a program. NULL entries are ignored. Returns
+ * NULL if the expressions can not be compiled.
+ */
+so_eval_program *
+so_eval_compile(so_eval_node * const * nodes, int numnodes)
+{
+  so_eval_compiler c;
+  so_eval_program * program;
+  int i, j;
+
+  program = (so_eval_program*) malloc(sizeof(so_eval_program));
+  program->instr = NULL;
+  program->numinstr = 0;
+  program->maxinstr = 0;
+  program->numslots = SLOT_NUM_NAMED;
+  program->slots = NULL;
+
+  c.program = program;
+  c.constslot = NULL;
+  c.constvalue = NULL;
+  c.numconstants = 0;
+  c.maxconstants = 0;
+  c.failed = 0;
+  for (i = 0; i < SLOT_NUM_NAMED; i++) c.written[i] = 0;
+
+  for (i = 0; i < numnodes && !c.failed; i++) {
+    (void) compile_node(&c, nodes[i]);
+  }
+  if (c.failed) {
+    free(c.constslot);
+    free(c.constvalue);
+    so_eval_program_delete(program);
+    return NULL;
+  }
+
+  program->slots = (float*)
+    malloc(program->numslots * SO_EVAL_BATCHSIZE * sizeof(float));
+  for (i = 0; i < program->numslots * SO_EVAL_BATCHSIZE; i++) {
+    program->slots[i] = 0.0f;
+  }
+  /* constants are never written by the program, initialize them once */
+  for (i = 0; i < c.numconstants; i++) {
+    float * dst = SLOT(program, c.constslot[i]);
+    for (j = 0; j < SO_EVAL_BATCHSIZE; j++) dst[j] = c.constvalue[i];
+  }
+  free(c.constslot);
+  free(c.constvalue);
+  return program;
+}
+
+void
+so_eval_program_delete(so_eval_program * program)
+{
+  if (program) {
+    free(program->instr);
+    free(program->slots);
+    free(program);
+  }
+}
+
+/*
+ * returns a pointer to SO_EVAL_BATCHSIZE floats for the named
+ * register. Use this to set input values before, and read output
+ * values after, calling so_eval_program_run(). For vector registers,
+ * component selects x, y or z.
+ */
+float *
+so_eval_program_register(so_eval_program * program, const char * regname, int component)
+{
+  return SLOT(program, register_slot(regname, component));
+}
+
+/*
+ * runs the program for field indices [0, num>, num <= SO_EVAL_BATCHSIZE.
+ */
+void
+so_eval_program_run(so_eval_program * program, int num)
+{
+  int i, k;
+  float * dst, * d1, * d2;
+  const float * s1, * s2, * s3, * s4, * s5, * s6;
+
+  assert(num >= 0 && num <= SO_EVAL_BATCHSIZE);
+
+  /* output registers are reset for each field index */
+  dst = SLOT(program, SLOT_OUT_FLT);
+  for (k = 0; k < 4 * SO_EVAL_BATCHSIZE; k++) dst[k] = 0.0f;
+  dst = SLOT(program, SLOT_OUT_VEC);
+  for (k = 0; k < 12 * SO_EVAL_BATCHSIZE; k++) dst[k] = 0.0f;
+
+  for (i = 0; i < program->numinstr; i++) {
+    const so_eval_instr * instr = &program->instr[i];
+    dst = SLOT(program, instr->dst);
+    s1 = instr->src[0] >= 0 ? SLOT(program, instr->src[0]) : NULL;
+    s2 = instr->src[1] >= 0 ? SLOT(program, instr->src[1]) : NULL;
+    s3 = instr->src[2] >= 0 ? SLOT(program, instr->src[2]) : NULL;
+
+    switch (instr->id) {
+    case ID_COPY:
+      for (k = 0; k < num; k++) dst[k] = s1[k];
+      break;
+    case ID_ADD:
+      for (k = 0; k < num; k++) dst[k] = s1[k] + s2[k];
+      break;
+    case ID_SUB:
+      for (k = 0; k < num; k++) dst[k] = s1[k] - s2[k];
+      break;
+    case ID_MUL:
+      for (k = 0; k < num; k++) dst[k] = s1[k] * s2[k];
+      break;
+    case ID_DIV:
+      for (k = 0; k < num; k++) {
+        dst[k] = s2[k] == 0.0f ? s1[k] / FLT_EPSILON : s1[k] / s2[k];
+      }
+      break;
+    case ID_FMOD:
+      for (k = 0; k < num; k++) {
+        dst[k] = s2[k] != 0.0f ? (float) fmod(s1[k], s2[k]) : 0.0f;
+      }
+      break;
+    case ID_NEG:
+      for (k = 0; k < num; k++) dst[k] = - s1[k];
+      break;
+    case ID_AND:
+      for (k = 0; k < num; k++) dst[k] = (s1[k] != 0.0f && s2[k] != 0.0f) ? 1.0f : 0.0f;
+      break;
+    case ID_OR:
+      for (k = 0; k < num; k++) dst[k] = (s1[k] != 0.0f || s2[k] != 0.0f) ? 1.0f : 0.0f;
+      break;
+    case ID_NOT:
+      for (k = 0; k < num; k++) dst[k] = s1[k] == 0.0f ? 1.0f : 0.0f;
+      break;
+    case ID_LEQ:
+      for (k = 0; k < num; k++) dst[k] = s1[k] <= s2[k] ? 1.0f : 0.0f;
+      break;
+    case ID_GEQ:
+      for (k = 0; k < num; k++) dst[k] = s1[k] >= s2[k] ? 1.0f : 0.0f;
+      break;
+    case ID_LT:
+      for (k = 0; k < num; k++) dst[k] = s1[k] < s2[k] ? 1.0f : 0.0f;
+      break;
+    case ID_GT:
+      for (k = 0; k < num; k++) dst[k] = s1[k] > s2[k] ? 1.0f : 0.0f;
+      break;
+    case ID_EQ: /* for vectors, only the first component is compared */
+      for (k = 0; k < num; k++) dst[k] = s1[k] == s2[k] ? 1.0f : 0.0f;
+      break;
+    case ID_NEQ:
+      for (k = 0; k < num; k++) dst[k] = s1[k] != s2[k] ? 1.0f : 0.0f;
+      break;
+    case ID_COS:
+      for (k = 0; k < num; k++) dst[k] = (float) cos(s1[k]);
+      break;
+    case ID_SIN:
+      for (k = 0; k < num; k++) dst[k] = (float) sin(s1[k]);
+      break;
+    case ID_TAN:
+      for (k = 0; k < num; k++) dst[k] = (float) tan(s1[k]);
+      break;
+    case ID_ACOS:
+      for (k = 0; k < num; k++) dst[k] = (float) acos(clamp(s1[k], -1.0f, 1.0f));
+      break;
+    case ID_ASIN:
+      for (k = 0; k < num; k++) dst[k] = (float) asin(clamp(s1[k], -1.0f, 1.0f));
+      break;
+    case ID_ATAN:
+      for (k = 0; k < num; k++) dst[k] = (float) atan(s1[k]);
+      break;
+    case ID_ATAN2:
+      for (k = 0; k < num; k++) {
+        if (s2[k] == 0.0) {
+          dst[k] = (float) (s1[k] >= 0.0f ? M_PI * 0.5 : - M_PI * 0.5);
+        }
+        else {
+          dst[k] = (float) atan2(s1[k], s2[k]);
+        }
+      }
+      break;
+    case ID_COSH:
+      for (k = 0; k < num; k++) dst[k] = (float) cosh(s1[k]);
+      break;
+    case ID_SINH:
+      for (k = 0; k < num; k++) dst[k] = (float) sinh(s1[k]);
+      break;
+    case ID_TANH:
+      for (k = 0; k < num; k++) dst[k] = (float) tanh(s1[k]);
+      break;
+    case ID_SQRT:
+      for (k = 0; k < num; k++) dst[k] = s1[k] > 0.0f ? (float) sqrt(s1[k]) : 0.0f;
+      break;
+    case ID_EXP:
+      for (k = 0; k < num; k++) dst[k] = (float) exp(s1[k]);
+      break;
+    case ID_LOG:
+      for (k = 0; k < num; k++) dst[k] = s1[k] <= 0.0f ? -128.0f : (float) log(s1[k]);
+      break;
+    case ID_LOG10:
+      for (k = 0; k < num; k++) dst[k] = s1[k] <= 0.0f ? -38.0f : (float) log10(s1[k]);
+      break;
+    case ID_CEIL:
+      for (k = 0; k < num; k++) dst[k] = (float) ceil(s1[k]);
+      break;
+    case ID_FLOOR:
+      for (k = 0; k < num; k++) dst[k] = (float) floor(s1[k]);
+      break;
+    case ID_FABS:
+      for (k = 0; k < num; k++) dst[k] = (float) fabs(s1[k]);
+      break;
+    case ID_POW:
+      for (k = 0; k < num; k++) {
+        if (s1[k] == 0.0f) dst[k] = 0.0f;
+        else if (s1[k] > 0.0f) dst[k] = (float) pow(s1[k], s2[k]);
+        else dst[k] = (float) pow(s1[k], floor(s2[k] + 0.5));
+      }
+      break;
+    case ID_TEST_FLT:
+      for (k = 0; k < num; k++) dst[k] = s1[k] != 0.0f ? 1.0f : 0.0f;
+      break;
+    case ID_TEST_VEC:
+      s4 = s1 + SO_EVAL_BATCHSIZE;
+      s5 = s4 + SO_EVAL_BATCHSIZE;
+      for (k = 0; k < num; k++) {
+        dst[k] = (s1[k] != 0.0f || s4[k] != 0.0f || s5[k] != 0.0f) ? 1.0f : 0.0f;
+      }
+      break;
+    case ID_FLT_COND:
+      for (k = 0; k < num; k++) dst[k] = s1[k] != 0.0f ? s2[k] : s3[k];
+      break;
+    case ID_VEC_COND:
+      {
+        int c;
+        for (c = 0; c < 3; c++) {
+          d1 = dst + c * SO_EVAL_BATCHSIZE;
+          s4 = s2 + c * SO_EVAL_BATCHSIZE;
+          s5 = s3 + c * SO_EVAL_BATCHSIZE;
+          for (k = 0; k < num; k++) d1[k] = s1[k] != 0.0f ? s4[k] : s5[k];
+        }
+      }
+      break;
+    case ID_VEC3F:
+      d1 = dst + SO_EVAL_BATCHSIZE;
+      d2 = d1 + SO_EVAL_BATCHSIZE;
+      for (k = 0; k < num; k++) {
+        dst[k] = s1[k];
+        d1[k] = s2[k];
+        d2[k] = s3[k];
+      }
+      break;
+    case ID_ADD_VEC:
+      for (k = 0; k < num; k++) {
+        dst[k] = s1[k] + s2[k];
+        dst[k + SO_EVAL_BATCHSIZE] = s1[k + SO_EVAL_BATCHSIZE] + s2[k + SO_EVAL_BATCHSIZE];
+        dst[k + 2 * SO_EVAL_BATCHSIZE] = s1[k + 2 * SO_EVAL_BATCHSIZE] + s2[k + 2 * SO_EVAL_BATCHSIZE];
+      }
+      break;
+    case ID_SUB_VEC:
+      for (k = 0; k < num; k++) {
+        dst[k] = s1[k] - s2[k];
+        dst[k + SO_EVAL_BATCHSIZE] = s1[k + SO_EVAL_BATCHSIZE] - s2[k + SO_EVAL_BATCHSIZE];
+        dst[k + 2 * SO_EVAL_BATCHSIZE] = s1[k + 2 * SO_EVAL_BATCHSIZE] - s2[k + 2 * SO_EVAL_BATCHSIZE];
+      }
+      break;
+    case ID_NEG_VEC:
+      for (k = 0; k < num; k++) {
+        dst[k] = - s1[k];
+        dst[k + SO_EVAL_BATCHSIZE] = - s1[k + SO_EVAL_BATCHSIZE];
+        dst[k + 2 * SO_EVAL_BATCHSIZE] = - s1[k + 2 * SO_EVAL_BATCHSIZE];
+      }
+      break;
+    case ID_MUL_VEC_FLT:
+      for (k = 0; k < num; k++) {
+        dst[k] = s1[k] * s2[k];
+        dst[k + SO_EVAL_BATCHSIZE] = s1[k + SO_EVAL_BATCHSIZE] * s2[k];
+        dst[k + 2 * SO_EVAL_BATCHSIZE] = s1[k + 2 * SO_EVAL_BATCHSIZE] * s2[k];
+      }
+      break;
+    case ID_DIV_VEC_FLT:
+      for (k = 0; k < num; k++) {
+        float div = s2[k] == 0.0f ? FLT_EPSILON : s2[k];
+        dst[k] = s1[k] / div;
+        dst[k + SO_EVAL_BATCHSIZE] = s1[k + SO_EVAL_BATCHSIZE] / div;
+        dst[k + 2 * SO_EVAL_BATCHSIZE] = s1[k + 2 * SO_EVAL_BATCHSIZE] / div;
+      }
+      break;
+    case ID_CROSS:
+      s4 = s2 + SO_EVAL_BATCHSIZE;
+      s5 = s4 + SO_EVAL_BATCHSIZE;
+      s3 = s1 + 2 * SO_EVAL_BATCHSIZE;
+      s6 = s1 + SO_EVAL_BATCHSIZE;
+      d1 = dst + SO_EVAL_BATCHSIZE;
+      d2 = d1 + SO_EVAL_BATCHSIZE;
+      for (k = 0; k < num; k++) {
+        dst[k] = s6[k]*s5[k] - s3[k]*s4[k];
+        d1[k] = s3[k]*s2[k] - s1[k]*s5[k];
+        d2[k] = s1[k]*s4[k] - s6[k]*s2[k];
+      }
+      break;
+    case ID_DOT:
+      s4 = s2 + SO_EVAL_BATCHSIZE;
+      s5 = s4 + SO_EVAL_BATCHSIZE;
+      s3 = s1 + 2 * SO_EVAL_BATCHSIZE;
+      s6 = s1 + SO_EVAL_BATCHSIZE;
+      for (k = 0; k < num; k++) {
+        dst[k] = s1[k]*s2[k] + s6[k]*s4[k] + s3[k]*s5[k];
+      }
+      break;
+    case ID_LEN:
+      s3 = s1 + 2 * SO_EVAL_BATCHSIZE;
+      s6 = s1 + SO_EVAL_BATCHSIZE;
+      for (k = 0; k < num; k++) {
+        dst[k] = (float) sqrt(s1[k]*s1[k] + s6[k]*s6[k] + s3[k]*s3[k]);
+      }
+      break;
+    case ID_NORMALIZE:
+      s3 = s1 + 2 * SO_EVAL_BATCHSIZE;
+      s6 = s1 + SO_EVAL_BATCHSIZE;
+      d1 = dst + SO_EVAL_BATCHSIZE;
+      d2 = d1 + SO_EVAL_BATCHSIZE;
+      for (k = 0; k < num; k++) {
+        float len = (float) sqrt(s1[k]*s1[k] + s6[k]*s6[k] + s3[k]*s3[k]);
+        if (len > 0.0f) {
+          dst[k] = s1[k] / len;
+          d1[k] = s6[k] / len;
+          d2[k] = s3[k] / len;
+        }
+        else {
+          dst[k] = d1[k] = d2[k] = 0.0f;
+        }
+      }
+      break;
+    default:
+      assert(0 && "Whoops. Unknown instruction id!\n");
+      break;
+    }
+  }
+}
+
+#undef SLOT
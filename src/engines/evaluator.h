@@ -99,6 +99,18 @@ extern "C" {
   so_eval_node *so_eval_create_reg_comp(const char *regname, int index);
   so_eval_node *so_eval_create_flt_val(float val);
 
+  /* compiled expressions, evaluated for up to SO_EVAL_BATCHSIZE
+     field indices at a time. See evaluator.c for details. */
+#define SO_EVAL_BATCHSIZE 64
+
+  typedef struct so_eval_program so_eval_program;
+
+  /* returns NULL if the expressions can not be compiled */
+  so_eval_program *so_eval_compile(so_eval_node * const *nodes, int numnodes);
+  void so_eval_program_delete(so_eval_program *program);
+  float *so_eval_program_register(so_eval_program *program, const char *regname, int component);
+  void so_eval_program_run(so_eval_program *program, int num);
+
 
 /* node ids */
 enum {
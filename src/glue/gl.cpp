@@ -1811,6 +1811,38 @@ glglue_resolve_symbols(cc_glglue * w)
   }
 #endif /* GL_ARB_shader_objects */
 
+  w->glGetProgramBinary = NULL;
+  w->glProgramBinary = NULL;
+  w->glProgramParameteri = NULL;
+  w->has_program_binary = FALSE;
+  if (w->has_arb_shader_objects &&
+      (cc_glglue_glversion_matches_at_least(w, 4, 1, 0) ||
+       cc_glglue_glext_supported(w, "GL_ARB_get_program_binary"))) {
+    w->glGetProgramBinary = (COIN_PFNGLGETPROGRAMBINARYPROC)PROC(w, glGetProgramBinary);
+    w->glProgramBinary = (COIN_PFNGLPROGRAMBINARYPROC)PROC(w, glProgramBinary);
+    w->glProgramParameteri = (COIN_PFNGLPROGRAMPARAMETERIPROC)PROC(w, glProgramParameteri);
+    w->has_program_binary =
+      w->glGetProgramBinary && w->glProgramBinary && w->glProgramParameteri;
+  }
+
+  w->glMaxShaderCompilerThreadsKHR = NULL;
+  w->has_parallel_shader_compile = FALSE;
+  if (w->has_arb_shader_objects) {
+    if (cc_glglue_glext_supported(w, "GL_KHR_parallel_shader_compile")) {
+      w->glMaxShaderCompilerThreadsKHR = (COIN_PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)
+        PROC(w, glMaxShaderCompilerThreadsKHR);
+    }
+    else if (cc_glglue_glext_supported(w, "GL_ARB_parallel_shader_compile")) {
+      w->glMaxShaderCompilerThreadsKHR = (COIN_PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)
+        PROC(w, glMaxShaderCompilerThreadsARB);
+    }
+    if (w->glMaxShaderCompilerThreadsKHR) {
+      w->has_parallel_shader_compile = TRUE;
+      /* let the driver decide how many threads to use */
+      w->glMaxShaderCompilerThreadsKHR(0xffffffff);
+    }
+  }
+
   w->glGenQueries = NULL; /* so that cc_glglue_has_occlusion_query() works  */
 #if defined(GL_VERSION_1_5)
   if (cc_glglue_glversion_matches_at_least(w, 1, 5, 0)) {
@@ -3796,6 +3828,20 @@ cc_glglue_has_arb_shader_objects(const cc_glglue * glue)
   return glue->has_arb_shader_objects;
 }
 
+SbBool
+cc_glglue_has_program_binary(const cc_glglue * glue)
+{
+  if (!glglue_allow_newer_opengl(glue)) return FALSE;
+  return glue->has_program_binary;
+}
+
+SbBool
+cc_glglue_has_parallel_shader_compile(const cc_glglue * glue)
+{
+  if (!glglue_allow_newer_opengl(glue)) return FALSE;
+  return glue->has_parallel_shader_compile;
+}
+
 
 /* ARB_fragment_program functions */
 SbBool
@@ -498,6 +498,14 @@ typedef void (APIENTRY * COIN_PFNGLDETACHOBJECTARBPROC)(COIN_GLhandle, COIN_GLha
 typedef void (APIENTRY * COIN_PFNGLGETINFOLOGARBPROC)(COIN_GLhandle, GLsizei, GLsizei *, COIN_GLchar *);
 typedef void (APIENTRY * COIN_PFNGLLINKPROGRAMARBPROC)(COIN_GLhandle);
 typedef void (APIENTRY * COIN_PFNGLUSEPROGRAMOBJECTARBPROC)(COIN_GLhandle);
+
+/* Typedefs for GL_ARB_get_program_binary */
+typedef void (APIENTRY * COIN_PFNGLGETPROGRAMBINARYPROC)(COIN_GLhandle program, GLsizei bufsize, GLsizei * length, GLenum * binaryformat, GLvoid * binary);
+typedef void (APIENTRY * COIN_PFNGLPROGRAMBINARYPROC)(COIN_GLhandle program, GLenum binaryformat, const GLvoid * binary, GLsizei length);
+typedef void (APIENTRY * COIN_PFNGLPROGRAMPARAMETERIPROC)(COIN_GLhandle program, GLenum pname, GLint value);
+
+/* Typedefs for GL_KHR_parallel_shader_compile */
+typedef void (APIENTRY * COIN_PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
 typedef COIN_GLhandle (APIENTRY * COIN_PFNGLCREATEPROGRAMOBJECTARBPROC)(void);
 typedef void (APIENTRY * COIN_PFNGLUNIFORM1FVARBPROC)(COIN_GLhandle, GLsizei, const GLfloat *);
 typedef void (APIENTRY * COIN_PFNGLUNIFORM2FVARBPROC)(COIN_GLhandle, GLsizei, const GLfloat *);
@@ -788,6 +796,14 @@ struct cc_glglue {
   COIN_PFNGLUNIFORMMATRIX3FVARBPROC glUniformMatrix3fvARB;
   COIN_PFNGLUNIFORMMATRIX4FVARBPROC glUniformMatrix4fvARB;
 
+  /* program binaries */
+  COIN_PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+  COIN_PFNGLPROGRAMBINARYPROC glProgramBinary;
+  COIN_PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+
+  /* parallel shader compilation */
+  COIN_PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+
   COIN_PFNGLPUSHCLIENTATTRIBPROC glPushClientAttrib;
   COIN_PFNGLPOPCLIENTATTRIBPROC glPopClientAttrib;
 
@@ -850,6 +866,8 @@ struct cc_glglue {
   SbBool has_arb_vertex_program;
   SbBool has_arb_shader_objects;
   SbBool has_arb_vertex_shader;
+  SbBool has_program_binary;
+  SbBool has_parallel_shader_compile;
   SbBool has_texture_env_combine;
   SbBool has_fbo;
 
@@ -913,6 +931,14 @@ void coin_apply_normalization_cube_map(const cc_glglue * glue);
 /* ARB_shader_objects */
 SbBool cc_glglue_has_arb_shader_objects(const cc_glglue * glue);
 
+/* ARB_get_program_binary. Only supported together with shader objects. */
+SbBool cc_glglue_has_program_binary(const cc_glglue * glue);
+
+/* KHR_parallel_shader_compile. When supported, compile and link
+   status can be polled with GL_COMPLETION_STATUS_KHR without
+   blocking. */
+SbBool cc_glglue_has_parallel_shader_compile(const cc_glglue * glue);
+
 /* Moved from gl.h and added compressed parameter.
    Original function is deprecated for internal use.
 */
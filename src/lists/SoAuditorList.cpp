@@ -42,6 +42,8 @@
 #include <config.h>
 #endif // HAVE_CONFIG_H
 
+#include "misc/SoAuditorBuffer.h"
+
 #ifdef COIN_THREADSAFE
 #include "threads/recmutexp.h"
 // we need this lock to avoid that auditors are added/removed by one
@@ -179,17 +181,18 @@ SoAuditorList::notify(SoNotList * l)
     // FIXME: should perhaps use a more general mechanism to detect when
     // to ignore notification? (In SoFieldContainer::notify() -- based
     // on SoNotList::getTimeStamp()?) 20000304 mortene.
-    SbPList notified(num);
-
-    for (int i = 0; i < num; i++) {
-      void * auditor = this->getObject(i);
-      if (notified.find(auditor) == -1) {
-        // use a copy of 'l', since the notification list might change
-        // when auditors are notified
-        SoNotList listcopy(l);
-        this->doNotify(&listcopy, auditor, this->getType(i));
-        notified.append(auditor);
-      }
+    SoAuditorBuffer auditors;
+    int i;
+    for (i = 0; i < num; i++) {
+      auditors.append(this->getObject(i), this->getType(i));
+    }
+    const int numnotify = auditors.removeDuplicates();
+
+    for (i = 0; i < numnotify; i++) {
+      // use a copy of 'l', since the notification list might change
+      // when auditors are notified
+      SoNotList listcopy(l);
+      this->doNotify(&listcopy, auditors.getObject(i), auditors.getType(i));
     }
 
     // FIXME: it should be possible for the application programmer to
@@ -0,0 +1,139 @@
+#ifndef COIN_SOAUDITORBUFFER_H
+#define COIN_SOAUDITORBUFFER_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif // !COIN_INTERNAL
+
+#include <cstdlib>
+#include <Inventor/misc/SoNotification.h>
+
+// SoAuditorBuffer holds a snapshot of the auditors of an object (or
+// field) during one notification fan-out. The same auditor can be
+// registered several times (a node used more than once below the
+// same group, or more than once in an SoMFNode field), but it only
+// needs to receive the notification once, so removeDuplicates() is
+// called before the auditors are notified.
+//
+// Snapshots of up to INLINESIZE auditors are stored on the stack, as
+// this covers nearly all objects in a scene graph.
+
+class SoAuditorBuffer {
+public:
+  SoAuditorBuffer(void)
+    : num(0), size(INLINESIZE), entries(inlineentries) { }
+  ~SoAuditorBuffer() {
+    if (this->entries != this->inlineentries) delete[] this->entries;
+  }
+
+  void append(void * auditor, const SoNotRec::Type type) {
+    if (this->num == this->size) this->grow();
+    this->entries[this->num].auditor = auditor;
+    this->entries[this->num].type = type;
+    this->num++;
+  }
+
+  int getLength(void) const { return this->num; }
+  void * getObject(const int idx) const { return this->entries[idx].auditor; }
+  SoNotRec::Type getType(const int idx) const { return this->entries[idx].type; }
+
+  // Removes all but the first occurrence of each auditor, keeping the
+  // order of the remaining auditors. Returns the new length.
+  int removeDuplicates(void) {
+    if (this->num <= INLINESIZE) {
+      int cnt = 0;
+      for (int i = 0; i < this->num; i++) {
+        int j = 0;
+        while (j < cnt && this->entries[j].auditor != this->entries[i].auditor) j++;
+        if (j == cnt) this->entries[cnt++] = this->entries[i];
+      }
+      this->num = cnt;
+    }
+    else {
+      // sort by pointer (and original index, for stability) to find
+      // the duplicates in O(n log n) instead of O(n^2)
+      SortEntry * sorted = new SortEntry[this->num];
+      int i;
+      for (i = 0; i < this->num; i++) {
+        sorted[i].auditor = this->entries[i].auditor;
+        sorted[i].idx = i;
+      }
+      qsort(sorted, this->num, sizeof(SortEntry), SoAuditorBuffer::compare);
+      for (i = 1; i < this->num; i++) {
+        if (sorted[i].auditor == sorted[i-1].auditor) {
+          this->entries[sorted[i].idx].auditor = NULL;
+        }
+      }
+      delete[] sorted;
+      int cnt = 0;
+      for (i = 0; i < this->num; i++) {
+        if (this->entries[i].auditor) this->entries[cnt++] = this->entries[i];
+      }
+      this->num = cnt;
+    }
+    return this->num;
+  }
+
+private:
+  // not implemented, the buffer should only live on the stack
+  SoAuditorBuffer(const SoAuditorBuffer &);
+  SoAuditorBuffer & operator=(const SoAuditorBuffer &);
+
+  enum { INLINESIZE = 16 };
+
+  struct Entry {
+    void * auditor;
+    SoNotRec::Type type;
+  };
+  struct SortEntry {
+    void * auditor;
+    int idx;
+  };
+
+  static int compare(const void * a, const void * b) {
+    const SortEntry * ea = static_cast<const SortEntry *>(a);
+    const SortEntry * eb = static_cast<const SortEntry *>(b);
+    const uintptr_t pa = reinterpret_cast<uintptr_t>(ea->auditor);
+    const uintptr_t pb = reinterpret_cast<uintptr_t>(eb->auditor);
+    if (pa != pb) return pa < pb ? -1 : 1;
+    return ea->idx - eb->idx;
+  }
+
+  void grow(void) {
+    Entry * newentries = new Entry[this->size * 2];
+    for (int i = 0; i < this->num; i++) newentries[i] = this->entries[i];
+    if (this->entries != this->inlineentries) delete[] this->entries;
+    this->entries = newentries;
+    this->size *= 2;
+  }
+
+  int num;
+  int size;
+  Entry * entries;
+  Entry inlineentries[INLINESIZE];
+};
+
+#endif // !COIN_SOAUDITORBUFFER_H
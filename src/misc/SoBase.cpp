@@ -73,8 +73,10 @@
 #include <Inventor/misc/SoProto.h>
 #include <Inventor/misc/SoProtoInstance.h>
 #include <Inventor/sensors/SoDataSensor.h>
+#include <Inventor/annex/Profiler/SoProfiler.h>
 
 #include "misc/SoBaseP.h"
+#include "misc/SoAuditorBuffer.h"
 #include "nodes/SoUnknownNode.h"
 #include "fields/SoGlobalField.h"
 #include "misc/SbHash.h"
@@ -83,6 +85,7 @@
 #include "tidbitsp.h"
 #include "io/SoInputP.h"
 #include "io/SoWriterefCounter.h"
+#include "profiler/SoProfilerP.h"
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -794,13 +797,29 @@ SoBase::notify(SoNotList * l)
   SoDebugError::postInfo("SoBase::notify", "base %p, list %p", this, l);
 #endif // debug
 
-  SoBase::PImpl::NotifyData notdata;
-  notdata.cnt = cc_rbptree_size(&this->auditortree);
-  notdata.list = l;
-  notdata.thisp = this;
+  if (SoProfiler::isEnabled()) {
+    SoProfilerP::countNotification(this->getTypeId());
+  }
 
-  cc_rbptree_traverse(&this->auditortree, (cc_rbptree_traversecb *)SoBase::PImpl::rbptree_notify_cb, &notdata);
-  assert(notdata.cnt == 0);
+  // Collect the auditors first, so that an auditor registered more
+  // than once (e.g. a group with the same child several times, or an
+  // SoMFNode field with the same node in several slots) is only
+  // notified once.
+  SoAuditorBuffer auditors;
+  cc_rbptree_traverse(&this->auditortree, (cc_rbptree_traversecb *)SoBase::PImpl::rbptree_collect_cb, &auditors);
+  const int num = auditors.removeDuplicates();
+
+  for (int i = 0; i < num; i++) {
+    if (i == num - 1) {
+      this->doNotify(l, auditors.getObject(i), auditors.getType(i));
+    }
+    else {
+      // use a copy of 'l', since the notification list might change
+      // when auditors are notified
+      SoNotList listcopy(l);
+      this->doNotify(&listcopy, auditors.getObject(i), auditors.getType(i));
+    }
+  }
 }
 
 /*!
@@ -863,12 +882,13 @@ SoBase::getAuditors(void) const
   if (iter!=SoBase::PImpl::auditordict->const_end()) {
     l = iter->obj;
     // empty list before copying in new values
-    for (int i = 0; i < l->getLength(); i++) {
+    for (int i = l->getLength() - 1; i >= 0; i--) {
       l->remove(i);
     }
   }
   else {
-    (*SoBase::PImpl::auditordict)[this] = new SoAuditorList;
+    l = new SoAuditorList;
+    (*SoBase::PImpl::auditordict)[this] = l;
   }
   cc_rbptree_traverse(&this->auditortree, (cc_rbptree_traversecb*)sobase_audlist_add, (void*) l);
 
@@ -1816,6 +1836,75 @@ DEF root Separator {
 	   newroot->unref();
  }
 
+#include <Inventor/fields/SoMFNode.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/sensors/SoFieldSensor.h>
+#include <Inventor/lists/SoTypeList.h>
+#include <Inventor/annex/Profiler/SoProfiler.h>
+
+static void
+count_sensor_cb(void * closure, SoSensor *)
+{
+  (*static_cast<int *>(closure))++;
+}
+
+BOOST_AUTO_TEST_CASE(notifyAuditorOnce)
+{
+  SoCube * cube = new SoCube;
+  cube->ref();
+
+  // the field is an auditor of the cube once for each slot
+  SoMFNode field;
+  field.set1Value(0, cube);
+  field.set1Value(1, cube);
+  field.set1Value(2, cube);
+
+  int count = 0;
+  SoFieldSensor sensor(count_sensor_cb, &count);
+  sensor.setPriority(0);
+  sensor.attach(&field);
+
+  cube->width = 2.0f;
+  BOOST_CHECK_MESSAGE(count == 1, "field should be notified once");
+
+  sensor.detach();
+  field.setNum(0);
+  cube->unref();
+}
+
+BOOST_AUTO_TEST_CASE(profilerNotificationCounts)
+{
+  SoProfiler::init();
+  SoProfiler::enable(TRUE);
+
+  SoGroup * root = new SoGroup;
+  root->ref();
+  SoCube * cube = new SoCube;
+  for (int i = 0; i < 4; i++) root->addChild(cube);
+
+  SoProfiler::resetNotificationCounts();
+  cube->width = 3.0f;
+
+  SoTypeList types;
+  SbList<uint32_t> counts;
+  SoProfiler::getNotificationCounts(types, counts);
+  SoProfiler::enable(FALSE);
+
+  const int groupidx = types.find(SoGroup::getClassTypeId());
+  const int cubeidx = types.find(SoCube::getClassTypeId());
+  BOOST_CHECK_EQUAL(types.getLength(), counts.getLength());
+  BOOST_REQUIRE(groupidx >= 0 && cubeidx >= 0);
+  BOOST_CHECK_EQUAL(counts[cubeidx], 1u);
+  BOOST_CHECK_EQUAL(counts[groupidx], 1u);
+
+  SoProfiler::resetNotificationCounts();
+  SoProfiler::getNotificationCounts(types, counts);
+  BOOST_CHECK_EQUAL(types.getLength(), 0);
+
+  root->unref();
+}
+
 #endif // COIN_TEST_SUITE
 
 /* *********************************************************************** */
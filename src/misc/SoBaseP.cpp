@@ -41,6 +41,7 @@
 #include "nodes/SoUnknownNode.h"
 #include "fields/SoGlobalField.h"
 #include "io/SoInputP.h"
+#include "misc/SoAuditorBuffer.h"
 
 // *************************************************************************
 
@@ -177,28 +178,18 @@ SoBase::PImpl::check_for_leaks(void)
 }
 
 //
-// Callback from cc_rbptree_traverse().
+// Callback from cc_rbptree_traverse(), used for collecting the
+// auditors to notify in an SoAuditorBuffer.
 //
 void
-SoBase::PImpl::rbptree_notify_cb(void * auditor, void * type, void * closure)
+SoBase::PImpl::rbptree_collect_cb(void * auditor, void * type, void * closure)
 {
-  NotifyData * data = static_cast<NotifyData *>(closure);
-  data->cnt--;
+  SoAuditorBuffer * buffer = static_cast<SoAuditorBuffer *>(closure);
 
   // MSVC7 on 64-bit Windows wants to go through this type when
   // casting from void*.
   const uintptr_t tmptype = (uintptr_t)type;
-
-  if (data->cnt == 0) {
-    data->thisp->doNotify(data->list, auditor, (SoNotRec::Type) tmptype);
-  }
-  else {
-    assert(data->cnt > 0);
-    // use a copy of 'l', since the notification list might change
-    // when auditors are notified
-    SoNotList listcopy(data->list);
-    data->thisp->doNotify(&listcopy, auditor, (SoNotRec::Type) tmptype);
-  }
+  buffer->append(auditor, (SoNotRec::Type) tmptype);
 }
 
 // Reads the name of a reference after a "USE" keyword and finds the
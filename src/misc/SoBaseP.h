@@ -86,18 +86,10 @@ public:
   static SoBase * createInstance(SoInput * in, const SbName & classname);
   static void flushInput(SoInput * in);
 
-  static void rbptree_notify_cb(void * auditor, void * type, void * closure);
+  static void rbptree_collect_cb(void * auditor, void * type, void * closure);
 
   static SoNode * readNode(SoInput * in);
 
-  // only needed for the callback from cc_rbptree_traverse
-  struct NotifyData {
-    int cnt;
-    int total;
-    SoNotList * list;
-    SoBase * thisp;
-  };
-
 }; // SoBase::PImpl
 
 #endif // !COIN_SOBASEP_H
@@ -0,0 +1,664 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SoImageTileProvider SoImageTileProvider.h Inventor/misc/SoImageTileProvider.h
+  \brief The SoImageTileProvider class supplies image data for SoGLBigImage one region at a time.
+  \ingroup general
+
+  A tile provider gives access to an image which is too big to be
+  kept in memory, typically an image pyramid stored on disk. Set one
+  on an SoGLBigImage with SoGLBigImage::setTileProvider(), and the
+  subtextures will be read at the resolution they are rendered at,
+  in the background, and through a cache of bounded size.
+
+  Subclass this class to read from your own image source, or use
+  createFromFile() to read the tiled pyramid files written by
+  writeFile(). Such files are also read by SoTexture2.
+
+  The file format is simple: a 32 byte header consisting of the
+  characters "COINPYR1" followed by six little-endian 32-bit
+  integers: the width, the height, the number of components, the
+  number of levels, the tile size and a reserved zero. Then follows
+  each level in turn, starting with the full-resolution level, each
+  level half the size of the previous one. Each level is stored as
+  square tiles, row by row of tiles from the bottom, with the pixels
+  of each tile stored bottom row first. Tiles crossing the right or
+  top edge are padded with the edge pixels.
+
+  Tile providers are reference counted, and will be destructed when
+  the reference count goes to zero.
+
+  \since Coin 4.0
+*/
+
+// *************************************************************************
+
+#include <Inventor/misc/SoImageTileProvider.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif // !_WIN32
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/SbImage.h>
+#include <Inventor/SbString.h>
+
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+class SoImageTileProviderP {
+public:
+  int32_t refcount;
+};
+
+static void * soimagetileprovider_mutex = NULL;
+
+static void
+soimagetileprovider_cleanup(void)
+{
+  CC_MUTEX_DESTRUCT(soimagetileprovider_mutex);
+}
+
+static void
+soimagetileprovider_lock(void)
+{
+  if (soimagetileprovider_mutex == NULL) {
+    CC_MUTEX_CONSTRUCT(soimagetileprovider_mutex);
+    coin_atexit(soimagetileprovider_cleanup, CC_ATEXIT_NORMAL);
+  }
+  CC_MUTEX_LOCK(soimagetileprovider_mutex);
+}
+
+static void
+soimagetileprovider_unlock(void)
+{
+  CC_MUTEX_UNLOCK(soimagetileprovider_mutex);
+}
+
+// returns the number of levels needed to get down to a 1x1 image
+static int
+soimagetile_fullnumlevels(const SbVec2i32 & size)
+{
+  int levels = 1;
+  while ((size[0] >> (levels-1)) > 1 || (size[1] >> (levels-1)) > 1) {
+    levels++;
+  }
+  return levels;
+}
+
+static SbVec2i32
+soimagetile_levelsize(const SbVec2i32 & size, const int level)
+{
+  int32_t w = size[0] >> level;
+  int32_t h = size[1] >> level;
+  return SbVec2i32(w > 0 ? w : 1, h > 0 ? h : 1);
+}
+
+// *************************************************************************
+
+// The layout of a pyramid file, shared between the reader and the
+// writer.
+class soimagetile_layout {
+public:
+  enum { HEADERSIZE = 32, MAXLEVELS = 32 };
+
+  SbVec2i32 size;
+  int nc;
+  int numlevels;
+  int tilesize;
+  uint64_t leveloffset[MAXLEVELS];
+
+  void init(void) {
+    uint64_t offset = HEADERSIZE;
+    for (int l = 0; l < this->numlevels; l++) {
+      this->leveloffset[l] = offset;
+      const SbVec2i32 tiles = this->getNumTiles(l);
+      offset += uint64_t(tiles[0]) * uint64_t(tiles[1]) * this->getTileBytes();
+    }
+  }
+  SbVec2i32 getNumTiles(const int level) const {
+    const SbVec2i32 ls = soimagetile_levelsize(this->size, level);
+    return SbVec2i32((ls[0] + this->tilesize - 1) / this->tilesize,
+                     (ls[1] + this->tilesize - 1) / this->tilesize);
+  }
+  uint64_t getTileBytes(void) const {
+    return uint64_t(this->tilesize) * uint64_t(this->tilesize) * this->nc;
+  }
+  uint64_t getTileOffset(const int level, const int tx, const int ty) const {
+    const SbVec2i32 tiles = this->getNumTiles(level);
+    return this->leveloffset[level] +
+      (uint64_t(ty) * uint64_t(tiles[0]) + uint64_t(tx)) * this->getTileBytes();
+  }
+};
+
+static SbBool
+soimagetile_seek(FILE * fp, const uint64_t offset)
+{
+#ifdef _WIN32
+  return _fseeki64(fp, (__int64) offset, SEEK_SET) == 0;
+#else // !_WIN32
+  return fseeko(fp, (off_t) offset, SEEK_SET) == 0;
+#endif // !_WIN32
+}
+
+static void
+soimagetile_write32(unsigned char * dst, const uint32_t val)
+{
+  dst[0] = (unsigned char) (val & 0xff);
+  dst[1] = (unsigned char) ((val >> 8) & 0xff);
+  dst[2] = (unsigned char) ((val >> 16) & 0xff);
+  dst[3] = (unsigned char) ((val >> 24) & 0xff);
+}
+
+static uint32_t
+soimagetile_read32(const unsigned char * src)
+{
+  return
+    uint32_t(src[0]) | (uint32_t(src[1]) << 8) |
+    (uint32_t(src[2]) << 16) | (uint32_t(src[3]) << 24);
+}
+
+// Fills in the pixels outside [x0, x1] x [y0, y1] (in dst
+// coordinates) of a region by repeating the edge pixels.
+static void
+soimagetile_clampedges(unsigned char * dst, const SbVec2i32 & size, const int nc,
+                       const int x0, const int y0, const int x1, const int y1)
+{
+  const int rowbytes = size[0] * nc;
+  for (int y = y0; y <= y1; y++) {
+    unsigned char * row = dst + y * rowbytes;
+    for (int x = 0; x < x0; x++) memcpy(row + x*nc, row + x0*nc, nc);
+    for (int x = x1+1; x < size[0]; x++) memcpy(row + x*nc, row + x1*nc, nc);
+  }
+  for (int y = 0; y < y0; y++) {
+    memcpy(dst + y * rowbytes, dst + y0 * rowbytes, rowbytes);
+  }
+  for (int y = y1+1; y < size[1]; y++) {
+    memcpy(dst + y * rowbytes, dst + y1 * rowbytes, rowbytes);
+  }
+}
+
+// Reads a region of a level from a pyramid file. Pixels outside the
+// level are clamped to the edge. tilebuf must have room for one
+// tile.
+static SbBool
+soimagetile_readregion(FILE * fp, const soimagetile_layout & layout,
+                       const int level, const SbVec2i32 & origin,
+                       const SbVec2i32 & size, unsigned char * dst,
+                       unsigned char * tilebuf)
+{
+  const SbVec2i32 ls = soimagetile_levelsize(layout.size, level);
+  const int nc = layout.nc;
+  const int ts = layout.tilesize;
+
+  // the pixels of the level covered by the region, in level coordinates
+  const int x0 = SbClamp(origin[0], 0, ls[0]-1);
+  const int y0 = SbClamp(origin[1], 0, ls[1]-1);
+  const int x1 = SbClamp(origin[0] + size[0] - 1, 0, ls[0]-1);
+  const int y1 = SbClamp(origin[1] + size[1] - 1, 0, ls[1]-1);
+
+  for (int ty = y0 / ts; ty <= y1 / ts; ty++) {
+    for (int tx = x0 / ts; tx <= x1 / ts; tx++) {
+      if (!soimagetile_seek(fp, layout.getTileOffset(level, tx, ty)) ||
+          fread(tilebuf, 1, (size_t) layout.getTileBytes(), fp) != layout.getTileBytes()) {
+        return FALSE;
+      }
+      const int sx0 = SbMax(x0, tx * ts);
+      const int sx1 = SbMin(x1, tx * ts + ts - 1);
+      const int sy0 = SbMax(y0, ty * ts);
+      const int sy1 = SbMin(y1, ty * ts + ts - 1);
+      for (int sy = sy0; sy <= sy1; sy++) {
+        const int dy = sy - origin[1];
+        if (dy < 0 || dy >= size[1]) continue;
+        const int cx0 = SbMax(sx0, origin[0]);
+        const int cx1 = SbMin(sx1, origin[0] + size[0] - 1);
+        if (cx0 > cx1) continue;
+        memcpy(dst + (dy * size[0] + (cx0 - origin[0])) * nc,
+               tilebuf + ((sy - ty * ts) * ts + (cx0 - tx * ts)) * nc,
+               (cx1 - cx0 + 1) * nc);
+      }
+    }
+  }
+  soimagetile_clampedges(dst, size, nc,
+                         SbClamp(x0 - origin[0], 0, size[0]-1),
+                         SbClamp(y0 - origin[1], 0, size[1]-1),
+                         SbClamp(x1 - origin[0], 0, size[0]-1),
+                         SbClamp(y1 - origin[1], 0, size[1]-1));
+  return TRUE;
+}
+
+// *************************************************************************
+
+// Reads tiles from a pyramid file. The file is shared between the
+// threads reading from it, so each read is done under a mutex.
+class soimagetileprovider_file : public SoImageTileProvider {
+public:
+  soimagetileprovider_file(FILE * fparg, const soimagetile_layout & layoutarg)
+    : fp(fparg), layout(layoutarg), mutex(NULL) {
+    CC_MUTEX_CONSTRUCT(this->mutex);
+    this->tilebuf = new unsigned char[(size_t) this->layout.getTileBytes()];
+  }
+
+  virtual SbVec2i32 getSize(void) const { return this->layout.size; }
+  virtual int getNumComponents(void) const { return this->layout.nc; }
+  virtual int getNumLevels(void) const { return this->layout.numlevels; }
+
+  virtual SbBool readRegion(const int level, const SbVec2i32 & origin,
+                            const SbVec2i32 & size, unsigned char * buffer) {
+    if (level < 0 || level >= this->layout.numlevels) return FALSE;
+    CC_MUTEX_LOCK(this->mutex);
+    const SbBool ok = soimagetile_readregion(this->fp, this->layout, level,
+                                             origin, size, buffer,
+                                             this->tilebuf);
+    CC_MUTEX_UNLOCK(this->mutex);
+    return ok;
+  }
+
+protected:
+  virtual ~soimagetileprovider_file() {
+    fclose(this->fp);
+    delete[] this->tilebuf;
+    CC_MUTEX_DESTRUCT(this->mutex);
+  }
+
+private:
+  FILE * fp;
+  soimagetile_layout layout;
+  unsigned char * tilebuf;
+  void * mutex;
+};
+
+// Serves an image kept in memory, averaging blocks of pixels for
+// the lower levels.
+class soimagetileprovider_image : public SoImageTileProvider {
+public:
+  soimagetileprovider_image(const SbImage & imagearg) : image(imagearg) {
+    SbVec2s s;
+    this->bytes = this->image.getValue(s, this->nc);
+    this->size.setValue(s[0], s[1]);
+  }
+
+  virtual SbVec2i32 getSize(void) const { return this->size; }
+  virtual int getNumComponents(void) const { return this->nc; }
+  virtual int getNumLevels(void) const {
+    return soimagetile_fullnumlevels(this->size);
+  }
+
+  virtual SbBool readRegion(const int level, const SbVec2i32 & origin,
+                            const SbVec2i32 & regionsize, unsigned char * buffer) {
+    if (this->bytes == NULL || level < 0 || level >= this->getNumLevels()) {
+      return FALSE;
+    }
+    const int n = 1 << level;
+    const int nc = this->nc;
+    const SbVec2i32 ls = soimagetile_levelsize(this->size, level);
+    unsigned char * dst = buffer;
+    for (int y = 0; y < regionsize[1]; y++) {
+      const int ly = SbClamp(origin[1] + y, 0, ls[1]-1);
+      const int sy0 = SbMin(ly * n, this->size[1]-1);
+      const int sy1 = SbMin(sy0 + n, this->size[1]);
+      for (int x = 0; x < regionsize[0]; x++) {
+        const int lx = SbClamp(origin[0] + x, 0, ls[0]-1);
+        const int sx0 = SbMin(lx * n, this->size[0]-1);
+        const int sx1 = SbMin(sx0 + n, this->size[0]);
+        uint64_t sum[4] = { 0, 0, 0, 0 };
+        for (int sy = sy0; sy < sy1; sy++) {
+          const unsigned char * src = this->bytes + (sy * this->size[0] + sx0) * nc;
+          for (int sx = sx0; sx < sx1; sx++) {
+            for (int c = 0; c < nc; c++) sum[c] += src[c];
+            src += nc;
+          }
+        }
+        const uint64_t num = uint64_t(sx1 - sx0) * uint64_t(sy1 - sy0);
+        for (int c = 0; c < nc; c++) {
+          *dst++ = (unsigned char) ((sum[c] + num/2) / num);
+        }
+      }
+    }
+    return TRUE;
+  }
+
+private:
+  SbImage image;
+  const unsigned char * bytes;
+  SbVec2i32 size;
+  int nc;
+};
+
+// *************************************************************************
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+/*!
+  Constructor. The reference count starts at zero.
+*/
+SoImageTileProvider::SoImageTileProvider(void)
+{
+  PRIVATE(this) = new SoImageTileProviderP;
+  PRIVATE(this)->refcount = 0;
+}
+
+/*!
+  Destructor. Called by unref() when the reference count goes to
+  zero.
+*/
+SoImageTileProvider::~SoImageTileProvider()
+{
+  delete PRIVATE(this);
+}
+
+/*!
+  Increases the reference count.
+*/
+void
+SoImageTileProvider::ref(void) const
+{
+  soimagetileprovider_lock();
+  PRIVATE(this)->refcount++;
+  soimagetileprovider_unlock();
+}
+
+/*!
+  Decreases the reference count, and destructs the provider when it
+  goes to zero.
+*/
+void
+SoImageTileProvider::unref(void) const
+{
+  soimagetileprovider_lock();
+  const SbBool destroy = (--PRIVATE(this)->refcount == 0);
+  soimagetileprovider_unlock();
+  if (destroy) delete this;
+}
+
+/*!
+  Returns the reference count.
+*/
+int32_t
+SoImageTileProvider::getRefCount(void) const
+{
+  return PRIVATE(this)->refcount;
+}
+
+/*!
+  \fn SbVec2i32 SoImageTileProvider::getSize(void) const
+
+  Returns the size of the full resolution image.
+*/
+
+/*!
+  \fn int SoImageTileProvider::getNumComponents(void) const
+
+  Returns the number of components (1-4) of each pixel.
+*/
+
+/*!
+  Returns the number of levels readRegion() can read from. Level 0
+  is the full resolution image, and each level is half the size of
+  the previous one. The default method returns 1.
+*/
+int
+SoImageTileProvider::getNumLevels(void) const
+{
+  return 1;
+}
+
+/*!
+  Returns the size of \a level, which is the size of the image
+  divided by 2^level, but at least 1.
+*/
+SbVec2i32
+SoImageTileProvider::getLevelSize(const int level) const
+{
+  return soimagetile_levelsize(this->getSize(), level);
+}
+
+/*!
+  \fn SbBool SoImageTileProvider::readRegion(const int level, const SbVec2i32 & origin, const SbVec2i32 & size, unsigned char * buffer)
+
+  Reads the pixels of \a level from \a origin and \a size pixels
+  ahead into \a buffer, bottom row first. Pixels outside the level
+  should be set to the closest pixel on the edge. Returns \e FALSE if
+  the data could not be read.
+
+  This method is called from the threads loading textures, and must
+  be thread safe.
+*/
+
+/*!
+  Opens the pyramid file \a filename. Returns \e NULL if the file
+  could not be opened or is not a pyramid file. The file is kept
+  open until the provider is destructed.
+
+  \sa writeFile()
+*/
+SoImageTileProvider *
+SoImageTileProvider::createFromFile(const SbString & filename)
+{
+  FILE * fp = fopen(filename.getString(), "rb");
+  if (fp == NULL) return NULL;
+
+  unsigned char header[soimagetile_layout::HEADERSIZE];
+  if (fread(header, 1, sizeof(header), fp) != sizeof(header) ||
+      memcmp(header, "COINPYR1", 8) != 0) {
+    fclose(fp);
+    return NULL;
+  }
+  soimagetile_layout layout;
+  const uint32_t w = soimagetile_read32(header + 8);
+  const uint32_t h = soimagetile_read32(header + 12);
+  layout.nc = (int) soimagetile_read32(header + 16);
+  layout.numlevels = (int) soimagetile_read32(header + 20);
+  layout.tilesize = (int) soimagetile_read32(header + 24);
+  if (w == 0 || h == 0 || w > 0x7fffffff || h > 0x7fffffff ||
+      layout.nc < 1 || layout.nc > 4 || layout.tilesize < 1 ||
+      layout.tilesize > 8192 || layout.numlevels < 1) {
+    fclose(fp);
+    return NULL;
+  }
+  layout.size.setValue((int32_t) w, (int32_t) h);
+  if (layout.numlevels > soimagetile_fullnumlevels(layout.size)) {
+    fclose(fp);
+    return NULL;
+  }
+  layout.init();
+  return new soimagetileprovider_file(fp, layout);
+}
+
+/*!
+  Returns a provider serving \a image from memory. The lower levels
+  are created on the fly by averaging the pixels of the image. This
+  is mostly useful for writing pyramid files with writeFile().
+*/
+SoImageTileProvider *
+SoImageTileProvider::createFromImage(const SbImage & image)
+{
+  return new soimagetileprovider_image(image);
+}
+
+/*!
+  Writes the image of \a source to the pyramid file \a filename, in
+  tiles of \a tilesize x \a tilesize pixels. Levels not provided by
+  \a source are created by averaging the previous level. Returns \e
+  FALSE if the file could not be written.
+
+  \sa createFromFile()
+*/
+SbBool
+SoImageTileProvider::writeFile(const SbString & filename,
+                               SoImageTileProvider * source,
+                               const int tilesize)
+{
+  soimagetile_layout layout;
+  layout.size = source->getSize();
+  layout.nc = source->getNumComponents();
+  layout.tilesize = tilesize;
+  if (layout.size[0] < 1 || layout.size[1] < 1 ||
+      layout.nc < 1 || layout.nc > 4 || tilesize < 1) return FALSE;
+  layout.numlevels = soimagetile_fullnumlevels(layout.size);
+  layout.init();
+
+  FILE * fp = fopen(filename.getString(), "w+b");
+  if (fp == NULL) return FALSE;
+
+  unsigned char header[soimagetile_layout::HEADERSIZE];
+  memcpy(header, "COINPYR1", 8);
+  soimagetile_write32(header + 8, (uint32_t) layout.size[0]);
+  soimagetile_write32(header + 12, (uint32_t) layout.size[1]);
+  soimagetile_write32(header + 16, (uint32_t) layout.nc);
+  soimagetile_write32(header + 20, (uint32_t) layout.numlevels);
+  soimagetile_write32(header + 24, (uint32_t) layout.tilesize);
+  soimagetile_write32(header + 28, 0);
+  SbBool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+
+  const int nc = layout.nc;
+  const size_t tilebytes = (size_t) layout.getTileBytes();
+  unsigned char * tile = new unsigned char[tilebytes];
+  unsigned char * tmptile = new unsigned char[tilebytes];
+  unsigned char * parent = new unsigned char[tilebytes * 4];
+  const int sourcelevels = source->getNumLevels();
+  const SbVec2i32 tsize(tilesize, tilesize);
+
+  for (int l = 0; ok && l < layout.numlevels; l++) {
+    const SbVec2i32 tiles = layout.getNumTiles(l);
+    for (int ty = 0; ok && ty < tiles[1]; ty++) {
+      for (int tx = 0; ok && tx < tiles[0]; tx++) {
+        const SbVec2i32 origin(tx * tilesize, ty * tilesize);
+        if (l < sourcelevels) {
+          ok = source->readRegion(l, origin, tsize, tile);
+        }
+        else {
+          // average the pixels of the previous level, read back from
+          // the file
+          ok = soimagetile_readregion(fp, layout, l-1, origin * 2,
+                                      tsize * 2, parent, tmptile);
+          const unsigned char * src = parent;
+          unsigned char * dst = tile;
+          const int rowbytes = tilesize * 2 * nc;
+          for (int y = 0; ok && y < tilesize; y++) {
+            for (int x = 0; x < tilesize; x++) {
+              for (int c = 0; c < nc; c++) {
+                *dst++ = (unsigned char)
+                  ((src[c] + src[nc+c] + src[rowbytes+c] + src[rowbytes+nc+c] + 2) >> 2);
+              }
+              src += 2 * nc;
+            }
+            src += rowbytes;
+          }
+        }
+        ok = ok &&
+          soimagetile_seek(fp, layout.getTileOffset(l, tx, ty)) &&
+          fwrite(tile, 1, tilebytes, fp) == tilebytes;
+      }
+    }
+  }
+  delete[] tile;
+  delete[] tmptile;
+  delete[] parent;
+  if (fclose(fp) != 0) ok = FALSE;
+  return ok;
+}
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbImage.h>
+#include <Inventor/SbString.h>
+#include <Inventor/misc/SoImageTileProvider.h>
+#include <cstdio>
+
+BOOST_AUTO_TEST_CASE(writeAndReadPyramid)
+{
+  // an image not a multiple of the tile size, to get edge tiles
+  const int w = 37, h = 21, nc = 3;
+  unsigned char bytes[w * h * nc];
+  for (int i = 0; i < w * h * nc; i++) bytes[i] = (unsigned char) ((i * 7) & 0xff);
+  SbImage image(bytes, SbVec2s(w, h), nc);
+
+  SoImageTileProvider * source = SoImageTileProvider::createFromImage(image);
+  source->ref();
+  const char * filename = "soimagetileprovider_test.pyr";
+  BOOST_REQUIRE(SoImageTileProvider::writeFile(filename, source, 16));
+
+  SoImageTileProvider * file = SoImageTileProvider::createFromFile(filename);
+  BOOST_REQUIRE_MESSAGE(file != NULL, "could not read pyramid file");
+  file->ref();
+  BOOST_CHECK(file->getSize() == SbVec2i32(w, h));
+  BOOST_CHECK_EQUAL(file->getNumComponents(), nc);
+  BOOST_CHECK_EQUAL(file->getNumLevels(), 6);
+  BOOST_CHECK(file->getLevelSize(5) == SbVec2i32(1, 1));
+
+  // a region crossing tiles and the right edge of the full image
+  const SbVec2i32 origin(10, 3), size(32, 17);
+  unsigned char region[32 * 17 * 3];
+  BOOST_REQUIRE(file->readRegion(0, origin, size, region));
+  int errors = 0;
+  for (int y = 0; y < size[1]; y++) {
+    for (int x = 0; x < size[0]; x++) {
+      const int sx = SbMin(origin[0] + x, w-1);
+      for (int c = 0; c < nc; c++) {
+        if (region[(y * size[0] + x) * nc + c] !=
+            bytes[((origin[1] + y) * w + sx) * nc + c]) errors++;
+      }
+    }
+  }
+  BOOST_CHECK_MESSAGE(errors == 0, "full resolution region differs");
+
+  // the lower levels should match the averaged image
+  unsigned char * expected = new unsigned char[w * h * nc];
+  unsigned char * got = new unsigned char[w * h * nc];
+  for (int l = 1; l < file->getNumLevels(); l++) {
+    const SbVec2i32 ls = file->getLevelSize(l);
+    BOOST_REQUIRE(source->readRegion(l, SbVec2i32(0, 0), ls, expected));
+    BOOST_REQUIRE(file->readRegion(l, SbVec2i32(0, 0), ls, got));
+    int maxdiff = 0;
+    for (int i = 0; i < ls[0] * ls[1] * nc; i++) {
+      maxdiff = SbMax(maxdiff, SbAbs(int(expected[i]) - int(got[i])));
+    }
+    // the file levels are averaged from the previous level, and are
+    // rounded once for each level
+    BOOST_CHECK_MESSAGE(maxdiff <= l, "level differs too much from the image");
+  }
+  delete[] expected;
+  delete[] got;
+
+  file->unref();
+  source->unref();
+  remove(filename);
+
+  BOOST_CHECK(SoImageTileProvider::createFromFile(filename) == NULL);
+}
+
+#endif // COIN_TEST_SUITE
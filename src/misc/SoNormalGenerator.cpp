@@ -32,12 +32,21 @@
 #include <Inventor/misc/SoNormalGenerator.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <Inventor/errors/SoDebugError.h>
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "misc/SoNormalGeneratorP.h"
 #include "tidbitsp.h"
+#include "threads/threadsutilp.h"
 #include "coindefs.h" // COIN_OBSOLETED()
 
+#define PRIVATE(obj) ((obj)->pimpl)
+
 /*!
   Constructor with \a isccw indicating if polygons are specified
   in counter clockwise order. The \a approxVertices can be used
@@ -45,14 +54,14 @@
 */
 SoNormalGenerator::SoNormalGenerator(const SbBool isccw,
                                      const int approxVertices)
-  : bsp(128, approxVertices),
-    vertexList(approxVertices),
+  : vertexList(approxVertices),
     vertexFace(approxVertices),
     faceNormals(approxVertices / 4),
     vertexNormals(approxVertices),
     ccw(isccw),
     perVertex(TRUE)
 {
+  PRIVATE(this) = new SoNormalGeneratorP(approxVertices);
 }
 
 /*!
@@ -60,6 +69,7 @@ SoNormalGenerator::SoNormalGenerator(const SbBool isccw,
 */
 SoNormalGenerator::~SoNormalGenerator()
 {
+  delete PRIVATE(this);
 }
 
 /*!
@@ -74,7 +84,7 @@ void
 SoNormalGenerator::reset(const SbBool ccwarg)
 {
   this->ccw = ccwarg;
-  this->bsp.clear();
+  PRIVATE(this)->welder.clear();
   this->vertexList.truncate(0);
   this->vertexFace.truncate(0);
   this->faceNormals.truncate(0);
@@ -101,7 +111,7 @@ SoNormalGenerator::beginPolygon(void)
 void
 SoNormalGenerator::polygonVertex(const SbVec3f &v)
 {
-  this->vertexList.append(this->bsp.addPoint(v));
+  this->vertexList.append(PRIVATE(this)->welder.addPoint(v));
   this->vertexFace.append(this->faceNormals.getLength());
 }
 
@@ -149,34 +159,124 @@ SoNormalGenerator::quad(const SbVec3f &v0,
   this->endPolygon();
 }
 
-//
-// calculates the normal vector for a vertex, based on the
-// normal vectors of all incident faces
-//
+// Shared by the threads smoothing normals, each doing a range of
+// corners.
+struct sonormalgenerator_smooth_data {
+  const SbVec3f * facenormals;
+  int numfacenormals;
+  const int32_t * firstface;
+  const int32_t * vertexfaces;
+  int numvertices;
+  const int32_t * vertex;
+  const int32_t * face;
+  float threshold;
+  SbVec3f * normals;
+};
+
+// corners handed to a thread at a time
+#define SONORMALGENERATOR_CHUNK 4096
+
 static void
-calc_normal_vec(const SbVec3f *facenormals, const int facenum,
-                SbList <int32_t> &faceArray, const float threshold,
-                SbVec3f &vertnormal)
+sonormalgenerator_smooth_range(void * closure, int start, int end)
 {
-  // start with face normal vector
-  const SbVec3f * facenormal = &facenormals[facenum];
-  vertnormal = *facenormal;
-
-  int n = faceArray.getLength();
-  int currface;
-
-  for (int i = 0; i < n; i++) {
-    currface = faceArray[i];
-    if (currface != facenum) { // check all but this face
-      const SbVec3f &normal = facenormals[currface];
-      if ((normal.dot(*facenormal)) > threshold) {
-        // smooth towards this face
-        vertnormal += normal;
+  sonormalgenerator_smooth_data * data =
+    static_cast<sonormalgenerator_smooth_data *>(closure);
+  const SbVec3f * facenormals = data->facenormals;
+  const int numfacenormals = data->numfacenormals;
+  for (int i = start; i < end; i++) {
+    const int32_t v = data->vertex[i];
+    if (v < 0 || v >= data->numvertices) continue;
+    const int32_t facenum = data->face[i];
+    // start with face normal vector
+    const SbVec3f & facenormal = facenormals[facenum];
+    SbVec3f vertnormal = facenormal;
+    const int32_t * faces = data->vertexfaces + data->firstface[v];
+    const int n = data->firstface[v+1] - data->firstface[v];
+    for (int j = 0; j < n; j++) {
+      const int32_t currface = faces[j];
+      // check all but this face
+      if (currface != facenum && (currface < numfacenormals || numfacenormals == -1)) {
+        const SbVec3f & normal = facenormals[currface];
+        if (normal.dot(facenormal) > data->threshold) {
+          // smooth towards this face
+          vertnormal += normal;
+        }
       }
     }
+    // as SbVec3f::normalize(), which may post warnings
+    const float len = vertnormal.length();
+    if (len > 0.0f) vertnormal /= len;
+    data->normals[i] = vertnormal;
   }
 }
 
+// Documented in SoNormalGeneratorP.h.
+void
+sonormalgenerator_vertex_faces(const int32_t * vertex,
+                               const int32_t * face,
+                               const int num,
+                               const int numvertices,
+                               int32_t * firstface,
+                               int32_t * vertexfaces)
+{
+  // counting sort, with the faces of vertex v counted in
+  // firstface[v+1], and then placed from firstface[v] up
+  int i;
+  for (i = 0; i <= numvertices; i++) firstface[i] = 0;
+  for (i = 0; i < num; i++) {
+    const int32_t v = vertex[i];
+    if (v >= 0 && v < numvertices) firstface[v + 1]++;
+  }
+  for (i = 0; i < numvertices; i++) firstface[i + 1] += firstface[i];
+  for (i = 0; i < num; i++) {
+    const int32_t v = vertex[i];
+    if (v >= 0 && v < numvertices) vertexfaces[firstface[v]++] = face[i];
+  }
+  // each firstface[v] is now where the faces of v + 1 start
+  for (i = numvertices; i > 0; i--) firstface[i] = firstface[i - 1];
+  firstface[0] = 0;
+}
+
+// Documented in SoNormalGeneratorP.h.
+void
+sonormalgenerator_smooth(const SbVec3f * facenormals,
+                         const int numfacenormals,
+                         const int32_t * firstface,
+                         const int32_t * vertexfaces,
+                         const int numvertices,
+                         const int32_t * vertex,
+                         const int32_t * face,
+                         const int num,
+                         const float threshold,
+                         SbVec3f * normals)
+{
+  sonormalgenerator_smooth_data data;
+  data.facenormals = facenormals;
+  data.numfacenormals = numfacenormals;
+  data.firstface = firstface;
+  data.vertexfaces = vertexfaces;
+  data.numvertices = numvertices;
+  data.vertex = vertex;
+  data.face = face;
+  data.threshold = threshold;
+  data.normals = normals;
+
+  static int numthreads = -1;
+  if (numthreads < 0) {
+    const char * env = coin_getenv("COIN_NORMALGENERATOR_THREADS");
+    numthreads = env ? SbMax(atoi(env), 1) : 4;
+  }
+  // leave small jobs to this thread, as starting the others costs
+  // more than it saves
+  const int numworkers =
+    SbMin(numthreads, (num + 8 * SONORMALGENERATOR_CHUNK - 1) / (8 * SONORMALGENERATOR_CHUNK));
+
+  cc_parallel_for(num, SONORMALGENERATOR_CHUNK, numworkers,
+                  sonormalgenerator_smooth_range, &data);
+}
+
+#undef SONORMALGENERATOR_CHUNK
+
 /*!
   Triggers the normal generation. Normals are generated using
   \a creaseAngle to find which edges should be flat-shaded
@@ -189,80 +289,76 @@ calc_normal_vec(const SbVec3f *facenormals, const int facenum,
   have to know how OpenGL/Coin generate triangles from triangle
   strips.
 
+  Vertices at equal positions are considered shared between the
+  faces. The normals of large meshes are calculated by several
+  threads, see the COIN_NORMALGENERATOR_THREADS environment variable.
 */
 void
 SoNormalGenerator::generate(const float creaseAngle,
                             const int32_t *striplens,
                             const int numstrips)
 {
-  // just ignore the warnings from normalize(). A null vector just
+  // null normals are left as they are. A null vector just
   // means that we have an empty triangle which will be ignored by
   // OpenGL anyway. It's also common to have empty triangles in for
   // instance triangle strips (they're used as a trick to generate
   // longer triangle strips).
 
   int i;
-
-  // for each vertex, store all faceindices the vertex is a part of
-  SbList <int32_t> * vertexFaceArray = new SbList<int32_t>[bsp.numPoints()];
-
-  int numvi = this->vertexList.getLength();
-
-  for (i = 0; i < numvi; i++) {
-    vertexFaceArray[vertexList[i]].append(this->vertexFace[i]);
-  }
+  const int numvi = this->vertexList.getLength();
+  const int32_t * vertices = this->vertexList.getArrayPtr();
+  const int32_t * faces = this->vertexFace.getArrayPtr();
 
   float threshold = (float)cos(SbClamp(creaseAngle, 0.0f, (float) M_PI));
 
+  // the vertices to calculate normals for, all of them except for
+  // triangle strips, where there is one normal per strip vertex
+  SbList <int32_t> stripvertices;
+  SbList <int32_t> stripfaces;
   if (striplens) {
     i = 0;
     for (int j = 0; j < numstrips; j++) {
       assert(i+2 < numvi);
-      SbVec3f tmpvec;
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i],
-                      vertexFaceArray[vertexList[i]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i+1],
-                      vertexFaceArray[vertexList[i+1]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
+      stripvertices.append(vertices[i]);
+      stripfaces.append(faces[i]);
+      stripvertices.append(vertices[i+1]);
+      stripfaces.append(faces[i+1]);
 
       int num = striplens[j] - 2;
 
       while (num--) {
         i += 2;
         assert(i < numvi);
-        calc_normal_vec(this->faceNormals.getArrayPtr(),
-                        this->vertexFace[i],
-                        vertexFaceArray[vertexList[i]],
-                        threshold, tmpvec);
-        (void) tmpvec.normalize();
-        this->vertexNormals.append(tmpvec);
+        stripvertices.append(vertices[i]);
+        stripfaces.append(faces[i]);
         i++;
       }
     }
   }
-  else {
-    for (i = 0; i < numvi; i++) {
-      SbVec3f tmpvec;
-      calc_normal_vec(this->faceNormals.getArrayPtr(),
-                      this->vertexFace[i],
-                      vertexFaceArray[vertexList[i]],
-                      threshold, tmpvec);
-      (void) tmpvec.normalize();
-      this->vertexNormals.append(tmpvec);
-    }
+  const int num = striplens ? stripvertices.getLength() : numvi;
+
+  const int first = this->vertexNormals.getLength();
+  for (i = 0; i < num; i++) this->vertexNormals.append(SbVec3f(0.0f, 0.0f, 0.0f));
+  if (num > 0) {
+    // for each vertex, store all faceindices the vertex is a part of
+    const int numpoints = PRIVATE(this)->welder.getNumPoints();
+    int32_t * firstface = new int32_t[numpoints + 1];
+    int32_t * vertexfaces = new int32_t[numvi];
+    sonormalgenerator_vertex_faces(vertices, faces, numvi, numpoints,
+                                   firstface, vertexfaces);
+    sonormalgenerator_smooth(this->faceNormals.getArrayPtr(), -1,
+                             firstface, vertexfaces, numpoints,
+                             striplens ? stripvertices.getArrayPtr() : vertices,
+                             striplens ? stripfaces.getArrayPtr() : faces,
+                             num, threshold, &this->vertexNormals[first]);
+    delete [] firstface;
+    delete [] vertexfaces;
   }
-  delete [] vertexFaceArray;
+
   this->vertexFace.truncate(0, TRUE);
   this->vertexList.truncate(0, TRUE);
   this->faceNormals.truncate(0, TRUE);
-  this->bsp.clear();
+  PRIVATE(this)->welder.clear();
   this->vertexNormals.fit();
 
   // return vertex normals
@@ -395,7 +491,7 @@ SoNormalGenerator::calcFaceNormal(void)
 
   assert(num >= 3);
   const int * cind = (const int *) this->vertexList.getArrayPtr() + this->currFaceStart;
-  const SbVec3f * coords = this->bsp.getPointsArrayPtr();
+  const SbVec3f * coords = PRIVATE(this)->welder.getPointsArrayPtr();
   SbVec3f ret;
 
   if (num == 3) { // triangle
@@ -442,3 +538,64 @@ SoNormalGenerator::calcFaceNormal(void)
   }
   return ret;
 }
+
+#undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+// A grid of n x n quads in the xy plane, folded 45 degrees up along
+// x = n / 2, with each triangle given its own copies of the
+// vertices. The vertices on the fold have z = -0 in the flat half.
+static void
+add_folded_grid(SoNormalGenerator & gen, const int n)
+{
+  const float h = float(n / 2);
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++) {
+      SbVec3f v[4];
+      for (int k = 0; k < 4; k++) {
+        const float x = float(i + ((k == 1 || k == 2) ? 1 : 0));
+        const float y = float(j + ((k >= 2) ? 1 : 0));
+        v[k].setValue(x, y, (i < n / 2) ? -0.0f : x - h);
+      }
+      gen.triangle(v[0], v[1], v[2]);
+      gen.triangle(v[0], v[2], v[3]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(foldedGrid)
+{
+  // large enough to have the normals calculated by several threads
+  const int n = 100;
+  const SbVec3f flat(0.0f, 0.0f, 1.0f);
+  const SbVec3f sloped(-float(M_SQRT1_2), 0.0f, float(M_SQRT1_2));
+
+  for (int smooth = 0; smooth < 2; smooth++) {
+    SoNormalGenerator gen(TRUE, 6 * n * n);
+    add_folded_grid(gen, n);
+    gen.generate(smooth ? 1.0f : 0.5f);
+    BOOST_REQUIRE_EQUAL(gen.getNumNormals(), 6 * n * n);
+
+    int wrong = 0;
+    for (int j = 0; j < n; j++) {
+      for (int i = 0; i < n; i++) {
+        for (int k = 0; k < 6; k++) {
+          const SbVec3f & normal = gen.getNormal((j * n + i) * 6 + k);
+          const SbVec3f & facenormal = (i < n / 2) ? flat : sloped;
+          // corners 0, 3 and 5 are at x = i, the others at x = i + 1
+          const int x = i + ((k == 0 || k == 3 || k == 5) ? 0 : 1);
+          if (smooth && x == n / 2) {
+            // on the fold, between the two face normals
+            if (!(normal[0] < -0.01f && normal[0] > sloped[0] + 0.01f &&
+                  SbAbs(normal.length() - 1.0f) < 1e-5f)) wrong++;
+          }
+          else if (!normal.equals(facenormal, 1e-5f)) wrong++;
+        }
+      }
+    }
+    BOOST_CHECK_MESSAGE(wrong == 0, "normals not smoothed as expected");
+  }
+}
+
+#endif // COIN_TEST_SUITE
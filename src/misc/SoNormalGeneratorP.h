@@ -0,0 +1,84 @@
+#ifndef COIN_SONORMALGENERATORP_H
+#define COIN_SONORMALGENERATORP_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+//
+// vertex normal smoothing shared by SoNormalGenerator and SoNormalCache
+//
+
+#include <Inventor/SbVec3f.h>
+#include <Inventor/system/inttypes.h>
+
+#include "base/SbPointWelder.h"
+
+// SoNormalGenerator's private data. The vertices are welded here
+// instead of in the bsp member, which is only kept so the class
+// layout stays the same.
+class SoNormalGeneratorP {
+public:
+  SoNormalGeneratorP(const int approxvertices)
+    : welder(0.0f, approxvertices) { }
+  SbPointWelder welder;
+};
+
+// Sorts the num pairs of vertex[i] and face[i] by vertex, so the
+// faces at vertex v are vertexfaces[firstface[v]] up to
+// vertexfaces[firstface[v+1]], in the order they were given. Pairs
+// with a vertex outside [0, numvertices) are skipped. firstface must
+// have room for numvertices + 1 indices, and vertexfaces for num.
+void sonormalgenerator_vertex_faces(const int32_t * vertex,
+                                    const int32_t * face,
+                                    const int num,
+                                    const int numvertices,
+                                    int32_t * firstface,
+                                    int32_t * vertexfaces);
+
+// For each of the num corners given by vertex[i] and face[i], sums
+// the normal of the face with the normals of the other faces at the
+// vertex which are within the crease angle threshold (the cosine of
+// the angle), in the order of vertexfaces. Face indices from
+// numfacenormals up are ignored, unless numfacenormals is -1. The
+// sums are normalized and stored in normals[i], leaving null vectors
+// as they are. Corners with a vertex outside [0, numvertices) are
+// skipped.
+//
+// Large jobs are split between several threads, set with the
+// COIN_NORMALGENERATOR_THREADS environment variable.
+void sonormalgenerator_smooth(const SbVec3f * facenormals,
+                              const int numfacenormals,
+                              const int32_t * firstface,
+                              const int32_t * vertexfaces,
+                              const int numvertices,
+                              const int32_t * vertex,
+                              const int32_t * face,
+                              const int num,
+                              const float threshold,
+                              SbVec3f * normals);
+
+#endif // !COIN_SONORMALGENERATORP_H
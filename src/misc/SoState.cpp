@@ -66,16 +66,38 @@
 */
 
 /*!
-  SoElement * SoState::getElementNoPush(const int stackindex) const
+  \class SoStateSnapshot Inventor/misc/SoStateSnapshot.h
+  \brief The SoStateSnapshot class is an immutable copy of the elements of an SoState.
+  \ingroup general
 
-  This method returns a pointer to a writable element without
-  checking for state depth.  Use with care.
+  Snapshots are created with SoState::createSnapshot(), and hold the
+  top element of every enabled element stack at the time of
+  creation. They can be used to seed another SoState through
+  SoState::restoreSnapshot(), which makes it possible to resume a
+  traversal at a given point later, or from another thread, without
+  traversing the scene graph up to that point again.
+
+  Elements are not copied. The snapshot shares the element instances
+  with the state it was taken from, and the state will push a new
+  element instead of modifying an element that is part of a
+  snapshot. A snapshot is therefore created in time proportional to
+  the number of elements changed since the previous snapshot of the
+  same state.
+
+  Snapshots are reference counted, and may be referenced and read
+  from any thread. Nodes and other data referenced by the elements
+  are not referenced by the snapshot, and must be kept alive by the
+  application for as long as the snapshot is used.
+
+  \since Coin 4.0
 */
 
 #include <Inventor/misc/SoState.h>
+#include <Inventor/misc/SoStateSnapshot.h>
 
 #include <Inventor/SbName.h>
 #include <Inventor/elements/SoElement.h>
+#include <Inventor/elements/SoCacheElement.h>
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/lists/SoTypeList.h>
 #include <Inventor/lists/SbList.h>
@@ -84,7 +106,10 @@
 #include "config.h"
 #endif // HAVE_CONFIG_H
 
+#include "misc/SoStateP.h"
 #include "rendering/SoGL.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
 
 // *************************************************************************
 
@@ -101,14 +126,91 @@ public:
   sostate_pushstore * prev;
 };
 
-// class to store private data members
-class SoStateP {
+// An element referenced by one or more snapshots. The element is
+// owned by the state it was created in for as long as it is part of
+// that state's element stacks, and by the snapshots (and the states
+// seeded from them) after that.
+class sostate_frozen {
 public:
-  SoAction * action;
-  SoElement ** initial;
-  int depth;
-  SbBool ispopping;
-  class sostate_pushstore * pushstore;
+  SoElement * element;
+  int refcount; // snapshots and seeded states using the element
+  SoState * owner; // NULL when the element has been detached from its state
+};
+
+// protects the reference counts of snapshots and frozen elements,
+// which may be used from several threads
+static void * sostate_snapshot_mutex = NULL;
+
+static void
+sostate_snapshot_cleanup(void)
+{
+  CC_MUTEX_DESTRUCT(sostate_snapshot_mutex);
+}
+
+static void
+sostate_snapshot_lock(void)
+{
+  if (sostate_snapshot_mutex == NULL) {
+    CC_MUTEX_CONSTRUCT(sostate_snapshot_mutex);
+    coin_atexit(sostate_snapshot_cleanup, CC_ATEXIT_NORMAL);
+  }
+  CC_MUTEX_LOCK(sostate_snapshot_mutex);
+}
+
+static void
+sostate_snapshot_unlock(void)
+{
+  CC_MUTEX_UNLOCK(sostate_snapshot_mutex);
+}
+
+static void
+sostate_frozen_ref(sostate_frozen * frozen)
+{
+  sostate_snapshot_lock();
+  frozen->refcount++;
+  sostate_snapshot_unlock();
+}
+
+static void
+sostate_frozen_unref(sostate_frozen * frozen)
+{
+  sostate_snapshot_lock();
+  const SbBool destroy = (--frozen->refcount == 0) && (frozen->owner == NULL);
+  sostate_snapshot_unlock();
+  if (destroy) {
+    delete frozen->element;
+    delete frozen;
+  }
+}
+
+// the maximum number of elements created at once by
+// SoStateP::growPool()
+#define SOSTATE_MAX_POOL_BATCH 8
+
+// the maximum number of snapshots chained together before a
+// snapshot of all elements is made
+#define SOSTATE_MAX_SNAPSHOT_CHAIN 8
+
+class SoStateSnapshotP {
+public:
+  SoStateSnapshotP(void) {
+    this->parent = NULL;
+    this->table = NULL;
+    this->numstacks = 0;
+    this->chainlength = 0;
+    this->refcount = 0;
+  }
+  // a snapshot either holds all elements in 'table', or the elements
+  // changed since 'parent' in 'indices' and 'elements'
+  SoStateSnapshot * parent;
+  sostate_frozen ** table;
+  SbList <int> indices;
+  SbList <sostate_frozen *> elements;
+  int numstacks;
+  int chainlength;
+  int32_t refcount;
+
+  sostate_frozen * find(const int stackindex) const;
 };
 
 #define PRIVATE(obj) ((obj)->pimpl)
@@ -132,6 +234,11 @@ SoState::SoState(SoAction * theAction, const SoTypeList & enabledelements)
   PRIVATE(this)->action = theAction;
   PRIVATE(this)->depth = 0;
   PRIVATE(this)->ispopping = FALSE;
+  PRIVATE(this)->cow = FALSE;
+  PRIVATE(this)->frozen = NULL;
+  PRIVATE(this)->shared = NULL;
+  PRIVATE(this)->lastsnapshot = NULL;
+  PRIVATE(this)->ischanged = NULL;
   this->cacheopen = FALSE;
 
   int i;
@@ -141,10 +248,11 @@ SoState::SoState(SoAction * theAction, const SoTypeList & enabledelements)
   // the stack member can be accessed from inline methods, and is
   // therefore not moved to the private class.
   this->stack = new SoElement * [this->numstacks];
-  PRIVATE(this)->initial = new SoElement * [this->numstacks];
+  PRIVATE(this)->pool = new SbList <SoElement *>[this->numstacks];
+  PRIVATE(this)->level = new int[this->numstacks];
 
   for (i = 0; i < this->numstacks; i++) {
-    PRIVATE(this)->initial[i] = NULL;
+    PRIVATE(this)->level[i] = 0;
     this->stack[i] = NULL;
   }
 
@@ -157,7 +265,7 @@ SoState::SoState(SoAction * theAction, const SoTypeList & enabledelements)
       element->setDepth(PRIVATE(this)->depth);
       const int stackindex = element->getStackIndex();
       this->stack[stackindex] = element;
-      PRIVATE(this)->initial[stackindex] = element;
+      PRIVATE(this)->pool[stackindex].append(element);
       element->init(this); // called for first element in state stack
     }
   }
@@ -173,17 +281,31 @@ SoState::SoState(SoAction * theAction, const SoTypeList & enabledelements)
 
 SoState::~SoState(void)
 {
+  if (PRIVATE(this)->lastsnapshot) PRIVATE(this)->lastsnapshot->unref();
+
   for (int i = 0; i < this->numstacks; i++) {
-    SoElement * elem = PRIVATE(this)->initial[i];
-    SoElement * next;
-    while (elem) {
-      next = elem->nextup;
-      delete elem;
-      elem = next;
+    const SbList <SoElement *> & pool = PRIVATE(this)->pool[i];
+    for (int j = 0; j < pool.getLength(); j++) {
+      SoElement * elem = pool[j];
+      // elements still used by a snapshot are taken over by the snapshot
+      if (!PRIVATE(this)->cow ||
+          !PRIVATE(this)->isFrozen(i, elem) ||
+          PRIVATE(this)->detach(i, elem)) {
+        delete elem;
+      }
     }
   }
+  if (PRIVATE(this)->cow) {
+    for (int i = 0; i < this->numstacks; i++) {
+      if (PRIVATE(this)->shared[i]) sostate_frozen_unref(PRIVATE(this)->shared[i]);
+    }
+    delete[] PRIVATE(this)->frozen;
+    delete[] PRIVATE(this)->shared;
+    delete[] PRIVATE(this)->ischanged;
+  }
 
-  delete[] PRIVATE(this)->initial;
+  delete[] PRIVATE(this)->pool;
+  delete[] PRIVATE(this)->level;
   delete[] this->stack;
 
   sostate_pushstore * item = PRIVATE(this)->pushstore;
@@ -223,6 +345,7 @@ SoState::getElement(const int stackindex)
   assert(!PRIVATE(this)->ispopping);
 
   if (!this->isElementEnabled(stackindex)) return NULL;
+  if (PRIVATE(this)->cow) return PRIVATE(this)->getElementCOW(this, stackindex);
   SoElement * element = this->stack[stackindex];
 
 #if 0 // debug
@@ -237,12 +360,8 @@ SoState::getElement(const int stackindex)
 #endif // debug
 
   if (element->getDepth() < PRIVATE(this)->depth) { // create elt of correct depth
-    SoElement * next = element->nextup;
-    if (! next) { // allocate new element
-      next = (SoElement *) element->getTypeId().createInstance();
-      next->nextdown = element;
-      element->nextup = next;
-    }
+    SoElement * next = PRIVATE(this)->pushElement(stackindex);
+    assert(next->nextdown == element);
     next->setDepth(PRIVATE(this)->depth);
     next->push(this);
     this->stack[stackindex] = next;
@@ -252,6 +371,30 @@ SoState::getElement(const int stackindex)
   return element;
 }
 
+/*!
+  This method returns a pointer to a writable element without
+  checking for state depth.  Use with care.
+
+  If the top element is used by a snapshot, a copy of it is pushed
+  and returned instead, as for getElement().
+
+  \sa createSnapshot()
+*/
+
+SoElement *
+SoState::getElementNoPush(const int stackindex) const
+{
+  assert(this->isElementEnabled(stackindex));
+  SoElement * element = this->stack[stackindex];
+  if (PRIVATE(this)->cow && !PRIVATE(this)->ispopping) {
+    SoState * thisp = const_cast<SoState *>(this);
+    if (SoStateP::isShared(thisp, stackindex, element)) {
+      element = PRIVATE(this)->getElementCOW(thisp, stackindex);
+    }
+  }
+  return element;
+}
+
 /*!
   This method pushes the state one level down.  This saves the state so it can
   be changed and later restored to this state by calling SoState::pop().
@@ -286,13 +429,16 @@ SoState::pop(void)
   PRIVATE(this)->ispopping = TRUE;
   PRIVATE(this)->depth--;
   int n = PRIVATE(this)->pushstore->elements.getLength();
-  if (n) {
+  if (PRIVATE(this)->cow) {
+    PRIVATE(this)->popCOW(this);
+  }
+  else if (n) {
     const int * array = PRIVATE(this)->pushstore->elements.getArrayPtr();
     for (int i = n-1; i >= 0; i--) {
       int idx = array[i];
       SoElement * elem = this->stack[idx];
-      SoElement * prev = elem->nextdown;
-      assert(prev);
+      SoElement * prev = PRIVATE(this)->popElement(idx);
+      assert(prev == elem->nextdown);
       prev->pop(this, elem);
       this->stack[idx] = prev;
     }
@@ -302,6 +448,114 @@ SoState::pop(void)
   PRIVATE(this)->ispopping = FALSE;
 }
 
+/*!
+  Creates a snapshot of the top element of all enabled element
+  stacks, except the SoCacheElement stack.
+
+  The state keeps a reference to the snapshot until the next snapshot
+  is created, so subsequent snapshots only need to record the
+  elements changed since then. Call SoStateSnapshot::ref() to keep
+  the snapshot around after that.
+
+  After the first snapshot has been created, the state will push a
+  new element rather than modify an element used by a snapshot, and
+  elements which are popped while still used by a snapshot are
+  handed over to the snapshot.
+
+  \sa restoreSnapshot()
+  \since Coin 4.0
+*/
+SoStateSnapshot *
+SoState::createSnapshot(void)
+{
+  PRIVATE(this)->initCOW(this->numstacks);
+
+  SoStateSnapshot * snapshot = new SoStateSnapshot;
+  SoStateSnapshotP * sp = snapshot->pimpl;
+  sp->numstacks = this->numstacks;
+
+  const int cacheindex = SoCacheElement::getClassStackIndex();
+  SoStateSnapshot * last = PRIVATE(this)->lastsnapshot;
+  if (last && last->pimpl->chainlength < SOSTATE_MAX_SNAPSHOT_CHAIN) {
+    last->ref();
+    sp->parent = last;
+    sp->chainlength = last->pimpl->chainlength + 1;
+    for (int i = 0; i < PRIVATE(this)->changed.getLength(); i++) {
+      const int idx = PRIVATE(this)->changed[i];
+      if (idx != cacheindex) {
+        sp->indices.append(idx);
+        sp->elements.append(PRIVATE(this)->freeze(this, idx));
+      }
+    }
+  }
+  else {
+    sp->table = new sostate_frozen * [this->numstacks];
+    for (int i = 0; i < this->numstacks; i++) {
+      sp->table[i] = (this->stack[i] && i != cacheindex) ?
+        PRIVATE(this)->freeze(this, i) : NULL;
+    }
+  }
+  for (int i = 0; i < PRIVATE(this)->changed.getLength(); i++) {
+    PRIVATE(this)->ischanged[PRIVATE(this)->changed[i]] = 0;
+  }
+  PRIVATE(this)->changed.truncate(0);
+
+  snapshot->ref();
+  if (last) last->unref();
+  PRIVATE(this)->lastsnapshot = snapshot;
+  return snapshot;
+}
+
+/*!
+  Makes the elements of \a snapshot the bottom elements of this
+  state, so that a traversal with this state continues from where the
+  snapshot was created. The snapshot may have been created from any
+  state with the same set of enabled elements, and may be restored
+  into several states at once, also from other threads.
+
+  This method must be called while the state is at depth 0,
+  i.e. before traversal starts. The snapshot stays in effect for all
+  following traversals until this method is called again. Passing
+  NULL reverts the state to its own default elements.
+
+  The restored elements are used read-only. Changes made during the
+  traversal are pushed on top of them, and SoElement::pop() is not
+  called for them. GL elements are not sent to GL when restored, so
+  the method is meant for non-GL actions, like picking and bounding
+  box calculations.
+
+  \sa createSnapshot()
+  \since Coin 4.0
+*/
+void
+SoState::restoreSnapshot(const SoStateSnapshot * snapshot)
+{
+  if (PRIVATE(this)->depth != 0) {
+    SoDebugError::post("SoState::restoreSnapshot",
+                       "a snapshot can only be restored at depth 0, "
+                       "not during traversal");
+    return;
+  }
+  PRIVATE(this)->initCOW(this->numstacks);
+
+  for (int i = 0; i < this->numstacks; i++) {
+    if (this->stack[i] == NULL) continue;
+    sostate_frozen * frozen = snapshot ? snapshot->pimpl->find(i) : NULL;
+    sostate_frozen * old = PRIVATE(this)->shared[i];
+    SoElement * element = frozen ? frozen->element : PRIVATE(this)->pool[i][0];
+    if (frozen == old && this->stack[i] == element) continue;
+
+    if (frozen != old) {
+      if (frozen) sostate_frozen_ref(frozen);
+      PRIVATE(this)->shared[i] = frozen;
+      if (old) sostate_frozen_unref(old);
+    }
+    this->stack[i] = element;
+    PRIVATE(this)->level[i] = 0;
+    PRIVATE(this)->markChanged(i);
+  }
+}
+
 /*!
   This method is just for debugging purposes.
 */
@@ -341,4 +595,532 @@ SoState::setCacheOpen(const SbBool open)
   this->cacheopen = open;
 }
 
+// *************************************************************************
+
+void
+SoStateP::initCOW(const int numstacks)
+{
+  if (this->cow) return;
+  this->frozen = new SbList <sostate_frozen *>[numstacks];
+  this->shared = new sostate_frozen * [numstacks];
+  this->ischanged = new unsigned char[numstacks];
+  for (int i = 0; i < numstacks; i++) {
+    this->shared[i] = NULL;
+    this->ischanged[i] = 0;
+  }
+  this->cow = TRUE;
+}
+
+// Returns TRUE if element is used by a snapshot. Records of elements
+// no longer used by any snapshot are removed.
+SbBool
+SoStateP::isFrozen(const int stackindex, const SoElement * element)
+{
+  SbList <sostate_frozen *> & list = this->frozen[stackindex];
+  for (int i = 0; i < list.getLength(); i++) {
+    sostate_frozen * frozen = list[i];
+    if (frozen->element == element) {
+      sostate_snapshot_lock();
+      const SbBool used = frozen->refcount > 0;
+      sostate_snapshot_unlock();
+      if (!used) {
+        list.removeFast(i);
+        delete frozen;
+      }
+      return used;
+    }
+  }
+  return FALSE;
+}
+
+// Removes element from this state's bookkeeping. Returns TRUE if the
+// state still owns the element, FALSE if it has been handed over to
+// the snapshots using it. The element must not be touched by the
+// state after that.
+SbBool
+SoStateP::detach(const int stackindex, SoElement * element)
+{
+  SbList <sostate_frozen *> & list = this->frozen[stackindex];
+  for (int i = 0; i < list.getLength(); i++) {
+    sostate_frozen * frozen = list[i];
+    if (frozen->element == element) {
+      list.removeFast(i);
+      sostate_snapshot_lock();
+      const SbBool owned = frozen->refcount == 0;
+      if (!owned) frozen->owner = NULL;
+      sostate_snapshot_unlock();
+      if (owned) delete frozen;
+      else {
+        // the element is no longer part of this state's stacks, and
+        // must not lead other states using it into them
+        element->nextup = element->nextdown = NULL;
+      }
+      return owned;
+    }
+  }
+  return TRUE;
+}
+
+// Returns a referenced record for the top element of a stack.
+sostate_frozen *
+SoStateP::freeze(SoState * state, const int stackindex)
+{
+  SoElement * element = state->stack[stackindex];
+  sostate_frozen * frozen = this->shared[stackindex];
+  if (frozen && frozen->element == element) {
+    sostate_frozen_ref(frozen);
+    return frozen;
+  }
+  SbList <sostate_frozen *> & list = this->frozen[stackindex];
+  for (int i = 0; i < list.getLength(); i++) {
+    if (list[i]->element == element) {
+      sostate_frozen_ref(list[i]);
+      return list[i];
+    }
+  }
+  frozen = new sostate_frozen;
+  frozen->element = element;
+  frozen->refcount = 1;
+  frozen->owner = state;
+  list.append(frozen);
+  return frozen;
+}
+
+// SoState::getElement() for states which share elements with
+// snapshots. Such elements are never modified, a new element is
+// pushed on top of them instead.
+SoElement *
+SoStateP::getElementCOW(SoState * state, const int stackindex)
+{
+  SoElement * element = state->stack[stackindex];
+  SbBool push = element->getDepth() < this->depth;
+  // restored elements are not linked into this state's stacks, and
+  // the top position is the initial element while they are used
+  const SbBool restored =
+    this->shared[stackindex] && this->shared[stackindex]->element == element;
+
+  if (restored || (!push && this->isFrozen(stackindex, element))) {
+    push = TRUE;
+  }
+  if (!push) return element;
+
+  SbList <SoElement *> & pool = this->pool[stackindex];
+  const int pos = this->level[stackindex] + 1;
+  SoElement * below = pool[pos-1]; // the element to link the new element above
+  SoElement * next = NULL;
+  if (pos < pool.getLength()) {
+    next = pool[pos];
+    if (this->isFrozen(stackindex, next)) {
+      SoElement * above = next->nextup;
+      if (!this->detach(stackindex, next)) {
+        // link in a new element in place of the snapshot's element
+        next = (SoElement *) element->getTypeId().createInstance();
+        next->nextup = above;
+        if (above) above->nextdown = next;
+        below->nextup = next;
+        pool[pos] = next;
+      }
+    }
+    this->level[stackindex] = pos;
+  }
+  else {
+    next = this->pushElement(stackindex);
+  }
+  next->nextdown = element;
+  next->setDepth(this->depth);
+  next->push(state);
+  // SoElement::push() copies from the restored element, but the
+  // element is not linked to it, so elements walking down their
+  // stack never reach the stacks of the state the snapshot was
+  // created in. popCOW() returns to the restored element instead.
+  if (restored) next->nextdown = below;
+  state->stack[stackindex] = next;
+  this->pushstore->elements.append(stackindex);
+  this->markChanged(stackindex);
+  return next;
+}
+
+// SoState::pop() for states which share elements with snapshots.
+void
+SoStateP::popCOW(SoState * state)
+{
+  const int n = this->pushstore->elements.getLength();
+  const int * array = this->pushstore->elements.getArrayPtr();
+  for (int i = n-1; i >= 0; i--) {
+    const int idx = array[i];
+    SoElement * elem = state->stack[idx];
+    SoElement * prev = this->popElement(idx);
+    assert(prev == elem->nextdown);
+    if (this->shared[idx] && this->level[idx] == 0) {
+      // elem was pushed on top of an element restored from a
+      // snapshot, which may be used by other states
+      state->stack[idx] = this->shared[idx]->element;
+    }
+    else {
+      prev->pop(state, elem);
+      state->stack[idx] = prev;
+    }
+    this->markChanged(idx);
+  }
+}
+
+SbBool
+SoStateP::isShared(SoState * state, const int stackindex,
+                   const SoElement * element)
+{
+  SoStateP * thisp = PRIVATE(state);
+  if (!thisp->cow) return FALSE;
+  if (thisp->shared[stackindex] &&
+      thisp->shared[stackindex]->element == element) return TRUE;
+  return thisp->isFrozen(stackindex, element);
+}
+
+// Links copy into the stack in place of element, which must be
+// linked into the stack and not restored from a snapshot. The
+// element is handed over to the snapshots using it.
+void
+SoStateP::replaceElement(SoState * state, const int stackindex,
+                         SoElement * element, SoElement * copy)
+{
+  SoStateP * thisp = PRIVATE(state);
+  assert(!thisp->shared[stackindex] ||
+         thisp->shared[stackindex]->element != element);
+
+  copy->setDepth(element->getDepth());
+  copy->nextdown = element->nextdown;
+  copy->nextup = element->nextup;
+  if (copy->nextdown) copy->nextdown->nextup = copy;
+  if (copy->nextup) copy->nextup->nextdown = copy;
+  SbList <SoElement *> & pool = thisp->pool[stackindex];
+  const int pos = pool.find(element);
+  assert(pos >= 0);
+  pool[pos] = copy;
+  if (state->stack[stackindex] == element) {
+    state->stack[stackindex] = copy;
+    thisp->markChanged(stackindex);
+  }
+  if (thisp->detach(stackindex, element)) delete element;
+}
+
+// Creates elements above the last element of a stack, and returns
+// the element at the top position.
+SoElement *
+SoStateP::growPool(const int stackindex)
+{
+  SbList <SoElement *> & pool = this->pool[stackindex];
+  const SoType type = pool[0]->getTypeId();
+  const int num = SbMin(pool.getLength(), SOSTATE_MAX_POOL_BATCH);
+  for (int i = 0; i < num; i++) {
+    SoElement * below = pool[pool.getLength() - 1];
+    SoElement * element = (SoElement *) type.createInstance();
+    element->nextdown = below;
+    below->nextup = element;
+    pool.append(element);
+  }
+  return pool[this->level[stackindex]];
+}
+
 #undef PRIVATE
+
+// *************************************************************************
+
+#define PRIVATE(obj) ((obj)->pimpl)
+
+sostate_frozen *
+SoStateSnapshotP::find(const int stackindex) const
+{
+  const SoStateSnapshotP * snapshot = this;
+  while (snapshot) {
+    if (snapshot->table) return snapshot->table[stackindex];
+    for (int i = 0; i < snapshot->indices.getLength(); i++) {
+      if (snapshot->indices[i] == stackindex) return snapshot->elements[i];
+    }
+    snapshot = snapshot->parent ? snapshot->parent->pimpl : NULL;
+  }
+  return NULL;
+}
+
+// Snapshots are only created by SoState::createSnapshot().
+SoStateSnapshot::SoStateSnapshot(void)
+{
+  PRIVATE(this) = new SoStateSnapshotP;
+}
+
+SoStateSnapshot::~SoStateSnapshot()
+{
+  if (PRIVATE(this)->table) {
+    for (int i = 0; i < PRIVATE(this)->numstacks; i++) {
+      if (PRIVATE(this)->table[i]) sostate_frozen_unref(PRIVATE(this)->table[i]);
+    }
+    delete[] PRIVATE(this)->table;
+  }
+  for (int i = 0; i < PRIVATE(this)->elements.getLength(); i++) {
+    sostate_frozen_unref(PRIVATE(this)->elements[i]);
+  }
+  if (PRIVATE(this)->parent) PRIVATE(this)->parent->unref();
+  delete PRIVATE(this);
+}
+
+/*!
+  Increases the reference count of the snapshot.
+*/
+void
+SoStateSnapshot::ref(void) const
+{
+  sostate_snapshot_lock();
+  PRIVATE(this)->refcount++;
+  sostate_snapshot_unlock();
+}
+
+/*!
+  Decreases the reference count of the snapshot, and destructs it when
+  the count reaches zero.
+*/
+void
+SoStateSnapshot::unref(void) const
+{
+  sostate_snapshot_lock();
+  const SbBool destroy = (--PRIVATE(this)->refcount == 0);
+  sostate_snapshot_unlock();
+  if (destroy) delete this;
+}
+
+/*!
+  Returns the reference count of the snapshot.
+*/
+int32_t
+SoStateSnapshot::getRefCount(void) const
+{
+  return PRIVATE(this)->refcount;
+}
+
+/*!
+  Returns TRUE if the snapshot holds an element for the given element
+  stack index.
+*/
+SbBool
+SoStateSnapshot::isElementEnabled(const int stackindex) const
+{
+  return (stackindex < PRIVATE(this)->numstacks) &&
+    (PRIVATE(this)->find(stackindex) != NULL);
+}
+
+/*!
+  Returns the element the snapshot holds for the given element stack
+  index. The element is read-only, and must not be changed.
+*/
+const SoElement *
+SoStateSnapshot::getConstElement(const int stackindex) const
+{
+  assert(this->isElementEnabled(stackindex));
+  return PRIVATE(this)->find(stackindex)->element;
+}
+
+#undef PRIVATE
+#undef SOSTATE_MAX_SNAPSHOT_CHAIN
+#undef SOSTATE_MAX_POOL_BATCH
+
+// *************************************************************************
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbVec3f.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/elements/SoBBoxModelMatrixElement.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoComplexityElement.h>
+#include <Inventor/elements/SoFontSizeElement.h>
+#include <Inventor/elements/SoLocalBBoxMatrixElement.h>
+#include <Inventor/elements/SoModelMatrixElement.h>
+#include <Inventor/lists/SoTypeList.h>
+#include <Inventor/misc/SoStateSnapshot.h>
+#include <Inventor/nodes/SoCallback.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+static SbVec3f
+sostate_test_local_translation(SoState * state)
+{
+  SbVec3f translation;
+  SoLocalBBoxMatrixElement::get(state).multVecMatrix(SbVec3f(0.0f, 0.0f, 0.0f), translation);
+  return translation;
+}
+
+static void
+sostate_test_snapshot_cb(void * closure, SoAction * action)
+{
+  if (closure && action->isOfType(SoGetBoundingBoxAction::getClassTypeId())) {
+    SoStateSnapshot ** snapshot = static_cast<SoStateSnapshot **>(closure);
+    *snapshot = action->getState()->createSnapshot();
+    (*snapshot)->ref();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(snapshots)
+{
+  SoTypeList elements;
+  elements.append(SoComplexityElement::getClassTypeId());
+  elements.append(SoFontSizeElement::getClassTypeId());
+  elements.append(SoModelMatrixElement::getClassTypeId());
+
+  SoState * state = new SoState(NULL, elements);
+  state->push();
+  SoComplexityElement::set(state, 0.25f);
+  SoModelMatrixElement::translateBy(state, NULL, SbVec3f(1.0f, 0.0f, 0.0f));
+  SoStateSnapshot * snapshot = state->createSnapshot();
+  snapshot->ref();
+  BOOST_CHECK(snapshot->isElementEnabled(SoComplexityElement::getClassStackIndex()));
+  BOOST_CHECK(!snapshot->isElementEnabled(SoCacheElement::getClassStackIndex()));
+
+  // the state must leave the snapshot's elements alone, both when
+  // setting them at the same depth and when reusing popped elements
+  SoComplexityElement::set(state, 0.5f);
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(state), 0.5f);
+  state->pop();
+  state->push();
+  SoComplexityElement::set(state, 0.75f);
+  SoFontSizeElement::set(state, 20.0f);
+  SoModelMatrixElement::translateBy(state, NULL, SbVec3f(0.0f, 2.0f, 0.0f));
+  SoStateSnapshot * changed = state->createSnapshot();
+  changed->ref();
+  state->pop();
+  delete state;
+
+  SbVec3f translation;
+  SoState * seeded = new SoState(NULL, elements);
+  seeded->restoreSnapshot(snapshot);
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(seeded), 0.25f);
+  BOOST_CHECK_EQUAL(SoFontSizeElement::get(seeded), SoFontSizeElement::getDefault());
+  SoModelMatrixElement::get(seeded).multVecMatrix(SbVec3f(0.0f, 0.0f, 0.0f), translation);
+  BOOST_CHECK(translation == SbVec3f(1.0f, 0.0f, 0.0f));
+
+  // changes are pushed on top of the restored elements
+  seeded->push();
+  SoComplexityElement::set(seeded, 1.0f);
+  SoModelMatrixElement::translateBy(seeded, NULL, SbVec3f(0.0f, 0.0f, 3.0f));
+  SoModelMatrixElement::get(seeded).multVecMatrix(SbVec3f(0.0f, 0.0f, 0.0f), translation);
+  BOOST_CHECK(translation == SbVec3f(1.0f, 0.0f, 3.0f));
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(seeded), 1.0f);
+  seeded->pop();
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(seeded), 0.25f);
+
+  seeded->restoreSnapshot(changed);
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(seeded), 0.75f);
+  BOOST_CHECK_EQUAL(SoFontSizeElement::get(seeded), 20.0f);
+  SoModelMatrixElement::get(seeded).multVecMatrix(SbVec3f(0.0f, 0.0f, 0.0f), translation);
+  BOOST_CHECK(translation == SbVec3f(0.0f, 2.0f, 0.0f));
+
+  // a snapshot of a seeded state holds the restored elements
+  SoStateSnapshot * copy = seeded->createSnapshot();
+  copy->ref();
+  seeded->restoreSnapshot(NULL);
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(seeded), SoComplexityElement::getDefault());
+  seeded->restoreSnapshot(copy);
+  BOOST_CHECK_EQUAL(SoComplexityElement::get(seeded), 0.75f);
+  delete seeded;
+
+  snapshot->unref();
+  changed->unref();
+  BOOST_CHECK_EQUAL(copy->getRefCount(), 1);
+  copy->unref();
+}
+
+BOOST_AUTO_TEST_CASE(snapshotPopBelowRestoredDepth)
+{
+  SoTypeList elements;
+  elements.append(SoBBoxModelMatrixElement::getClassTypeId());
+  elements.append(SoLocalBBoxMatrixElement::getClassTypeId());
+
+  SoState * state = new SoState(NULL, elements);
+  int i;
+  for (i = 0; i < 3; i++) {
+    state->push();
+    SoLocalBBoxMatrixElement::translateBy(state, SbVec3f(1.0f, 0.0f, 0.0f));
+  }
+  SoStateSnapshot * snapshot = state->createSnapshot();
+  snapshot->ref();
+  for (i = 0; i < 3; i++) state->pop();
+  delete state;
+
+  // the restored element was pushed at depth 3 in a state which no
+  // longer exists, and the seeded state must not follow it there
+  SoState * seeded = new SoState(NULL, elements);
+  seeded->restoreSnapshot(snapshot);
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(3.0f, 0.0f, 0.0f));
+
+  SbMatrix matrix = SoLocalBBoxMatrixElement::pushMatrix(seeded);
+  SoLocalBBoxMatrixElement::popMatrix(seeded, SbMatrix::identity());
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(0.0f, 0.0f, 0.0f));
+  SoLocalBBoxMatrixElement::popMatrix(seeded, matrix);
+
+  for (i = 0; i < 4; i++) {
+    seeded->push();
+    SoLocalBBoxMatrixElement::translateBy(seeded, SbVec3f(0.0f, 1.0f, 0.0f));
+  }
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(3.0f, 4.0f, 0.0f));
+  SoLocalBBoxMatrixElement::resetAll(seeded);
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(0.0f, 0.0f, 0.0f));
+  for (i = 0; i < 4; i++) seeded->pop();
+
+  seeded->restoreSnapshot(snapshot);
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(3.0f, 0.0f, 0.0f));
+  seeded->restoreSnapshot(NULL);
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(0.0f, 0.0f, 0.0f));
+  delete seeded;
+  snapshot->unref();
+}
+
+BOOST_AUTO_TEST_CASE(snapshotBoundingBoxReset)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoTranslation * translation = new SoTranslation;
+  translation->translation = SbVec3f(1.0f, 0.0f, 0.0f);
+  root->addChild(translation);
+  SoCallback * callback = new SoCallback;
+  root->addChild(callback);
+  SoSeparator * sep = new SoSeparator;
+  root->addChild(sep);
+  translation = new SoTranslation;
+  translation->translation = SbVec3f(0.0f, 2.0f, 0.0f);
+  sep->addChild(translation);
+  SoCube * cube = new SoCube;
+  sep->addChild(cube);
+
+  SoPath * path = new SoPath(root);
+  path->ref();
+  path->append(sep);
+  path->append(cube);
+
+  SoGetBoundingBoxAction reference(SbViewportRegion(100, 100));
+  reference.setResetPath(path, TRUE, SoGetBoundingBoxAction::TRANSFORM);
+  reference.apply(root);
+
+  // resetting the transform below the snapshot must leave the
+  // snapshot's local matrix alone
+  SoStateSnapshot * snapshot = NULL;
+  callback->setCallback(sostate_test_snapshot_cb, &snapshot);
+  SoGetBoundingBoxAction action(SbViewportRegion(100, 100));
+  action.setResetPath(path, TRUE, SoGetBoundingBoxAction::TRANSFORM);
+  action.apply(root);
+  BOOST_REQUIRE(snapshot != NULL);
+  BOOST_CHECK(action.getBoundingBox().getMin() == reference.getBoundingBox().getMin());
+  BOOST_CHECK(action.getBoundingBox().getMax() == reference.getBoundingBox().getMax());
+
+  SoTypeList elements;
+  elements.append(SoBBoxModelMatrixElement::getClassTypeId());
+  elements.append(SoLocalBBoxMatrixElement::getClassTypeId());
+  SoState * seeded = new SoState(NULL, elements);
+  seeded->restoreSnapshot(snapshot);
+  BOOST_CHECK(sostate_test_local_translation(seeded) == SbVec3f(1.0f, 0.0f, 0.0f));
+  delete seeded;
+
+  snapshot->unref();
+  path->unref();
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
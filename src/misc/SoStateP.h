@@ -0,0 +1,101 @@
+#ifndef COIN_SOSTATEP_H
+#define COIN_SOSTATEP_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <Inventor/lists/SbList.h>
+
+class SoAction;
+class SoElement;
+class SoState;
+class SoStateSnapshot;
+class sostate_pushstore;
+class sostate_frozen;
+
+// class to store private data members
+class SoStateP {
+public:
+  SoAction * action;
+  int depth;
+  SbBool ispopping;
+  sostate_pushstore * pushstore;
+
+  // The elements of each stack in the order they are linked, with
+  // the initial element first, and the position of the top element
+  // in 'level'. Push and pop move the position instead of following
+  // the links between the elements. Elements are created in batches
+  // by growPool(), so elements of one type end up close in memory.
+  SbList <SoElement *> * pool;
+  int * level;
+
+  SoElement * pushElement(const int stackindex) {
+    const int pos = ++this->level[stackindex];
+    if (pos < this->pool[stackindex].getLength()) return this->pool[stackindex][pos];
+    return this->growPool(stackindex);
+  }
+  SoElement * popElement(const int stackindex) {
+    return this->pool[stackindex][--this->level[stackindex]];
+  }
+  SoElement * growPool(const int stackindex);
+
+  // Copy-on-write bookkeeping, only used after a snapshot has been
+  // created from, or restored into, this state. 'frozen' holds the
+  // elements of each stack that are referenced by snapshots, and
+  // 'shared' the elements restored from a snapshot. These are never
+  // modified by the state.
+  SbBool cow;
+  SbList <sostate_frozen *> * frozen;
+  sostate_frozen ** shared;
+  SoStateSnapshot * lastsnapshot;
+  SbList <int> changed;
+  unsigned char * ischanged;
+
+  void initCOW(const int numstacks);
+  SoElement * getElementCOW(SoState * state, const int stackindex);
+  void popCOW(SoState * state);
+  SbBool isFrozen(const int stackindex, const SoElement * element);
+  SbBool detach(const int stackindex, SoElement * element);
+  sostate_frozen * freeze(SoState * state, const int stackindex);
+  void markChanged(const int stackindex) {
+    if (this->lastsnapshot && !this->ischanged[stackindex]) {
+      this->ischanged[stackindex] = 1;
+      this->changed.append(stackindex);
+    }
+  }
+
+  // For elements which modify elements below the top of their stack,
+  // like SoLocalBBoxMatrixElement::resetAll(). Such elements must
+  // check isShared() and use a copy installed with replaceElement()
+  // instead of modifying an element used by a snapshot.
+  static SbBool isShared(SoState * state, const int stackindex,
+                         const SoElement * element);
+  static void replaceElement(SoState * state, const int stackindex,
+                             SoElement * element, SoElement * copy);
+};
+
+#endif // !COIN_SOSTATEP_H
@@ -0,0 +1,127 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// The number of worker threads can be set with the environment
+// variable COIN_TEXTURE_THREADS. The default is 2. Set it to 0 to
+// run all texture jobs from the delay queue.
+
+#include "misc/SoTextureScheduler.h"
+
+#include <stdlib.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/C/threads/sched.h>
+#include <Inventor/C/threads/thread.h>
+#include <Inventor/sensors/SoOneShotSensor.h>
+
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+static cc_sched * sotexturescheduler_sched = NULL;
+static SbBool sotexturescheduler_init = FALSE;
+
+// atexit callback
+static void
+sotexturescheduler_cleanup(void)
+{
+  if (sotexturescheduler_sched) {
+    cc_sched_destruct(sotexturescheduler_sched);
+    sotexturescheduler_sched = NULL;
+  }
+  sotexturescheduler_init = FALSE;
+}
+
+// The worker threads are only used if Coin is built thread safe,
+// since the nodes handing over data from the jobs rely on the
+// internal mutexes for that.
+static cc_sched *
+sotexturescheduler_get(void)
+{
+  CC_GLOBAL_LOCK;
+  if (!sotexturescheduler_init) {
+    sotexturescheduler_init = TRUE;
+#ifdef COIN_THREADSAFE
+    if (cc_thread_implementation() != CC_NO_THREADS) {
+      int numthreads = 2;
+      const char * env = coin_getenv("COIN_TEXTURE_THREADS");
+      if (env) numthreads = atoi(env);
+      if (numthreads > 0) {
+        sotexturescheduler_sched = cc_sched_construct(numthreads);
+      }
+    }
+#endif // COIN_THREADSAFE
+    coin_atexit(sotexturescheduler_cleanup, CC_ATEXIT_NORMAL);
+  }
+  CC_GLOBAL_UNLOCK;
+  return sotexturescheduler_sched;
+}
+
+class sotexturescheduler_job {
+public:
+  SoTextureScheduler::JobCB * job;
+  void * closure;
+  SoOneShotSensor * sensor;
+};
+
+static void
+sotexturescheduler_sensor_cb(void * closure, SoSensor *)
+{
+  sotexturescheduler_job * data = static_cast<sotexturescheduler_job *>(closure);
+  data->job(data->closure);
+  delete data->sensor;
+  delete data;
+}
+
+// *************************************************************************
+
+// Schedules \a job to be called with \a closure. Jobs with a higher
+// \a priority are run first. The caller is responsible for keeping
+// \a closure valid until the job has been run.
+void
+SoTextureScheduler::schedule(JobCB * job, void * closure, const float priority)
+{
+  cc_sched * sched = sotexturescheduler_get();
+  if (sched) {
+    cc_sched_schedule(sched, job, closure, priority);
+  }
+  else {
+    sotexturescheduler_job * data = new sotexturescheduler_job;
+    data->job = job;
+    data->closure = closure;
+    data->sensor = new SoOneShotSensor(sotexturescheduler_sensor_cb, data);
+    data->sensor->schedule();
+  }
+}
+
+// Returns TRUE if jobs are run in worker threads.
+SbBool
+SoTextureScheduler::isThreaded(void)
+{
+  return sotexturescheduler_get() != NULL;
+}
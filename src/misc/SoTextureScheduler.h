@@ -0,0 +1,47 @@
+#ifndef COIN_SOTEXTURESCHEDULER_H
+#define COIN_SOTEXTURESCHEDULER_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif /* !COIN_INTERNAL */
+
+#include <Inventor/SbBasic.h>
+
+// Runs texture jobs (image decoding, resizing and mipmap generation)
+// in a pool of worker threads shared by all texture nodes. If threads
+// are not available, jobs are run from the delay queue instead, so
+// that they are at least kept out of the traversal which needs the
+// texture.
+
+class SoTextureScheduler {
+public:
+  typedef void JobCB(void * closure);
+
+  static void schedule(JobCB * job, void * closure, const float priority = 0.0f);
+  static SbBool isThreaded(void);
+};
+
+#endif // !COIN_SOTEXTURESCHEDULER_H
@@ -53,6 +53,7 @@
 #include "SoFullPath.cpp"
 #include "SoGenerate.cpp"
 #include "SoGlyph.cpp"
+#include "SoImageTileProvider.cpp"
 #include "SoInteraction.cpp"
 #include "SoJavaScriptEngine.cpp"
 #include "SoLightPath.cpp"
@@ -70,5 +71,6 @@
 #include "SoSceneManagerP.cpp"
 #include "SoShaderGenerator.cpp"
 #include "SoState.cpp"
+#include "SoTextureScheduler.cpp"
 #include "SoTempPath.cpp"
 #include "SoType.cpp"
@@ -47,8 +47,10 @@
 #include <Inventor/nodes/SoCallback.h>
 
 #include <Inventor/actions/SoActions.h> // SoCallback uses all of them.
+#include <Inventor/misc/SoState.h>
 
 #include "nodes/SoSubNodeP.h"
+#include "caches/SoGLRenderCacheP.h"
 
 // *************************************************************************
 
@@ -170,6 +172,14 @@ SoCallback::GLRender(SoGLRenderAction * action)
   // renderlists. Investigate, and consider whether or not we should
   // follow suit. 20051110 mortene.
 
+  // OpenGL calls made by the callback can't be baked into a vertex
+  // buffer render cache
+  SoState * state = action->getState();
+  if (state->isCacheOpen()) {
+    SoGLRenderCacheP * rendercache = SoGLRenderCacheP::getRecording(state);
+    if (rendercache) rendercache->fail("SoCallback");
+  }
+
   SoCallback::doAction(action);
 }
 
@@ -83,6 +83,7 @@
 #include <Inventor/SbBox2s.h>
 #include <Inventor/SbBox3f.h>
 #include <Inventor/SbMatrix.h>
+#include <Inventor/SbPlane.h>
 #include <Inventor/SbTesselator.h>
 #include <Inventor/SbTime.h>
 #include <Inventor/SbVec2s.h>
@@ -119,6 +120,7 @@
 #include <Inventor/misc/SoGLDriverDatabase.h>
 
 #include "nodes/SoSubNodeP.h"
+#include "caches/SoTriangleBVHCache.h"
 #include "coindefs.h" // COIN_OBSOLETED()
 
 // *************************************************************************
@@ -323,6 +325,11 @@ public:
                                             const SbBox2s & lassorect,
                                             const SbBool full);
 
+  SbBool outsideLassoRect(SoCallbackAction * action,
+                          const SbMatrix & projmatrix,
+                          const SoShape * shape,
+                          const SbBox2s & lassorect);
+
   static void offscreenLassoTesselatorCallback(void * v0, void * v1, void * v2, void * userdata);
 
   static void triangleCB(void * userData,
@@ -1641,19 +1648,14 @@ SoExtSelectionP::testBBox(SoCallbackAction * action,
 SoCallbackAction::Response
 SoExtSelectionP::testPrimitives(SoCallbackAction * action,
                                 const SbMatrix & projmatrix,
-                                const SoShape * /* shape */,
+                                const SoShape * shape,
                                 const SbBox2s & lassorect,
                                 const SbBool full)
 {
-  // FIXME: consider quick reject based on bounding box for now we
-  // just initialize some variables, and trust that the user has a
-  // sensible scene graph so that shapes are culled in the separators.
-  // ????-??-?? pederb.
-  //
-  // FIXME: I believe what pederb mention above would be a _very_
-  // important optimization -- especially when using VISIBLE_SHAPES
-  // with a small rectangle/polygon selection in a huge scene.
-  // 20050309 mortene.
+  // FIXME: the quick reject below is only done for ALL_SHAPES, since
+  // VISIBLE_SHAPES renders all triangles into the offscreen buffer
+  // for the visibility test. Rejected shapes could be rendered
+  // there directly, without the callbacks. 20261019 agent.
 
   this->primcbdata.fulltest = full;
   this->primcbdata.projmatrix = projmatrix;
@@ -1665,11 +1667,99 @@ SoExtSelectionP::testPrimitives(SoCallbackAction * action,
   this->primcbdata.abort = FALSE;
   this->primcbdata.onlyrect = (this->runningselection.mode == SelectionState::LASSO);
   this->primcbdata.hasgeometry = FALSE;
+
+  if (this->primcbdata.allshapes &&
+      this->outsideLassoRect(action, projmatrix, shape, lassorect)) {
+    return SoCallbackAction::PRUNE;
+  }
   // signal to callback action that we want to generate primitives for
   // this shape
   return SoCallbackAction::CONTINUE;
 }
 
+// Makes the object space planes of the volume projecting into the
+// screen space rectangle rect, with the normals pointing into the
+// volume. The rectangle is grown by a pixel, since project_pt()
+// truncates.
+static void
+lasso_rect_planes(const SbMatrix & projmatrix, const SbBox2s & rect,
+                  const SbVec2s & vporg, const SbVec2s & vpsize, SbPlane * planes)
+{
+  for (int axis = 0; axis < 2; axis++) {
+    const float lo = 2.0f * float(rect.getMin()[axis] - 1 - vporg[axis]) / float(vpsize[axis]) - 1.0f;
+    const float hi = 2.0f * float(rect.getMax()[axis] + 1 - vporg[axis]) / float(vpsize[axis]) - 1.0f;
+    for (int side = 0; side < 2; side++) {
+      // the clip space coordinate minus lo times w, or hi times w
+      // minus the coordinate, is positive inside
+      const float sign = side ? -1.0f : 1.0f;
+      const float bound = side ? hi : lo;
+      SbVec3f n;
+      for (int j = 0; j < 3; j++) {
+        n[j] = sign * (projmatrix[j][axis] - bound * projmatrix[j][3]);
+      }
+      const float c = sign * (projmatrix[3][axis] - bound * projmatrix[3][3]);
+      const float len = n.length();
+      if (len > 0.0f) planes[2 * axis + side] = SbPlane(n / len, -c / len);
+      else planes[2 * axis + side] = SbPlane(SbVec3f(0.0f, 0.0f, 1.0f), -FLT_MAX);
+    }
+  }
+}
+
+// Returns TRUE if shape is certain to have no primitives touching the
+// lasso rectangle, using the shape bounding box and the triangle tree
+// the shape keeps for picking. The test is only done for shapes
+// entirely in front of the camera, as project_pt() mirrors points
+// behind it.
+SbBool
+SoExtSelectionP::outsideLassoRect(SoCallbackAction * action,
+                                  const SbMatrix & projmatrix,
+                                  const SoShape * shape,
+                                  const SbBox2s & lassorect)
+{
+  SbBox3f bbox;
+  SbVec3f center;
+  const SoBoundingBoxCache * bboxcache = shape->getBoundingBoxCache();
+  if (bboxcache && bboxcache->isValid(action->getState())) {
+    bbox = bboxcache->getProjectedBox();
+  }
+  else {
+    ((SoShape *)shape)->computeBBox(action, bbox, center);
+  }
+  if (bbox.isEmpty()) return FALSE;
+
+  const SbVec3f & bmin = bbox.getMin();
+  const SbVec3f & bmax = bbox.getMax();
+  int i;
+  for (i = 0; i < 8; i++) {
+    const SbVec3f corner((i & 1) ? bmax[0] : bmin[0],
+                         (i & 2) ? bmax[1] : bmin[1],
+                         (i & 4) ? bmax[2] : bmin[2]);
+    const float w =
+      corner[0] * projmatrix[0][3] + corner[1] * projmatrix[1][3] +
+      corner[2] * projmatrix[2][3] + projmatrix[3][3];
+    if (w <= 0.0f) return FALSE;
+  }
+
+  SbPlane planes[4];
+  lasso_rect_planes(projmatrix, lassorect, this->primcbdata.vporg,
+                    this->primcbdata.vpsize, planes);
+  for (i = 0; i < 4; i++) {
+    const SbVec3f & n = planes[i].getNormal();
+    const SbVec3f farcorner(n[0] >= 0.0f ? bmax[0] : bmin[0],
+                      n[1] >= 0.0f ? bmax[1] : bmin[1],
+                      n[2] >= 0.0f ? bmax[2] : bmin[2]);
+    if (!planes[i].isInHalfSpace(farcorner)) return TRUE;
+  }
+
+  SbBool outside = FALSE;
+  SoTriangleBVHCache * bvhcache = ((SoShape *)shape)->getTriangleBVHCache(action);
+  if (bvhcache) {
+    outside = !bvhcache->mayIntersect(planes, 4);
+    bvhcache->unref();
+  }
+  return outside;
+}
+
 
 
 // triangle callback from SoCallbackAction
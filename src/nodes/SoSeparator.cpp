@@ -67,6 +67,7 @@
 #include <Inventor/actions/SoAudioRenderAction.h>
 #include <Inventor/caches/SoBoundingBoxCache.h>
 #include <Inventor/caches/SoGLCacheList.h>
+#include <Inventor/caches/SoGLRenderCache.h>
 #include <Inventor/elements/SoCacheElement.h>
 #include <Inventor/elements/SoCullElement.h>
 #include <Inventor/elements/SoLocalBBoxMatrixElement.h>
@@ -304,6 +305,9 @@ public:
 
   SoSeparator * pub;
 
+  // SoGLRenderCache::Backend, or -1 for the SoGLRenderCache default
+  static int rendercachebackend;
+
   SoBoundingBoxCache * bboxcache;
   uint32_t bboxcache_usecount;
   uint32_t bboxcache_destroycount;
@@ -352,6 +356,10 @@ public:
 
 // *************************************************************************
 
+int SoSeparatorP::rendercachebackend = -1;
+
+// *************************************************************************
+
 SoGLCacheList *
 SoSeparatorP::getGLCacheList(SbBool createifnull)
 {
@@ -467,6 +475,7 @@ SoSeparator::initClass(void)
   SO_ENABLE(SoGetBoundingBoxAction, SoCacheElement);
   SO_ENABLE(SoGLRenderAction, SoCacheElement);
   SoSeparator::numrendercaches = 2;
+  SoSeparatorP::rendercachebackend = -1;
 }
 
 // Doc from superclass.
@@ -686,7 +695,8 @@ SoSeparator::GLRenderBelowPath(SoGLRenderAction * action)
   }
 
   if (createcache) {
-    createcache->open(action, this->renderCaching.getValue() == AUTO);
+    createcache->open(action, this->renderCaching.getValue() == AUTO,
+                      SoSeparator::getRenderCacheBackend());
   }
 
   SbBool outsidefrustum =
@@ -915,6 +925,38 @@ SoSeparator::getNumRenderCaches(void)
   return SoSeparator::numrendercaches;
 }
 
+/*!
+  Sets the SoGLRenderCache::Backend used for the render caches of
+  all SoSeparator nodes. Pass -1 to use
+  SoGLRenderCache::getDefaultBackend(), which is the default. That
+  default can also be set with the environment variable \c
+  COIN_RENDER_CACHE_BACKEND.
+
+  \since Coin 4.0
+  \sa getRenderCacheBackend()
+*/
+void
+SoSeparator::setRenderCacheBackend(const int backend)
+{
+  SoSeparatorP::rendercachebackend = backend;
+}
+
+/*!
+  Returns the SoGLRenderCache::Backend used for the render caches of
+  SoSeparator nodes.
+
+  \since Coin 4.0
+  \sa setRenderCacheBackend()
+*/
+int
+SoSeparator::getRenderCacheBackend(void)
+{
+  if (SoSeparatorP::rendercachebackend < 0) {
+    return SoGLRenderCache::getDefaultBackend();
+  }
+  return SoSeparatorP::rendercachebackend;
+}
+
 // Doc from superclass.
 SbBool
 SoSeparator::affectsState(void) const
@@ -166,6 +166,13 @@
   $ ./test < input.iv
   \endverbatim
 
+  If \a filename is an image pyramid file written by
+  SoImageTileProvider::writeFile(), the image field is set to a low
+  resolution version of the image, and the texture is rendered as an
+  SoGLBigImage reading the parts of the image needed, at the needed
+  resolution, from the file. This makes it possible to use images
+  too big to be kept in memory.
+
   <b>FILE FORMAT/DEFAULTS:</b>
   \code
     Texture2 {
@@ -185,12 +192,14 @@
 #include <Inventor/nodes/SoTexture2.h>
 
 #include <assert.h>
+#include <stdlib.h>
 
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif // HAVE_CONFIG_H
 
 #include "coindefs.h" // COIN_OBSOLETED()
+#include "elements/SoTextureAtlasElement.h"
 #include "elements/SoTextureScalePolicyElement.h"
 #include "nodes/SoSubNodeP.h"
 #include "tidbitsp.h"
@@ -205,6 +214,7 @@
 #include <Inventor/elements/SoGLLazyElement.h>
 #include <Inventor/elements/SoGLMultiTextureEnabledElement.h>
 #include <Inventor/elements/SoGLMultiTextureImageElement.h>
+#include <Inventor/elements/SoGLMultiTextureMatrixElement.h>
 #include <Inventor/elements/SoMultiTextureEnabledElement.h>
 #include <Inventor/elements/SoTextureOverrideElement.h>
 #include <Inventor/elements/SoTextureQualityElement.h>
@@ -213,9 +223,14 @@
 #include <Inventor/errors/SoReadError.h>
 #include <Inventor/lists/SbStringList.h>
 #include <Inventor/misc/SoGLBigImage.h>
+#include <Inventor/misc/SoImageTileProvider.h>
 #include <Inventor/sensors/SoFieldSensor.h>
+#include <Inventor/sensors/SoTimerSensor.h>
 #include <Inventor/threads/SbMutex.h>
 
+#include "misc/SoTextureScheduler.h"
+#include "rendering/SoGLTextureAtlas.h"
+
 // *************************************************************************
 
 /*!
@@ -306,6 +321,15 @@
   For more information about the simage library, including download
   and build instructions, see the <a href="http://www.coin3d.org">Coin
   www-pages</a>.
+
+  If background loading is enabled with setBackgroundLoading(), image
+  files are read in a worker thread, and the texture is not applied
+  until the file has been read.
+
+  DDS and KTX files with block compressed data (see
+  SbImage::CompressedFormat) are read without simage, and are sent to
+  OpenGL compressed if the driver supports the format. Other image
+  files can be compressed when they are read, see setCompressOnLoad().
 */
 /*!
   \var SoSFImage SoTexture2::image
@@ -364,22 +388,85 @@
 
 // *************************************************************************
 
+// An image file read in the background.
+class sotexture2_job {
+public:
+  ~sotexture2_job() {
+    for (int i = 0; i < this->directories.getLength(); i++) {
+      delete this->directories[i];
+    }
+    if (this->provider) this->provider->unref();
+  }
+  SoTexture2 * texture; // NULL if the node is gone
+  SbString filename;
+  SbStringList directories;
+  SbImage image;
+  SoImageTileProvider * provider;
+  SbBool compress;
+  SbBool ok;
+  SbBool done;
+};
+
 class SoTexture2P {
 public:
   int readstatus;
   SoGLImage * glimage;
   SbBool glimagevalid;
   SoFieldSensor * filenamesensor;
+  SoTimerSensor * timersensor;
+  sotexture2_job * job;
+  // the compressed data of an image read from file, if any
+  SbImage compressedimage;
+  // set if an image pyramid file was read
+  SoImageTileProvider * tileprovider;
+  // set if the image has been packed into a shared texture page
+  SoGLTextureAtlas::Entry * atlasentry;
+
+  void setImage(SoTexture2 * texture, SbImage & image,
+                SoImageTileProvider * provider = NULL);
+  static void compressImage(SbImage & image);
+  static SoImageTileProvider * readPyramid(const SbString & filename,
+                                           const SbString * const * dirs,
+                                           const int numdirs,
+                                           SbImage & image);
+
+  void startLoad(SoTexture2 * texture);
+  void cancelLoad(void);
+  static void loadJob(void * closure);
+  static void timerSensorCB(void * data, SoSensor * sensor);
 
   static SbMutex * mutex;
+  static SbBool backgroundload;
+  static SbBool compressonload;
+  static SbBool useatlas;
+  static SbBool atlasrepeat;
+
+  static void lock(void) {
+#ifdef COIN_THREADSAFE
+    SoTexture2P::mutex->lock();
+#endif // COIN_THREADSAFE
+  }
+  static void unlock(void) {
+#ifdef COIN_THREADSAFE
+    SoTexture2P::mutex->unlock();
+#endif // COIN_THREADSAFE
+  }
 
   static void cleanup(void) {
     delete SoTexture2P::mutex;
     SoTexture2P::mutex = NULL;
+    SoTexture2P::backgroundload = FALSE;
+    SoTexture2P::compressonload = FALSE;
+    SoTexture2P::useatlas = FALSE;
+    SoTexture2P::atlasrepeat = FALSE;
   }
 };
 
 SbMutex * SoTexture2P::mutex = NULL;
+SbBool SoTexture2P::backgroundload = FALSE;
+SbBool SoTexture2P::compressonload = FALSE;
+SbBool SoTexture2P::useatlas = FALSE;
+SbBool SoTexture2P::atlasrepeat = FALSE;
 
 #define PRIVATE(p) ((p)->pimpl)
 
@@ -429,6 +516,13 @@ SoTexture2::SoTexture2(void)
   PRIVATE(this)->glimage = NULL;
   PRIVATE(this)->glimagevalid = FALSE;
   PRIVATE(this)->readstatus = 1;
+  PRIVATE(this)->job = NULL;
+  PRIVATE(this)->tileprovider = NULL;
+  PRIVATE(this)->atlasentry = NULL;
+
+  // polls for background loading to finish
+  PRIVATE(this)->timersensor = new SoTimerSensor(SoTexture2P::timerSensorCB, this);
+  PRIVATE(this)->timersensor->setInterval(SbTime(0.05));
 
   // use field sensor for filename since we will load an image if
   // filename changes. This is a time-consuming task which should
@@ -444,8 +538,12 @@ SoTexture2::SoTexture2(void)
 */
 SoTexture2::~SoTexture2()
 {
+  PRIVATE(this)->cancelLoad();
   if (PRIVATE(this)->glimage) PRIVATE(this)->glimage->unref(NULL);
+  if (PRIVATE(this)->tileprovider) PRIVATE(this)->tileprovider->unref();
+  SoGLTextureAtlas::remove(PRIVATE(this)->atlasentry);
   delete PRIVATE(this)->filenamesensor;
+  delete PRIVATE(this)->timersensor;
   delete PRIVATE(this);
 }
 
@@ -457,6 +555,8 @@ SoTexture2::initClass(void)
 
   SO_ENABLE(SoGLRenderAction, SoGLMultiTextureImageElement);
   SO_ENABLE(SoGLRenderAction, SoGLMultiTextureEnabledElement);
+  SO_ENABLE(SoGLRenderAction, SoGLMultiTextureMatrixElement);
+  SO_ENABLE(SoGLRenderAction, SoTextureAtlasElement);
 
   SO_ENABLE(SoCallbackAction, SoMultiTextureEnabledElement);
   SO_ENABLE(SoCallbackAction, SoMultiTextureImageElement);
@@ -468,9 +568,139 @@ SoTexture2::initClass(void)
   SoTexture2P::mutex = new SbMutex;
 #endif // COIN_THREADSAFE
 
+  const char * env = coin_getenv("COIN_TEXTURE2_BACKGROUND_LOAD");
+  SoTexture2P::backgroundload = env && (atoi(env) > 0);
+  env = coin_getenv("COIN_TEXTURE2_COMPRESS_ON_LOAD");
+  SoTexture2P::compressonload = env && (atoi(env) > 0);
+  env = coin_getenv("COIN_TEXTURE2_USE_ATLAS");
+  SoTexture2P::useatlas = env && (atoi(env) > 0);
+  env = coin_getenv("COIN_TEXTURE2_ATLAS_REPEAT");
+  SoTexture2P::atlasrepeat = env && (atoi(env) > 0);
+
   coin_atexit(SoTexture2P::cleanup, CC_ATEXIT_NORMAL);
 }
 
+/*!
+  Sets whether image files should be read in the background. When
+  enabled, setting SoTexture2::filename (or reading it from a file)
+  only schedules the image file to be read by a worker thread, and
+  the image is set in SoTexture2::image when it has been read. Until
+  then the shapes are rendered without the texture. Mipmaps for the
+  texture are also built in the background, and are sent to OpenGL
+  within the upload budget set with
+  SoGLResourceManager::setUploadBudget(), smallest first. The node
+  is touched as the texture is completed, so that the scene is
+  redrawn.
+
+  Since errors are only detected when the file is read, they are
+  reported as warnings instead of as read errors.
+
+  Background loading is disabled by default. It can also be enabled
+  by setting the environment variable \c COIN_TEXTURE2_BACKGROUND_LOAD
+  to 1. If Coin is built without thread support, image files are read
+  from the delay queue instead.
+
+  \since Coin 4.0
+  \sa SoGLImage::BACKGROUND_MIPMAP
+*/
+void
+SoTexture2::setBackgroundLoading(const SbBool onoff)
+{
+  SoTexture2P::backgroundload = onoff;
+}
+
+/*!
+  Returns whether image files are read in the background.
+
+  \since Coin 4.0
+  \sa setBackgroundLoading()
+*/
+SbBool
+SoTexture2::isBackgroundLoading(void)
+{
+  return SoTexture2P::backgroundload;
+}
+
+/*!
+  Sets whether images read from file should be block compressed when
+  they are read, using SbImage::compress(). 1 and 2 component images
+  are compressed to SbImage::BC4_R and SbImage::BC5_RG, RGB images to
+  SbImage::BC1_RGB and RGBA images to SbImage::BC3_RGBA, with a full
+  chain of mipmaps. This reduces the texture memory used by 4 to 8
+  times, at the cost of some image quality. If the OpenGL driver
+  doesn't support the format, the texture is sent uncompressed.
+
+  Compressing is done by the CPU and takes some time, so this is best
+  combined with setBackgroundLoading(), which moves the work to a
+  worker thread. Images set directly in SoTexture2::image are never
+  compressed.
+
+  Disabled by default. It can also be enabled by setting the
+  environment variable \c COIN_TEXTURE2_COMPRESS_ON_LOAD to 1.
+
+  \since Coin 4.0
+  \sa enableCompressedTexture
+*/
+void
+SoTexture2::setCompressOnLoad(const SbBool onoff)
+{
+  SoTexture2P::compressonload = onoff;
+}
+
+/*!
+  Returns whether images read from file are compressed.
+
+  \since Coin 4.0
+  \sa setCompressOnLoad()
+*/
+SbBool
+SoTexture2::isCompressOnLoad(void)
+{
+  return SoTexture2P::compressonload;
+}
+
+/*!
+  Sets whether small textures should be packed into shared atlas
+  textures. Shapes using different textures from the same atlas page
+  can then be rendered without binding a new texture object for each
+  of them, which is a large part of the rendering time for scenes
+  with many small textured objects, like labels and icons.
+
+  Images up to 128x128 texels which are set to CLAMP in both
+  directions are packed the first time they are rendered, and the
+  atlas page is used from the next frame. The image is resampled to a
+  square power of two cell, and the texture matrix is changed to map
+  texture coordinates in [0, 1] into the cell. Atlas pages are not
+  mipmapped, since that would blend texels from neighbouring cells.
+
+  Textures set to REPEAT can't be repeated inside an atlas page, and
+  are not packed. If all texture coordinates are known to be within
+  [0, 1], these can be packed too by setting the environment variable
+  \c COIN_TEXTURE2_ATLAS_REPEAT to 1.
+
+  Disabled by default. It can also be enabled by setting the
+  environment variable \c COIN_TEXTURE2_USE_ATLAS to 1.
+
+  \since Coin 4.0
+*/
+void
+SoTexture2::setUseAtlas(const SbBool onoff)
+{
+  SoTexture2P::useatlas = onoff;
+}
+
+/*!
+  Returns whether small textures are packed into atlas textures.
+
+  \since Coin 4.0
+  \sa setUseAtlas()
+*/
+SbBool
+SoTexture2::isUseAtlas(void)
+{
+  return SoTexture2P::useatlas;
+}
+
 
 // Documented in superclass. Overridden to check if texture file (if
 // any) can be found and loaded.
@@ -513,10 +743,17 @@ SoTexture2::GLRender(SoGLRenderAction * action)
   const cc_glglue * glue = cc_glglue_instance(SoGLCacheContextElement::get(state));
   SoTextureScalePolicyElement::Policy scalepolicy =
     SoTextureScalePolicyElement::get(state);
-  SbBool needbig = (scalepolicy == SoTextureScalePolicyElement::FRACTURE);
+  // images read from pyramid files are always rendered in pieces
+  SbBool needbig = (scalepolicy == SoTextureScalePolicyElement::FRACTURE) ||
+    (PRIVATE(this)->tileprovider != NULL);
   SoType glimagetype = PRIVATE(this)->glimage ? PRIVATE(this)->glimage->getTypeId() : SoType::badType();
     
   LOCK_GLIMAGE(this);
+
+  if (PRIVATE(this)->atlasentry && !SoTexture2P::useatlas) {
+    SoGLTextureAtlas::remove(PRIVATE(this)->atlasentry);
+    PRIVATE(this)->atlasentry = NULL;
+  }
   
   if (!PRIVATE(this)->glimagevalid || 
       (needbig && glimagetype != SoGLBigImage::getClassTypeId()) ||
@@ -546,12 +783,39 @@ SoTexture2::GLRender(SoGLRenderAction * action)
       PRIVATE(this)->glimage->setFlags(PRIVATE(this)->glimage->getFlags()|SoGLImage::SCALE_DOWN);
     }
 
+    if (SoTexture2P::backgroundload) {
+      PRIVATE(this)->glimage->setFlags(PRIVATE(this)->glimage->getFlags()|
+                                       SoGLImage::BACKGROUND_MIPMAP);
+    }
+
     if (bytes && size != SbVec2s(0,0)) {
-      PRIVATE(this)->glimage->setData(bytes, size, nc,
-                             translateWrap((Wrap)this->wrapS.getValue()),
-                             translateWrap((Wrap)this->wrapT.getValue()),
-                             quality);
+      if (!needbig && PRIVATE(this)->compressedimage.hasData()) {
+        PRIVATE(this)->glimage->setData(&PRIVATE(this)->compressedimage,
+                               translateWrap((Wrap)this->wrapS.getValue()),
+                               translateWrap((Wrap)this->wrapT.getValue()),
+                               quality);
+      }
+      else {
+        PRIVATE(this)->glimage->setData(bytes, size, nc,
+                               translateWrap((Wrap)this->wrapS.getValue()),
+                               translateWrap((Wrap)this->wrapT.getValue()),
+                               quality);
+        if (PRIVATE(this)->tileprovider) {
+          ((SoGLBigImage*) PRIVATE(this)->glimage)->
+            setTileProvider(PRIVATE(this)->tileprovider);
+        }
+      }
       PRIVATE(this)->glimagevalid = TRUE;
+
+      SoGLTextureAtlas::remove(PRIVATE(this)->atlasentry);
+      PRIVATE(this)->atlasentry = NULL;
+      if (SoTexture2P::useatlas && !needbig &&
+          !PRIVATE(this)->compressedimage.hasData() &&
+          SoGLTextureAtlas::canAdd(size, nc) &&
+          (SoTexture2P::atlasrepeat ||
+           (this->wrapS.getValue() == CLAMP && this->wrapT.getValue() == CLAMP))) {
+        PRIVATE(this)->atlasentry = SoGLTextureAtlas::add(bytes, size, nc);
+      }
       // don't cache while creating a texture object
       SoCacheElement::setInvalid(TRUE);
       if (state->isCacheOpen()) {
@@ -564,6 +828,24 @@ SoTexture2::GLRender(SoGLRenderAction * action)
     SoCacheElement::invalidate(state);
   }
 
+  // keep redrawing while mipmaps are built and uploaded
+  if (PRIVATE(this)->glimagevalid &&
+      (PRIVATE(this)->glimage->getFlags() & SoGLImage::BACKGROUND_MIPMAP) &&
+      !PRIVATE(this)->timersensor->isScheduled() &&
+      PRIVATE(this)->glimage->isLoading()) {
+    PRIVATE(this)->timersensor->schedule();
+  }
+
+  // the own texture object is used until the atlas page has been
+  // updated at the end of the frame
+  SoGLImage * glimage = PRIVATE(this)->glimagevalid ? PRIVATE(this)->glimage : NULL;
+  SbMatrix remap;
+  SoGLImage * atlasimage = NULL;
+  if (glimage && PRIVATE(this)->atlasentry) {
+    atlasimage = SoGLTextureAtlas::get(PRIVATE(this)->atlasentry, remap, state);
+    if (atlasimage == NULL) SoCacheElement::invalidate(state);
+  }
+
   UNLOCK_GLIMAGE(this);
   
   SoMultiTextureImageElement::Model glmodel = (SoMultiTextureImageElement::Model) 
@@ -587,10 +869,35 @@ SoTexture2::GLRender(SoGLRenderAction * action)
   
   int maxunits = cc_glglue_max_texture_units(glue);
   if (unit < maxunits) {
-    SoGLMultiTextureImageElement::set(state, this, unit,
-                                      PRIVATE(this)->glimagevalid ? PRIVATE(this)->glimage : NULL,
-                                      glmodel,
-                                      this->blendColor.getValue());
+    // strip the remapping of a previous atlas texture on this unit,
+    // and add our own
+    SbMatrix base;
+    const SbBool remapped = SoTextureAtlasElement::strip(state, unit,
+                                                        SoMultiTextureMatrixElement::get(state, unit),
+                                                        base);
+    if (atlasimage) {
+      if (!remapped) base = SoMultiTextureMatrixElement::get(state, unit);
+      SbMatrix m = base;
+      m.multRight(remap);
+      SoTextureAtlasElement::set(state, this, unit, base, m);
+      SoMultiTextureMatrixElement::set(state, this, unit, m);
+      glimage = atlasimage;
+    }
+    else if (remapped) {
+      SoTextureAtlasElement::clear(state, this, unit);
+      SoMultiTextureMatrixElement::set(state, this, unit, base);
+    }
+
+    // no need to bind the atlas page again if the previous texture
+    // on this unit was packed into the same page
+    SoMultiTextureImageElement::Model curmodel;
+    SbColor curblend;
+    if (!atlasimage ||
+        SoGLMultiTextureImageElement::get(state, unit, curmodel, curblend) != atlasimage ||
+        curmodel != glmodel || curblend != this->blendColor.getValue()) {
+      SoGLMultiTextureImageElement::set(state, this, unit, glimage, glmodel,
+                                        this->blendColor.getValue());
+    }
     
     SoGLMultiTextureEnabledElement::set(state, this, unit,
                                         PRIVATE(this)->glimagevalid &&
@@ -696,6 +1003,13 @@ SoTexture2::notify(SoNotList * l)
   SoField * f = l->getLastField();
   if (f == &this->image) {
     PRIVATE(this)->glimagevalid = FALSE;
+    // the image set by the user replaces an image being read
+    PRIVATE(this)->cancelLoad();
+    PRIVATE(this)->compressedimage.setValue(SbVec3s(0,0,0), 0, NULL);
+    if (PRIVATE(this)->tileprovider) {
+      PRIVATE(this)->tileprovider->unref();
+      PRIVATE(this)->tileprovider = NULL;
+    }
 
     // write image, not filename
     this->filename.setDefault(TRUE);
@@ -715,20 +1029,26 @@ SbBool
 SoTexture2::loadFilename(void)
 {
   SbBool retval = FALSE;
-  if (this->filename.getValue().getLength()) {
+  if (this->filename.getValue().getLength() && SoTexture2P::backgroundload) {
+    PRIVATE(this)->startLoad(this);
+    retval = TRUE;
+  }
+  else if (this->filename.getValue().getLength()) {
+    PRIVATE(this)->cancelLoad();
     SbImage tmpimage;
     const SbStringList & sl = SoInput::getDirectories();
-    if (tmpimage.readFile(this->filename.getValue(),
-                          sl.getArrayPtr(), sl.getLength())) {
-      int nc;
-      SbVec2s size;
-      unsigned char * bytes = tmpimage.getValue(size, nc);
-      // disable notification on image while setting data from filename
-      // as a notify will cause a filename.setDefault(TRUE).
-      SbBool oldnotify = this->image.enableNotify(FALSE);
-      this->image.setValue(size, nc, bytes);
-      this->image.enableNotify(oldnotify);
-      PRIVATE(this)->glimagevalid = FALSE; // recreate GL image in next GLRender()
+    SoImageTileProvider * provider =
+      SoTexture2P::readPyramid(this->filename.getValue(),
+                               sl.getArrayPtr(), sl.getLength(), tmpimage);
+    if (provider) {
+      PRIVATE(this)->setImage(this, tmpimage, provider);
+      provider->unref();
+      retval = TRUE;
+    }
+    else if (tmpimage.readFile(this->filename.getValue(),
+                               sl.getArrayPtr(), sl.getLength())) {
+      if (SoTexture2P::compressonload) SoTexture2P::compressImage(tmpimage);
+      PRIVATE(this)->setImage(this, tmpimage);
       retval = TRUE;
     }
   }
@@ -754,6 +1074,7 @@ SoTexture2::filenameSensorCB(void * data, SoSensor *)
   }
   else if (thisp->filename.getValue() == "") {
     // setting filename to "" should reset the node to its initial state
+    PRIVATE(thisp)->cancelLoad();
     thisp->setReadStatus(0);
     thisp->image.setValue(SbVec2s(0,0), 0, NULL);
     thisp->image.setDefault(TRUE);
@@ -761,6 +1082,249 @@ SoTexture2::filenameSensorCB(void * data, SoSensor *)
   }
 }
 
+// *************************************************************************
+
+// Schedules the image file to be read in the background.
+void
+SoTexture2P::startLoad(SoTexture2 * texture)
+{
+  this->cancelLoad();
+
+  sotexture2_job * job = new sotexture2_job;
+  job->texture = texture;
+  job->filename = texture->filename.getValue();
+  const SbStringList & sl = SoInput::getDirectories();
+  for (int i = 0; i < sl.getLength(); i++) {
+    job->directories.append(new SbString(*sl[i]));
+  }
+  job->compress = SoTexture2P::compressonload;
+  job->provider = NULL;
+  job->ok = FALSE;
+  job->done = FALSE;
+  this->job = job;
+
+  SoTextureScheduler::schedule(SoTexture2P::loadJob, job);
+  if (!this->timersensor->isScheduled()) this->timersensor->schedule();
+}
+
+// Abandons the image file being read, if any.
+void
+SoTexture2P::cancelLoad(void)
+{
+  if (this->job == NULL) return;
+  SoTexture2P::lock();
+  if (this->job->done) delete this->job;
+  else this->job->texture = NULL; // deleted by the job
+  SoTexture2P::unlock();
+  this->job = NULL;
+}
+
+// SoTextureScheduler job reading an image file. Can run in any
+// thread, so it only touches the job itself.
+void
+SoTexture2P::loadJob(void * closure)
+{
+  sotexture2_job * job = (sotexture2_job *) closure;
+  job->provider =
+    SoTexture2P::readPyramid(job->filename,
+                             job->directories.getArrayPtr(),
+                             job->directories.getLength(), job->image);
+  job->ok = (job->provider != NULL) ||
+    job->image.readFile(job->filename,
+                        job->directories.getArrayPtr(),
+                        job->directories.getLength());
+  if (job->ok && !job->provider) {
+    // decode compressed files here rather than in the main thread
+    SbVec3s size;
+    int nc;
+    (void) job->image.getValue(size, nc);
+    if (job->compress) SoTexture2P::compressImage(job->image);
+  }
+  SoTexture2P::lock();
+  job->done = TRUE;
+  const SbBool abandoned = (job->texture == NULL);
+  SoTexture2P::unlock();
+  if (abandoned) delete job;
+}
+
+// Sets the image when it has been read, and touches the node while
+// the texture is being completed.
+void
+SoTexture2P::timerSensorCB(void * data, SoSensor * COIN_UNUSED_ARG(sensor))
+{
+  SoTexture2 * thisp = (SoTexture2 *) data;
+  sotexture2_job * job = PRIVATE(thisp)->job;
+  if (job) {
+    SoTexture2P::lock();
+    const SbBool done = job->done;
+    SoTexture2P::unlock();
+    if (!done) return;
+
+    PRIVATE(thisp)->job = NULL;
+    if (job->ok) {
+      PRIVATE(thisp)->setImage(thisp, job->image, job->provider);
+      thisp->image.setDefault(TRUE); // write filename, not image
+      thisp->setReadStatus(1);
+    }
+    else {
+      SoDebugError::postWarning("SoTexture2::loadFilename",
+                                "Image file '%s' could not be read",
+                                job->filename.getString());
+      thisp->setReadStatus(0);
+    }
+    delete job;
+    thisp->touch();
+    return;
+  }
+
+  LOCK_GLIMAGE(thisp);
+  const SbBool loading =
+    PRIVATE(thisp)->glimage && PRIVATE(thisp)->glimage->isLoading();
+  UNLOCK_GLIMAGE(thisp);
+  if (loading) thisp->touch();
+  else PRIVATE(thisp)->timersensor->unschedule();
+}
+
+// Sets the image field from an image read from file, and keeps the
+// compressed data or the tile provider, if any, for GLRender().
+void
+SoTexture2P::setImage(SoTexture2 * texture, SbImage & image,
+                      SoImageTileProvider * provider)
+{
+  int nc;
+  SbVec2s size;
+  unsigned char * bytes = image.getValue(size, nc);
+  // disable notification on image while setting data from filename
+  // as a notify will cause a filename.setDefault(TRUE).
+  SbBool oldnotify = texture->image.enableNotify(FALSE);
+  texture->image.setValue(size, nc, bytes);
+  texture->image.enableNotify(oldnotify);
+
+  LOCK_GLIMAGE(texture);
+  const SbImage::CompressedFormat format = image.getCompressedFormat();
+  if (format != SbImage::UNCOMPRESSED) {
+    size_t numbytes;
+    // the levels are stored back to back, starting with level 0
+    const unsigned char * data = image.getCompressedLevel(0, size, numbytes);
+    this->compressedimage.setCompressedValue(size, format,
+                                             image.getNumCompressedLevels(),
+                                             data);
+  }
+  else {
+    this->compressedimage.setValue(SbVec3s(0,0,0), 0, NULL);
+  }
+  if (provider) provider->ref();
+  if (this->tileprovider) this->tileprovider->unref();
+  this->tileprovider = provider;
+  this->glimagevalid = FALSE; // recreate GL image in next GLRender()
+  UNLOCK_GLIMAGE(texture);
+}
+
+// Opens filename if it is an image pyramid file, and reads a low
+// resolution version of the image into image. Returns the referenced
+// provider, or NULL if the file is not a pyramid file. Can run in
+// any thread.
+SoImageTileProvider *
+SoTexture2P::readPyramid(const SbString & filename,
+                         const SbString * const * dirs, const int numdirs,
+                         SbImage & image)
+{
+  const SbString fullname = SbImage::searchForFile(filename, dirs, numdirs);
+  if (fullname.getLength() == 0) return NULL;
+  SoImageTileProvider * provider = SoImageTileProvider::createFromFile(fullname);
+  if (provider == NULL) return NULL;
+  provider->ref();
+
+  // the largest level not bigger than a normal texture
+  const int numlevels = provider->getNumLevels();
+  int level = 0;
+  SbVec2i32 size = provider->getLevelSize(0);
+  while (level < numlevels-1 && (size[0] > 1024 || size[1] > 1024)) {
+    size = provider->getLevelSize(++level);
+  }
+  if (size[0] > 4096 || size[1] > 4096) size.setValue(1, 1);
+
+  const int nc = provider->getNumComponents();
+  image.setValue(SbVec2s((short) size[0], (short) size[1]), nc, NULL);
+  SbVec2s dummy;
+  int dummync;
+  if (!provider->readRegion(level, SbVec2i32(0, 0), size,
+                            image.getValue(dummy, dummync))) {
+    provider->unref();
+    return NULL;
+  }
+  return provider;
+}
+
+// Compresses an image read from file. Can run in any thread.
+void
+SoTexture2P::compressImage(SbImage & image)
+{
+  if (image.getCompressedFormat() != SbImage::UNCOMPRESSED) return;
+
+  SbVec3s size;
+  int nc;
+  (void) image.getValue(size, nc);
+  SbImage::CompressedFormat format;
+  switch (nc) {
+  case 1: format = SbImage::BC4_R; break;
+  case 2: format = SbImage::BC5_RG; break;
+  case 3: format = SbImage::BC1_RGB; break;
+  case 4: format = SbImage::BC3_RGBA; break;
+  default: return;
+  }
+  (void) image.compress(format, TRUE);
+}
+
 #undef LOCK_GLIMAGE
 #undef UNLOCK_GLIMAGE
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbImage.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/sensors/SoSensorManager.h>
+
+static SbBool
+test_read_image_cb(const SbString & filename, SbImage * image, void * closure)
+{
+  if (filename != "background.test") return FALSE;
+  unsigned char bytes[4 * 2 * 3];
+  for (int i = 0; i < 4 * 2 * 3; i++) bytes[i] = (unsigned char) i;
+  image->setValue(SbVec2s(4, 2), 3, bytes);
+  return TRUE;
+}
+
+BOOST_AUTO_TEST_CASE(backgroundLoading)
+{
+  const SbBool oldbackground = SoTexture2::isBackgroundLoading();
+  SoTexture2::setBackgroundLoading(TRUE);
+  SbImage::addReadImageCB(test_read_image_cb, NULL);
+
+  SoTexture2 * node = new SoTexture2;
+  node->ref();
+  node->filename = "background.test";
+
+  SbVec2s size(0, 0);
+  int nc;
+  const SbTime start = SbTime::getTimeOfDay();
+  while (size == SbVec2s(0, 0) &&
+         (SbTime::getTimeOfDay() - start).getValue() < 5.0) {
+    SbTime::sleep(10);
+    SoDB::getSensorManager()->processTimerQueue();
+    SoDB::getSensorManager()->processDelayQueue(FALSE);
+    node->image.getValue(size, nc);
+  }
+  BOOST_CHECK_MESSAGE(size == SbVec2s(4, 2) && nc == 3,
+                      "image file not read in the background");
+  BOOST_CHECK_MESSAGE(node->image.isDefault(),
+                      "image read from file should not be written");
+
+  node->unref();
+  SbImage::removeReadImageCB(test_read_image_cb, NULL);
+  SoTexture2::setBackgroundLoading(oldbackground);
+}
+
+#endif // COIN_TEST_SUITE
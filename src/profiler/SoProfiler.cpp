@@ -54,6 +54,14 @@
   wish to use the data, either attach sensors to the fields, or connect
   the the fields on other coin nodes to the fields on SoProfilerStats.
 
+  <h2>Notification counters</h2>
+
+  While profiling is enabled, Coin also counts the number of
+  notifications received by scene graph objects, per object type. Use
+  SoProfiler::getNotificationCounts() to read the counters, and
+  SoProfiler::resetNotificationCounts() to reset them, e.g. once per
+  frame.
+
   \ingroup profiler
 */
 
@@ -72,6 +80,7 @@
 
 #include <Inventor/errors/SoDebugError.h>
 #include <Inventor/SoType.h>
+#include <Inventor/lists/SoTypeList.h>
 #include <Inventor/actions/SoActions.h>
 #include <Inventor/nodekits/SoNodeKit.h>
 
@@ -115,6 +124,11 @@ namespace {
       static SbBool active = FALSE;
     };
 
+    namespace notifications {
+      // notification count per type, indexed by SoType key
+      static SbList<uint32_t> * counts = NULL;
+    };
+
     namespace console {
       static SbBool active = FALSE;
       static SbBool clear = FALSE;
@@ -146,6 +160,13 @@ namespace {
     }
   }
 
+  void
+  cleanup_notification_counts(void)
+  {
+    delete profiler::notifications::counts;
+    profiler::notifications::counts = NULL;
+  }
+
 } // namespace
 
 
@@ -223,6 +244,47 @@ SoProfiler::isEnabled(void)
   return profiler::enabled;
 }
 
+/*!
+  Returns the number of notifications received by objects of each
+  type since profiling was enabled, or since the last call to
+  resetNotificationCounts(). Only types with a non-zero count are
+  returned.
+
+  This shows which node types are involved in the notification
+  traffic when the scene graph is changed, which is often where the
+  time goes when editing large scene graphs with many shared (DEF/USE)
+  nodes interactively.
+
+  \sa resetNotificationCounts()
+*/
+void
+SoProfiler::getNotificationCounts(SoTypeList & types, SbList<uint32_t> & counts)
+{
+  types.truncate(0);
+  counts.truncate(0);
+  const SbList<uint32_t> * list = profiler::notifications::counts;
+  if (list == NULL) return;
+  for (int i = 0; i < list->getLength(); i++) {
+    if ((*list)[i] > 0) {
+      types.append(SoType::fromKey(static_cast<uint16_t>(i)));
+      counts.append((*list)[i]);
+    }
+  }
+}
+
+/*!
+  Resets all notification counters to zero.
+
+  \sa getNotificationCounts()
+*/
+void
+SoProfiler::resetNotificationCounts(void)
+{
+  if (profiler::notifications::counts) {
+    profiler::notifications::counts->truncate(0);
+  }
+}
+
 SbBool
 SoProfilerP::shouldContinuousRender(void)
 {
@@ -530,6 +592,26 @@ SoProfilerP::parseCoinProfilerOverlayVariable(void)
   }
 }
 
+/*
+  Called from SoBase::notify() when profiling is enabled.
+*/
+void
+SoProfilerP::countNotification(SoType type)
+{
+  // FIXME: the counters are not protected by a mutex, so they are
+  // only approximate when notifications are sent from several
+  // threads at the same time.
+  SbList<uint32_t> * list = profiler::notifications::counts;
+  if (list == NULL) {
+    list = profiler::notifications::counts = new SbList<uint32_t>;
+    coin_atexit(static_cast<coin_atexit_f *>(cleanup_notification_counts), CC_ATEXIT_NORMAL);
+  }
+  const int key = type.getKey();
+  if (key < 0) return;
+  while (list->getLength() <= key) list->append(0);
+  (*list)[key]++;
+}
+
 /*
   Default implementation for dumping on console instead of overlaying
   statistics over the 3D graphics.
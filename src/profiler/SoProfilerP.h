@@ -45,6 +45,8 @@ public:
   static SoType getActionType(void);
 
   static void dumpToConsole(const SbProfilingData & data);
+
+  static void countNotification(SoType type);
 };
 
 #endif // !COIN_SOPROFILERP_H
@@ -47,6 +47,14 @@
   is doubled, and creating the texture object is much slower, so we
   avoid this for SoGLBigImage.
 
+  For images too big to be kept in memory, an SoImageTileProvider
+  can be set with setTileProvider(). The subtextures are then read
+  from the provider at the resolution they are rendered at, by the
+  texture loading threads, and kept in a cache of limited size (see
+  setTileCacheSize()). A low resolution version of the image is kept
+  in memory, and is used for the subtextures until they have been
+  read.
+
   \COIN_CLASS_EXTENSION
 
   \since Coin 2.0
@@ -71,6 +79,7 @@
 #include <Inventor/elements/SoGLCacheContextElement.h>
 #include <Inventor/elements/SoGLDisplayList.h>
 #include <Inventor/errors/SoDebugError.h>
+#include <Inventor/misc/SoImageTileProvider.h>
 #include <Inventor/system/gl.h>
 
 #ifdef COIN_THREADSAFE
@@ -78,7 +87,10 @@
 #endif // COIN_THREADSAFE
 
 #include "tidbitsp.h"
+#include "misc/SbHash.h"
+#include "misc/SoTextureScheduler.h"
 #include "rendering/SoGL.h"
+#include "threads/threadsutilp.h"
 
 // *************************************************************************
 
@@ -90,6 +102,24 @@ static int CHANGELIMIT = 4;
 // the texturequality limit when linear filtering will be used
 #define LINEAR_LIMIT 0.1f
 
+// the maximum size of the tiles read from a tile provider which are
+// kept in memory. Can be set with setTileCacheSize() or the
+// COIN_BIGIMAGE_TILE_CACHE_SIZE environment variable (in megabytes).
+static size_t TILECACHESIZE = 64 * 1024 * 1024;
+
+// the maximum number of tiles waiting to be read for each image. We
+// don't want to queue up tiles which might not be needed anymore
+// when they are read.
+#define MAXPENDINGTILES 16
+
+// the maximum number of subtextures along each side when streaming
+// tiles. The subtexture size is increased as needed.
+#define MAXSTREAMDIM 64
+
+// the largest size of the low resolution image kept in memory while
+// streaming tiles
+#define MAXBASESIZE 1024
+
 typedef struct {
   SbVec2s imagesize;
   SbVec2s glimagesize;
@@ -105,9 +135,84 @@ typedef struct {
   int * glimagediv;
   uint32_t * glimageage;
   int changecnt;
+  SbBool pending;
   unsigned int * averagebuf;
 } SoGLBigImageTls;
 
+// A tile read from a tile provider. Tiles are identified by the
+// subimage index and the level.
+typedef struct soglbigimage_tile {
+  uint32_t key;
+  unsigned char * data;
+  SbVec2s size;
+  size_t numbytes;
+  SbBool loading;
+  struct soglbigimage_tile * prev;
+  struct soglbigimage_tile * next;
+} soglbigimage_tile;
+
+// The tiles read from a tile provider, shared by all threads
+// rendering the image and by the jobs reading the tiles. Reference
+// counted, since the jobs might finish after the image has been
+// destructed.
+class soglbigimage_stream {
+public:
+  soglbigimage_stream(SoImageTileProvider * provider);
+
+  void ref(void);
+  void unref(void);
+
+  void setLayout(const SbVec2s & regionsize, const SbVec2s & dim);
+  int getMaxLevel(void) const { return this->provider->getNumLevels() - 1; }
+  int getSubImage(const int idx, const int level, const int currentlevel,
+                  SbImage * image);
+
+  SoImageTileProvider * provider;
+
+private:
+  ~soglbigimage_stream();
+
+  static uint32_t getKey(const int idx, const int level) {
+    return (uint32_t(idx) << 5) | uint32_t(level);
+  }
+  void getRegion(const int idx, const int level,
+                 SbVec2i32 & origin, SbVec2s & size) const;
+  void request(const int idx, const int level);
+  void use(soglbigimage_tile * tile);
+  void unlink(soglbigimage_tile * tile);
+  void evict(void);
+  void clear(void);
+  void createBase(void);
+  static void loadTile(void * closure);
+
+  void * mutex;
+  int refcount;
+  SbHash<uint32_t, soglbigimage_tile *> tiles;
+  // loaded tiles, most recently used first
+  soglbigimage_tile * first;
+  soglbigimage_tile * last;
+  size_t numbytes;
+  int numpending;
+  // increased when the layout changes, to discard tiles being read
+  uint32_t generation;
+  SbVec2s regionsize;
+  SbVec2s dim;
+
+  // the low resolution image kept in memory
+  int baselevel;
+  SbVec2i32 basesize;
+  unsigned char * basedata;
+};
+
+typedef struct {
+  soglbigimage_stream * stream;
+  uint32_t key;
+  uint32_t generation;
+  int level;
+  SbVec2i32 origin;
+  SbVec2s size;
+} soglbigimage_tilejob;
+
 class SoGLBigImageP {
 public:
   SoGLBigImageP(void);
@@ -119,6 +224,7 @@ public:
 #ifdef COIN_THREADSAFE
   SbMutex mutex;
 #endif // !COIN_THREADSAFE
+  soglbigimage_stream * stream;
   unsigned char ** cache;
   SbVec2s * cachesize;
   int numcachelevels;
@@ -159,6 +265,9 @@ public:
   static void reset(SoGLBigImageTls * tls, SoState * state = NULL);
   static void unrefOldDL(SoGLBigImageTls * tls, SoState * state, const uint32_t maxage);
   void createCache(const unsigned char * bytes, const SbVec2s size, const int nc);
+  void updateStreamedSubImage(SoGLBigImageTls * tls, const int idx,
+                              const int level, const uint32_t flags,
+                              const float quality);
 };
 
 SoType SoGLBigImageP::classTypeId STATIC_SOTYPE_INIT;
@@ -167,6 +276,7 @@ static void soglbigimagep_cleanup(void)
 {
   SoGLBigImageP::classTypeId STATIC_SOTYPE_INIT;
   CHANGELIMIT = 4;
+  TILECACHESIZE = 64 * 1024 * 1024;
 }
 
 static void
@@ -179,6 +289,8 @@ soglbigimagetls_construct(void * closure)
   storage->currentdim.setValue(0, 0);
   storage->tmpbuf = NULL;
   storage->tmpbufsize = 0;
+  storage->changecnt = 0;
+  storage->pending = FALSE;
   storage->glimagearray = NULL;
   storage->imagearray = NULL;
   storage->glimagediv = NULL;
@@ -235,6 +347,9 @@ SoGLBigImage::initClass(void)
   SoGLBigImageP::classTypeId =
     SoType::createType(SoGLImage::getClassTypeId(), SbName("GLBigImage"));
   coin_atexit((coin_atexit_f*) soglbigimagep_cleanup, CC_ATEXIT_NORMAL);
+
+  const char * env = coin_getenv("COIN_BIGIMAGE_TILE_CACHE_SIZE");
+  if (env && atoi(env) > 0) TILECACHESIZE = size_t(atoi(env)) * 1024 * 1024;
 }
 
 // Doc in superclass.
@@ -298,12 +413,27 @@ int
 SoGLBigImage::initSubImages(const SbVec2s & subimagesize) const
 {
   SoGLBigImageTls * tls = PRIVATE(this)->getTls();
+  soglbigimage_stream * stream = PRIVATE(this)->stream;
 
   tls->changecnt = 0;
-  if (subimagesize == tls->imagesize &&
+  tls->pending = FALSE;
+
+  SbVec2s regionsize = subimagesize;
+  if (stream) {
+    // use bigger subimages rather than a huge number of them
+    const SbVec2i32 imagesize = stream->provider->getSize();
+    while (regionsize[0] < 16384 && regionsize[1] < 16384 &&
+           (imagesize[0] > regionsize[0] * MAXSTREAMDIM ||
+            imagesize[1] > regionsize[1] * MAXSTREAMDIM)) {
+      regionsize[0] <<= 1;
+      regionsize[1] <<= 1;
+    }
+  }
+
+  if (regionsize == tls->imagesize &&
       tls->dim[0] > 0) return tls->dim[0] * tls->dim[1];
 
-  tls->imagesize = subimagesize;
+  tls->imagesize = regionsize;
   tls->glimagesize[0] = coin_geq_power_of_two(tls->imagesize[0]);
   tls->glimagesize[1] = coin_geq_power_of_two(tls->imagesize[1]);
 
@@ -346,22 +476,29 @@ SoGLBigImage::initSubImages(const SbVec2s & subimagesize) const
     if (ratio < 0.3) tls->glimagesize[1] >>= 1;
   }
 
-  SbVec2s size(0,0);
-  int nc = 0;
-
-  if (this->getImage() != NULL)
-    (void)(this->getImage()->getValue(size, nc));
+  SbVec2i32 size(0,0);
+  if (stream) {
+    size = stream->provider->getSize();
+  }
+  else if (this->getImage() != NULL) {
+    SbVec2s imagesize(0, 0);
+    int nc = 0;
+    (void)(this->getImage()->getValue(imagesize, nc));
+    size.setValue(imagesize[0], imagesize[1]);
+  }
 
-  tls->dim[0] = size[0] / subimagesize[0];
-  tls->dim[1] = size[1] / subimagesize[1];
+  tls->dim[0] = short(size[0] / regionsize[0]);
+  tls->dim[1] = short(size[1] / regionsize[1]);
 
-  tls->remain[0] = size[0] % subimagesize[0];
+  tls->remain[0] = short(size[0] % regionsize[0]);
   if (tls->remain[0]) tls->dim[0] += 1;
-  tls->remain[1] = size[1] % subimagesize[1];
+  tls->remain[1] = short(size[1] % regionsize[1]);
   if (tls->remain[1]) tls->dim[1] += 1;
 
-  tls->tcmul[0] = float(tls->dim[0] * subimagesize[0]) / float(size[0]);
-  tls->tcmul[1] = float(tls->dim[1] * subimagesize[1]) / float(size[1]);
+  tls->tcmul[0] = float(tls->dim[0] * regionsize[0]) / float(size[0]);
+  tls->tcmul[1] = float(tls->dim[1] * regionsize[1]) / float(size[1]);
+
+  if (stream) stream->setLayout(tls->imagesize, tls->dim);
   return tls->dim[0] * tls->dim[1];
 }
 
@@ -391,10 +528,16 @@ SoGLBigImage::applySubImage(SoState * state, const int idx,
                             const float quality,
                             const SbVec2s & projsize)
 {
+  soglbigimage_stream * stream = PRIVATE(this)->stream;
   SbVec2s size;
-  int numcomponents;
-  unsigned char * bytes = this->getImage() ?
-    this->getImage()->getValue(size, numcomponents) : NULL;
+  int numcomponents = 0;
+  unsigned char * bytes = NULL;
+  if (stream) {
+    numcomponents = stream->provider->getNumComponents();
+  }
+  else if (this->getImage()) {
+    bytes = this->getImage()->getValue(size, numcomponents);
+  }
 
   SoGLBigImageTls * tls = PRIVATE(this)->getTls();
 
@@ -414,7 +557,9 @@ SoGLBigImage::applySubImage(SoState * state, const int idx,
       tls->glimageage[i] = 0;
     }
 
-    int numbytes = tls->imagesize[0] * tls->imagesize[1] * numcomponents;
+    // the average buffer is only used when downsampling the image
+    int numbytes = stream ? 0 :
+      tls->imagesize[0] * tls->imagesize[1] * numcomponents;
     tls->averagebuf =
       new unsigned int[numbytes ? numbytes : 1];
 
@@ -435,7 +580,12 @@ SoGLBigImage::applySubImage(SoState * state, const int idx,
   }
   div >>= 1;
 
-  if (tls->glimagearray[idx] == NULL ||
+  if (stream) {
+    if (level > stream->getMaxLevel()) level = stream->getMaxLevel();
+    PRIVATE(this)->updateStreamedSubImage(tls, idx, level,
+                                          this->getFlags(), quality);
+  }
+  else if (tls->glimagearray[idx] == NULL ||
       (tls->glimagediv[idx] != div && tls->changecnt < CHANGELIMIT)) {
 
     if (tls->glimagearray[idx] == NULL) {
@@ -513,12 +663,16 @@ SoGLBigImage::applySubImage(SoState * state, const int idx,
   number of subtextures that can be changed each frame. If this limit
   is exceeded, this function will return TRUE, otherwise FALSE.
 
+  TRUE is also returned while subtextures are being read from the
+  tile provider, so that the shape is redrawn when they are ready.
+
   \sa setChangeLimit()
 */
 SbBool
 SoGLBigImage::exceededChangeLimit(void)
 {
-  return PRIVATE(this)->getTls()->changecnt >= CHANGELIMIT;
+  SoGLBigImageTls * tls = PRIVATE(this)->getTls();
+  return tls->changecnt >= CHANGELIMIT || tls->pending;
 }
 
 /*!
@@ -535,6 +689,60 @@ SoGLBigImage::setChangeLimit(const int limit)
   return old;
 }
 
+/*!
+  Sets the provider the subtextures should be read from, instead of
+  the image set with setData(). The image is then never kept in
+  memory in full resolution. The provider is referenced until
+  another provider is set, or setData() is called. Set it to \e NULL
+  to go back to using the image.
+
+  \sa SoImageTileProvider
+  \since Coin 4.0
+*/
+void
+SoGLBigImage::setTileProvider(SoImageTileProvider * provider)
+{
+  soglbigimage_stream * old = PRIVATE(this)->stream;
+  if (old && old->provider == provider) return;
+  PRIVATE(this)->resetAllTls(NULL);
+  PRIVATE(this)->stream = NULL;
+  if (provider) {
+    PRIVATE(this)->stream = new soglbigimage_stream(provider);
+    PRIVATE(this)->stream->ref();
+  }
+  if (old) old->unref();
+}
+
+/*!
+  Returns the tile provider, or \e NULL if none has been set.
+
+  \sa setTileProvider()
+  \since Coin 4.0
+*/
+SoImageTileProvider *
+SoGLBigImage::getTileProvider(void) const
+{
+  return PRIVATE(this)->stream ? PRIVATE(this)->stream->provider : NULL;
+}
+
+/*!
+  Sets the maximum number of bytes used for the tiles read from a
+  tile provider, for each image. The least recently used tiles are
+  freed when the limit is exceeded. Returns the old limit. The
+  default is 64 MB, or the number of megabytes in the environment
+  variable \c COIN_BIGIMAGE_TILE_CACHE_SIZE.
+
+  \sa setTileProvider()
+  \since Coin 4.0
+*/
+size_t
+SoGLBigImage::setTileCacheSize(const size_t numbytes)
+{
+  size_t old = TILECACHESIZE;
+  TILECACHESIZE = numbytes;
+  return old;
+}
+
 // needed for cc_storage_apply_to_all() callback
 typedef struct {
   uint32_t maxage;
@@ -568,6 +776,7 @@ SoGLBigImage::unrefOldDL(SoState * state, const uint32_t maxage)
 #ifndef DOXYGEN_SKIP_THIS
 
 SoGLBigImageP::SoGLBigImageP(void) :
+  stream(NULL),
   cache(NULL),
   cachesize(NULL),
   numcachelevels(0)
@@ -581,6 +790,7 @@ SoGLBigImageP::~SoGLBigImageP()
 {
   this->resetCache();
   cc_storage_destruct(this->storage);
+  if (this->stream) this->stream->unref();
 }
 
 //  The method copySubImage() handles the downsampling. It averages
@@ -950,6 +1160,9 @@ SoGLBigImageP::unrefOldDL(SoGLBigImageTls * tls, SoState * state, const uint32_t
 #endif // debug
         tls->glimagearray[i]->unref(state);
         tls->glimagearray[i] = NULL;
+        // the image data is copied again when needed
+        delete tls->imagearray[i];
+        tls->imagearray[i] = NULL;
       }
       else tls->glimageage[i] += 1;
     }
@@ -960,8 +1173,9 @@ SoGLBigImageP::unrefOldDL(SoGLBigImageTls * tls, SoState * state, const uint32_t
 static void
 soglbigimage_resetall_cb(void * tls, void * closure)
 {
-  // simply call SoGLBigImageP::reset()
   SoGLBigImageP::reset((SoGLBigImageTls*) tls, (SoState*) closure);
+  // make initSubImages() calculate the subimages again
+  ((SoGLBigImageTls*) tls)->dim.setValue(0, 0);
 }
 
 void
@@ -970,6 +1184,354 @@ SoGLBigImageP::resetAllTls(SoState * state)
   cc_storage_apply_to_all(this->storage, soglbigimage_resetall_cb, state);
 }
 
+// Updates the subtexture idx from the tile provider, if a tile
+// closer to level than the current one is available. Requests the
+// tile if it is not.
+void
+SoGLBigImageP::updateStreamedSubImage(SoGLBigImageTls * tls, const int idx,
+                                      const int level, const uint32_t flagsarg,
+                                      const float quality)
+{
+  SoGLImage * glimage = tls->glimagearray[idx];
+  int currentlevel = -1;
+  if (glimage) {
+    currentlevel = 0;
+    while ((1 << currentlevel) < tls->glimagediv[idx]) currentlevel++;
+    if (currentlevel == level) return;
+    if (tls->changecnt >= CHANGELIMIT) {
+      tls->pending = TRUE;
+      return;
+    }
+  }
+  if (tls->imagearray[idx] == NULL) tls->imagearray[idx] = new SbImage;
+
+  const int newlevel =
+    this->stream->getSubImage(idx, level, currentlevel, tls->imagearray[idx]);
+  if (newlevel != level) tls->pending = TRUE;
+  if (newlevel < 0) return;
+
+  if (glimage == NULL) {
+    glimage = tls->glimagearray[idx] = new SoGLImage();
+  }
+  else {
+    tls->changecnt++;
+  }
+  tls->glimagediv[idx] = 1 << newlevel;
+
+  uint32_t flags = flagsarg | SoGLImage::NO_MIPMAP | SoGLImage::INVINCIBLE;
+  if (flags & SoGLImage::USE_QUALITY_VALUE) {
+    flags &= ~SoGLImage::USE_QUALITY_VALUE;
+    if (quality >= LINEAR_LIMIT) {
+      flags |= SoGLImage::LINEAR_MIN_FILTER|SoGLImage::LINEAR_MAG_FILTER;
+    }
+  }
+  glimage->setFlags(flags);
+  glimage->setData(tls->imagearray[idx],
+                   SoGLImage::CLAMP_TO_EDGE,
+                   SoGLImage::CLAMP_TO_EDGE,
+                   quality,
+                   0, NULL);
+}
+
+// *************************************************************************
+
+// copies a region of an image, clamping the coordinates to the image
+static void
+soglbigimage_copyclamped(const unsigned char * src, const SbVec2i32 & srcsize,
+                         const int nc, const SbVec2i32 & origin,
+                         const SbVec2s & size, unsigned char * dst)
+{
+  for (int y = 0; y < size[1]; y++) {
+    const int sy = SbClamp(origin[1] + y, 0, srcsize[1]-1);
+    const unsigned char * row = src + sy * srcsize[0] * nc;
+    for (int x = 0; x < size[0]; x++) {
+      const int sx = SbClamp(origin[0] + x, 0, srcsize[0]-1);
+      for (int c = 0; c < nc; c++) *dst++ = row[sx * nc + c];
+    }
+  }
+}
+
+soglbigimage_stream::soglbigimage_stream(SoImageTileProvider * providerarg)
+  : provider(providerarg), mutex(NULL), refcount(0),
+    first(NULL), last(NULL), numbytes(0), numpending(0), generation(0),
+    regionsize(0, 0), dim(0, 0), baselevel(-1), basesize(0, 0), basedata(NULL)
+{
+  CC_MUTEX_CONSTRUCT(this->mutex);
+  this->provider->ref();
+}
+
+soglbigimage_stream::~soglbigimage_stream()
+{
+  this->clear();
+  delete[] this->basedata;
+  this->provider->unref();
+  CC_MUTEX_DESTRUCT(this->mutex);
+}
+
+void
+soglbigimage_stream::ref(void)
+{
+  CC_MUTEX_LOCK(this->mutex);
+  this->refcount++;
+  CC_MUTEX_UNLOCK(this->mutex);
+}
+
+void
+soglbigimage_stream::unref(void)
+{
+  CC_MUTEX_LOCK(this->mutex);
+  const SbBool destroy = (--this->refcount == 0);
+  CC_MUTEX_UNLOCK(this->mutex);
+  if (destroy) delete this;
+}
+
+// Sets the subimage size and the number of subimages. The tiles are
+// discarded if they change.
+void
+soglbigimage_stream::setLayout(const SbVec2s & regionsizearg, const SbVec2s & dimarg)
+{
+  CC_MUTEX_LOCK(this->mutex);
+  if (regionsizearg != this->regionsize || dimarg != this->dim) {
+    this->clear();
+    this->regionsize = regionsizearg;
+    this->dim = dimarg;
+    this->generation++;
+  }
+  CC_MUTEX_UNLOCK(this->mutex);
+}
+
+// Copies the subimage idx into image from the tile closest to level
+// which is available, and requests the tile at level if it isn't.
+// Returns the level of the tile, or -1 if no tile closer to level
+// than currentlevel (-1 if none) is available.
+int
+soglbigimage_stream::getSubImage(const int idx, const int level,
+                                 const int currentlevel, SbImage * image)
+{
+  const int nc = this->provider->getNumComponents();
+  const int maxlevel = this->getMaxLevel();
+  int found = -1;
+  soglbigimage_tile * tile = NULL;
+
+  CC_MUTEX_LOCK(this->mutex);
+  if (this->baselevel < 0) this->createBase();
+
+  if (!this->tiles.get(getKey(idx, level), tile)) {
+    this->request(idx, level);
+  }
+  else if (!tile->loading) {
+    found = level;
+  }
+
+  // look for the closest level already read, preferring the smaller
+  // textures
+  const int maxdist = currentlevel >= 0 ? SbAbs(currentlevel - level) : maxlevel + 1;
+  for (int d = 1; found < 0 && d < maxdist; d++) {
+    const int candidates[2] = { level + d, level - d };
+    for (int i = 0; i < 2 && found < 0; i++) {
+      const int l = candidates[i];
+      if (l < 0 || l > maxlevel) continue;
+      if (this->tiles.get(getKey(idx, l), tile) && !tile->loading) {
+        found = l;
+      }
+    }
+  }
+
+  if (found >= 0) {
+    this->use(tile);
+    image->setValue(tile->size, nc, tile->data);
+  }
+  else if (this->basedata &&
+           (currentlevel < 0 ||
+            SbAbs(this->baselevel - level) < SbAbs(currentlevel - level))) {
+    SbVec2i32 origin;
+    SbVec2s size;
+    this->getRegion(idx, this->baselevel, origin, size);
+    image->setValue(size, nc, NULL);
+    SbVec2s dummy;
+    int dummync;
+    soglbigimage_copyclamped(this->basedata, this->basesize, nc, origin, size,
+                             image->getValue(dummy, dummync));
+    found = this->baselevel;
+  }
+  CC_MUTEX_UNLOCK(this->mutex);
+
+  if (found < 0 && currentlevel < 0) {
+    // nothing at all to show, which happens if the provider has no
+    // levels small enough to be kept in memory. Read the tile here.
+    SbVec2i32 origin;
+    SbVec2s size;
+    this->getRegion(idx, level, origin, size);
+    image->setValue(size, nc, NULL);
+    SbVec2s dummy;
+    int dummync;
+    if (!this->provider->readRegion(level, origin, SbVec2i32(size[0], size[1]),
+                                    image->getValue(dummy, dummync))) {
+      memset(image->getValue(dummy, dummync), 0, size[0] * size[1] * nc);
+    }
+    found = level;
+  }
+  return found;
+}
+
+// Returns the pixels of level covered by subimage idx.
+void
+soglbigimage_stream::getRegion(const int idx, const int level,
+                               SbVec2i32 & origin, SbVec2s & size) const
+{
+  const int x = idx % this->dim[0];
+  const int y = idx / this->dim[0];
+  origin.setValue((x * this->regionsize[0]) >> level,
+                  (y * this->regionsize[1]) >> level);
+  size.setValue(SbMax(this->regionsize[0] >> level, 1),
+                SbMax(this->regionsize[1] >> level, 1));
+}
+
+// Schedules a job reading a tile. Must be called with the mutex
+// locked.
+void
+soglbigimage_stream::request(const int idx, const int level)
+{
+  if (this->numpending >= MAXPENDINGTILES) return;
+
+  soglbigimage_tile * tile = new soglbigimage_tile;
+  tile->key = getKey(idx, level);
+  tile->data = NULL;
+  tile->numbytes = 0;
+  tile->loading = TRUE;
+  tile->prev = tile->next = NULL;
+  this->tiles.put(tile->key, tile);
+  this->numpending++;
+
+  soglbigimage_tilejob * job = new soglbigimage_tilejob;
+  job->stream = this;
+  job->key = tile->key;
+  job->generation = this->generation;
+  job->level = level;
+  this->getRegion(idx, level, job->origin, job->size);
+  tile->size = job->size;
+  this->refcount++; // released by the job
+  // read low resolution tiles first, since they cover more
+  SoTextureScheduler::schedule(soglbigimage_stream::loadTile, job, float(level));
+}
+
+// SoTextureScheduler job reading a tile.
+void
+soglbigimage_stream::loadTile(void * closure)
+{
+  soglbigimage_tilejob * job = (soglbigimage_tilejob *) closure;
+  soglbigimage_stream * thisp = job->stream;
+  const int nc = thisp->provider->getNumComponents();
+  const size_t numbytes = size_t(job->size[0]) * job->size[1] * nc;
+  unsigned char * data = new unsigned char[numbytes];
+  if (!thisp->provider->readRegion(job->level, job->origin,
+                                   SbVec2i32(job->size[0], job->size[1]),
+                                   data)) {
+    // show black rather than trying again and again
+    memset(data, 0, numbytes);
+  }
+
+  CC_MUTEX_LOCK(thisp->mutex);
+  soglbigimage_tile * tile;
+  if (job->generation == thisp->generation &&
+      thisp->tiles.get(job->key, tile) && tile->loading) {
+    tile->data = data;
+    tile->numbytes = numbytes;
+    tile->loading = FALSE;
+    thisp->numpending--;
+    thisp->numbytes += numbytes;
+    thisp->use(tile);
+    thisp->evict();
+    data = NULL;
+  }
+  CC_MUTEX_UNLOCK(thisp->mutex);
+
+  delete[] data;
+  delete job;
+  thisp->unref();
+}
+
+// Moves a loaded tile first in the list of recently used tiles.
+void
+soglbigimage_stream::use(soglbigimage_tile * tile)
+{
+  if (this->first == tile) return;
+  if (tile->prev || tile->next || this->last == tile) this->unlink(tile);
+  tile->next = this->first;
+  if (this->first) this->first->prev = tile;
+  this->first = tile;
+  if (this->last == NULL) this->last = tile;
+}
+
+void
+soglbigimage_stream::unlink(soglbigimage_tile * tile)
+{
+  if (tile->prev) tile->prev->next = tile->next;
+  else this->first = tile->next;
+  if (tile->next) tile->next->prev = tile->prev;
+  else this->last = tile->prev;
+  tile->prev = tile->next = NULL;
+}
+
+// Frees the least recently used tiles until the cache is within its
+// limit. The most recently used tile is always kept.
+void
+soglbigimage_stream::evict(void)
+{
+  while (this->numbytes > TILECACHESIZE && this->last != this->first) {
+    soglbigimage_tile * tile = this->last;
+    this->unlink(tile);
+    this->tiles.erase(tile->key);
+    this->numbytes -= tile->numbytes;
+    delete[] tile->data;
+    delete tile;
+  }
+}
+
+// Frees all tiles. Tiles being read are discarded when the job
+// finishes.
+void
+soglbigimage_stream::clear(void)
+{
+  for (SbHash<uint32_t, soglbigimage_tile *>::const_iterator iter =
+         this->tiles.const_begin(); iter != this->tiles.const_end(); ++iter) {
+    soglbigimage_tile * tile = iter->obj;
+    delete[] tile->data;
+    delete tile;
+  }
+  this->tiles.clear();
+  this->first = this->last = NULL;
+  this->numbytes = 0;
+  this->numpending = 0;
+}
+
+// Reads the largest level which is small enough to be kept in
+// memory. Must be called with the mutex locked.
+void
+soglbigimage_stream::createBase(void)
+{
+  const int maxlevel = this->getMaxLevel();
+  int level = 0;
+  while (level < maxlevel) {
+    const SbVec2i32 size = this->provider->getLevelSize(level);
+    if (size[0] <= MAXBASESIZE && size[1] <= MAXBASESIZE) break;
+    level++;
+  }
+  this->baselevel = level;
+  const SbVec2i32 size = this->provider->getLevelSize(level);
+  if (size[0] > MAXBASESIZE || size[1] > MAXBASESIZE) return;
+
+  const int nc = this->provider->getNumComponents();
+  this->basedata = new unsigned char[size[0] * size[1] * nc];
+  if (this->provider->readRegion(level, SbVec2i32(0, 0), size, this->basedata)) {
+    this->basesize = size;
+  }
+  else {
+    delete[] this->basedata;
+    this->basedata = NULL;
+  }
+}
+
 #endif // DOXYGEN_SKIP_THIS
 
 #undef LINEAR_LIMIT
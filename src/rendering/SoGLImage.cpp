@@ -141,6 +141,24 @@
   requirements on how the texture should be rendered, you can set the
   flags using the SoGLImage::setFlags() method.
 
+  If BACKGROUND_MIPMAP is set, the image data is resized and the
+  mipmap levels are built in a worker thread the first time a
+  mipmapped texture is needed. A single texel texture with the
+  average color of the image is used until the mipmaps are ready.
+  The mipmap levels are then sent to OpenGL starting with the
+  smallest one, within the upload budget set with
+  SoGLResourceManager::setUploadBudget(), so that the texture gets
+  sharper over a few frames instead of stalling one frame. The
+  mipmaps are kept in memory, so that texture objects can be
+  recreated quickly, until new data is set. Use isLoading() to find
+  out when the texture is complete. 2D textures with a custom resize
+  callback, a border or the RECTANGLE flag are created as usual.
+
+  If SRGB_MIPMAP is set, the image data is taken to be sRGB encoded,
+  and the color components are averaged in linear space when the
+  mipmap levels are built. This keeps minified textures from getting
+  too dark. The mipmaps are then always built by Coin, instead of by
+  OpenGL.
 */
 
 // FIXME: Support other reason values than IMAGE (kintel 20050531)
@@ -176,7 +194,9 @@
 /*! \file SoGLImage.h */
 #include <Inventor/misc/SoGLImage.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <list>
 #include <cstdio>
 #include <cstdlib>
@@ -209,7 +229,11 @@
 #endif // COIN_THREADSAFE
 
 #include "tidbitsp.h"
+#include "base/SbImageCodec.h"
+#include "misc/SoTextureScheduler.h"
 #include "rendering/SoGL.h"
+#include "rendering/SoGLResourceManagerP.h"
+#include "rendering/SoGLImageKernels.h"
 #include "elements/SoTextureScaleQualityElement.h"
 #include "glue/GLUWrapper.h"
 #include "glue/glp.h"
@@ -217,6 +241,13 @@
 #include "threads/threadsutilp.h"
 #include "coindefs.h"
 
+#ifdef COIN_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif // COIN_HAVE_X86_SIMD
+#ifdef COIN_HAVE_NEON_SIMD
+#include <arm_neon.h>
+#endif // COIN_HAVE_NEON_SIMD
+
 #if BOOST_WORKAROUND(COIN_MSVC, <= COIN_MSVC_6_0_VERSION)
 // truncating symbol length
 #pragma warning(disable:4786)
@@ -325,10 +356,401 @@ compute_log(int value)
   return i;
 }
 
+// *************************************************************************
+
+// Image kernels used to build mipmaps and to resize images. The SIMD
+// versions of halve_image() average the pixels in exactly the same
+// way as the plain C++ versions, and fast_image_resize() uses tables
+// of source offsets computed as before, so the results do not depend
+// on the instruction set in use. The version is picked at runtime
+// with coin_runtime_simd().
+
+// Averages pairs of pixels from ROWS rows (2 for 2D images, 4 for 3D
+// images) into num pixels in dst.
+typedef void halve_row_func(const unsigned char * const * rows, const int nc,
+                            const int num, unsigned char * dst);
+
+template <int ROWS>
+static void
+halve_row_c(const unsigned char * const * rows, const int nc,
+            const int num, unsigned char * dst)
+{
+  const int shift = (ROWS == 2) ? 2 : 3;
+  const unsigned char * src[ROWS];
+  int r;
+  for (r = 0; r < ROWS; r++) src[r] = rows[r];
+  for (int i = 0; i < num; i++) {
+    for (int c = 0; c < nc; c++) {
+      int sum = ROWS;
+      for (r = 0; r < ROWS; r++) {
+        sum += src[r][0] + src[r][nc];
+        src[r]++;
+      }
+      *dst++ = (unsigned char) (sum >> shift);
+    }
+    for (r = 0; r < ROWS; r++) src[r] += nc; // skip to next pixel
+  }
+}
+
+#ifdef COIN_HAVE_X86_SIMD
+
+// Adds the horizontal pixel pairs in the 16-bit column sums of 16
+// bytes (lo: bytes 0-7, hi: bytes 8-15).
+template <int NC>
+static COIN_TARGET_SSE2 inline __m128i
+halve_pairs_sse2(const __m128i lo, const __m128i hi)
+{
+  __m128i even, odd;
+  if (NC == 4) {
+    even = _mm_unpacklo_epi64(lo, hi);
+    odd = _mm_unpackhi_epi64(lo, hi);
+  }
+  else if (NC == 2) {
+    const __m128i l = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i h = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+    even = _mm_unpacklo_epi64(l, h);
+    odd = _mm_unpackhi_epi64(l, h);
+  }
+  else {
+    const __m128i mask = _mm_set1_epi32(0xffff);
+    even = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+    odd = _mm_packs_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+  }
+  return _mm_add_epi16(even, odd);
+}
+
+template <int NC, int ROWS>
+static COIN_TARGET_SSE2 void
+halve_row_sse2(const unsigned char * const * rows, const int num,
+               unsigned char * dst)
+{
+  const int n = 2 * num * NC;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(ROWS);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i lo = zero, hi = zero;
+    for (int r = 0; r < ROWS; r++) {
+      const __m128i v = _mm_loadu_si128((const __m128i *) (rows[r] + i));
+      lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+      hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+    }
+    __m128i sum = _mm_add_epi16(halve_pairs_sse2<NC>(lo, hi), round);
+    sum = _mm_srli_epi16(sum, (ROWS == 2) ? 2 : 3);
+    _mm_storel_epi64((__m128i *) (dst + i / 2), _mm_packus_epi16(sum, sum));
+  }
+  const unsigned char * rest[ROWS];
+  for (int r = 0; r < ROWS; r++) rest[r] = rows[r] + i;
+  halve_row_c<ROWS>(rest, NC, (n - i) / (2 * NC), dst + i / 2);
+}
+
+// Three component pixels do not line up with the vector size, so the
+// pair sums are computed for all bytes in a block of 16 pixels, using
+// loads offset by one pixel, and every other pixel is then copied out.
+template <int ROWS>
+static COIN_TARGET_SSE2 void
+halve_row_rgb_sse2(const unsigned char * const * rows, const int num,
+                   unsigned char * dst)
+{
+  const int n = 6 * num;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(ROWS);
+  const int shift = (ROWS == 2) ? 2 : 3;
+  unsigned char tmp[96];
+  int i = 0;
+  for (; i + 96 + 3 <= n; i += 96) {
+    for (int k = 0; k < 96; k += 16) {
+      __m128i lo = round, hi = round;
+      for (int r = 0; r < ROWS; r++) {
+        const __m128i a = _mm_loadu_si128((const __m128i *) (rows[r] + i + k));
+        const __m128i b = _mm_loadu_si128((const __m128i *) (rows[r] + i + k + 3));
+        lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                             _mm_unpacklo_epi8(b, zero)));
+        hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                             _mm_unpackhi_epi8(b, zero)));
+      }
+      _mm_storeu_si128((__m128i *) (tmp + k),
+                       _mm_packus_epi16(_mm_srli_epi16(lo, shift),
+                                        _mm_srli_epi16(hi, shift)));
+    }
+    for (int j = 0; j < 16; j++) {
+      (void)memcpy(dst + i / 2 + 3 * j, tmp + 6 * j, 3);
+    }
+  }
+  const unsigned char * rest[ROWS];
+  for (int r = 0; r < ROWS; r++) rest[r] = rows[r] + i;
+  halve_row_c<ROWS>(rest, 3, (n - i) / 6, dst + i / 2);
+}
+
+template <int ROWS>
+static COIN_TARGET_SSE2 void
+halve_rows_sse2(const unsigned char * const * rows, const int nc,
+                const int num, unsigned char * dst)
+{
+  switch (nc) {
+  case 1: halve_row_sse2<1, ROWS>(rows, num, dst); break;
+  case 2: halve_row_sse2<2, ROWS>(rows, num, dst); break;
+  case 3: halve_row_rgb_sse2<ROWS>(rows, num, dst); break;
+  case 4: halve_row_sse2<4, ROWS>(rows, num, dst); break;
+  default: halve_row_c<ROWS>(rows, nc, num, dst); break;
+  }
+}
+
+// The AVX2 version works on 32 bytes at a time. The pairs end up
+// interleaved between the two 128-bit lanes, and are put back in
+// order with a final permute, which is the same for all sizes.
+template <int NC, int ROWS>
+static COIN_TARGET_AVX2 void
+halve_row_avx2(const unsigned char * const * rows, const int num,
+               unsigned char * dst)
+{
+  const int n = 2 * num * NC;
+  const __m256i round = _mm256_set1_epi16(ROWS);
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+    for (int r = 0; r < ROWS; r++) {
+      const unsigned char * p = rows[r] + i;
+      lo = _mm256_add_epi16(lo, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) p)));
+      hi = _mm256_add_epi16(hi, _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (p + 16))));
+    }
+    __m256i even, odd;
+    if (NC == 4) {
+      even = _mm256_unpacklo_epi64(lo, hi);
+      odd = _mm256_unpackhi_epi64(lo, hi);
+    }
+    else if (NC == 2) {
+      const __m256i l = _mm256_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+      const __m256i h = _mm256_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+      even = _mm256_unpacklo_epi64(l, h);
+      odd = _mm256_unpackhi_epi64(l, h);
+    }
+    else {
+      const __m256i mask = _mm256_set1_epi32(0xffff);
+      even = _mm256_packs_epi32(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+      odd = _mm256_packs_epi32(_mm256_srli_epi32(lo, 16), _mm256_srli_epi32(hi, 16));
+    }
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(even, odd), round);
+    sum = _mm256_srli_epi16(sum, (ROWS == 2) ? 2 : 3);
+    sum = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(sum, sum), order);
+    _mm_storeu_si128((__m128i *) (dst + i / 2), _mm256_castsi256_si128(sum));
+  }
+  const unsigned char * rest[ROWS];
+  for (int r = 0; r < ROWS; r++) rest[r] = rows[r] + i;
+  halve_rows_sse2<ROWS>(rest, NC, (n - i) / (2 * NC), dst + i / 2);
+}
+
+template <int ROWS>
+static COIN_TARGET_AVX2 void
+halve_rows_avx2(const unsigned char * const * rows, const int nc,
+                const int num, unsigned char * dst)
+{
+  switch (nc) {
+  case 1: halve_row_avx2<1, ROWS>(rows, num, dst); break;
+  case 2: halve_row_avx2<2, ROWS>(rows, num, dst); break;
+  case 4: halve_row_avx2<4, ROWS>(rows, num, dst); break;
+  default: halve_rows_sse2<ROWS>(rows, nc, num, dst); break;
+  }
+}
+
+#endif // COIN_HAVE_X86_SIMD
+
+#ifdef COIN_HAVE_NEON_SIMD
+
+// The NEON version deinterleaves 16 pixels into one register per
+// component, and adds the pixel pairs with pairwise widening adds.
+// The rounding shift gives the same result as the C++ version.
+template <int NC, int ROWS>
+static void
+halve_row_neon(const unsigned char * const * rows, const int num,
+               unsigned char * dst)
+{
+  int j = 0;
+  for (; j + 8 <= num; j += 8) {
+    uint16x8_t sum[4];
+    for (int r = 0; r < ROWS; r++) {
+      const unsigned char * p = rows[r] + 2 * j * NC;
+      uint8x16_t v[4];
+      if (NC == 1) { v[0] = vld1q_u8(p); }
+      else if (NC == 2) { uint8x16x2_t t = vld2q_u8(p); v[0] = t.val[0]; v[1] = t.val[1]; }
+      else if (NC == 3) { uint8x16x3_t t = vld3q_u8(p); v[0] = t.val[0]; v[1] = t.val[1]; v[2] = t.val[2]; }
+      else { uint8x16x4_t t = vld4q_u8(p); v[0] = t.val[0]; v[1] = t.val[1]; v[2] = t.val[2]; v[3] = t.val[3]; }
+      for (int c = 0; c < NC; c++) {
+        sum[c] = (r == 0) ? vpaddlq_u8(v[c]) : vpadalq_u8(sum[c], v[c]);
+      }
+    }
+    uint8x8_t o[4];
+    for (int c = 0; c < NC; c++) {
+      o[c] = (ROWS == 2) ? vrshrn_n_u16(sum[c], 2) : vrshrn_n_u16(sum[c], 3);
+    }
+    unsigned char * q = dst + j * NC;
+    if (NC == 1) { vst1_u8(q, o[0]); }
+    else if (NC == 2) { uint8x8x2_t t; t.val[0] = o[0]; t.val[1] = o[1]; vst2_u8(q, t); }
+    else if (NC == 3) { uint8x8x3_t t; t.val[0] = o[0]; t.val[1] = o[1]; t.val[2] = o[2]; vst3_u8(q, t); }
+    else { uint8x8x4_t t; t.val[0] = o[0]; t.val[1] = o[1]; t.val[2] = o[2]; t.val[3] = o[3]; vst4_u8(q, t); }
+  }
+  const unsigned char * rest[ROWS];
+  for (int r = 0; r < ROWS; r++) rest[r] = rows[r] + 2 * j * NC;
+  halve_row_c<ROWS>(rest, NC, num - j, dst + j * NC);
+}
+
+template <int ROWS>
+static void
+halve_rows_neon(const unsigned char * const * rows, const int nc,
+                const int num, unsigned char * dst)
+{
+  switch (nc) {
+  case 1: halve_row_neon<1, ROWS>(rows, num, dst); break;
+  case 2: halve_row_neon<2, ROWS>(rows, num, dst); break;
+  case 3: halve_row_neon<3, ROWS>(rows, num, dst); break;
+  case 4: halve_row_neon<4, ROWS>(rows, num, dst); break;
+  default: halve_row_c<ROWS>(rows, nc, num, dst); break;
+  }
+}
+
+#endif // COIN_HAVE_NEON_SIMD
+
+// Returns the row kernel for 2D (2 rows) or 3D (4 rows) images for
+// the given coin_runtime_simd() level, or NULL if the kernel is not
+// compiled in.
+static halve_row_func *
+halve_select_row_func(const int simd, const int numrows)
+{
+  switch (simd) {
+#ifdef COIN_HAVE_X86_SIMD
+  case COIN_SIMD_AVX2:
+    return (numrows == 2) ? halve_rows_avx2<2> : halve_rows_avx2<4>;
+  case COIN_SIMD_SSE2:
+  case COIN_SIMD_AVX:
+    return (numrows == 2) ? halve_rows_sse2<2> : halve_rows_sse2<4>;
+#endif // COIN_HAVE_X86_SIMD
+#ifdef COIN_HAVE_NEON_SIMD
+  case COIN_SIMD_NEON:
+    return (numrows == 2) ? halve_rows_neon<2> : halve_rows_neon<4>;
+#endif // COIN_HAVE_NEON_SIMD
+  case COIN_SIMD_NONE:
+    return (numrows == 2) ? halve_row_c<2> : halve_row_c<4>;
+  default:
+    return NULL;
+  }
+}
+
+// Returns the row kernel for 2D (2 rows) or 3D (4 rows) images.
+static halve_row_func *
+halve_get_row_func(const int numrows)
+{
+  static halve_row_func * func2 = NULL;
+  static halve_row_func * func4 = NULL;
+  if (func2 == NULL) {
+    const int simd = coin_runtime_simd();
+    func4 = halve_select_row_func(simd, 4);
+    func2 = halve_select_row_func(simd, 2);
+  }
+  return (numrows == 2) ? func2 : func4;
+}
+
+// Lets the internal test suite check every kernel, not just the one
+// picked for this CPU.
+const char *
+coin_glimage_halve_rows(const int kernel, const unsigned char * const * rows,
+                        const int numrows, const int nc, const int num,
+                        unsigned char * dst)
+{
+  static const int levels[] = {
+    COIN_SIMD_NONE, COIN_SIMD_SSE2, COIN_SIMD_AVX2, COIN_SIMD_NEON
+  };
+  static const char * names[] = { "C++", "SSE2", "AVX2", "NEON" };
+  const int cpu = coin_runtime_simd();
+  int n = 0;
+  for (int i = 0; i < 4; i++) {
+    const int simd = levels[i];
+    const SbBool supported = (simd == COIN_SIMD_NEON) ?
+      (cpu == COIN_SIMD_NEON) : (cpu != COIN_SIMD_NEON && simd <= cpu);
+    halve_row_func * func = halve_select_row_func(simd, numrows);
+    if (!supported || func == NULL) continue;
+    if (n++ == kernel) {
+      func(rows, nc, num, dst);
+      return names[i];
+    }
+  }
+  return NULL;
+}
+
+// Lookup tables for averaging sRGB encoded pixels in linear space,
+// with linear values scaled to [0, 65535]. glimage_srgb_thresholds[i]
+// is the linear value halfway between sRGB values i and i+1, so the
+// nearest sRGB value is found by counting the thresholds below a
+// linear value. glimage_srgb_start gives the count for every 16th
+// linear value, to start from.
+static uint16_t glimage_srgb_to_linear[256];
+static int glimage_srgb_thresholds[256];
+static unsigned char glimage_srgb_start[4096];
+
+static double
+glimage_srgb_decode(const double v)
+{
+  return (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+static void
+glimage_init_srgb_tables(void)
+{
+  int i;
+  for (i = 0; i < 256; i++) {
+    glimage_srgb_to_linear[i] =
+      (uint16_t) (glimage_srgb_decode(i / 255.0) * 65535.0 + 0.5);
+  }
+  for (i = 0; i < 255; i++) {
+    glimage_srgb_thresholds[i] =
+      (int) ceil(glimage_srgb_decode((i + 0.5) / 255.0) * 65535.0);
+  }
+  glimage_srgb_thresholds[255] = 65536; // never passed
+  const int * t = glimage_srgb_thresholds;
+  for (i = 0; i < 4096; i++) {
+    glimage_srgb_start[i] = (unsigned char) (std::upper_bound(t, t + 255, i << 4) - t);
+  }
+}
+
+static inline unsigned char
+glimage_linear_to_srgb(const int v)
+{
+  int s = glimage_srgb_start[v >> 4];
+  while (v >= glimage_srgb_thresholds[s]) s++;
+  return (unsigned char) s;
+}
+
+// Gamma correct version of the row kernels. ROWS is 1 for 1D
+// images. Alpha is averaged as is.
+template <int ROWS>
+static void
+halve_row_srgb(const unsigned char * const * rows, const int nc,
+               const int num, unsigned char * dst)
+{
+  const int alpha = (nc == 2 || nc == 4) ? nc - 1 : -1;
+  const int shift = (ROWS == 1) ? 1 : ((ROWS == 2) ? 2 : 3);
+  const uint16_t * lin = glimage_srgb_to_linear;
+  for (int i = 0; i < num; i++) {
+    for (int c = 0; c < nc; c++) {
+      const int j = 2 * i * nc + c;
+      int sum = ROWS;
+      if (c == alpha) {
+        for (int r = 0; r < ROWS; r++) sum += rows[r][j] + rows[r][j + nc];
+        *dst++ = (unsigned char) (sum >> shift);
+      }
+      else {
+        for (int r = 0; r < ROWS; r++) sum += lin[rows[r][j]] + lin[rows[r][j + nc]];
+        *dst++ = glimage_linear_to_srgb(sum >> shift);
+      }
+    }
+  }
+}
+
 //FIXME: Use as a special case of 3D image to reduce codelines ? (kintel 20011115)
 static void
 halve_image(const int width, const int height, const int nc,
-            const unsigned char *datain, unsigned char *dataout)
+            const unsigned char *datain, unsigned char *dataout,
+            const SbBool srgb = FALSE)
 {
   assert(width > 1 || height > 1);
 
@@ -341,6 +763,10 @@ halve_image(const int width, const int height, const int nc,
   // check for 1D images
   if (width == 1 || height == 1) {
     int n = SbMax(newwidth, newheight);
+    if (srgb) {
+      halve_row_srgb<1>(&src, nc, n, dst);
+      return;
+    }
     for (int i = 0; i < n; i++) {
       for (int j = 0; j < nc; j++) {
         *dst = (src[0] + src[nc]) >> 1;
@@ -350,22 +776,21 @@ halve_image(const int width, const int height, const int nc,
     }
   }
   else {
+    halve_row_func * halverow = halve_get_row_func(2);
     for (int i = 0; i < newheight; i++) {
-      for (int j = 0; j < newwidth; j++) {
-        for (int c = 0; c < nc; c++) {
-          *dst = (src[0] + src[nc] + src[nextrow] + src[nextrow+nc] + 2) >> 2;
-          dst++; src++;
-        }
-        src += nc; // skip to next pixel
-      }
-      src += nextrow;
+      const unsigned char * rows[2] = { src, src + nextrow };
+      if (srgb) halve_row_srgb<2>(rows, nc, newwidth, dst);
+      else halverow(rows, nc, newwidth, dst);
+      dst += newwidth * nc;
+      src += newwidth * nc * 2 + nextrow; // skip to next row pair
     }
   }
 }
 
 static void
 halve_image(const int width, const int height, const int depth, const int nc,
-            const unsigned char *datain, unsigned char *dataout)
+            const unsigned char *datain, unsigned char *dataout,
+            const SbBool srgb = FALSE)
 {
   assert(width > 1 || height > 1 || depth > 1);
 
@@ -377,10 +802,14 @@ halve_image(const int width, const int height, const int depth, const int nc,
   unsigned char *dst = dataout;
   const unsigned char *src = datain;
 
-  int numdims = (width>=1?1:0)+(height>=1?1:0)+(depth>=1?1:0);
+  int numdims = (width>1?1:0)+(height>1?1:0)+(depth>1?1:0);
   // check for 1D images.
   if (numdims == 1) {
     int n = SbMax(SbMax(newwidth, newheight), newdepth);
+    if (srgb) {
+      halve_row_srgb<1>(&src, nc, n, dst);
+      return;
+    }
     for (int i = 0; i < n; i++) {
       for (int j = 0; j < nc; j++) {
         *dst = (src[0] + src[nc]) >> 1;
@@ -401,32 +830,26 @@ halve_image(const int width, const int height, const int depth, const int nc,
       blocksize = width * nc;
     }
     s2 = depth==1?newheight:newdepth;
+    halve_row_func * halverow = halve_get_row_func(2);
     for (int j = 0; j < s2; j++) {
-      for (int i = 0; i < s1; i++) {
-        for (int j = 0; j < nc; j++) {
-          *dst = (src[0] + src[nc] + src[blocksize] + src[blocksize+nc] + 2) >> 2;
-          dst++; src++;
-        }
-        src += nc; // skip to next pixel (x or y direction)
-      }
-      src += blocksize; // Skip to next row/image
+      const unsigned char * rows[2] = { src, src + blocksize };
+      if (srgb) halve_row_srgb<2>(rows, nc, s1, dst);
+      else halverow(rows, nc, s1, dst);
+      dst += s1 * nc;
+      src += s1 * nc * 2 + blocksize; // Skip to next row/image
     }
   }
   else { // 3D image
+    halve_row_func * halverow = halve_get_row_func(4);
     for (int k = 0; k < newdepth; k++) {
       for (int j = 0; j < newheight; j++) {
-        for (int i = 0; i < newwidth; i++) {
-          for (int c = 0; c < nc; c++) {
-            *dst = (src[0] + src[nc] +
-                    src[rowsize] + src[rowsize+nc] +
-                    src[imagesize] + src[imagesize+nc] +
-                    src[imagesize+rowsize] + src[imagesize+rowsize+nc] +
-                    4) >> 3;
-            dst++; src++;
-          }
-          src += nc; // skip one pixel
-        }
-        src += rowsize; // skip one row
+        const unsigned char * rows[4] = {
+          src, src + rowsize, src + imagesize, src + imagesize + rowsize
+        };
+        if (srgb) halve_row_srgb<4>(rows, nc, newwidth, dst);
+        else halverow(rows, nc, newwidth, dst);
+        dst += newwidth * nc;
+        src += newwidth * nc * 2 + rowsize; // skip one row
       }
       src += imagesize; // skip one image
     }
@@ -438,7 +861,7 @@ halve_image(const int width, const int height, const int depth, const int nc,
 static void
 fast_mipmap(SoState * state, int width, int height, int nc,
             const unsigned char *data, const SbBool useglsubimage,
-            SbBool compress)
+            SbBool compress, const SbBool srgb)
 {
   const cc_glglue * glw = sogl_glue_instance(state);
   GLint internalFormat = coin_glglue_get_internal_texture_format(glw, nc, compress);
@@ -463,7 +886,7 @@ fast_mipmap(SoState * state, int width, int height, int nc,
   }
   unsigned char *src = (unsigned char *) data;
   for (level = 1; level <= levels; level++) {
-    halve_image(width, height, nc, src, mipmap_buffer);
+    halve_image(width, height, nc, src, mipmap_buffer, srgb);
     if (width > 1) width >>= 1;
     if (height > 1) height >>= 1;
     src = mipmap_buffer;
@@ -486,7 +909,7 @@ fast_mipmap(SoState * state, int width, int height, int nc,
 static void
 fast_mipmap(SoState * state, int width, int height, int depth,
             int nc, const unsigned char *data, const SbBool useglsubimage,
-            SbBool compress)
+            SbBool compress, const SbBool srgb)
 {
   const cc_glglue * glw = sogl_glue_instance(state);
   GLint internalFormat = coin_glglue_get_internal_texture_format(glw, nc, compress);
@@ -513,7 +936,7 @@ fast_mipmap(SoState * state, int width, int height, int depth,
   }
   unsigned char *src = (unsigned char *) data;
   for (int level = 1; level <= levels; level++) {
-    halve_image(width, height, depth, nc, src, mipmap_buffer);
+    halve_image(width, height, depth, nc, src, mipmap_buffer, srgb);
     if (width > 1) width >>= 1;
     if (height > 1) height >>= 1;
     if (depth > 1) depth >>= 1;
@@ -535,6 +958,125 @@ fast_mipmap(SoState * state, int width, int height, int depth,
   }
 }
 
+// Copies num pixels from the source row offsets in a table. srcsize
+// is the number of bytes that can be read from src.
+typedef void resize_row_func(const unsigned char * src, const int srcsize,
+                             const int * offsets, const int nc,
+                             const int num, unsigned char * dst);
+
+static void
+resize_row_c(const unsigned char * src, const int COIN_UNUSED_ARG(srcsize),
+             const int * offsets, const int nc,
+             const int num, unsigned char * dst)
+{
+  int x;
+  switch (nc) {
+  case 1:
+    for (x = 0; x < num; x++) dst[x] = src[offsets[x]];
+    break;
+  case 2:
+    for (x = 0; x < num; x++) (void)memcpy(dst + 2 * x, src + offsets[x], 2);
+    break;
+  case 3:
+    for (x = 0; x < num; x++) (void)memcpy(dst + 3 * x, src + offsets[x], 3);
+    break;
+  case 4:
+    for (x = 0; x < num; x++) (void)memcpy(dst + 4 * x, src + offsets[x], 4);
+    break;
+  default:
+    for (x = 0; x < num; x++) {
+      for (int i = 0; i < nc; i++) dst[x * nc + i] = src[offsets[x] + i];
+    }
+    break;
+  }
+}
+
+#ifdef COIN_HAVE_X86_SIMD
+
+// Gathers 8 pixels at a time as 32-bit words, and packs the first nc
+// bytes of each word. Stops before gathering past the end of the
+// source image.
+static COIN_TARGET_AVX2 void
+resize_row_avx2(const unsigned char * src, const int srcsize,
+                const int * offsets, const int nc,
+                const int num, unsigned char * dst)
+{
+  if (nc < 1 || nc > 4) {
+    resize_row_c(src, srcsize, offsets, nc, num, dst);
+    return;
+  }
+  const char z = -1;
+  const __m256i pack[3] = {
+    _mm256_setr_epi8(0, 4, 8, 12, z, z, z, z, z, z, z, z, z, z, z, z,
+                     0, 4, 8, 12, z, z, z, z, z, z, z, z, z, z, z, z),
+    _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, z, z, z, z, z, z, z, z,
+                     0, 1, 4, 5, 8, 9, 12, 13, z, z, z, z, z, z, z, z),
+    _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, z, z, z, z,
+                     0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, z, z, z, z)
+  };
+  const __m256i order[3] = {
+    _mm256_setr_epi32(0, 4, 1, 2, 3, 5, 6, 7),
+    _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7),
+    _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)
+  };
+  int x = 0;
+  for (; x + 8 <= num && offsets[x + 7] + 4 <= srcsize; x += 8) {
+    const __m256i idx = _mm256_loadu_si256((const __m256i *) (offsets + x));
+    __m256i v = _mm256_i32gather_epi32((const int *) src, idx, 1);
+    unsigned char * p = dst + x * nc;
+    switch (nc) {
+    case 4:
+      _mm256_storeu_si256((__m256i *) p, v);
+      break;
+    case 3:
+      v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack[2]), order[2]);
+      _mm_storeu_si128((__m128i *) p, _mm256_castsi256_si128(v));
+      _mm_storel_epi64((__m128i *) (p + 16), _mm256_extracti128_si256(v, 1));
+      break;
+    default:
+      v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack[nc - 1]), order[nc - 1]);
+      if (nc == 2) _mm_storeu_si128((__m128i *) p, _mm256_castsi256_si128(v));
+      else _mm_storel_epi64((__m128i *) p, _mm256_castsi256_si128(v));
+      break;
+    }
+  }
+  resize_row_c(src, srcsize, offsets + x, nc, num - x, dst + x * nc);
+}
+
+#endif // COIN_HAVE_X86_SIMD
+
+static resize_row_func *
+resize_get_row_func(void)
+{
+  static resize_row_func * func = NULL;
+  if (func == NULL) {
+#ifdef COIN_HAVE_X86_SIMD
+    if (coin_runtime_simd() == COIN_SIMD_AVX2) func = resize_row_avx2;
+    else
+#endif // COIN_HAVE_X86_SIMD
+    {
+      func = resize_row_c;
+    }
+  }
+  return func;
+}
+
+// Returns the source offsets for each of the num destination
+// pixels/rows/images, stepping with the same float increments as the
+// resize functions always have, so that the same pixels are picked.
+static int *
+resize_make_offsets(const int size, const int newsize, const int stride)
+{
+  int * offsets = new int[newsize];
+  const float d = ((float)size)/((float)newsize);
+  float s = 0.0f;
+  for (int i = 0; i < newsize; i++) {
+    offsets[i] = ((int)s) * stride;
+    s += d;
+  }
+  return offsets;
+}
+
 // A low quality resize function. It is only used when neither simage
 // nor GLU is available.
 static void
@@ -544,26 +1086,25 @@ fast_image_resize(const unsigned char * src,
                   int height, int num_comp,
                   int newwidth, int newheight)
 {
-  float sx, sy, dx, dy;
-  int src_bpr, dest_bpr, xstop, ystop, x, y, offset, i;
-
-  dx = ((float)width)/((float)newwidth);
-  dy = ((float)height)/((float)newheight);
-  src_bpr = width * num_comp;
-  dest_bpr = newwidth * num_comp;
+  const int src_bpr = width * num_comp;
+  const int dest_bpr = newwidth * num_comp;
+  const int srcsize = src_bpr * height;
+  int * xoffsets = resize_make_offsets(width, newwidth, num_comp);
+  int * yoffsets = resize_make_offsets(height, newheight, src_bpr);
+  resize_row_func * resizerow = resize_get_row_func();
 
-  sy = 0.0f;
-  ystop = newheight * dest_bpr;
-  xstop = newwidth * num_comp;
-  for (y = 0; y < ystop; y += dest_bpr) {
-    sx = 0.0f;
-    for (x = 0; x < xstop; x += num_comp) {
-      offset = ((int)sy)*src_bpr + ((int)sx)*num_comp;
-      for (i = 0; i < num_comp; i++) dest[x+y+i] = src[offset+i];
-      sx += dx;
+  for (int y = 0; y < newheight; y++) {
+    if (y > 0 && yoffsets[y] == yoffsets[y-1]) { // same row as the previous one
+      (void)memcpy(dest, dest - dest_bpr, dest_bpr);
+    }
+    else {
+      resizerow(src + yoffsets[y], srcsize - yoffsets[y], xoffsets,
+                num_comp, newwidth, dest);
     }
-    sy += dy;
+    dest += dest_bpr;
   }
+  delete[] xoffsets;
+  delete[] yoffsets;
 }
 
 // A low quality resize function for 3D texture image buffers. It is
@@ -576,34 +1117,123 @@ fast_image_resize3d(const unsigned char * src,
                     int newwidth, int newheight,
                     int newlayers)
 {
-  float sx, sy, sz, dx, dy, dz;
-  int src_bpr, dest_bpr, src_bpl, dest_bpl, xstop, ystop, zstop;
-  int x, y, z, offset, i;
-
-  dx = ((float)width)/((float)newwidth);
-  dy = ((float)height)/((float)newheight);
-  dz = ((float)layers)/((float)newlayers);
-  src_bpr = width * nc;
-  dest_bpr = newwidth * nc;
-  src_bpl = src_bpr * height;
-  dest_bpl = dest_bpr * newheight;
-
-  zstop = newlayers * dest_bpl;
-  ystop = dest_bpl;
-  xstop = dest_bpr;
-  sz = 0.0f;
-  for (z = 0; z < zstop; z += dest_bpl) {
-    sy = 0.0f;
-    for (y = 0; y < ystop; y += dest_bpr) {
-      sx = 0.0f;
-      for (x = 0; x < xstop; x += nc) {
-        offset = ((int)sz)*src_bpl + ((int)sy)*src_bpr + ((int)sx)*nc;
-        for (i = 0; i < nc; i++) dest[x+y+z+i] = src[offset+i];
-        sx += dx;
+  const int src_bpr = width * nc;
+  const int dest_bpr = newwidth * nc;
+  const int src_bpl = src_bpr * height;
+  const int dest_bpl = dest_bpr * newheight;
+  const int srcsize = src_bpl * layers;
+  int * xoffsets = resize_make_offsets(width, newwidth, nc);
+  int * yoffsets = resize_make_offsets(height, newheight, src_bpr);
+  int * zoffsets = resize_make_offsets(layers, newlayers, src_bpl);
+  resize_row_func * resizerow = resize_get_row_func();
+
+  for (int z = 0; z < newlayers; z++) {
+    if (z > 0 && zoffsets[z] == zoffsets[z-1]) { // same layer as the previous one
+      (void)memcpy(dest, dest - dest_bpl, dest_bpl);
+      dest += dest_bpl;
+      continue;
+    }
+    for (int y = 0; y < newheight; y++) {
+      if (y > 0 && yoffsets[y] == yoffsets[y-1]) {
+        (void)memcpy(dest, dest - dest_bpr, dest_bpr);
       }
-      sy += dy;
+      else {
+        const int offset = zoffsets[z] + yoffsets[y];
+        resizerow(src + offset, srcsize - offset, xoffsets, nc, newwidth, dest);
+      }
+      dest += dest_bpr;
     }
-    sz += dz;
+  }
+  delete[] xoffsets;
+  delete[] yoffsets;
+  delete[] zoffsets;
+}
+
+// *************************************************************************
+
+// Mipmaps built in the background for images with the
+// BACKGROUND_MIPMAP flag. The image data is copied, resized to a
+// power of two size, and all the mipmap levels are stored after each
+// other in one buffer. The instance is shared by the image and the
+// job building the mipmaps, and is deleted when both are done with
+// it.
+class soglimage_mipmaps {
+public:
+  soglimage_mipmaps(void)
+    : source(NULL), data(NULL), numlevels(0), done(FALSE), refcount(2) { }
+  ~soglimage_mipmaps() {
+    delete[] this->source;
+    delete[] this->data;
+  }
+
+  int getWidth(const int level) const { return SbMax(this->width >> level, 1); }
+  int getHeight(const int level) const { return SbMax(this->height >> level, 1); }
+  size_t getNumBytes(const int level) const {
+    return size_t(this->getWidth(level)) * size_t(this->getHeight(level)) * this->nc;
+  }
+  const unsigned char * getLevel(const int level) const {
+    size_t offset = 0;
+    for (int i = 0; i < level; i++) offset += this->getNumBytes(i);
+    return this->data + offset;
+  }
+  void build(void);
+
+  unsigned char * source; // freed when the mipmaps are built
+  int sourcewidth, sourceheight;
+  int nc;
+  int width, height; // size of level 0
+  SbBool highquality;
+  SbBool srgb;
+
+  unsigned char * data;
+  int numlevels;
+  SbBool done;
+  int refcount;
+};
+
+// Called from a worker thread. Does not touch anything but the
+// instance itself.
+void
+soglimage_mipmaps::build(void)
+{
+  this->numlevels = compute_log(SbMax(this->width, this->height)) + 1;
+  size_t total = 0;
+  for (int i = 0; i < this->numlevels; i++) total += this->getNumBytes(i);
+  this->data = new unsigned char[total];
+
+  SbBool resized = FALSE;
+  if (this->width == this->sourcewidth && this->height == this->sourceheight) {
+    (void)memcpy(this->data, this->source, this->getNumBytes(0));
+    resized = TRUE;
+  }
+  else if (this->highquality &&
+           simage_wrapper()->available &&
+           simage_wrapper()->versionMatchesAtLeast(1,1,1) &&
+           simage_wrapper()->simage_resize) {
+    unsigned char * result =
+      simage_wrapper()->simage_resize(this->source,
+                                      this->sourcewidth, this->sourceheight,
+                                      this->nc, this->width, this->height);
+    if (result) {
+      (void)memcpy(this->data, result, this->getNumBytes(0));
+      simage_wrapper()->simage_free_image(result);
+      resized = TRUE;
+    }
+  }
+  if (!resized) {
+    fast_image_resize(this->source, this->data,
+                      this->sourcewidth, this->sourceheight, this->nc,
+                      this->width, this->height);
+  }
+  delete[] this->source;
+  this->source = NULL;
+
+  unsigned char * src = this->data;
+  for (int level = 1; level < this->numlevels; level++) {
+    unsigned char * dst = src + this->getNumBytes(level - 1);
+    halve_image(this->getWidth(level - 1), this->getHeight(level - 1),
+                this->nc, src, dst, this->srgb);
+    src = dst;
   }
 }
 
@@ -620,6 +1250,7 @@ public:
   static uint32_t getNextGLImageId(void);
 
   SoGLDisplayList *createGLDisplayList(SoState *state);
+  SoGLDisplayList *createCompressedDL(SoState *state);
   void checkTransparency(void);
   void unrefDLists(SoState *state);
   void reallyCreateTexture(SoState *state,
@@ -634,12 +1265,25 @@ public:
                    uint32_t &xsize, uint32_t &ysize, uint32_t &zsize);
   SbBool shouldCreateMipmap(void);
   void applyFilter(const SbBool ismipmap);
+  void computePowerOfTwoSize(uint32_t & xsize, uint32_t & ysize, uint32_t & zsize);
+
+  SbBool useBackgroundMipmaps(SoState * state);
+  SoGLDisplayList * getBackgroundDL(SoState * state);
+  SoGLDisplayList * createPlaceholderDL(SoState * state);
+  SoGLDisplayList * createMipmapDL(SoState * state,
+                                   int & firstlevel, int & pendinglevels);
+  void uploadMipmapLevels(SoState * state, const int firstlevel,
+                          const int numlevels, int & pendinglevels);
+  void releaseMipmaps(void);
+  soglimage_mipmaps * mipmaps;
 
   void * pbuffer;
   const SbImage *image;
   SbImage dummyimage;
   SbVec3s glsize;
   int glcomp;
+  // bytes uploaded for compressed textures, 0 for uncompressed ones
+  size_t glbytes;
 
   SbBool needtransparencytest;
   SbBool hastransparency;
@@ -659,21 +1303,36 @@ public:
   class dldata {
   public:
     dldata(void)
-      : dlist(NULL), age(0) { }
-    dldata(SoGLDisplayList *dl)
+      : dlist(NULL), age(0), resid(0), firstlevel(0), pendinglevels(0) { }
+    dldata(SoGLDisplayList *dl, uint32_t id = 0)
       : dlist(dl),
-        age(0) { }
+        age(0),
+        resid(id),
+        firstlevel(0),
+        pendinglevels(0) { }
     dldata(const dldata & org)
       : dlist(org.dlist),
-        age(org.age) { }
+        age(org.age),
+        resid(org.resid),
+        firstlevel(org.firstlevel),
+        pendinglevels(org.pendinglevels) { }
     SoGLDisplayList *dlist;
     uint32_t age;
+    // SoGLResourceManager id, 0 for display lists set by the user
+    uint32_t resid;
+    // for BACKGROUND_MIPMAP textures: the mipmap level used as level
+    // 0 in OpenGL, and the number of levels not uploaded yet (-1 for
+    // a placeholder texture)
+    int firstlevel;
+    int pendinglevels;
   };
 
   SbList <dldata> dlists;
   SoGLDisplayList *findDL(SoState *state);
   void tagDL(SoState *state);
   void unrefOldDL(SoState *state, const uint32_t maxage);
+  uint32_t addResource(SoGLDisplayList *dl);
+  static void evictCB(void *closure, const uint32_t contextid, SoState *state);
   SoGLImage *owner;
   uint32_t glimageid;
   void init(void);
@@ -721,6 +1380,22 @@ SbMutex * SoGLImageP::mutex;
 
 // *************************************************************************
 
+// SoTextureScheduler job building mipmaps
+static void
+glimage_mipmaps_job(void * closure)
+{
+  soglimage_mipmaps * mipmaps = (soglimage_mipmaps *) closure;
+  mipmaps->build();
+
+  LOCK_GLIMAGE;
+  mipmaps->done = TRUE;
+  const SbBool unused = (--mipmaps->refcount == 0);
+  UNLOCK_GLIMAGE;
+  if (unused) delete mipmaps;
+}
+
+// *************************************************************************
+
 /*!
   Constructor.
 */
@@ -729,6 +1404,7 @@ SoGLImage::SoGLImage(void)
   PRIVATE(this) = new SoGLImageP;
   SoContextHandler::addContextDestructionCallback(SoGLImageP::contextCleanup, PRIVATE(this));
   PRIVATE(this)->isregistered = FALSE;
+  PRIVATE(this)->mipmaps = NULL;
   PRIVATE(this)->init(); // init members to default values
   PRIVATE(this)->owner = this;
 
@@ -807,6 +1483,7 @@ SoGLImage::initClass(void)
 #endif // COIN_THREADSAFE
   glimage_bufferstorage = new SbStorage(sizeof(soglimage_buffer),
                                         glimage_buffer_construct, glimage_buffer_destruct);
+  glimage_init_srgb_tables();
 
   coin_atexit((coin_atexit_f*)SoGLImage::cleanupClass, CC_ATEXIT_NORMAL);
 
@@ -1011,6 +1688,12 @@ SoGLImage::setData(const SbImage * image,
 
   If you supply NULL for \a image, the instance will be reset, causing
   all display lists and memory to be freed.
+
+  If \a image holds block compressed data (see
+  SbImage::setCompressedValue()), and the OpenGL driver supports the
+  format, the data is uploaded without being decoded, together with
+  the mipmap levels stored in the image. Otherwise the decoded pixels
+  are used like for any other image.
 */
 void
 SoGLImage::setData(const SbImage *image,
@@ -1051,9 +1734,12 @@ SoGLImage::setData(const SbImage *image,
       border == 0 && // haven't tested with borders yet. Play it safe.
       (dl = PRIVATE(this)->findDL(createinstate)) != NULL;
 
-    SbVec3s size;
-    int nc;
-    const unsigned char * bytes = image->getValue(size, nc);
+    // compressed images always get a new texture object
+    SbVec3s size(0, 0, 0);
+    int nc = 0;
+    const unsigned char * bytes =
+      image->getCompressedFormat() == SbImage::UNCOMPRESSED ?
+      image->getValue(size, nc) : NULL;
     copyok = copyok && bytes && (size == PRIVATE(this)->glsize) && (nc == PRIVATE(this)->glcomp);
 
     SbBool is3D = (size[2]==0)?FALSE:TRUE;
@@ -1075,13 +1761,15 @@ SoGLImage::setData(const SbImage *image,
         (PRIVATE(this)->flags & COMPRESSED) &&
         SoGLDriverDatabase::isSupported(glw, SO_GL_TEXTURE_COMPRESSION);
 
+      const SbBool srgb = (PRIVATE(this)->flags & SRGB_MIPMAP) != 0;
+
       if (dl->isMipMapTextureObject()) {
         if (is3D)
           fast_mipmap(createinstate, size[0], size[1], size[2], nc, bytes,
-                      TRUE, compress);
+                      TRUE, compress, srgb);
         else
           fast_mipmap(createinstate, size[0], size[1], nc, bytes,
-                      TRUE, compress);
+                      TRUE, compress, srgb);
       }
       else {
         GLenum format = coin_glglue_get_texture_format(glw, nc);
@@ -1233,6 +1921,10 @@ SoGLImage::getImage(void) const
 SoGLDisplayList *
 SoGLImage::getGLDisplayList(SoState *state)
 {
+  if (PRIVATE(this)->useBackgroundMipmaps(state)) {
+    return PRIVATE(this)->getBackgroundDL(state);
+  }
+
   LOCK_GLIMAGE;
   SoGLDisplayList *dl = PRIVATE(this)->findDL(state);
   UNLOCK_GLIMAGE;
@@ -1241,7 +1933,7 @@ SoGLImage::getGLDisplayList(SoState *state)
     dl = PRIVATE(this)->createGLDisplayList(state);
     if (dl) {
       LOCK_GLIMAGE;
-      PRIVATE(this)->dlists.append(SoGLImageP::dldata(dl));
+      PRIVATE(this)->dlists.append(SoGLImageP::dldata(dl, PRIVATE(this)->addResource(dl)));
       UNLOCK_GLIMAGE;
     }
   }
@@ -1256,8 +1948,10 @@ SoGLImage::getGLDisplayList(SoState *state)
       for (int i = 0; i < n; i++) {
         if (PRIVATE(this)->dlists[i].dlist == dl) {
           dl->unref(state); // unref old DL
+          SoGLResourceManagerP::remove(PRIVATE(this)->dlists[i].resid);
           dl = PRIVATE(this)->createGLDisplayList(state);
           PRIVATE(this)->dlists[i].dlist = dl;
+          PRIVATE(this)->dlists[i].resid = dl ? PRIVATE(this)->addResource(dl) : 0;
           break;
         }
       }
@@ -1350,6 +2044,81 @@ SoGLImage::getGLImageId(void) const
   return PRIVATE(this)->glimageid;
 }
 
+/*!
+  Returns \e TRUE while the mipmaps for an image with the
+  BACKGROUND_MIPMAP flag are being built, or while some of them have
+  not been sent to OpenGL yet. The scene should be redrawn until this
+  returns \e FALSE.
+
+  \since Coin 4.0
+*/
+SbBool
+SoGLImage::isLoading(void) const
+{
+  SbBool loading = FALSE;
+  LOCK_GLIMAGE;
+  if (PRIVATE(this)->mipmaps) {
+    loading = !PRIVATE(this)->mipmaps->done;
+    const int n = PRIVATE(this)->dlists.getLength();
+    for (int i = 0; i < n; i++) {
+      if (PRIVATE(this)->dlists[i].pendinglevels != 0) loading = TRUE;
+    }
+  }
+  UNLOCK_GLIMAGE;
+  return loading;
+}
+
+/*!
+  Builds the next mipmap level for an image of \a size pixels with \a
+  numcomponents bytes per pixel, using the same box filter as is used
+  for textures. \a dst must have room for an image with each
+  dimension halved (but at least 1). Use a depth of 1 or 0 for 2D
+  images. The dimensions are expected to be powers of two.
+
+  If \a srgb is \e TRUE, the color components are averaged in linear
+  space, as for images with the SRGB_MIPMAP flag.
+
+  \since Coin 4.0
+*/
+void
+SoGLImage::halveImage(const unsigned char * src, const SbVec3s & size,
+                      const int numcomponents, unsigned char * dst,
+                      const SbBool srgb)
+{
+  if (size[2] <= 1) {
+    halve_image(size[0], size[1], numcomponents, src, dst, srgb);
+  }
+  else {
+    halve_image(size[0], size[1], size[2], numcomponents, src, dst, srgb);
+  }
+}
+
+/*!
+  Resizes an image of \a size pixels with \a numcomponents bytes per
+  pixel to \a newsize, and stores the result in \a dst. This is the
+  fast, low quality (nearest pixel) resize used for textures when
+  neither simage nor a resize callback is available. Use a depth of
+  1 or 0 for 2D images.
+
+  \since Coin 4.0
+  \sa setResizeCallback()
+*/
+void
+SoGLImage::resizeImage(const unsigned char * src, const SbVec3s & size,
+                       const int numcomponents, unsigned char * dst,
+                       const SbVec3s & newsize)
+{
+  if (size[2] <= 1 && newsize[2] <= 1) {
+    fast_image_resize(src, dst, size[0], size[1], numcomponents,
+                      newsize[0], newsize[1]);
+  }
+  else {
+    fast_image_resize3d(src, dst, size[0], size[1], numcomponents,
+                        SbMax((int) size[2], 1), newsize[0], newsize[1],
+                        SbMax((int) newsize[2], 1));
+  }
+}
+
 /*!
   Virtual method that will be called once each frame.  The method
   should unref display lists that has an age bigger or equal to \a
@@ -1372,6 +2141,7 @@ SoGLImageP::init(void)
   this->pbuffer = NULL;
   this->glsize.setValue(0,0,0);
   this->glcomp = 0;
+  this->glbytes = 0;
   this->wraps = SoGLImage::CLAMP;
   this->wrapt = SoGLImage::CLAMP;
   this->wrapr = SoGLImage::CLAMP;
@@ -1386,6 +2156,41 @@ SoGLImageP::init(void)
   this->glimageid = 0; // glimageid 0 is an empty image
 }
 
+//
+// Calculates the power of two size (without border) to use for an
+// image of the given size (with border).
+//
+void
+SoGLImageP::computePowerOfTwoSize(uint32_t & xsize, uint32_t & ysize, uint32_t & zsize)
+{
+  uint32_t newx = coin_geq_power_of_two(xsize - 2*this->border);
+  uint32_t newy = coin_geq_power_of_two(ysize - 2*this->border);
+  uint32_t newz = zsize ? coin_geq_power_of_two(zsize - 2*this->border) : 0;
+
+  // if >= 256 and low quality, don't scale up unless size is
+  // close to an above power of two. This saves a lot of texture memory
+
+  if (this->flags & SoGLImage::SCALE_DOWN) {
+    // no use scaling down for very small images
+    if (newx > xsize && newx > 16) newx >>= 1;
+    if (newy > ysize && newy > 16) newy >>= 1;
+    if (newz > zsize && newz > 16) newz >>= 1;
+  }
+  else if (this->flags & SoGLImage::USE_QUALITY_VALUE) {
+    if (this->quality < COIN_TEX2_SCALEUP_LIMIT) {
+      if ((newx >= 256) && ((newx - (xsize-2*this->border)) > (newx>>3)))
+        newx >>= 1;
+      if ((newy >= 256) && ((newy - (ysize-2*this->border)) > (newy>>3)))
+        newy >>= 1;
+      if ((newz >= 256) && ((newz - (zsize-2*this->border)) > (newz>>3)))
+        newz >>= 1;
+    }
+  }
+  xsize = newx;
+  ysize = newy;
+  zsize = newz;
+}
+
 //
 // resize image if necessary. Returns pointer to temporary
 // buffer if that happens, and the new size in xsize, ysize.
@@ -1405,29 +2210,7 @@ SoGLImageP::resizeImage(SoState * state, unsigned char *& imageptr,
   uint32_t maxrectsize = 0;
 
   if (!(this->flags & SoGLImage::RECTANGLE)) {
-    newx = coin_geq_power_of_two(xsize - 2*this->border);
-    newy = coin_geq_power_of_two(ysize - 2*this->border);
-    newz = zsize ? coin_geq_power_of_two(zsize - 2*this->border) : 0;
-
-    // if >= 256 and low quality, don't scale up unless size is
-    // close to an above power of two. This saves a lot of texture memory
-
-    if (this->flags & SoGLImage::SCALE_DOWN) {
-      // no use scaling down for very small images
-      if (newx > xsize && newx > 16) newx >>= 1;
-      if (newy > ysize && newy > 16) newy >>= 1;
-      if (newz > zsize && newz > 16) newz >>= 1;
-    }
-    else if (this->flags & SoGLImage::USE_QUALITY_VALUE) {
-      if (this->quality < COIN_TEX2_SCALEUP_LIMIT) {
-        if ((newx >= 256) && ((newx - (xsize-2*this->border)) > (newx>>3)))
-          newx >>= 1;
-        if ((newy >= 256) && ((newy - (ysize-2*this->border)) > (newy>>3)))
-          newy >>= 1;
-        if ((newz >= 256) && ((newz - (zsize-2*this->border)) > (newz>>3)))
-          newz >>= 1;
-      }
-    }
+    this->computePowerOfTwoSize(newx, newy, newz);
   }
   else {
     GLint maxr;
@@ -1603,6 +2386,14 @@ SoGLImageP::resizeImage(SoState * state, unsigned char *& imageptr,
 SoGLDisplayList *
 SoGLImageP::createGLDisplayList(SoState *state)
 {
+  if (this->image && !this->pbuffer &&
+      this->image->getCompressedFormat() != SbImage::UNCOMPRESSED) {
+    SoGLDisplayList * dl = this->createCompressedDL(state);
+    if (dl) return dl;
+    // not supported by the driver, fall through and use the decoded
+    // pixels
+  }
+
   SbVec3s size;
   int numcomponents;
   unsigned char *bytes =
@@ -1675,6 +2466,31 @@ SoGLImageP::checkTransparency(void)
   this->usealphatest = FALSE;
   this->hastransparency = FALSE;
 
+  const SbImage::CompressedFormat format = this->image ?
+    this->image->getCompressedFormat() : SbImage::UNCOMPRESSED;
+  if (format != SbImage::UNCOMPRESSED && !SbImageCodec::hasAlpha(format)) {
+    return; // no need to decode the image
+  }
+  if (format == SbImage::BC1_RGBA) {
+    // alpha is either 0 or 255. A block has transparent pixels if
+    // color0 <= color1 and some pixel uses index 3.
+    SbVec2s size;
+    size_t numbytes;
+    const unsigned char * block =
+      this->image->getCompressedLevel(0, size, numbytes);
+    for (size_t i = 0; i < numbytes && !this->usealphatest; i += 8, block += 8) {
+      if ((block[0] | (block[1] << 8)) > (block[2] | (block[3] << 8))) continue;
+      for (int j = 4; j < 8; j++) {
+        const unsigned char b = block[j];
+        // both bits set in any of the four 2-bit indices
+        if (b & (b >> 1) & 0x55) this->usealphatest = TRUE;
+      }
+    }
+    // FIXME: padding pixels in partial blocks are counted as well
+    this->hastransparency = this->usealphatest;
+    return;
+  }
+
   SbVec3s size;
   int numcomponents;
   unsigned char *bytes = this->image ?
@@ -1727,6 +2543,144 @@ translate_wrap(SoState *state, const SoGLImage::Wrap wrap)
   return (GLenum) GL_CLAMP;
 }
 
+// Returns the OpenGL internal format for uploading a compressed
+// image, or 0 if the driver doesn't support it. BC4 and BC5 are
+// uploaded as LATC, since 1 and 2 component images are luminance and
+// luminance-alpha in Coin.
+static GLenum
+glimage_compressed_format(const cc_glglue * glw,
+                          const SbImage::CompressedFormat format)
+{
+  if (!SoGLDriverDatabase::isSupported(glw, SO_GL_TEXTURE_COMPRESSION)) return 0;
+
+  const SbBool s3tc =
+    SoGLDriverDatabase::isSupported(glw, "GL_EXT_texture_compression_s3tc");
+  const SbBool latc =
+    SoGLDriverDatabase::isSupported(glw, "GL_EXT_texture_compression_latc");
+
+  switch (format) {
+  case SbImage::BC1_RGB:
+    return s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+  case SbImage::BC1_RGBA:
+    return s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : 0;
+  case SbImage::BC2_RGBA:
+    return s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT3_EXT : 0;
+  case SbImage::BC3_RGBA:
+    return s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+  case SbImage::BC4_R:
+    return latc ? GL_COMPRESSED_LUMINANCE_LATC1_EXT : 0;
+  case SbImage::BC5_RG:
+    return latc ? GL_COMPRESSED_LUMINANCE_ALPHA_LATC2_EXT : 0;
+  case SbImage::ETC1_RGB:
+    if (SoGLDriverDatabase::isSupported(glw, "GL_OES_compressed_ETC1_RGB8_texture")) {
+      return GL_ETC1_RGB8_OES;
+    }
+    // ETC2 is backwards compatible with ETC1
+    if (SoGLDriverDatabase::isSupported(glw, "GL_ARB_ES3_compatibility")) {
+      return GL_COMPRESSED_RGB8_ETC2;
+    }
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+//
+// Creates a texture object from the compressed levels of the image,
+// without decoding them. Returns NULL if the driver can't use the
+// data as is, for instance if the format isn't supported, or the image
+// would need to be resized.
+//
+SoGLDisplayList *
+SoGLImageP::createCompressedDL(SoState *state)
+{
+  const cc_glglue * glw = sogl_glue_instance(state);
+  const SbImage::CompressedFormat format = this->image->getCompressedFormat();
+  const GLenum internalformat = glimage_compressed_format(glw, format);
+  if (internalformat == 0) return NULL;
+  if (this->border != 0 || (this->flags & SoGLImage::RECTANGLE)) return NULL;
+  if (SoMultiTextureEnabledElement::getMode(state) ==
+      SoMultiTextureEnabledElement::TEXTURE3D) return NULL;
+
+  const int nc = SbImageCodec::getNumComponents(format);
+  const int numlevels = this->image->getNumCompressedLevels();
+  SbVec2s size;
+  size_t numbytes;
+  if (!this->image->getCompressedLevel(0, size, numbytes)) return NULL;
+
+  if (((size[0] & (size[0] - 1)) || (size[1] & (size[1] - 1))) &&
+      !SoGLDriverDatabase::isSupported(glw, SO_GL_NON_POWER_OF_TWO_TEXTURES)) {
+    return NULL;
+  }
+
+  // The mipmap levels in the image are used if present. An incomplete
+  // chain is clamped with GL_TEXTURE_MAX_LEVEL, which needs OpenGL
+  // 1.2. The compressed data can't be mipmapped by us, so the texture
+  // is used without mipmaps if there is only one level.
+  const SbBool mipmap = this->shouldCreateMipmap();
+  int maxlevels = 1;
+  for (int s = SbMax(size[0], size[1]); s > 1; s >>= 1) maxlevels++;
+  const SbBool canclamp = cc_glglue_glversion_matches_at_least(glw, 1, 2, 0);
+  int lastlevel = 0;
+  if (mipmap && numlevels > 1 && (numlevels >= maxlevels || canclamp)) {
+    lastlevel = numlevels - 1;
+  }
+
+  // skip the levels which are too large for OpenGL
+  const GLenum dataformat = coin_glglue_get_texture_format(glw, nc);
+  int firstlevel = 0;
+  while (!coin_glglue_is_texture_size_legal(glw, size[0], size[1], 0,
+                                            internalformat, dataformat,
+                                            GL_UNSIGNED_BYTE, lastlevel > 0)) {
+    if (firstlevel >= lastlevel) return NULL;
+    firstlevel++;
+    (void) this->image->getCompressedLevel(firstlevel, size, numbytes);
+  }
+
+  SoCacheElement::setInvalid(TRUE);
+  if (state->isCacheOpen()) {
+    SoCacheElement::invalidate(state);
+  }
+  // The texture object is flagged as mipmapped if mipmapping was
+  // requested, even if there are no mipmap levels. Otherwise
+  // getGLDisplayList() would keep recreating it.
+  SoGLDisplayList * dl = new SoGLDisplayList(state,
+                                             SoGLDisplayList::TEXTURE_OBJECT,
+                                             1, mipmap);
+  dl->ref();
+  dl->setTextureTarget((int) GL_TEXTURE_2D);
+  dl->open(state);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                  translate_wrap(state, this->wraps));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                  translate_wrap(state, this->wrapt));
+  if ((this->quality > COIN_TEX2_ANISOTROPIC_LIMIT) &&
+      SoGLDriverDatabase::isSupported(glw, SO_GL_ANISOTROPIC_FILTERING)) {
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                    cc_glglue_get_max_anisotropy(glw));
+  }
+
+  this->glsize = SbVec3s(size[0], size[1], 0);
+  this->glcomp = nc;
+  this->glbytes = 0;
+  for (int level = firstlevel; level <= lastlevel; level++) {
+    const unsigned char * data =
+      this->image->getCompressedLevel(level, size, numbytes);
+    cc_glglue_glCompressedTexImage2D(glw, GL_TEXTURE_2D, level - firstlevel,
+                                     internalformat, size[0], size[1], 0,
+                                     (GLsizei) numbytes, data);
+    this->glbytes += numbytes;
+  }
+  if (lastlevel > 0 && lastlevel < maxlevels - 1) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastlevel - firstlevel);
+  }
+  this->applyFilter(lastlevel > 0);
+
+  dl->close(state);
+  return dl;
+}
+
 void
 SoGLImageP::reallyBindPBuffer(SoState * state)
 {
@@ -1766,6 +2720,7 @@ SoGLImageP::reallyCreateTexture(SoState *state,
   const cc_glglue * glw = sogl_glue_instance(state);
   this->glsize = SbVec3s((short) w, (short) h, (short) d);
   this->glcomp = numComponents;
+  this->glbytes = 0;
 
   SbBool compress =
     (this->flags & SoGLImage::COMPRESSED) &&
@@ -1773,6 +2728,8 @@ SoGLImageP::reallyCreateTexture(SoState *state,
   GLint internalFormat =
     coin_glglue_get_internal_texture_format(glw, numComponents, compress);
   GLenum dataFormat = coin_glglue_get_texture_format(glw, numComponents);
+  // the OpenGL mipmap generation doesn't know the image is sRGB
+  const SbBool srgb = (this->flags & SoGLImage::SRGB_MIPMAP) != 0;
 
   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
@@ -1807,7 +2764,7 @@ SoGLImageP::reallyCreateTexture(SoState *state,
       //                                         w, h, d, dataFormat,
       //                                         GL_UNSIGNED_BYTE, texture);
 
-      fast_mipmap(state, w, h, d, numComponents, texture, FALSE, compress);
+      fast_mipmap(state, w, h, d, numComponents, texture, FALSE, compress, srgb);
     }
   }
   else { // 2D textures
@@ -1832,7 +2789,7 @@ SoGLImageP::reallyCreateTexture(SoState *state,
     }
     // prefer GL_SGIS_generate_mipmap to glGenerateMipmap. It seems to
     // be better supported in drivers.
-    else if (mipmap && SoGLDriverDatabase::isSupported(glw, "GL_SGIS_generate_mipmap")) {
+    else if (mipmap && !srgb && SoGLDriverDatabase::isSupported(glw, "GL_SGIS_generate_mipmap")) {
       glTexParameteri(target, GL_GENERATE_MIPMAP_SGIS, GL_TRUE);
       mipmapimage = FALSE;
     }
@@ -1840,7 +2797,7 @@ SoGLImageP::reallyCreateTexture(SoState *state,
     // supported (even if the display list is never used). This is
     // probably because the OpenGL driver creates each mipmap level by
     // rendering it using normal OpenGL calls.
-    else if (mipmap && SoGLDriverDatabase::isSupported(glw, SO_GL_GENERATE_MIPMAP) && !state->isCacheOpen()) {
+    else if (mipmap && !srgb && SoGLDriverDatabase::isSupported(glw, SO_GL_GENERATE_MIPMAP) && !state->isCacheOpen()) {
       mipmapimage = FALSE;
       generatemipmap = TRUE; // delay until after the texture image is set up
     }
@@ -1877,7 +2834,7 @@ SoGLImageP::reallyCreateTexture(SoState *state,
       //   (void)GLUWrapper()->gluBuild2DMipmaps(GL_TEXTURE_2D, internalFormat,
       //                                         w, h, dataFormat,
       //                                         GL_UNSIGNED_BYTE, texture);
-      fast_mipmap(state, w, h, numComponents, texture, FALSE, compress);
+      fast_mipmap(state, w, h, numComponents, texture, FALSE, compress, srgb);
     }
     // apply the texture filters
     this->applyFilter(mipmapfilter);
@@ -1885,6 +2842,303 @@ SoGLImageP::reallyCreateTexture(SoState *state,
   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
+//
+// Returns TRUE if the image should be mipmapped in the background
+// when it is used in \a state.
+//
+SbBool
+SoGLImageP::useBackgroundMipmaps(SoState * state)
+{
+  if (!(this->flags & SoGLImage::BACKGROUND_MIPMAP)) return FALSE;
+  if (this->pbuffer || !this->image || this->border != 0) return FALSE;
+  // compressed images have their mipmaps precomputed, or can't have any
+  if (this->image->getCompressedFormat() != SbImage::UNCOMPRESSED) return FALSE;
+  if ((this->flags & SoGLImage::RECTANGLE) || SoGLImageP::resizecb) return FALSE;
+
+  SbVec3s size;
+  int numcomponents;
+  const unsigned char * bytes = this->image->getValue(size, numcomponents);
+  if (!bytes || size[0] == 0 || size[1] == 0 || size[2] != 0) return FALSE;
+  if (SoMultiTextureEnabledElement::getMode(state) ==
+      SoMultiTextureEnabledElement::TEXTURE3D) return FALSE;
+
+  if (!this->shouldCreateMipmap()) {
+    // the texture quality might have increased since the data was set
+    const float oldquality = this->quality;
+    this->quality = SoTextureQualityElement::get(state);
+    if (!this->shouldCreateMipmap()) {
+      this->quality = oldquality;
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+//
+// Returns the texture object for a BACKGROUND_MIPMAP image. Starts
+// building the mipmaps, creates a placeholder texture while they are
+// being built, and uploads the mipmap levels when they are done.
+//
+SoGLDisplayList *
+SoGLImageP::getBackgroundDL(SoState * state)
+{
+  SoGLDisplayList * dl = NULL;
+  int firstlevel = 0;
+  int pendinglevels = 0;
+
+  LOCK_GLIMAGE;
+  if (this->mipmaps == NULL) {
+    SbVec3s size;
+    int nc;
+    const unsigned char * bytes = this->image->getValue(size, nc);
+    uint32_t xsize = size[0];
+    uint32_t ysize = size[1];
+    uint32_t zsize = 0;
+    this->computePowerOfTwoSize(xsize, ysize, zsize);
+
+    soglimage_mipmaps * mipmaps = new soglimage_mipmaps;
+    mipmaps->sourcewidth = size[0];
+    mipmaps->sourceheight = size[1];
+    mipmaps->nc = nc;
+    mipmaps->width = (int) xsize;
+    mipmaps->height = (int) ysize;
+    mipmaps->highquality = SoTextureScaleQualityElement::get(state) >= 0.5f;
+    mipmaps->srgb = (this->flags & SoGLImage::SRGB_MIPMAP) != 0;
+    const size_t numbytes = size_t(size[0]) * size_t(size[1]) * nc;
+    mipmaps->source = new unsigned char[numbytes];
+    (void)memcpy(mipmaps->source, bytes, numbytes);
+    this->mipmaps = mipmaps;
+    SoTextureScheduler::schedule(glimage_mipmaps_job, mipmaps);
+  }
+  const SbBool done = this->mipmaps->done;
+  const int currcontext = SoGLCacheContextElement::get(state);
+  const int n = this->dlists.getLength();
+  for (int i = 0; i < n; i++) {
+    if (this->dlists[i].dlist->getContext() == currcontext) {
+      dl = this->dlists[i].dlist;
+      firstlevel = this->dlists[i].firstlevel;
+      pendinglevels = this->dlists[i].pendinglevels;
+      break;
+    }
+  }
+  UNLOCK_GLIMAGE;
+
+  if (dl && pendinglevels == 0 && dl->isMipMapTextureObject()) return dl;
+
+  if (dl && pendinglevels > 0) {
+    // keep the caches from being built until the texture is complete
+    SoCacheElement::setInvalid(TRUE);
+    if (state->isCacheOpen()) {
+      SoCacheElement::invalidate(state);
+    }
+    dl->call(state); // bind the texture object
+    const int numlevels = this->mipmaps->numlevels - firstlevel;
+    this->uploadMipmapLevels(state, firstlevel, numlevels, pendinglevels);
+
+    LOCK_GLIMAGE;
+    for (int i = 0; i < this->dlists.getLength(); i++) {
+      if (this->dlists[i].dlist == dl) {
+        this->dlists[i].pendinglevels = pendinglevels;
+        break;
+      }
+    }
+    UNLOCK_GLIMAGE;
+    return dl;
+  }
+
+  // dl is NULL, a placeholder, or a texture object without mipmaps
+  if (!done) {
+    if (dl) return dl;
+    dl = this->createPlaceholderDL(state);
+    LOCK_GLIMAGE;
+    SoGLImageP::dldata data(dl, this->addResource(dl));
+    data.pendinglevels = -1;
+    this->dlists.append(data);
+    UNLOCK_GLIMAGE;
+    return dl;
+  }
+
+  SoGLDisplayList * newdl = this->createMipmapDL(state, firstlevel, pendinglevels);
+  SoGLImageP::dldata data(newdl, this->addResource(newdl));
+  data.firstlevel = firstlevel;
+  data.pendinglevels = pendinglevels;
+
+  LOCK_GLIMAGE;
+  int idx = -1;
+  for (int i = 0; dl && i < this->dlists.getLength(); i++) {
+    if (this->dlists[i].dlist == dl) { idx = i; break; }
+  }
+  if (idx >= 0) {
+    dl->unref(state);
+    SoGLResourceManagerP::remove(this->dlists[idx].resid);
+    this->dlists[idx] = data;
+  }
+  else {
+    this->dlists.append(data);
+  }
+  UNLOCK_GLIMAGE;
+  return newdl;
+}
+
+//
+// Creates a single texel texture with the average color of some
+// texels spread over the image.
+//
+SoGLDisplayList *
+SoGLImageP::createPlaceholderDL(SoState * state)
+{
+  SbVec3s size;
+  int nc;
+  const unsigned char * bytes = this->image->getValue(size, nc);
+
+  const int numsamples = 8;
+  unsigned int sum[4] = { 0, 0, 0, 0 };
+  for (int y = 0; y < numsamples; y++) {
+    const int iy = ((size[1] - 1) * y) / (numsamples - 1);
+    for (int x = 0; x < numsamples; x++) {
+      const int ix = ((size[0] - 1) * x) / (numsamples - 1);
+      const unsigned char * texel = bytes + (size_t(iy) * size[0] + ix) * nc;
+      for (int c = 0; c < nc; c++) sum[c] += texel[c];
+    }
+  }
+  unsigned char texel[4];
+  for (int c = 0; c < nc; c++) {
+    texel[c] = (unsigned char) (sum[c] / (numsamples * numsamples));
+  }
+
+  SoCacheElement::setInvalid(TRUE);
+  if (state->isCacheOpen()) {
+    SoCacheElement::invalidate(state);
+  }
+  SoGLDisplayList * dl = new SoGLDisplayList(state,
+                                             SoGLDisplayList::TEXTURE_OBJECT,
+                                             1, FALSE);
+  dl->ref();
+  dl->setTextureTarget((int) GL_TEXTURE_2D);
+  dl->open(state);
+  this->reallyCreateTexture(state, texel, nc, 1, 1, 0,
+                            FALSE, FALSE, 0);
+  dl->close(state);
+  return dl;
+}
+
+//
+// Creates a mipmapped texture object from the mipmaps built in the
+// background, and uploads as many levels as the budget allows,
+// starting with the smallest one.
+//
+SoGLDisplayList *
+SoGLImageP::createMipmapDL(SoState * state, int & firstlevel, int & pendinglevels)
+{
+  const cc_glglue * glw = sogl_glue_instance(state);
+  const soglimage_mipmaps * mipmaps = this->mipmaps;
+  SbBool compress =
+    (this->flags & SoGLImage::COMPRESSED) &&
+    SoGLDriverDatabase::isSupported(glw, SO_GL_TEXTURE_COMPRESSION);
+  GLint internalformat =
+    coin_glglue_get_internal_texture_format(glw, mipmaps->nc, compress);
+  GLenum format = coin_glglue_get_texture_format(glw, mipmaps->nc);
+
+  // skip the levels which are too large for OpenGL
+  firstlevel = 0;
+  while (firstlevel < mipmaps->numlevels - 1 &&
+         !coin_glglue_is_texture_size_legal(glw,
+                                            mipmaps->getWidth(firstlevel),
+                                            mipmaps->getHeight(firstlevel),
+                                            0, internalformat, format,
+                                            GL_UNSIGNED_BYTE, TRUE)) {
+    firstlevel++;
+  }
+  this->glsize = SbVec3s((short) mipmaps->getWidth(firstlevel),
+                         (short) mipmaps->getHeight(firstlevel), 0);
+  this->glcomp = mipmaps->nc;
+  this->glbytes = 0;
+
+  SoCacheElement::setInvalid(TRUE);
+  if (state->isCacheOpen()) {
+    SoCacheElement::invalidate(state);
+  }
+  SoGLDisplayList * dl = new SoGLDisplayList(state,
+                                             SoGLDisplayList::TEXTURE_OBJECT,
+                                             1, TRUE);
+  dl->ref();
+  dl->setTextureTarget((int) GL_TEXTURE_2D);
+  dl->open(state);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                  translate_wrap(state, this->wraps));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                  translate_wrap(state, this->wrapt));
+  if ((this->quality > COIN_TEX2_ANISOTROPIC_LIMIT) &&
+      SoGLDriverDatabase::isSupported(glw, SO_GL_ANISOTROPIC_FILTERING)) {
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                    cc_glglue_get_max_anisotropy(glw));
+  }
+  this->applyFilter(TRUE);
+
+  const int numlevels = mipmaps->numlevels - firstlevel;
+  if (cc_glglue_glversion_matches_at_least(glw, 1, 2, 0)) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numlevels - 1);
+  }
+  pendinglevels = numlevels;
+  this->uploadMipmapLevels(state, firstlevel, numlevels, pendinglevels);
+  dl->close(state);
+  return dl;
+}
+
+//
+// Uploads mipmap levels to the bound texture object, from level
+// pendinglevels-1 and down, until the upload budget for the frame is
+// used. The smallest level is always uploaded. Without OpenGL 1.2
+// the base level can not be set, and all levels are uploaded at
+// once.
+//
+void
+SoGLImageP::uploadMipmapLevels(SoState * state, const int firstlevel,
+                               const int numlevels, int & pendinglevels)
+{
+  const cc_glglue * glw = sogl_glue_instance(state);
+  const soglimage_mipmaps * mipmaps = this->mipmaps;
+  const SbBool baselevel = cc_glglue_glversion_matches_at_least(glw, 1, 2, 0);
+  SbBool compress =
+    (this->flags & SoGLImage::COMPRESSED) &&
+    SoGLDriverDatabase::isSupported(glw, SO_GL_TEXTURE_COMPRESSION);
+  GLint internalformat =
+    coin_glglue_get_internal_texture_format(glw, mipmaps->nc, compress);
+  GLenum format = coin_glglue_get_texture_format(glw, mipmaps->nc);
+  const uint32_t contextid = SoGLCacheContextElement::get(state);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  while (pendinglevels > 0) {
+    const int level = firstlevel + pendinglevels - 1;
+    if (!SoGLResourceManagerP::reserveUpload(contextid, mipmaps->getNumBytes(level)) &&
+        baselevel && pendinglevels < numlevels) break;
+    glTexImage2D(GL_TEXTURE_2D, pendinglevels - 1, internalformat,
+                 mipmaps->getWidth(level), mipmaps->getHeight(level), 0,
+                 format, GL_UNSIGNED_BYTE, mipmaps->getLevel(level));
+    pendinglevels--;
+  }
+  if (baselevel) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, pendinglevels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+//
+// Releases the mipmaps built in the background. A job still building
+// them will delete them when it is done.
+//
+void
+SoGLImageP::releaseMipmaps(void)
+{
+  LOCK_GLIMAGE;
+  soglimage_mipmaps * mipmaps = this->mipmaps;
+  this->mipmaps = NULL;
+  const SbBool unused = mipmaps && (--mipmaps->refcount == 0);
+  UNLOCK_GLIMAGE;
+  if (unused) delete mipmaps;
+}
+
 //
 // unref all dlists stored in image
 //
@@ -1894,8 +3148,43 @@ SoGLImageP::unrefDLists(SoState *state)
   int n = this->dlists.getLength();
   for (int i = 0; i < n; i++) {
     this->dlists[i].dlist->unref(state);
+    SoGLResourceManagerP::remove(this->dlists[i].resid);
   }
   this->dlists.truncate(0);
+  this->releaseMipmaps();
+}
+
+// register a texture object with SoGLResourceManager
+uint32_t
+SoGLImageP::addResource(SoGLDisplayList *dl)
+{
+  size_t size =
+    size_t(this->glsize[0]) * size_t(this->glsize[1]) *
+    size_t(SbMax(this->glsize[2], (short) 1)) * size_t(this->glcomp);
+  // the mipmap levels add up to a third of the base level
+  if (dl->isMipMapTextureObject()) size += size / 3;
+  // compressed textures know their exact size
+  if (this->glbytes) size = this->glbytes;
+  return SoGLResourceManagerP::add(dl->getContext(), SoGLResourceManager::TEXTURE,
+                                   size, SoGLImageP::evictCB, this);
+}
+
+// Callback from SoGLResourceManager. The texture object will be
+// recreated the next time the image is used in the context.
+void
+SoGLImageP::evictCB(void *closure, const uint32_t contextid, SoState *state)
+{
+  SoGLImageP * thisp = (SoGLImageP *) closure;
+  LOCK_GLIMAGE;
+  int n = thisp->dlists.getLength();
+  for (int i = 0; i < n; i++) {
+    if (thisp->dlists[i].dlist->getContext() == (int) contextid) {
+      thisp->dlists[i].dlist->unref(state);
+      thisp->dlists.removeFast(i);
+      break;
+    }
+  }
+  UNLOCK_GLIMAGE;
 }
 
 // find dl for a context, NULL if not found
@@ -1922,6 +3211,7 @@ SoGLImageP::tagDL(SoState *state)
     dl = this->dlists[i].dlist;
     if (dl->getContext() == currcontext) {
       this->dlists[i].age = 0;
+      SoGLResourceManagerP::touch(this->dlists[i].resid, state);
       break;
     }
   }
@@ -1954,6 +3244,7 @@ SoGLImageP::unrefOldDL(SoState *state, const uint32_t maxage)
                              this->owner);
 #endif // debug
       data.dlist->unref(state);
+      SoGLResourceManagerP::remove(data.resid);
       this->dlists.removeFast(i);
       n--; // one less in list now
     }
@@ -2234,6 +3525,7 @@ SoGLImageP::contextCleanup(uint32_t context, void * closure)
   while (i < n) {
     if (thisp->dlists[i].dlist->getContext() == (int) context) {
       thisp->dlists[i].dlist->unref(NULL);
+      SoGLResourceManagerP::remove(thisp->dlists[i].resid);
       thisp->dlists.remove(i);
       n--;
     }
@@ -2249,3 +3541,203 @@ SoGLImageP::contextCleanup(uint32_t context, void * closure)
 #undef PRIVATE
 #undef LOCK_GLIMAGE
 #undef UNLOCK_GLIMAGE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SbVec3s.h>
+#include <Inventor/misc/SoGLImage.h>
+#include <vector>
+#include <cstring>
+
+// The plain loops SoGLImage used before the kernels were vectorized,
+// used as references for the results.
+
+static void
+test_halve_reference(const int width, const int height, const int depth,
+                     const int nc, const unsigned char * src,
+                     unsigned char * dst)
+{
+  const int rowsize = width * nc;
+  const int imagesize = width * height * nc;
+  if (depth <= 1) {
+    for (int i = 0; i < height / 2; i++) {
+      for (int j = 0; j < width / 2; j++) {
+        for (int c = 0; c < nc; c++) {
+          *dst++ = (src[0] + src[nc] + src[rowsize] + src[rowsize+nc] + 2) >> 2;
+          src++;
+        }
+        src += nc;
+      }
+      src += rowsize;
+    }
+    return;
+  }
+  for (int k = 0; k < depth / 2; k++) {
+    for (int j = 0; j < height / 2; j++) {
+      for (int i = 0; i < width / 2; i++) {
+        for (int c = 0; c < nc; c++) {
+          *dst++ = (src[0] + src[nc] +
+                    src[rowsize] + src[rowsize+nc] +
+                    src[imagesize] + src[imagesize+nc] +
+                    src[imagesize+rowsize] + src[imagesize+rowsize+nc] +
+                    4) >> 3;
+          src++;
+        }
+        src += nc;
+      }
+      src += rowsize;
+    }
+    src += imagesize;
+  }
+}
+
+static void
+test_resize_reference(const unsigned char * src, unsigned char * dest,
+                      int width, int height, int nc, int layers,
+                      int newwidth, int newheight, int newlayers)
+{
+  float dx = ((float)width)/((float)newwidth);
+  float dy = ((float)height)/((float)newheight);
+  float dz = ((float)layers)/((float)newlayers);
+  int src_bpr = width * nc;
+  int src_bpl = src_bpr * height;
+  float sz = 0.0f;
+  for (int z = 0; z < newlayers; z++) {
+    float sy = 0.0f;
+    for (int y = 0; y < newheight; y++) {
+      float sx = 0.0f;
+      for (int x = 0; x < newwidth; x++) {
+        int offset = ((int)sz)*src_bpl + ((int)sy)*src_bpr + ((int)sx)*nc;
+        for (int i = 0; i < nc; i++) *dest++ = src[offset+i];
+        sx += dx;
+      }
+      sy += dy;
+    }
+    sz += dz;
+  }
+}
+
+static std::vector<unsigned char>
+test_random_image(const int numbytes)
+{
+  std::vector<unsigned char> image(numbytes);
+  unsigned int seed = 12345;
+  for (int i = 0; i < numbytes; i++) {
+    seed = seed * 1103515245 + 12345;
+    image[i] = (unsigned char) (seed >> 16);
+  }
+  return image;
+}
+
+BOOST_AUTO_TEST_CASE(halveImage)
+{
+  const short sizes[][3] = {
+    { 256, 128, 1 }, { 8, 4, 1 }, { 2, 64, 1 }, { 64, 32, 8 }, { 4, 2, 2 }
+  };
+  for (int s = 0; s < 5; s++) {
+    const SbVec3s size(sizes[s][0], sizes[s][1], sizes[s][2]);
+    for (int nc = 1; nc <= 4; nc++) {
+      const int numbytes = size[0] * size[1] * size[2] * nc;
+      std::vector<unsigned char> src = test_random_image(numbytes);
+      std::vector<unsigned char> expected(numbytes / 4 + 1, 0);
+      std::vector<unsigned char> result(numbytes / 4 + 1, 0);
+      test_halve_reference(size[0], size[1], size[2], nc, &src[0], &expected[0]);
+      SoGLImage::halveImage(&src[0], size, nc, &result[0]);
+      BOOST_CHECK_MESSAGE(expected == result,
+                          "mipmap level differs from the reference");
+    }
+  }
+}
+
+#ifdef COIN_INT_TEST_SUITE
+
+#include "../src/rendering/SoGLImageKernels.h"
+
+BOOST_AUTO_TEST_CASE(halveRowKernels)
+{
+  // widths around the 16 and 32 byte blocks, to cover the scalar tails
+  const int widths[] = { 1, 3, 7, 8, 9, 16, 17, 31, 33, 64, 100 };
+  int numkernels = 0;
+  for (int k = 0; ; k++) {
+    const char * name = NULL;
+    for (int numrows = 2; numrows <= 4; numrows += 2) {
+      for (int nc = 1; nc <= 4; nc++) {
+        for (int w = 0; w < 11; w++) {
+          const int num = widths[w];
+          std::vector<unsigned char> src = test_random_image(numrows * num * 2 * nc);
+          const unsigned char * rows[4];
+          for (int r = 0; r < numrows; r++) rows[r] = &src[r * num * 2 * nc];
+
+          std::vector<unsigned char> expected(num * nc);
+          for (int i = 0; i < num * nc; i++) {
+            const int p = (i / nc) * 2 * nc + (i % nc);
+            int sum = numrows;
+            for (int r = 0; r < numrows; r++) sum += rows[r][p] + rows[r][p + nc];
+            expected[i] = (unsigned char) (sum / (numrows * 2));
+          }
+          // an extra byte to catch writes past the row
+          std::vector<unsigned char> result(num * nc + 1, 0xcd);
+          name = coin_glimage_halve_rows(k, rows, numrows, nc, num, &result[0]);
+          if (name == NULL) break;
+          BOOST_CHECK_MESSAGE(std::memcmp(&expected[0], &result[0], num * nc) == 0 &&
+                              result[num * nc] == 0xcd,
+                              "the " << name << " halve_image() kernel differs from " <<
+                              "the reference for " << numrows << " rows, " << nc <<
+                              " components and " << num << " pixels");
+        }
+      }
+    }
+    if (name == NULL) break;
+    numkernels++;
+  }
+  // the plain C++ kernel is always there
+  BOOST_CHECK(numkernels >= 1);
+}
+
+#endif // COIN_INT_TEST_SUITE
+
+BOOST_AUTO_TEST_CASE(halveImageSRGB)
+{
+  // a black and white checker board with alternating alpha
+  unsigned char src[2 * 2 * 4] = {
+    0, 0, 0, 0,  255, 255, 255, 255,
+    255, 255, 255, 255,  0, 0, 0, 0
+  };
+  unsigned char dst[4];
+  SoGLImage::halveImage(src, SbVec3s(2, 2, 1), 4, dst, FALSE);
+  BOOST_CHECK_EQUAL(int(dst[0]), 128);
+  SoGLImage::halveImage(src, SbVec3s(2, 2, 1), 4, dst, TRUE);
+  // linear 0.5 is 187.5 in sRGB
+  BOOST_CHECK_MESSAGE(dst[0] >= 187 && dst[0] <= 188 && dst[2] == dst[0],
+                      "colors not averaged in linear space");
+  BOOST_CHECK_EQUAL(int(dst[3]), 128);
+}
+
+BOOST_AUTO_TEST_CASE(resizeImage)
+{
+  const short sizes[][6] = {
+    { 300, 200, 1, 512, 256, 1 },
+    { 1000, 700, 1, 256, 512, 1 },
+    { 5, 3, 1, 64, 64, 1 },
+    { 10, 12, 7, 16, 16, 8 },
+    { 64, 64, 64, 16, 32, 8 }
+  };
+  for (int s = 0; s < 5; s++) {
+    const SbVec3s size(sizes[s][0], sizes[s][1], sizes[s][2]);
+    const SbVec3s newsize(sizes[s][3], sizes[s][4], sizes[s][5]);
+    for (int nc = 1; nc <= 4; nc++) {
+      std::vector<unsigned char> src =
+        test_random_image(size[0] * size[1] * size[2] * nc);
+      const int numbytes = newsize[0] * newsize[1] * newsize[2] * nc;
+      std::vector<unsigned char> expected(numbytes, 0);
+      std::vector<unsigned char> result(numbytes, 0);
+      test_resize_reference(&src[0], &expected[0], size[0], size[1], nc,
+                            size[2], newsize[0], newsize[1], newsize[2]);
+      SoGLImage::resizeImage(&src[0], size, nc, &result[0], newsize);
+      BOOST_CHECK_MESSAGE(expected == result,
+                          "resized image differs from the reference");
+    }
+  }
+}
+
+#endif // COIN_TEST_SUITE
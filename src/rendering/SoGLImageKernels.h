@@ -0,0 +1,39 @@
+#ifndef COIN_SOGLIMAGEKERNELS_H
+#define COIN_SOGLIMAGEKERNELS_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// This header does not check for COIN_INTERNAL, so that the internal
+// test suite can include it.
+
+// Runs kernel number 'kernel' of the SoGLImage::halveImage() row
+// kernels which are compiled in and supported by the CPU, on numrows
+// (2 or 4) rows of 2 * num pixels. Returns the name of the kernel, or
+// NULL if there is no such kernel.
+const char * coin_glimage_halve_rows(const int kernel,
+                                     const unsigned char * const * rows,
+                                     const int numrows, const int nc,
+                                     const int num, unsigned char * dst);
+
+#endif // !COIN_SOGLIMAGEKERNELS_H
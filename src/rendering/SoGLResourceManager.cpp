@@ -0,0 +1,899 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+/*!
+  \class SoGLResourceManager Inventor/misc/SoGLResourceManager.h
+  \brief The SoGLResourceManager class keeps OpenGL memory usage within a budget.
+  \ingroup general
+
+  Render caches (SoGLRenderCache), texture objects (SoGLImage) and
+  vertex buffer objects are registered with the resource manager
+  when they are created for an OpenGL context, together with an
+  estimate of the memory they use. Each time a resource is used, it
+  is moved to the front of a least recently used list for its
+  context.
+
+  At the end of each SoGLRenderAction traversal, resources which
+  were not used during that traversal are evicted, least recently
+  used first, until the memory used in the context is within the
+  budget set with setMemoryBudget(). Evicted resources are recreated
+  from the data in the scene graph the next time they are needed, so
+  eviction only affects performance, not what is rendered.
+
+  Texture objects which are referenced by a render cache are kept
+  alive as long as the render cache is used. If such a texture object
+  is evicted, the render caches referencing it are evicted as well.
+
+  The memory used by buffer objects and texture objects is calculated
+  from the data sent to OpenGL. The memory used by display lists can
+  not be queried from OpenGL, and is estimated from the number of
+  coordinates available to the shapes recorded into the display
+  list.
+
+  The default budget is 0, which means no limit. It can also be set
+  using the environment variable \c COIN_GL_MEMORY_BUDGET, in
+  megabytes.
+
+  Texture data which is prepared in the background (see
+  SoGLImage::BACKGROUND_MIPMAP) is sent to OpenGL a few mipmap levels
+  at a time, limited by the upload budget set with setUploadBudget().
+
+  \since Coin 4.0
+*/
+
+/*!
+  \enum SoGLResourceManager::ResourceType
+
+  The kinds of OpenGL resources tracked by the resource manager.
+*/
+/*!
+  \var SoGLResourceManager::ResourceType SoGLResourceManager::RENDER_CACHE
+  Render caches created by SoSeparator nodes.
+*/
+/*!
+  \var SoGLResourceManager::ResourceType SoGLResourceManager::TEXTURE
+  Texture objects created by SoGLImage.
+*/
+/*!
+  \var SoGLResourceManager::ResourceType SoGLResourceManager::BUFFER_OBJECT
+  Vertex buffer objects.
+*/
+
+// *************************************************************************
+
+#include <Inventor/misc/SoGLResourceManager.h>
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/errors/SoDebugError.h>
+#include <Inventor/elements/SoCacheElement.h>
+#include <Inventor/elements/SoGLCacheContextElement.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/misc/SoContextHandler.h>
+#include <Inventor/misc/SoState.h>
+
+#include "rendering/SoGLResourceManagerP.h"
+#include "caches/SoGLRenderCacheP.h"
+#include "misc/SbHash.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+#define SOGLRESOURCE_NUMTYPES 3
+
+class soglresource_entry {
+public:
+  uint32_t id;
+  uint32_t contextid;
+  SoGLResourceManager::ResourceType type;
+  size_t size;
+  SoGLResourceManagerP::EvictCB * cb;
+  void * closure;
+  uint32_t lastframe;
+  uint32_t owner; // render cache deleting this resource, or 0
+
+  // LRU list, most recently used first
+  soglresource_entry * prev;
+  soglresource_entry * next;
+
+  // render caches replaying this resource, and resources replayed
+  // by this render cache
+  SbList <uint32_t> parents;
+  SbList <uint32_t> children;
+};
+
+class soglresource_context {
+public:
+  soglresource_context(void)
+    : first(NULL), last(NULL), frame(1), numevicted(0), uploaded(0) {
+    for (int i = 0; i < SOGLRESOURCE_NUMTYPES; i++) {
+      this->usage[i] = 0;
+      this->num[i] = 0;
+    }
+  }
+  size_t getUsage(void) const {
+    size_t sum = 0;
+    for (int i = 0; i < SOGLRESOURCE_NUMTYPES; i++) sum += this->usage[i];
+    return sum;
+  }
+
+  soglresource_entry * first;
+  soglresource_entry * last;
+  uint32_t frame;
+  int numevicted;
+  size_t uploaded; // bytes uploaded in the current frame
+  size_t usage[SOGLRESOURCE_NUMTYPES];
+  int num[SOGLRESOURCE_NUMTYPES];
+};
+
+// an evicted resource, for invoking the callback outside the lock
+typedef struct {
+  SoGLResourceManagerP::EvictCB * cb;
+  void * closure;
+  uint32_t contextid;
+} soglresource_victim;
+
+static SbHash <uint32_t, soglresource_entry *> * soglresource_entries = NULL;
+static SbHash <uint32_t, soglresource_context *> * soglresource_contexts = NULL;
+static uint32_t soglresource_nextid = 1;
+static size_t soglresource_budget = 0;
+static SbBool soglresource_budgetinit = FALSE;
+static size_t soglresource_uploadbudget = 0;
+static SbBool soglresource_uploadbudgetinit = FALSE;
+static void * soglresource_mutex = NULL;
+
+static void soglresource_context_destruction(uint32_t contextid, void * closure);
+
+static void
+soglresource_cleanup(void)
+{
+  if (soglresource_entries) {
+    for (SbHash <uint32_t, soglresource_entry *>::const_iterator iter =
+           soglresource_entries->const_begin();
+         iter != soglresource_entries->const_end(); ++iter) {
+      delete iter->obj;
+    }
+  }
+  if (soglresource_contexts) {
+    for (SbHash <uint32_t, soglresource_context *>::const_iterator iter =
+           soglresource_contexts->const_begin();
+         iter != soglresource_contexts->const_end(); ++iter) {
+      delete iter->obj;
+    }
+  }
+  delete soglresource_entries;
+  delete soglresource_contexts;
+  soglresource_entries = NULL;
+  soglresource_contexts = NULL;
+  soglresource_nextid = 1;
+  soglresource_budget = 0;
+  soglresource_budgetinit = FALSE;
+  soglresource_uploadbudget = 0;
+  soglresource_uploadbudgetinit = FALSE;
+  CC_MUTEX_DESTRUCT(soglresource_mutex);
+}
+
+// must be called with the mutex locked
+static void
+soglresource_init(void)
+{
+  if (soglresource_entries == NULL) {
+    soglresource_entries = new SbHash <uint32_t, soglresource_entry *>;
+    soglresource_contexts = new SbHash <uint32_t, soglresource_context *>(16);
+    SoContextHandler::addContextDestructionCallback(soglresource_context_destruction, NULL);
+    coin_atexit(soglresource_cleanup, CC_ATEXIT_NORMAL);
+  }
+}
+
+static void
+soglresource_lock(void)
+{
+  CC_MUTEX_CONSTRUCT(soglresource_mutex);
+  CC_MUTEX_LOCK(soglresource_mutex);
+  soglresource_init();
+}
+
+static void
+soglresource_unlock(void)
+{
+  CC_MUTEX_UNLOCK(soglresource_mutex);
+}
+
+static soglresource_context *
+soglresource_get_context(const uint32_t contextid, const SbBool create)
+{
+  soglresource_context * ctx = NULL;
+  if (!soglresource_contexts->get(contextid, ctx) && create) {
+    ctx = new soglresource_context;
+    soglresource_contexts->put(contextid, ctx);
+  }
+  return ctx;
+}
+
+static void
+soglresource_unlink(soglresource_context * ctx, soglresource_entry * entry)
+{
+  if (entry->prev) entry->prev->next = entry->next;
+  else ctx->first = entry->next;
+  if (entry->next) entry->next->prev = entry->prev;
+  else ctx->last = entry->prev;
+  entry->prev = entry->next = NULL;
+}
+
+static void
+soglresource_link_first(soglresource_context * ctx, soglresource_entry * entry)
+{
+  entry->prev = NULL;
+  entry->next = ctx->first;
+  if (ctx->first) ctx->first->prev = entry;
+  else ctx->last = entry;
+  ctx->first = entry;
+}
+
+// Removes the entry with \a id, and all render caches depending on
+// it. If \a victims is not NULL, the resources owned by the entry are
+// removed too, and the evict callbacks of the removed entries are
+// appended to it, owned resources before their owners.
+static void
+soglresource_remove(const uint32_t id, SbList <soglresource_victim> * victims)
+{
+  soglresource_entry * entry;
+  if (!soglresource_entries->get(id, entry)) return;
+  soglresource_entries->erase(id);
+
+  soglresource_context * ctx = soglresource_get_context(entry->contextid, FALSE);
+  assert(ctx);
+  soglresource_unlink(ctx, entry);
+  ctx->usage[entry->type] -= entry->size;
+  ctx->num[entry->type]--;
+
+  int i;
+  soglresource_entry * other;
+  if (victims) {
+    // the resources owned by this entry are deleted by its callback,
+    // so theirs must be called first
+    for (i = 0; i < entry->children.getLength(); i++) {
+      if (soglresource_entries->get(entry->children[i], other) &&
+          other->owner == id) {
+        soglresource_remove(entry->children[i], victims);
+      }
+    }
+
+    soglresource_victim victim;
+    victim.cb = entry->cb;
+    victim.closure = entry->closure;
+    victim.contextid = entry->contextid;
+    victims->append(victim);
+    ctx->numevicted++;
+  }
+
+  for (i = 0; i < entry->children.getLength(); i++) {
+    if (soglresource_entries->get(entry->children[i], other)) {
+      int idx = other->parents.find(id);
+      if (idx >= 0) other->parents.removeFast(idx);
+      if (other->owner == id) other->owner = 0;
+    }
+  }
+  // the render caches replaying an evicted resource must be evicted too
+  for (i = 0; i < entry->parents.getLength(); i++) {
+    if (victims) {
+      soglresource_remove(entry->parents[i], victims);
+    }
+    else if (soglresource_entries->get(entry->parents[i], other)) {
+      int idx = other->children.find(id);
+      if (idx >= 0) other->children.removeFast(idx);
+    }
+  }
+  delete entry;
+}
+
+static void
+soglresource_touch(soglresource_entry * entry)
+{
+  soglresource_context * ctx = soglresource_get_context(entry->contextid, FALSE);
+  assert(ctx);
+  if (entry->lastframe == ctx->frame && ctx->first == entry) return;
+  const SbBool touched = entry->lastframe == ctx->frame;
+  entry->lastframe = ctx->frame;
+  soglresource_unlink(ctx, entry);
+  soglresource_link_first(ctx, entry);
+
+  if (!touched) {
+    // the resources replayed by a render cache are used along with it
+    for (int i = 0; i < entry->children.getLength(); i++) {
+      soglresource_entry * child;
+      if (soglresource_entries->get(entry->children[i], child)) {
+        soglresource_touch(child);
+      }
+    }
+  }
+}
+
+static void
+soglresource_evict(SbList <soglresource_victim> & victims, SoState * state)
+{
+  for (int i = 0; i < victims.getLength(); i++) {
+    if (victims[i].cb) {
+      victims[i].cb(victims[i].closure, victims[i].contextid, state);
+    }
+  }
+}
+
+static void
+soglresource_context_destruction(uint32_t contextid, void * closure)
+{
+  // The owners free their resources for the context in their own
+  // callbacks. Remove whatever is left.
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  if (ctx) {
+    while (ctx->first) soglresource_remove(ctx->first->id, NULL);
+    soglresource_contexts->erase(contextid);
+    delete ctx;
+  }
+  soglresource_unlock();
+}
+
+// *************************************************************************
+
+/*!
+  Sets the maximum number of bytes of OpenGL memory to use in each
+  context. Resources will be evicted at the end of the next
+  SoGLRenderAction traversal if the budget is exceeded. 0 means no
+  limit.
+*/
+void
+SoGLResourceManager::setMemoryBudget(const size_t bytes)
+{
+  soglresource_lock();
+  soglresource_budget = bytes;
+  soglresource_budgetinit = TRUE;
+  soglresource_unlock();
+}
+
+/*!
+  Returns the maximum number of bytes of OpenGL memory to use in each
+  context.
+*/
+size_t
+SoGLResourceManager::getMemoryBudget(void)
+{
+  soglresource_lock();
+  if (!soglresource_budgetinit) {
+    soglresource_budgetinit = TRUE;
+    const char * env = coin_getenv("COIN_GL_MEMORY_BUDGET");
+    if (env) soglresource_budget = size_t(atoi(env)) * 1024 * 1024;
+  }
+  const size_t budget = soglresource_budget;
+  soglresource_unlock();
+  return budget;
+}
+
+/*!
+  Sets the maximum number of bytes of texture data to send to OpenGL
+  in each context per SoGLRenderAction traversal, for textures which
+  are loaded in the background. 0 means no limit.
+
+  The budget can also be set using the environment variable \c
+  COIN_GL_UPLOAD_BUDGET, in kilobytes.
+*/
+void
+SoGLResourceManager::setUploadBudget(const size_t bytes)
+{
+  soglresource_lock();
+  soglresource_uploadbudget = bytes;
+  soglresource_uploadbudgetinit = TRUE;
+  soglresource_unlock();
+}
+
+/*!
+  Returns the maximum number of bytes of texture data to send to
+  OpenGL in each context per frame.
+*/
+size_t
+SoGLResourceManager::getUploadBudget(void)
+{
+  soglresource_lock();
+  if (!soglresource_uploadbudgetinit) {
+    soglresource_uploadbudgetinit = TRUE;
+    const char * env = coin_getenv("COIN_GL_UPLOAD_BUDGET");
+    if (env) soglresource_uploadbudget = size_t(atoi(env)) * 1024;
+  }
+  const size_t budget = soglresource_uploadbudget;
+  soglresource_unlock();
+  return budget;
+}
+
+/*!
+  Returns the estimated number of bytes used by the resources
+  registered for context \a contextid.
+*/
+size_t
+SoGLResourceManager::getMemoryUsage(const uint32_t contextid)
+{
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  const size_t usage = ctx ? ctx->getUsage() : 0;
+  soglresource_unlock();
+  return usage;
+}
+
+/*!
+  Returns the estimated number of bytes used by the resources of type
+  \a type registered for context \a contextid.
+*/
+size_t
+SoGLResourceManager::getMemoryUsage(const uint32_t contextid, const ResourceType type)
+{
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  const size_t usage = ctx ? ctx->usage[type] : 0;
+  soglresource_unlock();
+  return usage;
+}
+
+/*!
+  Returns the number of resources of type \a type registered for
+  context \a contextid.
+*/
+int
+SoGLResourceManager::getNumResources(const uint32_t contextid, const ResourceType type)
+{
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  const int num = ctx ? ctx->num[type] : 0;
+  soglresource_unlock();
+  return num;
+}
+
+/*!
+  Returns the number of resources evicted from context \a contextid
+  so far.
+*/
+int
+SoGLResourceManager::getNumEvicted(const uint32_t contextid)
+{
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  const int num = ctx ? ctx->numevicted : 0;
+  soglresource_unlock();
+  return num;
+}
+
+/*!
+  Evicts all resources registered for context \a contextid. This can
+  be used to free OpenGL memory when a context will not be rendered
+  for a while. The OpenGL resources are deleted the next time the
+  context is current.
+*/
+void
+SoGLResourceManager::evictAll(const uint32_t contextid)
+{
+  SbList <soglresource_victim> victims;
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  if (ctx) {
+    while (ctx->first) soglresource_remove(ctx->first->id, &victims);
+  }
+  soglresource_unlock();
+  soglresource_evict(victims, NULL);
+}
+
+// *************************************************************************
+
+// Registers a resource of \a size bytes for \a contextid. \a cb is
+// called with \a closure if the resource is evicted. The resource is
+// treated as used in the current frame.
+uint32_t
+SoGLResourceManagerP::add(const uint32_t contextid,
+                          const SoGLResourceManager::ResourceType type,
+                          const size_t size,
+                          EvictCB * cb, void * closure)
+{
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, TRUE);
+  soglresource_entry * entry = new soglresource_entry;
+  entry->id = soglresource_nextid++;
+  if (soglresource_nextid == 0) soglresource_nextid = 1;
+  entry->contextid = contextid;
+  entry->type = type;
+  entry->size = size;
+  entry->cb = cb;
+  entry->closure = closure;
+  entry->lastframe = ctx->frame;
+  entry->owner = 0;
+  soglresource_link_first(ctx, entry);
+  ctx->usage[type] += size;
+  ctx->num[type]++;
+  soglresource_entries->put(entry->id, entry);
+  const uint32_t id = entry->id;
+  soglresource_unlock();
+  return id;
+}
+
+// Unregisters a resource. Must be called when the owner frees the
+// resource.
+void
+SoGLResourceManagerP::remove(const uint32_t id)
+{
+  if (id == 0) return;
+  soglresource_lock();
+  soglresource_remove(id, NULL);
+  soglresource_unlock();
+}
+
+// Updates the size of a resource.
+void
+SoGLResourceManagerP::resize(const uint32_t id, const size_t size)
+{
+  if (id == 0) return;
+  soglresource_lock();
+  soglresource_entry * entry;
+  if (soglresource_entries->get(id, entry)) {
+    soglresource_context * ctx = soglresource_get_context(entry->contextid, FALSE);
+    ctx->usage[entry->type] -= entry->size;
+    ctx->usage[entry->type] += size;
+    entry->size = size;
+  }
+  soglresource_unlock();
+}
+
+// Marks a resource as used. If \a state is not NULL and a render
+// cache is being recorded, the resource will be kept alive as long as
+// that render cache is used.
+void
+SoGLResourceManagerP::touch(const uint32_t id, SoState * state)
+{
+  if (id == 0) return;
+
+  uint32_t parentid = 0;
+  if (state && state->isCacheOpen()) {
+    SoGLRenderCache * cache =
+      dynamic_cast<SoGLRenderCache *>(SoCacheElement::getCurrentCache(state));
+    if (cache) parentid = SoGLRenderCacheP::get(cache)->resid;
+  }
+
+  soglresource_lock();
+  soglresource_entry * entry;
+  if (soglresource_entries->get(id, entry)) {
+    soglresource_touch(entry);
+  }
+  soglresource_unlock();
+  if (parentid && parentid != id) SoGLResourceManagerP::addDependency(parentid, id);
+}
+
+// Makes the render cache \a parentid depend on the resource \a
+// childid. The child is touched each time the parent is touched, and
+// the parent is evicted if the child is evicted. If \a owned is TRUE,
+// the parent's evict callback deletes the child, so the child is
+// evicted together with the parent, before it.
+void
+SoGLResourceManagerP::addDependency(const uint32_t parentid, const uint32_t childid,
+                                    const SbBool owned)
+{
+  soglresource_lock();
+  soglresource_entry * parent, * child;
+  if (soglresource_entries->get(parentid, parent) &&
+      soglresource_entries->get(childid, child) &&
+      parent->contextid == child->contextid) {
+    if (parent->children.find(childid) < 0) {
+      parent->children.append(childid);
+      child->parents.append(parentid);
+    }
+    if (owned) child->owner = parentid;
+  }
+  soglresource_unlock();
+}
+
+SbBool
+SoGLResourceManagerP::reserveUpload(const uint32_t contextid, const size_t size)
+{
+  const size_t budget = SoGLResourceManager::getUploadBudget();
+
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, TRUE);
+  const SbBool ok =
+    budget == 0 || ctx->uploaded == 0 || ctx->uploaded + size <= budget;
+  if (ok) ctx->uploaded += size;
+  soglresource_unlock();
+  return ok;
+}
+
+// Evicts resources not used in the current frame in \a contextid
+// until the memory usage is within the budget, then starts a new
+// frame.
+void
+SoGLResourceManagerP::endFrame(const uint32_t contextid, SoState * state)
+{
+  const size_t budget = SoGLResourceManager::getMemoryBudget();
+
+  SbList <soglresource_victim> victims;
+  soglresource_lock();
+  soglresource_context * ctx = soglresource_get_context(contextid, FALSE);
+  if (ctx == NULL) {
+    soglresource_unlock();
+    return;
+  }
+  if (budget > 0) {
+    while (ctx->last && ctx->last->lastframe != ctx->frame &&
+           ctx->getUsage() > budget) {
+      soglresource_remove(ctx->last->id, &victims);
+    }
+  }
+  ctx->frame++;
+  ctx->uploaded = 0;
+  soglresource_unlock();
+
+#if COIN_DEBUG
+  if (victims.getLength() && coin_debug_caching_level() > 0) {
+    SoDebugError::postInfo("SoGLResourceManagerP::endFrame",
+                           "evicted %d resources from context %u. "
+                           "Memory usage is now %lu bytes",
+                           victims.getLength(), contextid,
+                           static_cast<unsigned long>
+                           (SoGLResourceManager::getMemoryUsage(contextid)));
+  }
+#endif // debug
+  soglresource_evict(victims, state);
+}
+
+// Convenience function for SoGLRenderAction.
+void
+SoGLResourceManagerP::endFrame(SoState * state)
+{
+  SoGLResourceManagerP::endFrame(SoGLCacheContextElement::get(state), state);
+}
+
+#undef SOGLRESOURCE_NUMTYPES
+
+// *************************************************************************
+
+#ifdef COIN_TEST_SUITE
+
+BOOST_AUTO_TEST_CASE(memoryBudget)
+{
+  const size_t oldbudget = SoGLResourceManager::getMemoryBudget();
+  SoGLResourceManager::setMemoryBudget(64 * 1024 * 1024);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryBudget(), size_t(64 * 1024 * 1024));
+  SoGLResourceManager::setMemoryBudget(oldbudget);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryBudget(), oldbudget);
+}
+
+BOOST_AUTO_TEST_CASE(uploadBudget)
+{
+  const size_t oldbudget = SoGLResourceManager::getUploadBudget();
+  SoGLResourceManager::setUploadBudget(512 * 1024);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getUploadBudget(), size_t(512 * 1024));
+  SoGLResourceManager::setUploadBudget(oldbudget);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getUploadBudget(), oldbudget);
+}
+
+BOOST_AUTO_TEST_CASE(unknownContext)
+{
+  // a context without any resources is empty and can always be evicted
+  const uint32_t context = 0xfffff0;
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context, SoGLResourceManager::TEXTURE), size_t(0));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumResources(context, SoGLResourceManager::RENDER_CACHE), 0);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumEvicted(context), 0);
+  SoGLResourceManager::evictAll(context);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumEvicted(context), 0);
+}
+
+#ifdef COIN_INT_TEST_SUITE
+
+// makeextract.sh moves the includes to the top of the extracted file,
+// also for the public test suite, which doesn't search src/
+#include "../src/rendering/SoGLResourceManagerP.h"
+#include <Inventor/lists/SbList.h>
+
+// the closures of the evicted resources, in the order they were evicted
+static SbList <intptr_t> * soglresource_test_evicted = NULL;
+
+static void
+soglresource_test_evict(void * closure, const uint32_t, SoState *)
+{
+  soglresource_test_evicted->append(reinterpret_cast<intptr_t>(closure));
+}
+
+static uint32_t
+soglresource_test_add(const uint32_t context, const intptr_t tag,
+                      const SoGLResourceManager::ResourceType type =
+                      SoGLResourceManager::TEXTURE)
+{
+  return SoGLResourceManagerP::add(context, type, 100, soglresource_test_evict,
+                                   reinterpret_cast<void *>(tag));
+}
+
+// Runs one frame for \a context with \a budget, and returns the tags of
+// the resources evicted at the end of it.
+static SbList <intptr_t>
+soglresource_test_end_frame(const uint32_t context, const size_t budget)
+{
+  SbList <intptr_t> evicted;
+  soglresource_test_evicted = &evicted;
+  const size_t oldbudget = SoGLResourceManager::getMemoryBudget();
+  SoGLResourceManager::setMemoryBudget(budget);
+  SoGLResourceManagerP::endFrame(context, NULL);
+  SoGLResourceManager::setMemoryBudget(oldbudget);
+  soglresource_test_evicted = NULL;
+  return evicted;
+}
+
+BOOST_AUTO_TEST_CASE(leastRecentlyUsedFirst)
+{
+  const uint32_t context = 0xfffe01;
+  soglresource_test_add(context, 1);
+  soglresource_test_add(context, 2);
+  const uint32_t c = soglresource_test_add(context, 3);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(300));
+
+  // nothing is evicted without a budget
+  BOOST_CHECK_EQUAL(soglresource_test_end_frame(context, 0).getLength(), 0);
+
+  // resource 1 was added first, and is the least recently used
+  SbList <intptr_t> evicted = soglresource_test_end_frame(context, 250);
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 1);
+  BOOST_CHECK_EQUAL(evicted[0], intptr_t(1));
+
+  // a touched resource moves to the front
+  SoGLResourceManagerP::touch(c);
+  soglresource_test_end_frame(context, 0);
+  evicted = soglresource_test_end_frame(context, 150);
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 1);
+  BOOST_CHECK_EQUAL(evicted[0], intptr_t(2));
+
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(100));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumResources(context, SoGLResourceManager::TEXTURE), 1);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumEvicted(context), 2);
+
+  // removing an evicted resource is harmless
+  SoGLResourceManagerP::remove(c);
+  SoGLResourceManagerP::remove(c);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(evictWithinBudget)
+{
+  const uint32_t context = 0xfffe02;
+  const uint32_t a = soglresource_test_add(context, 1);
+  const uint32_t b = soglresource_test_add(context, 2);
+  SoGLResourceManagerP::resize(b, 300);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(400));
+
+  // resources used in the current frame are kept, even over budget
+  BOOST_CHECK_EQUAL(soglresource_test_end_frame(context, 50).getLength(), 0);
+
+  // evicting stops as soon as the usage is within the budget
+  SoGLResourceManagerP::touch(a);
+  soglresource_test_end_frame(context, 0);
+  SbList <intptr_t> evicted = soglresource_test_end_frame(context, 100);
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 1);
+  BOOST_CHECK_EQUAL(evicted[0], intptr_t(2));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(100));
+
+  // the budget is checked again in the next frame
+  BOOST_CHECK_EQUAL(soglresource_test_end_frame(context, 50).getLength(), 1);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(dependencyCascade)
+{
+  const uint32_t context = 0xfffe03;
+  const uint32_t texture = soglresource_test_add(context, 1);
+  const uint32_t cache =
+    soglresource_test_add(context, 2, SoGLResourceManager::RENDER_CACHE);
+  SoGLResourceManagerP::addDependency(cache, texture);
+
+  // touching the cache touches the texture, which then is the most
+  // recently used. Touch the cache again to move it in front.
+  soglresource_test_end_frame(context, 0);
+  SoGLResourceManagerP::touch(cache);
+  SoGLResourceManagerP::touch(cache);
+  soglresource_test_end_frame(context, 0);
+
+  // evicting the texture evicts the cache replaying it
+  SbList <intptr_t> evicted = soglresource_test_end_frame(context, 150);
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 2);
+  BOOST_CHECK_EQUAL(evicted[0], intptr_t(1));
+  BOOST_CHECK_EQUAL(evicted[1], intptr_t(2));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+
+  // evicting a cache keeps the textures it doesn't own
+  const uint32_t texture2 = soglresource_test_add(context, 3);
+  const uint32_t cache2 =
+    soglresource_test_add(context, 4, SoGLResourceManager::RENDER_CACHE);
+  SoGLResourceManagerP::addDependency(cache2, texture2);
+  soglresource_test_end_frame(context, 0);
+  SoGLResourceManagerP::touch(cache2);
+  soglresource_test_end_frame(context, 0);
+  evicted = soglresource_test_end_frame(context, 150);
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 1);
+  BOOST_CHECK_EQUAL(evicted[0], intptr_t(4));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumResources(context, SoGLResourceManager::TEXTURE), 1);
+  SoGLResourceManagerP::remove(texture2);
+}
+
+BOOST_AUTO_TEST_CASE(ownedEvictedFirst)
+{
+  // a render cache deletes its buffer objects when it is evicted, so
+  // the buffers' callbacks must not be called after the cache's
+  const uint32_t context = 0xfffe04;
+  const uint32_t cache =
+    soglresource_test_add(context, 1, SoGLResourceManager::RENDER_CACHE);
+  const uint32_t vertices =
+    soglresource_test_add(context, 2, SoGLResourceManager::BUFFER_OBJECT);
+  const uint32_t indices =
+    soglresource_test_add(context, 3, SoGLResourceManager::BUFFER_OBJECT);
+  SoGLResourceManagerP::addDependency(cache, vertices, TRUE);
+  SoGLResourceManagerP::addDependency(cache, indices, TRUE);
+
+  // the cache is touched before its buffers, and is the least
+  // recently used
+  soglresource_test_end_frame(context, 0);
+  SoGLResourceManagerP::touch(cache);
+  soglresource_test_end_frame(context, 0);
+
+  SbList <intptr_t> evicted = soglresource_test_end_frame(context, 250);
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 3);
+  BOOST_CHECK_EQUAL(evicted[2], intptr_t(1));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumEvicted(context), 3);
+}
+
+BOOST_AUTO_TEST_CASE(evictAllResources)
+{
+  const uint32_t context = 0xfffe05;
+  const uint32_t texture = soglresource_test_add(context, 1);
+  const uint32_t cache =
+    soglresource_test_add(context, 2, SoGLResourceManager::RENDER_CACHE);
+  const uint32_t buffer =
+    soglresource_test_add(context, 3, SoGLResourceManager::BUFFER_OBJECT);
+  SoGLResourceManagerP::addDependency(cache, texture);
+  SoGLResourceManagerP::addDependency(cache, buffer, TRUE);
+
+  // also resources used in the current frame are evicted, each once
+  SbList <intptr_t> evicted;
+  soglresource_test_evicted = &evicted;
+  SoGLResourceManager::evictAll(context);
+  soglresource_test_evicted = NULL;
+  BOOST_REQUIRE_EQUAL(evicted.getLength(), 3);
+  BOOST_CHECK(evicted.find(1) >= 0);
+  BOOST_CHECK(evicted.find(2) >= 0);
+  BOOST_CHECK(evicted.find(3) >= 0);
+  BOOST_CHECK(evicted.find(3) < evicted.find(2));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getNumResources(context, SoGLResourceManager::RENDER_CACHE), 0);
+
+  // the ids are not valid any more
+  SoGLResourceManagerP::touch(cache);
+  SoGLResourceManagerP::remove(texture);
+  BOOST_CHECK_EQUAL(SoGLResourceManager::getMemoryUsage(context), size_t(0));
+}
+
+#endif // COIN_INT_TEST_SUITE
+
+#endif // COIN_TEST_SUITE
@@ -0,0 +1,70 @@
+#ifndef COIN_SOGLRESOURCEMANAGERP_H
+#define COIN_SOGLRESOURCEMANAGERP_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// This header does not check for COIN_INTERNAL, and only includes
+// public headers, so that the test suite can include it.
+
+#include <Inventor/misc/SoGLResourceManager.h>
+
+class SoState;
+
+// Internal interface used by the owners of OpenGL resources (render
+// caches, textures and buffer objects) to register them with the
+// resource manager. Each resource is identified by the id returned
+// from add(). 0 is never a valid id, and all functions accept ids of
+// resources which have already been evicted or removed.
+
+class SoGLResourceManagerP {
+public:
+  // Called when a resource is evicted. The owner should release the
+  // OpenGL resource for the context, but keep enough data to
+  // recreate it on demand. \a state is NULL if the context might not
+  // be current. The resource is already unregistered when this is
+  // called.
+  typedef void EvictCB(void * closure, const uint32_t contextid, SoState * state);
+
+  static uint32_t add(const uint32_t contextid,
+                      const SoGLResourceManager::ResourceType type,
+                      const size_t size,
+                      EvictCB * cb, void * closure);
+  static void remove(const uint32_t id);
+  static void resize(const uint32_t id, const size_t size);
+  static void touch(const uint32_t id, SoState * state = NULL);
+  // If \a owned is TRUE, the child is deleted by the parent's evict
+  // callback, and is evicted before the parent.
+  static void addDependency(const uint32_t parentid, const uint32_t childid,
+                            const SbBool owned = FALSE);
+
+  // Returns TRUE if \a size bytes of data can be sent to OpenGL in
+  // the current frame without exceeding the upload budget. The first
+  // upload in each frame is always allowed, so that progress is made.
+  static SbBool reserveUpload(const uint32_t contextid, const size_t size);
+
+  static void endFrame(const uint32_t contextid, SoState * state);
+  static void endFrame(SoState * state);
+};
+
+#endif // !COIN_SOGLRESOURCEMANAGERP_H
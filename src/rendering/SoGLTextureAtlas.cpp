@@ -0,0 +1,677 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// Shared texture pages for small 2D textures.
+//
+// Each page is a PAGESIZE x PAGESIZE image divided into square cells
+// using a buddy allocator: a free cell is split into four quadrants
+// until it has the requested size. Every image gets a cell with the
+// smallest power of two size which holds it, and is resampled to fill
+// the cell, so that texture coordinates in [0, 1] can be mapped into
+// the cell with a scale and a translation. A freed cell is merged with
+// its three buddies into the larger cell again when they are all free,
+// so that the page does not fragment into small cells over time, and a
+// page is deleted together with its last entry.
+//
+// Images are kept in separate pages depending on the number of
+// components and on whether they have transparent texels, so that
+// packing an opaque texture never makes shapes using it be rendered
+// as transparent.
+//
+// The pages are created without mipmaps, since mipmap levels would
+// blend texels from neighbouring cells. The remapping insets the
+// coordinates by half a texel for the same reason.
+
+#include "rendering/SoGLTextureAtlas.h"
+
+#include <string.h>
+#include <assert.h>
+
+#include <Inventor/SbImage.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbVec3s.h>
+#include <Inventor/C/glue/gl.h>
+#include <Inventor/C/tidbits.h>
+#include <Inventor/elements/SoGLCacheContextElement.h>
+#include <Inventor/elements/SoGLDisplayList.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/misc/SoGLImage.h>
+#include <Inventor/system/gl.h>
+
+#include "glue/glp.h"
+#include "rendering/SoGL.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+#define PAGESIZE SoGLTextureAtlasAllocator::PAGESIZE
+#define MAXIMAGESIZE 128
+
+class sogltextureatlas_page {
+public:
+  int numcomponents;
+  SbBool transparent;
+  unsigned char * buffer;
+  SbImage image;
+  SoGLImage * glimage;
+  SoGLTextureAtlasDirtyRegion dirty;
+  SoGLTextureAtlasAllocator cells;
+  SbList <SoGLTextureAtlas::Entry *> entries;
+};
+
+class SoGLTextureAtlas::Entry {
+public:
+  sogltextureatlas_page * page;
+  SbVec2s origin;
+  int level;
+  SbBool committed;
+};
+
+static void * sogltextureatlas_mutex = NULL;
+static SbList <sogltextureatlas_page *> * sogltextureatlas_pages = NULL;
+static SbList <SoGLTextureAtlas::Entry *> * sogltextureatlas_staged = NULL;
+
+static void
+sogltextureatlas_delete_page(sogltextureatlas_page * page)
+{
+  page->glimage->unref(NULL);
+  delete[] page->buffer;
+  delete page;
+}
+
+static void
+sogltextureatlas_cleanup(void)
+{
+  for (int i = 0; i < sogltextureatlas_pages->getLength(); i++) {
+    sogltextureatlas_page * page = (*sogltextureatlas_pages)[i];
+    // entries are owned by the nodes, and might outlive the pages
+    for (int j = 0; j < page->entries.getLength(); j++) {
+      page->entries[j]->page = NULL;
+    }
+    sogltextureatlas_delete_page(page);
+  }
+  delete sogltextureatlas_pages;
+  delete sogltextureatlas_staged;
+  sogltextureatlas_pages = NULL;
+  sogltextureatlas_staged = NULL;
+  CC_MUTEX_DESTRUCT(sogltextureatlas_mutex);
+}
+
+static void
+sogltextureatlas_lock(void)
+{
+  CC_MUTEX_CONSTRUCT(sogltextureatlas_mutex);
+  CC_MUTEX_LOCK(sogltextureatlas_mutex);
+  if (sogltextureatlas_pages == NULL) {
+    sogltextureatlas_pages = new SbList <sogltextureatlas_page *>;
+    sogltextureatlas_staged = new SbList <SoGLTextureAtlas::Entry *>;
+    coin_atexit(sogltextureatlas_cleanup, CC_ATEXIT_NORMAL);
+  }
+}
+
+static void
+sogltextureatlas_unlock(void)
+{
+  CC_MUTEX_UNLOCK(sogltextureatlas_mutex);
+}
+
+static SbBool
+sogltextureatlas_has_transparency(const unsigned char * bytes,
+                                  const SbVec2s & size,
+                                  const int numcomponents)
+{
+  if (numcomponents != 2 && numcomponents != 4) return FALSE;
+  const int n = int(size[0]) * int(size[1]);
+  for (int i = 0; i < n; i++) {
+    if (bytes[i * numcomponents + numcomponents - 1] != 255) return TRUE;
+  }
+  return FALSE;
+}
+
+static sogltextureatlas_page *
+sogltextureatlas_new_page(const int numcomponents, const SbBool transparent)
+{
+  sogltextureatlas_page * page = new sogltextureatlas_page;
+  page->numcomponents = numcomponents;
+  page->transparent = transparent;
+  page->buffer = new unsigned char[PAGESIZE * PAGESIZE * numcomponents];
+  memset(page->buffer, 0, PAGESIZE * PAGESIZE * numcomponents);
+  page->image.setValuePtr(SbVec2s(PAGESIZE, PAGESIZE), numcomponents, page->buffer);
+  page->glimage = new SoGLImage;
+  page->glimage->setFlags(SoGLImage::NO_MIPMAP |
+                          SoGLImage::LINEAR_MIN_FILTER |
+                          SoGLImage::LINEAR_MAG_FILTER);
+  // texture objects are created from the whole buffer, and updated
+  // with the changed cells by sogltextureatlas_upload()
+  page->glimage->setData(&page->image,
+                         SoGLImage::CLAMP_TO_EDGE,
+                         SoGLImage::CLAMP_TO_EDGE,
+                         0.5f);
+  return page;
+}
+
+// Uploads the cells of the page changed since the page was last used
+// in the GL context of state.
+static void
+sogltextureatlas_upload(SoState * state, sogltextureatlas_page * page)
+{
+  SbBox2s region;
+  if (!page->dirty.take(SoGLCacheContextElement::get(state), region)) return;
+  SoGLDisplayList * dl = page->glimage->getGLDisplayList(state);
+  if (dl == NULL || dl->getType() != SoGLDisplayList::TEXTURE_OBJECT) return;
+
+  const cc_glglue * glw = sogl_glue_instance(state);
+  const SbVec2s origin = region.getMin();
+  const SbVec2s size = region.getMax() - origin + SbVec2s(1, 1);
+
+  // restore the binding afterwards, since the texture elements
+  // assume that their texture is still bound
+  GLint oldtexture = 0, oldalignment = 4;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &oldtexture);
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &oldalignment);
+  cc_glglue_glBindTexture(glw, GL_TEXTURE_2D, (GLuint) dl->getFirstIndex());
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, PAGESIZE);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, origin[0]);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, origin[1]);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  cc_glglue_glTexSubImage2D(glw, GL_TEXTURE_2D, 0, origin[0], origin[1],
+                            size[0], size[1],
+                            coin_glglue_get_texture_format(glw, page->numcomponents),
+                            GL_UNSIGNED_BYTE, page->buffer);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, oldalignment);
+  cc_glglue_glBindTexture(glw, GL_TEXTURE_2D, (GLuint) oldtexture);
+}
+
+// *************************************************************************
+
+SoGLTextureAtlasAllocator::SoGLTextureAtlasAllocator(void)
+{
+  this->freecells[NUMLEVELS - 1].append(SbVec2s(0, 0));
+}
+
+// Returns the level of the smallest cell which holds an image of the
+// given size.
+int
+SoGLTextureAtlasAllocator::getLevel(const SbVec2s & size)
+{
+  const int cellsize = SbMax((int) coin_geq_power_of_two(SbMax(size[0], size[1])),
+                             (int) MINCELLSIZE);
+  int level = 0;
+  while ((MINCELLSIZE << level) < cellsize) level++;
+  return level;
+}
+
+int
+SoGLTextureAtlasAllocator::getCellSize(const int level)
+{
+  return MINCELLSIZE << level;
+}
+
+// finds a free cell at level, splitting larger cells as needed
+SbBool
+SoGLTextureAtlasAllocator::alloc(const int level, SbVec2s & origin)
+{
+  assert(level >= 0 && level < NUMLEVELS);
+  int l = level;
+  while (l < NUMLEVELS && this->freecells[l].getLength() == 0) l++;
+  if (l == NUMLEVELS) return FALSE;
+
+  SbVec2s cell = this->freecells[l].pop();
+  while (l > level) {
+    l--;
+    const short half = MINCELLSIZE << l;
+    this->freecells[l].append(SbVec2s(cell[0] + half, cell[1]));
+    this->freecells[l].append(SbVec2s(cell[0], cell[1] + half));
+    this->freecells[l].append(SbVec2s(cell[0] + half, cell[1] + half));
+  }
+  origin = cell;
+  return TRUE;
+}
+
+// returns the cell to the free lists, merging it with its buddies
+void
+SoGLTextureAtlasAllocator::free(const int level, const SbVec2s & origin)
+{
+  assert(level >= 0 && level < NUMLEVELS);
+  int l = level;
+  SbVec2s cell = origin;
+  while (l < NUMLEVELS - 1) {
+    const short size = MINCELLSIZE << l;
+    // the larger cell is aligned to twice the size
+    const SbVec2s parent(cell[0] & ~(2 * size - 1), cell[1] & ~(2 * size - 1));
+    SbList <SbVec2s> & list = this->freecells[l];
+    SbVec2s buddies[3];
+    int n = 0;
+    for (int i = 0; i < 4; i++) {
+      const SbVec2s buddy(parent[0] + (i & 1) * size, parent[1] + (i >> 1) * size);
+      if (buddy != cell) buddies[n++] = buddy;
+    }
+    if (list.find(buddies[0]) < 0 || list.find(buddies[1]) < 0 ||
+        list.find(buddies[2]) < 0) break;
+
+    for (int i = 0; i < 3; i++) list.removeFast(list.find(buddies[i]));
+    cell = parent;
+    l++;
+  }
+  this->freecells[l].append(cell);
+}
+
+int
+SoGLTextureAtlasAllocator::getNumFreeCells(const int level) const
+{
+  return this->freecells[level].getLength();
+}
+
+// Returns TRUE if no cells are allocated.
+SbBool
+SoGLTextureAtlasAllocator::isEmpty(void) const
+{
+  return this->freecells[NUMLEVELS - 1].getLength() == 1;
+}
+
+void
+SoGLTextureAtlasAllocator::getRemap(const int level, const SbVec2s & origin,
+                                    SbMatrix & remap)
+{
+  const float cellsize = float(MINCELLSIZE << level);
+  const float scale = (cellsize - 1.0f) / float(PAGESIZE);
+  remap = SbMatrix::identity();
+  remap[0][0] = scale;
+  remap[1][1] = scale;
+  remap[3][0] = (float(origin[0]) + 0.5f) / float(PAGESIZE);
+  remap[3][1] = (float(origin[1]) + 0.5f) / float(PAGESIZE);
+}
+
+// *************************************************************************
+
+void
+SoGLTextureAtlasDirtyRegion::add(const SbVec2s & origin, const int size)
+{
+  const SbVec2s last(origin[0] + size - 1, origin[1] + size - 1);
+  for (int i = 0; i < this->regions.getLength(); i++) {
+    this->regions[i].extendBy(origin);
+    this->regions[i].extendBy(last);
+  }
+}
+
+SbBool
+SoGLTextureAtlasDirtyRegion::take(const uint32_t contextid, SbBox2s & region)
+{
+  const int i = this->contexts.find(contextid);
+  if (i < 0) {
+    this->contexts.append(contextid);
+    this->regions.append(SbBox2s());
+    return FALSE;
+  }
+  if (this->regions[i].isEmpty()) return FALSE;
+  region = this->regions[i];
+  this->regions[i].makeEmpty();
+  return TRUE;
+}
+
+// *************************************************************************
+
+// Returns TRUE if an image with the given size and number of
+// components is small enough to be packed.
+SbBool
+SoGLTextureAtlas::canAdd(const SbVec2s & size, const int numcomponents)
+{
+  return
+    numcomponents >= 1 && numcomponents <= 4 &&
+    size[0] > 0 && size[1] > 0 &&
+    size[0] <= MAXIMAGESIZE && size[1] <= MAXIMAGESIZE;
+}
+
+// Copies the image into a free cell, and returns the new entry. The
+// data in \a bytes is not needed after this call. Returns NULL if the
+// image can not be packed.
+SoGLTextureAtlas::Entry *
+SoGLTextureAtlas::add(const unsigned char * bytes, const SbVec2s & size,
+                      const int numcomponents)
+{
+  if (!bytes || !SoGLTextureAtlas::canAdd(size, numcomponents)) return NULL;
+
+  const SbBool transparent =
+    sogltextureatlas_has_transparency(bytes, size, numcomponents);
+  const int level = SoGLTextureAtlasAllocator::getLevel(size);
+  const int cellsize = SoGLTextureAtlasAllocator::getCellSize(level);
+
+  // resample outside the lock
+  unsigned char * resized = NULL;
+  const unsigned char * src = bytes;
+  if (size[0] != cellsize || size[1] != cellsize) {
+    resized = new unsigned char[cellsize * cellsize * numcomponents];
+    SoGLImage::resizeImage(bytes, SbVec3s(size[0], size[1], 0), numcomponents,
+                           resized, SbVec3s(cellsize, cellsize, 0));
+    src = resized;
+  }
+
+  sogltextureatlas_lock();
+
+  sogltextureatlas_page * page = NULL;
+  SbVec2s origin;
+  for (int i = 0; i < sogltextureatlas_pages->getLength(); i++) {
+    sogltextureatlas_page * p = (*sogltextureatlas_pages)[i];
+    if (p->numcomponents == numcomponents && p->transparent == transparent &&
+        p->cells.alloc(level, origin)) {
+      page = p;
+      break;
+    }
+  }
+  if (page == NULL) {
+    page = sogltextureatlas_new_page(numcomponents, transparent);
+    sogltextureatlas_pages->append(page);
+    SbBool ok = page->cells.alloc(level, origin);
+    assert(ok);
+  }
+
+  const int rowsize = cellsize * numcomponents;
+  for (int y = 0; y < cellsize; y++) {
+    memcpy(page->buffer + ((origin[1] + y) * PAGESIZE + origin[0]) * numcomponents,
+           src + y * rowsize, rowsize);
+  }
+  page->dirty.add(origin, cellsize);
+
+  Entry * entry = new Entry;
+  entry->page = page;
+  entry->origin = origin;
+  entry->level = level;
+  entry->committed = FALSE;
+  page->entries.append(entry);
+  sogltextureatlas_staged->append(entry);
+
+  sogltextureatlas_unlock();
+
+  delete[] resized;
+  return entry;
+}
+
+// Frees the cell used by \a entry, and deletes the entry.
+void
+SoGLTextureAtlas::remove(Entry * entry)
+{
+  if (entry == NULL) return;
+  if (entry->page) {
+    sogltextureatlas_lock();
+    sogltextureatlas_page * page = entry->page;
+    page->entries.removeItem(entry);
+    page->cells.free(entry->level, entry->origin);
+    if (!entry->committed) sogltextureatlas_staged->removeItem(entry);
+    if (page->entries.getLength() == 0) {
+      sogltextureatlas_pages->removeItem(page);
+      sogltextureatlas_delete_page(page);
+    }
+    sogltextureatlas_unlock();
+  }
+  delete entry;
+}
+
+SoGLImage *
+SoGLTextureAtlas::get(const Entry * entry, SbMatrix & remap, SoState * state)
+{
+  if (entry == NULL || entry->page == NULL) return NULL;
+
+  sogltextureatlas_lock();
+  SoGLImage * glimage = entry->committed ? entry->page->glimage : NULL;
+  if (glimage && state) sogltextureatlas_upload(state, entry->page);
+  sogltextureatlas_unlock();
+  if (glimage == NULL) return NULL;
+
+  SoGLTextureAtlasAllocator::getRemap(entry->level, entry->origin, remap);
+  return glimage;
+}
+
+// Called at the end of each frame. Makes the entries added since the
+// last call visible. Their cells are uploaded by get(), for each GL
+// context using the page.
+void
+SoGLTextureAtlas::endFrame(void)
+{
+  // unlocked test, to avoid any overhead when no textures are packed
+  if (sogltextureatlas_pages == NULL) return;
+
+  sogltextureatlas_lock();
+  for (int i = 0; i < sogltextureatlas_staged->getLength(); i++) {
+    (*sogltextureatlas_staged)[i]->committed = TRUE;
+  }
+  sogltextureatlas_staged->truncate(0);
+  sogltextureatlas_unlock();
+}
+
+#undef MAXIMAGESIZE
+#undef PAGESIZE
+
+#ifdef COIN_TEST_SUITE
+#ifdef COIN_INT_TEST_SUITE
+
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbVec3f.h>
+#include <Inventor/misc/SoGLImage.h>
+
+static SbBool
+sogltextureatlas_test_only_whole_page(const SoGLTextureAtlasAllocator & cells)
+{
+  for (int l = 0; l < SoGLTextureAtlasAllocator::NUMLEVELS - 1; l++) {
+    if (cells.getNumFreeCells(l) != 0) return FALSE;
+  }
+  return cells.isEmpty();
+}
+
+BOOST_AUTO_TEST_CASE(cellLevels)
+{
+  BOOST_CHECK_EQUAL(SoGLTextureAtlasAllocator::getLevel(SbVec2s(1, 1)), 0);
+  BOOST_CHECK_EQUAL(SoGLTextureAtlasAllocator::getLevel(SbVec2s(4, 4)), 0);
+  BOOST_CHECK_EQUAL(SoGLTextureAtlasAllocator::getLevel(SbVec2s(5, 3)), 1);
+  BOOST_CHECK_EQUAL(SoGLTextureAtlasAllocator::getLevel(SbVec2s(100, 128)), 5);
+  BOOST_CHECK_EQUAL(SoGLTextureAtlasAllocator::getCellSize(5), 128);
+  BOOST_CHECK_EQUAL(SoGLTextureAtlasAllocator::getCellSize(SoGLTextureAtlasAllocator::NUMLEVELS - 1),
+                    (int) SoGLTextureAtlasAllocator::PAGESIZE);
+}
+
+BOOST_AUTO_TEST_CASE(allocSplits)
+{
+  SoGLTextureAtlasAllocator cells;
+  BOOST_CHECK(sogltextureatlas_test_only_whole_page(cells));
+
+  // the page is split down to the smallest cells, leaving the three
+  // other quadrants free at each level
+  SbVec2s a;
+  BOOST_REQUIRE(cells.alloc(0, a));
+  BOOST_CHECK(a == SbVec2s(0, 0));
+  BOOST_CHECK(!cells.isEmpty());
+  for (int l = 0; l < SoGLTextureAtlasAllocator::NUMLEVELS - 1; l++) {
+    BOOST_CHECK_EQUAL(cells.getNumFreeCells(l), 3);
+  }
+  BOOST_CHECK_EQUAL(cells.getNumFreeCells(SoGLTextureAtlasAllocator::NUMLEVELS - 1), 0);
+
+  // a free cell of the right size is used without splitting
+  SbVec2s b;
+  BOOST_REQUIRE(cells.alloc(0, b));
+  BOOST_CHECK(b != a);
+  BOOST_CHECK(b[0] < 8 && b[1] < 8);
+  BOOST_CHECK_EQUAL(cells.getNumFreeCells(0), 2);
+  BOOST_CHECK_EQUAL(cells.getNumFreeCells(1), 3);
+
+  // a larger cell is split again
+  SbVec2s c;
+  BOOST_REQUIRE(cells.alloc(2, c));
+  BOOST_CHECK_EQUAL(c[0] % 16, 0);
+  BOOST_CHECK_EQUAL(c[1] % 16, 0);
+  BOOST_CHECK(c[0] >= 16 || c[1] >= 16);
+  BOOST_CHECK_EQUAL(cells.getNumFreeCells(2), 2);
+}
+
+BOOST_AUTO_TEST_CASE(freeMerges)
+{
+  SoGLTextureAtlasAllocator cells;
+  SbVec2s a, b;
+  BOOST_REQUIRE(cells.alloc(0, a));
+  BOOST_REQUIRE(cells.alloc(0, b));
+
+  // b's buddy a is still in use, so b can not be merged
+  cells.free(0, b);
+  BOOST_CHECK_EQUAL(cells.getNumFreeCells(0), 3);
+  BOOST_CHECK(!cells.isEmpty());
+
+  // freeing a merges all the way up to the whole page
+  cells.free(0, a);
+  BOOST_CHECK(sogltextureatlas_test_only_whole_page(cells));
+
+  // cells of mixed sizes, freed in a different order
+  const int levels[] = { 3, 0, 5, 1, 0, 2, 4, 0, 1 };
+  const int num = sizeof(levels) / sizeof(levels[0]);
+  SbVec2s origins[num];
+  for (int i = 0; i < num; i++) {
+    BOOST_REQUIRE(cells.alloc(levels[i], origins[i]));
+  }
+  for (int i = 0; i < num; i += 2) cells.free(levels[i], origins[i]);
+  BOOST_CHECK(!cells.isEmpty());
+  for (int i = 1; i < num; i += 2) cells.free(levels[i], origins[i]);
+  BOOST_CHECK(sogltextureatlas_test_only_whole_page(cells));
+}
+
+BOOST_AUTO_TEST_CASE(fullPage)
+{
+  SoGLTextureAtlasAllocator cells;
+  const int level = SoGLTextureAtlasAllocator::getLevel(SbVec2s(128, 128));
+  const int cellsize = SoGLTextureAtlasAllocator::getCellSize(level);
+  const int percol = SoGLTextureAtlasAllocator::PAGESIZE / cellsize;
+  const int num = percol * percol;
+
+  SbList <SbVec2s> origins;
+  SbBool used[64];
+  BOOST_REQUIRE_EQUAL(num, 64);
+  for (int i = 0; i < num; i++) used[i] = FALSE;
+  for (int i = 0; i < num; i++) {
+    SbVec2s origin;
+    BOOST_REQUIRE(cells.alloc(level, origin));
+    BOOST_REQUIRE_EQUAL(origin[0] % cellsize, 0);
+    BOOST_REQUIRE_EQUAL(origin[1] % cellsize, 0);
+    const int idx = (origin[1] / cellsize) * percol + origin[0] / cellsize;
+    BOOST_REQUIRE(idx >= 0 && idx < num);
+    BOOST_CHECK(!used[idx]);
+    used[idx] = TRUE;
+    origins.append(origin);
+  }
+
+  // a full page reports failure for any size
+  SbVec2s dummy;
+  BOOST_CHECK(!cells.alloc(level, dummy));
+  BOOST_CHECK(!cells.alloc(0, dummy));
+  for (int l = 0; l < SoGLTextureAtlasAllocator::NUMLEVELS; l++) {
+    BOOST_CHECK_EQUAL(cells.getNumFreeCells(l), 0);
+  }
+
+  // one freed cell can hold smaller cells again
+  cells.free(level, origins[17]);
+  BOOST_CHECK(cells.alloc(0, dummy));
+  BOOST_CHECK(dummy[0] >= origins[17][0] && dummy[0] < origins[17][0] + cellsize);
+  BOOST_CHECK(dummy[1] >= origins[17][1] && dummy[1] < origins[17][1] + cellsize);
+  cells.free(0, dummy);
+  BOOST_CHECK_EQUAL(cells.getNumFreeCells(level), 1);
+
+  for (int i = 0; i < num; i++) {
+    if (i != 17) cells.free(level, origins[i]);
+  }
+  BOOST_CHECK(sogltextureatlas_test_only_whole_page(cells));
+}
+
+BOOST_AUTO_TEST_CASE(remapToCell)
+{
+  const float eps = 1.0e-6f;
+  const float pagesize = float(SoGLTextureAtlasAllocator::PAGESIZE);
+  SbMatrix remap;
+  SoGLTextureAtlasAllocator::getRemap(5, SbVec2s(128, 256), remap);
+
+  // the corners of the texture map to the centers of the corner texels
+  SbVec3f lo, hi, mid;
+  remap.multVecMatrix(SbVec3f(0.0f, 0.0f, 0.0f), lo);
+  remap.multVecMatrix(SbVec3f(1.0f, 1.0f, 0.0f), hi);
+  remap.multVecMatrix(SbVec3f(0.5f, 0.5f, 0.0f), mid);
+  BOOST_CHECK_CLOSE(lo[0], 128.5f / pagesize, eps);
+  BOOST_CHECK_CLOSE(lo[1], 256.5f / pagesize, eps);
+  BOOST_CHECK_CLOSE(hi[0], 255.5f / pagesize, eps);
+  BOOST_CHECK_CLOSE(hi[1], 383.5f / pagesize, eps);
+  BOOST_CHECK_CLOSE(mid[0], 192.0f / pagesize, eps);
+  BOOST_CHECK_CLOSE(mid[1], 320.0f / pagesize, eps);
+  BOOST_CHECK_EQUAL(lo[2], 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(dirtyRegions)
+{
+  SoGLTextureAtlasDirtyRegion dirty;
+  SbBox2s region;
+
+  // a context creates its texture from the whole page the first time
+  dirty.add(SbVec2s(64, 64), 32);
+  BOOST_CHECK(!dirty.take(1, region));
+  BOOST_CHECK(!dirty.take(1, region));
+
+  // later changes are collected for each context
+  dirty.add(SbVec2s(8, 16), 8);
+  BOOST_CHECK(!dirty.take(2, region));
+  dirty.add(SbVec2s(128, 256), 128);
+  BOOST_REQUIRE(dirty.take(1, region));
+  BOOST_CHECK(region.getMin() == SbVec2s(8, 16));
+  BOOST_CHECK(region.getMax() == SbVec2s(255, 383));
+  BOOST_CHECK(!dirty.take(1, region));
+
+  // context 2 was added after the first cell
+  BOOST_REQUIRE(dirty.take(2, region));
+  BOOST_CHECK(region.getMin() == SbVec2s(128, 256));
+  BOOST_CHECK(region.getMax() == SbVec2s(255, 383));
+}
+
+BOOST_AUTO_TEST_CASE(entryVisibleAfterEndFrame)
+{
+  unsigned char bytes[6 * 6 * 3];
+  for (int i = 0; i < 6 * 6 * 3; i++) bytes[i] = (unsigned char) i;
+  BOOST_CHECK(!SoGLTextureAtlas::canAdd(SbVec2s(129, 4), 3));
+
+  SoGLTextureAtlas::Entry * a = SoGLTextureAtlas::add(bytes, SbVec2s(6, 6), 3);
+  SoGLTextureAtlas::Entry * b = SoGLTextureAtlas::add(bytes, SbVec2s(6, 6), 3);
+  BOOST_REQUIRE(a != NULL && b != NULL);
+
+  SbMatrix ra, rb;
+  BOOST_CHECK(SoGLTextureAtlas::get(a, ra, NULL) == NULL);
+  SoGLTextureAtlas::endFrame();
+  SoGLImage * pa = SoGLTextureAtlas::get(a, ra, NULL);
+  SoGLImage * pb = SoGLTextureAtlas::get(b, rb, NULL);
+  BOOST_CHECK(pa != NULL);
+  BOOST_CHECK(pa == pb);
+
+  // 6 x 6 images get 8 x 8 cells in the same page
+  BOOST_CHECK_CLOSE(ra[0][0], 7.0f / 1024.0f, 1.0e-6f);
+  BOOST_CHECK_CLOSE(rb[1][1], 7.0f / 1024.0f, 1.0e-6f);
+  BOOST_CHECK(ra[3][0] != rb[3][0] || ra[3][1] != rb[3][1]);
+
+  SoGLTextureAtlas::remove(a);
+  SoGLTextureAtlas::remove(b);
+}
+
+#endif // COIN_INT_TEST_SUITE
+#endif // COIN_TEST_SUITE
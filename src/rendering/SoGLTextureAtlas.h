@@ -0,0 +1,117 @@
+#ifndef COIN_SOGLTEXTUREATLAS_H
+#define COIN_SOGLTEXTUREATLAS_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// This header does not check for COIN_INTERNAL, so that the internal
+// test suite can include it.
+
+#include <Inventor/SbBasic.h>
+#include <Inventor/SbBox2s.h>
+#include <Inventor/SbVec2s.h>
+#include <Inventor/lists/SbList.h>
+
+class SbMatrix;
+class SoGLImage;
+class SoState;
+
+// Buddy allocator for the square cells of one atlas page. A cell at
+// level l is MINCELLSIZE << l texels wide, and the whole page is the
+// single cell at level NUMLEVELS - 1. Allocation splits a larger free
+// cell into four quadrants as needed, and freeing a cell merges it
+// with its three buddies again when they are all free.
+
+class SoGLTextureAtlasAllocator {
+public:
+  enum {
+    PAGESIZE = 1024,
+    MINCELLSIZE = 4,
+    NUMLEVELS = 9 // MINCELLSIZE << (NUMLEVELS - 1) == PAGESIZE
+  };
+
+  SoGLTextureAtlasAllocator(void);
+
+  static int getLevel(const SbVec2s & size);
+  static int getCellSize(const int level);
+
+  // Returns FALSE if there is no free cell at \a level or above.
+  SbBool alloc(const int level, SbVec2s & origin);
+  void free(const int level, const SbVec2s & origin);
+
+  int getNumFreeCells(const int level) const;
+  SbBool isEmpty(void) const;
+
+  // Sets \a remap to the matrix which maps texture coordinates in
+  // [0, 1] into the cell, inset by half a texel.
+  static void getRemap(const int level, const SbVec2s & origin,
+                       SbMatrix & remap);
+
+private:
+  SbList <SbVec2s> freecells[NUMLEVELS];
+};
+
+// The part of an atlas page changed since the page was last uploaded
+// to each GL context. A context gets no region the first time it
+// asks, since its texture object is then created from the whole page.
+
+class SoGLTextureAtlasDirtyRegion {
+public:
+  void add(const SbVec2s & origin, const int size);
+
+  // Returns FALSE if nothing has changed for \a contextid, otherwise
+  // sets \a region to the changed texels and clears it.
+  SbBool take(const uint32_t contextid, SbBox2s & region);
+
+private:
+  SbList <uint32_t> contexts;
+  SbList <SbBox2s> regions;
+};
+
+// Packs small 2D images into shared texture pages, so that shapes
+// using different small textures can be rendered without binding a
+// new texture object for each of them. Entries are staged when they
+// are added, and become visible through get() after the next call to
+// endFrame(). get() uploads the cells changed since the page was last
+// used in the GL context of the state. All functions are thread safe.
+
+class SoGLTextureAtlas {
+public:
+  class Entry;
+
+  static SbBool canAdd(const SbVec2s & size, const int numcomponents);
+  static Entry * add(const unsigned char * bytes, const SbVec2s & size,
+                     const int numcomponents);
+  static void remove(Entry * entry);
+
+  // Returns the page holding \a entry, or NULL if the entry has not
+  // been committed yet. \a remap is set to the matrix which maps
+  // texture coordinates in [0, 1] into the entry's cell in the page.
+  // Nothing is uploaded if \a state is NULL.
+  static SoGLImage * get(const Entry * entry, SbMatrix & remap,
+                         SoState * state);
+
+  static void endFrame(void);
+};
+
+#endif // !COIN_SOGLTEXTUREATLAS_H
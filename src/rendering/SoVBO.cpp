@@ -45,9 +45,11 @@
 #include <Inventor/errors/SoDebugError.h>
 
 #include "rendering/SoVertexArrayIndexer.h"
+#include "rendering/SoGLResourceManagerP.h"
 #include "threads/threadsutilp.h"
 #include "glue/glp.h"
 #include "tidbitsp.h"
+#include "coindefs.h" // COIN_UNUSED_ARG
 
 static int vbo_vertex_count_min_limit = -1;
 static int vbo_vertex_count_max_limit = -1;
@@ -72,7 +74,8 @@ SoVBO::SoVBO(const GLenum target, const GLenum usage)
     datasize(0),
     dataid(0),
     didalloc(FALSE),
-    vbohash(5)
+    vbohash(5),
+    residhash(5)
 {
   SoContextHandler::addContextDestructionCallback(context_destruction_cb, this);
 }
@@ -89,12 +92,47 @@ SoVBO::vbo_delete(void * closure, uint32_t contextid)
   cc_glglue_glDeleteBuffers(glue, 1, &id);
 }
 
+//
+// Callback from SoGLResourceManager. The buffer will be recreated
+// from the data the next time it's bound.
+//
+void
+SoVBO::vbo_evict(void * closure, const uint32_t contextid, SoState * COIN_UNUSED_ARG(state))
+{
+  SoVBO * thisp = (SoVBO*) closure;
+  GLuint buffer;
+  if (thisp->vbohash.get(contextid, buffer)) {
+    SoGLCacheContextElement::scheduleDeleteCallback(contextid, SoVBO::vbo_delete,
+                                                    (void*) ((uintptr_t) buffer));
+    thisp->vbohash.erase(contextid);
+  }
+  thisp->residhash.erase(contextid);
+}
+
+//
+// Unregisters the buffers from SoGLResourceManager
+//
+void
+SoVBO::removeResources(void)
+{
+  for(
+      SbHash<uint32_t, uint32_t>::const_iterator iter =
+       this->residhash.const_begin();
+      iter!=this->residhash.const_end();
+      ++iter
+      ) {
+    SoGLResourceManagerP::remove(iter->obj);
+  }
+  this->residhash.clear();
+}
+
 /*!
   Destructor
 */
 SoVBO::~SoVBO()
 {
   SoContextHandler::removeContextDestructionCallback(context_destruction_cb, this);
+  this->removeResources();
   // schedule delete for all allocated GL resources
   for(
       SbHash<uint32_t, GLuint>::const_iterator iter =
@@ -208,6 +246,7 @@ SoVBO::allocBufferData(intptr_t size, uint32_t dataid)
 
   // clear hash table
   this->vbohash.clear();
+  this->removeResources();
 
   if (this->didalloc && this->datasize == size) {
     return (void*)this->data;
@@ -247,6 +286,7 @@ SoVBO::setBufferData(const GLvoid * data, intptr_t size, uint32_t dataid)
 
   // clear hash table
   this->vbohash.clear();
+  this->removeResources();
 
   // clean up old buffer (if any)
   if (this->didalloc) {
@@ -271,6 +311,18 @@ SoVBO::getBufferDataId(void) const
   return this->dataid;
 }
 
+/*!
+  Returns the SoGLResourceManager id of the buffer for \a contextid,
+  or 0 if the buffer hasn't been created for that context.
+*/
+uint32_t
+SoVBO::getResourceId(const uint32_t contextid) const
+{
+  uint32_t resid = 0;
+  (void) this->residhash.get(contextid, resid);
+  return resid;
+}
+
 /*!
   Returns the data pointer and size.
 */
@@ -306,10 +358,19 @@ SoVBO::bindBuffer(uint32_t contextid)
                            this->data,
                            this->usage);
     this->vbohash.put(contextid, buffer);
+    this->residhash.put(contextid,
+                        SoGLResourceManagerP::add(contextid,
+                                                  SoGLResourceManager::BUFFER_OBJECT,
+                                                  this->datasize,
+                                                  SoVBO::vbo_evict, this));
   }
   else {
     // buffer already exists, bind it
     cc_glglue_glBindBuffer(glue, this->target, buffer);
+    uint32_t resid;
+    if (this->residhash.get(contextid, resid)) {
+      SoGLResourceManagerP::touch(resid);
+    }
   }
 
 #if COIN_DEBUG
@@ -344,6 +405,11 @@ SoVBO::context_destruction_cb(uint32_t context, void * userdata)
     cc_glglue_glDeleteBuffers(glue, 1, &buffer);
     thisp->vbohash.erase(context);
   }
+  uint32_t resid;
+  if (thisp->residhash.get(context, resid)) {
+    SoGLResourceManagerP::remove(resid);
+    thisp->residhash.erase(context);
+  }
 }
 
 
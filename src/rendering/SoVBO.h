@@ -48,6 +48,7 @@ class SoVBO {
   uint32_t getBufferDataId(void) const;
   void getBufferData(const GLvoid *& data, intptr_t & size);
   void bindBuffer(uint32_t contextid);
+  uint32_t getResourceId(const uint32_t contextid) const;
 
   static void setVertexCountLimits(const int minlimit, const int maxlimit);
   static int getVertexCountMinLimit(void);
@@ -65,6 +66,8 @@ class SoVBO {
   static void context_destruction_cb(uint32_t context, void * userdata);
   friend struct vbo_schedule;
   static void vbo_delete(void * closure, uint32_t contextid);
+  static void vbo_evict(void * closure, const uint32_t contextid, SoState * state);
+  void removeResources(void);
 
   GLenum target;
   GLenum usage;
@@ -74,6 +77,7 @@ class SoVBO {
   SbBool didalloc;
 
   SbHash<uint32_t, GLuint> vbohash;
+  SbHash<uint32_t, uint32_t> residhash;
 };
 
 #endif // COIN_VERTEXARRAYINDEXER_H
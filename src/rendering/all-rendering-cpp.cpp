@@ -27,6 +27,7 @@
 #include "SoGLCubeMapImage.cpp"
 #include "SoGLDriverDatabase.cpp"
 #include "SoGLImage.cpp"
+#include "SoGLTextureAtlas.cpp"
 #include "SoGLNurbs.cpp"
 #include "SoOffscreenCGData.cpp"
 #include "SoOffscreenGLXData.cpp"
@@ -35,4 +36,5 @@
 #include "SoRenderManager.cpp"
 #include "SoRenderManagerP.cpp"
 #include "SoVBO.cpp"
+#include "SoGLResourceManager.cpp"
 #include "SoVertexArrayIndexer.cpp"
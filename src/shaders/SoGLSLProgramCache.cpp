@@ -0,0 +1,282 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include "shaders/SoGLSLProgramCache.h"
+
+#include <stdlib.h>
+
+#include <Inventor/C/tidbits.h>
+#include <Inventor/system/gl.h>
+
+#include "misc/SbHash.h"
+#include "shaders/SoGLSLProgramFile.h"
+#include "threads/threadsutilp.h"
+#include "tidbitsp.h"
+
+// *************************************************************************
+
+class soglslprogramcache_record {
+public:
+  SbString driver;
+  SbString key;
+  GLenum format;
+  unsigned char * data;
+  uint32_t size;
+  soglslprogramcache_record * next;
+};
+
+static void * soglslprogramcache_mutex = NULL;
+static SbHash<uint32_t, soglslprogramcache_record *> * soglslprogramcache_records = NULL;
+static SbString * soglslprogramcache_dir = NULL;
+static SbBool soglslprogramcache_enabled = TRUE;
+
+static void
+soglslprogramcache_cleanup(void)
+{
+  if (soglslprogramcache_records) {
+    for (SbHash<uint32_t, soglslprogramcache_record *>::const_iterator iter =
+           soglslprogramcache_records->const_begin();
+         iter != soglslprogramcache_records->const_end(); ++iter) {
+      soglslprogramcache_record * rec = iter->obj;
+      while (rec) {
+        soglslprogramcache_record * next = rec->next;
+        delete[] rec->data;
+        delete rec;
+        rec = next;
+      }
+    }
+    delete soglslprogramcache_records;
+    soglslprogramcache_records = NULL;
+  }
+  delete soglslprogramcache_dir;
+  soglslprogramcache_dir = NULL;
+  soglslprogramcache_enabled = TRUE;
+  CC_MUTEX_DESTRUCT(soglslprogramcache_mutex);
+}
+
+static SbString
+soglslprogramcache_driver(const cc_glglue * glue)
+{
+  SbString driver(glue->vendorstr ? glue->vendorstr : "");
+  driver += "\n";
+  driver += glue->rendererstr ? glue->rendererstr : "";
+  driver += "\n";
+  driver += glue->versionstr ? glue->versionstr : "";
+  return driver;
+}
+
+// returns a new record, or NULL if there is no valid file for the program
+static soglslprogramcache_record *
+soglslprogramcache_read_file(const SbString & dir, const SbString & driver,
+                             const SbString & key)
+{
+  uint32_t format = 0;
+  unsigned char * data = NULL;
+  uint32_t size = 0;
+  if (!SoGLSLProgramFile::read(SoGLSLProgramFile::getFilename(dir, driver, key),
+                               driver, key, format, data, size)) {
+    return NULL;
+  }
+  soglslprogramcache_record * rec = new soglslprogramcache_record;
+  rec->driver = driver;
+  rec->key = key;
+  rec->format = (GLenum) format;
+  rec->data = data;
+  rec->size = size;
+  rec->next = NULL;
+  return rec;
+}
+
+// must be called with the mutex locked
+static soglslprogramcache_record *
+soglslprogramcache_find(const uint32_t hash, const SbString & driver,
+                        const SbString & key)
+{
+  soglslprogramcache_record * rec = NULL;
+  if (soglslprogramcache_records->get(hash, rec)) {
+    while (rec && (rec->key != key || rec->driver != driver)) rec = rec->next;
+  }
+  return rec;
+}
+
+// must be called with the mutex locked. Replaces any record for the
+// same program and driver.
+static void
+soglslprogramcache_insert(const uint32_t hash, soglslprogramcache_record * rec)
+{
+  soglslprogramcache_record * first = NULL;
+  (void) soglslprogramcache_records->get(hash, first);
+  soglslprogramcache_record * prev = NULL;
+  soglslprogramcache_record * old = first;
+  while (old && (old->key != rec->key || old->driver != rec->driver)) {
+    prev = old;
+    old = old->next;
+  }
+  if (old) {
+    if (prev) prev->next = old->next;
+    else first = old->next;
+    delete[] old->data;
+    delete old;
+  }
+  rec->next = first;
+  soglslprogramcache_records->put(hash, rec);
+}
+
+// must be called with the mutex locked
+static void
+soglslprogramcache_erase(const uint32_t hash, const SbString & driver,
+                         const SbString & key)
+{
+  soglslprogramcache_record * first = NULL;
+  if (!soglslprogramcache_records->get(hash, first)) return;
+  soglslprogramcache_record * prev = NULL;
+  soglslprogramcache_record * rec = first;
+  while (rec && (rec->key != key || rec->driver != driver)) {
+    prev = rec;
+    rec = rec->next;
+  }
+  if (rec == NULL) return;
+  if (prev) prev->next = rec->next;
+  else first = rec->next;
+  delete[] rec->data;
+  delete rec;
+  if (first) soglslprogramcache_records->put(hash, first);
+  else soglslprogramcache_records->erase(hash);
+}
+
+// *************************************************************************
+
+void
+SoGLSLProgramCache::init(void)
+{
+  CC_MUTEX_CONSTRUCT(soglslprogramcache_mutex);
+  soglslprogramcache_records = new SbHash<uint32_t, soglslprogramcache_record *>;
+
+  const char * env = coin_getenv("COIN_SHADER_PROGRAM_CACHE");
+  if (env && atoi(env) == 0) soglslprogramcache_enabled = FALSE;
+  env = coin_getenv("COIN_SHADER_PROGRAM_CACHE_DIR");
+  if (env && env[0]) soglslprogramcache_dir = new SbString(env);
+
+  coin_atexit(soglslprogramcache_cleanup, CC_ATEXIT_NORMAL);
+}
+
+// Returns TRUE if program binaries can be used for the context.
+SbBool
+SoGLSLProgramCache::isEnabled(const cc_glglue * glue)
+{
+  return
+    soglslprogramcache_enabled && soglslprogramcache_records &&
+    cc_glglue_has_program_binary(glue);
+}
+
+// Loads the binary for the program identified by key into program,
+// which must be a new program object. Returns FALSE if there is no
+// binary, or if the driver rejected it. program must then be linked
+// from source.
+SbBool
+SoGLSLProgramCache::restore(const cc_glglue * glue, const SbString & key,
+                            COIN_GLhandle program)
+{
+  if (!SoGLSLProgramCache::isEnabled(glue)) return FALSE;
+
+  const SbString driver = soglslprogramcache_driver(glue);
+  const uint32_t hash = SbString::hash(key.getString());
+
+  CC_MUTEX_LOCK(soglslprogramcache_mutex);
+  soglslprogramcache_record * rec = soglslprogramcache_find(hash, driver, key);
+  if (rec == NULL && soglslprogramcache_dir) {
+    rec = soglslprogramcache_read_file(*soglslprogramcache_dir, driver, key);
+    if (rec) soglslprogramcache_insert(hash, rec);
+  }
+  GLint linked = 0;
+  if (rec) {
+    glue->glProgramBinary(program, rec->format, rec->data, (GLsizei) rec->size);
+    glue->glGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB, &linked);
+    if (!linked) {
+      // binaries are invalidated by driver updates. Forget it, and
+      // let the program be linked from source and stored again.
+      soglslprogramcache_erase(hash, driver, key);
+      while (glGetError() != GL_NO_ERROR) { }
+    }
+  }
+  CC_MUTEX_UNLOCK(soglslprogramcache_mutex);
+  return linked ? TRUE : FALSE;
+}
+
+// Stores the binary of program, which must have been successfully
+// linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void
+SoGLSLProgramCache::store(const cc_glglue * glue, const SbString & key,
+                          COIN_GLhandle program)
+{
+  if (!SoGLSLProgramCache::isEnabled(glue)) return;
+
+  GLint length = 0;
+  glue->glGetObjectParameterivARB(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return;
+
+  soglslprogramcache_record * rec = new soglslprogramcache_record;
+  rec->data = new unsigned char[length];
+  GLsizei written = 0;
+  rec->format = 0;
+  glue->glGetProgramBinary(program, length, &written, &rec->format, rec->data);
+  if (written <= 0) {
+    delete[] rec->data;
+    delete rec;
+    return;
+  }
+  rec->size = (uint32_t) written;
+  rec->driver = soglslprogramcache_driver(glue);
+  rec->key = key;
+  rec->next = NULL;
+
+  const uint32_t hash = SbString::hash(key.getString());
+  CC_MUTEX_LOCK(soglslprogramcache_mutex);
+  soglslprogramcache_insert(hash, rec);
+  if (soglslprogramcache_dir) {
+    (void) SoGLSLProgramFile::write(SoGLSLProgramFile::getFilename(*soglslprogramcache_dir,
+                                                                   rec->driver, key),
+                                    rec->driver, key, (uint32_t) rec->format,
+                                    rec->data, rec->size);
+  }
+  CC_MUTEX_UNLOCK(soglslprogramcache_mutex);
+}
+
+void
+SoGLSLProgramCache::setDirectory(const SbString & dir)
+{
+  CC_MUTEX_LOCK(soglslprogramcache_mutex);
+  delete soglslprogramcache_dir;
+  soglslprogramcache_dir = dir.getLength() ? new SbString(dir) : NULL;
+  CC_MUTEX_UNLOCK(soglslprogramcache_mutex);
+}
+
+SbString
+SoGLSLProgramCache::getDirectory(void)
+{
+  CC_MUTEX_LOCK(soglslprogramcache_mutex);
+  SbString dir = soglslprogramcache_dir ? *soglslprogramcache_dir : SbString();
+  CC_MUTEX_UNLOCK(soglslprogramcache_mutex);
+  return dir;
+}
+
@@ -0,0 +1,64 @@
+#ifndef COIN_SOGLSLPROGRAMCACHE_H
+#define COIN_SOGLSLPROGRAMCACHE_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#ifndef COIN_INTERNAL
+#error this is a private header file
+#endif
+
+// *************************************************************************
+
+#include <Inventor/SbString.h>
+
+#include "glue/glp.h"
+
+// *************************************************************************
+
+// Keeps the binaries of linked GLSL programs, so that a program which
+// has been linked before can be restored with glProgramBinary()
+// instead of compiling and linking its shaders again. Programs are
+// identified by a key holding the complete source of their shader
+// objects and their program parameters, and binaries are only used
+// with the driver which created them.
+//
+// Binaries are kept in memory for the lifetime of the process, and
+// are also written to the directory set with setDirectory(), so that
+// they can be used when the application is started again.
+
+class SoGLSLProgramCache {
+public:
+  static void init(void);
+
+  static SbBool isEnabled(const cc_glglue * glue);
+  static SbBool restore(const cc_glglue * glue, const SbString & key,
+                        COIN_GLhandle program);
+  static void store(const cc_glglue * glue, const SbString & key,
+                    COIN_GLhandle program);
+
+  static void setDirectory(const SbString & dir);
+  static SbString getDirectory(void);
+};
+
+#endif /* ! COIN_SOGLSLPROGRAMCACHE_H */
@@ -0,0 +1,324 @@
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+#include "shaders/SoGLSLProgramFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// *************************************************************************
+
+// File layout, all integers little endian:
+//
+//   8 bytes  magic "COINGLSL"
+//   uint32   binary format
+//   uint32   length of driver string
+//   uint32   length of key
+//   uint32   length of binary
+//   driver string, key and binary
+//
+// The driver string and key are stored in full, and are compared
+// when the file is read, so that a hash collision in the file name
+// can never cause the wrong program to be used.
+
+#define SOGLSLPROGRAMFILE_HEADERSIZE 24
+
+static void
+soglslprogramfile_write32(unsigned char * dst, const uint32_t val)
+{
+  dst[0] = (unsigned char) (val & 0xff);
+  dst[1] = (unsigned char) ((val >> 8) & 0xff);
+  dst[2] = (unsigned char) ((val >> 16) & 0xff);
+  dst[3] = (unsigned char) ((val >> 24) & 0xff);
+}
+
+static uint32_t
+soglslprogramfile_read32(const unsigned char * src)
+{
+  return
+    (uint32_t) src[0] | ((uint32_t) src[1] << 8) |
+    ((uint32_t) src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+static SbBool
+soglslprogramfile_read_string(FILE * fp, const uint32_t len, const SbString & expected)
+{
+  if (len != (uint32_t) expected.getLength()) return FALSE;
+  char * buf = new char[len + 1];
+  const SbBool ok =
+    fread(buf, 1, len, fp) == len &&
+    memcmp(buf, expected.getString(), len) == 0;
+  delete[] buf;
+  return ok;
+}
+
+// *************************************************************************
+
+// Returns the name of the file for the program identified by driver
+// and key in dir. The name is a 64 bit FNV-1a hash of driver and key.
+SbString
+SoGLSLProgramFile::getFilename(const SbString & dir, const SbString & driver,
+                               const SbString & key)
+{
+  uint64_t h = (uint64_t(0xcbf29ce4) << 32) | 0x84222325;
+  const SbString * strings[2] = { &driver, &key };
+  for (int s = 0; s < 2; s++) {
+    const unsigned char * p = (const unsigned char *) strings[s]->getString();
+    const int len = strings[s]->getLength();
+    for (int i = 0; i < len; i++) {
+      h ^= p[i];
+      h *= (uint64_t(0x100) << 32) | 0x1b3;
+    }
+  }
+  SbString name;
+  name.sprintf("%s/coin-%08x%08x.glsl", dir.getString(),
+               (unsigned int) (h >> 32), (unsigned int) (h & 0xffffffff));
+  return name;
+}
+
+// Reads the binary of the program identified by driver and key from
+// filename. On success, data is set to a new array of size bytes,
+// which the caller must delete. Returns FALSE if the file does not
+// exist, is not a valid program file, or was written for another
+// program or driver.
+SbBool
+SoGLSLProgramFile::read(const SbString & filename, const SbString & driver,
+                        const SbString & key, uint32_t & format,
+                        unsigned char *& data, uint32_t & size)
+{
+  FILE * fp = fopen(filename.getString(), "rb");
+  if (!fp) return FALSE;
+
+  SbBool ok = FALSE;
+  unsigned char header[SOGLSLPROGRAMFILE_HEADERSIZE];
+  if (fread(header, 1, SOGLSLPROGRAMFILE_HEADERSIZE, fp) == SOGLSLPROGRAMFILE_HEADERSIZE &&
+      memcmp(header, "COINGLSL", 8) == 0) {
+    const uint32_t driverlen = soglslprogramfile_read32(header + 12);
+    const uint32_t keylen = soglslprogramfile_read32(header + 16);
+    const uint32_t datalen = soglslprogramfile_read32(header + 20);
+
+    // check the lengths in the header against the length of the
+    // file before anything is allocated, so that a truncated or
+    // corrupt file is rejected instead of making us allocate
+    // whatever the header says
+    const uint64_t expected = uint64_t(SOGLSLPROGRAMFILE_HEADERSIZE) +
+      uint64_t(driverlen) + uint64_t(keylen) + uint64_t(datalen);
+    long filelen = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) filelen = ftell(fp);
+
+    if (datalen > 0 && filelen >= 0 && uint64_t(filelen) == expected &&
+        fseek(fp, SOGLSLPROGRAMFILE_HEADERSIZE, SEEK_SET) == 0 &&
+        soglslprogramfile_read_string(fp, driverlen, driver) &&
+        soglslprogramfile_read_string(fp, keylen, key)) {
+      unsigned char * buf = new unsigned char[datalen];
+      if (fread(buf, 1, datalen, fp) == datalen) {
+        format = soglslprogramfile_read32(header + 8);
+        data = buf;
+        size = datalen;
+        ok = TRUE;
+      }
+      else {
+        delete[] buf;
+      }
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+// Writes the binary of the program identified by driver and key to
+// filename. The file is written to a temporary file first, and then
+// renamed, so that other processes never see a partially written
+// file.
+SbBool
+SoGLSLProgramFile::write(const SbString & filename, const SbString & driver,
+                         const SbString & key, const uint32_t format,
+                         const unsigned char * data, const uint32_t size)
+{
+  SbString tmpname(filename);
+  tmpname += ".tmp";
+  FILE * fp = fopen(tmpname.getString(), "wb");
+  if (!fp) return FALSE;
+
+  unsigned char header[SOGLSLPROGRAMFILE_HEADERSIZE];
+  memcpy(header, "COINGLSL", 8);
+  soglslprogramfile_write32(header + 8, format);
+  soglslprogramfile_write32(header + 12, (uint32_t) driver.getLength());
+  soglslprogramfile_write32(header + 16, (uint32_t) key.getLength());
+  soglslprogramfile_write32(header + 20, size);
+
+  SbBool ok =
+    fwrite(header, 1, SOGLSLPROGRAMFILE_HEADERSIZE, fp) == SOGLSLPROGRAMFILE_HEADERSIZE &&
+    fwrite(driver.getString(), 1, driver.getLength(), fp) ==
+    (size_t) driver.getLength() &&
+    fwrite(key.getString(), 1, key.getLength(), fp) ==
+    (size_t) key.getLength() &&
+    fwrite(data, 1, size, fp) == size;
+  if (fclose(fp) != 0) ok = FALSE;
+
+  if (ok) {
+    (void) remove(filename.getString());
+    ok = rename(tmpname.getString(), filename.getString()) == 0;
+  }
+  if (!ok) (void) remove(tmpname.getString());
+  return ok;
+}
+
+#undef SOGLSLPROGRAMFILE_HEADERSIZE
+
+// *************************************************************************
+
+#ifdef COIN_TEST_SUITE
+#ifdef COIN_INT_TEST_SUITE
+
+#include <stdlib.h>
+#include <string.h>
+
+static SbString
+soglslprogramfile_test_dir(void)
+{
+  const char * dir = getenv("TMPDIR");
+  if (dir == NULL || dir[0] == '\0') dir = getenv("TEMP");
+  return SbString((dir && dir[0]) ? dir : "/tmp");
+}
+
+// reads the whole file into buf, which is returned with the length
+static long
+soglslprogramfile_test_slurp(const SbString & filename, unsigned char * buf, long max)
+{
+  FILE * fp = fopen(filename.getString(), "rb");
+  if (!fp) return -1;
+  const long len = (long) fread(buf, 1, max, fp);
+  fclose(fp);
+  return len;
+}
+
+static void
+soglslprogramfile_test_spill(const SbString & filename, const unsigned char * buf, long len)
+{
+  FILE * fp = fopen(filename.getString(), "wb");
+  if (!fp) return;
+  (void) fwrite(buf, 1, len, fp);
+  fclose(fp);
+}
+
+static const unsigned char soglslprogramfile_test_binary[] = {
+  0x00, 0x01, 0x02, 0x03, 0xfe, 0xff, 0x80, 0x7f, 0x10, 0x20, 0x30
+};
+
+BOOST_AUTO_TEST_CASE(roundTrip)
+{
+  const SbString driver("vendor\nrenderer\n4.6");
+  const SbString key("void main(void) { gl_FragColor = vec4(1.0); }");
+  const SbString filename =
+    SoGLSLProgramFile::getFilename(soglslprogramfile_test_dir(), driver, key);
+  const uint32_t size = sizeof(soglslprogramfile_test_binary);
+
+  BOOST_REQUIRE(SoGLSLProgramFile::write(filename, driver, key, 0x8741,
+                                         soglslprogramfile_test_binary, size));
+
+  uint32_t format = 0;
+  unsigned char * data = NULL;
+  uint32_t datalen = 0;
+  BOOST_REQUIRE(SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+  BOOST_CHECK_EQUAL(format, (uint32_t) 0x8741);
+  BOOST_CHECK_EQUAL(datalen, size);
+  BOOST_CHECK(memcmp(data, soglslprogramfile_test_binary, size) == 0);
+  delete[] data;
+
+  // a file written for another driver or another program is not used
+  data = NULL;
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, SbString("vendor\nrenderer\n4.5"),
+                                       key, format, data, datalen));
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, SbString("void main(void) { }"),
+                                       format, data, datalen));
+  BOOST_CHECK(data == NULL);
+
+  (void) remove(filename.getString());
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+}
+
+BOOST_AUTO_TEST_CASE(corruptFiles)
+{
+  const SbString driver("vendor\nrenderer\n4.6");
+  const SbString key("void main(void) { gl_FragColor = vec4(0.0); }");
+  const SbString filename =
+    SoGLSLProgramFile::getFilename(soglslprogramfile_test_dir(), driver, key);
+  const uint32_t size = sizeof(soglslprogramfile_test_binary);
+
+  BOOST_REQUIRE(SoGLSLProgramFile::write(filename, driver, key, 0x8741,
+                                         soglslprogramfile_test_binary, size));
+  unsigned char file[256];
+  const long filelen = soglslprogramfile_test_slurp(filename, file, sizeof(file));
+  BOOST_REQUIRE_EQUAL(filelen, (long) (24 + driver.getLength() + key.getLength() + size));
+
+  unsigned char corrupt[256];
+  uint32_t format = 0;
+  unsigned char * data = NULL;
+  uint32_t datalen = 0;
+
+  // bad magic
+  memcpy(corrupt, file, filelen);
+  corrupt[0] = 'X';
+  soglslprogramfile_test_spill(filename, corrupt, filelen);
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+
+  // truncated binary
+  soglslprogramfile_test_spill(filename, file, filelen - 1);
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+
+  // truncated header
+  soglslprogramfile_test_spill(filename, file, 10);
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+
+  // trailing garbage
+  memcpy(corrupt, file, filelen);
+  corrupt[filelen] = 0;
+  soglslprogramfile_test_spill(filename, corrupt, filelen + 1);
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+
+  // binary length far beyond the end of the file, which must be
+  // rejected without being allocated
+  memcpy(corrupt, file, filelen);
+  corrupt[20] = corrupt[21] = corrupt[22] = corrupt[23] = 0xff;
+  soglslprogramfile_test_spill(filename, corrupt, filelen);
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+
+  // empty binary
+  memcpy(corrupt, file, filelen);
+  corrupt[20] = corrupt[21] = corrupt[22] = corrupt[23] = 0;
+  soglslprogramfile_test_spill(filename, corrupt, filelen - size);
+  BOOST_CHECK(!SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+
+  BOOST_CHECK(data == NULL);
+
+  // the intact file is still accepted
+  soglslprogramfile_test_spill(filename, file, filelen);
+  BOOST_CHECK(SoGLSLProgramFile::read(filename, driver, key, format, data, datalen));
+  delete[] data;
+
+  (void) remove(filename.getString());
+}
+
+#endif // COIN_INT_TEST_SUITE
+#endif // COIN_TEST_SUITE
@@ -0,0 +1,53 @@
+#ifndef COIN_SOGLSLPROGRAMFILE_H
+#define COIN_SOGLSLPROGRAMFILE_H
+
+/**************************************************************************\
+ *
+ *  This file is part of the Coin 3D visualization library.
+ *  Copyright (C) by Kongsberg Oil & Gas Technologies.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  ("GPL") version 2 as published by the Free Software Foundation.
+ *  See the file LICENSE.GPL at the root directory of this source
+ *  distribution for additional information about the GNU GPL.
+ *
+ *  For using Coin with software that can not be combined with the GNU
+ *  GPL, and for taking advantage of the additional benefits of our
+ *  support services, please contact Kongsberg Oil & Gas Technologies
+ *  about acquiring a Coin Professional Edition License.
+ *
+ *  See http://www.coin3d.org/ for more information.
+ *
+ *  Kongsberg Oil & Gas Technologies, Bygdoy Alle 5, 0257 Oslo, NORWAY.
+ *  http://www.sim.no/  sales@sim.no  coin-support@coin3d.org
+ *
+\**************************************************************************/
+
+// This header does not check for COIN_INTERNAL, and uses no GL
+// types, so that the internal test suite can include it.
+
+// *************************************************************************
+
+#include <Inventor/SbString.h>
+#include <Inventor/system/inttypes.h>
+
+// *************************************************************************
+
+// Reads and writes the files in which SoGLSLProgramCache stores the
+// binaries of linked GLSL programs.
+
+class SoGLSLProgramFile {
+public:
+  static SbString getFilename(const SbString & dir, const SbString & driver,
+                              const SbString & key);
+
+  static SbBool read(const SbString & filename, const SbString & driver,
+                     const SbString & key, uint32_t & format,
+                     unsigned char *& data, uint32_t & size);
+  static SbBool write(const SbString & filename, const SbString & driver,
+                      const SbString & key, const uint32_t format,
+                      const unsigned char * data, const uint32_t size);
+};
+
+#endif /* ! COIN_SOGLSLPROGRAMFILE_H */
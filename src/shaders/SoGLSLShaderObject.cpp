@@ -44,6 +44,8 @@ SoGLSLShaderObject::SoGLSLShaderObject(const uint32_t cachecontext)
   this->shaderHandle = 0;
   this->isattached = FALSE;
   this->programid = 0;
+  this->compilefailed = FALSE;
+  this->islinked = FALSE;
 }
 
 SoGLSLShaderObject::~SoGLSLShaderObject()
@@ -66,7 +68,7 @@ SoGLSLShaderObject::shaderType(void) const
 SbBool
 SoGLSLShaderObject::isLoaded(void) const
 {
-  return (this->shaderHandle != 0);
+  return (this->source.getLength() > 0) && !this->compilefailed;
 }
 
 void
@@ -75,7 +77,22 @@ SoGLSLShaderObject::load(const char* srcStr)
   this->unload();
   this->setParametersDirty(TRUE);
 
-  GLint flag;
+  this->source = srcStr ? srcStr : "";
+  this->compilefailed = FALSE;
+  this->programid = soglshaderobject_idcounter++;
+}
+
+const SbString &
+SoGLSLShaderObject::getSource(void) const
+{
+  return this->source;
+}
+
+void
+SoGLSLShaderObject::compile(void)
+{
+  if (this->shaderHandle || this->compilefailed) return;
+
   GLenum sType;
 
   switch (this->getShaderType()) {
@@ -93,26 +110,50 @@ SoGLSLShaderObject::load(const char* srcStr)
   }
 
   this->shaderHandle = this->glctx->glCreateShaderObjectARB(sType);
-  this->programid = 0;
-
-  if (this->shaderHandle == 0) return;
-  this->programid = soglshaderobject_idcounter++;
+  if (this->shaderHandle == 0) {
+    this->compilefailed = TRUE;
+    return;
+  }
 
+  const char * srcStr = this->source.getString();
   this->glctx->glShaderSourceARB(this->shaderHandle, 1, (const COIN_GLchar **)&srcStr, NULL);
   this->glctx->glCompileShaderARB(this->shaderHandle);
 
   if (SoGLSLShaderObject::didOpenGLErrorOccur("SoGLSLShaderObject::load()")) {
     this->shaderHandle = 0;
+    this->compilefailed = TRUE;
     return;
   }
 
+  // with parallel shader compilation, the status is checked after
+  // the program has been linked, so that we don't wait for the
+  // compiler here
+  if (!cc_glglue_has_parallel_shader_compile(this->glctx)) {
+    (void) this->checkCompileStatus();
+  }
+}
+
+// Returns FALSE, and prints the compiler log, if the source failed
+// to compile.
+SbBool
+SoGLSLShaderObject::checkCompileStatus(void)
+{
+  if (this->shaderHandle == 0) return !this->compilefailed;
+
+  GLint flag = 0;
   this->glctx->glGetObjectParameterivARB(this->shaderHandle,
                                          GL_OBJECT_COMPILE_STATUS_ARB,
                                          &flag);
   SoGLSLShaderObject::printInfoLog(this->GLContext(), this->shaderHandle,
                                    this->getShaderType());
 
-  if (!flag) this->shaderHandle = 0;
+  if (!flag) {
+    this->detach();
+    this->glctx->glDeleteObjectARB(this->shaderHandle);
+    this->shaderHandle = 0;
+    this->compilefailed = TRUE;
+  }
+  return flag ? TRUE : FALSE;
 }
 
 void
@@ -123,6 +164,8 @@ SoGLSLShaderObject::unload(void)
   this->shaderHandle = 0;
   this->programHandle = 0;
   this->programid = 0;
+  this->source.makeEmpty();
+  this->compilefailed = FALSE;
 }
 
 SoGLShaderParameter *
@@ -139,24 +182,49 @@ SoGLSLShaderObject::attach(COIN_GLhandle programHandle)
   if (programHandle <= 0 || this->programHandle == programHandle) return;
 
   detach();
+  this->compile();
 
   if (this->shaderHandle) {
     this->programHandle = programHandle;
     this->glctx->glAttachObjectARB(this->programHandle, this->shaderHandle);
     this->isattached = TRUE;
+    this->islinked = FALSE;
   }
 }
 
+// Used instead of attach() when the program has been restored from
+// a binary. The source is then never compiled.
+void
+SoGLSLShaderObject::attachLinked(COIN_GLhandle programHandle)
+{
+  detach();
+  this->programHandle = programHandle;
+  this->isattached = TRUE;
+  this->setLinked(TRUE);
+}
+
 void
 SoGLSLShaderObject::detach(void)
 {
-  if (this->isattached && this->programHandle && this->shaderHandle) {
-    this->glctx->glDetachObjectARB(this->programHandle, this->shaderHandle);
+  if (this->isattached) {
+    if (this->programHandle && this->shaderHandle) {
+      this->glctx->glDetachObjectARB(this->programHandle, this->shaderHandle);
+    }
     this->isattached = FALSE;
+    this->islinked = FALSE;
     this->programHandle = 0;
   }
 }
 
+// Called by the program when linking has finished. Parameters set
+// while the program was linking are sent again.
+void
+SoGLSLShaderObject::setLinked(const SbBool linked)
+{
+  if (linked && !this->islinked) this->setParametersDirty(TRUE);
+  this->islinked = linked;
+}
+
 SbBool
 SoGLSLShaderObject::isAttached(void) const
 {
@@ -228,7 +296,7 @@ void
 SoGLSLShaderObject::updateCoinParameter(SoState * COIN_UNUSED_ARG(state), const SbName & name, SoShaderParameter * param, const int value)
 {
   COIN_GLhandle pHandle = this->programHandle;
-  if (pHandle) {
+  if (pHandle && this->islinked) {
     const cc_glglue * glue = this->GLContext();
 
     // FIXME: set up a dict for the supported Coin variables
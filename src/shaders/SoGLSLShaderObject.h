@@ -54,9 +54,14 @@ public:
   virtual void unload(void);
 
   void attach(COIN_GLhandle programHandle);
+  void attachLinked(COIN_GLhandle programHandle);
   void detach(void);
   SbBool isAttached(void) const;
 
+  const SbString & getSource(void) const;
+  SbBool checkCompileStatus(void);
+  void setLinked(const SbBool linked);
+
   // source should be the name of the calling function
   static SbBool didOpenGLErrorOccur(const SbString & source);
   static void printInfoLog(const cc_glglue * g, COIN_GLhandle handle, int objType);
@@ -64,10 +69,18 @@ public:
   virtual void updateCoinParameter(SoState * state, const SbName & name, SoShaderParameter * param, const int value);
 
 private:
+  void compile(void);
+
   COIN_GLhandle programHandle;
   COIN_GLhandle shaderHandle;
   SbBool isattached;
   int32_t programid;
+  // the source is compiled when the program is linked, and not at
+  // all if the program can be restored from a binary
+  SbString source;
+  SbBool compilefailed;
+  // parameters can't be set until the program has finished linking
+  SbBool islinked;
 };
 
 #endif /* ! COIN_SOGLSLSHADEROBJECT_H */
@@ -224,6 +224,9 @@ SoGLSLShaderParameter::isValid(const SoGLShaderObject * shader,
   
   COIN_GLhandle pHandle = ((SoGLSLShaderObject*)shader)->programHandle;
   int32_t pId = ((SoGLSLShaderObject*)shader)->programid;
+
+  // the parameters are sent again when the program has been linked
+  if (!((SoGLSLShaderObject*)shader)->islinked) return FALSE;
   
   // return TRUE if uniform isn't active. We warned the user about
   // this when we found it to be inactive.
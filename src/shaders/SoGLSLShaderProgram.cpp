@@ -27,6 +27,7 @@
 #include <Inventor/misc/SoContextHandler.h>
 
 #include "shaders/SoGLSLShaderObject.h"
+#include "shaders/SoGLSLProgramCache.h"
 #include <Inventor/errors/SoDebugError.h>
 #include "glue/glp.h"
 
@@ -42,6 +43,7 @@ SoGLSLShaderProgram::SoGLSLShaderProgram(void)
 {
   this->isExecutable = FALSE;
   this->neededlinking = TRUE;
+  this->linkpending = FALSE;
   SoContextHandler::addContextDestructionCallback(context_destruction_cb, this);
 }
 
@@ -101,6 +103,7 @@ SoGLSLShaderProgram::enable(const cc_glglue * g)
 {
   this->neededlinking = FALSE;
   this->ensureLinking(g);
+  if (this->linkpending) this->checkLinking(g, FALSE);
 
   if (this->isExecutable) {
     COIN_GLhandle programhandle = this->getProgramHandle(g, TRUE);
@@ -151,6 +154,7 @@ SoGLSLShaderProgram::ensureLinking(const cc_glglue * g)
   this->deleteProgram(g);
 
   this->isExecutable = FALSE;
+  this->linkpending = FALSE;
 
   COIN_GLhandle programHandle = this->getProgramHandle(g, TRUE);
 
@@ -158,7 +162,18 @@ SoGLSLShaderProgram::ensureLinking(const cc_glglue * g)
 
   if (cnt > 0) {
     int i;
-    GLint didLink = 0;
+
+    // programs which have been linked before, in this or an earlier
+    // run, are restored without compiling the shaders
+    this->linkkey = this->getProgramKey();
+    if (SoGLSLProgramCache::restore(g, this->linkkey, programHandle)) {
+      for (i = 0; i < cnt; i++) {
+        this->shaderObjects[i]->attachLinked(programHandle);
+      }
+      this->isExecutable = TRUE;
+      this->neededlinking = TRUE;
+      return;
+    }
 
     for (i = 0; i < cnt; i++) {
       this->shaderObjects[i]->attach(programHandle);
@@ -170,18 +185,84 @@ SoGLSLShaderProgram::ensureLinking(const cc_glglue * g)
                                 this->programParameters[i+1]);
 
     }
+    if (SoGLSLProgramCache::isEnabled(g)) {
+      g->glProgramParameteri(programHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
 
     g->glLinkProgramARB(programHandle);
 
     if (SoGLSLShaderObject::didOpenGLErrorOccur("SoGLSLShaderProgram::ensureLinking")) {
       SoGLSLShaderObject::printInfoLog(g, programHandle, 0);
     }
-    g->glGetObjectParameterivARB(programHandle,
-                                 GL_OBJECT_LINK_STATUS_ARB,&didLink);
 
-    this->isExecutable = didLink;
-    this->neededlinking = TRUE;
+    // with parallel shader compilation, the program is used from the
+    // first frame after the driver has finished linking it
+    this->linkpending = TRUE;
+    this->checkLinking(g, !cc_glglue_has_parallel_shader_compile(g));
+  }
+}
+
+// Checks if the program has finished linking. If wait is FALSE and
+// the driver is still compiling or linking, linkpending stays TRUE.
+void
+SoGLSLShaderProgram::checkLinking(const cc_glglue * g, const SbBool wait)
+{
+  COIN_GLhandle programHandle = this->getProgramHandle(g);
+  if (programHandle == 0) {
+    this->linkpending = FALSE;
+    return;
+  }
+
+  if (!wait) {
+    GLint done = 0;
+    g->glGetObjectParameterivARB(programHandle, GL_COMPLETION_STATUS_KHR, &done);
+    if (!done) return;
+  }
+  this->linkpending = FALSE;
+
+  GLint didLink = 0;
+  g->glGetObjectParameterivARB(programHandle,
+                               GL_OBJECT_LINK_STATUS_ARB,&didLink);
+
+  int i, cnt = this->shaderObjects.getLength();
+  if (!didLink) {
+    // report compile errors that were not checked for when the
+    // shaders were compiled
+    for (i = 0; i < cnt; i++) (void) this->shaderObjects[i]->checkCompileStatus();
+    SoGLSLShaderObject::printInfoLog(g, programHandle, 0);
+  }
+  else {
+    SoGLSLProgramCache::store(g, this->linkkey, programHandle);
+  }
+  for (i = 0; i < cnt; i++) this->shaderObjects[i]->setLinked(didLink);
+
+  this->isExecutable = didLink;
+  this->neededlinking = TRUE;
+}
+
+// Returns a string which identifies the linked program: the source
+// and type of all shader objects, and the program parameters.
+SbString
+SoGLSLShaderProgram::getProgramKey(void) const
+{
+  SbString key;
+  int i;
+  for (i = 0; i < this->shaderObjects.getLength(); i++) {
+    const SoGLSLShaderObject * obj = this->shaderObjects[i];
+    SbString header;
+    header.sprintf("shader %d %d\n", (int) obj->getShaderType(),
+                   obj->getSource().getLength());
+    key += header;
+    key += obj->getSource();
+    key += "\n";
+  }
+  for (i = 0; i < this->programParameters.getLength(); i += 2) {
+    SbString param;
+    param.sprintf("parameter %d %d\n", this->programParameters[i],
+                  this->programParameters[i+1]);
+    key += param;
   }
+  return key;
 }
 
 int
@@ -219,6 +300,12 @@ SoGLSLShaderProgram::neededLinking(void) const
   return this->neededlinking;
 }
 
+SbBool
+SoGLSLShaderProgram::isLinkPending(void) const
+{
+  return this->linkpending;
+}
+
 void
 SoGLSLShaderProgram::context_destruction_cb(uint32_t cachecontext, void * userdata)
 {
@@ -30,6 +30,7 @@
 
 // *************************************************************************
 
+#include <Inventor/SbString.h>
 #include <Inventor/lists/SbList.h>
 
 #include "misc/SbHash.h"
@@ -64,6 +65,7 @@ public:
 
   COIN_GLhandle getProgramHandle(const cc_glglue * g, const SbBool create = FALSE);
   SbBool neededLinking(void) const;
+  SbBool isLinkPending(void) const;
 
 protected:
   SbList <int> programParameters;
@@ -72,9 +74,13 @@ protected:
 
   SbBool isExecutable;
   SbBool neededlinking;
+  SbBool linkpending;
+  SbString linkkey;
 
   int indexOfShaderObject(SoGLSLShaderObject * shaderObject);
   void ensureLinking(const cc_glglue * g);
+  void checkLinking(const cc_glglue * g, const SbBool wait);
+  SbString getProgramKey(void) const;
   void ensureProgramHandle(const cc_glglue * g);
 
 private:
@@ -169,6 +169,17 @@ SoGLShaderProgram::glslShaderProgramLinked(void) const
   return FALSE;
 }
 
+// Returns TRUE if the GLSL program is still being linked by the
+// driver, and can't be used yet.
+SbBool
+SoGLShaderProgram::isLinkPending(void) const
+{
+  if (this->glslShaderProgram) {
+    return this->glslShaderProgram->isLinkPending();
+  }
+  return FALSE;
+}
+
 #if defined(SOURCE_HINT)
 SbString
 SoGLShaderProgram::getSourceHint(void)
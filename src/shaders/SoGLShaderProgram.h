@@ -66,6 +66,7 @@ public:
   void getShaderObjectIds(SbList <uint32_t> & ids) const;
   uint32_t getGLSLShaderProgramHandle(SoState * state) const;
   SbBool glslShaderProgramLinked(void) const;
+  SbBool isLinkPending(void) const;
 private:
 
   class SoGLARBShaderProgram * arbShaderProgram;
@@ -169,6 +169,7 @@
 */
 
 #include "shaders/SoShader.h"
+#include "shaders/SoGLSLProgramCache.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -306,6 +307,8 @@ SoShader::init(void)
   shader_builtin_dict = new SbHash<const char *, char *>;
   setupBuiltinShaders();
 
+  SoGLSLProgramCache::init();
+
   coin_atexit((coin_atexit_f*) soshader_cleanup, CC_ATEXIT_NORMAL);
 }
 
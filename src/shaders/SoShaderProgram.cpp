@@ -180,6 +180,16 @@
     }
   \endcode
 
+  GLSL programs are compiled and linked the first time they are
+  rendered. If the OpenGL driver supports GL_ARB_get_program_binary,
+  the linked binary is kept, and programs with the same shader
+  sources are later restored from it without compiling the shaders
+  again. With setProgramCacheDirectory(), the binaries are also
+  written to disk, so that this works across runs of the
+  application. If the driver supports GL_KHR_parallel_shader_compile,
+  shaders are compiled and linked without blocking rendering, and the
+  program is used from the first frame after the driver has finished.
+
   \sa SoShaderObject
   \sa SoShaderProgram
   \since Coin 2.5
@@ -205,9 +215,11 @@
 #include <Inventor/elements/SoGLShaderProgramElement.h>
 #include <Inventor/nodes/SoShaderObject.h>
 #include <Inventor/sensors/SoNodeSensor.h>
+#include <Inventor/sensors/SoTimerSensor.h>
 
 #include "nodes/SoSubNodeP.h"
 #include "shaders/SoGLShaderProgram.h"
+#include "shaders/SoGLSLProgramCache.h"
 
 // *************************************************************************
 
@@ -227,7 +239,10 @@ private:
   SoGLShaderProgram glShaderProgram;
 
   static void sensorCB(void * data, SoSensor *);
+  static void timerSensorCB(void * data, SoSensor *);
   SoNodeSensor * sensor;
+  // polls for the driver to finish linking the program
+  SoTimerSensor * timersensor;
 };
 
 #define PRIVATE(p) ((p)->pimpl)
@@ -313,6 +328,39 @@ SoShaderProgram::search(SoSearchAction * action)
 #endif // disabled
 }
 
+/*!
+  Sets the directory where binaries of linked GLSL programs are
+  stored. Programs are restored from these files when the application
+  is started again, instead of compiling the shaders, as long as the
+  same OpenGL driver is used. Files from other drivers or driver
+  versions are ignored and replaced. An empty string disables the
+  disk cache, which is the default.
+
+  The directory can also be set with the environment variable \c
+  COIN_SHADER_PROGRAM_CACHE_DIR. Program binaries are not used at all
+  if \c COIN_SHADER_PROGRAM_CACHE is set to 0.
+
+  \since Coin 4.0
+*/
+void
+SoShaderProgram::setProgramCacheDirectory(const SbString & dir)
+{
+  SoGLSLProgramCache::setDirectory(dir);
+}
+
+/*!
+  Returns the directory where binaries of linked GLSL programs are
+  stored, or an empty string if they are not stored on disk.
+
+  \since Coin 4.0
+  \sa setProgramCacheDirectory()
+*/
+SbString
+SoShaderProgram::getProgramCacheDirectory(void)
+{
+  return SoGLSLProgramCache::getDirectory();
+}
+
 /*!
   Adds a callback which is called every time this program is enabled/disabled.
 */
@@ -331,10 +379,13 @@ SoShaderProgramP::SoShaderProgramP(SoShaderProgram * ownerptr)
   PUBLIC(this) = ownerptr;
   this->sensor = new SoNodeSensor(SoShaderProgramP::sensorCB, this);
   this->sensor->attach(ownerptr);
+  this->timersensor = new SoTimerSensor(SoShaderProgramP::timerSensorCB, this);
+  this->timersensor->setInterval(SbTime(0.05));
 }
 
 SoShaderProgramP::~SoShaderProgramP()
 {
+  delete this->timersensor;
   delete this->sensor;
 }
 
@@ -368,6 +419,12 @@ SoShaderProgramP::GLRender(SoGLRenderAction * action)
   // enable shader after all shader objects have been loaded
   SoGLShaderProgramElement::enable(state, TRUE);
 
+  // redraw when the driver has linked the program
+  if (this->glShaderProgram.isLinkPending() &&
+      !this->timersensor->isScheduled()) {
+    this->timersensor->schedule();
+  }
+
   // update parameters after all shader objects have been added and enabled
 
   for (i = 0; i <cnt; i++) {
@@ -384,6 +441,15 @@ SoShaderProgramP::sensorCB(void * COIN_UNUSED_ARG(data), SoSensor *)
   // nothing to do now
 }
 
+void
+SoShaderProgramP::timerSensorCB(void * data, SoSensor *)
+{
+  SoShaderProgramP * thisp = (SoShaderProgramP *) data;
+  thisp->timersensor->unschedule();
+  // the link status is checked when the program is rendered
+  PUBLIC(thisp)->touch();
+}
+
 #undef PRIVATE
 #undef PUBLIC
 
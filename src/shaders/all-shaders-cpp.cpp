@@ -30,6 +30,8 @@
 #include "SoGLSLShaderObject.cpp"
 #include "SoGLSLShaderParameter.cpp"
 #include "SoGLSLShaderProgram.cpp"
+#include "SoGLSLProgramCache.cpp"
+#include "SoGLSLProgramFile.cpp"
 #include "SoGLShaderObject.cpp"
 #include "SoGLShaderParameter.cpp"
 #include "SoGLShaderProgram.cpp"
@@ -118,6 +118,8 @@
 #include "soshape_trianglesort.h"
 #include "soshape_bigtexture.h"
 #include "soshape_bumprender.h"
+#include "caches/SoGLRenderCacheP.h"
+#include "caches/SoTriangleBVHCache.h"
 
 // *************************************************************************
 
@@ -165,6 +167,8 @@ public:
   SoShapeP() {
     this->bboxcache = NULL;
     this->pvcache = NULL;
+    this->bvhcache = NULL;
+    this->bvhaction = NULL;
     this->bumprender = NULL;
     this->rendercnt = 0;
     this->flags = 0;
@@ -172,6 +176,7 @@ public:
   ~SoShapeP() {
     if (this->bboxcache) { this->bboxcache->unref(); }
     if (this->pvcache) { this->pvcache->unref(); }
+    if (this->bvhcache) { this->bvhcache->unref(); }
     delete this->bumprender;
   }
   enum {
@@ -182,12 +187,17 @@ public:
     SHOULD_BBOX_CACHE = 0x1,
     NEED_SETUP_SHAPE_HINTS = 0x2,
     DISABLE_VERTEX_ARRAY_CACHE = 0x4,
+    // set when picked or selected since the last change
+    SHOULD_BVH_CACHE = 0x8
   };
 
   static void calibrateBBoxCache(void);
   static double bboxcachetimelimit;
   SoBoundingBoxCache * bboxcache;
   SoPrimitiveVertexCache * pvcache;
+  SoTriangleBVHCache * bvhcache;
+  // the action the bvhcache is being made for
+  SoAction * bvhaction;
   soshape_bumprender * bumprender;
   uint32_t flags : FLAG_BITS;
   // stores the number of frames rendered with no node changes
@@ -254,7 +264,8 @@ enum SoShapeRenderMode {
   NORMAL,
   BIGTEXTURE,
   SORTED_TRIANGLES,
-  PVCACHE
+  PVCACHE,
+  RENDERCACHE
 };
 
 typedef struct {
@@ -266,10 +277,42 @@ typedef struct {
   soshape_bigtexture * currentbigtexture;
   // used in generatePrimitives() callbacks to set correct material
   SoMaterialBundle * currentbundle;
+  // vertex buffer render cache being recorded
+  SoGLRenderCacheP * rendercache;
 
   int rendermode;
 } soshape_staticdata;
 
+// Adds an estimate of the memory used by a shape to the display list
+// render cache being recorded, for SoGLResourceManager. The memory
+// used by display lists can't be queried from OpenGL.
+static void
+soshape_estimate_dlsize(SoShape * shape, SoState * state)
+{
+  SoGLRenderCache * cache =
+    dynamic_cast<SoGLRenderCache *>(SoCacheElement::getCurrentCache(state));
+  if (cache == NULL || cache->getBackend() != SoGLRenderCache::DISPLAY_LIST) return;
+
+  int numvertices = 0;
+  if (shape->isOfType(SoVertexShape::getClassTypeId())) {
+    const SoVertexProperty * vp =
+      (const SoVertexProperty *) ((SoVertexShape*)shape)->vertexProperty.getValue();
+    if (vp) {
+      numvertices = vp->vertex.getNum();
+    }
+    else {
+      // don't use SoCoordinateElement::getInstance(), since that
+      // would add a cache dependency
+      const SoCoordinateElement * coords = (const SoCoordinateElement *)
+        state->getConstElement(SoCoordinateElement::getClassStackIndex());
+      numvertices = coords->getNum();
+    }
+  }
+  // a point, a normal and a packed color per vertex
+  SoGLRenderCacheP::get(cache)->dlestimate +=
+    numvertices * (2 * sizeof(SbVec3f) + sizeof(uint32_t));
+}
+
 static soshape_bigtexture *
 soshape_get_bigtexture(soshape_staticdata * data, uint32_t context)
 {
@@ -294,6 +337,7 @@ soshape_construct_staticdata(void * closure)
   data->primdata = new soshape_primdata();
   data->trianglesort = new soshape_trianglesort();
   data->rendermode = NORMAL;
+  data->rendercache = NULL;
 }
 
 static void
@@ -436,18 +480,47 @@ soshape_ray_intersect(SoRayPickAction * action, const SbBox3f & box)
 
 /*!
   Calculates picked point based on primitives generated by subclasses.
+
+  In batched picks (see SoRayPickAction::setRays()), the primitives
+  are generated once for all the rays which may hit the shape.
 */
 void
 SoShape::rayPick(SoRayPickAction * action)
 {
-  if (this->shouldRayPick(action)) {
+  const int numrays = action->claimRayPacket();
+  SbList <int> hits;
+  SoTriangleBVHCache * bvhcache = NULL;
+  SbBool bvhfetched = FALSE;
+
+  for (int i = 0; i < numrays; i++) {
+    action->setPacketRay(i);
+    if (!this->shouldRayPick(action)) continue;
     this->computeObjectSpaceRay(action);
 
-    if (!PRIVATE(this)->bboxcache ||
-        !PRIVATE(this)->bboxcache->isValid(action->getState()) ||
-        soshape_ray_intersect(action, PRIVATE(this)->bboxcache->getProjectedBox())) {
-      this->generatePrimitives(action);
+    if (PRIVATE(this)->bboxcache &&
+        PRIVATE(this)->bboxcache->isValid(action->getState()) &&
+        !soshape_ray_intersect(action, PRIVATE(this)->bboxcache->getProjectedBox())) {
+      continue;
+    }
+    // skip generating the primitives if the triangle tree shows
+    // that the ray misses all of them
+    if (!bvhfetched) {
+      bvhcache = this->getTriangleBVHCache(action);
+      bvhfetched = TRUE;
     }
+    if (bvhcache && !bvhcache->mayIntersect(action->getLine())) continue;
+    hits.append(i);
+  }
+  if (bvhcache) bvhcache->unref();
+  if (hits.getLength() == 0) return;
+
+  if (numrays == 1) {
+    this->generatePrimitives(action);
+  }
+  else {
+    action->pushRayPacket(hits.getArrayPtr(), hits.getLength());
+    this->generatePrimitives(action);
+    action->popRayPacket();
   }
 }
 
@@ -469,15 +542,18 @@ SoShape::getScreenSize(SoState * const state, const SbBox3f & boundingbox,
   SbVec3f bmin, bmax;
   boundingbox.getBounds(bmin, bmax);
 
-  SbVec3f v;
+  SbVec3f v[8];
   SbBox2f normbox;
   normbox.makeEmpty();
-  for (int i = 0; i < 8; i++) {
-    v.setValue(i&1 ? bmin[0] : bmax[0],
-               i&2 ? bmin[1] : bmax[1],
-               i&4 ? bmin[2] : bmax[2]);
-    projmatrix.multVecMatrix(v, v);
-    normbox.extendBy(SbVec2f(v[0], v[1]));
+  int i;
+  for (i = 0; i < 8; i++) {
+    v[i].setValue(i&1 ? bmin[0] : bmax[0],
+                  i&2 ? bmin[1] : bmax[1],
+                  i&4 ? bmin[2] : bmax[2]);
+  }
+  projmatrix.multVecMatrix(v, v, 8);
+  for (i = 0; i < 8; i++) {
+    normbox.extendBy(SbVec2f(v[i][0], v[i][1]));
   }
   float nx, ny;
   normbox.getSize(nx, ny);
@@ -561,6 +637,21 @@ SoShape::shouldGLRender(SoGLRenderAction * action)
   SbBool transparent = (shapestyleflags & (SoShapeStyleElement::TRANSP_TEXTURE|
                                            SoShapeStyleElement::TRANSP_MATERIAL)) != 0;
 
+  // a vertex buffer render cache can only record shapes rendered
+  // straight from generatePrimitives()
+  SoGLRenderCacheP * rendercache =
+    state->isCacheOpen() ? SoGLRenderCacheP::getRecording(state) : NULL;
+  if (rendercache &&
+      (shapestyleflags & (SoShapeStyleElement::SHADOWMAP|
+                          SoShapeStyleElement::BBOXCMPLX|
+                          SoShapeStyleElement::TRANSP_SORTED_TRIANGLES|
+                          SoShapeStyleElement::BIGIMAGE|
+                          SoShapeStyleElement::BUMPMAP|
+                          SoShapeStyleElement::VERTEXARRAY))) {
+    rendercache->fail("shape style");
+    rendercache = NULL;
+  }
+
   if (shapestyleflags & SoShapeStyleElement::SHADOWMAP) {
     if (transparent) return FALSE;
     int style = SoShadowStyleElement::get(state);
@@ -568,8 +659,10 @@ SoShape::shouldGLRender(SoGLRenderAction * action)
     return FALSE;
   }
 
-  if (action->handleTransparency(transparent))
+  if (action->handleTransparency(transparent)) {
+    if (rendercache) rendercache->fail("delayed transparency");
     return FALSE;
+  }
 
   if (shapestyleflags & SoShapeStyleElement::BBOXCMPLX) {
     this->GLRenderBoundingBox(action);
@@ -800,6 +893,31 @@ SoShape::shouldGLRender(SoGLRenderAction * action)
   this->generatePrimitives(action);
   return FALSE;
 #else // generatePrimitives() rendering
+  if (rendercache) {
+    // push the vertex property data, like GLRender() does before
+    // calling generatePrimitives()
+    SoVertexProperty * vp = NULL;
+    if (this->isOfType(SoVertexShape::getClassTypeId())) {
+      vp = (SoVertexProperty*) ((SoVertexShape*)this)->vertexProperty.getValue();
+    }
+    if (vp) {
+      state->push();
+      vp->doAction(action);
+    }
+    if (rendercache->beginShape(state, this)) {
+      soshape_staticdata * shapedata = soshape_get_staticdata();
+      shapedata->rendercache = rendercache;
+      shapedata->rendermode = RENDERCACHE;
+      this->generatePrimitives(action);
+      shapedata->rendermode = NORMAL;
+      shapedata->rendercache = NULL;
+      rendercache->endShape();
+    }
+    if (vp) state->pop();
+  }
+  else if (state->isCacheOpen()) {
+    soshape_estimate_dlsize(this, state);
+  }
   if (PRIVATE(this)->rendercnt < ((1<<SoShapeP::RENDERCNT_BITS)-1)) {
     PRIVATE(this)->rendercnt++;
   }
@@ -974,56 +1092,65 @@ SoShape::invokeTriangleCallbacks(SoAction * const action,
                                  const SoPrimitiveVertex * const v2,
                                  const SoPrimitiveVertex * const v3)
 {
+  if (PRIVATE(this)->bvhaction == action) {
+    PRIVATE(this)->bvhcache->addTriangle(v1->getPoint(), v2->getPoint(), v3->getPoint());
+    return;
+  }
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection;
-    SbVec3f barycentric;
-    SbBool front;
-
-    if (ra->intersect(v1->getPoint(), v2->getPoint(), v3->getPoint(),
-                      intersection, barycentric, front)) {
-
-      if (ra->isBetweenPlanes(intersection)) {
-        if (SoShapeHintsElement::getVertexOrdering(ra->getState()) ==
-            SoShapeHintsElement::CLOCKWISE) {
-          front = !front;
-        }
-        SoPickedPoint * pp = ra->addIntersection(intersection, front);
-        if (pp) {
-          pp->setDetail(this->createTriangleDetail(ra, v1, v2, v3, pp), this);
-          // calculate normal at picked point
-          SbVec3f n =
-            v1->getNormal() * barycentric[0] +
-            v2->getNormal() * barycentric[1] +
-            v3->getNormal() * barycentric[2];
-          n.normalize();
-          pp->setObjectNormal(n);
-
-          // calculate texture coordinate at picked point
-          SbVec4f tc =
-            v1->getTextureCoords() * barycentric[0] +
-            v2->getTextureCoords() * barycentric[1] +
-            v3->getTextureCoords() * barycentric[2];
-
-          pp->setObjectTextureCoords(tc);
-
-          // material index need to be approximated, since there is no
-          // way to average material indices :( This makes it
-          // impossible to fully support color per vertex. An
-          // extension to the OIV API would perhaps be a good idea
-          // here? Maybe calculate the rgba value for diffuse and
-          // transparency and set it in SoPickedPoint?
-          float maxval = barycentric[0];
-          const SoPrimitiveVertex * maxv = v1;
-          if (barycentric[1] > maxval) {
-            maxv = v2;
-            maxval = barycentric[1];
+    // all the rays of a batched pick which may hit the shape
+    const int numrays = ra->getNumPacketRays();
+    for (int r = 0; r < numrays; r++) {
+      ra->setPacketRay(r);
+      SbVec3f intersection;
+      SbVec3f barycentric;
+      SbBool front;
+
+      if (ra->intersect(v1->getPoint(), v2->getPoint(), v3->getPoint(),
+                        intersection, barycentric, front)) {
+
+        if (ra->isBetweenPlanes(intersection)) {
+          if (SoShapeHintsElement::getVertexOrdering(ra->getState()) ==
+              SoShapeHintsElement::CLOCKWISE) {
+            front = !front;
           }
-          if (barycentric[2] > maxval) {
-            maxv = v3;
+          SoPickedPoint * pp = ra->addIntersection(intersection, front);
+          if (pp) {
+            pp->setDetail(this->createTriangleDetail(ra, v1, v2, v3, pp), this);
+            // calculate normal at picked point
+            SbVec3f n =
+              v1->getNormal() * barycentric[0] +
+              v2->getNormal() * barycentric[1] +
+              v3->getNormal() * barycentric[2];
+            n.normalize();
+            pp->setObjectNormal(n);
+
+            // calculate texture coordinate at picked point
+            SbVec4f tc =
+              v1->getTextureCoords() * barycentric[0] +
+              v2->getTextureCoords() * barycentric[1] +
+              v3->getTextureCoords() * barycentric[2];
+
+            pp->setObjectTextureCoords(tc);
+
+            // material index need to be approximated, since there is no
+            // way to average material indices :( This makes it
+            // impossible to fully support color per vertex. An
+            // extension to the OIV API would perhaps be a good idea
+            // here? Maybe calculate the rgba value for diffuse and
+            // transparency and set it in SoPickedPoint?
+            float maxval = barycentric[0];
+            const SoPrimitiveVertex * maxv = v1;
+            if (barycentric[1] > maxval) {
+              maxv = v2;
+              maxval = barycentric[1];
+            }
+            if (barycentric[2] > maxval) {
+              maxv = v3;
+            }
+            pp->setMaterialIndex(maxv->getMaterialIndex());
           }
-          pp->setMaterialIndex(maxv->getMaterialIndex());
         }
       }
     }
@@ -1055,6 +1182,9 @@ SoShape::invokeTriangleCallbacks(SoAction * const action,
         PRIVATE(this)->pvcache->addTriangle(v1, v2, v3, pdidx);
       }
       break;
+    case RENDERCACHE:
+      shapedata->rendercache->addTriangle(v1, v2, v3);
+      break;
     default:
       glBegin(GL_TRIANGLES);
       glTexCoord4fv(v1->getTextureCoords().getValue());
@@ -1085,38 +1215,47 @@ SoShape::invokeLineSegmentCallbacks(SoAction * const action,
                                     const SoPrimitiveVertex * const v1,
                                     const SoPrimitiveVertex * const v2)
 {
+  if (PRIVATE(this)->bvhaction == action) {
+    PRIVATE(this)->bvhcache->addOtherPrimitive();
+    return;
+  }
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection;
-    if (ra->intersect(v1->getPoint(), v2->getPoint(), intersection)) {
-      if (ra->isBetweenPlanes(intersection)) {
-        SoPickedPoint * pp = ra->addIntersection(intersection);
-        if (pp) {
-          pp->setDetail(this->createLineSegmentDetail(ra, v1, v2, pp), this);
-          float total = (v2->getPoint()-v1->getPoint()).length();
-          float len1 = 1.0f;
-          float len2 = 0.0f;
-          if (total > 0.0f) {
-            len1 = (intersection-v1->getPoint()).length();
-            len2 = (intersection-v2->getPoint()).length();
-            len1 /= total;
-            len2 /= total;
-          }
-          SbVec3f n =
-            v1->getNormal() * len1 +
-            v2->getNormal() * len2;
-          n.normalize();
-          pp->setObjectNormal(n);
-
-          SbVec4f tc =
-            v1->getTextureCoords() * len1 +
-            v2->getTextureCoords() * len2;
-          pp->setObjectTextureCoords(tc);
-          pp->setMaterialIndex(len1 >= len2 ?
-                               v1->getMaterialIndex() :
-                               v2->getMaterialIndex());
+    // all the rays of a batched pick which may hit the shape
+    const int numrays = ra->getNumPacketRays();
+    for (int r = 0; r < numrays; r++) {
+      ra->setPacketRay(r);
+      SbVec3f intersection;
+      if (ra->intersect(v1->getPoint(), v2->getPoint(), intersection)) {
+        if (ra->isBetweenPlanes(intersection)) {
+          SoPickedPoint * pp = ra->addIntersection(intersection);
+          if (pp) {
+            pp->setDetail(this->createLineSegmentDetail(ra, v1, v2, pp), this);
+            float total = (v2->getPoint()-v1->getPoint()).length();
+            float len1 = 1.0f;
+            float len2 = 0.0f;
+            if (total > 0.0f) {
+              len1 = (intersection-v1->getPoint()).length();
+              len2 = (intersection-v2->getPoint()).length();
+              len1 /= total;
+              len2 /= total;
+            }
+            SbVec3f n =
+              v1->getNormal() * len1 +
+              v2->getNormal() * len2;
+            n.normalize();
+            pp->setObjectNormal(n);
+
+            SbVec4f tc =
+              v1->getTextureCoords() * len1 +
+              v2->getTextureCoords() * len2;
+            pp->setObjectTextureCoords(tc);
+            pp->setMaterialIndex(len1 >= len2 ?
+                                 v1->getMaterialIndex() :
+                                 v2->getMaterialIndex());
 
+          }
         }
       }
     }
@@ -1135,6 +1274,9 @@ SoShape::invokeLineSegmentCallbacks(SoAction * const action,
     case PVCACHE:
       PRIVATE(this)->pvcache->addLine(v1, v2);
       break;
+    case RENDERCACHE:
+      shapedata->rendercache->fail("line segments");
+      break;
     default:
       glBegin(GL_LINES);
       glTexCoord4fv(v1->getTextureCoords().getValue());
@@ -1159,18 +1301,27 @@ void
 SoShape::invokePointCallbacks(SoAction * const action,
                               const SoPrimitiveVertex * const v)
 {
+  if (PRIVATE(this)->bvhaction == action) {
+    PRIVATE(this)->bvhcache->addOtherPrimitive();
+    return;
+  }
   if (action->getTypeId().isDerivedFrom(SoRayPickAction::getClassTypeId())) {
     SoRayPickAction * ra = (SoRayPickAction *) action;
 
-    SbVec3f intersection = v->getPoint();
-    if (ra->intersect(intersection)) {
-      if (ra->isBetweenPlanes(intersection)) {
-        SoPickedPoint * pp = ra->addIntersection(intersection);
-        if (pp) {
-          pp->setDetail(this->createPointDetail(ra, v, pp), this);
-          pp->setObjectNormal(v->getNormal());
-          pp->setObjectTextureCoords(v->getTextureCoords());
-          pp->setMaterialIndex(v->getMaterialIndex());
+    // all the rays of a batched pick which may hit the shape
+    const int numrays = ra->getNumPacketRays();
+    for (int r = 0; r < numrays; r++) {
+      ra->setPacketRay(r);
+      SbVec3f intersection = v->getPoint();
+      if (ra->intersect(intersection)) {
+        if (ra->isBetweenPlanes(intersection)) {
+          SoPickedPoint * pp = ra->addIntersection(intersection);
+          if (pp) {
+            pp->setDetail(this->createPointDetail(ra, v, pp), this);
+            pp->setObjectNormal(v->getNormal());
+            pp->setObjectTextureCoords(v->getTextureCoords());
+            pp->setMaterialIndex(v->getMaterialIndex());
+          }
         }
       }
     }
@@ -1190,6 +1341,9 @@ SoShape::invokePointCallbacks(SoAction * const action,
     case PVCACHE:
       PRIVATE(this)->pvcache->addPoint(v);
       break;
+    case RENDERCACHE:
+      shapedata->rendercache->fail("points");
+      break;
     default:
       glBegin(GL_POINTS);
       glTexCoord4fv(v->getTextureCoords().getValue());
@@ -1416,7 +1570,10 @@ SoShape::notify(SoNotList * nl)
   if (PRIVATE(this)->pvcache) {
     PRIVATE(this)->pvcache->invalidate();
   }
-  PRIVATE(this)->flags &= ~SoShapeP::SHOULD_BBOX_CACHE;
+  if (PRIVATE(this)->bvhcache) {
+    PRIVATE(this)->bvhcache->invalidate();
+  }
+  PRIVATE(this)->flags &= ~(SoShapeP::SHOULD_BBOX_CACHE | SoShapeP::SHOULD_BVH_CACHE);
   PRIVATE(this)->rendercnt = 0;
   PRIVATE(this)->unlock();
 }
@@ -1776,5 +1933,132 @@ SoShape::validatePVCache(SoGLRenderAction * action)
   }
 }
 
+// Returns the triangle tree of the shape for the current state,
+// ref'ed, or NULL if there is none. The tree is made the second time
+// the shape is picked or selected after a change, so that shapes
+// which are only tested once don't pay for it. It is made in a
+// separate pass over the primitives, with the primitive callbacks
+// diverted to the cache.
+SoTriangleBVHCache *
+SoShape::getTriangleBVHCache(SoAction * action)
+{
+  static int disabled = -1;
+  if (disabled == -1) {
+    const char * env = coin_getenv("COIN_NO_TRIANGLE_BVH_CACHE");
+    disabled = (env && atoi(env) > 0) ? 1 : 0;
+  }
+  if (disabled) return NULL;
+
+  SoState * state = action->getState();
+  PRIVATE(this)->lock();
+  SoTriangleBVHCache * cache = PRIVATE(this)->bvhcache;
+  if (cache && (!cache->isValid(state) || cache->getActionType() != action->getTypeId())) {
+    cache->unref();
+    cache = PRIVATE(this)->bvhcache = NULL;
+  }
+  if (cache == NULL) {
+    if (!(PRIVATE(this)->flags & SoShapeP::SHOULD_BVH_CACHE)) {
+      PRIVATE(this)->flags |= SoShapeP::SHOULD_BVH_CACHE;
+      PRIVATE(this)->unlock();
+      return NULL;
+    }
+    SbBool storedinvalid = SoCacheElement::setInvalid(FALSE);
+    // must push state to make cache dependencies work
+    state->push();
+    cache = new SoTriangleBVHCache(state, action->getTypeId());
+    cache->ref();
+    SoCacheElement::set(state, cache);
+    PRIVATE(this)->bvhcache = cache;
+    PRIVATE(this)->bvhaction = action;
+    this->generatePrimitives(action);
+    PRIVATE(this)->bvhaction = NULL;
+    state->pop();
+    SoCacheElement::setInvalid(storedinvalid);
+    cache->close();
+  }
+  cache->ref();
+  PRIVATE(this)->unlock();
+  return cache;
+}
+
 
 #undef PRIVATE
+
+#ifdef COIN_TEST_SUITE
+
+#include <Inventor/SoPickedPoint.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/details/SoFaceDetail.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+// a 10x10 grid of unit quads in the z=0 plane, without the quad at
+// (4, 4)
+static SoIndexedFaceSet *
+make_grid_with_hole(SoCoordinate3 * coords)
+{
+  int i, j;
+  for (j = 0; j <= 10; j++) {
+    for (i = 0; i <= 10; i++) {
+      coords->point.set1Value(j * 11 + i, SbVec3f(float(i), float(j), 0.0f));
+    }
+  }
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+  int idx = 0;
+  for (j = 0; j < 10; j++) {
+    for (i = 0; i < 10; i++) {
+      if (i == 4 && j == 4) continue;
+      const int32_t quad[] = {
+        j * 11 + i, j * 11 + i + 1, (j + 1) * 11 + i + 1, (j + 1) * 11 + i, -1
+      };
+      ifs->coordIndex.setValues(idx, 5, quad);
+      idx += 5;
+    }
+  }
+  return ifs;
+}
+
+static const SoPickedPoint *
+pick_grid(SoRayPickAction & rp, SoNode * root, const float x, const float y)
+{
+  rp.setRay(SbVec3f(x, y, 5.0f), SbVec3f(0.0f, 0.0f, -1.0f));
+  rp.apply(root);
+  return rp.getPickedPoint();
+}
+
+BOOST_AUTO_TEST_CASE(rayPickTriangleTree)
+{
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  root->addChild(coords);
+  root->addChild(make_grid_with_hole(coords));
+
+  SoRayPickAction rp(SbViewportRegion(100, 100));
+  // the triangle tree is built on the second pick, so pick a few
+  // times to test with and without it
+  for (int n = 0; n < 3; n++) {
+    BOOST_CHECK_MESSAGE(pick_grid(rp, root, 4.5f, 4.5f) == NULL,
+                        "ray through the hole should not hit");
+    const SoPickedPoint * pp = pick_grid(rp, root, 2.5f, 7.5f);
+    BOOST_REQUIRE_MESSAGE(pp != NULL, "ray should hit the grid");
+    BOOST_CHECK_MESSAGE(pp->getPoint().equals(SbVec3f(2.5f, 7.5f, 0.0f), 1e-4f),
+                        "wrong intersection point");
+    const SoDetail * detail = pp->getDetail();
+    BOOST_REQUIRE(detail && detail->isOfType(SoFaceDetail::getClassTypeId()));
+    // quads before (4, 4) keep their index
+    BOOST_CHECK_EQUAL(static_cast<const SoFaceDetail *>(detail)->getFaceIndex(), 71);
+  }
+
+  // moving a vertex must update the tree
+  coords->point.set1Value(4 * 11 + 4, SbVec3f(4.5f, 4.5f, 0.0f));
+  BOOST_CHECK_MESSAGE(pick_grid(rp, root, 4.5f, 4.2f) != NULL,
+                      "ray should hit the moved vertex' triangles");
+  BOOST_CHECK_MESSAGE(pick_grid(rp, root, 4.5f, 4.2f) != NULL,
+                      "ray should hit the moved vertex' triangles");
+
+  root->unref();
+}
+
+#endif // COIN_TEST_SUITE
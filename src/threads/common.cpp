@@ -27,6 +27,13 @@
 #include <config.h>
 #endif /* HAVE_CONFIG_H */
 
+#ifdef HAVE_THREADS
+#include <Inventor/C/threads/mutex.h>
+#include <Inventor/C/threads/wpool.h>
+#endif /* HAVE_THREADS */
+
+#include "threads/threadsutilp.h"
+
 /* ********************************************************************** */
 
 int
@@ -44,3 +51,80 @@ cc_thread_implementation(void)
 } /* cc_thread_implementation() */
 
 /* ********************************************************************** */
+
+/* The range handed to cc_parallel_for(), and the start of the next
+   chunk, shared by the threads. */
+typedef struct {
+  int num;
+  int chunk;
+  int next;
+  cc_mutex * mutex;
+  cc_parallel_func * func;
+  void * closure;
+} cc_parallel_job;
+
+static void
+cc_parallel_worker(void * closure)
+{
+  cc_parallel_job * job = (cc_parallel_job *) closure;
+  for (;;) {
+    int begin, end;
+#ifdef HAVE_THREADS
+    if (job->mutex) { cc_mutex_lock(job->mutex); }
+#endif /* HAVE_THREADS */
+    begin = job->next;
+    end = (job->num - begin > job->chunk) ? begin + job->chunk : job->num;
+    job->next = end;
+#ifdef HAVE_THREADS
+    if (job->mutex) { cc_mutex_unlock(job->mutex); }
+#endif /* HAVE_THREADS */
+    if (begin >= end) return;
+    job->func(job->closure, begin, end);
+  }
+}
+
+/* Documented in threadsutilp.h. */
+void
+cc_parallel_for(int num, int chunk, int numthreads,
+                cc_parallel_func * func, void * closure)
+{
+  cc_parallel_job job;
+  int numworkers;
+
+  if (num <= 0) return;
+  if (chunk < 1) chunk = 1;
+
+  job.num = num;
+  job.chunk = chunk;
+  job.next = 0;
+  job.mutex = NULL;
+  job.func = func;
+  job.closure = closure;
+
+  numworkers = (num - 1) / chunk + 1;
+  if (numthreads < numworkers) numworkers = numthreads;
+
+#ifdef HAVE_THREADS
+  if (numworkers > 1 && cc_thread_implementation() != CC_NO_THREADS) {
+    cc_wpool * pool;
+    int i;
+    job.mutex = cc_mutex_construct();
+    pool = cc_wpool_construct(numworkers - 1);
+    cc_wpool_begin(pool, numworkers - 1);
+    for (i = 1; i < numworkers; i++) {
+      cc_wpool_start_worker(pool, cc_parallel_worker, &job);
+    }
+    cc_wpool_end(pool);
+    /* this thread does its share too */
+    cc_parallel_worker(&job);
+    cc_wpool_wait_all(pool);
+    cc_wpool_destruct(pool);
+    cc_mutex_destruct(job.mutex);
+    return;
+  }
+#endif /* HAVE_THREADS */
+
+  cc_parallel_worker(&job);
+}
+
+/* ********************************************************************** */
@@ -80,4 +80,17 @@
 
 #endif /* ! HAVE_THREADS */
 
+/*
+  cc_parallel_for() calls func(closure, begin, end) for consecutive
+  chunks of at most chunk elements, until [0, num) is covered. The
+  chunks are handed out to up to numthreads threads, the calling
+  thread included, as they become idle, so func must only touch what
+  belongs to its own range. Without thread support everything runs in
+  the calling thread. Returns when all chunks are done.
+*/
+typedef void cc_parallel_func(void * closure, int begin, int end);
+
+void cc_parallel_for(int num, int chunk, int numthreads,
+                     cc_parallel_func * func, void * closure);
+
 #endif /* CC_THREADUTILP_H */
@@ -1755,6 +1755,40 @@ coin_runtime_os(void)
 
 /**************************************************************************/
 
+/*
+ * Returns the best SIMD instruction set supported by the CPU (and
+ * operating system) we are running on, as one of the CoinSIMDLevel
+ * values. Used for selecting between optimized code paths at
+ * runtime. Set the environment variable COIN_NO_SIMD to 1 to force
+ * the plain C/C++ code paths.
+ */
+int
+coin_runtime_simd(void)
+{
+  static int level = -1;
+  if (level < 0) {
+    const char * env = coin_getenv("COIN_NO_SIMD");
+    level = COIN_SIMD_NONE;
+    if (env && atoi(env) > 0) return level;
+#if defined(COIN_HAVE_X86_SIMD) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) level = COIN_SIMD_AVX2;
+    else if (__builtin_cpu_supports("avx")) level = COIN_SIMD_AVX;
+    else if (__builtin_cpu_supports("sse2")) level = COIN_SIMD_SSE2;
+#elif defined(COIN_HAVE_X86_SIMD)
+    /* FIXME: no AVX detection with MSVC yet (needs __cpuid() and
+       _xgetbv()). SSE2 is available on all x86 targets supported by
+       MSVC. */
+    level = COIN_SIMD_SSE2;
+#elif defined(COIN_HAVE_NEON_SIMD)
+    level = COIN_SIMD_NEON;
+#endif
+  }
+  return level;
+}
+
+/**************************************************************************/
+
 /*
  * Will return TRUE if extra debugging information is enabled. These
  * are typically debugging messages extra for Coin and not found in
@@ -252,6 +252,38 @@ int coin_runtime_os(void);
 
 /* ********************************************************************** */
 
+/*
+  Compile-time support for SIMD code paths. The x86 code paths are
+  compiled with per-function target attributes (COIN_TARGET_*), so
+  they do not depend on the compiler flags, and must only be called
+  after checking coin_runtime_simd().
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COIN_HAVE_X86_SIMD 1
+#define COIN_TARGET_SSE2 __attribute__((target("sse2")))
+#define COIN_TARGET_AVX __attribute__((target("avx")))
+#define COIN_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define COIN_HAVE_X86_SIMD 1
+#define COIN_TARGET_SSE2
+#define COIN_TARGET_AVX
+#define COIN_TARGET_AVX2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define COIN_HAVE_NEON_SIMD 1
+#endif
+
+enum CoinSIMDLevel {
+  COIN_SIMD_NONE,
+  COIN_SIMD_SSE2,
+  COIN_SIMD_AVX,
+  COIN_SIMD_AVX2,
+  COIN_SIMD_NEON
+};
+
+int coin_runtime_simd(void);
+
+/* ********************************************************************** */
+
 int coin_debug_extra(void);
 int coin_debug_normalize(void);
 int coin_debug_caching_level(void);
@@ -55,19 +55,9 @@
 #include <Inventor/VRMLnodes/SoVRMLCoordinateInterpolator.h>
 
 #include <Inventor/VRMLnodes/SoVRMLMacros.h>
-#include <Inventor/lists/SbList.h>
 
 #include "engines/SoSubNodeEngineP.h"
-
-#ifndef DOXYGEN_SKIP_THIS
-
-class SoVRMLCoordinateInterpolatorP {
-public:
-  SbList <SbVec3f> tmplist;
-};
-
-#endif // DOXYGEN_SKIP_THIS
-
+#include "engines/SoInterpolateP.h"
 
 SO_NODEENGINE_SOURCE(SoVRMLCoordinateInterpolator);
 
@@ -77,11 +67,10 @@ SoVRMLCoordinateInterpolator::initClass(void) // static
   SO_NODEENGINE_INTERNAL_INIT_CLASS(SoVRMLCoordinateInterpolator);
 }
 
-#define PRIVATE(obj) ((obj)->pimpl)
-
 SoVRMLCoordinateInterpolator::SoVRMLCoordinateInterpolator(void)
 {
-  PRIVATE(this) = new SoVRMLCoordinateInterpolatorP;
+  // not used, kept for binary compatibility
+  this->pimpl = NULL;
 
   SO_NODEENGINE_INTERNAL_CONSTRUCTOR(SoVRMLCoordinateInterpolator);
 
@@ -91,7 +80,6 @@ SoVRMLCoordinateInterpolator::SoVRMLCoordinateInterpolator(void)
 
 SoVRMLCoordinateInterpolator::~SoVRMLCoordinateInterpolator()
 {
-  delete PRIVATE(this);
 }
 
 void
@@ -103,7 +91,6 @@ SoVRMLCoordinateInterpolator::evaluate(void)
   int i, idx = this->getKeyValueIndex(interp, this->keyValue.getNum());
   if (idx < 0) return;
 
-  PRIVATE(this)->tmplist.truncate(0);
   const int numkeys = this->key.getNum();
   const int numcoords = this->keyValue.getNum() / numkeys;
 
@@ -111,16 +98,18 @@ SoVRMLCoordinateInterpolator::evaluate(void)
   const SbVec3f * c1 = c0;
   if (interp > 0.0f) c1 = this->keyValue.getValues((idx+1)*numcoords);
 
-  for (i = 0; i < numcoords; i++) {
-    PRIVATE(this)->tmplist.append(c0[i] + (c1[i]-c0[i]) * interp);
+  // interpolate directly into the connected fields
+  if (!this->value_changed.isEnabled()) return;
+  for (i = 0; i < this->value_changed.getNumConnections(); i++) {
+    SoMFVec3f * field = static_cast<SoMFVec3f *>(this->value_changed[i]);
+    if (field->isReadOnly()) continue;
+    field->setNum(numcoords);
+    SoInterpolateP::lerp(reinterpret_cast<const float *>(c0),
+                         reinterpret_cast<const float *>(c1),
+                         reinterpret_cast<float *>(field->startEditing()),
+                         numcoords * 3, interp);
+    field->finishEditing();
   }
-
-  const SbVec3f * coords = PRIVATE(this)->tmplist.getArrayPtr();
-
-  SO_ENGINE_OUTPUT(value_changed, SoMFVec3f, setNum(numcoords));
-  SO_ENGINE_OUTPUT(value_changed, SoMFVec3f, setValues(0, numcoords, coords));
 }
 
-#undef PRIVATE
-
 #endif // HAVE_VRML97
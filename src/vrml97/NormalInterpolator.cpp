@@ -77,15 +77,7 @@
 #include <Inventor/VRMLnodes/SoVRMLMacros.h>
 
 #include "engines/SoSubNodeEngineP.h"
-
-#ifndef DOXYGEN_SKIP_THIS
-
-class SoVRMLNormalInterpolatorP {
-public:
-  SbList <SbVec3f> tmplist;
-};
-
-#endif // DOXYGEN_SKIP_THIS
+#include "engines/SoInterpolateP.h"
 
 SO_NODEENGINE_SOURCE(SoVRMLNormalInterpolator);
 
@@ -96,14 +88,13 @@ SoVRMLNormalInterpolator::initClass(void)
   SO_NODEENGINE_INTERNAL_INIT_CLASS(SoVRMLNormalInterpolator);
 }
 
-#define PRIVATE(obj) ((obj)->pimpl)
-
 /*!
   Constructor.
 */
 SoVRMLNormalInterpolator::SoVRMLNormalInterpolator(void)
 {
-  PRIVATE(this) = new SoVRMLNormalInterpolatorP;
+  // not used, kept for binary compatibility
+  this->pimpl = NULL;
 
   SO_NODEENGINE_INTERNAL_CONSTRUCTOR(SoVRMLNormalInterpolator);
 
@@ -116,7 +107,6 @@ SoVRMLNormalInterpolator::SoVRMLNormalInterpolator(void)
 */
 SoVRMLNormalInterpolator::~SoVRMLNormalInterpolator()
 {
-  delete PRIVATE(this);
 }
 
 // Doc in parent
@@ -129,7 +119,6 @@ SoVRMLNormalInterpolator::evaluate(void)
   int i, idx = this->getKeyValueIndex(interp, this->keyValue.getNum());
   if (idx < 0) return;
 
-  PRIVATE(this)->tmplist.truncate(0);
   const int numkeys = this->key.getNum();
   const int numcoords = this->keyValue.getNum() / numkeys;
 
@@ -137,16 +126,18 @@ SoVRMLNormalInterpolator::evaluate(void)
   const SbVec3f * c1 = c0;
   if (interp > 0.0f) c1 = this->keyValue.getValues((idx+1)*numcoords);
 
-  for (i = 0; i < numcoords; i++) {
-    PRIVATE(this)->tmplist.append(c0[i] + (c1[i]-c0[i]) * interp);
+  // interpolate directly into the connected fields
+  if (!this->value_changed.isEnabled()) return;
+  for (i = 0; i < this->value_changed.getNumConnections(); i++) {
+    SoMFVec3f * field = static_cast<SoMFVec3f *>(this->value_changed[i]);
+    if (field->isReadOnly()) continue;
+    field->setNum(numcoords);
+    SoInterpolateP::lerp(reinterpret_cast<const float *>(c0),
+                         reinterpret_cast<const float *>(c1),
+                         reinterpret_cast<float *>(field->startEditing()),
+                         numcoords * 3, interp);
+    field->finishEditing();
   }
-
-  const SbVec3f * coords = PRIVATE(this)->tmplist.getArrayPtr();
-
-  SO_ENGINE_OUTPUT(value_changed, SoMFVec3f, setNum(numcoords));
-  SO_ENGINE_OUTPUT(value_changed, SoMFVec3f, setValues(0, numcoords, coords));
 }
 
-#undef PRIVATE
-
 #endif // HAVE_VRML97
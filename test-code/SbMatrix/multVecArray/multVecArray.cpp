@@ -0,0 +1,128 @@
+/************************************************************************
+ *
+ * Microbenchmark for the array versions of SbMatrix::multVecMatrix()
+ * and SbMatrix::multDirMatrix(), and for SbBox3f::transform(), against
+ * the per-vector calls they replace. Prints the cost per vector (or
+ * per box) and checks that the results are identical.
+ *
+ * Run with COIN_NO_SIMD=1 in the environment to measure the plain C++
+ * array code.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbRotation.h>
+#include <Inventor/SbBox3f.h>
+
+static double
+nsper(const SbTime & start, const int count)
+{
+  return (SbTime::getTimeOfDay() - start).getValue() * 1.0e9 / double(count);
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int num = (argc > 1) ? atoi(argv[1]) : 100000;
+  const int rounds = (argc > 2) ? atoi(argv[2]) : 50;
+
+  SoDB::init();
+
+  SbMatrix matrix;
+  matrix.setTransform(SbVec3f(1.0f, -2.0f, 3.5f),
+                      SbRotation(SbVec3f(1.0f, 1.0f, 0.0f), 0.7f),
+                      SbVec3f(2.0f, 0.5f, 1.5f));
+
+  srand(19720408);
+  SbVec3f * src = new SbVec3f[num];
+  SbVec3f * dst0 = new SbVec3f[num];
+  SbVec3f * dst1 = new SbVec3f[num];
+  int i, r;
+  for (i = 0; i < num; i++) {
+    src[i].setValue(float(rand()) / float(RAND_MAX) - 0.5f,
+                    float(rand()) / float(RAND_MAX) * 10.0f,
+                    float(rand()) / float(RAND_MAX) * -3.0f);
+  }
+
+  SbTime start = SbTime::getTimeOfDay();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < num; i++) matrix.multVecMatrix(src[i], dst0[i]);
+  }
+  const double single = nsper(start, num * rounds);
+
+  start = SbTime::getTimeOfDay();
+  for (r = 0; r < rounds; r++) matrix.multVecMatrix(src, dst1, num);
+  const double array = nsper(start, num * rounds);
+
+  int diff = 0;
+  for (i = 0; i < num; i++) if (dst0[i] != dst1[i]) diff++;
+  (void)fprintf(stdout, "multVecMatrix: %.2f ns/vector single, %.2f ns/vector array, %d differences\n",
+                single, array, diff);
+
+  start = SbTime::getTimeOfDay();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < num; i++) matrix.multDirMatrix(src[i], dst0[i]);
+  }
+  const double singledir = nsper(start, num * rounds);
+
+  start = SbTime::getTimeOfDay();
+  for (r = 0; r < rounds; r++) matrix.multDirMatrix(src, dst1, num);
+  const double arraydir = nsper(start, num * rounds);
+
+  diff = 0;
+  for (i = 0; i < num; i++) if (dst0[i] != dst1[i]) diff++;
+  (void)fprintf(stdout, "multDirMatrix: %.2f ns/vector single, %.2f ns/vector array, %d differences\n",
+                singledir, arraydir, diff);
+
+  // transform boxes by transforming all eight corners, as
+  // SbBox3f::transform() used to do for all matrices
+  const int numboxes = num / 2;
+  SbBox3f * boxes0 = new SbBox3f[numboxes];
+  SbBox3f * boxes1 = new SbBox3f[numboxes];
+
+  start = SbTime::getTimeOfDay();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < numboxes; i++) {
+      const SbBox3f box(src[i*2], src[i*2] + SbVec3f(1.0f, 2.0f, 3.0f));
+      SbBox3f newbox;
+      for (int c = 0; c < 8; c++) {
+        SbVec3f corner(c&4 ? box.getMax()[0] : box.getMin()[0],
+                       c&2 ? box.getMax()[1] : box.getMin()[1],
+                       c&1 ? box.getMax()[2] : box.getMin()[2]);
+        matrix.multVecMatrix(corner, corner);
+        newbox.extendBy(corner);
+      }
+      boxes0[i] = newbox;
+    }
+  }
+  const double corners = nsper(start, numboxes * rounds);
+
+  start = SbTime::getTimeOfDay();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < numboxes; i++) {
+      SbBox3f box(src[i*2], src[i*2] + SbVec3f(1.0f, 2.0f, 3.0f));
+      box.transform(matrix);
+      boxes1[i] = box;
+    }
+  }
+  const double transform = nsper(start, numboxes * rounds);
+
+  diff = 0;
+  for (i = 0; i < numboxes; i++) {
+    if (boxes0[i].getMin() != boxes1[i].getMin() ||
+        boxes0[i].getMax() != boxes1[i].getMax()) diff++;
+  }
+  (void)fprintf(stdout, "SbBox3f::transform: %.2f ns/box corners, %.2f ns/box transform(), %d differences\n",
+                corners, transform, diff);
+
+  delete[] boxes0;
+  delete[] boxes1;
+  delete[] src;
+  delete[] dst0;
+  delete[] dst1;
+  return 0;
+}
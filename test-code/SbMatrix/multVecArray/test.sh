@@ -0,0 +1,12 @@
+#!/bin/sh
+
+if test multVecArray -ot multVecArray.cpp
+then
+  coin-config --build multVecArray multVecArray.cpp || exit 1
+fi
+
+echo "plain C++:"
+COIN_NO_SIMD=1 ./multVecArray $*
+echo "SIMD:"
+./multVecArray $*
+exit 0
@@ -0,0 +1,158 @@
+/************************************************************************
+ *
+ * Benchmark for SoBoxPickAction. Builds n x n blocks of m x m
+ * spheres, and times rectangle and lasso selection of a part of them
+ * with the action, against a SoCallbackAction which tests every
+ * triangle in the scene against the view volume, which is how
+ * SoExtSelection selects.
+ *
+ * The first pick makes the bounding box caches, and later picks use
+ * the triangle trees of the shapes on the boundary, so the picks are
+ * repeated and timed separately.
+ *
+ * Run with COIN_DEBUG_BOXPICKACTION=1 in the environment to get the
+ * number of shapes inside, outside and on the boundary of the volume.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbPlane.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewVolume.h>
+#include <Inventor/SoPrimitiveVertex.h>
+#include <Inventor/actions/SoBoxPickAction.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/nodes/SoComplexity.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+struct Brute {
+  SbPlane planes[6];
+  SbBool hit;
+  int numshapes;
+  int numtriangles;
+};
+
+static SoCallbackAction::Response
+pre_shape(void * closure, SoCallbackAction *, const SoNode *)
+{
+  ((Brute *)closure)->hit = FALSE;
+  return SoCallbackAction::CONTINUE;
+}
+
+static SoCallbackAction::Response
+post_shape(void * closure, SoCallbackAction *, const SoNode *)
+{
+  if (((Brute *)closure)->hit) ((Brute *)closure)->numshapes++;
+  return SoCallbackAction::CONTINUE;
+}
+
+// counts the shape if a vertex of one of its triangles is inside
+static void
+triangle(void * closure, SoCallbackAction * action,
+         const SoPrimitiveVertex * v1,
+         const SoPrimitiveVertex * v2,
+         const SoPrimitiveVertex * v3)
+{
+  Brute * brute = (Brute *)closure;
+  brute->numtriangles++;
+  if (brute->hit) return;
+  const SoPrimitiveVertex * v[3] = { v1, v2, v3 };
+  for (int i = 0; i < 3 && !brute->hit; i++) {
+    SbVec3f p;
+    action->getModelMatrix().multVecMatrix(v[i]->getPoint(), p);
+    int j;
+    for (j = 0; j < 6; j++) {
+      if (!brute->planes[j].isInHalfSpace(p)) break;
+    }
+    if (j == 6) brute->hit = TRUE;
+  }
+}
+
+static void
+time_picks(const char * what, SoBoxPickAction & pa, SoNode * root)
+{
+  for (int i = 0; i < 3; i++) {
+    SbTime start = SbTime::getTimeOfDay();
+    pa.apply(root);
+    (void)fprintf(stdout, "%s, pick %d: %d shapes, %.2f ms\n", what, i + 1,
+                  pa.getPaths().getLength(),
+                  (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+  }
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 8;
+  const int m = (argc > 2) ? atoi(argv[2]) : 8;
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoComplexity * complexity = new SoComplexity;
+  complexity->value = 0.5f;
+  root->addChild(complexity);
+  const float size = float(n * m) * 2.0f;
+  for (int i = 0; i < n * n; i++) {
+    SoSeparator * block = new SoSeparator;
+    for (int j = 0; j < m * m; j++) {
+      SoSeparator * sep = new SoSeparator;
+      SoTranslation * t = new SoTranslation;
+      t->translation.setValue(float((i % n) * m + j % m) * 2.0f - size * 0.5f,
+                              float((i / n) * m + j / m) * 2.0f - size * 0.5f,
+                              -size);
+      sep->addChild(t);
+      sep->addChild(new SoSphere);
+      block->addChild(sep);
+    }
+    root->addChild(block);
+  }
+
+  SbViewVolume vv;
+  vv.perspective(0.9f, 1.0f, 1.0f, size * 2.0f);
+  const SbViewVolume rect = vv.narrow(0.3f, 0.3f, 0.6f, 0.55f);
+
+  Brute brute;
+  rect.getViewVolumePlanes(brute.planes);
+  brute.numshapes = brute.numtriangles = 0;
+  SoCallbackAction cba;
+  cba.addPreCallback(SoShape::getClassTypeId(), pre_shape, &brute);
+  cba.addPostCallback(SoShape::getClassTypeId(), post_shape, &brute);
+  cba.addTriangleCallback(SoShape::getClassTypeId(), triangle, &brute);
+  SbTime start = SbTime::getTimeOfDay();
+  cba.apply(root);
+  (void)fprintf(stdout, "%d spheres, every triangle: %d shapes, %d triangles, %.2f ms\n",
+                n * n * m * m, brute.numshapes, brute.numtriangles,
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+
+  SoBoxPickAction pa;
+  pa.setViewVolume(rect);
+  time_picks("rectangle", pa, root);
+
+  // a concave lasso, and its convex hull
+  const SbVec2f lasso[5] = {
+    SbVec2f(0.3f, 0.3f), SbVec2f(0.6f, 0.3f), SbVec2f(0.6f, 0.55f),
+    SbVec2f(0.45f, 0.4f), SbVec2f(0.3f, 0.55f)
+  };
+  pa.setPolygon(vv, lasso, 5);
+  time_picks("concave lasso", pa, root);
+  const SbVec2f hull[4] = {
+    SbVec2f(0.3f, 0.3f), SbVec2f(0.6f, 0.3f), SbVec2f(0.6f, 0.55f), SbVec2f(0.3f, 0.55f)
+  };
+  pa.setPolygon(vv, hull, 4);
+  time_picks("convex lasso", pa, root);
+
+  pa.setViewVolume(rect);
+  pa.setPickPrimitives(TRUE);
+  time_picks("rectangle with primitives", pa, root);
+
+  root->unref();
+  return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test rectangle -ot rectangle.cpp
+then
+  coin-config --build rectangle rectangle.cpp || exit 1
+fi
+
+./rectangle $*
+exit 0
@@ -0,0 +1,88 @@
+/************************************************************************
+ *
+ * Benchmark for SoCalculator::evaluate() with large multi-field
+ * inputs. Prints the average cost per field value.
+ *
+ * Run with COIN_NO_COMPILED_CALCULATOR=1 in the environment to
+ * measure the interpreting evaluator instead of the compiled one.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/engines/SoCalculator.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoMaterial.h>
+
+static const char * expressions[] = {
+  "oa = a * (0.5 + b) / c",
+  "ta = a * b; tb = c + d; oA = vec3f(ta, tb, ta - tb) + A",
+  "oA = normalize(cross(A, B)) * length(A); ob = dot(A, B) > 0 ? sqrt(a) : cos(a)",
+  NULL
+};
+
+int
+main(int argc, char ** argv)
+{
+  const int num = (argc > 1) ? atoi(argv[1]) : 100000;
+  const int rounds = (argc > 2) ? atoi(argv[2]) : 20;
+
+  SoDB::init();
+
+  SoCalculator * calc = new SoCalculator;
+  calc->ref();
+  SoMaterial * mat = new SoMaterial;
+  mat->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  coords->ref();
+
+  srand(19720408);
+  calc->a.setNum(num);
+  calc->b.setNum(num);
+  calc->c.setNum(num);
+  calc->A.setNum(num);
+  calc->B.setNum(num);
+  float * a = calc->a.startEditing();
+  float * b = calc->b.startEditing();
+  float * c = calc->c.startEditing();
+  SbVec3f * A = calc->A.startEditing();
+  SbVec3f * B = calc->B.startEditing();
+  for (int i = 0; i < num; i++) {
+    a[i] = float(rand()) / float(RAND_MAX);
+    b[i] = float(rand()) / float(RAND_MAX);
+    c[i] = 1.0f + float(rand()) / float(RAND_MAX);
+    A[i].setValue(a[i], b[i], c[i]);
+    B[i].setValue(c[i], a[i], b[i]);
+  }
+  calc->a.finishEditing();
+  calc->b.finishEditing();
+  calc->c.finishEditing();
+  calc->A.finishEditing();
+  calc->B.finishEditing();
+  calc->d.setValue(1.0f);
+
+  mat->transparency.connectFrom(&calc->oa);
+  coords->point.connectFrom(&calc->oA);
+
+  for (int e = 0; expressions[e]; e++) {
+    calc->expression.setValue(expressions[e]);
+    (void) mat->transparency.getNum(); // warm up (parse and compile)
+
+    const SbTime start = SbTime::getTimeOfDay();
+    for (int r = 0; r < rounds; r++) {
+      calc->d.touch();
+      (void) mat->transparency.getNum();
+      (void) coords->point.getNum();
+    }
+    const double usecs = (SbTime::getTimeOfDay() - start).getValue() * 1.0e6;
+    (void)fprintf(stdout, "%-80s %8.2f ns/value\n", expressions[e],
+                  usecs * 1000.0 / (double(num) * double(rounds)));
+  }
+
+  coords->unref();
+  mat->unref();
+  calc->unref();
+  return 0;
+}
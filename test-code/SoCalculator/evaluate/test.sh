@@ -0,0 +1,12 @@
+#!/bin/sh
+
+if test evaluate -ot evaluate.cpp
+then
+  coin-config --build evaluate evaluate.cpp || exit 1
+fi
+
+echo "interpreted:"
+COIN_NO_COMPILED_CALCULATOR=1 ./evaluate $*
+echo "compiled:"
+./evaluate $*
+exit 0
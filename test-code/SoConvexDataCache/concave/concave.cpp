@@ -0,0 +1,97 @@
+/************************************************************************
+ *
+ * Benchmark for tessellating concave polygons, as done when an
+ * SoIndexedFaceSet without convex face type hints is rendered for the
+ * first time. Makes n x n polygons, alternating between L shaped
+ * hexagons and 12 pointed stars, and times SoConvexDataCache
+ * generating triangles for them twice.
+ *
+ * With a directory as the second argument, it is set with
+ * SoConvexDataCache::setCacheDirectory(), and the second run reads
+ * the triangles stored by the first (or both do, if the directory
+ * has a file from an earlier run). Set COIN_CONVEXDATACACHE_THREADS
+ * in the environment to change the number of threads tessellating.
+ *
+ ************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbMatrix.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/caches/SoConvexDataCache.h>
+#include <Inventor/elements/SoCoordinateElement.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/nodes/SoCallback.h>
+
+static SbList<SbVec3f> coords;
+static SbList<int32_t> indices;
+
+static void
+tessellate(void * closure, SoAction * action)
+{
+  if (!action->isOfType(SoCallbackAction::getClassTypeId())) return;
+  SoState * state = action->getState();
+  SoCoordinateElement::set3(state, static_cast<SoNode *>(closure),
+                            coords.getLength(), coords.getArrayPtr());
+
+  for (int run = 0; run < 2; run++) {
+    SbTime t = SbTime::getTimeOfDay();
+    SoConvexDataCache * cache = new SoConvexDataCache(state);
+    cache->ref();
+    cache->generate(SoCoordinateElement::getInstance(state), SbMatrix::identity(),
+                    indices.getArrayPtr(), indices.getLength(),
+                    NULL, NULL, NULL,
+                    SoConvexDataCache::PER_FACE, SoConvexDataCache::NONE,
+                    SoConvexDataCache::PER_VERTEX_INDEXED);
+    fprintf(stdout, "run %d: %8.1f ms, %d triangles\n", run + 1,
+            (SbTime::getTimeOfDay() - t).getValue() * 1000.0,
+            cache->getNumCoordIndices() / 4);
+    cache->unref();
+  }
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 300;
+
+  SoDB::init();
+  if (argc > 2) SoConvexDataCache::setCacheDirectory(argv[2]);
+
+  const float l[6][2] = {
+    { 0.0f, 0.0f }, { 0.8f, 0.0f }, { 0.8f, 0.4f },
+    { 0.4f, 0.4f }, { 0.4f, 0.8f }, { 0.0f, 0.8f }
+  };
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++) {
+      if ((i + j) & 1) {
+        for (int k = 0; k < 6; k++) {
+          indices.append(coords.getLength());
+          coords.append(SbVec3f(i + l[k][0], j + l[k][1], 0.0f));
+        }
+      }
+      else {
+        for (int k = 0; k < 24; k++) {
+          const float r = (k & 1) ? 0.2f : 0.45f;
+          const double a = 2.0 * M_PI * k / 24;
+          indices.append(coords.getLength());
+          coords.append(SbVec3f(i + 0.5f + r * float(cos(a)),
+                                j + 0.5f + r * float(sin(a)), 0.0f));
+        }
+      }
+      indices.append(-1);
+    }
+  }
+  fprintf(stdout, "%d polygons, %d vertices\n", n * n, coords.getLength());
+
+  SoCallback * root = new SoCallback;
+  root->ref();
+  root->setCallback(tessellate, root);
+  SoCallbackAction cba;
+  cba.apply(root);
+  root->unref();
+  return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test concave -ot concave.cpp
+then
+  coin-config --build concave concave.cpp || exit 1
+fi
+
+./concave $*
+exit 0
@@ -0,0 +1,113 @@
+/************************************************************************
+ *
+ * Benchmark for SoDistanceAction. Builds an assembly of n x n x n
+ * jittered spheres and cones, and times finding the minimum
+ * clearance with one apply() of the action, against applying it to
+ * every pair of shapes by itself, which is what finding the clearance
+ * without a shape hierarchy amounts to. Also times ALL_PAIRS and
+ * NEAREST queries on the whole assembly.
+ *
+ * Run with COIN_DEBUG_DISTANCEACTION=1 in the environment to get the
+ * number of shape and triangle pairs tested.
+ *
+ ************************************************************************/
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SoPath.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/collision/SoDistanceAction.h>
+#include <Inventor/lists/SoPathList.h>
+#include <Inventor/nodes/SoComplexity.h>
+#include <Inventor/nodes/SoCone.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+static float
+jitter(void)
+{
+  return (float(rand()) / float(RAND_MAX) - 0.5f) * 0.6f;
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 5;
+
+  SoDB::init();
+  srand(42);
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoComplexity * complexity = new SoComplexity;
+  complexity->value = 0.6f;
+  root->addChild(complexity);
+  for (int i = 0; i < n * n * n; i++) {
+    SoSeparator * sep = new SoSeparator;
+    SoTranslation * t = new SoTranslation;
+    t->translation.setValue(float(i % n) * 2.5f + jitter(),
+                            float((i / n) % n) * 2.5f + jitter(),
+                            float(i / (n * n)) * 2.5f + jitter());
+    sep->addChild(t);
+    if (i % 2) sep->addChild(new SoSphere);
+    else sep->addChild(new SoCone);
+    root->addChild(sep);
+  }
+
+  SoDistanceAction da;
+  SbTime start = SbTime::getTimeOfDay();
+  da.apply(root);
+  const double hierarchy = (SbTime::getTimeOfDay() - start).getValue();
+  const float clearance = da.getNumResults() ? da.getResult(0)->distance : -1.0f;
+
+  // every pair by itself
+  float pairwise = -1.0f;
+  int numpairs = 0;
+  start = SbTime::getTimeOfDay();
+  for (int i = 0; i < n * n * n; i++) {
+    for (int j = i + 1; j < n * n * n; j++) {
+      SoPath * p1 = new SoPath(root);
+      p1->append(i + 1);
+      SoPath * p2 = new SoPath(root);
+      p2->append(j + 1);
+      SoPathList paths;
+      paths.append(p1);
+      paths.append(p2);
+      da.apply(paths);
+      if (da.getNumResults() &&
+          (pairwise < 0.0f || da.getResult(0)->distance < pairwise)) {
+        pairwise = da.getResult(0)->distance;
+      }
+      numpairs++;
+    }
+  }
+  const double bypair = (SbTime::getTimeOfDay() - start).getValue();
+
+  (void)fprintf(stdout, "%d shapes, clearance %g (hierarchy) %g (%d pairs)\n",
+                n * n * n, clearance, pairwise, numpairs);
+  (void)fprintf(stdout, "closest pair: %.2f ms hierarchy, %.2f ms pair by pair\n",
+                hierarchy * 1000.0, bypair * 1000.0);
+
+  da.setQuery(SoDistanceAction::ALL_PAIRS);
+  da.setMaxDistance(clearance * 2.0f);
+  start = SbTime::getTimeOfDay();
+  da.apply(root);
+  (void)fprintf(stdout, "all pairs within %g: %d pairs, %.2f ms\n",
+                clearance * 2.0f, da.getNumResults(),
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+
+  da.setQuery(SoDistanceAction::NEAREST);
+  da.setMaxDistance(FLT_MAX);
+  da.setNumNearest(4);
+  da.setPoint(SbVec3f(1.25f, 1.25f, 1.25f));
+  start = SbTime::getTimeOfDay();
+  da.apply(root);
+  (void)fprintf(stdout, "4 nearest: %d shapes, %.2f ms\n", da.getNumResults(),
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+
+  root->unref();
+  return 0;
+}
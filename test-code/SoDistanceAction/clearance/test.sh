@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test clearance -ot clearance.cpp
+then
+  coin-config --build clearance clearance.cpp || exit 1
+fi
+
+./clearance $*
+exit 0
@@ -0,0 +1,147 @@
+/************************************************************************
+ *
+ * Microbenchmark for SoGLImage::resizeImage() and
+ * SoGLImage::halveImage(), the kernels used to resize texture images
+ * and build mipmaps, against the plain loops they replace. Resizes a
+ * 3000x3000 image up to 4096x4096, builds the full mipmap chain for
+ * the 4096x4096 image, and checks that the results are identical.
+ *
+ * Run with COIN_NO_SIMD=1 in the environment to measure the plain C++
+ * kernels.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbVec3s.h>
+#include <Inventor/misc/SoGLImage.h>
+
+// the loops from SoGLImage before the kernels were vectorized
+
+static void
+old_resize(const unsigned char * src, unsigned char * dest,
+           int width, int height, int num_comp,
+           int newwidth, int newheight)
+{
+  float dx = ((float)width)/((float)newwidth);
+  float dy = ((float)height)/((float)newheight);
+  int src_bpr = width * num_comp;
+  int dest_bpr = newwidth * num_comp;
+  float sy = 0.0f;
+  int ystop = newheight * dest_bpr;
+  int xstop = newwidth * num_comp;
+  for (int y = 0; y < ystop; y += dest_bpr) {
+    float sx = 0.0f;
+    for (int x = 0; x < xstop; x += num_comp) {
+      int offset = ((int)sy)*src_bpr + ((int)sx)*num_comp;
+      for (int i = 0; i < num_comp; i++) dest[x+y+i] = src[offset+i];
+      sx += dx;
+    }
+    sy += dy;
+  }
+}
+
+static void
+old_halve(const int width, const int height, const int nc,
+          const unsigned char * src, unsigned char * dst)
+{
+  int nextrow = width * nc;
+  for (int i = 0; i < height / 2; i++) {
+    for (int j = 0; j < width / 2; j++) {
+      for (int c = 0; c < nc; c++) {
+        *dst = (src[0] + src[nc] + src[nextrow] + src[nextrow+nc] + 2) >> 2;
+        dst++; src++;
+      }
+      src += nc;
+    }
+    src += nextrow;
+  }
+}
+
+static double
+msince(const SbTime & start)
+{
+  return (SbTime::getTimeOfDay() - start).getValue() * 1.0e3;
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int rounds = (argc > 1) ? atoi(argv[1]) : 3;
+  const int size = 4096, srcsize = 3000;
+
+  SoDB::init();
+
+  unsigned char * src = new unsigned char[srcsize * srcsize * 4];
+  unsigned char * big0 = new unsigned char[size * size * 4];
+  unsigned char * big1 = new unsigned char[size * size * 4];
+  unsigned char * mip0 = new unsigned char[size * size * 4 / 2];
+  unsigned char * mip1 = new unsigned char[size * size * 4 / 2];
+
+  srand(19720408);
+  for (int i = 0; i < srcsize * srcsize * 4; i++) src[i] = (unsigned char) rand();
+
+  for (int nc = 1; nc <= 4; nc++) {
+    const SbVec3s from(srcsize, srcsize, 1), to(size, size, 1);
+    SbTime start = SbTime::getTimeOfDay();
+    for (int r = 0; r < rounds; r++) old_resize(src, big0, srcsize, srcsize, nc, size, size);
+    const double oldresize = msince(start) / rounds;
+    start = SbTime::getTimeOfDay();
+    for (int r = 0; r < rounds; r++) SoGLImage::resizeImage(src, from, nc, big1, to);
+    const double newresize = msince(start) / rounds;
+    const int resizediff = memcmp(big0, big1, size * size * nc) != 0;
+
+    // all mipmap levels, each level written after the previous one
+    double oldhalve = 0.0, newhalve = 0.0, srgbhalve = 0.0;
+    int halvediff = 0;
+    for (int r = 0; r < rounds; r++) {
+      int w = size;
+      const unsigned char * s0 = big0;
+      unsigned char * d0 = mip0;
+      start = SbTime::getTimeOfDay();
+      while (w > 1) {
+        old_halve(w, w, nc, s0, d0);
+        s0 = d0; d0 += (w / 2) * (w / 2) * nc; w /= 2;
+      }
+      oldhalve += msince(start);
+
+      w = size;
+      const unsigned char * s1 = big0;
+      unsigned char * d1 = mip1;
+      start = SbTime::getTimeOfDay();
+      while (w > 1) {
+        SoGLImage::halveImage(s1, SbVec3s(w, w, 1), nc, d1);
+        s1 = d1; d1 += (w / 2) * (w / 2) * nc; w /= 2;
+      }
+      newhalve += msince(start);
+      halvediff |= memcmp(mip0, mip1, d1 - mip1) != 0;
+
+      w = size;
+      s1 = big0;
+      d1 = mip1;
+      start = SbTime::getTimeOfDay();
+      while (w > 1) {
+        SoGLImage::halveImage(s1, SbVec3s(w, w, 1), nc, d1, TRUE);
+        s1 = d1; d1 += (w / 2) * (w / 2) * nc; w /= 2;
+      }
+      srgbhalve += msince(start);
+    }
+
+    (void)fprintf(stdout, "%d component%s: resize %.1f ms old, %.1f ms new%s; "
+                  "mipmaps %.1f ms old, %.1f ms new, %.1f ms sRGB%s\n",
+                  nc, nc == 1 ? "" : "s", oldresize, newresize,
+                  resizediff ? " (DIFFERENT)" : "",
+                  oldhalve / rounds, newhalve / rounds, srgbhalve / rounds,
+                  halvediff ? " (DIFFERENT)" : "");
+  }
+
+  delete[] src;
+  delete[] big0;
+  delete[] big1;
+  delete[] mip0;
+  delete[] mip1;
+  return 0;
+}
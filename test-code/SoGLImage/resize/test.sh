@@ -0,0 +1,12 @@
+#!/bin/sh
+
+if test resize -ot resize.cpp
+then
+  coin-config --build resize resize.cpp || exit 1
+fi
+
+echo "plain C++:"
+COIN_NO_SIMD=1 ./resize $*
+echo "SIMD:"
+./resize $*
+exit 0
@@ -0,0 +1,78 @@
+/************************************************************************
+ *
+ * Benchmark for generating vertex normals for large meshes. Makes a
+ * wavy n x n grid of quads and times generating its normals in the
+ * two ways Coin does it:
+ *
+ *   - with SoNormalCache::generatePerVertex() on the coordinate
+ *     indices, as SoIndexedFaceSet does
+ *
+ *   - with SoNormalGenerator on the vertex positions, which need to
+ *     be welded to find the shared vertices, as SoFaceSet does
+ *
+ * The default n = 1000 makes 1M quads with 4M corners. Set
+ * COIN_NORMALGENERATOR_THREADS in the environment to change the
+ * number of threads smoothing the normals.
+ *
+ ************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/caches/SoNormalCache.h>
+#include <Inventor/lists/SbList.h>
+#include <Inventor/misc/SoNormalGenerator.h>
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 1000;
+  const float creaseangle = 0.8f;
+
+  SoDB::init();
+
+  SbList<SbVec3f> coords((n + 1) * (n + 1));
+  SbList<int32_t> indices(n * n * 5);
+  int i, j;
+  for (j = 0; j <= n; j++) {
+    for (i = 0; i <= n; i++) {
+      const float x = float(i) / float(n);
+      const float y = float(j) / float(n);
+      coords.append(SbVec3f(x, y, 0.05f * float(sin(40.0 * x) * cos(30.0 * y))));
+    }
+  }
+  for (j = 0; j < n; j++) {
+    for (i = 0; i < n; i++) {
+      indices.append(j * (n + 1) + i);
+      indices.append(j * (n + 1) + i + 1);
+      indices.append((j + 1) * (n + 1) + i + 1);
+      indices.append((j + 1) * (n + 1) + i);
+      indices.append(-1);
+    }
+  }
+  fprintf(stdout, "%d quads, %d vertices\n", n * n, coords.getLength());
+
+  SbTime t = SbTime::getTimeOfDay();
+  SoNormalCache cache(NULL);
+  cache.generatePerVertex(coords.getArrayPtr(), coords.getLength(),
+                          indices.getArrayPtr(), indices.getLength(),
+                          creaseangle);
+  fprintf(stdout, "indexed (SoNormalCache):       %8.1f ms, %d normals\n",
+          (SbTime::getTimeOfDay() - t).getValue() * 1000.0, cache.getNum());
+
+  t = SbTime::getTimeOfDay();
+  SoNormalGenerator gen(TRUE, indices.getLength());
+  const SbVec3f * c = coords.getArrayPtr();
+  const int32_t * idx = indices.getArrayPtr();
+  for (i = 0; i < n * n; i++) {
+    gen.quad(c[idx[0]], c[idx[1]], c[idx[2]], c[idx[3]]);
+    idx += 5;
+  }
+  gen.generate(creaseangle);
+  fprintf(stdout, "positions (SoNormalGenerator): %8.1f ms, %d normals\n",
+          (SbTime::getTimeOfDay() - t).getValue() * 1000.0, gen.getNumNormals());
+
+  return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test largemesh -ot largemesh.cpp
+then
+  coin-config --build largemesh largemesh.cpp || exit 1
+fi
+
+./largemesh $*
+exit 0
@@ -0,0 +1,127 @@
+/************************************************************************
+ *
+ * Benchmark for batched ray picking. Builds n x n blocks of m x m
+ * bumpy quad meshes, and times picking a k x k grid of viewport
+ * points, with one action application for each point, with all the
+ * points in one batch, and with the batch split between threads.
+ *
+ * In the batched picks the rays are culled as packets against the
+ * bounding boxes of the separators, and each mesh generates its
+ * triangles once for all the rays which hit its bounding box.
+ *
+ * The threads only run in parallel when Coin is built with thread
+ * safety enabled.
+ *
+ ************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/lists/SoPickedPointList.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoQuadMesh.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+static int
+count_hits(SoRayPickAction & rp)
+{
+  int hits = 0;
+  for (int i = 0; i < rp.getNumRays(); i++) {
+    if (rp.getPickedPointList(i).getLength()) hits++;
+  }
+  return hits;
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 8;
+  const int m = (argc > 2) ? atoi(argv[2]) : 8;
+  const int k = (argc > 3) ? atoi(argv[3]) : 64;
+  const int threads = (argc > 4) ? atoi(argv[4]) : 4;
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  root->addChild(camera);
+
+  // one bumpy 16 x 16 quad mesh, shared by all the cells
+  const int size = 17;
+  SoCoordinate3 * coords = new SoCoordinate3;
+  for (int v = 0; v < size * size; v++) {
+    const float x = float(v % size) / float(size - 1);
+    const float y = float(v / size) / float(size - 1);
+    coords->point.set1Value(v, SbVec3f(x * 1.8f, y * 1.8f,
+                                       0.2f * float(sin(x * 9.0f) * cos(y * 7.0f))));
+  }
+  SoQuadMesh * mesh = new SoQuadMesh;
+  mesh->verticesPerRow = size;
+  mesh->verticesPerColumn = size;
+
+  for (int i = 0; i < n * n; i++) {
+    SoSeparator * block = new SoSeparator;
+    for (int j = 0; j < m * m; j++) {
+      SoSeparator * sep = new SoSeparator;
+      SoTranslation * t = new SoTranslation;
+      t->translation.setValue(float((i % n) * m + j % m) * 2.0f,
+                              float((i / n) * m + j / m) * 2.0f,
+                              0.0f);
+      sep->addChild(t);
+      sep->addChild(coords);
+      sep->addChild(mesh);
+      block->addChild(sep);
+    }
+    root->addChild(block);
+  }
+
+  SbViewportRegion vp(512, 512);
+  camera->viewAll(root, vp);
+
+  SbVec2f * points = new SbVec2f[k * k];
+  for (int i = 0; i < k * k; i++) {
+    points[i].setValue((float(i % k) + 0.5f) / float(k),
+                       (float(i / k) + 0.5f) / float(k));
+  }
+
+  SoRayPickAction rp(vp);
+  // make the bounding box caches
+  rp.setNormalizedPoints(points, k * k);
+  rp.apply(root);
+
+  SbTime start = SbTime::getTimeOfDay();
+  int hits = 0;
+  for (int i = 0; i < k * k; i++) {
+    rp.setNormalizedPoint(points[i]);
+    rp.apply(root);
+    if (rp.getPickedPoint()) hits++;
+  }
+  (void)fprintf(stdout, "%d rays one by one: %d hits, %.2f ms\n", k * k, hits,
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+
+  start = SbTime::getTimeOfDay();
+  rp.setNormalizedPoints(points, k * k);
+  rp.apply(root);
+  hits = count_hits(rp);
+  (void)fprintf(stdout, "%d rays batched: %d hits, %.2f ms\n", k * k, hits,
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+
+  start = SbTime::getTimeOfDay();
+  rp.setNumThreads(threads);
+  rp.apply(root);
+  hits = count_hits(rp);
+  (void)fprintf(stdout, "%d rays batched in %d threads: %d hits, %.2f ms\n",
+                k * k, threads, hits,
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0);
+
+  delete[] points;
+  root->unref();
+  return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test batch -ot batch.cpp
+then
+  coin-config --build batch batch.cpp || exit 1
+fi
+
+./batch $*
+exit 0
@@ -0,0 +1,84 @@
+/************************************************************************
+ *
+ * Benchmark for lightweight ray picking. Builds n layers of m x m
+ * spheres behind each other, and times picking at random points of
+ * the viewport, like when highlighting the shape under the mouse
+ * cursor, with full picked points and with lightweight picks.
+ *
+ * Lightweight picks skip the subgraphs behind the closest hit so
+ * far, and don't make details and normals for the hits, so the
+ * gain grows with the number of layers.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/SoPickedPoint.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/nodes/SoComplexity.h>
+#include <Inventor/nodes/SoPerspectiveCamera.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoSphere.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+static void
+time_picks(const char * what, SoRayPickAction & rp, SoNode * root,
+           const int count)
+{
+  srand(1);
+  int hits = 0;
+  SbTime start = SbTime::getTimeOfDay();
+  for (int i = 0; i < count; i++) {
+    rp.setNormalizedPoint(SbVec2f(float(rand()) / float(RAND_MAX),
+                                  float(rand()) / float(RAND_MAX)));
+    rp.apply(root);
+    if (rp.isLightweightPick() ? rp.getPickedPath() != NULL :
+        rp.getPickedPoint() != NULL) hits++;
+  }
+  (void)fprintf(stdout, "%s: %d hits, %.3f ms per pick\n", what, hits,
+                (SbTime::getTimeOfDay() - start).getValue() * 1000.0 / count);
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 16;
+  const int m = (argc > 2) ? atoi(argv[2]) : 16;
+  const int count = (argc > 3) ? atoi(argv[3]) : 1000;
+
+  SoDB::init();
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoPerspectiveCamera * camera = new SoPerspectiveCamera;
+  root->addChild(camera);
+  SoComplexity * complexity = new SoComplexity;
+  complexity->value = 0.5f;
+  root->addChild(complexity);
+  for (int k = 0; k < n; k++) {
+    SoSeparator * layer = new SoSeparator;
+    for (int j = 0; j < m * m; j++) {
+      SoSeparator * sep = new SoSeparator;
+      SoTranslation * t = new SoTranslation;
+      t->translation.setValue(float(j % m) * 2.5f, float(j / m) * 2.5f,
+                              -float(k) * 2.5f);
+      sep->addChild(t);
+      sep->addChild(new SoSphere);
+      layer->addChild(sep);
+    }
+    root->addChild(layer);
+  }
+  SbViewportRegion vp(640, 480);
+  camera->viewAll(root, vp);
+
+  SoRayPickAction rp(vp);
+  time_picks("full picked points", rp, root, count);
+  rp.setLightweightPick(TRUE);
+  time_picks("lightweight", rp, root, count);
+
+  root->unref();
+  return 0;
+}
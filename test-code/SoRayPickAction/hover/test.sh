@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test hover -ot hover.cpp
+then
+  coin-config --build hover hover.cpp || exit 1
+fi
+
+./hover $*
+exit 0
@@ -0,0 +1,94 @@
+/************************************************************************
+ *
+ * Benchmark for ray picking shapes with many triangles. Builds an
+ * n x n checkerboard of quads in a single SoIndexedFaceSet, and times
+ * picking rays through the holes, which miss the shape but not its
+ * bounding box, and rays hitting quads.
+ *
+ * Run with COIN_NO_TRIANGLE_BVH_CACHE=1 in the environment to time
+ * picking without the triangle tree shapes keep for picking, where
+ * every pick generates and tests all the triangles of the shape.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoRayPickAction.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+#include <Inventor/nodes/SoSeparator.h>
+
+static int
+pick(SoRayPickAction & rp, SoNode * root, const int n, const int count,
+     const SbBool hole)
+{
+  int hits = 0;
+  for (int k = 0; k < count; k++) {
+    const int i = rand() % n;
+    int j = rand() % n;
+    // holes are where i + j is odd
+    if (((i + j) % 2 == 1) != hole) j = (j + 1) % n;
+    if (((i + j) % 2 == 1) != hole) j = (j + n - 2) % n;
+    rp.setRay(SbVec3f(float(i) + 0.5f, float(j) + 0.5f, 10.0f),
+              SbVec3f(0.0f, 0.0f, -1.0f));
+    rp.apply(root);
+    if (rp.getPickedPoint()) hits++;
+  }
+  return hits;
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int n = (argc > 1) ? atoi(argv[1]) : 200;
+  const int count = (argc > 2) ? atoi(argv[2]) : 200;
+
+  SoDB::init();
+  srand(42);
+
+  SoSeparator * root = new SoSeparator;
+  root->ref();
+  SoCoordinate3 * coords = new SoCoordinate3;
+  SoIndexedFaceSet * ifs = new SoIndexedFaceSet;
+  root->addChild(coords);
+  root->addChild(ifs);
+
+  int i, j, idx = 0;
+  for (j = 0; j <= n; j++) {
+    for (i = 0; i <= n; i++) {
+      coords->point.set1Value(j * (n + 1) + i, SbVec3f(float(i), float(j), 0.0f));
+    }
+  }
+  for (j = 0; j < n; j++) {
+    for (i = 0; i < n; i++) {
+      if ((i + j) % 2) continue;
+      const int32_t quad[] = {
+        j * (n + 1) + i, j * (n + 1) + i + 1,
+        (j + 1) * (n + 1) + i + 1, (j + 1) * (n + 1) + i, -1
+      };
+      ifs->coordIndex.setValues(idx, 5, quad);
+      idx += 5;
+    }
+  }
+  fprintf(stdout, "%d quads, %d picks of each kind\n", idx / 5, count);
+
+  SoRayPickAction rp(SbViewportRegion(512, 512));
+  // the first two picks build the pick caches
+  pick(rp, root, n, 2, FALSE);
+
+  SbTime t = SbTime::getTimeOfDay();
+  int hits = pick(rp, root, n, count, TRUE);
+  fprintf(stdout, "rays through holes: %8.3f ms/pick, %d hits\n",
+          (SbTime::getTimeOfDay() - t).getValue() * 1000.0 / count, hits);
+
+  t = SbTime::getTimeOfDay();
+  hits = pick(rp, root, n, count, FALSE);
+  fprintf(stdout, "rays hitting quads: %8.3f ms/pick, %d hits\n",
+          (SbTime::getTimeOfDay() - t).getValue() * 1000.0 / count, hits);
+
+  root->unref();
+  return 0;
+}
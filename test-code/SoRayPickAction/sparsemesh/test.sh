@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test sparsemesh -ot sparsemesh.cpp
+then
+  coin-config --build sparsemesh sparsemesh.cpp || exit 1
+fi
+
+./sparsemesh $*
+exit 0
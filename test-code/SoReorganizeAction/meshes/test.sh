@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test meshes -ot meshes.cpp
+then
+  coin-config --build meshes meshes.cpp || exit 1
+fi
+
+./meshes $*
+exit 0
@@ -0,0 +1,9 @@
+#!/bin/sh
+
+if test traversal -ot traversal.cpp
+then
+  coin-config --build traversal traversal.cpp || exit 1
+fi
+
+./traversal $*
+exit 0
@@ -0,0 +1,121 @@
+/************************************************************************
+ *
+ * Microbenchmark for the traversal state overhead. Builds a deep graph
+ * (nested separators, each changing a few elements) and a wide graph
+ * (one group with many small separators), and prints the cost per
+ * node of applying an SoCallbackAction and an SoGetBoundingBoxAction,
+ * plus the cost of constructing an action and its state.
+ *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Inventor/SoDB.h>
+#include <Inventor/SbTime.h>
+#include <Inventor/SbViewportRegion.h>
+#include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoGetBoundingBoxAction.h>
+#include <Inventor/nodes/SoComplexity.h>
+#include <Inventor/nodes/SoCube.h>
+#include <Inventor/nodes/SoDrawStyle.h>
+#include <Inventor/nodes/SoMaterial.h>
+#include <Inventor/nodes/SoSeparator.h>
+#include <Inventor/nodes/SoTranslation.h>
+
+static double
+nsper(const SbTime & start, const int count)
+{
+  return (SbTime::getTimeOfDay() - start).getValue() * 1.0e9 / double(count);
+}
+
+// a separator changing the model matrix, material, draw style and
+// complexity elements
+static SoSeparator *
+make_level(const int i)
+{
+  SoSeparator * sep = new SoSeparator;
+  sep->renderCaching = SoSeparator::OFF;
+  sep->boundingBoxCaching = SoSeparator::OFF;
+  SoTranslation * t = new SoTranslation;
+  t->translation.setValue(float(i % 7) * 0.1f, 0.0f, 0.0f);
+  sep->addChild(t);
+  SoMaterial * m = new SoMaterial;
+  m->diffuseColor.setValue(float(i % 3) / 3.0f, 0.5f, 0.5f);
+  sep->addChild(m);
+  SoDrawStyle * ds = new SoDrawStyle;
+  ds->lineWidth = float(i % 4);
+  sep->addChild(ds);
+  SoComplexity * c = new SoComplexity;
+  c->value = float(i % 10) / 10.0f;
+  sep->addChild(c);
+  return sep;
+}
+
+static void
+run(const char * name, SoNode * root, const int numnodes, const int rounds)
+{
+  SoCallbackAction cba;
+  SoGetBoundingBoxAction bba(SbViewportRegion(640, 480));
+  cba.apply(root);
+  bba.apply(root);
+
+  SbTime start = SbTime::getTimeOfDay();
+  for (int r = 0; r < rounds; r++) cba.apply(root);
+  const double cb = nsper(start, numnodes * rounds);
+
+  start = SbTime::getTimeOfDay();
+  for (int r = 0; r < rounds; r++) bba.apply(root);
+  const double bb = nsper(start, numnodes * rounds);
+
+  (void)fprintf(stdout, "%s: %.2f ns/node SoCallbackAction, %.2f ns/node SoGetBoundingBoxAction\n",
+                name, cb, bb);
+}
+
+int
+main(int argc, char ** argv)
+{
+  const int num = (argc > 1) ? atoi(argv[1]) : 1000;
+  const int rounds = (argc > 2) ? atoi(argv[2]) : 200;
+
+  SoDB::init();
+
+  // deep: separators nested num levels deep
+  SoSeparator * deep = make_level(0);
+  deep->ref();
+  SoSeparator * parent = deep;
+  for (int i = 0; i < num; i++) {
+    SoSeparator * level = make_level(i);
+    parent->addChild(level);
+    parent = level;
+  }
+  parent->addChild(new SoCube);
+
+  // wide: num separators side by side
+  SoSeparator * wide = make_level(0);
+  wide->ref();
+  for (int i = 0; i < num; i++) {
+    SoSeparator * level = make_level(i);
+    level->addChild(new SoCube);
+    wide->addChild(level);
+  }
+
+  // each level holds five nodes, plus a cube in the wide graph
+  run("deep", deep, (num + 1) * 5, rounds);
+  run("wide", wide, num * 6 + 5, rounds);
+
+  SoCube * cube = new SoCube;
+  cube->ref();
+  const int numactions = rounds * 100;
+  SbTime start = SbTime::getTimeOfDay();
+  for (int i = 0; i < numactions; i++) {
+    SoGetBoundingBoxAction action(SbViewportRegion(640, 480));
+    action.apply(cube);
+  }
+  (void)fprintf(stdout, "new action: %.2f ns/action for SoGetBoundingBoxAction on a single node\n",
+                nsper(start, 1) / double(numactions));
+
+  cube->unref();
+  deep->unref();
+  wide->unref();
+  return 0;
+}